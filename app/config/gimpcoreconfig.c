@@ -126,6 +126,12 @@ enum
   PROP_EXPORT_METADATA_EXIF,
   PROP_EXPORT_METADATA_XMP,
   PROP_EXPORT_METADATA_IPTC,
+  PROP_XCF_FAST_COMPRESSION,
+  PROP_XCF_SAVE_MIPMAPS,
+  PROP_XCF_LAZY_LOADING,
+  PROP_BRUSH_CACHE_SIZE,
+  PROP_BRUSH_CACHE_TOLERANCE,
+  PROP_PLUG_IN_SHM_SIZE,
   PROP_DEBUG_POLICY,
 
   /* ignored, only for backward compatibility: */
@@ -755,6 +761,49 @@ gimp_core_config_class_init (GimpCoreConfigClass *klass)
                             TRUE,
                             GIMP_PARAM_STATIC_STRINGS);
 
+  GIMP_CONFIG_PROP_BOOLEAN (object_class, PROP_XCF_FAST_COMPRESSION,
+                            "xcf-fast-compression",
+                            "XCF fast compression",
+                            XCF_FAST_COMPRESSION_BLURB,
+                            FALSE,
+                            GIMP_PARAM_STATIC_STRINGS);
+
+  GIMP_CONFIG_PROP_BOOLEAN (object_class, PROP_XCF_SAVE_MIPMAPS,
+                            "xcf-save-mipmaps",
+                            "XCF save mipmaps",
+                            XCF_SAVE_MIPMAPS_BLURB,
+                            FALSE,
+                            GIMP_PARAM_STATIC_STRINGS);
+
+  GIMP_CONFIG_PROP_BOOLEAN (object_class, PROP_XCF_LAZY_LOADING,
+                            "xcf-lazy-loading",
+                            "XCF lazy loading",
+                            XCF_LAZY_LOADING_BLURB,
+                            FALSE,
+                            GIMP_PARAM_STATIC_STRINGS);
+
+  GIMP_CONFIG_PROP_MEMSIZE (object_class, PROP_BRUSH_CACHE_SIZE,
+                            "brush-cache-size",
+                            "Brush cache size",
+                            BRUSH_CACHE_SIZE_BLURB,
+                            0, GIMP_MAX_MEMSIZE, 1 << 26,
+                            GIMP_PARAM_STATIC_STRINGS);
+
+  GIMP_CONFIG_PROP_DOUBLE (object_class, PROP_BRUSH_CACHE_TOLERANCE,
+                           "brush-cache-tolerance",
+                           "Brush cache tolerance",
+                           BRUSH_CACHE_TOLERANCE_BLURB,
+                           0.0, 10.0, 0.25,
+                           GIMP_PARAM_STATIC_STRINGS);
+
+  GIMP_CONFIG_PROP_MEMSIZE (object_class, PROP_PLUG_IN_SHM_SIZE,
+                            "plug-in-shm-size",
+                            "Plug-in shared memory size",
+                            PLUG_IN_SHM_SIZE_BLURB,
+                            0, GIMP_MAX_MEMSIZE, 1 << 24,
+                            GIMP_PARAM_STATIC_STRINGS |
+                            GIMP_CONFIG_PARAM_RESTART);
+
   GIMP_CONFIG_PROP_ENUM (object_class, PROP_DEBUG_POLICY,
                          "debug-policy",
                          "Try generating backtrace upon errors",
@@ -1078,6 +1127,24 @@ gimp_core_config_set_property (GObject      *object,
     case PROP_EXPORT_METADATA_IPTC:
       core_config->export_metadata_iptc = g_value_get_boolean (value);
       break;
+    case PROP_XCF_FAST_COMPRESSION:
+      core_config->xcf_fast_compression = g_value_get_boolean (value);
+      break;
+    case PROP_XCF_SAVE_MIPMAPS:
+      core_config->xcf_save_mipmaps = g_value_get_boolean (value);
+      break;
+    case PROP_XCF_LAZY_LOADING:
+      core_config->xcf_lazy_loading = g_value_get_boolean (value);
+      break;
+    case PROP_BRUSH_CACHE_SIZE:
+      core_config->brush_cache_size = g_value_get_uint64 (value);
+      break;
+    case PROP_BRUSH_CACHE_TOLERANCE:
+      core_config->brush_cache_tolerance = g_value_get_double (value);
+      break;
+    case PROP_PLUG_IN_SHM_SIZE:
+      core_config->plug_in_shm_size = g_value_get_uint64 (value);
+      break;
     case PROP_DEBUG_POLICY:
       core_config->debug_policy = g_value_get_enum (value);
       break;
@@ -1286,6 +1353,24 @@ gimp_core_config_get_property (GObject    *object,
     case PROP_EXPORT_METADATA_IPTC:
       g_value_set_boolean (value, core_config->export_metadata_iptc);
       break;
+    case PROP_XCF_FAST_COMPRESSION:
+      g_value_set_boolean (value, core_config->xcf_fast_compression);
+      break;
+    case PROP_XCF_SAVE_MIPMAPS:
+      g_value_set_boolean (value, core_config->xcf_save_mipmaps);
+      break;
+    case PROP_XCF_LAZY_LOADING:
+      g_value_set_boolean (value, core_config->xcf_lazy_loading);
+      break;
+    case PROP_BRUSH_CACHE_SIZE:
+      g_value_set_uint64 (value, core_config->brush_cache_size);
+      break;
+    case PROP_BRUSH_CACHE_TOLERANCE:
+      g_value_set_double (value, core_config->brush_cache_tolerance);
+      break;
+    case PROP_PLUG_IN_SHM_SIZE:
+      g_value_set_uint64 (value, core_config->plug_in_shm_size);
+      break;
     case PROP_DEBUG_POLICY:
       g_value_set_enum (value, core_config->debug_policy);
       break;
@@ -101,6 +101,12 @@ struct _GimpCoreConfig
   gboolean                export_metadata_exif;
   gboolean                export_metadata_xmp;
   gboolean                export_metadata_iptc;
+  gboolean                xcf_fast_compression;
+  gboolean                xcf_save_mipmaps;
+  gboolean                xcf_lazy_loading;
+  guint64                 brush_cache_size;
+  gdouble                 brush_cache_tolerance;
+  guint64                 plug_in_shm_size;
   GimpDebugPolicy         debug_policy;
 };
 
@@ -228,6 +228,35 @@ _("Export XMP metadata by default.")
 #define EXPORT_METADATA_IPTC_BLURB \
 _("Export IPTC metadata by default.")
 
+#define XCF_FAST_COMPRESSION_BLURB \
+_("Use fast per-tile zlib compression when saving XCF files.  Files saved " \
+  "this way can't be opened by older versions.")
+
+#define XCF_SAVE_MIPMAPS_BLURB \
+_("Save reduced-size copies of all layers and channels in XCF files, so " \
+  "that zoomed-out views of large images can be shown sooner after " \
+  "opening them.  Files saved this way can't be opened by older versions.")
+
+#define XCF_LAZY_LOADING_BLURB \
+_("When opening local XCF files, only read the pixels of layers and " \
+  "channels when they are first needed, instead of all at once.  The " \
+  "file must not be modified by other programs while it is open.")
+
+#define BRUSH_CACHE_SIZE_BLURB \
+_("Sets the amount of memory used for caching transformed brushes.")
+
+#define BRUSH_CACHE_TOLERANCE_BLURB \
+_("Transformed brushes are cached at this precision, in percent of the " \
+  "brush size, so that brushes whose size, aspect ratio, angle or " \
+  "hardness vary slightly between dabs can be reused.  The default moves " \
+  "the outline of brushes up to 400 pixels by less than a pixel.  Set to " \
+  "0 to only reuse exact matches.")
+
+#define PLUG_IN_SHM_SIZE_BLURB \
+_("Sets the size of the shared memory segment used for exchanging pixel " \
+  "data with plug-ins.  Larger values let plug-ins transfer more tiles " \
+  "at once.")
+
 #define GENERATE_BACKTRACE_BLURB \
 _("Try generating debug data for bug reporting when appropriate.")
 
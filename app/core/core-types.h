@@ -214,8 +214,11 @@ typedef struct _GimpWaitable                    GimpWaitable;    /* dummy typede
 
 typedef struct _GimpBacktrace                   GimpBacktrace;
 typedef struct _GimpBoundSeg                    GimpBoundSeg;
+typedef struct _GimpBoundaryCache               GimpBoundaryCache;
 typedef struct _GimpChunkIterator               GimpChunkIterator;
 typedef struct _GimpCoords                      GimpCoords;
+typedef struct _GimpDataIndex                   GimpDataIndex;
+typedef struct _GimpDataIndexEntry              GimpDataIndexEntry;
 typedef struct _GimpGradientSegment             GimpGradientSegment;
 typedef struct _GimpPaletteEntry                GimpPaletteEntry;
 typedef struct _GimpScanConvert                 GimpScanConvert;
@@ -35,6 +35,7 @@
 #include "gimpcontainer.h"
 #include "gimpbrush-load.h"
 #include "gimpbrush.h"
+#include "gimpbrushcache.h"
 #include "gimpbrushclipboard.h"
 #include "gimpbrushgenerated-load.h"
 #include "gimpbrushpipe-load.h"
@@ -64,6 +65,8 @@ gimp_data_factories_init (Gimp *gimp)
 {
   g_return_if_fail (GIMP_IS_GIMP (gimp));
 
+  gimp_brush_cache_global_init (gimp);
+
   gimp->brush_factory =
     gimp_data_loader_factory_new (gimp,
                                   GIMP_TYPE_BRUSH,
@@ -103,6 +106,10 @@ gimp_data_factories_init (Gimp *gimp)
                                        gimp_brush_pipe_load,
                                        GIMP_BRUSH_PIPE_FILE_EXTENSION,
                                        TRUE);
+  gimp_data_loader_factory_set_index (gimp->brush_factory,
+                                      "brushrc.idx",
+                                      gimp_brush_new_from_index,
+                                      gimp_brush_fill_index_entry);
 
   gimp->dynamics_factory =
     gimp_data_loader_factory_new (gimp,
@@ -151,6 +158,10 @@ gimp_data_factories_init (Gimp *gimp)
   gimp_data_loader_factory_add_fallback (gimp->pattern_factory,
                                          "Pattern from GdkPixbuf",
                                          gimp_pattern_load_pixbuf);
+  gimp_data_loader_factory_set_index (gimp->pattern_factory,
+                                      "patternrc.idx",
+                                      gimp_pattern_new_from_index,
+                                      gimp_pattern_fill_index_entry);
 
   gimp->gradient_factory =
     gimp_data_loader_factory_new (gimp,
@@ -289,6 +300,8 @@ gimp_data_factories_exit (Gimp *gimp)
   g_clear_object (&gimp->font_factory);
   g_clear_object (&gimp->tool_preset_factory);
   g_clear_object (&gimp->tag_cache);
+
+  gimp_brush_cache_global_exit (gimp);
 }
 
 gint64
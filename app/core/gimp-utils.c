@@ -36,6 +36,8 @@
 #define _WIN32_WINNT 0x0500
 #include <windows.h>
 #include <process.h>
+#else
+#include <signal.h>
 #endif
 
 #if defined(G_OS_UNIX) && defined(HAVE_EXECINFO_H)
@@ -73,6 +75,29 @@ gimp_get_pid (void)
   return (gint) getpid ();
 }
 
+/*  returns TRUE if a process with the given pid is running  */
+gboolean
+gimp_is_pid_alive (gint pid)
+{
+#ifdef G_OS_WIN32
+  HANDLE   process;
+  gboolean alive;
+
+  process = OpenProcess (SYNCHRONIZE, FALSE, pid);
+
+  if (! process)
+    return FALSE;
+
+  alive = WaitForSingleObject (process, 0) == WAIT_TIMEOUT;
+
+  CloseHandle (process);
+
+  return alive;
+#else
+  return kill (pid, 0) == 0 || errno == EPERM;
+#endif
+}
+
 guint64
 gimp_get_physical_memory_size (void)
 {
@@ -33,6 +33,7 @@
 
 
 gint         gimp_get_pid                          (void);
+gboolean     gimp_is_pid_alive                     (gint             pid);
 guint64      gimp_get_physical_memory_size         (void);
 gchar      * gimp_get_default_language             (const gchar     *category);
 GimpUnit     gimp_get_default_unit                 (void);
@@ -56,6 +56,7 @@
 #include "gimpbrush.h"
 #include "gimpbuffer.h"
 #include "gimpcontext.h"
+#include "gimpdrawableundo.h"
 #include "gimpdynamics.h"
 #include "gimpdocumentlist.h"
 #include "gimpgradient.h"
@@ -504,6 +505,9 @@ gimp_real_initialize (Gimp               *gimp,
 
   status_callback (_("Initialization"), NULL, 0.0);
 
+  /*  remove the undo swap files of crashed sessions  */
+  gimp_drawable_undo_swap_init (gimp);
+
   /*  set the last values used to default values  */
   gimp->image_new_last_template =
     gimp_config_duplicate (GIMP_CONFIG (gimp->config->default_image));
@@ -554,6 +558,8 @@ gimp_real_exit (Gimp     *gimp,
   gimp_parasiterc_save (gimp);
   gimp_unitrc_save (gimp);
 
+  gimp_drawable_undo_swap_exit (gimp);
+
   return FALSE; /* continue exiting */
 }
 
@@ -32,6 +32,9 @@
 /* GimpBoundSeg array growth parameter */
 #define MAX_SEGS_INC  2048
 
+/* size of the tiles the boundary cache is organized in */
+#define CACHE_TILE_SIZE  256
+
 
 typedef struct _GimpBoundary GimpBoundary;
 
@@ -52,6 +55,36 @@ struct _GimpBoundary
   gint          max_empty_segs;
 };
 
+typedef struct _GimpBoundaryTile GimpBoundaryTile;
+
+struct _GimpBoundaryTile
+{
+  /*  runs of pixels above the threshold, as pairs of start and end
+   *  x coordinates, indexed by row_offsets for each row of the tile
+   */
+  gint *runs;
+  gint *row_offsets;
+  gint  n_rows;
+};
+
+struct _GimpBoundaryCache
+{
+  const Babl        *format;
+  gfloat             threshold;
+  GeglRectangle      extent;
+
+  GimpBoundaryTile **tiles;
+  gint               n_cols;
+  gint               n_rows;
+};
+
+typedef struct
+{
+  GimpBoundaryCache *cache;
+  GeglBuffer        *buffer;
+  const gint        *indices;
+} CacheFillData;
+
 
 /*  local function prototypes  */
 
@@ -66,8 +99,18 @@ static void           gimp_boundary_add_seg    (GimpBoundary        *bounrady,
                                                 gint                 y2,
                                                 gboolean             open);
 
-static void           find_empty_segs          (const GeglRectangle *region,
-                                                const gfloat        *line_data,
+static void           gimp_boundary_cache_fill (GimpBoundaryCache   *cache,
+                                                GeglBuffer          *buffer,
+                                                const Babl          *format,
+                                                gfloat               threshold,
+                                                const GeglRectangle *area);
+static void     gimp_boundary_cache_fill_tiles (gint                 offset,
+                                                gint                 size,
+                                                CacheFillData       *data);
+static void           gimp_boundary_tile_free  (GimpBoundaryTile    *tile);
+
+static void           find_empty_segs          (GimpBoundaryCache   *cache,
+                                                const GeglRectangle *region,
                                                 gint                 scanline,
                                                 gint                 empty_segs[],
                                                 gint                 max_empty,
@@ -76,8 +119,7 @@ static void           find_empty_segs          (const GeglRectangle *region,
                                                 gint                 x1,
                                                 gint                 y1,
                                                 gint                 x2,
-                                                gint                 y2,
-                                                gfloat               threshold);
+                                                gint                 y2);
 static void           process_horiz_seg        (GimpBoundary        *boundary,
                                                 gint                 x1,
                                                 gint                 y1,
@@ -91,7 +133,8 @@ static void           make_horiz_segs          (GimpBoundary        *boundary,
                                                 gint                 empty[],
                                                 gint                 num_empty,
                                                 gint                 top);
-static GimpBoundary * generate_boundary        (GeglBuffer          *buffer,
+static GimpBoundary * generate_boundary        (GimpBoundaryCache   *cache,
+                                                GeglBuffer          *buffer,
                                                 const GeglRectangle *region,
                                                 const Babl          *format,
                                                 GimpBoundaryType     type,
@@ -163,10 +206,64 @@ gimp_boundary_find (GeglBuffer          *buffer,
                     int                  y2,
                     gfloat               threshold,
                     int                 *num_segs)
+{
+  GimpBoundaryCache *cache;
+  GimpBoundSeg      *segs;
+
+  g_return_val_if_fail (GEGL_IS_BUFFER (buffer), NULL);
+  g_return_val_if_fail (num_segs != NULL, NULL);
+
+  cache = gimp_boundary_cache_new ();
+
+  segs = gimp_boundary_find_cached (cache, buffer, region, format, type,
+                                    x1, y1, x2, y2, threshold, num_segs);
+
+  gimp_boundary_cache_free (cache);
+
+  return segs;
+}
+
+/**
+ * gimp_boundary_find_cached:
+ * @cache:     a #GimpBoundaryCache
+ * @buffer:    a #GeglBuffer
+ * @format:    a #Babl float format representing the component to analyze
+ * @type:      type of bounds
+ * @x1:        left side of bounds
+ * @y1:        top side of bounds
+ * @x2:        right side of bounds
+ * @y2:        bottom side of bounds
+ * @threshold: pixel value of boundary line
+ * @num_segs:  number of returned #GimpBoundSeg's
+ *
+ * Like gimp_boundary_find(), but keeps the per-tile pixel runs the
+ * boundary is built from in @cache.  Only tiles that were invalidated
+ * using gimp_boundary_cache_invalidate() since the last call, or that
+ * were not needed before, are read from @buffer again; they are
+ * processed in parallel.
+ *
+ * The caller is responsible for invalidating @cache whenever @buffer
+ * changes.
+ *
+ * Return value: the boundary array.
+ **/
+GimpBoundSeg *
+gimp_boundary_find_cached (GimpBoundaryCache   *cache,
+                           GeglBuffer          *buffer,
+                           const GeglRectangle *region,
+                           const Babl          *format,
+                           GimpBoundaryType     type,
+                           int                  x1,
+                           int                  y1,
+                           int                  x2,
+                           int                  y2,
+                           gfloat               threshold,
+                           int                 *num_segs)
 {
   GimpBoundary  *boundary;
   GeglRectangle  rect = { 0, };
 
+  g_return_val_if_fail (cache != NULL, NULL);
   g_return_val_if_fail (GEGL_IS_BUFFER (buffer), NULL);
   g_return_val_if_fail (num_segs != NULL, NULL);
   g_return_val_if_fail (format != NULL, NULL);
@@ -183,7 +280,7 @@ gimp_boundary_find (GeglBuffer          *buffer,
       rect.height = gegl_buffer_get_height (buffer);
     }
 
-  boundary = generate_boundary (buffer, &rect, format, type,
+  boundary = generate_boundary (cache, buffer, &rect, format, type,
                                 x1, y1, x2, y2, threshold);
 
   *num_segs = boundary->num_segs;
@@ -408,6 +505,119 @@ gimp_boundary_offset (GimpBoundSeg *segs,
     }
 }
 
+/**
+ * gimp_boundary_cache_new:
+ *
+ * Creates an empty cache to be used with gimp_boundary_find_cached().
+ *
+ * Return value: the new #GimpBoundaryCache.
+ **/
+GimpBoundaryCache *
+gimp_boundary_cache_new (void)
+{
+  return g_slice_new0 (GimpBoundaryCache);
+}
+
+void
+gimp_boundary_cache_free (GimpBoundaryCache *cache)
+{
+  g_return_if_fail (cache != NULL);
+
+  gimp_boundary_cache_invalidate (cache, NULL);
+
+  g_slice_free (GimpBoundaryCache, cache);
+}
+
+/**
+ * gimp_boundary_cache_invalidate:
+ * @cache: a #GimpBoundaryCache
+ * @rect:  the changed area of the buffer, or %NULL
+ *
+ * Drops the cached tiles intersecting @rect, or all of them if @rect
+ * is %NULL, so they are recomputed by the next call to
+ * gimp_boundary_find_cached().
+ **/
+void
+gimp_boundary_cache_invalidate (GimpBoundaryCache   *cache,
+                                const GeglRectangle *rect)
+{
+  gint col1, col2;
+  gint row1, row2;
+  gint row, col;
+
+  g_return_if_fail (cache != NULL);
+
+  if (! cache->tiles)
+    return;
+
+  if (rect)
+    {
+      GeglRectangle area;
+
+      if (! gegl_rectangle_intersect (&area, rect, &cache->extent))
+        return;
+
+      col1 = (area.x - cache->extent.x) / CACHE_TILE_SIZE;
+      row1 = (area.y - cache->extent.y) / CACHE_TILE_SIZE;
+      col2 = (area.x + area.width  - 1 - cache->extent.x) / CACHE_TILE_SIZE;
+      row2 = (area.y + area.height - 1 - cache->extent.y) / CACHE_TILE_SIZE;
+    }
+  else
+    {
+      col1 = 0;
+      row1 = 0;
+      col2 = cache->n_cols - 1;
+      row2 = cache->n_rows - 1;
+    }
+
+  for (row = row1; row <= row2; row++)
+    {
+      for (col = col1; col <= col2; col++)
+        {
+          GimpBoundaryTile **tile = &cache->tiles[row * cache->n_cols + col];
+
+          g_clear_pointer (tile, gimp_boundary_tile_free);
+        }
+    }
+
+  if (! rect)
+    {
+      g_clear_pointer (&cache->tiles, g_free);
+
+      cache->format = NULL;
+      cache->n_cols = 0;
+      cache->n_rows = 0;
+    }
+}
+
+gint64
+gimp_boundary_cache_get_memsize (GimpBoundaryCache *cache)
+{
+  gint64 memsize = 0;
+  gint   i;
+
+  g_return_val_if_fail (cache != NULL, 0);
+
+  if (! cache->tiles)
+    return 0;
+
+  memsize += cache->n_cols * cache->n_rows * sizeof (GimpBoundaryTile *);
+
+  for (i = 0; i < cache->n_cols * cache->n_rows; i++)
+    {
+      GimpBoundaryTile *tile = cache->tiles[i];
+
+      if (tile)
+        {
+          memsize += sizeof (GimpBoundaryTile);
+          memsize += (tile->n_rows + 1) * sizeof (gint);
+          memsize += tile->row_offsets[tile->n_rows] * sizeof (gint);
+        }
+    }
+
+  return memsize;
+}
+
 
 /*  private functions  */
 
@@ -487,8 +697,184 @@ gimp_boundary_add_seg (GimpBoundary *boundary,
 }
 
 static void
-find_empty_segs (const GeglRectangle *region,
-                 const gfloat        *line_data,
+gimp_boundary_cache_fill (GimpBoundaryCache   *cache,
+                          GeglBuffer          *buffer,
+                          const Babl          *format,
+                          gfloat               threshold,
+                          const GeglRectangle *area)
+{
+  const GeglRectangle *extent = gegl_buffer_get_extent (buffer);
+  GeglRectangle        rect;
+  GArray              *indices;
+  gint                 col1, col2;
+  gint                 row1, row2;
+  gint                 row, col;
+
+  if (cache->format    != format    ||
+      cache->threshold != threshold ||
+      ! gegl_rectangle_equal (&cache->extent, extent))
+    {
+      gimp_boundary_cache_invalidate (cache, NULL);
+
+      cache->format    = format;
+      cache->threshold = threshold;
+      cache->extent    = *extent;
+      cache->n_cols    = (extent->width  + CACHE_TILE_SIZE - 1) /
+                         CACHE_TILE_SIZE;
+      cache->n_rows    = (extent->height + CACHE_TILE_SIZE - 1) /
+                         CACHE_TILE_SIZE;
+      cache->tiles     = g_new0 (GimpBoundaryTile *,
+                                 cache->n_cols * cache->n_rows);
+    }
+
+  if (! gegl_rectangle_intersect (&rect, area, extent))
+    return;
+
+  col1 = (rect.x - extent->x) / CACHE_TILE_SIZE;
+  row1 = (rect.y - extent->y) / CACHE_TILE_SIZE;
+  col2 = (rect.x + rect.width  - 1 - extent->x) / CACHE_TILE_SIZE;
+  row2 = (rect.y + rect.height - 1 - extent->y) / CACHE_TILE_SIZE;
+
+  indices = g_array_new (FALSE, FALSE, sizeof (gint));
+
+  for (row = row1; row <= row2; row++)
+    {
+      for (col = col1; col <= col2; col++)
+        {
+          gint index = row * cache->n_cols + col;
+
+          if (! cache->tiles[index])
+            g_array_append_val (indices, index);
+        }
+    }
+
+  if (indices->len > 0)
+    {
+      CacheFillData data;
+
+      data.cache   = cache;
+      data.buffer  = buffer;
+      data.indices = (const gint *) indices->data;
+
+      gegl_parallel_distribute_range (
+        indices->len, 1,
+        (GeglParallelDistributeRangeFunc) gimp_boundary_cache_fill_tiles,
+        &data);
+    }
+
+  g_array_free (indices, TRUE);
+}
+
+static void
+gimp_boundary_cache_fill_tiles (gint           offset,
+                                gint           size,
+                                CacheFillData *data)
+{
+  GimpBoundaryCache *cache = data->cache;
+  GArray            *runs;
+  gfloat            *tile_data;
+  gint               i;
+
+  runs      = g_array_new (FALSE, FALSE, sizeof (gint));
+  tile_data = g_new (gfloat, CACHE_TILE_SIZE * CACHE_TILE_SIZE);
+
+  for (i = offset; i < offset + size; i++)
+    {
+      gint              index = data->indices[i];
+      GimpBoundaryTile *tile;
+      GeglRectangle     rect;
+      gint              y;
+
+      rect.x      = cache->extent.x +
+                    (index % cache->n_cols) * CACHE_TILE_SIZE;
+      rect.y      = cache->extent.y +
+                    (index / cache->n_cols) * CACHE_TILE_SIZE;
+      rect.width  = CACHE_TILE_SIZE;
+      rect.height = CACHE_TILE_SIZE;
+
+      gegl_rectangle_intersect (&rect, &rect, &cache->extent);
+
+      gegl_buffer_get (data->buffer, &rect, 1.0, cache->format,
+                       tile_data, GEGL_AUTO_ROWSTRIDE,
+                       GEGL_ABYSS_NONE);
+
+      tile = g_slice_new (GimpBoundaryTile);
+
+      tile->n_rows      = rect.height;
+      tile->row_offsets = g_new (gint, rect.height + 1);
+
+      g_array_set_size (runs, 0);
+
+      for (y = 0; y < rect.height; y++)
+        {
+          const gfloat *line_data = tile_data + y * rect.width;
+          gint          x         = 0;
+
+          tile->row_offsets[y] = runs->len;
+
+          while (x < rect.width)
+            {
+              if (line_data[x] > cache->threshold)
+                {
+                  gint x1 = rect.x + x;
+                  gint x2;
+
+                  while (x < rect.width && line_data[x] > cache->threshold)
+                    x++;
+
+                  x2 = rect.x + x;
+
+                  g_array_append_val (runs, x1);
+                  g_array_append_val (runs, x2);
+                }
+              else
+                {
+                  x++;
+                }
+            }
+        }
+
+      tile->row_offsets[rect.height] = runs->len;
+
+      tile->runs = g_memdup (runs->data, runs->len * sizeof (gint));
+
+      cache->tiles[index] = tile;
+    }
+
+  g_free (tile_data);
+  g_array_free (runs, TRUE);
+}
+
+static void
+gimp_boundary_tile_free (GimpBoundaryTile *tile)
+{
+  g_free (tile->runs);
+  g_free (tile->row_offsets);
+
+  g_slice_free (GimpBoundaryTile, tile);
+}
+
+static inline void
+add_empty_seg_run (gint  empty_segs[],
+                   gint *num_empty,
+                   gint  start,
+                   gint  end)
+{
+  /*  merge runs touching across tile borders  */
+  if (*num_empty > 1 && empty_segs[*num_empty - 1] == start)
+    {
+      empty_segs[*num_empty - 1] = end;
+    }
+  else
+    {
+      empty_segs[(*num_empty)++] = start;
+      empty_segs[(*num_empty)++] = end;
+    }
+}
+
+static void
+find_empty_segs (GimpBoundaryCache   *cache,
+                 const GeglRectangle *region,
                  gint                 scanline,
                  gint                 empty_segs[],
                  gint                 max_empty,
@@ -497,15 +883,14 @@ find_empty_segs (const GeglRectangle *region,
                  gint                 x1,
                  gint                 y1,
                  gint                 x2,
-                 gint                 y2,
-                 gfloat               threshold)
+                 gint                 y2)
 {
-  gint start = 0;
-  gint end   = 0;
-  gint endx  = 0;
-  gint last  = -1;
-  gint l_num_empty;
-  gint x;
+  const GeglRectangle *extent = &cache->extent;
+  gint                 start  = 0;
+  gint                 end    = 0;
+  gint                 l_num_empty;
+  gint                 row;
+  gint                 col;
 
   *num_empty = 0;
 
@@ -527,6 +912,9 @@ find_empty_segs (const GeglRectangle *region,
 
       start = x1;
       end   = x2;
+
+      /*  no excluded area  */
+      x2 = x1;
     }
   else if (type == GIMP_BOUNDARY_IGNORE_BOUNDS)
     {
@@ -540,64 +928,57 @@ find_empty_segs (const GeglRectangle *region,
 
   l_num_empty = *num_empty;
 
-  endx = end;
-
-  line_data += start;
+  /*  everything outside the buffer extent is empty  */
+  start = MAX (start, extent->x);
+  end   = MIN (end,   extent->x + extent->width);
 
-  for (x = start; x < end;)
+  if (start < end &&
+      scanline >= extent->y && scanline < extent->y + extent->height)
     {
-      if (type == GIMP_BOUNDARY_IGNORE_BOUNDS && (endx > x1 || x < x2))
+      row = (scanline - extent->y) / CACHE_TILE_SIZE;
+
+      /*  stitch the runs of all tiles the scanline crosses  */
+      for (col = (start - extent->x) / CACHE_TILE_SIZE;
+           col <= (end - 1 - extent->x) / CACHE_TILE_SIZE;
+           col++)
         {
-          for (; x < endx; x++)
+          const GimpBoundaryTile *tile;
+          const gint             *run;
+          const gint             *last;
+          gint                    y;
+
+          tile = cache->tiles[row * cache->n_cols + col];
+          y    = scanline - extent->y - row * CACHE_TILE_SIZE;
+          run  = tile->runs + tile->row_offsets[y];
+          last = tile->runs + tile->row_offsets[y + 1];
+
+          for (; run < last; run += 2)
             {
-              gint val;
+              gint s = MAX (run[0], start);
+              gint e = MIN (run[1], end);
 
-              if (*line_data > threshold)
+              if (s >= e)
+                continue;
+
+              if (x1 < x2 && s < x2 && e > x1)
                 {
-                  if (x >= x1 && x < x2)
-                    val = -1;
-                  else
-                    val = 1;
+                  /*  cut the excluded area out of the run  */
+                  if (s < x1)
+                    add_empty_seg_run (empty_segs, &l_num_empty, s, x1);
+
+                  if (e > x2)
+                    add_empty_seg_run (empty_segs, &l_num_empty, x2, e);
                 }
               else
                 {
-                  val = -1;
+                  add_empty_seg_run (empty_segs, &l_num_empty, s, e);
                 }
-
-              line_data++;
-
-              if (last != val)
-                empty_segs[l_num_empty++] = x;
-
-              last = val;
-            }
-        }
-      else
-        {
-          for (; x < endx; x++)
-            {
-              gint val;
-
-              if (*line_data > threshold)
-                val = 1;
-              else
-                val = -1;
-
-              line_data++;
-
-              if (last != val)
-                empty_segs[l_num_empty++] = x;
-
-              last = val;
             }
         }
     }
 
   *num_empty = l_num_empty;
 
-  if (last > 0)
-    empty_segs[(*num_empty)++] = x;
-
   empty_segs[(*num_empty)++] = G_MAXINT;
 }
 
@@ -664,7 +1045,8 @@ make_horiz_segs (GimpBoundary *boundary,
 }
 
 static GimpBoundary *
-generate_boundary (GeglBuffer          *buffer,
+generate_boundary (GimpBoundaryCache   *cache,
+                   GeglBuffer          *buffer,
                    const GeglRectangle *region,
                    const Babl          *format,
                    GimpBoundaryType     type,
@@ -675,8 +1057,7 @@ generate_boundary (GeglBuffer          *buffer,
                    gfloat               threshold)
 {
   GimpBoundary  *boundary;
-  GeglRectangle  line_rect = { 0, };
-  gfloat        *line_data;
+  GeglRectangle  area = { 0, };
   gint           scanline;
   gint           i;
   gint           start, end;
@@ -688,11 +1069,6 @@ generate_boundary (GeglBuffer          *buffer,
 
   boundary = gimp_boundary_new (region);
 
-  line_rect.width  = gegl_buffer_get_width (buffer);
-  line_rect.height = 1;
-
-  line_data = g_alloca (sizeof (gfloat) * line_rect.width);
-
   start = 0;
   end   = 0;
 
@@ -700,47 +1076,39 @@ generate_boundary (GeglBuffer          *buffer,
     {
       start = y1;
       end   = y2;
+
+      gegl_rectangle_set (&area, x1, y1, x2 - x1, y2 - y1);
     }
   else if (type == GIMP_BOUNDARY_IGNORE_BOUNDS)
     {
       start = region->y;
       end   = region->y + region->height;
+
+      area = *region;
     }
 
+  /*  Make sure the pixel runs of all tiles we are going to look at
+   *  are known, computing the missing ones in parallel
+   */
+  gimp_boundary_cache_fill (cache, buffer, format, threshold, &area);
+
   /*  Find the empty segments for the previous and current scanlines  */
-  find_empty_segs (region, NULL,
+  find_empty_segs (cache, region,
                    start - 1, boundary->empty_segs_l,
                    boundary->max_empty_segs, &num_empty_l,
-                   type, x1, y1, x2, y2,
-                   threshold);
-
-  line_rect.y = start;
-  gegl_buffer_get (buffer, &line_rect, 1.0, format,
-                   line_data, GEGL_AUTO_ROWSTRIDE,
-                   GEGL_ABYSS_NONE);
-
-  find_empty_segs (region, line_data,
+                   type, x1, y1, x2, y2);
+  find_empty_segs (cache, region,
                    start, boundary->empty_segs_c,
                    boundary->max_empty_segs, &num_empty_c,
-                   type, x1, y1, x2, y2,
-                   threshold);
+                   type, x1, y1, x2, y2);
 
   for (scanline = start; scanline < end; scanline++)
     {
       /*  find the empty segment list for the next scanline  */
-      line_rect.y = scanline + 1;
-      if (scanline + 1 == end)
-        line_data = NULL;
-      else
-        gegl_buffer_get (buffer, &line_rect, 1.0, format,
-                         line_data, GEGL_AUTO_ROWSTRIDE,
-                         GEGL_ABYSS_NONE);
-
-      find_empty_segs (region, line_data,
+      find_empty_segs (cache, region,
                        scanline + 1, boundary->empty_segs_n,
                        boundary->max_empty_segs, &num_empty_n,
-                       type, x1, y1, x2, y2,
-                       threshold);
+                       type, x1, y1, x2, y2);
 
       /*  process the segments on the current scanline  */
       for (i = 1; i < num_empty_c - 1; i += 2)
@@ -526,6 +526,72 @@ gimp_brush_load_abr (GimpContext   *context,
 }
 
 
+/**
+ * gimp_brush_load_mask:
+ * @file:   a GIMP brush file
+ * @pixmap: return location for the brush's pixmap, or %NULL
+ * @error:  return location for errors
+ *
+ * Loads only the pixels of the brush in @file.  *@pixmap is set to
+ * %NULL if the brush has no pixmap.
+ *
+ * Returns: the brush's mask, or %NULL on error.
+ **/
+GimpTempBuf *
+gimp_brush_load_mask (GFile        *file,
+                      GimpTempBuf **pixmap,
+                      GError      **error)
+{
+  GInputStream *input;
+  GimpBrush    *brush;
+  GimpTempBuf  *mask = NULL;
+
+  g_return_val_if_fail (G_IS_FILE (file), NULL);
+  g_return_val_if_fail (pixmap != NULL, NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  *pixmap = NULL;
+
+  input = G_INPUT_STREAM (g_file_read (file, NULL, error));
+
+  if (! input)
+    {
+      g_prefix_error (error,
+                      _("Could not open '%s' for reading: "),
+                      gimp_file_get_utf8_name (file));
+      return NULL;
+    }
+
+  brush = gimp_brush_load_brush (NULL, file, input, error);
+
+  g_object_unref (input);
+
+  if (brush)
+    {
+      mask = gimp_temp_buf_ref (brush->priv->mask);
+
+      if (brush->priv->pixmap)
+        *pixmap = gimp_temp_buf_ref (brush->priv->pixmap);
+
+      g_object_unref (brush);
+    }
+  else if (error && ! *error)
+    {
+      g_set_error (error, GIMP_DATA_ERROR, GIMP_DATA_ERROR_READ,
+                   _("Error loading '%s'"),
+                   gimp_file_get_utf8_name (file));
+    }
+  else
+    {
+      g_prefix_error (error,
+                      _("Error loading '%s': "),
+                      gimp_file_get_utf8_name (file));
+    }
+
+  return mask;
+}
+
+
 /*  private functions  */
 
 static GList *
@@ -25,19 +25,23 @@
 #define GIMP_BRUSH_PSP_FILE_EXTENSION    ".jbr"
 
 
-GList     * gimp_brush_load        (GimpContext   *context,
-                                    GFile         *file,
-                                    GInputStream  *input,
-                                    GError       **error);
-GimpBrush * gimp_brush_load_brush  (GimpContext   *context,
-                                    GFile         *file,
-                                    GInputStream  *input,
-                                    GError       **error);
-
-GList     * gimp_brush_load_abr    (GimpContext   *context,
-                                    GFile         *file,
-                                    GInputStream  *input,
-                                    GError       **error);
+GList       * gimp_brush_load        (GimpContext   *context,
+                                      GFile         *file,
+                                      GInputStream  *input,
+                                      GError       **error);
+GimpBrush   * gimp_brush_load_brush  (GimpContext   *context,
+                                      GFile         *file,
+                                      GInputStream  *input,
+                                      GError       **error);
+
+GList       * gimp_brush_load_abr    (GimpContext   *context,
+                                      GFile         *file,
+                                      GInputStream  *input,
+                                      GError       **error);
+
+GimpTempBuf * gimp_brush_load_mask   (GFile         *file,
+                                      GimpTempBuf  **pixmap,
+                                      GError       **error);
 
 
 #endif /* __GIMP_BRUSH_LOAD_H__ */
@@ -36,6 +36,14 @@ struct _GimpBrushPrivate
   GimpBrushCache *mask_cache;
   GimpBrushCache *pixmap_cache;
   GimpBrushCache *boundary_cache;
+
+  /*  what the data index knows about the brush, until the mask is
+   *  loaded on first use, see gimp_brush_new_from_index()
+   */
+  gint            index_width;
+  gint            index_height;
+  gchar          *index_checksum;
+  GimpTempBuf    *index_preview;
 };
 
 
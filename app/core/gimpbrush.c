@@ -36,6 +36,7 @@
 #include "gimpbrushcache.h"
 #include "gimpbrushgenerated.h"
 #include "gimpbrushpipe.h"
+#include "gimpdataindex.h"
 #include "gimpmarshal.h"
 #include "gimptagged.h"
 #include "gimptempbuf.h"
@@ -43,6 +44,13 @@
 #include "gimp-intl.h"
 
 
+/*  serializes loading the masks of brushes created from the index,
+ *  and protects their index_checksum and index_preview, which are
+ *  freed once the mask is loaded
+ */
+G_LOCK_DEFINE_STATIC (brush_mask);
+
+
 enum
 {
   SPACING_CHANGED,
@@ -86,6 +94,9 @@ static const gchar * gimp_brush_get_extension         (GimpData             *dat
 static void          gimp_brush_copy                  (GimpData             *data,
                                                        GimpData             *src_data);
 
+static gsize         gimp_brush_bezier_desc_get_memsize
+                                                      (const GimpBezierDesc *desc);
+
 static void          gimp_brush_real_begin_use        (GimpBrush            *brush);
 static void          gimp_brush_real_end_use          (GimpBrush            *brush);
 static GimpBrush   * gimp_brush_real_select_brush     (GimpBrush            *brush,
@@ -97,6 +108,11 @@ static gboolean      gimp_brush_real_want_null_motion (GimpBrush            *bru
 
 static gchar       * gimp_brush_get_checksum          (GimpTagged           *tagged);
 
+static GimpTempBuf * gimp_brush_get_index_preview     (GimpBrush            *brush,
+                                                       gint                  width,
+                                                       gint                  height);
+static GimpTempBuf * gimp_brush_load_index_mask       (GimpBrush            *brush);
+
 
 G_DEFINE_TYPE_WITH_CODE (GimpBrush, gimp_brush, GIMP_TYPE_DATA,
                          G_ADD_PRIVATE (GimpBrush)
@@ -193,6 +209,9 @@ gimp_brush_finalize (GObject *object)
   g_clear_object (&brush->priv->pixmap_cache);
   g_clear_object (&brush->priv->boundary_cache);
 
+  g_clear_pointer (&brush->priv->index_checksum, g_free);
+  g_clear_pointer (&brush->priv->index_preview,  gimp_temp_buf_unref);
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -243,8 +262,13 @@ gimp_brush_get_memsize (GimpObject *object,
   GimpBrush *brush   = GIMP_BRUSH (object);
   gint64     memsize = 0;
 
+  G_LOCK (brush_mask);
+
   memsize += gimp_temp_buf_get_memsize (brush->priv->mask);
   memsize += gimp_temp_buf_get_memsize (brush->priv->pixmap);
+  memsize += gimp_temp_buf_get_memsize (brush->priv->index_preview);
+
+  G_UNLOCK (brush_mask);
 
   return memsize + GIMP_OBJECT_CLASS (parent_class)->get_memsize (object,
                                                                   gui_size);
@@ -257,8 +281,20 @@ gimp_brush_get_size (GimpViewable *viewable,
 {
   GimpBrush *brush = GIMP_BRUSH (viewable);
 
-  *width  = gimp_temp_buf_get_width  (brush->priv->mask);
-  *height = gimp_temp_buf_get_height (brush->priv->mask);
+  G_LOCK (brush_mask);
+
+  if (brush->priv->mask)
+    {
+      *width  = gimp_temp_buf_get_width  (brush->priv->mask);
+      *height = gimp_temp_buf_get_height (brush->priv->mask);
+    }
+  else
+    {
+      *width  = brush->priv->index_width;
+      *height = brush->priv->index_height;
+    }
+
+  G_UNLOCK (brush_mask);
 
   return TRUE;
 }
@@ -270,8 +306,8 @@ gimp_brush_get_new_preview (GimpViewable *viewable,
                             gint          height)
 {
   GimpBrush         *brush       = GIMP_BRUSH (viewable);
-  const GimpTempBuf *mask_buf    = brush->priv->mask;
-  const GimpTempBuf *pixmap_buf  = brush->priv->pixmap;
+  const GimpTempBuf *mask_buf;
+  const GimpTempBuf *pixmap_buf;
   GimpTempBuf       *return_buf  = NULL;
   gint               mask_width;
   gint               mask_height;
@@ -281,6 +317,15 @@ gimp_brush_get_new_preview (GimpViewable *viewable,
   gint               x, y;
   gboolean           scaled = FALSE;
 
+  /*  don't load the whole brush while the one from the index will do  */
+  return_buf = gimp_brush_get_index_preview (brush, width, height);
+
+  if (return_buf)
+    return return_buf;
+
+  mask_buf   = gimp_brush_load_index_mask (brush);
+  pixmap_buf = brush->priv->pixmap;
+
   mask_width  = gimp_temp_buf_get_width  (mask_buf);
   mask_height = gimp_temp_buf_get_height (mask_buf);
 
@@ -389,11 +434,14 @@ gimp_brush_get_description (GimpViewable  *viewable,
                             gchar        **tooltip)
 {
   GimpBrush *brush = GIMP_BRUSH (viewable);
+  gint       width;
+  gint       height;
+
+  gimp_brush_get_size (viewable, &width, &height);
 
   return g_strdup_printf ("%s (%d × %d)",
                           gimp_object_get_name (brush),
-                          gimp_temp_buf_get_width  (brush->priv->mask),
-                          gimp_temp_buf_get_height (brush->priv->mask));
+                          width, height);
 }
 
 static void
@@ -426,12 +474,15 @@ static void
 gimp_brush_copy (GimpData *data,
                  GimpData *src_data)
 {
-  GimpBrush *brush     = GIMP_BRUSH (data);
-  GimpBrush *src_brush = GIMP_BRUSH (src_data);
+  GimpBrush   *brush     = GIMP_BRUSH (data);
+  GimpBrush   *src_brush = GIMP_BRUSH (src_data);
+  GimpTempBuf *src_mask;
+
+  src_mask = gimp_brush_load_index_mask (src_brush);
 
   g_clear_pointer (&brush->priv->mask, gimp_temp_buf_unref);
-  if (src_brush->priv->mask)
-    brush->priv->mask = gimp_temp_buf_copy (src_brush->priv->mask);
+  if (src_mask)
+    brush->priv->mask = gimp_temp_buf_copy (src_mask);
 
   g_clear_pointer (&brush->priv->pixmap, gimp_temp_buf_unref);
   if (src_brush->priv->pixmap)
@@ -444,17 +495,29 @@ gimp_brush_copy (GimpData *data,
   gimp_data_dirty (data);
 }
 
+static gsize
+gimp_brush_bezier_desc_get_memsize (const GimpBezierDesc *desc)
+{
+  return sizeof (GimpBezierDesc) + desc->num_data * sizeof (cairo_path_data_t);
+}
+
 static void
 gimp_brush_real_begin_use (GimpBrush *brush)
 {
   brush->priv->mask_cache =
-    gimp_brush_cache_new ((GDestroyNotify) gimp_temp_buf_unref, 'M', 'm');
+    gimp_brush_cache_new ((GDestroyNotify) gimp_temp_buf_unref,
+                          (GimpBrushCacheSizeFunc) gimp_temp_buf_get_memsize,
+                          'M', 'm');
 
   brush->priv->pixmap_cache =
-    gimp_brush_cache_new ((GDestroyNotify) gimp_temp_buf_unref, 'P', 'p');
+    gimp_brush_cache_new ((GDestroyNotify) gimp_temp_buf_unref,
+                          (GimpBrushCacheSizeFunc) gimp_temp_buf_get_memsize,
+                          'P', 'p');
 
   brush->priv->boundary_cache =
-    gimp_brush_cache_new ((GDestroyNotify) gimp_bezier_desc_free, 'B', 'b');
+    gimp_brush_cache_new ((GDestroyNotify) gimp_bezier_desc_free,
+                          (GimpBrushCacheSizeFunc) gimp_brush_bezier_desc_get_memsize,
+                          'B', 'b');
 }
 
 static void
@@ -487,16 +550,32 @@ gimp_brush_real_want_null_motion (GimpBrush        *brush,
 static gchar *
 gimp_brush_get_checksum (GimpTagged *tagged)
 {
-  GimpBrush *brush           = GIMP_BRUSH (tagged);
-  gchar     *checksum_string = NULL;
+  GimpBrush   *brush           = GIMP_BRUSH (tagged);
+  GimpTempBuf *mask;
+  gchar       *checksum_string = NULL;
 
-  if (brush->priv->mask)
+  /*  the tag cache asks for the checksum of all brushes, don't load
+   *  them just for that
+   */
+  G_LOCK (brush_mask);
+
+  if (! brush->priv->mask)
+    checksum_string = g_strdup (brush->priv->index_checksum);
+
+  G_UNLOCK (brush_mask);
+
+  if (checksum_string)
+    return checksum_string;
+
+  mask = g_atomic_pointer_get (&brush->priv->mask);
+
+  if (mask)
     {
       GChecksum *checksum = g_checksum_new (G_CHECKSUM_MD5);
 
       g_checksum_update (checksum,
-                         gimp_temp_buf_get_data (brush->priv->mask),
-                         gimp_temp_buf_get_data_size (brush->priv->mask));
+                         gimp_temp_buf_get_data (mask),
+                         gimp_temp_buf_get_data_size (mask));
       if (brush->priv->pixmap)
         g_checksum_update (checksum,
                            gimp_temp_buf_get_data (brush->priv->pixmap),
@@ -551,6 +630,95 @@ gimp_brush_get_standard (GimpContext *context)
   return standard_brush;
 }
 
+/**
+ * gimp_brush_new_from_index:
+ * @context: a #GimpContext
+ * @entry:   the brush's entry in the data index
+ *
+ * Creates a GIMP brush from what the data index knows about it,
+ * without reading its file.  The brush's pixels are loaded from the
+ * file set with gimp_data_set_file() the first time they are needed.
+ *
+ * Returns: a new #GimpBrush
+ **/
+GimpData *
+gimp_brush_new_from_index (GimpContext              *context,
+                           const GimpDataIndexEntry *entry)
+{
+  GimpBrush *brush;
+
+  g_return_val_if_fail (entry != NULL, NULL);
+  g_return_val_if_fail (entry->name != NULL, NULL);
+
+  if (entry->width < 1 || entry->height < 1 || entry->spacing < 1)
+    return NULL;
+
+  brush = g_object_new (GIMP_TYPE_BRUSH,
+                        "name",      entry->name,
+                        "mime-type", "image/x-gimp-gbr",
+                        NULL);
+
+  brush->priv->spacing  = entry->spacing;
+  brush->priv->x_axis.x = entry->width  / 2.0;
+  brush->priv->x_axis.y = 0.0;
+  brush->priv->y_axis.x = 0.0;
+  brush->priv->y_axis.y = entry->height / 2.0;
+
+  brush->priv->index_width    = entry->width;
+  brush->priv->index_height   = entry->height;
+  brush->priv->index_checksum = g_strdup (entry->checksum);
+
+  if (entry->preview)
+    brush->priv->index_preview = gimp_temp_buf_ref (entry->preview);
+
+  return GIMP_DATA (brush);
+}
+
+/**
+ * gimp_brush_fill_index_entry:
+ * @data:  a #GimpBrush
+ * @entry: a data index entry
+ *
+ * Stores what gimp_brush_new_from_index() needs to recreate @data in
+ * @entry.  Only plain GIMP brushes can be indexed, all other kinds of
+ * brushes are rejected.
+ *
+ * Returns: %TRUE on success.
+ **/
+gboolean
+gimp_brush_fill_index_entry (GimpData           *data,
+                             GimpDataIndexEntry *entry)
+{
+  GimpBrush *brush;
+
+  g_return_val_if_fail (GIMP_IS_BRUSH (data), FALSE);
+  g_return_val_if_fail (entry != NULL, FALSE);
+
+  brush = GIMP_BRUSH (data);
+
+  if (G_OBJECT_TYPE (brush) != GIMP_TYPE_BRUSH ||
+      g_strcmp0 (gimp_data_get_mime_type (data), "image/x-gimp-gbr") ||
+      ! brush->priv->mask)
+    {
+      return FALSE;
+    }
+
+  gimp_brush_get_size (GIMP_VIEWABLE (brush), &entry->width, &entry->height);
+
+  entry->spacing = brush->priv->spacing;
+
+  g_free (entry->checksum);
+  entry->checksum = gimp_brush_get_checksum (GIMP_TAGGED (brush));
+
+  g_clear_pointer (&entry->preview, gimp_temp_buf_unref);
+  entry->preview = gimp_brush_get_new_preview (GIMP_VIEWABLE (brush),
+                                               NULL,
+                                               GIMP_DATA_INDEX_PREVIEW_SIZE,
+                                               GIMP_DATA_INDEX_PREVIEW_SIZE);
+
+  return TRUE;
+}
+
 void
 gimp_brush_begin_use (GimpBrush *brush)
 {
@@ -616,12 +784,16 @@ gimp_brush_transform_size (GimpBrush     *brush,
   g_return_if_fail (width != NULL);
   g_return_if_fail (height != NULL);
 
+  gimp_brush_cache_quantize (&scale, &aspect_ratio, &angle, NULL);
+
   if (scale             == 1.0 &&
       aspect_ratio      == 0.0 &&
       fmod (angle, 0.5) == 0.0)
     {
-      *width  = gimp_temp_buf_get_width  (brush->priv->mask);
-      *height = gimp_temp_buf_get_height (brush->priv->mask);
+      const GimpTempBuf *mask = gimp_brush_load_index_mask (brush);
+
+      *width  = gimp_temp_buf_get_width  (mask);
+      *height = gimp_temp_buf_get_height (mask);
 
       return;
     }
@@ -647,6 +819,9 @@ gimp_brush_transform_mask (GimpBrush *brush,
   g_return_val_if_fail (GIMP_IS_BRUSH (brush), NULL);
   g_return_val_if_fail (scale > 0.0, NULL);
 
+  gimp_brush_cache_quantize (&scale, &aspect_ratio, &angle, &hardness);
+  effective_hardness = hardness;
+
   gimp_brush_transform_size (brush,
                              scale, aspect_ratio, angle, reflect,
                              &width, &height);
@@ -712,9 +887,12 @@ gimp_brush_transform_pixmap (GimpBrush *brush,
   gdouble            effective_hardness = hardness;
 
   g_return_val_if_fail (GIMP_IS_BRUSH (brush), NULL);
-  g_return_val_if_fail (brush->priv->pixmap != NULL, NULL);
+  g_return_val_if_fail (gimp_brush_get_pixmap (brush) != NULL, NULL);
   g_return_val_if_fail (scale > 0.0, NULL);
 
+  gimp_brush_cache_quantize (&scale, &aspect_ratio, &angle, &hardness);
+  effective_hardness = hardness;
+
   gimp_brush_transform_size (brush,
                              scale, aspect_ratio, angle, reflect,
                              &width, &height);
@@ -778,6 +956,8 @@ gimp_brush_transform_boundary (GimpBrush *brush,
   g_return_val_if_fail (width != NULL, NULL);
   g_return_val_if_fail (height != NULL, NULL);
 
+  gimp_brush_cache_quantize (&scale, &aspect_ratio, &angle, &hardness);
+
   gimp_brush_transform_size (brush,
                              scale, aspect_ratio, angle, reflect,
                              width, height);
@@ -823,7 +1003,7 @@ gimp_brush_get_mask (GimpBrush *brush)
     {
       return brush->priv->blurred_mask;
     }
-  return brush->priv->mask;
+  return gimp_brush_load_index_mask (brush);
 }
 
 GimpTempBuf *
@@ -836,6 +1016,10 @@ gimp_brush_get_pixmap (GimpBrush *brush)
     {
       return brush->priv->blurred_pixmap;
     }
+
+  /*  the pixmap is loaded together with the mask  */
+  gimp_brush_load_index_mask (brush);
+
   return brush->priv->pixmap;
 }
 
@@ -876,7 +1060,7 @@ gimp_brush_get_width (GimpBrush *brush)
   if (brush->priv->blurred_pixmap)
     return gimp_temp_buf_get_width (brush->priv->blurred_pixmap);
 
-  return gimp_temp_buf_get_width (brush->priv->mask);
+  return gimp_temp_buf_get_width (gimp_brush_load_index_mask (brush));
 }
 
 gint
@@ -890,7 +1074,7 @@ gimp_brush_get_height (GimpBrush *brush)
   if (brush->priv->blurred_pixmap)
     return gimp_temp_buf_get_height (brush->priv->blurred_pixmap);
 
-  return gimp_temp_buf_get_height (brush->priv->mask);
+  return gimp_temp_buf_get_height (gimp_brush_load_index_mask (brush));
 }
 
 gint
@@ -933,3 +1117,126 @@ gimp_brush_get_y_axis (GimpBrush *brush)
 
   return brush->priv->y_axis;
 }
+
+
+/*  private functions  */
+
+/*  returns a copy of the preview from the data index, scaled down to
+ *  what gimp_brush_get_new_preview() would return, as long as the
+ *  brush isn't loaded yet and the index preview is large enough
+ */
+static GimpTempBuf *
+gimp_brush_get_index_preview (GimpBrush *brush,
+                              gint       width,
+                              gint       height)
+{
+  GimpTempBuf *preview = NULL;
+  gint         preview_width;
+  gint         preview_height;
+
+  G_LOCK (brush_mask);
+
+  if (! brush->priv->mask && brush->priv->index_preview)
+    preview = gimp_temp_buf_ref (brush->priv->index_preview);
+
+  preview_width  = brush->priv->index_width;
+  preview_height = brush->priv->index_height;
+
+  G_UNLOCK (brush_mask);
+
+  if (! preview)
+    return NULL;
+
+  if (preview_width > width || preview_height > height)
+    {
+      gdouble scale = MIN ((gdouble) width  / (gdouble) preview_width,
+                           (gdouble) height / (gdouble) preview_height);
+
+      preview_width  = MAX (1, RINT (preview_width  * scale));
+      preview_height = MAX (1, RINT (preview_height * scale));
+    }
+
+  if (preview_width  > gimp_temp_buf_get_width  (preview) ||
+      preview_height > gimp_temp_buf_get_height (preview))
+    {
+      gimp_temp_buf_unref (preview);
+
+      return NULL;
+    }
+
+  if (preview_width  == gimp_temp_buf_get_width  (preview) &&
+      preview_height == gimp_temp_buf_get_height (preview))
+    {
+      GimpTempBuf *copy = gimp_temp_buf_copy (preview);
+
+      gimp_temp_buf_unref (preview);
+
+      return copy;
+    }
+  else
+    {
+      GimpTempBuf *scaled = gimp_temp_buf_scale (preview,
+                                                 preview_width,
+                                                 preview_height);
+
+      gimp_temp_buf_unref (preview);
+
+      return scaled;
+    }
+}
+
+/*  returns the brush's mask, loading it, and the pixmap, from the
+ *  brush's file if the brush was created from the data index
+ */
+static GimpTempBuf *
+gimp_brush_load_index_mask (GimpBrush *brush)
+{
+  GimpTempBuf *mask = g_atomic_pointer_get (&brush->priv->mask);
+
+  /*  index_width never changes, and is only set for indexed brushes  */
+  if (G_LIKELY (mask || ! brush->priv->index_width))
+    return mask;
+
+  G_LOCK (brush_mask);
+
+  mask = brush->priv->mask;
+
+  if (! mask)
+    {
+      GFile       *file   = gimp_data_get_file (GIMP_DATA (brush));
+      GimpTempBuf *pixmap = NULL;
+      GError      *error  = NULL;
+
+      if (file)
+        mask = gimp_brush_load_mask (file, &pixmap, &error);
+
+      if (! mask)
+        {
+          if (error)
+            {
+              g_printerr ("%s\n", error->message);
+              g_clear_error (&error);
+            }
+
+          /*  keep the promised size, and don't retry every time  */
+          mask = gimp_temp_buf_new (brush->priv->index_width,
+                                    brush->priv->index_height,
+                                    babl_format ("Y u8"));
+          gimp_temp_buf_data_clear (mask);
+        }
+
+      brush->priv->pixmap = pixmap;
+
+      g_clear_pointer (&brush->priv->index_checksum, g_free);
+      g_clear_pointer (&brush->priv->index_preview,  gimp_temp_buf_unref);
+
+      /*  publish the mask only once the pixmap is set, since readers
+       *  don't take the lock once the mask is set
+       */
+      g_atomic_pointer_set (&brush->priv->mask, mask);
+    }
+
+  G_UNLOCK (brush_mask);
+
+  return mask;
+}
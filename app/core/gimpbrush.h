@@ -92,6 +92,11 @@ GimpData             * gimp_brush_new                (GimpContext      *context,
                                                       const gchar      *name);
 GimpData             * gimp_brush_get_standard       (GimpContext      *context);
 
+GimpData             * gimp_brush_new_from_index     (GimpContext              *context,
+                                                      const GimpDataIndexEntry *entry);
+gboolean               gimp_brush_fill_index_entry   (GimpData                 *data,
+                                                      GimpDataIndexEntry       *entry);
+
 void                   gimp_brush_begin_use          (GimpBrush        *brush);
 void                   gimp_brush_end_use            (GimpBrush        *brush);
 
@@ -22,21 +22,30 @@
 
 #include <gegl.h>
 
+#include "libgimpmath/gimpmath.h"
+
 #include "core-types.h"
 
+#include "config/gimpcoreconfig.h"
+
+#include "gimp.h"
 #include "gimpbrushcache.h"
 
 #include "gimp-log.h"
 #include "gimp-intl.h"
 
 
-#define MAX_CACHED_DATA 20
+/*  the aspect ratio scales one axis of the brush by
+ *  1 - |aspect_ratio| / ASPECT_RATIO_RANGE, see gimp_brush_transform_matrix()
+ */
+#define ASPECT_RATIO_RANGE 20.0
 
 
 enum
 {
   PROP_0,
-  PROP_DATA_DESTROY
+  PROP_DATA_DESTROY,
+  PROP_DATA_SIZE
 };
 
 
@@ -44,28 +53,44 @@ typedef struct _GimpBrushCacheUnit GimpBrushCacheUnit;
 
 struct _GimpBrushCacheUnit
 {
-  gpointer data;
-
-  gint     width;
-  gint     height;
-  gdouble  scale;
-  gdouble  aspect_ratio;
-  gdouble  angle;
-  gboolean reflect;
-  gdouble  hardness;
+  GimpBrushCache *cache;
+  GList           link;
+  gint            ref_count;
+
+  gpointer        data;
+  gsize           size;
+
+  gint            width;
+  gint            height;
+  gdouble         scale;
+  gdouble         aspect_ratio;
+  gdouble         angle;
+  gboolean        reflect;
+  gdouble         hardness;
 };
 
 
-static void   gimp_brush_cache_constructed  (GObject      *object);
-static void   gimp_brush_cache_finalize     (GObject      *object);
-static void   gimp_brush_cache_set_property (GObject      *object,
-                                             guint         property_id,
-                                             const GValue *value,
-                                             GParamSpec   *pspec);
-static void   gimp_brush_cache_get_property (GObject      *object,
-                                             guint         property_id,
-                                             GValue       *value,
-                                             GParamSpec   *pspec);
+static void       gimp_brush_cache_constructed    (GObject             *object);
+static void       gimp_brush_cache_finalize       (GObject             *object);
+static void       gimp_brush_cache_set_property   (GObject             *object,
+                                                   guint                property_id,
+                                                   const GValue        *value,
+                                                   GParamSpec          *pspec);
+static void       gimp_brush_cache_get_property   (GObject             *object,
+                                                   guint                property_id,
+                                                   GValue              *value,
+                                                   GParamSpec          *pspec);
+
+static void       gimp_brush_cache_notify_config  (GimpCoreConfig      *config);
+
+static guint      gimp_brush_cache_unit_hash      (GimpBrushCacheUnit  *unit);
+static gboolean   gimp_brush_cache_unit_equal     (GimpBrushCacheUnit  *unit1,
+                                                   GimpBrushCacheUnit  *unit2);
+static void       gimp_brush_cache_unit_unref     (GimpBrushCacheUnit  *unit);
+static void       gimp_brush_cache_unit_remove    (GimpBrushCacheUnit  *unit);
+static void       gimp_brush_cache_unit_pin       (GimpBrushCacheUnit  *unit);
+
+static void       gimp_brush_cache_trim           (void);
 
 
 G_DEFINE_TYPE (GimpBrushCache, gimp_brush_cache, GIMP_TYPE_OBJECT)
@@ -73,6 +98,19 @@ G_DEFINE_TYPE (GimpBrushCache, gimp_brush_cache, GIMP_TYPE_OBJECT)
 #define parent_class gimp_brush_cache_parent_class
 
 
+/*  all caches share a single LRU list and memory budget, protected by the
+ *  mutex, since brushes are transformed on the paint thread as well as on
+ *  the main thread.
+ */
+static GMutex   gimp_brush_cache_mutex;
+static GQueue   gimp_brush_cache_lru        = G_QUEUE_INIT;
+static guint64  gimp_brush_cache_total_size = 0;
+static guint64  gimp_brush_cache_max_size   = 1 << 26;
+static gdouble  gimp_brush_cache_tolerance  = 0.0;
+static gint     gimp_brush_cache_hits       = 0;
+static gint     gimp_brush_cache_misses     = 0;
+
+
 static void
 gimp_brush_cache_class_init (GimpBrushCacheClass *klass)
 {
@@ -88,11 +126,28 @@ gimp_brush_cache_class_init (GimpBrushCacheClass *klass)
                                                          NULL, NULL,
                                                          GIMP_PARAM_READWRITE |
                                                          G_PARAM_CONSTRUCT_ONLY));
+
+  g_object_class_install_property (object_class, PROP_DATA_SIZE,
+                                   g_param_spec_pointer ("data-size",
+                                                         NULL, NULL,
+                                                         GIMP_PARAM_READWRITE |
+                                                         G_PARAM_CONSTRUCT_ONLY));
 }
 
 static void
-gimp_brush_cache_init (GimpBrushCache *brush)
+gimp_brush_cache_init (GimpBrushCache *cache)
 {
+  cache->units = g_hash_table_new_full (
+    (GHashFunc)      gimp_brush_cache_unit_hash,
+    (GEqualFunc)     gimp_brush_cache_unit_equal,
+    (GDestroyNotify) gimp_brush_cache_unit_remove,
+    NULL);
+
+  cache->pins = g_hash_table_new_full (
+    g_direct_hash,
+    g_direct_equal,
+    NULL,
+    (GDestroyNotify) gimp_brush_cache_unit_unref);
 }
 
 static void
@@ -103,6 +158,7 @@ gimp_brush_cache_constructed (GObject *object)
   G_OBJECT_CLASS (parent_class)->constructed (object);
 
   gimp_assert (cache->data_destroy != NULL);
+  gimp_assert (cache->data_size != NULL);
 }
 
 static void
@@ -110,7 +166,12 @@ gimp_brush_cache_finalize (GObject *object)
 {
   GimpBrushCache *cache = GIMP_BRUSH_CACHE (object);
 
-  gimp_brush_cache_clear (cache);
+  g_mutex_lock (&gimp_brush_cache_mutex);
+
+  g_clear_pointer (&cache->units, g_hash_table_unref);
+  g_clear_pointer (&cache->pins,  g_hash_table_unref);
+
+  g_mutex_unlock (&gimp_brush_cache_mutex);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -128,6 +189,9 @@ gimp_brush_cache_set_property (GObject      *object,
     case PROP_DATA_DESTROY:
       cache->data_destroy = g_value_get_pointer (value);
       break;
+    case PROP_DATA_SIZE:
+      cache->data_size = g_value_get_pointer (value);
+      break;
 
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -148,6 +212,9 @@ gimp_brush_cache_get_property (GObject    *object,
     case PROP_DATA_DESTROY:
       g_value_set_pointer (value, cache->data_destroy);
       break;
+    case PROP_DATA_SIZE:
+      g_value_set_pointer (value, cache->data_size);
+      break;
 
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -155,20 +222,157 @@ gimp_brush_cache_get_property (GObject    *object,
     }
 }
 
+static void
+gimp_brush_cache_notify_config (GimpCoreConfig *config)
+{
+  g_mutex_lock (&gimp_brush_cache_mutex);
+
+  gimp_brush_cache_max_size  = config->brush_cache_size;
+  gimp_brush_cache_tolerance = config->brush_cache_tolerance;
+
+  gimp_brush_cache_trim ();
+
+  g_mutex_unlock (&gimp_brush_cache_mutex);
+}
+
+static guint
+gimp_brush_cache_unit_hash (GimpBrushCacheUnit *unit)
+{
+  /*  adding 0.0 turns -0.0 into 0.0, which compares equal to it  */
+  gdouble scale        = unit->scale        + 0.0;
+  gdouble aspect_ratio = unit->aspect_ratio + 0.0;
+  gdouble angle        = unit->angle        + 0.0;
+  gdouble hardness     = unit->hardness     + 0.0;
+  guint   hash;
+
+  hash = unit->width;
+  hash = hash * 31 + unit->height;
+  hash = hash * 31 + g_double_hash (&scale);
+  hash = hash * 31 + g_double_hash (&aspect_ratio);
+  hash = hash * 31 + g_double_hash (&angle);
+  hash = hash * 31 + g_double_hash (&hardness);
+  hash = hash * 31 + (unit->reflect ? 1 : 0);
+
+  return hash;
+}
+
+static gboolean
+gimp_brush_cache_unit_equal (GimpBrushCacheUnit *unit1,
+                             GimpBrushCacheUnit *unit2)
+{
+  return unit1->width        == unit2->width        &&
+         unit1->height       == unit2->height       &&
+         unit1->scale        == unit2->scale        &&
+         unit1->aspect_ratio == unit2->aspect_ratio &&
+         unit1->angle        == unit2->angle        &&
+         ! unit1->reflect    == ! unit2->reflect    &&
+         unit1->hardness     == unit2->hardness;
+}
+
+static void
+gimp_brush_cache_unit_unref (GimpBrushCacheUnit *unit)
+{
+  if (--unit->ref_count == 0)
+    {
+      unit->cache->data_destroy (unit->data);
+
+      g_slice_free (GimpBrushCacheUnit, unit);
+    }
+}
+
+/*  called when a unit leaves the cache's hash table.  the unit stays
+ *  alive as long as it's pinned by some thread.
+ */
+static void
+gimp_brush_cache_unit_remove (GimpBrushCacheUnit *unit)
+{
+  g_queue_unlink (&gimp_brush_cache_lru, &unit->link);
+
+  gimp_brush_cache_total_size -= unit->size;
+
+  gimp_brush_cache_unit_unref (unit);
+}
+
+/*  pins the unit for the calling thread, and releases the unit that was
+ *  pinned by the thread before.  the data returned by
+ *  gimp_brush_cache_get() and gimp_brush_cache_add() is in use by the
+ *  caller until its next call on the same cache, so each thread keeps
+ *  its last unit of each cache alive, even if it's evicted, replaced or
+ *  cleared in the meantime.
+ */
+static void
+gimp_brush_cache_unit_pin (GimpBrushCacheUnit *unit)
+{
+  unit->ref_count++;
+
+  g_hash_table_replace (unit->cache->pins, g_thread_self (), unit);
+}
+
+/*  evicts the least recently used units until the cache fits its memory
+ *  budget.  pinned units are skipped, since their data is still in use
+ *  by some thread.
+ *
+ *  must be called with the mutex held.
+ */
+static void
+gimp_brush_cache_trim (void)
+{
+  GList *link = gimp_brush_cache_lru.tail;
+
+  while (link && gimp_brush_cache_total_size > gimp_brush_cache_max_size)
+    {
+      GimpBrushCacheUnit *unit = link->data;
+
+      link = link->prev;
+
+      /*  the hash table holds one reference, pins hold the others  */
+      if (unit->ref_count == 1)
+        g_hash_table_remove (unit->cache->units, unit);
+    }
+}
+
 
 /*  public functions  */
 
+void
+gimp_brush_cache_global_init (Gimp *gimp)
+{
+  g_return_if_fail (GIMP_IS_GIMP (gimp));
+
+  g_signal_connect (gimp->config, "notify::brush-cache-size",
+                    G_CALLBACK (gimp_brush_cache_notify_config),
+                    NULL);
+  g_signal_connect (gimp->config, "notify::brush-cache-tolerance",
+                    G_CALLBACK (gimp_brush_cache_notify_config),
+                    NULL);
+
+  gimp_brush_cache_notify_config (gimp->config);
+}
+
+void
+gimp_brush_cache_global_exit (Gimp *gimp)
+{
+  g_return_if_fail (GIMP_IS_GIMP (gimp));
+
+  g_signal_handlers_disconnect_by_func (gimp->config,
+                                        (gpointer) gimp_brush_cache_notify_config,
+                                        NULL);
+}
+
 GimpBrushCache *
-gimp_brush_cache_new (GDestroyNotify  data_destroy,
-                      gchar           debug_hit,
-                      gchar           debug_miss)
+gimp_brush_cache_new (GDestroyNotify          data_destroy,
+                      GimpBrushCacheSizeFunc  data_size,
+                      gchar                   debug_hit,
+                      gchar                   debug_miss)
 {
   GimpBrushCache *cache;
 
   g_return_val_if_fail (data_destroy != NULL, NULL);
+  g_return_val_if_fail (data_size != NULL, NULL);
 
   cache =  g_object_new (GIMP_TYPE_BRUSH_CACHE,
                          "data-destroy", data_destroy,
+                         "data-size",    data_size,
                          NULL);
 
   cache->debug_hit  = debug_hit;
@@ -182,20 +386,11 @@ gimp_brush_cache_clear (GimpBrushCache *cache)
 {
   g_return_if_fail (GIMP_IS_BRUSH_CACHE (cache));
 
-  if (cache->cached_units)
-    {
-      GList *iter;
-
-      for (iter = cache->cached_units; iter; iter = g_list_next (iter))
-        {
-          GimpBrushCacheUnit *unit = iter->data;
+  g_mutex_lock (&gimp_brush_cache_mutex);
 
-          cache->data_destroy (unit->data);
-        }
+  g_hash_table_remove_all (cache->units);
 
-      g_list_free_full (cache->cached_units, g_free);
-      cache->cached_units = NULL;
-    }
+  g_mutex_unlock (&gimp_brush_cache_mutex);
 }
 
 gconstpointer
@@ -208,41 +403,47 @@ gimp_brush_cache_get (GimpBrushCache *cache,
                       gboolean        reflect,
                       gdouble         hardness)
 {
-  GList *iter;
+  GimpBrushCacheUnit  key;
+  GimpBrushCacheUnit *unit;
+  gconstpointer       data = NULL;
 
   g_return_val_if_fail (GIMP_IS_BRUSH_CACHE (cache), NULL);
 
-  for (iter = cache->cached_units; iter; iter = g_list_next (iter))
+  key.width        = width;
+  key.height       = height;
+  key.scale        = scale;
+  key.aspect_ratio = aspect_ratio;
+  key.angle        = angle;
+  key.reflect      = reflect;
+  key.hardness     = hardness;
+
+  g_mutex_lock (&gimp_brush_cache_mutex);
+
+  unit = g_hash_table_lookup (cache->units, &key);
+
+  if (unit)
     {
-      GimpBrushCacheUnit *unit = iter->data;
-
-      if (unit->data                         &&
-          unit->width        == width        &&
-          unit->height       == height       &&
-          unit->scale        == scale        &&
-          unit->aspect_ratio == aspect_ratio &&
-          unit->angle        == angle        &&
-          unit->reflect      == reflect      &&
-          unit->hardness     == hardness)
-        {
-          if (gimp_log_flags & GIMP_LOG_BRUSH_CACHE)
-            g_printerr ("%c", cache->debug_hit);
-
-          /* Make the returned cached brush first in the list. */
-          cache->cached_units = g_list_remove_link (cache->cached_units, iter);
-          iter->next = cache->cached_units;
-          if (cache->cached_units)
-            cache->cached_units->prev = iter;
-          cache->cached_units = iter;
-
-          return (gconstpointer) unit->data;
-        }
+      /* Make the returned cached brush first in the list. */
+      g_queue_unlink         (&gimp_brush_cache_lru, &unit->link);
+      g_queue_push_head_link (&gimp_brush_cache_lru, &unit->link);
+
+      gimp_brush_cache_unit_pin (unit);
+
+      data = unit->data;
+
+      gimp_brush_cache_hits++;
     }
+  else
+    {
+      gimp_brush_cache_misses++;
+    }
+
+  g_mutex_unlock (&gimp_brush_cache_mutex);
 
   if (gimp_log_flags & GIMP_LOG_BRUSH_CACHE)
-    g_printerr ("%c", cache->debug_miss);
+    g_printerr ("%c", data ? cache->debug_hit : cache->debug_miss);
 
-  return NULL;
+  return data;
 }
 
 void
@@ -256,44 +457,126 @@ gimp_brush_cache_add (GimpBrushCache *cache,
                       gboolean        reflect,
                       gdouble         hardness)
 {
-  GList              *iter;
   GimpBrushCacheUnit *unit;
-  GList              *last   = NULL;
-  gint                length = 0;
+  GimpBrushCacheUnit *old_unit;
 
   g_return_if_fail (GIMP_IS_BRUSH_CACHE (cache));
   g_return_if_fail (data != NULL);
 
-  for (iter = cache->cached_units; iter; iter = g_list_next (iter))
+  unit = g_slice_new0 (GimpBrushCacheUnit);
+
+  unit->cache        = cache;
+  unit->link.data    = unit;
+  unit->ref_count    = 1;
+  unit->data         = data;
+  unit->size         = sizeof (GimpBrushCacheUnit) + cache->data_size (data);
+  unit->width        = width;
+  unit->height       = height;
+  unit->scale        = scale;
+  unit->aspect_ratio = aspect_ratio;
+  unit->angle        = angle;
+  unit->reflect      = reflect;
+  unit->hardness     = hardness;
+
+  g_mutex_lock (&gimp_brush_cache_mutex);
+
+  old_unit = g_hash_table_lookup (cache->units, unit);
+
+  if (old_unit && old_unit->data == data)
+    {
+      gimp_brush_cache_unit_pin (old_unit);
+
+      g_mutex_unlock (&gimp_brush_cache_mutex);
+
+      g_slice_free (GimpBrushCacheUnit, unit);
+
+      return;
+    }
+
+  /*  replaces, and releases, any unit with the same key  */
+  g_hash_table_replace (cache->units, unit, unit);
+
+  g_queue_push_head_link (&gimp_brush_cache_lru, &unit->link);
+
+  gimp_brush_cache_total_size += unit->size;
+
+  gimp_brush_cache_unit_pin (unit);
+
+  gimp_brush_cache_trim ();
+
+  g_mutex_unlock (&gimp_brush_cache_mutex);
+}
+
+/*  rounds the transform parameters to the cache's tolerance, so that
+ *  brushes transformed with nearly the same parameters, as is common
+ *  with jittering dynamics, share a cache entry.  the scale is rounded
+ *  logarithmically, the other parameters linearly, using an integral
+ *  number of steps per unit, so that unit scale, zero aspect ratio and
+ *  half turns are kept exact.
+ */
+void
+gimp_brush_cache_quantize (gdouble *scale,
+                           gdouble *aspect_ratio,
+                           gdouble *angle,
+                           gdouble *hardness)
+{
+  gdouble tolerance;
+
+  g_mutex_lock (&gimp_brush_cache_mutex);
+
+  tolerance = gimp_brush_cache_tolerance / 100.0;
+
+  g_mutex_unlock (&gimp_brush_cache_mutex);
+
+  if (tolerance <= 0.0)
+    return;
+
+  if (scale)
     {
-      unit = iter->data;
+      gdouble step = log1p (tolerance);
 
-      if (data == unit->data)
-        return;
+      *scale = exp (RINT (log (*scale) / step) * step);
+    }
+
+  if (aspect_ratio)
+    {
+      gdouble n = MAX (RINT (1.0 / (ASPECT_RATIO_RANGE * tolerance)), 1.0);
 
-      length++;
-      last = iter;
+      *aspect_ratio = RINT (*aspect_ratio * n) / n;
     }
 
-  if (length > MAX_CACHED_DATA)
+  if (angle)
     {
-      unit = last->data;
+      /*  the angle is in turns; a step of tolerance / 2π turns moves the
+       *  brush outline by at most tolerance of the brush radius.
+       */
+      gdouble n = 2.0 * MAX (RINT (G_PI / tolerance), 1.0);
 
-      cache->data_destroy (unit->data);
-      cache->cached_units = g_list_delete_link (cache->cached_units, last);
-      g_free (unit);
+      *angle = RINT (*angle * n) / n;
     }
 
-  unit = g_new0 (GimpBrushCacheUnit, 1);
+  if (hardness)
+    {
+      gdouble n = MAX (RINT (1.0 / tolerance), 1.0);
 
-  unit->data         = data;
-  unit->width        = width;
-  unit->height       = height;
-  unit->scale        = scale;
-  unit->aspect_ratio = aspect_ratio;
-  unit->angle        = angle;
-  unit->reflect      = reflect;
-  unit->hardness     = hardness;
+      *hardness = RINT (*hardness * n) / n;
+    }
+}
+
+guint64
+gimp_brush_cache_get_total_memsize (void)
+{
+  return gimp_brush_cache_total_size;
+}
+
+void
+gimp_brush_cache_get_hit_miss (gint *hits,
+                               gint *misses)
+{
+  g_mutex_lock (&gimp_brush_cache_mutex);
+
+  if (hits)   *hits   = gimp_brush_cache_hits;
+  if (misses) *misses = gimp_brush_cache_misses;
 
-  cache->cached_units = g_list_prepend (cache->cached_units, unit);
+  g_mutex_unlock (&gimp_brush_cache_mutex);
 }
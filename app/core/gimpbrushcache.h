@@ -33,18 +33,23 @@
 #define GIMP_BRUSH_CACHE_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), GIMP_TYPE_BRUSH_CACHE, GimpBrushCacheClass))
 
 
+typedef gsize (* GimpBrushCacheSizeFunc) (gconstpointer data);
+
+
 typedef struct _GimpBrushCacheClass GimpBrushCacheClass;
 
 struct _GimpBrushCache
 {
-  GimpObject      parent_instance;
+  GimpObject              parent_instance;
 
-  GDestroyNotify  data_destroy;
+  GDestroyNotify          data_destroy;
+  GimpBrushCacheSizeFunc  data_size;
 
-  GList          *cached_units;
+  GHashTable             *units;
+  GHashTable             *pins;
 
-  gchar           debug_hit;
-  gchar           debug_miss;
+  gchar                   debug_hit;
+  gchar                   debug_miss;
 };
 
 struct _GimpBrushCacheClass
@@ -53,31 +58,44 @@ struct _GimpBrushCacheClass
 };
 
 
-GType            gimp_brush_cache_get_type (void) G_GNUC_CONST;
-
-GimpBrushCache * gimp_brush_cache_new      (GDestroyNotify  data_destory,
-                                            gchar           debug_hit,
-                                            gchar           debug_miss);
-
-void             gimp_brush_cache_clear    (GimpBrushCache *cache);
-
-gconstpointer    gimp_brush_cache_get      (GimpBrushCache *cache,
-                                            gint            width,
-                                            gint            height,
-                                            gdouble         scale,
-                                            gdouble         aspect_ratio,
-                                            gdouble         angle,
-                                            gboolean        reflect,
-                                            gdouble         hardness);
-void             gimp_brush_cache_add      (GimpBrushCache *cache,
-                                            gpointer        data,
-                                            gint            width,
-                                            gint            height,
-                                            gdouble         scale,
-                                            gdouble         aspect_ratio,
-                                            gdouble         angle,
-                                            gboolean        reflect,
-                                            gdouble         hardness);
+void             gimp_brush_cache_global_init       (Gimp                   *gimp);
+void             gimp_brush_cache_global_exit       (Gimp                   *gimp);
+
+GType            gimp_brush_cache_get_type          (void) G_GNUC_CONST;
+
+GimpBrushCache * gimp_brush_cache_new               (GDestroyNotify          data_destory,
+                                                     GimpBrushCacheSizeFunc  data_size,
+                                                     gchar                   debug_hit,
+                                                     gchar                   debug_miss);
+
+void             gimp_brush_cache_clear             (GimpBrushCache         *cache);
+
+gconstpointer    gimp_brush_cache_get               (GimpBrushCache         *cache,
+                                                     gint                    width,
+                                                     gint                    height,
+                                                     gdouble                 scale,
+                                                     gdouble                 aspect_ratio,
+                                                     gdouble                 angle,
+                                                     gboolean                reflect,
+                                                     gdouble                 hardness);
+void             gimp_brush_cache_add               (GimpBrushCache         *cache,
+                                                     gpointer                data,
+                                                     gint                    width,
+                                                     gint                    height,
+                                                     gdouble                 scale,
+                                                     gdouble                 aspect_ratio,
+                                                     gdouble                 angle,
+                                                     gboolean                reflect,
+                                                     gdouble                 hardness);
+
+void             gimp_brush_cache_quantize          (gdouble                *scale,
+                                                     gdouble                *aspect_ratio,
+                                                     gdouble                *angle,
+                                                     gdouble                *hardness);
+
+guint64          gimp_brush_cache_get_total_memsize (void);
+void             gimp_brush_cache_get_hit_miss      (gint                   *hits,
+                                                     gint                   *misses);
 
 
 #endif  /*  __GIMP_BRUSH_CACHE_H__  */
@@ -329,6 +329,7 @@ gimp_channel_init (GimpChannel *channel)
   channel->segs_out       = NULL;
   channel->num_segs_in    = 0;
   channel->num_segs_out   = 0;
+  channel->boundary_cache = gimp_boundary_cache_new ();
   channel->empty          = FALSE;
   channel->bounds_known   = FALSE;
   channel->x1             = 0;
@@ -350,6 +351,7 @@ gimp_channel_finalize (GObject *object)
 
   g_clear_pointer (&channel->segs_in,  g_free);
   g_clear_pointer (&channel->segs_out, g_free);
+  g_clear_pointer (&channel->boundary_cache, gimp_boundary_cache_free);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -362,6 +364,7 @@ gimp_channel_get_memsize (GimpObject *object,
 
   *gui_size += channel->num_segs_in  * sizeof (GimpBoundSeg);
   *gui_size += channel->num_segs_out * sizeof (GimpBoundSeg);
+  *gui_size += gimp_boundary_cache_get_memsize (channel->boundary_cache);
 
   return GIMP_OBJECT_CLASS (parent_class)->get_memsize (object, gui_size);
 }
@@ -1020,6 +1023,8 @@ gimp_channel_set_buffer (GimpDrawable *drawable,
                                                   buffer,
                                                   offset_x, offset_y);
 
+  gimp_boundary_cache_invalidate (channel->boundary_cache, NULL);
+
   gegl_buffer_signal_connect (buffer, "changed",
                               G_CALLBACK (gimp_channel_buffer_changed),
                               channel);
@@ -1095,12 +1100,14 @@ gimp_channel_real_boundary (GimpChannel         *channel,
 
           buffer = gimp_drawable_get_buffer (GIMP_DRAWABLE (channel));
 
-          channel->segs_out = gimp_boundary_find (buffer, &rect,
-                                                  babl_format ("Y float"),
-                                                  GIMP_BOUNDARY_IGNORE_BOUNDS,
-                                                  x1, y1, x2, y2,
-                                                  GIMP_BOUNDARY_HALF_WAY,
-                                                  &channel->num_segs_out);
+          channel->segs_out =
+            gimp_boundary_find_cached (channel->boundary_cache,
+                                       buffer, &rect,
+                                       babl_format ("Y float"),
+                                       GIMP_BOUNDARY_IGNORE_BOUNDS,
+                                       x1, y1, x2, y2,
+                                       GIMP_BOUNDARY_HALF_WAY,
+                                       &channel->num_segs_out);
           x1 = MAX (x1, x3);
           y1 = MAX (y1, y3);
           x2 = MIN (x2, x4);
@@ -1108,12 +1115,14 @@ gimp_channel_real_boundary (GimpChannel         *channel,
 
           if (x2 > x1 && y2 > y1)
             {
-              channel->segs_in = gimp_boundary_find (buffer, NULL,
-                                                     babl_format ("Y float"),
-                                                     GIMP_BOUNDARY_WITHIN_BOUNDS,
-                                                     x1, y1, x2, y2,
-                                                     GIMP_BOUNDARY_HALF_WAY,
-                                                     &channel->num_segs_in);
+              channel->segs_in =
+                gimp_boundary_find_cached (channel->boundary_cache,
+                                           buffer, NULL,
+                                           babl_format ("Y float"),
+                                           GIMP_BOUNDARY_WITHIN_BOUNDS,
+                                           x1, y1, x2, y2,
+                                           GIMP_BOUNDARY_HALF_WAY,
+                                           &channel->num_segs_in);
             }
           else
             {
@@ -1546,6 +1555,11 @@ gimp_channel_buffer_changed (GeglBuffer          *buffer,
                              const GeglRectangle *rect,
                              GimpChannel         *channel)
 {
+  /*  only the tiles touched by the change need their boundary runs
+   *  recomputed, the rest of the cache stays valid
+   */
+  gimp_boundary_cache_invalidate (channel->boundary_cache, rect);
+
   gimp_drawable_invalidate_boundary (GIMP_DRAWABLE (channel));
 }
 
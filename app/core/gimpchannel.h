@@ -33,26 +33,27 @@ typedef struct _GimpChannelClass GimpChannelClass;
 
 struct _GimpChannel
 {
-  GimpDrawable  parent_instance;
+  GimpDrawable       parent_instance;
 
-  GimpRGB       color;             /*  Also stores the opacity        */
-  gboolean      show_masked;       /*  Show masked areas--as          */
-                                   /*  opposed to selected areas      */
+  GimpRGB            color;             /*  Also stores the opacity        */
+  gboolean           show_masked;       /*  Show masked areas--as          */
+                                        /*  opposed to selected areas      */
 
-  GeglNode     *color_node;
-  GeglNode     *invert_node;
-  GeglNode     *mask_node;
+  GeglNode          *color_node;
+  GeglNode          *invert_node;
+  GeglNode          *mask_node;
 
   /*  Selection mask variables  */
-  gboolean      boundary_known;    /*  is the current boundary valid  */
-  GimpBoundSeg *segs_in;           /*  outline of selected region     */
-  GimpBoundSeg *segs_out;          /*  outline of selected region     */
-  gint          num_segs_in;       /*  number of lines in boundary    */
-  gint          num_segs_out;      /*  number of lines in boundary    */
-  gboolean      empty;             /*  is the region empty?           */
-  gboolean      bounds_known;      /*  recalculate the bounds?        */
-  gint          x1, y1;            /*  coordinates for bounding box   */
-  gint          x2, y2;            /*  lower right hand coordinate    */
+  gboolean           boundary_known;    /*  is the current boundary valid  */
+  GimpBoundSeg      *segs_in;           /*  outline of selected region     */
+  GimpBoundSeg      *segs_out;          /*  outline of selected region     */
+  gint               num_segs_in;       /*  number of lines in boundary    */
+  gint               num_segs_out;      /*  number of lines in boundary    */
+  GimpBoundaryCache *boundary_cache;    /*  per-tile runs of the mask      */
+  gboolean           empty;             /*  is the region empty?           */
+  gboolean           bounds_known;      /*  recalculate the bounds?        */
+  gint               x1, y1;            /*  coordinates for bounding box   */
+  gint               x2, y2;            /*  lower right hand coordinate    */
 };
 
 struct _GimpChannelClass
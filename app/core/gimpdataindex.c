@@ -0,0 +1,698 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimpdataindex.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*  A GimpDataIndex remembers what a data factory found in each of its
+ *  files the last time it decoded them: the data's name, size, brush
+ *  spacing, a small preview and the checksum the tag cache identifies
+ *  it by.  Entries are keyed by URI and are only valid as long as the
+ *  file's mtime and size didn't change, which allows a factory to
+ *  register its data without decoding the files, and to defer decoding
+ *  to the first time the pixels are actually used.
+ *
+ *  Only the pattern and brush factories use an index, and their fill
+ *  functions only accept GIMP patterns and plain GIMP brushes.  GIH
+ *  brush pipes, generated and ABR brushes, patterns loaded through
+ *  GdkPixbuf, gradients, palettes, dynamics and MyPaint brushes are
+ *  still decoded at startup, and tags still come from the tag cache
+ *  rather than from the index.
+ *
+ *  The index is stored as a simple binary file:
+ *
+ *    magic, version, n_entries,
+ *    n_entries * { uri, mtime, size, name, checksum, width, height,
+ *                  spacing, preview format, preview width,
+ *                  preview height, preview data }
+ *
+ *  with all integers in network byte order and all strings prefixed
+ *  by their length.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include <gegl.h>
+
+#include "libgimpbase/gimpbase.h"
+
+#include "core-types.h"
+
+#include "gimpdataindex.h"
+#include "gimptempbuf.h"
+
+#include "gimp-intl.h"
+
+
+#define GIMP_DATA_INDEX_MAGIC   "GIMP-DATA-INDEX"
+#define GIMP_DATA_INDEX_VERSION 3
+
+/*  sanity limits against corrupt files  */
+#define MAX_STRING_LENGTH       (64 * 1024)
+#define MAX_ENTRIES             (1024 * 1024)
+
+
+struct _GimpDataIndex
+{
+  GFile      *file;
+  GHashTable *entries;
+  gboolean    dirty;
+};
+
+
+static GimpDataIndexEntry * gimp_data_index_entry_new  (const gchar         *uri);
+static void                 gimp_data_index_entry_free (GimpDataIndexEntry  *entry);
+
+static gboolean             gimp_data_index_read_entry (GDataInputStream    *input,
+                                                        GimpDataIndexEntry **entry,
+                                                        GError             **error);
+static gboolean             gimp_data_index_write_entry (GDataOutputStream  *output,
+                                                         GimpDataIndexEntry *entry,
+                                                         GError            **error);
+
+static gchar              * read_string                (GDataInputStream    *input,
+                                                        GError             **error);
+static gboolean             write_string               (GDataOutputStream   *output,
+                                                        const gchar         *string,
+                                                        GError             **error);
+
+
+/*  public functions  */
+
+GimpDataIndex *
+gimp_data_index_new (GFile *file)
+{
+  GimpDataIndex *index;
+
+  g_return_val_if_fail (G_IS_FILE (file), NULL);
+
+  index = g_slice_new0 (GimpDataIndex);
+
+  index->file    = g_object_ref (file);
+  index->entries = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                          NULL,
+                                          (GDestroyNotify) gimp_data_index_entry_free);
+
+  return index;
+}
+
+void
+gimp_data_index_free (GimpDataIndex *index)
+{
+  g_return_if_fail (index != NULL);
+
+  g_hash_table_unref (index->entries);
+  g_object_unref (index->file);
+
+  g_slice_free (GimpDataIndex, index);
+}
+
+/**
+ * gimp_data_index_load:
+ * @index: a #GimpDataIndex
+ * @error: return location for errors
+ *
+ * Replaces the entries of @index by the ones stored in its file.  A
+ * missing file is not an error, it simply leaves the index empty.
+ *
+ * Returns: %TRUE on success.
+ **/
+gboolean
+gimp_data_index_load (GimpDataIndex  *index,
+                      GError        **error)
+{
+  GInputStream     *stream;
+  GDataInputStream *input;
+  gchar             magic[sizeof (GIMP_DATA_INDEX_MAGIC)];
+  gsize             bytes_read;
+  guint32           version = 0;
+  guint32           n_entries;
+  guint32           i;
+  GError           *my_error = NULL;
+
+  g_return_val_if_fail (index != NULL, FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  g_hash_table_remove_all (index->entries);
+  index->dirty = FALSE;
+
+  stream = G_INPUT_STREAM (g_file_read (index->file, NULL, &my_error));
+
+  if (! stream)
+    {
+      if (my_error->code == G_IO_ERROR_NOT_FOUND)
+        {
+          g_clear_error (&my_error);
+
+          return TRUE;
+        }
+
+      g_propagate_prefixed_error (error, my_error,
+                                  _("Could not open '%s' for reading: "),
+                                  gimp_file_get_utf8_name (index->file));
+      return FALSE;
+    }
+
+  input = g_data_input_stream_new (stream);
+  g_object_unref (stream);
+
+  if (! g_input_stream_read_all (G_INPUT_STREAM (input),
+                                 magic, sizeof (magic),
+                                 &bytes_read, NULL, &my_error))
+    goto out;
+
+  if (bytes_read != sizeof (magic) ||
+      memcmp (magic, GIMP_DATA_INDEX_MAGIC, sizeof (magic)))
+    {
+      g_set_error_literal (&my_error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                           _("File is corrupt."));
+      goto out;
+    }
+
+  version = g_data_input_stream_read_uint32 (input, NULL, &my_error);
+
+  /*  an index written by another version is simply rebuilt  */
+  if (my_error || version != GIMP_DATA_INDEX_VERSION)
+    goto out;
+
+  n_entries = g_data_input_stream_read_uint32 (input, NULL, &my_error);
+
+  if (! my_error && n_entries > MAX_ENTRIES)
+    {
+      g_set_error_literal (&my_error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                           _("File is corrupt."));
+    }
+
+  for (i = 0; ! my_error && i < n_entries; i++)
+    {
+      GimpDataIndexEntry *entry;
+
+      if (gimp_data_index_read_entry (input, &entry, &my_error))
+        g_hash_table_replace (index->entries, entry->uri, entry);
+    }
+
+ out:
+  g_object_unref (input);
+
+  if (my_error || version != GIMP_DATA_INDEX_VERSION)
+    {
+      g_hash_table_remove_all (index->entries);
+      index->dirty = TRUE;
+    }
+
+  if (my_error)
+    {
+      g_propagate_prefixed_error (error, my_error,
+                                  _("Error reading '%s': "),
+                                  gimp_file_get_utf8_name (index->file));
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+/**
+ * gimp_data_index_save:
+ * @index: a #GimpDataIndex
+ * @error: return location for errors
+ *
+ * Writes the entries of @index to its file, if they changed since it
+ * was last loaded or saved.
+ *
+ * Returns: %TRUE on success.
+ **/
+gboolean
+gimp_data_index_save (GimpDataIndex  *index,
+                      GError        **error)
+{
+  GOutputStream     *stream;
+  GDataOutputStream *output;
+  GHashTableIter     iter;
+  gpointer           value;
+  GError            *my_error = NULL;
+
+  g_return_val_if_fail (index != NULL, FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  if (! index->dirty)
+    return TRUE;
+
+  stream = G_OUTPUT_STREAM (g_file_replace (index->file,
+                                            NULL, FALSE, G_FILE_CREATE_NONE,
+                                            NULL, &my_error));
+
+  if (! stream)
+    {
+      g_propagate_prefixed_error (error, my_error,
+                                  _("Could not open '%s' for writing: "),
+                                  gimp_file_get_utf8_name (index->file));
+      return FALSE;
+    }
+
+  output = g_data_output_stream_new (stream);
+  g_object_unref (stream);
+
+  if (! g_output_stream_write_all (G_OUTPUT_STREAM (output),
+                                   GIMP_DATA_INDEX_MAGIC,
+                                   sizeof (GIMP_DATA_INDEX_MAGIC),
+                                   NULL, NULL, &my_error)             ||
+      ! g_data_output_stream_put_uint32 (output, GIMP_DATA_INDEX_VERSION,
+                                         NULL, &my_error)             ||
+      ! g_data_output_stream_put_uint32 (output,
+                                         g_hash_table_size (index->entries),
+                                         NULL, &my_error))
+    {
+      goto error;
+    }
+
+  g_hash_table_iter_init (&iter, index->entries);
+
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+      if (! gimp_data_index_write_entry (output, value, &my_error))
+        goto error;
+    }
+
+  if (! g_output_stream_close (G_OUTPUT_STREAM (output), NULL, &my_error))
+    goto error;
+
+  g_object_unref (output);
+
+  index->dirty = FALSE;
+
+  return TRUE;
+
+ error:
+  {
+    GCancellable *cancellable = g_cancellable_new ();
+
+    /*  cancel the overwrite initiated by g_file_replace()  */
+    g_cancellable_cancel (cancellable);
+    g_output_stream_close (G_OUTPUT_STREAM (output), cancellable, NULL);
+    g_object_unref (cancellable);
+  }
+
+  g_object_unref (output);
+
+  g_propagate_prefixed_error (error, my_error,
+                              _("Error writing '%s': "),
+                              gimp_file_get_utf8_name (index->file));
+
+  return FALSE;
+}
+
+/**
+ * gimp_data_index_lookup:
+ * @index: a #GimpDataIndex
+ * @file:  a data file
+ * @mtime: the file's current modification time
+ * @size:  the file's current size
+ *
+ * Looks up the entry of @file, and marks it as still in use for
+ * gimp_data_index_prune().  An entry recorded for a different @mtime
+ * or @size is stale, and is removed.
+ *
+ * Returns: the entry, or %NULL.
+ **/
+const GimpDataIndexEntry *
+gimp_data_index_lookup (GimpDataIndex *index,
+                        GFile         *file,
+                        guint64        mtime,
+                        guint64        size)
+{
+  GimpDataIndexEntry *entry;
+  gchar              *uri;
+
+  g_return_val_if_fail (index != NULL, NULL);
+  g_return_val_if_fail (G_IS_FILE (file), NULL);
+
+  uri   = g_file_get_uri (file);
+  entry = g_hash_table_lookup (index->entries, uri);
+  g_free (uri);
+
+  if (! entry)
+    return NULL;
+
+  if (mtime == 0 || entry->mtime != mtime || entry->size != size)
+    {
+      g_hash_table_remove (index->entries, entry->uri);
+      index->dirty = TRUE;
+
+      return NULL;
+    }
+
+  entry->referenced = TRUE;
+
+  return entry;
+}
+
+/**
+ * gimp_data_index_insert:
+ * @index: a #GimpDataIndex
+ * @file:  a data file
+ * @mtime: the file's modification time
+ * @size:  the file's size
+ *
+ * Adds an empty entry for @file, replacing any previous one.  The
+ * caller fills in the remaining fields.
+ *
+ * Returns: the new entry.
+ **/
+GimpDataIndexEntry *
+gimp_data_index_insert (GimpDataIndex *index,
+                        GFile         *file,
+                        guint64        mtime,
+                        guint64        size)
+{
+  GimpDataIndexEntry *entry;
+
+  g_return_val_if_fail (index != NULL, NULL);
+  g_return_val_if_fail (G_IS_FILE (file), NULL);
+
+  entry = gimp_data_index_entry_new (NULL);
+
+  entry->uri        = g_file_get_uri (file);
+  entry->mtime      = mtime;
+  entry->size       = size;
+  entry->referenced = TRUE;
+
+  g_hash_table_replace (index->entries, entry->uri, entry);
+  index->dirty = TRUE;
+
+  return entry;
+}
+
+void
+gimp_data_index_remove (GimpDataIndex *index,
+                        GFile         *file)
+{
+  gchar *uri;
+
+  g_return_if_fail (index != NULL);
+  g_return_if_fail (G_IS_FILE (file));
+
+  uri = g_file_get_uri (file);
+
+  if (g_hash_table_remove (index->entries, uri))
+    index->dirty = TRUE;
+
+  g_free (uri);
+}
+
+/**
+ * gimp_data_index_prune:
+ * @index: a #GimpDataIndex
+ *
+ * Removes all entries which were neither looked up nor inserted
+ * since the last call, i.e. the entries of files which no longer
+ * exist.
+ **/
+void
+gimp_data_index_prune (GimpDataIndex *index)
+{
+  GHashTableIter iter;
+  gpointer       value;
+
+  g_return_if_fail (index != NULL);
+
+  g_hash_table_iter_init (&iter, index->entries);
+
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+      GimpDataIndexEntry *entry = value;
+
+      if (entry->referenced)
+        {
+          entry->referenced = FALSE;
+        }
+      else
+        {
+          g_hash_table_iter_remove (&iter);
+          index->dirty = TRUE;
+        }
+    }
+}
+
+gboolean
+gimp_data_index_is_dirty (GimpDataIndex *index)
+{
+  g_return_val_if_fail (index != NULL, FALSE);
+
+  return index->dirty;
+}
+
+
+/*  private functions  */
+
+static GimpDataIndexEntry *
+gimp_data_index_entry_new (const gchar *uri)
+{
+  GimpDataIndexEntry *entry = g_slice_new0 (GimpDataIndexEntry);
+
+  entry->uri = g_strdup (uri);
+
+  return entry;
+}
+
+static void
+gimp_data_index_entry_free (GimpDataIndexEntry *entry)
+{
+  g_free (entry->uri);
+  g_free (entry->name);
+  g_free (entry->checksum);
+  g_clear_pointer (&entry->preview, gimp_temp_buf_unref);
+
+  g_slice_free (GimpDataIndexEntry, entry);
+}
+
+static gboolean
+gimp_data_index_read_entry (GDataInputStream    *input,
+                            GimpDataIndexEntry **entry,
+                            GError             **error)
+{
+  GimpDataIndexEntry *new_entry;
+  gchar              *format_name;
+  gint                preview_width  = 0;
+  gint                preview_height = 0;
+  GError             *my_error = NULL;
+
+  new_entry = gimp_data_index_entry_new (NULL);
+
+  new_entry->uri = read_string (input, &my_error);
+  if (! new_entry->uri)
+    goto error;
+
+  new_entry->mtime = g_data_input_stream_read_uint64 (input, NULL, &my_error);
+  if (my_error)
+    goto error;
+
+  new_entry->size = g_data_input_stream_read_uint64 (input, NULL, &my_error);
+  if (my_error)
+    goto error;
+
+  new_entry->name = read_string (input, &my_error);
+  if (! new_entry->name)
+    goto error;
+
+  new_entry->checksum = read_string (input, &my_error);
+  if (! new_entry->checksum)
+    goto error;
+
+  new_entry->width = g_data_input_stream_read_int32 (input, NULL, &my_error);
+  if (my_error)
+    goto error;
+
+  new_entry->height = g_data_input_stream_read_int32 (input, NULL, &my_error);
+  if (my_error)
+    goto error;
+
+  new_entry->spacing = g_data_input_stream_read_int32 (input, NULL, &my_error);
+  if (my_error)
+    goto error;
+
+  format_name = read_string (input, &my_error);
+  if (! format_name)
+    goto error;
+
+  preview_width = g_data_input_stream_read_int32 (input, NULL, &my_error);
+
+  if (! my_error)
+    preview_height = g_data_input_stream_read_int32 (input, NULL, &my_error);
+
+  if (! my_error && *format_name)
+    {
+      if (preview_width  < 1 || preview_width  > GIMP_DATA_INDEX_PREVIEW_SIZE ||
+          preview_height < 1 || preview_height > GIMP_DATA_INDEX_PREVIEW_SIZE ||
+          ! babl_format_exists (format_name))
+        {
+          g_set_error_literal (&my_error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                               _("Invalid preview."));
+        }
+      else
+        {
+          gsize size;
+          gsize bytes_read;
+
+          new_entry->preview = gimp_temp_buf_new (preview_width,
+                                                  preview_height,
+                                                  babl_format (format_name));
+
+          size = gimp_temp_buf_get_data_size (new_entry->preview);
+
+          if (g_input_stream_read_all (G_INPUT_STREAM (input),
+                                       gimp_temp_buf_get_data (new_entry->preview),
+                                       size, &bytes_read,
+                                       NULL, &my_error) &&
+              bytes_read != size)
+            {
+              g_set_error_literal (&my_error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                                   _("File appears truncated."));
+            }
+        }
+    }
+
+  g_free (format_name);
+
+  if (my_error)
+    goto error;
+
+  *entry = new_entry;
+
+  return TRUE;
+
+ error:
+  gimp_data_index_entry_free (new_entry);
+
+  g_propagate_error (error, my_error);
+
+  return FALSE;
+}
+
+static gboolean
+gimp_data_index_write_entry (GDataOutputStream   *output,
+                             GimpDataIndexEntry  *entry,
+                             GError             **error)
+{
+  GimpTempBuf *preview = entry->preview;
+
+  if (! write_string (output, entry->uri, error)                         ||
+      ! g_data_output_stream_put_uint64 (output, entry->mtime,
+                                         NULL, error)                     ||
+      ! g_data_output_stream_put_uint64 (output, entry->size,
+                                         NULL, error)                     ||
+      ! write_string (output, entry->name, error)                        ||
+      ! write_string (output, entry->checksum, error)                    ||
+      ! g_data_output_stream_put_int32 (output, entry->width,
+                                        NULL, error)                      ||
+      ! g_data_output_stream_put_int32 (output, entry->height,
+                                        NULL, error)                      ||
+      ! g_data_output_stream_put_int32 (output, entry->spacing,
+                                        NULL, error)                      ||
+      ! write_string (output,
+                      preview ?
+                      babl_format_get_encoding (gimp_temp_buf_get_format (preview)) :
+                      NULL,
+                      error)                                              ||
+      ! g_data_output_stream_put_int32 (output,
+                                        preview ?
+                                        gimp_temp_buf_get_width (preview) : 0,
+                                        NULL, error)                      ||
+      ! g_data_output_stream_put_int32 (output,
+                                        preview ?
+                                        gimp_temp_buf_get_height (preview) : 0,
+                                        NULL, error))
+    {
+      return FALSE;
+    }
+
+  if (preview &&
+      ! g_output_stream_write_all (G_OUTPUT_STREAM (output),
+                                   gimp_temp_buf_get_data (preview),
+                                   gimp_temp_buf_get_data_size (preview),
+                                   NULL, NULL, error))
+    {
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static gchar *
+read_string (GDataInputStream  *input,
+             GError           **error)
+{
+  gchar   *string;
+  guint32  length;
+  gsize    bytes_read;
+
+  length = g_data_input_stream_read_uint32 (input, NULL, error);
+
+  if (error && *error)
+    return NULL;
+
+  if (length > MAX_STRING_LENGTH)
+    {
+      g_set_error_literal (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                           _("Invalid string length."));
+      return NULL;
+    }
+
+  string = g_malloc (length + 1);
+
+  if (! g_input_stream_read_all (G_INPUT_STREAM (input), string, length,
+                                 &bytes_read, NULL, error) ||
+      bytes_read != length)
+    {
+      if (error && ! *error)
+        g_set_error_literal (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                             _("File appears truncated."));
+
+      g_free (string);
+
+      return NULL;
+    }
+
+  string[length] = '\0';
+
+  if (! g_utf8_validate (string, -1, NULL))
+    {
+      g_set_error_literal (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                           _("Invalid UTF-8 string."));
+      g_free (string);
+
+      return NULL;
+    }
+
+  return string;
+}
+
+static gboolean
+write_string (GDataOutputStream  *output,
+              const gchar        *string,
+              GError            **error)
+{
+  guint32 length = string ? strlen (string) : 0;
+
+  if (! g_data_output_stream_put_uint32 (output, length, NULL, error))
+    return FALSE;
+
+  return g_output_stream_write_all (G_OUTPUT_STREAM (output),
+                                    string, length,
+                                    NULL, NULL, error);
+}
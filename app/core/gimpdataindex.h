@@ -0,0 +1,69 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimpdataindex.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GIMP_DATA_INDEX_H__
+#define __GIMP_DATA_INDEX_H__
+
+
+/*  the maximal size of the previews stored in the index  */
+#define GIMP_DATA_INDEX_PREVIEW_SIZE 64
+
+
+struct _GimpDataIndexEntry
+{
+  gchar       *uri;
+  guint64      mtime;
+  guint64      size;
+
+  gchar       *name;
+  gchar       *checksum;
+  gint         width;
+  gint         height;
+  gint         spacing;
+  GimpTempBuf *preview;
+
+  /*< private >*/
+  gboolean     referenced;
+};
+
+
+GimpDataIndex            * gimp_data_index_new         (GFile                    *file);
+void                       gimp_data_index_free        (GimpDataIndex            *index);
+
+gboolean                   gimp_data_index_load        (GimpDataIndex            *index,
+                                                        GError                  **error);
+gboolean                   gimp_data_index_save        (GimpDataIndex            *index,
+                                                        GError                  **error);
+
+const GimpDataIndexEntry * gimp_data_index_lookup      (GimpDataIndex            *index,
+                                                        GFile                    *file,
+                                                        guint64                   mtime,
+                                                        guint64                   size);
+GimpDataIndexEntry       * gimp_data_index_insert      (GimpDataIndex            *index,
+                                                        GFile                    *file,
+                                                        guint64                   mtime,
+                                                        guint64                   size);
+void                       gimp_data_index_remove      (GimpDataIndex            *index,
+                                                        GFile                    *file);
+void                       gimp_data_index_prune       (GimpDataIndex            *index);
+
+gboolean                   gimp_data_index_is_dirty    (GimpDataIndex            *index);
+
+
+#endif /* __GIMP_DATA_INDEX_H__ */
@@ -33,6 +33,7 @@
 #include "gimp-utils.h"
 #include "gimpcontainer.h"
 #include "gimpdata.h"
+#include "gimpdataindex.h"
 #include "gimpdataloaderfactory.h"
 
 #include "gimp-intl.h"
@@ -57,8 +58,13 @@ struct _GimpDataLoader
 
 struct _GimpDataLoaderFactoryPrivate
 {
-  GList          *loaders;
-  GimpDataLoader *fallback;
+  GList                 *loaders;
+  GimpDataLoader        *fallback;
+
+  GimpDataIndex         *index;
+  gboolean               index_loaded;
+  GimpDataIndexNewFunc   index_new_func;
+  GimpDataIndexFillFunc  index_fill_func;
 };
 
 #define GET_PRIVATE(obj) (((GimpDataLoaderFactory *) (obj))->priv)
@@ -133,6 +139,8 @@ gimp_data_loader_factory_finalize (GObject *object)
 
   g_clear_pointer (&priv->fallback, gimp_data_loader_free);
 
+  g_clear_pointer (&priv->index, gimp_data_index_free);
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -286,6 +294,47 @@ gimp_data_loader_factory_add_fallback (GimpDataFactory  *factory,
   priv->fallback = gimp_data_loader_new (name, load_func, NULL, FALSE);
 }
 
+/**
+ * gimp_data_loader_factory_set_index:
+ * @factory:   a #GimpDataLoaderFactory
+ * @basename:  the file name of the index in the user's gimp directory
+ * @new_func:  creates a data object from an index entry
+ * @fill_func: fills an index entry from a loaded data object
+ *
+ * Makes @factory remember what it loaded from each single-object data
+ * file in a #GimpDataIndex.  As long as a file doesn't change, its
+ * data object is then created by @new_func from the index alone, and
+ * the file is only decoded when the object actually needs its
+ * contents.
+ **/
+void
+gimp_data_loader_factory_set_index (GimpDataFactory       *factory,
+                                    const gchar           *basename,
+                                    GimpDataIndexNewFunc   new_func,
+                                    GimpDataIndexFillFunc  fill_func)
+{
+  GimpDataLoaderFactoryPrivate *priv;
+  GFile                        *file;
+
+  g_return_if_fail (GIMP_IS_DATA_LOADER_FACTORY (factory));
+  g_return_if_fail (basename != NULL);
+  g_return_if_fail (new_func != NULL);
+  g_return_if_fail (fill_func != NULL);
+
+  priv = GET_PRIVATE (factory);
+
+  g_clear_pointer (&priv->index, gimp_data_index_free);
+
+  file = gimp_directory_file (basename, NULL);
+
+  priv->index           = gimp_data_index_new (file);
+  priv->index_loaded    = FALSE;
+  priv->index_new_func  = new_func;
+  priv->index_fill_func = fill_func;
+
+  g_object_unref (file);
+}
+
 
 /*  private functions  */
 
@@ -312,9 +361,22 @@ gimp_data_loader_factory_load (GimpDataFactory *factory,
                                GimpContext     *context,
                                GHashTable      *cache)
 {
-  GList *path;
-  GList *writable_path;
-  GList *list;
+  GimpDataLoaderFactoryPrivate *priv = GET_PRIVATE (factory);
+  GList                        *path;
+  GList                        *writable_path;
+  GList                        *list;
+  GError                       *error = NULL;
+
+  if (priv->index && ! priv->index_loaded)
+    {
+      if (! gimp_data_index_load (priv->index, &error))
+        {
+          g_printerr ("%s\n", error->message);
+          g_clear_error (&error);
+        }
+
+      priv->index_loaded = TRUE;
+    }
 
   path          = gimp_data_factory_get_data_path          (factory);
   writable_path = gimp_data_factory_get_data_path_writable (factory);
@@ -335,6 +397,18 @@ gimp_data_loader_factory_load (GimpDataFactory *factory,
 
   g_list_free_full (path,          (GDestroyNotify) g_object_unref);
   g_list_free_full (writable_path, (GDestroyNotify) g_object_unref);
+
+  if (priv->index)
+    {
+      /*  forget about files which are gone  */
+      gimp_data_index_prune (priv->index);
+
+      if (! gimp_data_index_save (priv->index, &error))
+        {
+          g_printerr ("%s\n", error->message);
+          g_clear_error (&error);
+        }
+    }
 }
 
 static void
@@ -351,6 +425,7 @@ gimp_data_loader_factory_load_directory (GimpDataFactory *factory,
                                           G_FILE_ATTRIBUTE_STANDARD_NAME ","
                                           G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN ","
                                           G_FILE_ATTRIBUTE_STANDARD_TYPE ","
+                                          G_FILE_ATTRIBUTE_STANDARD_SIZE ","
                                           G_FILE_ATTRIBUTE_TIME_MODIFIED,
                                           G_FILE_QUERY_INFO_NONE,
                                           NULL, NULL);
@@ -405,13 +480,16 @@ gimp_data_loader_factory_load_data (GimpDataFactory *factory,
                                     GFileInfo       *info,
                                     GFile           *top_directory)
 {
-  GimpDataLoader *loader;
-  GimpContainer  *container;
-  GimpContainer  *container_obsolete;
-  GList          *data_list = NULL;
-  GInputStream   *input;
-  guint64         mtime;
-  GError         *error = NULL;
+  GimpDataLoaderFactoryPrivate *priv  = GET_PRIVATE (factory);
+  const GimpDataIndexEntry     *entry = NULL;
+  GimpDataLoader               *loader;
+  GimpContainer                *container;
+  GimpContainer                *container_obsolete;
+  GList                        *data_list = NULL;
+  GInputStream                 *input;
+  guint64                       mtime;
+  guint64                       size;
+  GError                       *error = NULL;
 
   loader = gimp_data_loader_factory_get_loader (factory, file);
 
@@ -426,6 +504,13 @@ gimp_data_loader_factory_load_data (GimpDataFactory *factory,
 
   mtime = g_file_info_get_attribute_uint64 (info,
                                             G_FILE_ATTRIBUTE_TIME_MODIFIED);
+  size  = g_file_info_get_size (info);
+
+  /*  look up the entry even if the cached object is used below, so
+   *  the entry isn't pruned
+   */
+  if (priv->index)
+    entry = gimp_data_index_lookup (priv->index, file, mtime, size);
 
   if (cache)
     {
@@ -444,35 +529,61 @@ gimp_data_loader_factory_load_data (GimpDataFactory *factory,
         }
     }
 
-  input = G_INPUT_STREAM (g_file_read (file, NULL, &error));
+  if (entry)
+    {
+      GimpData *data = priv->index_new_func (context, entry);
+
+      if (data)
+        data_list = g_list_prepend (NULL, data);
+      else
+        gimp_data_index_remove (priv->index, file);
+    }
 
-  if (input)
+  if (! data_list)
     {
-      GInputStream *buffered = g_buffered_input_stream_new (input);
+      input = G_INPUT_STREAM (g_file_read (file, NULL, &error));
+
+      if (input)
+        {
+          GInputStream *buffered = g_buffered_input_stream_new (input);
 
-      data_list = loader->load_func (context, file, buffered, &error);
+          data_list = loader->load_func (context, file, buffered, &error);
 
-      if (error)
+          if (error)
+            {
+              g_prefix_error (&error,
+                              _("Error loading '%s': "),
+                              gimp_file_get_utf8_name (file));
+            }
+          else if (! data_list)
+            {
+              g_set_error (&error, GIMP_DATA_ERROR, GIMP_DATA_ERROR_READ,
+                           _("Error loading '%s'"),
+                           gimp_file_get_utf8_name (file));
+            }
+
+          g_object_unref (buffered);
+          g_object_unref (input);
+        }
+      else
         {
           g_prefix_error (&error,
-                          _("Error loading '%s': "),
+                          _("Could not open '%s' for reading: "),
                           gimp_file_get_utf8_name (file));
         }
-      else if (! data_list)
+
+      /*  only files containing a single data object are indexed  */
+      if (priv->index && data_list && ! data_list->next && ! error)
         {
-          g_set_error (&error, GIMP_DATA_ERROR, GIMP_DATA_ERROR_READ,
-                       _("Error loading '%s'"),
-                       gimp_file_get_utf8_name (file));
-        }
+          GimpDataIndexEntry *new_entry;
 
-      g_object_unref (buffered);
-      g_object_unref (input);
-    }
-  else
-    {
-      g_prefix_error (&error,
-                      _("Could not open '%s' for reading: "),
-                      gimp_file_get_utf8_name (file));
+          new_entry = gimp_data_index_insert (priv->index, file, mtime, size);
+
+          new_entry->name = g_strdup (gimp_object_get_name (data_list->data));
+
+          if (! priv->index_fill_func (data_list->data, new_entry))
+            gimp_data_index_remove (priv->index, file);
+        }
     }
 
   if (G_LIKELY (data_list))
@@ -25,10 +25,14 @@
 #include "gimpdatafactory.h"
 
 
-typedef GList * (* GimpDataLoadFunc) (GimpContext   *context,
-                                      GFile         *file,
-                                      GInputStream  *input,
-                                      GError       **error);
+typedef GList    * (* GimpDataLoadFunc)      (GimpContext               *context,
+                                               GFile                     *file,
+                                               GInputStream              *input,
+                                               GError                   **error);
+typedef GimpData * (* GimpDataIndexNewFunc)  (GimpContext               *context,
+                                               const GimpDataIndexEntry  *entry);
+typedef gboolean   (* GimpDataIndexFillFunc) (GimpData                  *data,
+                                               GimpDataIndexEntry        *entry);
 
 
 #define GIMP_TYPE_DATA_LOADER_FACTORY            (gimp_data_loader_factory_get_type ())
@@ -72,6 +76,10 @@ void              gimp_data_loader_factory_add_loader   (GimpDataFactory
 void              gimp_data_loader_factory_add_fallback (GimpDataFactory         *factory,
                                                          const gchar             *name,
                                                          GimpDataLoadFunc         load_func);
+void              gimp_data_loader_factory_set_index    (GimpDataFactory         *factory,
+                                                         const gchar             *basename,
+                                                         GimpDataIndexNewFunc     new_func,
+                                                         GimpDataIndexFillFunc    fill_func);
 
 
 #endif  /*  __GIMP_DATA_LOADER_FACTORY_H__  */
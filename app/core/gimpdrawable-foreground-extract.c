@@ -22,11 +22,15 @@
 #include <gdk-pixbuf/gdk-pixbuf.h>
 
 #include "libgimpbase/gimpbase.h"
+#include "libgimpmath/gimpmath.h"
 
 #include "core-types.h"
 
+#include "gegl/gimp-gegl-nodes.h"
 #include "gegl/gimp-gegl-utils.h"
 
+#include "gimp-parallel.h"
+#include "gimpasync.h"
 #include "gimpchannel.h"
 #include "gimpdrawable.h"
 #include "gimpdrawable-foreground-extract.h"
@@ -36,18 +40,113 @@
 #include "gimp-intl.h"
 
 
-/*  public functions  */
+/*  drawables larger than this are matted on a downsampled copy first  */
+#define PREVIEW_AREA      (1024 * 1024)
 
-GeglBuffer *
-gimp_drawable_foreground_extract (GimpDrawable      *drawable,
-                                  GimpMattingEngine  engine,
-                                  gint               global_iterations,
-                                  gint               levin_levels,
-                                  gint               levin_active_levels,
-                                  GeglBuffer        *trimap,
-                                  GimpProgress      *progress)
+/*  the refinement re-solves the uncertain band in blocks of this size,
+ *  each with a margin of context around it
+ */
+#define REFINE_BLOCK_SIZE 256
+#define REFINE_MARGIN     32
+
+/*  coarse alpha values outside of [ALPHA_LOW, ALPHA_HIGH] are taken as
+ *  decided; the rest, grown by BAND_RADIUS pixels, is the uncertain band
+ */
+#define ALPHA_LOW         0.05f
+#define ALPHA_HIGH        0.95f
+#define BAND_RADIUS       4
+
+
+typedef struct
+{
+  GeglBuffer        *input;
+  gint               off_x;
+  gint               off_y;
+  GeglBuffer        *trimap;
+  GeglBuffer        *mask;
+  GimpMattingEngine  engine;
+  gint               global_iterations;
+  gint               levin_levels;
+  gint               levin_active_levels;
+} RefineData;
+
+
+/*  local function prototypes  */
+
+static GeglNode   * gimp_drawable_foreground_extract_matting_node
+                                          (GeglNode            *gegl,
+                                           GimpMattingEngine    engine,
+                                           gint                 global_iterations,
+                                           gint                 levin_levels,
+                                           gint                 levin_active_levels);
+static GeglBuffer * gimp_drawable_foreground_extract_run
+                                          (GimpDrawable        *drawable,
+                                           GimpMattingEngine    engine,
+                                           gint                 global_iterations,
+                                           gint                 levin_levels,
+                                           gint                 levin_active_levels,
+                                           GeglBuffer          *trimap,
+                                           gdouble              scale,
+                                           GimpProgress        *progress);
+
+static void         gimp_drawable_foreground_extract_dilate
+                                          (guchar              *band,
+                                           guchar              *temp,
+                                           gint                 width,
+                                           gint                 height);
+static gboolean     gimp_drawable_foreground_extract_refine_block
+                                          (RefineData          *data,
+                                           GeglNode            *crop_node,
+                                           GeglNode            *trimap_node,
+                                           GeglNode            *matting_node,
+                                           const GeglRectangle *block);
+static void         gimp_drawable_foreground_extract_refine_func
+                                          (GimpAsync           *async,
+                                           RefineData          *data);
+
+static void         refine_data_free      (RefineData          *data);
+
+
+/*  private functions  */
+
+static GeglNode *
+gimp_drawable_foreground_extract_matting_node (GeglNode          *gegl,
+                                               GimpMattingEngine  engine,
+                                               gint               global_iterations,
+                                               gint               levin_levels,
+                                               gint               levin_active_levels)
+{
+  if (engine == GIMP_MATTING_ENGINE_GLOBAL)
+    {
+      return gegl_node_new_child (gegl,
+                                  "operation",  "gegl:matting-global",
+                                  "iterations", global_iterations,
+                                  NULL);
+    }
+  else
+    {
+      return gegl_node_new_child (gegl,
+                                  "operation",     "gegl:matting-levin",
+                                  "levels",        levin_levels,
+                                  "active_levels", levin_active_levels,
+                                  NULL);
+    }
+}
+
+/*  runs the matting over the whole drawable, after scaling the drawable
+ *  and the trimap down by 'scale'; the resulting alpha is scaled back up
+ *  to exactly the drawable's size, in image coordinates
+ */
+static GeglBuffer *
+gimp_drawable_foreground_extract_run (GimpDrawable      *drawable,
+                                      GimpMattingEngine  engine,
+                                      gint               global_iterations,
+                                      gint               levin_levels,
+                                      gint               levin_active_levels,
+                                      GeglBuffer        *trimap,
+                                      gdouble            scale,
+                                      GimpProgress      *progress)
 {
-  GeglBuffer    *drawable_buffer;
   GeglNode      *gegl;
   GeglNode      *input_node;
   GeglNode      *trimap_node;
@@ -58,14 +157,10 @@ gimp_drawable_foreground_extract (GimpDrawable      *drawable,
   gdouble        value;
   gint           off_x, off_y;
 
-  g_return_val_if_fail (GIMP_IS_DRAWABLE (drawable), NULL);
-  g_return_val_if_fail (GEGL_IS_BUFFER (trimap), NULL);
-  g_return_val_if_fail (progress == NULL || GIMP_IS_PROGRESS (progress), NULL);
-
   progress = gimp_progress_start (progress, FALSE,
                                   _("Computing alpha of unknown pixels"));
 
-  drawable_buffer = gimp_drawable_get_buffer (drawable);
+  gimp_item_get_offset (GIMP_ITEM (drawable), &off_x, &off_y);
 
   gegl = gegl_node_new ();
 
@@ -73,62 +168,91 @@ gimp_drawable_foreground_extract (GimpDrawable      *drawable,
                                      "operation", "gegl:buffer-source",
                                      "buffer",    trimap,
                                      NULL);
-  input_node = gegl_node_new_child (gegl,
-                                    "operation", "gegl:buffer-source",
-                                    "buffer",    drawable_buffer,
-                                    NULL);
   output_node = gegl_node_new_child (gegl,
                                      "operation", "gegl:buffer-sink",
                                      "buffer",    &buffer,
                                      "format",    NULL,
                                      NULL);
 
-  if (engine == GIMP_MATTING_ENGINE_GLOBAL)
-    {
-      matting_node = gegl_node_new_child (gegl,
-                                          "operation",  "gegl:matting-global",
-                                          "iterations", global_iterations,
-                                          NULL);
-    }
-  else
+  matting_node =
+    gimp_drawable_foreground_extract_matting_node (gegl, engine,
+                                                   global_iterations,
+                                                   levin_levels,
+                                                   levin_active_levels);
+
+  if (scale < 1.0)
     {
-      matting_node = gegl_node_new_child (gegl,
-                                          "operation",     "gegl:matting-levin",
-                                          "levels",        levin_levels,
-                                          "active_levels", levin_active_levels,
-                                          NULL);
-    }
+      gint      width         = gimp_item_get_width  (GIMP_ITEM (drawable));
+      gint      height        = gimp_item_get_height (GIMP_ITEM (drawable));
+      gint      scaled_width  = MAX (1, RINT (width  * scale));
+      gint      scaled_height = MAX (1, RINT (height * scale));
+      GeglNode *trimap_translate;
+      GeglNode *trimap_scale;
+      GeglNode *input_scale;
+      GeglNode *output_scale;
+      GeglNode *output_translate;
+      GeglNode *crop;
 
-  gimp_item_get_offset (GIMP_ITEM (drawable), &off_x, &off_y);
+      /*  scale in drawable coordinates, with separate ratios for each
+       *  axis, so that scaling back up hits the drawable's size exactly,
+       *  instead of being off by the rounding of 'scale'
+       */
+      input_node = gimp_gegl_add_buffer_source (gegl,
+                                                gimp_drawable_get_buffer (drawable),
+                                                0, 0);
 
-  if (off_x || off_y)
-    {
-      GeglNode *pre;
-      GeglNode *post;
-
-      pre = gegl_node_new_child (gegl,
-                                 "operation", "gegl:translate",
-                                 "x", -1.0 * off_x,
-                                 "y", -1.0 * off_y,
-                                 NULL);
-      post = gegl_node_new_child (gegl,
-                                  "operation", "gegl:translate",
-                                  "x", 1.0 * off_x,
-                                  "y", 1.0 * off_y,
+      trimap_translate = gegl_node_new_child (gegl,
+                                              "operation", "gegl:translate",
+                                              "x",         (gdouble) -off_x,
+                                              "y",         (gdouble) -off_y,
+                                              NULL);
+      input_scale = gegl_node_new_child (gegl,
+                                         "operation", "gegl:scale-ratio",
+                                         "x",         (gdouble) scaled_width  / width,
+                                         "y",         (gdouble) scaled_height / height,
+                                         "sampler",   GEGL_SAMPLER_LINEAR,
+                                         NULL);
+      /*  keep the trimap's three values intact  */
+      trimap_scale = gegl_node_new_child (gegl,
+                                          "operation", "gegl:scale-ratio",
+                                          "x",         (gdouble) scaled_width  / width,
+                                          "y",         (gdouble) scaled_height / height,
+                                          "sampler",   GEGL_SAMPLER_NEAREST,
+                                          NULL);
+      output_scale = gegl_node_new_child (gegl,
+                                          "operation", "gegl:scale-ratio",
+                                          "x",         (gdouble) width  / scaled_width,
+                                          "y",         (gdouble) height / scaled_height,
+                                          "sampler",   GEGL_SAMPLER_LINEAR,
+                                          NULL);
+      output_translate = gegl_node_new_child (gegl,
+                                              "operation", "gegl:translate",
+                                              "x",         (gdouble) off_x,
+                                              "y",         (gdouble) off_y,
+                                              NULL);
+      crop = gegl_node_new_child (gegl,
+                                  "operation", "gegl:crop",
+                                  "x",         (gdouble) off_x,
+                                  "y",         (gdouble) off_y,
+                                  "width",     (gdouble) width,
+                                  "height",    (gdouble) height,
                                   NULL);
 
-      gegl_node_connect_to (trimap_node,   "output", pre, "input");
-      gegl_node_connect_to (pre,  "output", matting_node, "aux");
-      gegl_node_link_many (input_node, matting_node, post, output_node, NULL);
+      gegl_node_link_many (trimap_node, trimap_translate, trimap_scale, NULL);
+      gegl_node_connect_to (trimap_scale, "output", matting_node, "aux");
+      gegl_node_link_many (input_node, input_scale, matting_node,
+                           output_scale, output_translate, crop, output_node,
+                           NULL);
     }
   else
     {
-      gegl_node_connect_to (input_node,   "output",
-                            matting_node, "input");
+      input_node = gimp_gegl_add_buffer_source (gegl,
+                                                gimp_drawable_get_buffer (drawable),
+                                                off_x, off_y);
+
       gegl_node_connect_to (trimap_node,  "output",
                             matting_node, "aux");
-      gegl_node_connect_to (matting_node, "output",
-                            output_node,  "input");
+      gegl_node_link_many (input_node, matting_node, output_node, NULL);
     }
 
   processor = gegl_node_new_processor (output_node, NULL);
@@ -148,3 +272,380 @@ gimp_drawable_foreground_extract (GimpDrawable      *drawable,
 
   return buffer;
 }
+
+/*  grows the non-zero pixels of 'band' by BAND_RADIUS, separably  */
+static void
+gimp_drawable_foreground_extract_dilate (guchar *band,
+                                         guchar *temp,
+                                         gint    width,
+                                         gint    height)
+{
+  gint x, y, i;
+
+  for (y = 0; y < height; y++)
+    {
+      const guchar *src  = band + y * width;
+      guchar       *dest = temp + y * width;
+
+      for (x = 0; x < width; x++)
+        {
+          gint x1 = MAX (x - BAND_RADIUS, 0);
+          gint x2 = MIN (x + BAND_RADIUS, width - 1);
+
+          dest[x] = 0;
+
+          for (i = x1; i <= x2 && ! dest[x]; i++)
+            dest[x] = src[i];
+        }
+    }
+
+  for (y = 0; y < height; y++)
+    {
+      gint    y1   = MAX (y - BAND_RADIUS, 0);
+      gint    y2   = MIN (y + BAND_RADIUS, height - 1);
+      guchar *dest = band + y * width;
+
+      for (x = 0; x < width; x++)
+        {
+          dest[x] = 0;
+
+          for (i = y1; i <= y2 && ! dest[x]; i++)
+            dest[x] = temp[i * width + x];
+        }
+    }
+}
+
+/*  re-solves the uncertain pixels of 'block' at full resolution.  the
+ *  unknown pixels of the trimap whose coarse alpha is already decided
+ *  are made known, which gives the matting engine samples close to the
+ *  band, so that it only has to look at the block and its margin.
+ *  returns FALSE if the block needed no refinement.
+ */
+static gboolean
+gimp_drawable_foreground_extract_refine_block (RefineData          *data,
+                                               GeglNode            *crop_node,
+                                               GeglNode            *trimap_node,
+                                               GeglNode            *matting_node,
+                                               const GeglRectangle *block)
+{
+  const Babl    *format = babl_format ("Y float");
+  GeglRectangle  rect;
+  GeglBuffer    *local_trimap;
+  gfloat        *trimap;
+  gfloat        *alpha;
+  gfloat        *result;
+  guchar        *band;
+  guchar        *temp;
+  gboolean       has_fg = FALSE;
+  gboolean       has_bg = FALSE;
+  gboolean       refine = FALSE;
+  gint           n_pixels;
+  gint           bx, by;
+  gint           x, y, i;
+
+  rect = *block;
+
+  rect.x      -= REFINE_MARGIN;
+  rect.y      -= REFINE_MARGIN;
+  rect.width  += 2 * REFINE_MARGIN;
+  rect.height += 2 * REFINE_MARGIN;
+
+  gegl_rectangle_intersect (&rect, &rect, gegl_buffer_get_extent (data->mask));
+
+  n_pixels = rect.width * rect.height;
+
+  trimap = g_new (gfloat, n_pixels);
+  alpha  = g_new (gfloat, n_pixels);
+  band   = g_new (guchar, 2 * n_pixels);
+  temp   = band + n_pixels;
+
+  gegl_buffer_get (data->trimap, &rect, 1.0, format, trimap,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+  gegl_buffer_get (data->mask, &rect, 1.0, format, alpha,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+  for (i = 0; i < n_pixels; i++)
+    {
+      band[i] = (trimap[i] > 0.25f && trimap[i] < 0.75f &&
+                 alpha[i]  > ALPHA_LOW && alpha[i] < ALPHA_HIGH);
+    }
+
+  gimp_drawable_foreground_extract_dilate (band, temp, rect.width, rect.height);
+
+  bx = block->x - rect.x;
+  by = block->y - rect.y;
+
+  for (y = by; y < by + block->height && ! refine; y++)
+    {
+      for (x = bx; x < bx + block->width && ! refine; x++)
+        refine = band[y * rect.width + x];
+    }
+
+  if (! refine)
+    {
+      g_free (trimap);
+      g_free (alpha);
+      g_free (band);
+
+      return FALSE;
+    }
+
+  for (i = 0; i < n_pixels; i++)
+    {
+      if (band[i])
+        trimap[i] = 0.5f;
+      else if (trimap[i] > 0.25f && trimap[i] < 0.75f)
+        trimap[i] = alpha[i] >= 0.5f ? 1.0f : 0.0f;
+
+      has_fg |= (trimap[i] >= 0.75f);
+      has_bg |= (trimap[i] <= 0.25f);
+    }
+
+  /*  the matting needs both foreground and background samples  */
+  if (! has_fg || ! has_bg)
+    {
+      g_free (trimap);
+      g_free (alpha);
+      g_free (band);
+
+      return FALSE;
+    }
+
+  local_trimap = gegl_buffer_linear_new_from_data (trimap, format, &rect,
+                                                   GEGL_AUTO_ROWSTRIDE,
+                                                   NULL, NULL);
+
+  gegl_node_set (trimap_node,
+                 "buffer", local_trimap,
+                 NULL);
+  gegl_node_set (crop_node,
+                 "x",      (gdouble) rect.x,
+                 "y",      (gdouble) rect.y,
+                 "width",  (gdouble) rect.width,
+                 "height", (gdouble) rect.height,
+                 NULL);
+
+  result = g_new (gfloat, n_pixels);
+
+  gegl_node_blit (matting_node, 1.0, &rect, format, result,
+                  GEGL_AUTO_ROWSTRIDE, GEGL_BLIT_DEFAULT);
+
+  gegl_node_set (trimap_node,
+                 "buffer", NULL,
+                 NULL);
+  g_object_unref (local_trimap);
+
+  /*  only the band changes, everything else keeps the coarse alpha  */
+  for (y = by; y < by + block->height; y++)
+    {
+      for (x = bx; x < bx + block->width; x++)
+        {
+          i = y * rect.width + x;
+
+          if (band[i])
+            alpha[i] = result[i];
+        }
+    }
+
+  gegl_buffer_set (data->mask, block, 0, format,
+                   alpha + by * rect.width + bx,
+                   rect.width * sizeof (gfloat));
+
+  g_free (result);
+  g_free (trimap);
+  g_free (alpha);
+  g_free (band);
+
+  return TRUE;
+}
+
+static void
+gimp_drawable_foreground_extract_refine_func (GimpAsync  *async,
+                                              RefineData *data)
+{
+  const GeglRectangle *extent = gegl_buffer_get_extent (data->mask);
+  GeglNode            *gegl;
+  GeglNode            *input_node;
+  GeglNode            *crop_node;
+  GeglNode            *trimap_node;
+  GeglNode            *matting_node;
+  gint                 x, y;
+
+  gegl = gegl_node_new ();
+
+  input_node = gimp_gegl_add_buffer_source (gegl, data->input,
+                                            data->off_x, data->off_y);
+  crop_node = gegl_node_new_child (gegl,
+                                   "operation", "gegl:crop",
+                                   NULL);
+  trimap_node = gegl_node_new_child (gegl,
+                                     "operation", "gegl:buffer-source",
+                                     NULL);
+
+  matting_node =
+    gimp_drawable_foreground_extract_matting_node (gegl, data->engine,
+                                                   data->global_iterations,
+                                                   data->levin_levels,
+                                                   data->levin_active_levels);
+
+  gegl_node_link_many (input_node, crop_node, matting_node, NULL);
+  gegl_node_connect_to (trimap_node,  "output",
+                        matting_node, "aux");
+
+  /*  cancellation is checked between blocks, so that a new stroke never
+   *  has to wait for more than a single block
+   */
+  for (y = extent->y; y < extent->y + extent->height; y += REFINE_BLOCK_SIZE)
+    {
+      for (x = extent->x; x < extent->x + extent->width; x += REFINE_BLOCK_SIZE)
+        {
+          GeglRectangle block;
+
+          if (gimp_async_is_canceled (async))
+            {
+              g_object_unref (gegl);
+
+              refine_data_free (data);
+
+              gimp_async_abort (async);
+
+              return;
+            }
+
+          gegl_rectangle_set (&block, x, y,
+                              MIN (REFINE_BLOCK_SIZE,
+                                   extent->x + extent->width  - x),
+                              MIN (REFINE_BLOCK_SIZE,
+                                   extent->y + extent->height - y));
+
+          gimp_drawable_foreground_extract_refine_block (data,
+                                                         crop_node,
+                                                         trimap_node,
+                                                         matting_node,
+                                                         &block);
+        }
+    }
+
+  g_object_unref (gegl);
+
+  gimp_async_finish_full (async,
+                          g_object_ref (data->mask),
+                          g_object_unref);
+
+  /*  the destroy notify passed to gimp_parallel_run_async_full() is only
+   *  called if the task is aborted before it runs
+   */
+  refine_data_free (data);
+}
+
+static void
+refine_data_free (RefineData *data)
+{
+  g_object_unref (data->input);
+  g_object_unref (data->trimap);
+  g_object_unref (data->mask);
+
+  g_slice_free (RefineData, data);
+}
+
+
+/*  public functions  */
+
+GeglBuffer *
+gimp_drawable_foreground_extract (GimpDrawable      *drawable,
+                                  GimpMattingEngine  engine,
+                                  gint               global_iterations,
+                                  gint               levin_levels,
+                                  gint               levin_active_levels,
+                                  GeglBuffer        *trimap,
+                                  GimpProgress      *progress)
+{
+  g_return_val_if_fail (GIMP_IS_DRAWABLE (drawable), NULL);
+  g_return_val_if_fail (GEGL_IS_BUFFER (trimap), NULL);
+  g_return_val_if_fail (progress == NULL || GIMP_IS_PROGRESS (progress), NULL);
+
+  return gimp_drawable_foreground_extract_run (drawable, engine,
+                                               global_iterations,
+                                               levin_levels,
+                                               levin_active_levels,
+                                               trimap, 1.0, progress);
+}
+
+/*  like gimp_drawable_foreground_extract(), but drawables larger than
+ *  PREVIEW_AREA are matted on a downsampled copy, and '*coarse' is set to
+ *  TRUE.  such a coarse result can be passed on to
+ *  gimp_drawable_foreground_extract_refine_async().
+ */
+GeglBuffer *
+gimp_drawable_foreground_extract_preview (GimpDrawable      *drawable,
+                                          GimpMattingEngine  engine,
+                                          gint               global_iterations,
+                                          gint               levin_levels,
+                                          gint               levin_active_levels,
+                                          GeglBuffer        *trimap,
+                                          GimpProgress      *progress,
+                                          gboolean          *coarse)
+{
+  gdouble area;
+  gdouble scale = 1.0;
+
+  g_return_val_if_fail (GIMP_IS_DRAWABLE (drawable), NULL);
+  g_return_val_if_fail (GEGL_IS_BUFFER (trimap), NULL);
+  g_return_val_if_fail (progress == NULL || GIMP_IS_PROGRESS (progress), NULL);
+  g_return_val_if_fail (coarse != NULL, NULL);
+
+  area = (gdouble) gimp_item_get_width  (GIMP_ITEM (drawable)) *
+         (gdouble) gimp_item_get_height (GIMP_ITEM (drawable));
+
+  if (area > PREVIEW_AREA)
+    scale = sqrt (PREVIEW_AREA / area);
+
+  *coarse = (scale < 1.0);
+
+  return gimp_drawable_foreground_extract_run (drawable, engine,
+                                               global_iterations,
+                                               levin_levels,
+                                               levin_active_levels,
+                                               trimap, scale, progress);
+}
+
+/*  refines a coarse mask returned by
+ *  gimp_drawable_foreground_extract_preview() at full resolution, but
+ *  only in the band where its alpha is uncertain.  the result of the
+ *  returned async is a new mask; 'coarse_mask' is left alone.
+ */
+GimpAsync *
+gimp_drawable_foreground_extract_refine_async (GimpDrawable      *drawable,
+                                               GimpMattingEngine  engine,
+                                               gint               global_iterations,
+                                               gint               levin_levels,
+                                               gint               levin_active_levels,
+                                               GeglBuffer        *trimap,
+                                               GeglBuffer        *coarse_mask)
+{
+  RefineData *data;
+
+  g_return_val_if_fail (GIMP_IS_DRAWABLE (drawable), NULL);
+  g_return_val_if_fail (GEGL_IS_BUFFER (trimap), NULL);
+  g_return_val_if_fail (GEGL_IS_BUFFER (coarse_mask), NULL);
+
+  /*  the worker operates on copies, so that the trimap can be painted
+   *  on while it is running
+   */
+  data = g_slice_new0 (RefineData);
+
+  data->input               = gegl_buffer_dup (gimp_drawable_get_buffer (drawable));
+  data->trimap              = gegl_buffer_dup (trimap);
+  data->mask                = gegl_buffer_dup (coarse_mask);
+  data->engine              = engine;
+  data->global_iterations   = global_iterations;
+  data->levin_levels        = levin_levels;
+  data->levin_active_levels = levin_active_levels;
+
+  gimp_item_get_offset (GIMP_ITEM (drawable), &data->off_x, &data->off_y);
+
+  return gimp_parallel_run_async_full (
+    +1,
+    (GimpParallelRunAsyncFunc) gimp_drawable_foreground_extract_refine_func,
+    data, (GDestroyNotify) refine_data_free);
+}
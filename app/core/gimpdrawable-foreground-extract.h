@@ -27,5 +27,23 @@ GeglBuffer * gimp_drawable_foreground_extract (GimpDrawable       *drawable,
                                                GeglBuffer         *trimap,
                                                GimpProgress       *progress);
 
+GeglBuffer * gimp_drawable_foreground_extract_preview
+                                              (GimpDrawable       *drawable,
+                                               GimpMattingEngine   engine,
+                                               gint                global_iterations,
+                                               gint                levin_levels,
+                                               gint                levin_active_levels,
+                                               GeglBuffer         *trimap,
+                                               GimpProgress       *progress,
+                                               gboolean           *coarse);
+GimpAsync  * gimp_drawable_foreground_extract_refine_async
+                                              (GimpDrawable       *drawable,
+                                               GimpMattingEngine   engine,
+                                               gint                global_iterations,
+                                               gint                levin_levels,
+                                               gint                levin_active_levels,
+                                               GeglBuffer         *trimap,
+                                               GeglBuffer         *coarse_mask);
+
 
 #endif  /*  __GIMP_DRAWABLE_FOREGROUND_EXTRACT_H__  */
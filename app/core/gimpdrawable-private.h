@@ -18,26 +18,29 @@
 #ifndef __GIMP_DRAWABLE_PRIVATE_H__
 #define __GIMP_DRAWABLE_PRIVATE_H__
 
+typedef struct _GimpDrawablePrepared GimpDrawablePrepared;
+
 struct _GimpDrawablePrivate
 {
-  GeglBuffer     *buffer; /* buffer for drawable data */
-  GeglBuffer     *shadow; /* shadow buffer            */
+  GeglBuffer           *buffer;   /* buffer for drawable data   */
+  GeglBuffer           *shadow;   /* shadow buffer              */
+  GimpDrawablePrepared *prepared; /* buffer computed in advance */
 
-  GeglNode       *source_node;
-  GeglNode       *buffer_source_node;
-  GimpContainer  *filter_stack;
+  GeglNode             *source_node;
+  GeglNode             *buffer_source_node;
+  GimpContainer        *filter_stack;
 
-  GimpLayer      *floating_selection;
-  GimpFilter     *fs_filter;
-  GeglNode       *fs_crop_node;
-  GimpApplicator *fs_applicator;
+  GimpLayer            *floating_selection;
+  GimpFilter           *fs_filter;
+  GeglNode             *fs_crop_node;
+  GimpApplicator       *fs_applicator;
 
-  GeglNode       *mode_node;
+  GeglNode             *mode_node;
 
-  gint            paint_count;
-  GeglBuffer     *paint_buffer;
-  cairo_region_t *paint_copy_region;
-  cairo_region_t *paint_update_region;
+  gint                  paint_count;
+  GeglBuffer           *paint_buffer;
+  cairo_region_t       *paint_copy_region;
+  cairo_region_t       *paint_update_region;
 };
 
 #endif /* __GIMP_DRAWABLE_PRIVATE_H__ */
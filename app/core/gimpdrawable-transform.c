@@ -34,9 +34,12 @@
 #include "gegl/gimp-gegl-utils.h"
 
 #include "gimp.h"
+#include "gimp-parallel.h"
 #include "gimp-transform-resize.h"
+#include "gimpasync.h"
 #include "gimpchannel.h"
 #include "gimpcontext.h"
+#include "gimpdrawable-private.h"
 #include "gimpdrawable-transform.h"
 #include "gimpimage.h"
 #include "gimpimage-undo.h"
@@ -47,6 +50,7 @@
 #include "gimppickable.h"
 #include "gimpprogress.h"
 #include "gimpselection.h"
+#include "gimpwaitable.h"
 
 #include "gimp-intl.h"
 
@@ -62,6 +66,70 @@
 #endif
 
 
+typedef enum
+{
+  PREPARED_SCALE,
+  PREPARED_FLIP,
+  PREPARED_ROTATE
+} PreparedType;
+
+struct _GimpDrawablePrepared
+{
+  PreparedType           type;
+  GimpAsync             *async;
+  GimpContext           *context;
+  GeglBuffer            *src_buffer;
+  gint                   offset_x;
+  gint                   offset_y;
+
+  /*  scale  */
+  gint                   width;
+  gint                   height;
+  GimpInterpolationType  interpolation_type;
+
+  /*  flip  */
+  GimpOrientationType    flip_type;
+  gdouble                axis;
+
+  /*  rotate  */
+  GimpRotationType       rotate_type;
+  gdouble                center_x;
+  gdouble                center_y;
+};
+
+typedef struct
+{
+  GimpDrawable         *drawable;
+  GeglBuffer           *src_buffer;
+  GimpDrawablePrepared  prepared;
+} PrepareData;
+
+typedef struct
+{
+  GeglBuffer           *buffer;
+  gint                  offset_x;
+  gint                  offset_y;
+} PrepareResult;
+
+
+static GimpDrawablePrepared * gimp_drawable_prepared_new    (GimpDrawable         *drawable,
+                                                             PreparedType          type);
+static void                   gimp_drawable_prepared_start  (GimpDrawable         *drawable,
+                                                             GimpDrawablePrepared *prepared,
+                                                             GimpContext          *context);
+static GimpDrawablePrepared * gimp_drawable_prepared_lookup (GimpDrawable         *drawable,
+                                                             PreparedType          type);
+static GeglBuffer           * gimp_drawable_prepared_take   (GimpDrawable         *drawable,
+                                                             gboolean             *clip_result,
+                                                             gint                 *new_offset_x,
+                                                             gint                 *new_offset_y);
+static void                   gimp_drawable_prepared_func   (GimpAsync            *async,
+                                                             PrepareData          *data);
+
+static void                   prepare_data_free             (PrepareData          *data);
+static void                   prepare_result_free           (PrepareResult        *result);
+
+
 /*  public functions  */
 
 GimpTransformResize
@@ -1128,3 +1196,481 @@ gimp_drawable_transform_paste (GimpDrawable     *drawable,
 
   return drawable;
 }
+
+/**
+ * gimp_drawable_transform_prepare_scale:
+ * @drawable:           a #GimpDrawable
+ * @new_width:          the width @drawable is going to be scaled to
+ * @new_height:         the height @drawable is going to be scaled to
+ * @interpolation_type: the interpolation to scale with
+ *
+ * Starts scaling the pixels of @drawable in the background, so that
+ * a following gimp_item_scale() with matching parameters only has to
+ * commit the result.  This lets whole-image operations compute the
+ * buffers of all their items concurrently, while undo and signals
+ * are still emitted in order, on the main thread.
+ *
+ * The result is discarded if the drawable's buffer changes in the
+ * meantime, and should be released using
+ * gimp_drawable_transform_drop_prepared() once it is no longer
+ * needed.
+ **/
+void
+gimp_drawable_transform_prepare_scale (GimpDrawable          *drawable,
+                                       gint                   new_width,
+                                       gint                   new_height,
+                                       GimpInterpolationType  interpolation_type)
+{
+  GimpDrawablePrepared *prepared;
+
+  g_return_if_fail (GIMP_IS_DRAWABLE (drawable));
+  g_return_if_fail (new_width > 0 && new_height > 0);
+
+  prepared = gimp_drawable_prepared_new (drawable, PREPARED_SCALE);
+
+  prepared->width              = new_width;
+  prepared->height             = new_height;
+  prepared->interpolation_type = interpolation_type;
+
+  gimp_drawable_prepared_start (drawable, prepared, NULL);
+}
+
+/**
+ * gimp_drawable_transform_prepare_flip:
+ * @drawable:  a #GimpDrawable
+ * @context:   a #GimpContext
+ * @flip_type: the orientation @drawable is going to be flipped in
+ * @axis:      the flip axis
+ *
+ * Same as gimp_drawable_transform_prepare_scale(), for a following
+ * gimp_item_flip().
+ **/
+void
+gimp_drawable_transform_prepare_flip (GimpDrawable        *drawable,
+                                      GimpContext         *context,
+                                      GimpOrientationType  flip_type,
+                                      gdouble              axis)
+{
+  GimpDrawablePrepared *prepared;
+
+  g_return_if_fail (GIMP_IS_DRAWABLE (drawable));
+  g_return_if_fail (gimp_item_is_attached (GIMP_ITEM (drawable)));
+  g_return_if_fail (GIMP_IS_CONTEXT (context));
+
+  prepared = gimp_drawable_prepared_new (drawable, PREPARED_FLIP);
+
+  prepared->flip_type = flip_type;
+  prepared->axis      = axis;
+
+  gimp_drawable_prepared_start (drawable, prepared, context);
+}
+
+/**
+ * gimp_drawable_transform_prepare_rotate:
+ * @drawable:    a #GimpDrawable
+ * @context:     a #GimpContext
+ * @rotate_type: the rotation @drawable is going to be rotated by
+ * @center_x:    x-coordinate of the rotation center
+ * @center_y:    y-coordinate of the rotation center
+ *
+ * Same as gimp_drawable_transform_prepare_scale(), for a following
+ * gimp_item_rotate().
+ **/
+void
+gimp_drawable_transform_prepare_rotate (GimpDrawable     *drawable,
+                                        GimpContext      *context,
+                                        GimpRotationType  rotate_type,
+                                        gdouble           center_x,
+                                        gdouble           center_y)
+{
+  GimpDrawablePrepared *prepared;
+
+  g_return_if_fail (GIMP_IS_DRAWABLE (drawable));
+  g_return_if_fail (gimp_item_is_attached (GIMP_ITEM (drawable)));
+  g_return_if_fail (GIMP_IS_CONTEXT (context));
+
+  prepared = gimp_drawable_prepared_new (drawable, PREPARED_ROTATE);
+
+  prepared->rotate_type = rotate_type;
+  prepared->center_x    = center_x;
+  prepared->center_y    = center_y;
+
+  gimp_drawable_prepared_start (drawable, prepared, context);
+}
+
+/**
+ * gimp_drawable_transform_take_scale:
+ * @drawable:           a #GimpDrawable
+ * @new_width:          the new width
+ * @new_height:         the new height
+ * @interpolation_type: the interpolation
+ *
+ * Takes the result of a gimp_drawable_transform_prepare_scale() with
+ * the same parameters, waiting for it if it's still running.
+ *
+ * Returns: the scaled buffer, or %NULL if there is no matching
+ *          prepared result and the caller has to scale by itself.
+ **/
+GeglBuffer *
+gimp_drawable_transform_take_scale (GimpDrawable          *drawable,
+                                    gint                   new_width,
+                                    gint                   new_height,
+                                    GimpInterpolationType  interpolation_type)
+{
+  GimpDrawablePrepared *prepared;
+
+  g_return_val_if_fail (GIMP_IS_DRAWABLE (drawable), NULL);
+
+  prepared = gimp_drawable_prepared_lookup (drawable, PREPARED_SCALE);
+
+  if (! prepared                                         ||
+      prepared->width              != new_width          ||
+      prepared->height             != new_height         ||
+      prepared->interpolation_type != interpolation_type)
+    {
+      gimp_drawable_transform_drop_prepared (drawable);
+
+      return NULL;
+    }
+
+  return gimp_drawable_prepared_take (drawable, NULL, NULL, NULL);
+}
+
+/**
+ * gimp_drawable_transform_take_flip:
+ * @drawable:     a #GimpDrawable
+ * @flip_type:    the flip orientation
+ * @axis:         the flip axis
+ * @clip_result:  whether the result is going to be clipped
+ * @new_offset_x: return location for the new horizontal offset
+ * @new_offset_y: return location for the new vertical offset
+ *
+ * Same as gimp_drawable_transform_take_scale(), for
+ * gimp_drawable_transform_prepare_flip().  The buffer is in the
+ * drawable's own color profile.
+ *
+ * Returns: the flipped buffer, or %NULL.
+ **/
+GeglBuffer *
+gimp_drawable_transform_take_flip (GimpDrawable        *drawable,
+                                   GimpOrientationType  flip_type,
+                                   gdouble              axis,
+                                   gboolean             clip_result,
+                                   gint                *new_offset_x,
+                                   gint                *new_offset_y)
+{
+  GimpDrawablePrepared *prepared;
+
+  g_return_val_if_fail (GIMP_IS_DRAWABLE (drawable), NULL);
+  g_return_val_if_fail (new_offset_x != NULL, NULL);
+  g_return_val_if_fail (new_offset_y != NULL, NULL);
+
+  prepared = gimp_drawable_prepared_lookup (drawable, PREPARED_FLIP);
+
+  if (! prepared                       ||
+      prepared->flip_type != flip_type ||
+      prepared->axis      != axis)
+    {
+      gimp_drawable_transform_drop_prepared (drawable);
+
+      return NULL;
+    }
+
+  return gimp_drawable_prepared_take (drawable, &clip_result,
+                                      new_offset_x, new_offset_y);
+}
+
+/**
+ * gimp_drawable_transform_take_rotate:
+ * @drawable:     a #GimpDrawable
+ * @rotate_type:  the rotation
+ * @center_x:     x-coordinate of the rotation center
+ * @center_y:     y-coordinate of the rotation center
+ * @clip_result:  whether the result is going to be clipped
+ * @new_offset_x: return location for the new horizontal offset
+ * @new_offset_y: return location for the new vertical offset
+ *
+ * Same as gimp_drawable_transform_take_scale(), for
+ * gimp_drawable_transform_prepare_rotate().
+ *
+ * Returns: the rotated buffer, or %NULL.
+ **/
+GeglBuffer *
+gimp_drawable_transform_take_rotate (GimpDrawable     *drawable,
+                                     GimpRotationType  rotate_type,
+                                     gdouble           center_x,
+                                     gdouble           center_y,
+                                     gboolean          clip_result,
+                                     gint             *new_offset_x,
+                                     gint             *new_offset_y)
+{
+  GimpDrawablePrepared *prepared;
+
+  g_return_val_if_fail (GIMP_IS_DRAWABLE (drawable), NULL);
+  g_return_val_if_fail (new_offset_x != NULL, NULL);
+  g_return_val_if_fail (new_offset_y != NULL, NULL);
+
+  prepared = gimp_drawable_prepared_lookup (drawable, PREPARED_ROTATE);
+
+  if (! prepared                           ||
+      prepared->rotate_type != rotate_type ||
+      prepared->center_x    != center_x    ||
+      prepared->center_y    != center_y)
+    {
+      gimp_drawable_transform_drop_prepared (drawable);
+
+      return NULL;
+    }
+
+  return gimp_drawable_prepared_take (drawable, &clip_result,
+                                      new_offset_x, new_offset_y);
+}
+
+/**
+ * gimp_drawable_transform_drop_prepared:
+ * @drawable: a #GimpDrawable
+ *
+ * Cancels and releases any result prepared for @drawable.
+ **/
+void
+gimp_drawable_transform_drop_prepared (GimpDrawable *drawable)
+{
+  GimpDrawablePrepared *prepared;
+
+  g_return_if_fail (GIMP_IS_DRAWABLE (drawable));
+
+  prepared = drawable->private->prepared;
+
+  if (! prepared)
+    return;
+
+  drawable->private->prepared = NULL;
+
+  gimp_async_cancel_and_wait (prepared->async);
+
+  g_object_unref (prepared->async);
+  g_clear_object (&prepared->context);
+  g_object_unref (prepared->src_buffer);
+
+  g_slice_free (GimpDrawablePrepared, prepared);
+}
+
+
+/*  private functions  */
+
+static GimpDrawablePrepared *
+gimp_drawable_prepared_new (GimpDrawable *drawable,
+                            PreparedType  type)
+{
+  GimpDrawablePrepared *prepared;
+
+  gimp_drawable_transform_drop_prepared (drawable);
+
+  prepared = g_slice_new0 (GimpDrawablePrepared);
+
+  prepared->type       = type;
+  prepared->src_buffer = g_object_ref (gimp_drawable_get_buffer (drawable));
+
+  gimp_item_get_offset (GIMP_ITEM (drawable),
+                        &prepared->offset_x, &prepared->offset_y);
+
+  return prepared;
+}
+
+static void
+gimp_drawable_prepared_start (GimpDrawable         *drawable,
+                              GimpDrawablePrepared *prepared,
+                              GimpContext          *context)
+{
+  PrepareData *data;
+
+  /*  the flip and rotate functions look up the drawable's profile,
+   *  which may be created on demand; make sure this happens here,
+   *  on the main thread, so the workers only ever see the cached one
+   */
+  if (prepared->type != PREPARED_SCALE)
+    gimp_color_managed_get_color_profile (GIMP_COLOR_MANAGED (drawable));
+
+  if (context)
+    prepared->context = g_object_ref (context);
+
+  /*  the drawable and context are kept alive by the main thread:
+   *  gimp_drawable_transform_drop_prepared(), which is called when the
+   *  drawable is finalized, waits for the worker
+   */
+  data = g_slice_new0 (PrepareData);
+
+  data->drawable   = drawable;
+  data->src_buffer = g_object_ref (prepared->src_buffer);
+  data->prepared   = *prepared;
+
+  prepared->async = gimp_parallel_run_async_full (
+    +1,
+    (GimpParallelRunAsyncFunc) gimp_drawable_prepared_func,
+    data, (GDestroyNotify) prepare_data_free);
+
+  drawable->private->prepared = prepared;
+}
+
+static GimpDrawablePrepared *
+gimp_drawable_prepared_lookup (GimpDrawable *drawable,
+                               PreparedType  type)
+{
+  GimpDrawablePrepared *prepared = drawable->private->prepared;
+  gint                  offset_x;
+  gint                  offset_y;
+
+  if (! prepared)
+    return NULL;
+
+  gimp_item_get_offset (GIMP_ITEM (drawable), &offset_x, &offset_y);
+
+  if (prepared->type       != type                                ||
+      prepared->src_buffer != gimp_drawable_get_buffer (drawable) ||
+      prepared->offset_x   != offset_x                            ||
+      prepared->offset_y   != offset_y)
+    {
+      return NULL;
+    }
+
+  return prepared;
+}
+
+static GeglBuffer *
+gimp_drawable_prepared_take (GimpDrawable *drawable,
+                             gboolean     *clip_result,
+                             gint         *new_offset_x,
+                             gint         *new_offset_y)
+{
+  GimpDrawablePrepared *prepared = drawable->private->prepared;
+  PrepareResult        *result   = NULL;
+  GeglBuffer           *buffer   = NULL;
+
+  gimp_waitable_wait (GIMP_WAITABLE (prepared->async));
+
+  if (gimp_async_is_finished (prepared->async))
+    result = gimp_async_get_result (prepared->async);
+
+  /*  the prepared result is unclipped.  clipping only makes a
+   *  difference if the drawable actually moves or changes size, so
+   *  otherwise it's still the same result
+   */
+  if (result && clip_result && *clip_result &&
+      (result->offset_x != prepared->offset_x                   ||
+       result->offset_y != prepared->offset_y                   ||
+       gegl_buffer_get_width  (result->buffer) !=
+       gegl_buffer_get_width  (prepared->src_buffer)            ||
+       gegl_buffer_get_height (result->buffer) !=
+       gegl_buffer_get_height (prepared->src_buffer)))
+    {
+      result = NULL;
+    }
+
+  if (result)
+    {
+      buffer = g_object_ref (result->buffer);
+
+      if (new_offset_x) *new_offset_x = result->offset_x;
+      if (new_offset_y) *new_offset_y = result->offset_y;
+    }
+
+  gimp_drawable_transform_drop_prepared (drawable);
+
+  return buffer;
+}
+
+static void
+gimp_drawable_prepared_func (GimpAsync   *async,
+                             PrepareData *data)
+{
+  GimpDrawablePrepared *prepared = &data->prepared;
+  GimpColorProfile     *profile;
+  PrepareResult        *result;
+
+  if (gimp_async_is_canceled (async))
+    {
+      gimp_async_abort (async);
+
+      return;
+    }
+
+  result = g_slice_new0 (PrepareResult);
+
+  switch (prepared->type)
+    {
+    case PREPARED_SCALE:
+      result->buffer =
+        gegl_buffer_new (GEGL_RECTANGLE (0, 0,
+                                         prepared->width, prepared->height),
+                         gegl_buffer_get_format (data->src_buffer));
+
+      gimp_gegl_apply_scale (data->src_buffer,
+                             NULL, NULL,
+                             result->buffer,
+                             prepared->interpolation_type,
+                             ((gdouble) prepared->width /
+                              gegl_buffer_get_width  (data->src_buffer)),
+                             ((gdouble) prepared->height /
+                              gegl_buffer_get_height (data->src_buffer)));
+      break;
+
+    case PREPARED_FLIP:
+      result->buffer =
+        gimp_drawable_transform_buffer_flip (data->drawable,
+                                             prepared->context,
+                                             data->src_buffer,
+                                             prepared->offset_x,
+                                             prepared->offset_y,
+                                             prepared->flip_type,
+                                             prepared->axis,
+                                             FALSE,
+                                             &profile,
+                                             &result->offset_x,
+                                             &result->offset_y);
+      break;
+
+    case PREPARED_ROTATE:
+      result->buffer =
+        gimp_drawable_transform_buffer_rotate (data->drawable,
+                                               prepared->context,
+                                               data->src_buffer,
+                                               prepared->offset_x,
+                                               prepared->offset_y,
+                                               prepared->rotate_type,
+                                               prepared->center_x,
+                                               prepared->center_y,
+                                               FALSE,
+                                               &profile,
+                                               &result->offset_x,
+                                               &result->offset_y);
+      break;
+    }
+
+  if (! result->buffer || gimp_async_is_canceled (async))
+    {
+      prepare_result_free (result);
+
+      gimp_async_abort (async);
+
+      return;
+    }
+
+  gimp_async_finish_full (async, result,
+                          (GDestroyNotify) prepare_result_free);
+}
+
+static void
+prepare_data_free (PrepareData *data)
+{
+  g_object_unref (data->src_buffer);
+
+  g_slice_free (PrepareData, data);
+}
+
+static void
+prepare_result_free (PrepareResult *result)
+{
+  g_clear_object (&result->buffer);
+
+  g_slice_free (PrepareResult, result);
+}
@@ -94,5 +94,39 @@ GimpDrawable         * gimp_drawable_transform_paste             (GimpDrawable
                                                                   gint                     offset_y,
                                                                   gboolean                 new_layer);
 
+void                   gimp_drawable_transform_prepare_scale     (GimpDrawable            *drawable,
+                                                                  gint                     new_width,
+                                                                  gint                     new_height,
+                                                                  GimpInterpolationType    interpolation_type);
+void                   gimp_drawable_transform_prepare_flip      (GimpDrawable            *drawable,
+                                                                  GimpContext             *context,
+                                                                  GimpOrientationType      flip_type,
+                                                                  gdouble                  axis);
+void                   gimp_drawable_transform_prepare_rotate    (GimpDrawable            *drawable,
+                                                                  GimpContext             *context,
+                                                                  GimpRotationType         rotate_type,
+                                                                  gdouble                  center_x,
+                                                                  gdouble                  center_y);
+
+GeglBuffer           * gimp_drawable_transform_take_scale        (GimpDrawable            *drawable,
+                                                                  gint                     new_width,
+                                                                  gint                     new_height,
+                                                                  GimpInterpolationType    interpolation_type);
+GeglBuffer           * gimp_drawable_transform_take_flip         (GimpDrawable            *drawable,
+                                                                  GimpOrientationType      flip_type,
+                                                                  gdouble                  axis,
+                                                                  gboolean                 clip_result,
+                                                                  gint                    *new_offset_x,
+                                                                  gint                    *new_offset_y);
+GeglBuffer           * gimp_drawable_transform_take_rotate       (GimpDrawable            *drawable,
+                                                                  GimpRotationType         rotate_type,
+                                                                  gdouble                  center_x,
+                                                                  gdouble                  center_y,
+                                                                  gboolean                 clip_result,
+                                                                  gint                    *new_offset_x,
+                                                                  gint                    *new_offset_y);
+
+void                   gimp_drawable_transform_drop_prepared     (GimpDrawable            *drawable);
+
 
 #endif  /*  __GIMP_DRAWABLE_TRANSFORM_H__  */
@@ -49,6 +49,7 @@
 #include "gimpimage-undo-push.h"
 #include "gimpmarshal.h"
 #include "gimppickable.h"
+#include "gimppickable-contiguous-region.h"
 #include "gimpprogress.h"
 
 #include "gimp-log.h"
@@ -350,6 +351,8 @@ gimp_drawable_finalize (GObject *object)
   while (drawable->private->paint_count)
     gimp_drawable_end_paint (drawable);
 
+  gimp_drawable_transform_drop_prepared (drawable);
+
   g_clear_object (&drawable->private->buffer);
 
   gimp_drawable_free_shadow_buffer (drawable);
@@ -406,6 +409,8 @@ gimp_drawable_get_memsize (GimpObject *object,
   memsize += gimp_gegl_buffer_get_memsize (gimp_drawable_get_buffer (drawable));
   memsize += gimp_gegl_buffer_get_memsize (drawable->private->shadow);
 
+  memsize += gimp_pickable_contiguous_region_get_cache_memsize (GIMP_PICKABLE (drawable));
+
   return memsize + GIMP_OBJECT_CLASS (parent_class)->get_memsize (object,
                                                                   gui_size);
 }
@@ -523,18 +528,25 @@ gimp_drawable_scale (GimpItem              *item,
   GimpDrawable *drawable = GIMP_DRAWABLE (item);
   GeglBuffer   *new_buffer;
 
-  new_buffer = gegl_buffer_new (GEGL_RECTANGLE (0, 0,
-                                                new_width, new_height),
-                                gimp_drawable_get_format (drawable));
+  new_buffer = gimp_drawable_transform_take_scale (drawable,
+                                                   new_width, new_height,
+                                                   interpolation_type);
 
-  gimp_gegl_apply_scale (gimp_drawable_get_buffer (drawable),
-                         progress, C_("undo-type", "Scale"),
-                         new_buffer,
-                         interpolation_type,
-                         ((gdouble) new_width /
-                          gimp_item_get_width  (item)),
-                         ((gdouble) new_height /
-                          gimp_item_get_height (item)));
+  if (! new_buffer)
+    {
+      new_buffer = gegl_buffer_new (GEGL_RECTANGLE (0, 0,
+                                                    new_width, new_height),
+                                    gimp_drawable_get_format (drawable));
+
+      gimp_gegl_apply_scale (gimp_drawable_get_buffer (drawable),
+                             progress, C_("undo-type", "Scale"),
+                             new_buffer,
+                             interpolation_type,
+                             ((gdouble) new_width /
+                              gimp_item_get_width  (item)),
+                             ((gdouble) new_height /
+                              gimp_item_get_height (item)));
+    }
 
   gimp_drawable_set_buffer_full (drawable, gimp_item_is_attached (item), NULL,
                                  new_buffer,
@@ -637,13 +649,26 @@ gimp_drawable_flip (GimpItem            *item,
 
   gimp_item_get_offset (item, &off_x, &off_y);
 
-  buffer = gimp_drawable_transform_buffer_flip (drawable, context,
-                                                gimp_drawable_get_buffer (drawable),
-                                                off_x, off_y,
-                                                flip_type, axis,
-                                                clip_result,
-                                                &buffer_profile,
-                                                &new_off_x, &new_off_y);
+  buffer = gimp_drawable_transform_take_flip (drawable,
+                                              flip_type, axis,
+                                              clip_result,
+                                              &new_off_x, &new_off_y);
+
+  if (buffer)
+    {
+      buffer_profile =
+        gimp_color_managed_get_color_profile (GIMP_COLOR_MANAGED (drawable));
+    }
+  else
+    {
+      buffer = gimp_drawable_transform_buffer_flip (drawable, context,
+                                                    gimp_drawable_get_buffer (drawable),
+                                                    off_x, off_y,
+                                                    flip_type, axis,
+                                                    clip_result,
+                                                    &buffer_profile,
+                                                    &new_off_x, &new_off_y);
+    }
 
   if (buffer)
     {
@@ -669,13 +694,26 @@ gimp_drawable_rotate (GimpItem         *item,
 
   gimp_item_get_offset (item, &off_x, &off_y);
 
-  buffer = gimp_drawable_transform_buffer_rotate (drawable, context,
-                                                  gimp_drawable_get_buffer (drawable),
-                                                  off_x, off_y,
-                                                  rotate_type, center_x, center_y,
-                                                  clip_result,
-                                                  &buffer_profile,
-                                                  &new_off_x, &new_off_y);
+  buffer = gimp_drawable_transform_take_rotate (drawable,
+                                                rotate_type, center_x, center_y,
+                                                clip_result,
+                                                &new_off_x, &new_off_y);
+
+  if (buffer)
+    {
+      buffer_profile =
+        gimp_color_managed_get_color_profile (GIMP_COLOR_MANAGED (drawable));
+    }
+  else
+    {
+      buffer = gimp_drawable_transform_buffer_rotate (drawable, context,
+                                                      gimp_drawable_get_buffer (drawable),
+                                                      off_x, off_y,
+                                                      rotate_type, center_x, center_y,
+                                                      clip_result,
+                                                      &buffer_profile,
+                                                      &new_off_x, &new_off_y);
+    }
 
   if (buffer)
     {
@@ -912,6 +950,7 @@ gimp_drawable_real_push_undo (GimpDrawable *drawable,
                               gint          height)
 {
   GimpImage *image;
+  gboolean   sparse = FALSE;
 
   if (! buffer)
     {
@@ -940,13 +979,18 @@ gimp_drawable_real_push_undo (GimpDrawable *drawable,
   else
     {
       g_object_ref (buffer);
+
+      /*  the drawable already contains the new pixels, only keep the
+       *  tiles that were actually changed
+       */
+      sparse = TRUE;
     }
 
   image = gimp_item_get_image (GIMP_ITEM (drawable));
 
   gimp_image_undo_push_drawable (image,
                                  undo_desc, drawable,
-                                 buffer, x, y);
+                                 buffer, x, y, sparse);
 
   g_object_unref (buffer);
 }
@@ -1445,6 +1489,11 @@ gimp_drawable_swap_pixels (GimpDrawable *drawable,
   GIMP_DRAWABLE_GET_CLASS (drawable)->swap_pixels (drawable, buffer, x, y);
 }
 
+/*  if @buffer is NULL, the area is copied from the drawable, so this
+ *  must be called before the drawable is modified.  otherwise, @buffer
+ *  holds the original pixels, and the drawable must already contain
+ *  the modified ones.
+ */
 void
 gimp_drawable_push_undo (GimpDrawable *drawable,
                          const gchar  *undo_desc,
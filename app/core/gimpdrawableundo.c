@@ -17,17 +17,40 @@
 
 #include "config.h"
 
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include <gdk-pixbuf/gdk-pixbuf.h>
 #include <gegl.h>
+#include <glib/gstdio.h>
+#include <zlib.h>
 
 #include "libgimpbase/gimpbase.h"
+#include "libgimpconfig/gimpconfig.h"
 
 #include "core-types.h"
 
+#include "config/gimpgeglconfig.h"
+
+#include "gegl/gimp-gegl-loops.h"
+
+#include "gimp.h"
 #include "gimp-memsize.h"
+#include "gimp-parallel.h"
+#include "gimp-utils.h"
+#include "gimpasync.h"
+#include "gimpcancelable.h"
 #include "gimpimage.h"
 #include "gimpdrawable.h"
 #include "gimpdrawableundo.h"
+#include "gimpwaitable.h"
+
+#include "gimp-intl.h"
+
+
+/*  the prefix of the per-session swap directories, followed by the pid  */
+#define SWAP_DIR_PREFIX "gimp-undo-"
 
 
 enum
@@ -35,28 +58,78 @@ enum
   PROP_0,
   PROP_BUFFER,
   PROP_X,
-  PROP_Y
+  PROP_Y,
+  PROP_SPARSE
 };
 
 
-static void     gimp_drawable_undo_constructed  (GObject             *object);
-static void     gimp_drawable_undo_set_property (GObject             *object,
-                                                 guint                property_id,
-                                                 const GValue        *value,
-                                                 GParamSpec          *pspec);
-static void     gimp_drawable_undo_get_property (GObject             *object,
-                                                 guint                property_id,
-                                                 GValue              *value,
-                                                 GParamSpec          *pspec);
+typedef struct
+{
+  GeglBuffer *buffer;
+  GeglBuffer *drawable_buffer;
+  gint        x;
+  gint        y;
+  const Babl *format;
+  gint        tile_width;
+  gint        tile_height;
+  gint        n_tile_cols;
+  gboolean   *changed;
+} DiffData;
+
+typedef struct
+{
+  GeglBuffer *buffer;
+  const Babl *format;
+  GArray     *tiles;
+} CompressData;
+
+typedef struct
+{
+  GBytes     *compressed;
+  GFile      *swap_dir;
+  gchar      *filename;
+  GError     *error;
+} SpillData;
 
-static gint64   gimp_drawable_undo_get_memsize  (GimpObject          *object,
-                                                 gint64              *gui_size);
 
-static void     gimp_drawable_undo_pop          (GimpUndo            *undo,
-                                                 GimpUndoMode         undo_mode,
-                                                 GimpUndoAccumulator *accum);
-static void     gimp_drawable_undo_free         (GimpUndo            *undo,
-                                                 GimpUndoMode         undo_mode);
+static void       gimp_drawable_undo_constructed   (GObject             *object);
+static void       gimp_drawable_undo_set_property  (GObject             *object,
+                                                    guint                property_id,
+                                                    const GValue        *value,
+                                                    GParamSpec          *pspec);
+static void       gimp_drawable_undo_get_property  (GObject             *object,
+                                                    guint                property_id,
+                                                    GValue              *value,
+                                                    GParamSpec          *pspec);
+
+static gint64     gimp_drawable_undo_get_memsize   (GimpObject          *object,
+                                                    gint64              *gui_size);
+
+static void       gimp_drawable_undo_pop           (GimpUndo            *undo,
+                                                    GimpUndoMode         undo_mode,
+                                                    GimpUndoAccumulator *accum);
+static void       gimp_drawable_undo_free          (GimpUndo            *undo,
+                                                    GimpUndoMode         undo_mode);
+
+static void       gimp_drawable_undo_find_tiles    (GimpDrawableUndo    *drawable_undo);
+static gsize      gimp_drawable_undo_get_raw_size  (GimpDrawableUndo    *drawable_undo);
+static gboolean   gimp_drawable_undo_load          (GimpDrawableUndo    *drawable_undo,
+                                                    GError             **error);
+
+static void       gimp_drawable_undo_compress_func (GimpAsync           *async,
+                                                    CompressData        *data);
+static void       gimp_drawable_undo_compress_cb   (GimpAsync           *async,
+                                                    GimpDrawableUndo    *drawable_undo);
+static void       compress_data_free               (CompressData        *data);
+
+static void       gimp_drawable_undo_start_spill   (GimpDrawableUndo    *drawable_undo);
+static void       gimp_drawable_undo_spill_func    (GimpAsync           *async,
+                                                    SpillData           *data);
+static void       gimp_drawable_undo_spill_cb      (GimpAsync           *async,
+                                                    GimpDrawableUndo    *drawable_undo);
+static void       spill_data_free                  (SpillData           *data);
+
+static void       gimp_drawable_undo_remove_dir    (const gchar         *path);
 
 
 G_DEFINE_TYPE (GimpDrawableUndo, gimp_drawable_undo, GIMP_TYPE_ITEM_UNDO)
@@ -97,6 +170,15 @@ gimp_drawable_undo_class_init (GimpDrawableUndoClass *klass)
                                                      0, GIMP_MAX_IMAGE_SIZE, 0,
                                                      GIMP_PARAM_READWRITE |
                                                      G_PARAM_CONSTRUCT_ONLY));
+
+  /*  TRUE if the drawable already contains the new pixels, so that only
+   *  the tiles which differ from it need to be kept
+   */
+  g_object_class_install_property (object_class, PROP_SPARSE,
+                                   g_param_spec_boolean ("sparse", NULL, NULL,
+                                                         FALSE,
+                                                         GIMP_PARAM_READWRITE |
+                                                         G_PARAM_CONSTRUCT_ONLY));
 }
 
 static void
@@ -113,6 +195,12 @@ gimp_drawable_undo_constructed (GObject *object)
 
   gimp_assert (GIMP_IS_DRAWABLE (GIMP_ITEM_UNDO (object)->item));
   gimp_assert (GEGL_IS_BUFFER (drawable_undo->buffer));
+
+  drawable_undo->width  = gegl_buffer_get_width  (drawable_undo->buffer);
+  drawable_undo->height = gegl_buffer_get_height (drawable_undo->buffer);
+  drawable_undo->format = gegl_buffer_get_format (drawable_undo->buffer);
+
+  gimp_drawable_undo_find_tiles (drawable_undo);
 }
 
 static void
@@ -134,6 +222,9 @@ gimp_drawable_undo_set_property (GObject      *object,
     case PROP_Y:
       drawable_undo->y = g_value_get_int (value);
       break;
+    case PROP_SPARSE:
+      drawable_undo->sparse = g_value_get_boolean (value);
+      break;
 
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -160,6 +251,9 @@ gimp_drawable_undo_get_property (GObject    *object,
     case PROP_Y:
       g_value_set_int (value, drawable_undo->y);
       break;
+    case PROP_SPARSE:
+      g_value_set_boolean (value, drawable_undo->sparse);
+      break;
 
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -174,7 +268,27 @@ gimp_drawable_undo_get_memsize (GimpObject *object,
   GimpDrawableUndo *drawable_undo = GIMP_DRAWABLE_UNDO (object);
   gint64            memsize       = 0;
 
-  memsize += gimp_gegl_buffer_get_memsize (drawable_undo->buffer);
+  /*  only count what is actually kept in memory: the changed tiles
+   *  while the step is hot, their compressed data once it's cold, and
+   *  nothing once it's spilled to disk.  a pending spill counts as
+   *  done, so that the step isn't freed while it's on its way to disk
+   */
+  if (! drawable_undo->swap_dir)
+    {
+      if (drawable_undo->buffer)
+        {
+          memsize += gimp_drawable_undo_get_raw_size (drawable_undo);
+          memsize += gimp_g_object_get_memsize (G_OBJECT (drawable_undo->buffer));
+        }
+
+      if (drawable_undo->compressed)
+        memsize += g_bytes_get_size (drawable_undo->compressed);
+    }
+
+  if (drawable_undo->tiles)
+    memsize += drawable_undo->tiles->len * sizeof (GeglRectangle);
+
+  memsize += gimp_string_get_memsize (drawable_undo->swap_file);
 
   return memsize + GIMP_OBJECT_CLASS (parent_class)->get_memsize (object,
                                                                   gui_size);
@@ -186,13 +300,59 @@ gimp_drawable_undo_pop (GimpUndo            *undo,
                         GimpUndoAccumulator *accum)
 {
   GimpDrawableUndo *drawable_undo = GIMP_DRAWABLE_UNDO (undo);
+  GimpDrawable     *drawable      = GIMP_DRAWABLE (GIMP_ITEM_UNDO (undo)->item);
+  GError           *error         = NULL;
+  gint              i;
 
   GIMP_UNDO_CLASS (parent_class)->pop (undo, undo_mode, accum);
 
-  gimp_drawable_swap_pixels (GIMP_DRAWABLE (GIMP_ITEM_UNDO (undo)->item),
-                             drawable_undo->buffer,
-                             drawable_undo->x,
-                             drawable_undo->y);
+  if (! gimp_drawable_undo_load (drawable_undo, &error))
+    {
+      gimp_message_literal (undo->image->gimp, NULL, GIMP_MESSAGE_ERROR,
+                            error->message);
+      g_clear_error (&error);
+
+      return;
+    }
+
+  for (i = 0; i < drawable_undo->tiles->len; i++)
+    {
+      const GeglRectangle *rect = &g_array_index (drawable_undo->tiles,
+                                                  GeglRectangle, i);
+
+      if (rect->width  == drawable_undo->width &&
+          rect->height == drawable_undo->height)
+        {
+          gimp_drawable_swap_pixels (drawable,
+                                     drawable_undo->buffer,
+                                     drawable_undo->x,
+                                     drawable_undo->y);
+        }
+      else
+        {
+          GeglBuffer *buffer;
+
+          /*  swap only the changed area, through a view of the buffer
+           *  which has its origin at the area's origin
+           */
+          buffer = g_object_new (GEGL_TYPE_BUFFER,
+                                 "source",  drawable_undo->buffer,
+                                 "shift-x", rect->x,
+                                 "shift-y", rect->y,
+                                 "x",       0,
+                                 "y",       0,
+                                 "width",   rect->width,
+                                 "height",  rect->height,
+                                 NULL);
+
+          gimp_drawable_swap_pixels (drawable,
+                                     buffer,
+                                     drawable_undo->x + rect->x,
+                                     drawable_undo->y + rect->y);
+
+          g_object_unref (buffer);
+        }
+    }
 }
 
 static void
@@ -201,7 +361,817 @@ gimp_drawable_undo_free (GimpUndo     *undo,
 {
   GimpDrawableUndo *drawable_undo = GIMP_DRAWABLE_UNDO (undo);
 
+  if (drawable_undo->async && ! drawable_undo->buffer)
+    {
+      /*  let a pending spill finish, so that its file gets removed
+       *  below
+       */
+      gimp_drawable_undo_wait (drawable_undo);
+    }
+
+  if (drawable_undo->async)
+    {
+      /*  the compression bails out when canceled, and
+       *  gimp_drawable_undo_compress_cb() ignores canceled results
+       */
+      gimp_cancelable_cancel (GIMP_CANCELABLE (drawable_undo->async));
+      g_clear_object (&drawable_undo->async);
+    }
+
+  g_clear_object (&drawable_undo->swap_dir);
+
+  if (drawable_undo->swap_file)
+    {
+      g_unlink (drawable_undo->swap_file);
+      g_clear_pointer (&drawable_undo->swap_file, g_free);
+    }
+
   g_clear_object (&drawable_undo->buffer);
+  g_clear_pointer (&drawable_undo->compressed, g_bytes_unref);
+  g_clear_pointer (&drawable_undo->tiles, g_array_unref);
 
   GIMP_UNDO_CLASS (parent_class)->free (undo, undo_mode);
 }
+
+
+/*  public functions  */
+
+/**
+ * gimp_drawable_undo_compress:
+ * @undo: a #GimpDrawableUndo
+ *
+ * Starts compressing the pixels of @undo in the background.  Once the
+ * compression is done, the uncompressed pixels are released.  This is
+ * meant for undo steps which are unlikely to be undone soon.
+ **/
+void
+gimp_drawable_undo_compress (GimpDrawableUndo *undo)
+{
+  CompressData *data;
+
+  g_return_if_fail (GIMP_IS_DRAWABLE_UNDO (undo));
+
+  if (! undo->buffer || undo->async)
+    return;
+
+  data = g_slice_new (CompressData);
+
+  data->buffer = g_object_ref (undo->buffer);
+  data->format = undo->format;
+  data->tiles  = g_array_ref (undo->tiles);
+
+  undo->async = gimp_parallel_run_async_full (
+    +1,
+    (GimpParallelRunAsyncFunc) gimp_drawable_undo_compress_func,
+    data, (GDestroyNotify) compress_data_free);
+
+  gimp_async_add_callback_for_object (
+    undo->async,
+    (GimpAsyncCallback) gimp_drawable_undo_compress_cb,
+    undo, undo);
+}
+
+/**
+ * gimp_drawable_undo_spill:
+ * @undo:     a #GimpDrawableUndo
+ * @swap_dir: the directory to write the swap file to
+ *
+ * Starts moving the compressed pixels of @undo to a file in @swap_dir
+ * in the background, compressing them first if necessary.  The file
+ * is read back when the step is undone, and removed when @undo is
+ * freed.  Failures are reported as messages, and leave the pixels in
+ * memory.
+ *
+ * Returns: %TRUE if a spill was started, %FALSE if @undo is already
+ *          spilled, or on its way to disk.
+ **/
+gboolean
+gimp_drawable_undo_spill (GimpDrawableUndo *undo,
+                          GFile            *swap_dir)
+{
+  g_return_val_if_fail (GIMP_IS_DRAWABLE_UNDO (undo), FALSE);
+  g_return_val_if_fail (G_IS_FILE (swap_dir), FALSE);
+
+  if (gimp_drawable_undo_is_spilled (undo))
+    return FALSE;
+
+  undo->swap_dir = g_object_ref (swap_dir);
+
+  /*  the spill continues in gimp_drawable_undo_compress_cb() if the
+   *  pixels are still being compressed
+   */
+  gimp_drawable_undo_compress (undo);
+
+  if (! undo->async)
+    gimp_drawable_undo_start_spill (undo);
+
+  return TRUE;
+}
+
+gboolean
+gimp_drawable_undo_is_spilled (GimpDrawableUndo *undo)
+{
+  g_return_val_if_fail (GIMP_IS_DRAWABLE_UNDO (undo), FALSE);
+
+  return undo->swap_file != NULL || undo->swap_dir != NULL;
+}
+
+/**
+ * gimp_drawable_undo_wait:
+ * @undo: a #GimpDrawableUndo
+ *
+ * Waits for the background compression and spilling of @undo to
+ * finish.
+ **/
+void
+gimp_drawable_undo_wait (GimpDrawableUndo *undo)
+{
+  g_return_if_fail (GIMP_IS_DRAWABLE_UNDO (undo));
+
+  /*  the compression's callback may start the spill  */
+  while (undo->async)
+    gimp_waitable_wait (GIMP_WAITABLE (undo->async));
+}
+
+/**
+ * gimp_drawable_undo_get_swap_dir:
+ * @gimp: a #Gimp
+ *
+ * Returns: the directory under swap-path which undo steps of this
+ *          session are spilled to, or %NULL if there is no swap-path.
+ **/
+GFile *
+gimp_drawable_undo_get_swap_dir (Gimp *gimp)
+{
+  GimpGeglConfig *config;
+  GFile          *swap_dir;
+  GFile          *session_dir;
+  gchar          *name;
+
+  g_return_val_if_fail (GIMP_IS_GIMP (gimp), NULL);
+
+  config = GIMP_GEGL_CONFIG (gimp->config);
+
+  if (! config->swap_path)
+    return NULL;
+
+  swap_dir = gimp_file_new_for_config_path (config->swap_path, NULL);
+
+  if (! swap_dir)
+    return NULL;
+
+  name        = g_strdup_printf (SWAP_DIR_PREFIX "%d", gimp_get_pid ());
+  session_dir = g_file_get_child (swap_dir, name);
+
+  g_free (name);
+  g_object_unref (swap_dir);
+
+  return session_dir;
+}
+
+/**
+ * gimp_drawable_undo_swap_init:
+ * @gimp: a #Gimp
+ *
+ * Removes the undo swap directories which crashed sessions left behind
+ * in swap-path, as well as loose swap files of older versions.
+ **/
+void
+gimp_drawable_undo_swap_init (Gimp *gimp)
+{
+  GimpGeglConfig *config;
+  GFile          *swap_dir;
+  gchar          *path;
+  GDir           *dir;
+  const gchar    *name;
+
+  g_return_if_fail (GIMP_IS_GIMP (gimp));
+
+  config = GIMP_GEGL_CONFIG (gimp->config);
+
+  if (! config->swap_path)
+    return;
+
+  swap_dir = gimp_file_new_for_config_path (config->swap_path, NULL);
+
+  if (! swap_dir)
+    return;
+
+  path = g_file_get_path (swap_dir);
+  g_object_unref (swap_dir);
+
+  dir = path ? g_dir_open (path, 0, NULL) : NULL;
+
+  if (! dir)
+    {
+      g_free (path);
+      return;
+    }
+
+  while ((name = g_dir_read_name (dir)))
+    {
+      gchar *filename;
+
+      if (! g_str_has_prefix (name, SWAP_DIR_PREFIX))
+        continue;
+
+      filename = g_build_filename (path, name, NULL);
+
+      if (g_file_test (filename, G_FILE_TEST_IS_DIR))
+        {
+          const gchar *pid_str = name + strlen (SWAP_DIR_PREFIX);
+          gchar       *end;
+          gint         pid;
+
+          pid = strtol (pid_str, &end, 10);
+
+          if (end != pid_str && ! *end &&
+              pid != gimp_get_pid ()   &&
+              ! gimp_is_pid_alive (pid))
+            {
+              gimp_drawable_undo_remove_dir (filename);
+            }
+        }
+      else
+        {
+          g_unlink (filename);
+        }
+
+      g_free (filename);
+    }
+
+  g_dir_close (dir);
+  g_free (path);
+}
+
+/**
+ * gimp_drawable_undo_swap_exit:
+ * @gimp: a #Gimp
+ *
+ * Removes the undo swap directory of this session.
+ **/
+void
+gimp_drawable_undo_swap_exit (Gimp *gimp)
+{
+  GFile *session_dir;
+  gchar *path;
+
+  g_return_if_fail (GIMP_IS_GIMP (gimp));
+
+  session_dir = gimp_drawable_undo_get_swap_dir (gimp);
+
+  if (! session_dir)
+    return;
+
+  path = g_file_get_path (session_dir);
+
+  if (path)
+    gimp_drawable_undo_remove_dir (path);
+
+  g_free (path);
+  g_object_unref (session_dir);
+}
+
+
+/*  private functions  */
+
+static void
+gimp_drawable_undo_diff_tiles (gint      offset,
+                               gint      size,
+                               DiffData *data)
+{
+  gint    bpp = babl_format_get_bytes_per_pixel (data->format);
+  guchar *undo_data;
+  guchar *drawable_data;
+  gint    i;
+
+  undo_data     = g_malloc (data->tile_width * data->tile_height * bpp);
+  drawable_data = g_malloc (data->tile_width * data->tile_height * bpp);
+
+  for (i = offset; i < offset + size; i++)
+    {
+      GeglRectangle rect;
+
+      rect.x      = (i % data->n_tile_cols) * data->tile_width;
+      rect.y      = (i / data->n_tile_cols) * data->tile_height;
+      rect.width  = data->tile_width;
+      rect.height = data->tile_height;
+
+      gegl_rectangle_intersect (&rect, &rect,
+                                gegl_buffer_get_extent (data->buffer));
+
+      gegl_buffer_get (data->buffer, &rect, 1.0,
+                       data->format, undo_data,
+                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+      rect.x += data->x;
+      rect.y += data->y;
+
+      gegl_buffer_get (data->drawable_buffer, &rect, 1.0,
+                       data->format, drawable_data,
+                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+      data->changed[i] = memcmp (undo_data, drawable_data,
+                                 rect.width * rect.height * bpp) != 0;
+    }
+
+  g_free (undo_data);
+  g_free (drawable_data);
+}
+
+static void
+gimp_drawable_undo_find_tiles (GimpDrawableUndo *drawable_undo)
+{
+  GimpDrawable  *drawable = GIMP_DRAWABLE (GIMP_ITEM_UNDO (drawable_undo)->item);
+  GeglRectangle  whole    = { 0, 0, drawable_undo->width, drawable_undo->height };
+  DiffData       data;
+  GeglBuffer    *buffer;
+  gint           n_tile_rows;
+  gint           n_tiles;
+  gint           n_changed = 0;
+  gint           row;
+  gint           i;
+
+  drawable_undo->tiles = g_array_new (FALSE, FALSE, sizeof (GeglRectangle));
+
+  if (! drawable_undo->sparse)
+    {
+      g_array_append_val (drawable_undo->tiles, whole);
+
+      return;
+    }
+
+  data.buffer          = drawable_undo->buffer;
+  data.drawable_buffer = gimp_drawable_get_buffer (drawable);
+  data.x               = drawable_undo->x;
+  data.y               = drawable_undo->y;
+  data.format          = drawable_undo->format;
+
+  g_object_get (data.drawable_buffer,
+                "tile-width",  &data.tile_width,
+                "tile-height", &data.tile_height,
+                NULL);
+
+  data.n_tile_cols = (drawable_undo->width  + data.tile_width  - 1) /
+                     data.tile_width;
+  n_tile_rows      = (drawable_undo->height + data.tile_height - 1) /
+                     data.tile_height;
+  n_tiles          = data.n_tile_cols * n_tile_rows;
+
+  data.changed = g_new0 (gboolean, n_tiles);
+
+  gegl_parallel_distribute_range (
+    n_tiles, 4,
+    (GeglParallelDistributeRangeFunc) gimp_drawable_undo_diff_tiles,
+    &data);
+
+  /*  merge runs of changed tiles in each row into a single area  */
+  for (row = 0; row < n_tile_rows; row++)
+    {
+      GeglRectangle rect = { 0, };
+
+      for (i = row * data.n_tile_cols; i < (row + 1) * data.n_tile_cols; i++)
+        {
+          gint col = i % data.n_tile_cols;
+
+          if (! data.changed[i])
+            continue;
+
+          n_changed++;
+
+          if (rect.width > 0 && rect.x + rect.width == col * data.tile_width)
+            {
+              rect.width += data.tile_width;
+            }
+          else
+            {
+              if (rect.width > 0)
+                g_array_append_val (drawable_undo->tiles, rect);
+
+              rect.x      = col * data.tile_width;
+              rect.y      = row * data.tile_height;
+              rect.width  = data.tile_width;
+              rect.height = data.tile_height;
+            }
+        }
+
+      if (rect.width > 0)
+        g_array_append_val (drawable_undo->tiles, rect);
+    }
+
+  /*  clip the areas at the buffer's right and bottom edges  */
+  for (i = 0; i < drawable_undo->tiles->len; i++)
+    {
+      gegl_rectangle_intersect (&g_array_index (drawable_undo->tiles,
+                                                GeglRectangle, i),
+                                &g_array_index (drawable_undo->tiles,
+                                                GeglRectangle, i),
+                                &whole);
+    }
+
+  g_free (data.changed);
+
+  if (n_changed == n_tiles)
+    {
+      g_array_set_size (drawable_undo->tiles, 0);
+      g_array_append_val (drawable_undo->tiles, whole);
+
+      return;
+    }
+
+  /*  keep only the changed tiles.  the copy shares the tiles of the
+   *  original buffer instead of duplicating them
+   */
+  buffer = gegl_buffer_new (&whole, drawable_undo->format);
+
+  for (i = 0; i < drawable_undo->tiles->len; i++)
+    {
+      const GeglRectangle *rect = &g_array_index (drawable_undo->tiles,
+                                                  GeglRectangle, i);
+
+      gimp_gegl_buffer_copy (drawable_undo->buffer, rect, GEGL_ABYSS_NONE,
+                             buffer, rect);
+    }
+
+  g_object_unref (drawable_undo->buffer);
+  drawable_undo->buffer = buffer;
+}
+
+static gsize
+gimp_drawable_undo_get_raw_size (GimpDrawableUndo *drawable_undo)
+{
+  gint  bpp  = babl_format_get_bytes_per_pixel (drawable_undo->format);
+  gsize size = 0;
+  gint  i;
+
+  for (i = 0; i < drawable_undo->tiles->len; i++)
+    {
+      const GeglRectangle *rect = &g_array_index (drawable_undo->tiles,
+                                                  GeglRectangle, i);
+
+      size += (gsize) rect->width * rect->height * bpp;
+    }
+
+  return size;
+}
+
+static gboolean
+gimp_drawable_undo_load (GimpDrawableUndo  *drawable_undo,
+                         GError           **error)
+{
+  guchar *data;
+  gsize   size;
+  uLongf  data_size;
+  gsize   offset = 0;
+  gint    bpp;
+  gint    i;
+
+  if (drawable_undo->async && ! drawable_undo->buffer)
+    {
+      /*  the pixels are being spilled, let the spill finish rather
+       *  than racing it for the file
+       */
+      gimp_drawable_undo_wait (drawable_undo);
+    }
+
+  if (drawable_undo->async)
+    {
+      /*  the pixels are still there, don't bother with the result  */
+      gimp_async_cancel_and_wait (drawable_undo->async);
+      g_clear_object (&drawable_undo->async);
+    }
+
+  g_clear_object (&drawable_undo->swap_dir);
+
+  if (drawable_undo->buffer)
+    return TRUE;
+
+  if (drawable_undo->swap_file)
+    {
+      gchar *contents;
+      gsize  length;
+
+      if (! g_file_get_contents (drawable_undo->swap_file,
+                                 &contents, &length, error))
+        {
+          return FALSE;
+        }
+
+      g_unlink (drawable_undo->swap_file);
+      g_clear_pointer (&drawable_undo->swap_file, g_free);
+
+      drawable_undo->compressed = g_bytes_new_take (contents, length);
+    }
+
+  size = gimp_drawable_undo_get_raw_size (drawable_undo);
+  data = g_try_malloc (size);
+
+  data_size = size;
+
+  if (! data ||
+      uncompress (data, &data_size,
+                  g_bytes_get_data (drawable_undo->compressed, NULL),
+                  g_bytes_get_size (drawable_undo->compressed)) != Z_OK ||
+      data_size != size)
+    {
+      g_free (data);
+
+      g_set_error_literal (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                           _("Could not decompress undo data"));
+      return FALSE;
+    }
+
+  g_clear_pointer (&drawable_undo->compressed, g_bytes_unref);
+
+  drawable_undo->buffer =
+    gegl_buffer_new (GEGL_RECTANGLE (0, 0,
+                                     drawable_undo->width,
+                                     drawable_undo->height),
+                     drawable_undo->format);
+
+  bpp = babl_format_get_bytes_per_pixel (drawable_undo->format);
+
+  for (i = 0; i < drawable_undo->tiles->len; i++)
+    {
+      const GeglRectangle *rect = &g_array_index (drawable_undo->tiles,
+                                                  GeglRectangle, i);
+
+      gegl_buffer_set (drawable_undo->buffer, rect, 0,
+                       drawable_undo->format, data + offset,
+                       GEGL_AUTO_ROWSTRIDE);
+
+      offset += (gsize) rect->width * rect->height * bpp;
+    }
+
+  g_free (data);
+
+  return TRUE;
+}
+
+static void
+gimp_drawable_undo_compress_func (GimpAsync    *async,
+                                  CompressData *data)
+{
+  gint    bpp  = babl_format_get_bytes_per_pixel (data->format);
+  gsize   size = 0;
+  gsize   offset;
+  guchar *raw;
+  guchar *dest;
+  uLongf  dest_size;
+  gint    i;
+
+  for (i = 0; i < data->tiles->len; i++)
+    {
+      const GeglRectangle *rect = &g_array_index (data->tiles,
+                                                  GeglRectangle, i);
+
+      size += (gsize) rect->width * rect->height * bpp;
+    }
+
+  raw = g_try_malloc (size);
+
+  if (! raw)
+    {
+      compress_data_free (data);
+      gimp_async_abort (async);
+
+      return;
+    }
+
+  for (i = 0, offset = 0; i < data->tiles->len; i++)
+    {
+      const GeglRectangle *rect = &g_array_index (data->tiles,
+                                                  GeglRectangle, i);
+
+      if (gimp_async_is_canceled (async))
+        {
+          g_free (raw);
+          compress_data_free (data);
+          gimp_async_abort (async);
+
+          return;
+        }
+
+      gegl_buffer_get (data->buffer, rect, 1.0,
+                       data->format, raw + offset,
+                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+      offset += (gsize) rect->width * rect->height * bpp;
+    }
+
+  dest_size = compressBound (size);
+  dest      = g_try_malloc (dest_size);
+
+  if (! dest ||
+      compress2 (dest, &dest_size, raw, size, Z_BEST_SPEED) != Z_OK)
+    {
+      g_free (dest);
+      g_free (raw);
+      compress_data_free (data);
+      gimp_async_abort (async);
+
+      return;
+    }
+
+  g_free (raw);
+  compress_data_free (data);
+
+  gimp_async_finish_full (async,
+                          g_bytes_new_take (g_realloc (dest, dest_size),
+                                            dest_size),
+                          (GDestroyNotify) g_bytes_unref);
+}
+
+static void
+gimp_drawable_undo_compress_cb (GimpAsync        *async,
+                                GimpDrawableUndo *drawable_undo)
+{
+  if (gimp_async_is_canceled (async))
+    return;
+
+  if (gimp_async_is_finished (async))
+    {
+      drawable_undo->compressed = g_bytes_ref (gimp_async_get_result (async));
+
+      g_clear_object (&drawable_undo->buffer);
+    }
+
+  g_clear_object (&drawable_undo->async);
+
+  if (drawable_undo->swap_dir)
+    {
+      if (drawable_undo->compressed)
+        {
+          gimp_drawable_undo_start_spill (drawable_undo);
+        }
+      else
+        {
+          gimp_message_literal (GIMP_UNDO (drawable_undo)->image->gimp,
+                                NULL, GIMP_MESSAGE_WARNING,
+                                _("Could not compress undo data"));
+
+          g_clear_object (&drawable_undo->swap_dir);
+        }
+    }
+}
+
+static void
+compress_data_free (CompressData *data)
+{
+  g_object_unref (data->buffer);
+  g_array_unref (data->tiles);
+
+  g_slice_free (CompressData, data);
+}
+
+static void
+gimp_drawable_undo_start_spill (GimpDrawableUndo *drawable_undo)
+{
+  SpillData *data;
+
+  data = g_slice_new0 (SpillData);
+
+  data->compressed = g_bytes_ref (drawable_undo->compressed);
+  data->swap_dir   = g_object_ref (drawable_undo->swap_dir);
+
+  drawable_undo->async = gimp_parallel_run_async_full (
+    +1,
+    (GimpParallelRunAsyncFunc) gimp_drawable_undo_spill_func,
+    data, (GDestroyNotify) spill_data_free);
+
+  gimp_async_add_callback_for_object (
+    drawable_undo->async,
+    (GimpAsyncCallback) gimp_drawable_undo_spill_cb,
+    drawable_undo, drawable_undo);
+}
+
+/*  gimp_filename_to_utf8() and friends are not thread-safe, use
+ *  g_filename_display_name() in the worker instead
+ */
+static void
+gimp_drawable_undo_spill_func (GimpAsync *async,
+                               SpillData *data)
+{
+  gchar *path;
+  gchar *display_name;
+  gint   fd;
+
+  path = g_file_get_path (data->swap_dir);
+
+  if (! path)
+    {
+      g_set_error_literal (&data->error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                           _("The swap folder is not a local folder"));
+      goto out;
+    }
+
+  if (g_mkdir_with_parents (path, 0700) == -1)
+    {
+      display_name = g_filename_display_name (path);
+
+      g_set_error (&data->error, G_FILE_ERROR, g_file_error_from_errno (errno),
+                   _("Could not create folder '%s': %s"),
+                   display_name, g_strerror (errno));
+
+      g_free (display_name);
+      goto out;
+    }
+
+  data->filename = g_build_filename (path, "undo-XXXXXX", NULL);
+
+  fd = g_mkstemp (data->filename);
+
+  if (fd == -1)
+    {
+      display_name = g_filename_display_name (data->filename);
+
+      g_set_error (&data->error, G_FILE_ERROR, g_file_error_from_errno (errno),
+                   _("Could not create swap file '%s': %s"),
+                   display_name, g_strerror (errno));
+
+      g_free (display_name);
+      goto out;
+    }
+
+  g_close (fd, NULL);
+
+  if (! g_file_set_contents (data->filename,
+                             g_bytes_get_data (data->compressed, NULL),
+                             g_bytes_get_size (data->compressed),
+                             &data->error))
+    {
+      g_unlink (data->filename);
+    }
+
+ out:
+  g_free (path);
+
+  gimp_async_finish_full (async, data, (GDestroyNotify) spill_data_free);
+}
+
+static void
+gimp_drawable_undo_spill_cb (GimpAsync        *async,
+                             GimpDrawableUndo *drawable_undo)
+{
+  SpillData *data = NULL;
+
+  if (gimp_async_is_finished (async))
+    data = gimp_async_get_result (async);
+
+  if (! data)
+    {
+      /*  canceled before it started, keep the pixels in memory  */
+    }
+  else if (data->error)
+    {
+      gimp_message (GIMP_UNDO (drawable_undo)->image->gimp,
+                    NULL, GIMP_MESSAGE_WARNING,
+                    _("Could not move undo data to disk: %s"),
+                    data->error->message);
+    }
+  else
+    {
+      drawable_undo->swap_file = g_steal_pointer (&data->filename);
+
+      g_clear_pointer (&drawable_undo->compressed, g_bytes_unref);
+    }
+
+  g_clear_object (&drawable_undo->swap_dir);
+  g_clear_object (&drawable_undo->async);
+}
+
+static void
+spill_data_free (SpillData *data)
+{
+  g_bytes_unref (data->compressed);
+  g_object_unref (data->swap_dir);
+  g_free (data->filename);
+  g_clear_error (&data->error);
+
+  g_slice_free (SpillData, data);
+}
+
+/*  removes a swap directory and the swap files in it  */
+static void
+gimp_drawable_undo_remove_dir (const gchar *path)
+{
+  GDir        *dir;
+  const gchar *name;
+
+  dir = g_dir_open (path, 0, NULL);
+
+  if (! dir)
+    return;
+
+  while ((name = g_dir_read_name (dir)))
+    {
+      gchar *filename = g_build_filename (path, name, NULL);
+
+      g_unlink (filename);
+      g_free (filename);
+    }
+
+  g_dir_close (dir);
+
+  g_rmdir (path);
+}
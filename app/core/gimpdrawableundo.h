@@ -40,6 +40,17 @@ struct _GimpDrawableUndo
   GeglBuffer   *buffer;
   gint          x;
   gint          y;
+  gboolean      sparse;
+
+  gint          width;
+  gint          height;
+  const Babl   *format;
+  GArray       *tiles;       /*  changed areas, or NULL for the whole buffer  */
+
+  GimpAsync    *async;       /*  pending background compression or spill    */
+  GBytes       *compressed;  /*  compressed pixels of the changed areas      */
+  gchar        *swap_file;   /*  compressed pixels, spilled to disk          */
+  GFile        *swap_dir;    /*  where a pending spill goes                  */
 };
 
 struct _GimpDrawableUndoClass
@@ -48,7 +59,17 @@ struct _GimpDrawableUndoClass
 };
 
 
-GType   gimp_drawable_undo_get_type (void) G_GNUC_CONST;
+GType      gimp_drawable_undo_get_type     (void) G_GNUC_CONST;
+
+void       gimp_drawable_undo_compress     (GimpDrawableUndo *undo);
+gboolean   gimp_drawable_undo_spill        (GimpDrawableUndo *undo,
+                                            GFile            *swap_dir);
+gboolean   gimp_drawable_undo_is_spilled   (GimpDrawableUndo *undo);
+void       gimp_drawable_undo_wait         (GimpDrawableUndo *undo);
+
+GFile    * gimp_drawable_undo_get_swap_dir (Gimp             *gimp);
+void       gimp_drawable_undo_swap_init    (Gimp             *gimp);
+void       gimp_drawable_undo_swap_exit    (Gimp             *gimp);
 
 
 #endif /* __GIMP_DRAWABLE_UNDO_H__ */
@@ -169,6 +169,19 @@
 #include "gimp-intl.h"
 
 
+#define PIXELS_PER_THREAD \
+  (/* each thread costs as much as */ 64.0 * 64.0 /* pixels */)
+
+/*  a thread building the rgb histogram has to zero and merge a private
+ *  histogram of HIST_R_ELEMS * HIST_G_ELEMS * HIST_B_ELEMS cells
+ */
+#define HISTOGRAM_PIXELS_PER_THREAD \
+  (/* each thread costs as much as */ 1024.0 * 1024.0 /* pixels */)
+
+/*  rows converted to L*a*b* at once ahead of the floyd-steinberg scan  */
+#define FS_BLOCK_ROWS 64
+
+
 /* basic memory/quality tradeoff */
 #define PRECISION_R 8
 #define PRECISION_G 6
@@ -314,9 +327,28 @@ HIST_LIN (ColorFreq  *hist_ptr,
 #define BRAT (1.0F)
 #endif
 
+/*  the fishes are created once and are immutable afterwards, so
+ *  they can be shared by concurrent conversions and worker threads
+ */
 static const Babl *rgb_to_lab_fish = NULL;
 static const Babl *lab_to_rgb_fish = NULL;
 
+static void
+init_lab_fishes (void)
+{
+  static gsize initialized = 0;
+
+  if (g_once_init_enter (&initialized))
+    {
+      rgb_to_lab_fish = babl_fish (babl_format ("R'G'B' float"),
+                                   babl_format ("CIE Lab float"));
+      lab_to_rgb_fish = babl_fish (babl_format ("CIE Lab float"),
+                                   babl_format ("R'G'B' float"));
+
+      g_once_init_leave (&initialized, 1);
+    }
+}
+
 static inline void
 rgb_to_unshifted_lin (const guchar  r,
                       const guchar  g,
@@ -487,6 +519,10 @@ struct _QuantizeObj
   gboolean      want_dither_alpha;
   gint          error_freedom;            /* 0=much bleed, 1=controlled bleed */
 
+  gboolean      needs_quantize;           /* more colors than allowed found    */
+  gint          num_found_cols;           /* number of distinct colors found   */
+  guchar        found_cols[MAXNUMCOLORS][3]; /* .. in order of appearance      */
+
   GimpProgress *progress;
 };
 
@@ -515,17 +551,100 @@ typedef struct
 
 } box, *boxptr;
 
+/*  progress of a parallel pass over a layer; the worker threads only
+ *  count the pixels they're done with, the progress itself is updated
+ *  from the main thread's share of the work
+ */
+typedef struct
+{
+  GimpProgress *progress;
+  gsize         n_pixels;
+  gsize         n_done;           /* updated atomically                       */
+} ParallelProgress;
+
+typedef struct
+{
+  gint          offset;           /* index of the band's first tile row       */
+  gint          num_found_cols;   /* > col_limit if the band has too many     */
+  guchar        found_cols[MAXNUMCOLORS][3];
+} HistogramBand;
+
+typedef struct
+{
+  GeglBuffer   *buffer;
+  const Babl   *format;
+  CFHistogram   histogram;        /* the shared histogram                     */
+  gint          width;
+  gint          height;
+  gint          band_height;
+  gint          n_bands;
+  gint          offsetx;
+  gint          offsety;
+  gint          col_limit;
+  gboolean      dither_alpha;
+  gboolean      track_colors;
+
+  ParallelProgress progress;
+
+  GMutex        mutex;            /* protects histogram and bands             */
+  GSList       *bands;
+} HistogramData;
+
+typedef struct
+{
+  GHashTable   *cells;            /* cache cells missing from the histogram   */
+  gulong        index_used_count[256];
+} RemapCache;
+
+typedef struct
+{
+  QuantizeObj  *quantobj;
+  GeglBuffer   *src_buffer;
+  GeglBuffer   *dest_buffer;
+  gint          src_bpp;
+  gint          dest_bpp;
+  gboolean      has_alpha;
+  gboolean      dither_alpha;
+  gint          red_pix;
+  gint          green_pix;
+  gint          blue_pix;
+  gint          alpha_pix;
+  gint          offsetx;
+  gint          offsety;
+
+  ParallelProgress progress;
+
+  GMutex        mutex;            /* protects caches                          */
+  GSList       *caches;
+} RemapData;
+
+typedef struct
+{
+  const guchar *src;
+  gint          src_bpp;
+  gint          red_pix;
+  gint          green_pix;
+  gint          blue_pix;
+  gint         *lin;              /* unshifted L*a*b* triplets of src         */
+} LinBlockData;
+
 
 static void          zero_histogram_gray     (CFHistogram   histogram);
 static void          zero_histogram_rgb      (CFHistogram   histogram);
 static void          generate_histogram_gray (CFHistogram   hostogram,
                                               GimpLayer    *layer,
                                               gboolean      dither_alpha);
-static void          generate_histogram_rgb  (CFHistogram   histogram,
+static void          generate_histogram_rgb  (QuantizeObj  *quantobj,
                                               GimpLayer    *layer,
                                               gint          col_limit,
-                                              gboolean      dither_alpha,
-                                              GimpProgress *progress);
+                                              gboolean      dither_alpha);
+
+static void          parallel_progress_init   (ParallelProgress *progress,
+                                               GimpProgress     *gimp_progress,
+                                               gsize             n_pixels);
+static void          parallel_progress_update (ParallelProgress *progress,
+                                               gsize             n_pixels,
+                                               gint             *count);
 
 static QuantizeObj * initialize_median_cut   (GimpImageBaseType      old_type,
                                               gint                   max_colors,
@@ -541,11 +660,6 @@ static void          compute_color_lin8      (QuantizeObj           *quantobj,
                                               const int              icolor);
 
 
-static guchar    found_cols[MAXNUMCOLORS][3];
-static gint      num_found_cols;
-static gboolean  needs_quantize;
-
-
 /**********************************************************/
 typedef struct
 {
@@ -819,10 +933,7 @@ gimp_image_convert_indexed (GimpImage               *image,
     }
 
   /*  Build histogram if necessary.  */
-  rgb_to_lab_fish = babl_fish (babl_format ("R'G'B' float"),
-                               babl_format ("CIE Lab float"));
-  lab_to_rgb_fish = babl_fish (babl_format ("CIE Lab float"),
-                               babl_format ("R'G'B' float"));
+  init_lab_fishes ();
 
   /* don't dither if the input is grayscale and we are simply mapping
    * every color
@@ -858,8 +969,8 @@ gimp_image_convert_indexed (GimpImage               *image,
        *  than the user actually asked for.  In that case, we don't
        *  need to quantize or color-dither.
        */
-      needs_quantize = FALSE;
-      num_found_cols = 0;
+      quantobj->needs_quantize = FALSE;
+      quantobj->num_found_cols = 0;
 
       /*  Build the histogram  */
       for (list = all_layers;
@@ -882,9 +993,8 @@ gimp_image_convert_indexed (GimpImage               *image,
                * if the image contains more colors than the limit
                * specified by the user.
                */
-              generate_histogram_rgb (quantobj->histogram,
-                                      layer, max_colors, dither_alpha,
-                                      sub_progress);
+              generate_histogram_rgb (quantobj, layer,
+                                      max_colors, dither_alpha);
             }
         }
     }
@@ -893,11 +1003,12 @@ gimp_image_convert_indexed (GimpImage               *image,
     gimp_progress_set_text_literal (progress,
                                     _("Converting to indexed colors (stage 2)"));
 
-  if (old_type == GIMP_RGB &&
-      ! needs_quantize     &&
+  if (old_type == GIMP_RGB          &&
+      ! quantobj->needs_quantize    &&
       palette_type == GIMP_CONVERT_PALETTE_GENERATE)
     {
-      gint i;
+      QuantizeObj *old_quantobj = quantobj;
+      gint         i;
 
       /*  If this is an RGB image, and the user wanted a custom-built
        *  generated palette, and this image has no more colors than
@@ -910,7 +1021,6 @@ gimp_image_convert_indexed (GimpImage               *image,
        *  no-dither remapper.
        */
 
-      quantobj->delete_func (quantobj);
       quantobj = initialize_median_cut (old_type, max_colors,
                                         GIMP_CONVERT_DITHER_NODESTRUCT,
                                         palette_type,
@@ -919,13 +1029,15 @@ gimp_image_convert_indexed (GimpImage               *image,
                                         sub_progress);
       /* We can skip the first pass (palette creation) */
 
-      quantobj->actual_number_of_colors = num_found_cols;
-      for (i = 0; i < num_found_cols; i++)
+      quantobj->actual_number_of_colors = old_quantobj->num_found_cols;
+      for (i = 0; i < old_quantobj->num_found_cols; i++)
         {
-          quantobj->cmap[i].red   = found_cols[i][0];
-          quantobj->cmap[i].green = found_cols[i][1];
-          quantobj->cmap[i].blue  = found_cols[i][2];
+          quantobj->cmap[i].red   = old_quantobj->found_cols[i][0];
+          quantobj->cmap[i].green = old_quantobj->found_cols[i][1];
+          quantobj->cmap[i].blue  = old_quantobj->found_cols[i][2];
         }
+
+      old_quantobj->delete_func (old_quantobj);
     }
   else
     {
@@ -1091,6 +1203,42 @@ gimp_image_convert_indexed (GimpImage               *image,
  *  Indexed color conversion machinery
  */
 
+static void
+parallel_progress_init (ParallelProgress *progress,
+                        GimpProgress     *gimp_progress,
+                        gsize             n_pixels)
+{
+  progress->progress = gimp_progress;
+  progress->n_pixels = MAX (n_pixels, 1);
+  progress->n_done   = 0;
+
+  if (progress->progress)
+    gimp_progress_set_value (progress->progress, 0.0);
+}
+
+/*  called by each thread after it's done with 'n_pixels' more pixels;
+ *  'count' is the thread's own counter of calls
+ */
+static void
+parallel_progress_update (ParallelProgress *progress,
+                          gsize             n_pixels,
+                          gint             *count)
+{
+  gsize n_done;
+
+  n_done = (gsize) g_atomic_pointer_add (&progress->n_done, n_pixels) +
+           n_pixels;
+
+  if (progress->progress     &&
+      (++(*count) % 16 == 0) &&
+      gegl_is_main_thread ())
+    {
+      gimp_progress_set_value (progress->progress,
+                               (gdouble) n_done /
+                               (gdouble) progress->n_pixels);
+    }
+}
+
 static void
 zero_histogram_gray (CFHistogram histogram)
 {
@@ -1110,256 +1258,346 @@ zero_histogram_rgb (CFHistogram histogram)
 
 
 static void
-generate_histogram_gray (CFHistogram  histogram,
-                         GimpLayer   *layer,
-                         gboolean     dither_alpha)
+generate_histogram_gray_area (const GeglRectangle *area,
+                              HistogramData       *data)
 {
   GeglBufferIterator *iter;
-  const Babl         *format;
+  ColorFreq           histogram[256] = { 0, };
   gint                bpp;
   gboolean            has_alpha;
+  gint                i;
 
-  format = gimp_drawable_get_format (GIMP_DRAWABLE (layer));
-
-  g_return_if_fail (format == babl_format ("Y' u8") ||
-                    format == babl_format ("Y'A u8"));
-
-  bpp       = babl_format_get_bytes_per_pixel (format);
-  has_alpha = babl_format_has_alpha (format);
+  bpp       = babl_format_get_bytes_per_pixel (data->format);
+  has_alpha = babl_format_has_alpha (data->format);
 
-  iter = gegl_buffer_iterator_new (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
-                                   NULL, 0, format,
+  iter = gegl_buffer_iterator_new (data->buffer,
+                                   area, 0, data->format,
                                    GEGL_ACCESS_READ, GEGL_ABYSS_NONE, 1);
 
   while (gegl_buffer_iterator_next (iter))
     {
-      const guchar *data   = iter->items[0].data;
+      const guchar *src    = iter->items[0].data;
       gint          length = iter->length;
 
       if (has_alpha)
         {
           while (length--)
             {
-              if (data[ALPHA_G] > 127)
-                histogram[*data]++;
+              if (src[ALPHA_G] > 127)
+                histogram[*src]++;
 
-              data += bpp;
+              src += bpp;
             }
         }
       else
         {
           while (length--)
             {
-              histogram[*data]++;
+              histogram[*src]++;
 
-              data += bpp;
+              src += bpp;
             }
         }
     }
+
+  g_mutex_lock (&data->mutex);
+
+  for (i = 0; i < 256; i++)
+    data->histogram[i] += histogram[i];
+
+  g_mutex_unlock (&data->mutex);
 }
 
+static void
+generate_histogram_gray (CFHistogram  histogram,
+                         GimpLayer   *layer,
+                         gboolean     dither_alpha)
+{
+  HistogramData data = { 0, };
+
+  data.buffer    = gimp_drawable_get_buffer (GIMP_DRAWABLE (layer));
+  data.format    = gimp_drawable_get_format (GIMP_DRAWABLE (layer));
+  data.histogram = histogram;
+
+  g_return_if_fail (data.format == babl_format ("Y' u8") ||
+                    data.format == babl_format ("Y'A u8"));
+
+  g_mutex_init (&data.mutex);
+
+  gegl_parallel_distribute_area (
+    gegl_buffer_get_extent (data.buffer), PIXELS_PER_THREAD,
+    GEGL_SPLIT_STRATEGY_AUTO,
+    (GeglParallelDistributeAreaFunc) generate_histogram_gray_area,
+    &data);
+
+  g_mutex_clear (&data.mutex);
+}
+
+
+/*  The RGB histogram is built from horizontal bands of whole tile rows,
+ *  so that each band visits its pixels in the same order a single
+ *  iterator over the whole layer would.  Besides the counts, every band
+ *  records the colors it has seen in order of appearance; merging those
+ *  lists in band order afterwards yields exactly the found_cols a serial
+ *  scan would have produced, which matters because the palette is later
+ *  sorted with ties left in discovery order.
+ */
 
 static void
-generate_histogram_rgb (CFHistogram   histogram,
-                        GimpLayer    *layer,
-                        gint          col_limit,
-                        gboolean      dither_alpha,
-                        GimpProgress *progress)
+generate_histogram_rgb_range (gsize          offset,
+                              gsize          size,
+                              HistogramData *data)
 {
   GeglBufferIterator *iter;
-  const Babl         *format;
   GeglRectangle      *roi;
-  ColorFreq          *colfreq;
-  gint                nfc_iter;
-  gint                row, col, coledge;
-  gint                offsetx, offsety;
-  glong               layer_size;
-  glong               total_size = 0;
-  gint                count      = 0;
+  GeglRectangle       area;
+  CFHistogram         histogram;
+  HistogramBand      *band  = NULL;
+  gint                count = 0;
   gint                bpp;
   gboolean            has_alpha;
 
-  format = gimp_drawable_get_format (GIMP_DRAWABLE (layer));
-
-  g_return_if_fail (format == babl_format ("R'G'B' u8") ||
-                    format == babl_format ("R'G'B'A u8"));
+  area.x      = 0;
+  area.y      = offset * data->band_height;
+  area.width  = data->width;
+  area.height = MIN (size * data->band_height, data->height - area.y);
 
-  bpp       = babl_format_get_bytes_per_pixel (format);
-  has_alpha = babl_format_has_alpha (format);
+  /*  a single band covering the whole layer counts straight into the
+   *  shared histogram, everything else uses a private one
+   */
+  if (size == (gsize) data->n_bands)
+    histogram = data->histogram;
+  else
+    histogram = g_new0 (ColorFreq,
+                        HIST_R_ELEMS * HIST_G_ELEMS * HIST_B_ELEMS);
 
-  gimp_item_get_offset (GIMP_ITEM (layer), &offsetx, &offsety);
+  if (data->track_colors)
+    {
+      band = g_new (HistogramBand, 1);
 
-  layer_size = (gimp_item_get_width  (GIMP_ITEM (layer)) *
-                gimp_item_get_height (GIMP_ITEM (layer)));
+      band->offset         = offset;
+      band->num_found_cols = 0;
+    }
 
-  /*  g_printerr ("col_limit = %d, nfc = %d\n", col_limit, num_found_cols); */
+  bpp       = babl_format_get_bytes_per_pixel (data->format);
+  has_alpha = babl_format_has_alpha (data->format);
 
-  iter = gegl_buffer_iterator_new (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
-                                   NULL, 0, format,
+  iter = gegl_buffer_iterator_new (data->buffer,
+                                   &area, 0, data->format,
                                    GEGL_ACCESS_READ, GEGL_ABYSS_NONE, 1);
   roi = &iter->items[0].roi;
 
-  if (progress)
-    gimp_progress_set_value (progress, 0.0);
-
   while (gegl_buffer_iterator_next (iter))
     {
-      const guchar *data   = iter->items[0].data;
+      const guchar *src    = iter->items[0].data;
       gint          length = iter->length;
+      gint          col, coledge, row;
 
-      total_size += length;
-
-      /* g_printerr (" [%d,%d - %d,%d]", srcPR.x, src_roi->y, offsetx, offsety); */
+      /* if alpha-dithering, we need to be deterministic w.r.t. offsets */
+      col     = roi->x + data->offsetx;
+      coledge = col + roi->width;
+      row     = roi->y + data->offsety;
 
-      if (needs_quantize)
+      while (length--)
         {
-          if (dither_alpha)
-            {
-              /* if alpha-dithering,
-                 we need to be deterministic w.r.t. offsets */
-
-              col = roi->x + offsetx;
-              coledge = col + roi->width;
-              row = roi->y + offsety;
+          gboolean transparent = FALSE;
 
-              while (length--)
+          if (has_alpha)
+            {
+              if (data->dither_alpha)
                 {
-                  gboolean transparent = FALSE;
-
-                  if (has_alpha &&
-                      data[ALPHA] <
+                  if (src[ALPHA] <
                       DM[col & DM_WIDTHMASK][row & DM_HEIGHTMASK])
                     transparent = TRUE;
+                }
+              else
+                {
+                  if (src[ALPHA] <= 127)
+                    transparent = TRUE;
+                }
+            }
+
+          if (! transparent)
+            {
+              ColorFreq *colfreq;
+
+              colfreq = HIST_RGB (histogram, src[RED], src[GREEN], src[BLUE]);
+              (*colfreq)++;
 
-                  if (! transparent)
+              if (band && band->num_found_cols <= data->col_limit)
+                {
+                  gint nfc_iter;
+
+                  for (nfc_iter = 0;
+                       nfc_iter < band->num_found_cols;
+                       nfc_iter++)
                     {
-                      colfreq = HIST_RGB (histogram,
-                                          data[RED],
-                                          data[GREEN],
-                                          data[BLUE]);
-                      (*colfreq)++;
+                      if ((src[RED]   == band->found_cols[nfc_iter][0]) &&
+                          (src[GREEN] == band->found_cols[nfc_iter][1]) &&
+                          (src[BLUE]  == band->found_cols[nfc_iter][2]))
+                        goto already_found;
                     }
 
-                  col++;
-                  if (col == coledge)
+                  /*  Remember the new color, unless this band alone
+                   *  already has more colors than were allowed
+                   */
+                  if (band->num_found_cols < data->col_limit)
                     {
-                      col = roi->x + offsetx;
-                      row++;
+                      band->found_cols[band->num_found_cols][0] = src[RED];
+                      band->found_cols[band->num_found_cols][1] = src[GREEN];
+                      band->found_cols[band->num_found_cols][2] = src[BLUE];
                     }
 
-                  data += bpp;
+                  band->num_found_cols++;
                 }
             }
-          else
-            {
-              while (length--)
-                {
-                  if ((has_alpha && ((data[ALPHA] > 127)))
-                      || (!has_alpha))
-                    {
-                      colfreq = HIST_RGB (histogram,
-                                          data[RED],
-                                          data[GREEN],
-                                          data[BLUE]);
-                      (*colfreq)++;
-                    }
+        already_found:
 
-                  data += bpp;
-                }
+          col++;
+          if (col == coledge)
+            {
+              col = roi->x + data->offsetx;
+              row++;
             }
+
+          src += bpp;
         }
-      else
+
+      parallel_progress_update (&data->progress, iter->length, &count);
+    }
+
+  if (histogram != data->histogram || band)
+    {
+      g_mutex_lock (&data->mutex);
+
+      if (histogram != data->histogram)
         {
-          /* if alpha-dithering, we need to be deterministic w.r.t. offsets */
-          col = roi->x + offsetx;
-          coledge = col + roi->width;
-          row = roi->y + offsety;
+          gint i;
 
-          while (length--)
-            {
-              gboolean transparent = FALSE;
+          for (i = 0; i < HIST_R_ELEMS * HIST_G_ELEMS * HIST_B_ELEMS; i++)
+            data->histogram[i] += histogram[i];
+        }
 
-              if (has_alpha)
-                {
-                  if (dither_alpha)
-                    {
-                      if (data[ALPHA] <
-                          DM[col & DM_WIDTHMASK][row & DM_HEIGHTMASK])
-                        transparent = TRUE;
-                    }
-                  else
-                    {
-                      if (data[ALPHA] <= 127)
-                        transparent = TRUE;
-                    }
-                }
+      if (band)
+        data->bands = g_slist_prepend (data->bands, band);
 
-              if (! transparent)
-                {
-                  colfreq = HIST_RGB (histogram,
-                                      data[RED],
-                                      data[GREEN],
-                                      data[BLUE]);
-                  (*colfreq)++;
+      g_mutex_unlock (&data->mutex);
+    }
 
-                  if (!needs_quantize)
-                    {
-                      for (nfc_iter = 0;
-                           nfc_iter < num_found_cols;
-                           nfc_iter++)
-                        {
-                          if ((data[RED]   == found_cols[nfc_iter][0]) &&
-                              (data[GREEN] == found_cols[nfc_iter][1]) &&
-                              (data[BLUE]  == found_cols[nfc_iter][2]))
-                            goto already_found;
-                        }
+  if (histogram != data->histogram)
+    g_free (histogram);
+}
 
-                      /* Color was not in the table of
-                       * existing colors
-                       */
+static gint
+histogram_band_compare (const HistogramBand *band1,
+                        const HistogramBand *band2)
+{
+  return band1->offset - band2->offset;
+}
+
+static void
+generate_histogram_rgb (QuantizeObj  *quantobj,
+                        GimpLayer    *layer,
+                        gint          col_limit,
+                        gboolean      dither_alpha)
+{
+  HistogramData  data = { 0, };
+  GSList        *list;
 
-                      num_found_cols++;
+  data.buffer    = gimp_drawable_get_buffer (GIMP_DRAWABLE (layer));
+  data.format    = gimp_drawable_get_format (GIMP_DRAWABLE (layer));
+  data.histogram = quantobj->histogram;
 
-                      if (num_found_cols > col_limit)
-                        {
-                          /* There are more colors in the image than
-                           *  were allowed.  We switch to plain
-                           *  histogram calculation with a view to
-                           *  quantizing at a later stage.
-                           */
-                          needs_quantize = TRUE;
-                          /* g_print ("\nmax colors exceeded - needs quantize.\n");*/
-                          goto already_found;
-                        }
-                      else
-                        {
-                          /* Remember the new color we just found.
-                           */
-                          found_cols[num_found_cols-1][0] = data[RED];
-                          found_cols[num_found_cols-1][1] = data[GREEN];
-                          found_cols[num_found_cols-1][2] = data[BLUE];
-                        }
-                    }
-                }
-            already_found:
+  g_return_if_fail (data.format == babl_format ("R'G'B' u8") ||
+                    data.format == babl_format ("R'G'B'A u8"));
 
-              col++;
-              if (col == coledge)
-                {
-                  col = roi->x + offsetx;
-                  row++;
-                }
+  gimp_item_get_offset (GIMP_ITEM (layer), &data.offsetx, &data.offsety);
 
-              data += bpp;
+  data.width        = gimp_item_get_width  (GIMP_ITEM (layer));
+  data.height       = gimp_item_get_height (GIMP_ITEM (layer));
+  data.col_limit    = col_limit;
+  data.dither_alpha = dither_alpha;
+
+  /*  Once there are too many colors we switch to plain histogram
+   *  calculation with a view to quantizing at a later stage.
+   */
+  data.track_colors = ! quantobj->needs_quantize;
+
+  g_object_get (data.buffer,
+                "tile-height", &data.band_height,
+                NULL);
+
+  data.n_bands = (data.height + data.band_height - 1) / data.band_height;
+
+  if (data.n_bands < 1)
+    return;
+
+  parallel_progress_init (&data.progress, quantobj->progress,
+                          (gsize) data.width * data.height);
+
+  g_mutex_init (&data.mutex);
+
+  /*  every extra band costs a private histogram, make it worth it  */
+  gegl_parallel_distribute_range (
+    data.n_bands,
+    MAX (HISTOGRAM_PIXELS_PER_THREAD /
+         MAX ((gdouble) data.width * data.band_height, 1.0), 1),
+    (GeglParallelDistributeRangeFunc) generate_histogram_rgb_range,
+    &data);
+
+  g_mutex_clear (&data.mutex);
+
+  data.bands = g_slist_sort (data.bands,
+                             (GCompareFunc) histogram_band_compare);
+
+  for (list = data.bands; list; list = g_slist_next (list))
+    {
+      HistogramBand *band = list->data;
+      gint           i;
+
+      if (band->num_found_cols > col_limit)
+        quantobj->needs_quantize = TRUE;
+
+      for (i = 0; i < band->num_found_cols && ! quantobj->needs_quantize; i++)
+        {
+          gint nfc_iter;
+
+          for (nfc_iter = 0;
+               nfc_iter < quantobj->num_found_cols;
+               nfc_iter++)
+            {
+              if ((band->found_cols[i][0] == quantobj->found_cols[nfc_iter][0]) &&
+                  (band->found_cols[i][1] == quantobj->found_cols[nfc_iter][1]) &&
+                  (band->found_cols[i][2] == quantobj->found_cols[nfc_iter][2]))
+                break;
             }
-        }
 
-      if (progress && (count % 16 == 0))
-        gimp_progress_set_value (progress,
-                                 (gdouble) total_size / (gdouble) layer_size);
+          if (nfc_iter < quantobj->num_found_cols)
+            continue;
+
+          /* Color was not in the table of existing colors */
+
+          quantobj->num_found_cols++;
+
+          if (quantobj->num_found_cols > col_limit)
+            {
+              /* There are more colors in the image than were allowed */
+              quantobj->needs_quantize = TRUE;
+            }
+          else
+            {
+              /* Remember the new color we just found */
+              quantobj->found_cols[quantobj->num_found_cols - 1][0] =
+                band->found_cols[i][0];
+              quantobj->found_cols[quantobj->num_found_cols - 1][1] =
+                band->found_cols[i][1];
+              quantobj->found_cols[quantobj->num_found_cols - 1][2] =
+                band->found_cols[i][2];
+            }
+        }
     }
 
-/*  g_print ("O: col_limit = %d, nfc = %d\n", col_limit, num_found_cols);*/
+  g_slist_free_full (data.bands, g_free);
 }
 
 
@@ -2652,36 +2890,46 @@ find_best_colors (QuantizeObj *quantobj,
 }
 
 
-/* Fill the inverse-colormap entries in the update box that contains
- * histogram cell R/G/B.  (Only that one cell MUST be filled, but we
- * can fill as many others as we wish.)
+/* Find the closest colormap index for each cell in the update box that
+ * contains histogram cell R/G/B, and return the box's base cell in R/G/B.
  */
 static void
-fill_inverse_cmap_gray (QuantizeObj *quantobj,
-                        CFHistogram  histogram,
-                        gint         pixel)
+find_inverse_cmap_box_rgb (QuantizeObj *quantobj,
+                           gint        *R,
+                           gint        *G,
+                           gint        *B,
+                           gint        *bestcolor)
 {
-  Color *cmap = quantobj->cmap;
-  glong  mindist;
-  gint   mindisti;
-  gint   i;
+  gint  minR, minG, minB; /* lower left corner of update box */
+  /* This array lists the candidate colormap indexes. */
+  gint  colorlist[MAXNUMCOLORS];
+  gint  numcolors;                /* number of candidate colors */
 
-  mindist  = 65536;
-  mindisti = -1;
+  /* Convert cell coordinates to update box id */
+  *R >>= BOX_R_LOG;
+  *G >>= BOX_G_LOG;
+  *B >>= BOX_B_LOG;
 
-  for (i = 0; i < quantobj->actual_number_of_colors; i++)
-    {
-      glong dist = ABS (pixel - cmap[i].red);
+  /* Compute true coordinates of update box's origin corner.
+   * Actually we compute the coordinates of the center of the corner
+   * histogram cell, which are the lower bounds of the volume we care about.
+   */
+  minR = (*R << BOX_R_SHIFT) + ((1 << R_SHIFT) >> 1);
+  minG = (*G << BOX_G_SHIFT) + ((1 << G_SHIFT) >> 1);
+  minB = (*B << BOX_B_SHIFT) + ((1 << B_SHIFT) >> 1);
 
-      if (dist < mindist)
-        {
-          mindist  = dist;
-          mindisti = i;
-        }
-    }
+  /* Determine which colormap entries are close enough to be candidates
+   * for the nearest entry to some cell in the update box.
+   */
+  numcolors = find_nearby_colors (quantobj, minR, minG, minB, colorlist);
 
-  if (i >= 0)
-    histogram[pixel] = mindisti + 1;
+  /* Determine the actually nearest colors. */
+  find_best_colors (quantobj, minR, minG, minB, numcolors, colorlist,
+                    bestcolor);
+
+  *R <<= BOX_R_LOG;             /* convert id back to base cell indexes */
+  *G <<= BOX_G_LOG;
+  *B <<= BOX_B_LOG;
 }
 
 
@@ -2696,41 +2944,14 @@ fill_inverse_cmap_rgb (QuantizeObj *quantobj,
                        gint         G,
                        gint         B)
 {
-  gint  minR, minG, minB; /* lower left corner of update box */
   gint  iR, iG, iB;
   gint *cptr;           /* pointer into bestcolor[] array */
-  /* This array lists the candidate colormap indexes. */
-  gint  colorlist[MAXNUMCOLORS];
-  gint  numcolors;                /* number of candidate colors */
   /* This array holds the actually closest colormap index for each cell. */
   gint  bestcolor[BOX_R_ELEMS * BOX_G_ELEMS * BOX_B_ELEMS] = { 0, };
 
-  /* Convert cell coordinates to update box id */
-  R >>= BOX_R_LOG;
-  G >>= BOX_G_LOG;
-  B >>= BOX_B_LOG;
-
-  /* Compute true coordinates of update box's origin corner.
-   * Actually we compute the coordinates of the center of the corner
-   * histogram cell, which are the lower bounds of the volume we care about.
-   */
-  minR = (R << BOX_R_SHIFT) + ((1 << R_SHIFT) >> 1);
-  minG = (G << BOX_G_SHIFT) + ((1 << G_SHIFT) >> 1);
-  minB = (B << BOX_B_SHIFT) + ((1 << B_SHIFT) >> 1);
-
-  /* Determine which colormap entries are close enough to be candidates
-   * for the nearest entry to some cell in the update box.
-   */
-  numcolors = find_nearby_colors (quantobj, minR, minG, minB, colorlist);
-
-  /* Determine the actually nearest colors. */
-  find_best_colors (quantobj, minR, minG, minB, numcolors, colorlist,
-                    bestcolor);
+  find_inverse_cmap_box_rgb (quantobj, &R, &G, &B, bestcolor);
 
   /* Save the best color numbers (plus 1) in the main cache array */
-  R <<= BOX_R_LOG;              /* convert id back to base cell indexes */
-  G <<= BOX_G_LOG;
-  B <<= BOX_B_LOG;
   cptr = bestcolor;
   for (iR = 0; iR < BOX_R_ELEMS; iR++)
     {
@@ -2745,6 +2966,153 @@ fill_inverse_cmap_rgb (QuantizeObj *quantobj,
 }
 
 
+/*  The non-diffusing rgb remappers run in parallel over the layer.  While
+ *  they run, the inverse-colormap cache in quantobj->histogram is only
+ *  read; cells missing from it are looked up in, and filled into, a
+ *  per-thread RemapCache, and all of them are folded back into the
+ *  shared cache (and index_used_count) once the layer is done.  Since a
+ *  cell's entry only depends on the colormap, the result is the same
+ *  as filling the shared cache on the fly.
+ */
+
+static void
+remap_data_init (RemapData   *data,
+                 QuantizeObj *quantobj,
+                 GimpLayer   *layer,
+                 GeglBuffer  *new_buffer)
+{
+  const Babl *src_format = gimp_drawable_get_format (GIMP_DRAWABLE (layer));
+
+  data->quantobj     = quantobj;
+  data->src_buffer   = gimp_drawable_get_buffer (GIMP_DRAWABLE (layer));
+  data->dest_buffer  = new_buffer;
+  data->src_bpp      = babl_format_get_bytes_per_pixel (src_format);
+  data->dest_bpp     = babl_format_get_bytes_per_pixel (gegl_buffer_get_format (new_buffer));
+  data->has_alpha    = babl_format_has_alpha (src_format);
+  data->dither_alpha = quantobj->want_dither_alpha;
+  data->red_pix      = RED;
+  data->green_pix    = GREEN;
+  data->blue_pix     = BLUE;
+  data->alpha_pix    = ALPHA;
+  data->caches       = NULL;
+
+  gimp_item_get_offset (GIMP_ITEM (layer), &data->offsetx, &data->offsety);
+
+  parallel_progress_init (&data->progress, quantobj->progress,
+                          (gsize) gegl_buffer_get_width  (data->src_buffer) *
+                          gegl_buffer_get_height (data->src_buffer));
+
+  /*  In the case of web/mono palettes, we actually force
+   *   grayscale drawables through the rgb pass2 functions
+   */
+  if (gimp_drawable_is_gray (GIMP_DRAWABLE (layer)))
+    {
+      data->red_pix = data->green_pix = data->blue_pix = GRAY;
+      data->alpha_pix = ALPHA_G;
+    }
+
+  g_mutex_init (&data->mutex);
+}
+
+static void
+remap_data_finish (RemapData *data)
+{
+  CFHistogram  histogram = data->quantobj->histogram;
+  GSList      *list;
+
+  g_mutex_clear (&data->mutex);
+
+  for (list = data->caches; list; list = g_slist_next (list))
+    {
+      RemapCache     *cache = list->data;
+      GHashTableIter  iter;
+      gpointer        key;
+      gpointer        value;
+      gint            i;
+
+      for (i = 0; i < 256; i++)
+        data->quantobj->index_used_count[i] += cache->index_used_count[i];
+
+      g_hash_table_iter_init (&iter, cache->cells);
+
+      while (g_hash_table_iter_next (&iter, &key, &value))
+        histogram[GPOINTER_TO_INT (key)] = GPOINTER_TO_INT (value);
+
+      g_hash_table_unref (cache->cells);
+      g_free (cache);
+    }
+
+  g_slist_free (data->caches);
+  data->caches = NULL;
+}
+
+static RemapCache *
+remap_cache_new (RemapData *data)
+{
+  RemapCache *cache = g_new0 (RemapCache, 1);
+
+  cache->cells = g_hash_table_new (NULL, NULL);
+
+  g_mutex_lock (&data->mutex);
+
+  data->caches = g_slist_prepend (data->caches, cache);
+
+  g_mutex_unlock (&data->mutex);
+
+  return cache;
+}
+
+static inline gint
+remap_cache_lookup_rgb (RemapData  *data,
+                        RemapCache *cache,
+                        gint        R,
+                        gint        G,
+                        gint        B)
+{
+  CFHistogram  histogram = data->quantobj->histogram;
+  ColorFreq   *cachep    = HIST_LIN (histogram, R, G, B);
+  gpointer     key       = GINT_TO_POINTER (cachep - histogram);
+  gpointer     value;
+
+  if (*cachep != 0)
+    return *cachep - 1;
+
+  value = g_hash_table_lookup (cache->cells, key);
+
+  if (! value)
+    {
+      /* If we have not seen this color before, find nearest
+       * colormap entry and update the thread's cache
+       */
+      gint  bestcolor[BOX_R_ELEMS * BOX_G_ELEMS * BOX_B_ELEMS] = { 0, };
+      gint *cptr = bestcolor;
+      gint  iR, iG, iB;
+
+      find_inverse_cmap_box_rgb (data->quantobj, &R, &G, &B, bestcolor);
+
+      for (iR = 0; iR < BOX_R_ELEMS; iR++)
+        {
+          for (iG = 0; iG < BOX_G_ELEMS; iG++)
+            {
+              for (iB = 0; iB < BOX_B_ELEMS; iB++)
+                {
+                  ColorFreq *cell = HIST_LIN (histogram,
+                                              R + iR, G + iG, B + iB);
+
+                  g_hash_table_insert (cache->cells,
+                                       GINT_TO_POINTER (cell - histogram),
+                                       GINT_TO_POINTER ((*cptr++) + 1));
+                }
+            }
+        }
+
+      value = g_hash_table_lookup (cache->cells, key);
+    }
+
+  return GPOINTER_TO_INT (value) - 1;
+}
+
+
 /*  This is pass 1  */
 
 static void
@@ -3089,84 +3457,50 @@ median_cut_pass2_fixed_dither_gray (QuantizeObj *quantobj,
 }
 
 static void
-median_cut_pass2_no_dither_rgb (QuantizeObj *quantobj,
-                                GimpLayer   *layer,
-                                GeglBuffer  *new_buffer)
+median_cut_pass2_no_dither_rgb_area (const GeglRectangle *area,
+                                     RemapData           *data)
 {
   GeglBufferIterator *iter;
-  CFHistogram         histogram = quantobj->histogram;
-  ColorFreq          *cachep;
-  const Babl         *src_format;
-  const Babl         *dest_format;
+  RemapCache         *cache     = remap_cache_new (data);
   GeglRectangle      *src_roi;
-  gint                src_bpp;
-  gint                dest_bpp;
-  gint                has_alpha;
+  gint                count     = 0;
   gint                R, G, B;
-  gint                red_pix          = RED;
-  gint                green_pix        = GREEN;
-  gint                blue_pix         = BLUE;
-  gint                alpha_pix        = ALPHA;
-  gboolean            dither_alpha     = quantobj->want_dither_alpha;
-  gint                offsetx, offsety;
-  gulong             *index_used_count = quantobj->index_used_count;
-  glong               total_size       = 0;
-  glong               layer_size;
-  gint                count            = 0;
-
-  gimp_item_get_offset (GIMP_ITEM (layer), &offsetx, &offsety);
-
-  src_format  = gimp_drawable_get_format (GIMP_DRAWABLE (layer));
-  dest_format = gegl_buffer_get_format (new_buffer);
-
-  src_bpp  = babl_format_get_bytes_per_pixel (src_format);
-  dest_bpp = babl_format_get_bytes_per_pixel (dest_format);
-
-  has_alpha = babl_format_has_alpha (src_format);
-
-  /*  In the case of web/mono palettes, we actually force
-   *   grayscale drawables through the rgb pass2 functions
-   */
-  if (gimp_drawable_is_gray (GIMP_DRAWABLE (layer)))
-    {
-      red_pix = green_pix = blue_pix = GRAY;
-      alpha_pix = ALPHA_G;
-    }
+  const gint          red_pix   = data->red_pix;
+  const gint          green_pix = data->green_pix;
+  const gint          blue_pix  = data->blue_pix;
+  const gint          alpha_pix = data->alpha_pix;
 
-  iter = gegl_buffer_iterator_new (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
-                                   NULL, 0, NULL,
+  iter = gegl_buffer_iterator_new (data->src_buffer,
+                                   area, 0, NULL,
                                    GEGL_ACCESS_READ, GEGL_ABYSS_NONE, 2);
   src_roi = &iter->items[0].roi;
 
-  gegl_buffer_iterator_add (iter, new_buffer,
-                            NULL, 0, NULL,
+  gegl_buffer_iterator_add (iter, data->dest_buffer,
+                            area, 0, NULL,
                             GEGL_ACCESS_WRITE, GEGL_ABYSS_NONE);
 
-  layer_size = (gimp_item_get_width  (GIMP_ITEM (layer)) *
-                gimp_item_get_height (GIMP_ITEM (layer)));
-
   while (gegl_buffer_iterator_next (iter))
     {
       const guchar *src  = iter->items[0].data;
       guchar       *dest = iter->items[1].data;
       gint          row;
 
-      total_size += src_roi->height * src_roi->width;
-
       for (row = 0; row < src_roi->height; row++)
         {
           gint col;
 
           for (col = 0; col < src_roi->width; col++)
             {
-              if (has_alpha)
+              gint index;
+
+              if (data->has_alpha)
                 {
                   gboolean transparent = FALSE;
 
-                  if (dither_alpha)
+                  if (data->dither_alpha)
                     {
-                      gint dither_x = (col + offsetx + src_roi->x) & DM_WIDTHMASK;
-                      gint dither_y = (row + offsety + src_roi->y) & DM_HEIGHTMASK;
+                      gint dither_x = (col + data->offsetx + src_roi->x) & DM_WIDTHMASK;
+                      gint dither_y = (row + data->offsety + src_roi->y) & DM_HEIGHTMASK;
 
                       if ((src[alpha_pix]) < DM[dither_x][dither_y])
                         transparent = TRUE;
@@ -3192,100 +3526,76 @@ median_cut_pass2_no_dither_rgb (QuantizeObj *quantobj,
               rgb_to_lin (src[red_pix], src[green_pix], src[blue_pix],
                           &R, &G, &B);
 
-              cachep = HIST_LIN (histogram, R, G, B);
-              /* If we have not seen this color before, find nearest
-               * colormap entry and update the cache
-               */
-              if (*cachep == 0)
-                fill_inverse_cmap_rgb (quantobj, histogram, R, G, B);
+              index = remap_cache_lookup_rgb (data, cache, R, G, B);
 
               /* Now emit the colormap index for this cell, barfbarf */
-              index_used_count[dest[INDEXED] = *cachep - 1]++;
+              cache->index_used_count[dest[INDEXED] = index]++;
 
             next_pixel:
 
-              src  += src_bpp;
-              dest += dest_bpp;
+              src  += data->src_bpp;
+              dest += data->dest_bpp;
             }
         }
 
-      if (quantobj->progress && (count % 16 == 0))
-         gimp_progress_set_value (quantobj->progress,
-                                  (gdouble) total_size / (gdouble) layer_size);
+      parallel_progress_update (&data->progress, iter->length, &count);
     }
 }
 
 static void
-median_cut_pass2_fixed_dither_rgb (QuantizeObj *quantobj,
-                                   GimpLayer   *layer,
-                                   GeglBuffer  *new_buffer)
+median_cut_pass2_no_dither_rgb (QuantizeObj *quantobj,
+                                GimpLayer   *layer,
+                                GeglBuffer  *new_buffer)
+{
+  RemapData data;
+
+  remap_data_init (&data, quantobj, layer, new_buffer);
+
+  gegl_parallel_distribute_area (
+    gegl_buffer_get_extent (data.src_buffer), PIXELS_PER_THREAD,
+    GEGL_SPLIT_STRATEGY_AUTO,
+    (GeglParallelDistributeAreaFunc) median_cut_pass2_no_dither_rgb_area,
+    &data);
+
+  remap_data_finish (&data);
+}
+
+static void
+median_cut_pass2_fixed_dither_rgb_area (const GeglRectangle *area,
+                                        RemapData           *data)
 {
   GeglBufferIterator *iter;
-  CFHistogram         histogram = quantobj->histogram;
-  ColorFreq          *cachep;
-  const Babl         *src_format;
-  const Babl         *dest_format;
+  QuantizeObj        *quantobj  = data->quantobj;
+  RemapCache         *cache     = remap_cache_new (data);
   GeglRectangle      *src_roi;
-  gint                src_bpp;
-  gint                dest_bpp;
-  gint                has_alpha;
-  gint                pixval1 = 0;
-  gint                pixval2 = 0;
+  gint                count     = 0;
+  gint                pixval1   = 0;
+  gint                pixval2   = 0;
   Color              *color1;
   Color              *color2;
   gint                R, G, B;
   gint                err1;
   gint                err2;
-  gint                red_pix          = RED;
-  gint                green_pix        = GREEN;
-  gint                blue_pix         = BLUE;
-  gint                alpha_pix        = ALPHA;
-  gboolean            dither_alpha     = quantobj->want_dither_alpha;
-  gint                offsetx, offsety;
-  gulong             *index_used_count = quantobj->index_used_count;
-  glong               total_size       = 0;
-  glong               layer_size;
-  gint                count            = 0;
-
-  gimp_item_get_offset (GIMP_ITEM (layer), &offsetx, &offsety);
-
-  src_format  = gimp_drawable_get_format (GIMP_DRAWABLE (layer));
-  dest_format = gegl_buffer_get_format (new_buffer);
-
-  src_bpp  = babl_format_get_bytes_per_pixel (src_format);
-  dest_bpp = babl_format_get_bytes_per_pixel (dest_format);
-
-  has_alpha = babl_format_has_alpha (src_format);
-
-  /*  In the case of web/mono palettes, we actually force
-   *   grayscale drawables through the rgb pass2 functions
-   */
-  if (gimp_drawable_is_gray (GIMP_DRAWABLE (layer)))
-    {
-      red_pix = green_pix = blue_pix = GRAY;
-      alpha_pix = ALPHA_G;
-    }
+  const gint          red_pix   = data->red_pix;
+  const gint          green_pix = data->green_pix;
+  const gint          blue_pix  = data->blue_pix;
+  const gint          alpha_pix = data->alpha_pix;
 
-  iter = gegl_buffer_iterator_new (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
-                                   NULL, 0, NULL,
+  iter = gegl_buffer_iterator_new (data->src_buffer,
+                                   area, 0, NULL,
                                    GEGL_ACCESS_READ, GEGL_ABYSS_NONE, 2);
   src_roi = &iter->items[0].roi;
 
-  gegl_buffer_iterator_add (iter, new_buffer,
-                            NULL, 0, NULL,
+  gegl_buffer_iterator_add (iter, data->dest_buffer,
+                            area, 0, NULL,
                             GEGL_ACCESS_WRITE, GEGL_ABYSS_NONE);
 
-  layer_size = (gimp_item_get_width  (GIMP_ITEM (layer)) *
-                gimp_item_get_height (GIMP_ITEM (layer)));
-
   while (gegl_buffer_iterator_next (iter))
     {
       const guchar *src  = iter->items[0].data;
       guchar       *dest = iter->items[1].data;
       gint          row;
 
-      total_size += src_roi->height * src_roi->width;
-
       for (row = 0; row < src_roi->height; row++)
         {
           gint col;
@@ -3293,14 +3603,14 @@ median_cut_pass2_fixed_dither_rgb (QuantizeObj *quantobj,
           for (col = 0; col < src_roi->width; col++)
             {
               const int dmval =
-                DM[(col + offsetx + src_roi->x) & DM_WIDTHMASK]
-                [(row + offsety + src_roi->y) & DM_HEIGHTMASK];
+                DM[(col + data->offsetx + src_roi->x) & DM_WIDTHMASK]
+                [(row + data->offsety + src_roi->y) & DM_HEIGHTMASK];
 
-              if (has_alpha)
+              if (data->has_alpha)
                 {
                   gboolean transparent = FALSE;
 
-                  if (dither_alpha)
+                  if (data->dither_alpha)
                     {
                       if (src[alpha_pix] < dmval)
                         transparent = TRUE;
@@ -3326,13 +3636,6 @@ median_cut_pass2_fixed_dither_rgb (QuantizeObj *quantobj,
               rgb_to_lin (src[red_pix], src[green_pix], src[blue_pix],
                           &R, &G, &B);
 
-              cachep = HIST_LIN (histogram, R, G, B);
-              /* If we have not seen this color before, find nearest
-               * colormap entry and update the cache
-               */
-              if (*cachep == 0)
-                fill_inverse_cmap_rgb (quantobj, histogram, R, G, B);
-
               /* We now try to find a color which, when mixed in some
                * fashion with the closest match, yields something
                * closer to the desired color.  We do this by
@@ -3342,7 +3645,7 @@ median_cut_pass2_fixed_dither_rgb (QuantizeObj *quantobj,
                * intended color to determine their relative
                * probabilities of being chosen.
                */
-              pixval1 = *cachep - 1;
+              pixval1 = remap_cache_lookup_rgb (data, cache, R, G, B);
               color1 = &quantobj->cmap[pixval1];
 
               if (quantobj->actual_number_of_colors > 2)
@@ -3361,14 +3664,7 @@ median_cut_pass2_fixed_dither_rgb (QuantizeObj *quantobj,
                                   (CLAMP0255(BV)),
                                   &R, &G, &B);
 
-                      cachep = HIST_LIN (histogram, R, G, B);
-                      /* If we have not seen this color before, find
-                       * nearest colormap entry and update the cache
-                       */
-                      if (*cachep == 0)
-                        fill_inverse_cmap_rgb (quantobj, histogram, R, G, B);
-
-                      pixval2 = *cachep - 1;
+                      pixval2 = remap_cache_lookup_rgb (data, cache, R, G, B);
                       RV += re;  GV += ge;  BV += be;
                     }
                   while ((pixval1 == pixval2) &&
@@ -3432,61 +3728,61 @@ median_cut_pass2_fixed_dither_rgb (QuantizeObj *quantobj,
                 }
 
               /* Now emit the colormap index for this cell, barfbarf */
-              index_used_count[dest[INDEXED] = pixval1]++;
+              cache->index_used_count[dest[INDEXED] = pixval1]++;
 
             next_pixel:
 
-              src  += src_bpp;
-              dest += dest_bpp;
+              src  += data->src_bpp;
+              dest += data->dest_bpp;
             }
         }
 
-      if (quantobj->progress && (count % 16 == 0))
-        gimp_progress_set_value (quantobj->progress,
-                                 (gdouble) total_size / (gdouble) layer_size);
+      parallel_progress_update (&data->progress, iter->length, &count);
     }
 }
 
 static void
-median_cut_pass2_nodestruct_dither_rgb (QuantizeObj *quantobj,
-                                        GimpLayer   *layer,
-                                        GeglBuffer  *new_buffer)
+median_cut_pass2_fixed_dither_rgb (QuantizeObj *quantobj,
+                                   GimpLayer   *layer,
+                                   GeglBuffer  *new_buffer)
 {
-  GeglBufferIterator *iter;
-  const Babl         *src_format;
-  const Babl         *dest_format;
-  GeglRectangle      *src_roi;
-  gint                src_bpp;
-  gint                dest_bpp;
-  gint                has_alpha;
-  gboolean            dither_alpha = quantobj->want_dither_alpha;
-  gint                red_pix      = RED;
-  gint                green_pix    = GREEN;
-  gint                blue_pix     = BLUE;
-  gint                alpha_pix    = ALPHA;
-  gint                lastindex    = 0;
-  gint                lastred      = -1;
-  gint                lastgreen    = -1;
-  gint                lastblue     = -1;
-  gint                offsetx, offsety;
+  RemapData data;
 
-  gimp_item_get_offset (GIMP_ITEM (layer), &offsetx, &offsety);
-
-  src_format  = gimp_drawable_get_format (GIMP_DRAWABLE (layer));
-  dest_format = gegl_buffer_get_format (new_buffer);
+  remap_data_init (&data, quantobj, layer, new_buffer);
 
-  src_bpp  = babl_format_get_bytes_per_pixel (src_format);
-  dest_bpp = babl_format_get_bytes_per_pixel (dest_format);
+  gegl_parallel_distribute_area (
+    gegl_buffer_get_extent (data.src_buffer), PIXELS_PER_THREAD,
+    GEGL_SPLIT_STRATEGY_AUTO,
+    (GeglParallelDistributeAreaFunc) median_cut_pass2_fixed_dither_rgb_area,
+    &data);
 
-  has_alpha = babl_format_has_alpha (src_format);
+  remap_data_finish (&data);
+}
 
-  iter = gegl_buffer_iterator_new (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
-                                   NULL, 0, NULL,
+static void
+median_cut_pass2_nodestruct_dither_rgb_area (const GeglRectangle *area,
+                                             RemapData           *data)
+{
+  GeglBufferIterator *iter;
+  QuantizeObj        *quantobj  = data->quantobj;
+  GeglRectangle      *src_roi;
+  gint                count     = 0;
+  const gint          red_pix   = data->red_pix;
+  const gint          green_pix = data->green_pix;
+  const gint          blue_pix  = data->blue_pix;
+  const gint          alpha_pix = data->alpha_pix;
+  gint                lastindex = 0;
+  gint                lastred   = -1;
+  gint                lastgreen = -1;
+  gint                lastblue  = -1;
+
+  iter = gegl_buffer_iterator_new (data->src_buffer,
+                                   area, 0, NULL,
                                    GEGL_ACCESS_READ, GEGL_ABYSS_NONE, 2);
   src_roi = &iter->items[0].roi;
 
-  gegl_buffer_iterator_add (iter, new_buffer,
-                            NULL, 0, NULL,
+  gegl_buffer_iterator_add (iter, data->dest_buffer,
+                            area, 0, NULL,
                             GEGL_ACCESS_WRITE, GEGL_ABYSS_NONE);
 
   while (gegl_buffer_iterator_next (iter))
@@ -3503,12 +3799,12 @@ median_cut_pass2_nodestruct_dither_rgb (QuantizeObj *quantobj,
             {
               gboolean transparent = FALSE;
 
-              if (has_alpha)
+              if (data->has_alpha)
                 {
-                  if (dither_alpha)
+                  if (data->dither_alpha)
                     {
-                      gint dither_x = (col + src_roi->x + offsetx) & DM_WIDTHMASK;
-                      gint dither_y = (row + src_roi->y + offsety) & DM_HEIGHTMASK;
+                      gint dither_x = (col + src_roi->x + data->offsetx) & DM_WIDTHMASK;
+                      gint dither_y = (row + src_roi->y + data->offsety) & DM_HEIGHTMASK;
 
                       if ((src[alpha_pix]) < DM[dither_x][dither_y])
                         transparent = TRUE;
@@ -3528,7 +3824,7 @@ median_cut_pass2_nodestruct_dither_rgb (QuantizeObj *quantobj,
                     {
                       /*  same pixel color as last time  */
                       dest[INDEXED] = lastindex;
-                      if (has_alpha)
+                      if (data->has_alpha)
                         dest[ALPHA_I] = 255;
                     }
                   else
@@ -3555,7 +3851,7 @@ median_cut_pass2_nodestruct_dither_rgb (QuantizeObj *quantobj,
                                "be in non-destructive colormap.");
                     got_color:
                       dest[INDEXED] = lastindex;
-                      if (has_alpha)
+                      if (data->has_alpha)
                         dest[ALPHA_I] = 255;
                     }
                 }
@@ -3564,13 +3860,39 @@ median_cut_pass2_nodestruct_dither_rgb (QuantizeObj *quantobj,
                   dest[ALPHA_I] = 0;
                 }
 
-              src  += src_bpp;
-              dest += dest_bpp;
+              src  += data->src_bpp;
+              dest += data->dest_bpp;
             }
         }
+
+      parallel_progress_update (&data->progress, iter->length, &count);
     }
 }
 
+static void
+median_cut_pass2_nodestruct_dither_rgb (QuantizeObj *quantobj,
+                                        GimpLayer   *layer,
+                                        GeglBuffer  *new_buffer)
+{
+  RemapData data;
+
+  remap_data_init (&data, quantobj, layer, new_buffer);
+
+  /*  the nodestruct remapper always uses the rgb channels  */
+  data.red_pix   = RED;
+  data.green_pix = GREEN;
+  data.blue_pix  = BLUE;
+  data.alpha_pix = ALPHA;
+
+  gegl_parallel_distribute_area (
+    gegl_buffer_get_extent (data.src_buffer), PIXELS_PER_THREAD,
+    GEGL_SPLIT_STRATEGY_AUTO,
+    (GeglParallelDistributeAreaFunc) median_cut_pass2_nodestruct_dither_rgb_area,
+    &data);
+
+  remap_data_finish (&data);
+}
+
 
 /*
  * Initialize the error-limiting transfer function (lookup table).
@@ -3913,6 +4235,32 @@ median_cut_pass2_gray_init (QuantizeObj *quantobj)
   memset (quantobj->index_used_count, 0, 256 * sizeof (gulong));
 }
 
+/*  The error diffusion below is inherently serial: rows are scanned in
+ *  alternating directions and every pixel depends on its predecessors.
+ *  What doesn't depend on the error is converting the source pixels to
+ *  L*a*b*, which is where most of the time goes, so that is done for a
+ *  block of rows at a time in parallel, ahead of the serial scan.
+ */
+static void
+convert_block_to_unshifted_lin (gsize         offset,
+                                gsize         size,
+                                LinBlockData *data)
+{
+  const guchar *src = data->src + offset * data->src_bpp;
+  gint         *lin = data->lin + offset * 3;
+
+  while (size--)
+    {
+      rgb_to_unshifted_lin (src[data->red_pix],
+                            src[data->green_pix],
+                            src[data->blue_pix],
+                            &lin[0], &lin[1], &lin[2]);
+
+      src += data->src_bpp;
+      lin += 3;
+    }
+}
+
 static void
 median_cut_pass2_fs_dither_rgb (QuantizeObj *quantobj,
                                 GimpLayer   *layer,
@@ -3931,6 +4279,8 @@ median_cut_pass2_fs_dither_rgb (QuantizeObj *quantobj,
   gint          src_bpp;
   gint          dest_bpp;
   guchar       *src_buf, *dest_buf;
+  gint         *lin_buf;
+  const gint   *lin;
   gint         *red_n_row, *red_p_row;
   gint         *grn_n_row, *grn_p_row;
   gint         *blu_n_row, *blu_p_row;
@@ -3941,7 +4291,7 @@ median_cut_pass2_fs_dither_rgb (QuantizeObj *quantobj,
   gint          re, ge, be;
   gint          row, col;
   gint          index;
-  gint          step_dest, step_src;
+  gint          step_dest, step_src, step_lin;
   gint          odd_row;
   gboolean      has_alpha;
   gint          width, height;
@@ -3994,8 +4344,9 @@ median_cut_pass2_fs_dither_rgb (QuantizeObj *quantobj,
       global_bmin = MIN(global_bmin, quantobj->clin[index].blue);
     }
 
-  src_buf  = g_malloc (width * src_bpp);
+  src_buf  = g_malloc (width * FS_BLOCK_ROWS * src_bpp);
   dest_buf = g_malloc (width * dest_bpp);
+  lin_buf  = g_new (gint, width * FS_BLOCK_ROWS * 3);
 
   red_n_row = g_new (gint, width + 2);
   red_p_row = g_new0 (gint, width + 2);
@@ -4016,11 +4367,30 @@ median_cut_pass2_fs_dither_rgb (QuantizeObj *quantobj,
       const guchar *src;
       guchar       *dest;
 
-      gegl_buffer_get (src_buffer, GEGL_RECTANGLE (0, row, width, 1),
-                       1.0, NULL, src_buf,
-                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+      if (row % FS_BLOCK_ROWS == 0)
+        {
+          LinBlockData lin_data;
+          gint         n_rows = MIN (FS_BLOCK_ROWS, height - row);
+
+          gegl_buffer_get (src_buffer, GEGL_RECTANGLE (0, row, width, n_rows),
+                           1.0, NULL, src_buf,
+                           GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+          lin_data.src       = src_buf;
+          lin_data.src_bpp   = src_bpp;
+          lin_data.red_pix   = red_pix;
+          lin_data.green_pix = green_pix;
+          lin_data.blue_pix  = blue_pix;
+          lin_data.lin       = lin_buf;
+
+          gegl_parallel_distribute_range (
+            width * n_rows, PIXELS_PER_THREAD,
+            (GeglParallelDistributeRangeFunc) convert_block_to_unshifted_lin,
+            &lin_data);
+        }
 
-      src  = src_buf;
+      src  = src_buf + (row % FS_BLOCK_ROWS) * width * src_bpp;
+      lin  = lin_buf + (row % FS_BLOCK_ROWS) * width * 3;
       dest = dest_buf;
 
       rnr = red_n_row;
@@ -4034,8 +4404,10 @@ median_cut_pass2_fs_dither_rgb (QuantizeObj *quantobj,
         {
           step_dest = -dest_bpp;
           step_src  = -src_bpp;
+          step_lin  = -3;
 
           src += (width * src_bpp) - src_bpp;
+          lin += (width * 3) - 3;
           dest += (width * dest_bpp) - dest_bpp;
 
           rnr += width + 1;
@@ -4051,6 +4423,7 @@ median_cut_pass2_fs_dither_rgb (QuantizeObj *quantobj,
         {
           step_dest = dest_bpp;
           step_src  = src_bpp;
+          step_lin  = 3;
 
           *(rnr + 1) = *(gnr + 1) = *(bnr + 1) = 0;
         }
@@ -4136,8 +4509,9 @@ median_cut_pass2_fs_dither_rgb (QuantizeObj *quantobj,
 
           rgb_to_lin (r, g, b, &re, &ge, &be);
 #endif
-          rgb_to_unshifted_lin (src[red_pix], src[green_pix], src[blue_pix],
-                                &re, &ge, &be);
+          re = lin[0];
+          ge = lin[1];
+          be = lin[2];
 
           /*
             re = CLAMP(re, global_rmin, global_rmax);
@@ -4250,6 +4624,7 @@ median_cut_pass2_fs_dither_rgb (QuantizeObj *quantobj,
 
           dest += step_dest;
           src += step_src;
+          lin += step_lin;
         }
 
       tmp = red_n_row;
@@ -4284,6 +4659,7 @@ median_cut_pass2_fs_dither_rgb (QuantizeObj *quantobj,
   g_free (blu_p_row);
   g_free (src_buf);
   g_free (dest_buf);
+  g_free (lin_buf);
 }
 
 
@@ -4348,6 +4724,8 @@ initialize_median_cut (GimpImageBaseType       type,
   quantobj->custom_palette           = custom_palette;
   quantobj->desired_number_of_colors = num_colors;
   quantobj->want_dither_alpha        = want_dither_alpha;
+  quantobj->needs_quantize           = FALSE;
+  quantobj->num_found_cols           = 0;
   quantobj->progress                 = progress;
 
   switch (type)
@@ -4363,7 +4741,7 @@ initialize_median_cut (GimpImageBaseType       type,
           break;
         case GIMP_CONVERT_PALETTE_CUSTOM:
           quantobj->first_pass = custompal_pass1;
-          needs_quantize = TRUE;
+          quantobj->needs_quantize = TRUE;
           break;
         case GIMP_CONVERT_PALETTE_MONO:
         default:
@@ -4435,11 +4813,11 @@ initialize_median_cut (GimpImageBaseType       type,
           break;
         case GIMP_CONVERT_PALETTE_WEB:
           quantobj->first_pass = webpal_pass1;
-          needs_quantize = TRUE;
+          quantobj->needs_quantize = TRUE;
           break;
         case GIMP_CONVERT_PALETTE_CUSTOM:
           quantobj->first_pass = custompal_pass1;
-          needs_quantize = TRUE;
+          quantobj->needs_quantize = TRUE;
           break;
         case GIMP_CONVERT_PALETTE_MONO:
         default:
@@ -25,6 +25,7 @@
 #include "gimp.h"
 #include "gimpcontainer.h"
 #include "gimpcontext.h"
+#include "gimpdrawable-transform.h"
 #include "gimpguide.h"
 #include "gimpimage.h"
 #include "gimpimage-flip.h"
@@ -33,11 +34,21 @@
 #include "gimpimage-undo.h"
 #include "gimpimage-undo-push.h"
 #include "gimpitem.h"
+#include "gimplayer.h"
+#include "gimplayermask.h"
 #include "gimpobjectqueue.h"
 #include "gimpprogress.h"
 #include "gimpsamplepoint.h"
 
 
+static GList * gimp_image_flip_prepare (GimpImage           *image,
+                                        GimpContext         *context,
+                                        GimpOrientationType  flip_type,
+                                        gdouble              axis);
+
+
+/*  public functions  */
+
 void
 gimp_image_flip (GimpImage           *image,
                  GimpContext         *context,
@@ -46,6 +57,7 @@ gimp_image_flip (GimpImage           *image,
 {
   GimpObjectQueue *queue;
   GimpItem        *item;
+  GList           *prepared;
   GList           *list;
   gdouble          axis;
 
@@ -80,6 +92,11 @@ gimp_image_flip (GimpImage           *image,
 
   gimp_image_undo_group_start (image, GIMP_UNDO_GROUP_IMAGE_FLIP, NULL);
 
+  /*  Flip the pixels of all drawables in parallel, below loop only
+   *  commits them
+   */
+  prepared = gimp_image_flip_prepare (image, context, flip_type, axis);
+
   /*  Flip all layers, channels (including selection mask), and vectors  */
   while ((item = gimp_object_queue_pop (queue)))
     {
@@ -88,6 +105,11 @@ gimp_image_flip (GimpImage           *image,
       gimp_progress_set_value (progress, 1.0);
     }
 
+  for (list = prepared; list; list = g_list_next (list))
+    gimp_drawable_transform_drop_prepared (list->data);
+
+  g_list_free_full (prepared, g_object_unref);
+
   /*  Flip all Guides  */
   for (list = gimp_image_get_guides (image);
        list;
@@ -147,3 +169,54 @@ gimp_image_flip (GimpImage           *image,
 
   gimp_unset_busy (image->gimp);
 }
+
+
+/*  private functions  */
+
+static GList *
+gimp_image_flip_prepare (GimpImage           *image,
+                         GimpContext         *context,
+                         GimpOrientationType  flip_type,
+                         gdouble              axis)
+{
+  GList *prepared = NULL;
+  GList *layers;
+  GList *list;
+
+  layers = gimp_image_get_layer_list (image);
+
+  for (list = layers; list; list = g_list_next (list))
+    {
+      GimpLayer *layer = list->data;
+
+      /*  layer groups only flip their children  */
+      if (gimp_viewable_get_children (GIMP_VIEWABLE (layer)))
+        continue;
+
+      prepared = g_list_prepend (prepared, g_object_ref (layer));
+
+      if (gimp_layer_get_mask (layer))
+        prepared = g_list_prepend (prepared,
+                                   g_object_ref (gimp_layer_get_mask (layer)));
+    }
+
+  g_list_free (layers);
+
+  prepared = g_list_prepend (prepared,
+                             g_object_ref (gimp_image_get_mask (image)));
+
+  for (list = gimp_image_get_channel_iter (image);
+       list;
+       list = g_list_next (list))
+    {
+      prepared = g_list_prepend (prepared, g_object_ref (list->data));
+    }
+
+  for (list = prepared; list; list = g_list_next (list))
+    {
+      gimp_drawable_transform_prepare_flip (list->data, context,
+                                            flip_type, axis);
+    }
+
+  return prepared;
+}
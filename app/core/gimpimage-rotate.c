@@ -27,6 +27,7 @@
 #include "gimp.h"
 #include "gimpcontainer.h"
 #include "gimpcontext.h"
+#include "gimpdrawable-transform.h"
 #include "gimpguide.h"
 #include "gimpimage.h"
 #include "gimpimage-rotate.h"
@@ -36,6 +37,7 @@
 #include "gimpimage-undo-push.h"
 #include "gimpitem.h"
 #include "gimplayer.h"
+#include "gimplayermask.h"
 #include "gimpobjectqueue.h"
 #include "gimpprogress.h"
 #include "gimpsamplepoint.h"
@@ -50,6 +52,11 @@ static void  gimp_image_rotate_guides        (GimpImage        *image,
                                               GimpRotationType  rotate_type);
 static void  gimp_image_rotate_sample_points (GimpImage        *image,
                                               GimpRotationType  rotate_type);
+static GList * gimp_image_rotate_prepare     (GimpImage        *image,
+                                              GimpContext      *context,
+                                              GimpRotationType  rotate_type,
+                                              gdouble           center_x,
+                                              gdouble           center_y);
 
 
 void
@@ -60,6 +67,7 @@ gimp_image_rotate (GimpImage        *image,
 {
   GimpObjectQueue *queue;
   GimpItem        *item;
+  GList           *prepared;
   GList           *list;
   gdouble          center_x;
   gdouble          center_y;
@@ -120,6 +128,12 @@ gimp_image_rotate (GimpImage        *image,
 
   gimp_image_undo_group_start (image, GIMP_UNDO_GROUP_IMAGE_ROTATE, NULL);
 
+  /*  Rotate the pixels of all drawables in parallel, below loop only
+   *  commits them
+   */
+  prepared = gimp_image_rotate_prepare (image, context, rotate_type,
+                                        center_x, center_y);
+
   /*  Rotate all layers, channels (including selection mask), and vectors  */
   while ((item = gimp_object_queue_pop (queue)))
     {
@@ -152,6 +166,11 @@ gimp_image_rotate (GimpImage        *image,
       gimp_progress_set_value (progress, 1.0);
     }
 
+  for (list = prepared; list; list = g_list_next (list))
+    gimp_drawable_transform_drop_prepared (list->data);
+
+  g_list_free_full (prepared, g_object_unref);
+
   /*  Rotate all Guides  */
   gimp_image_rotate_guides (image, rotate_type);
 
@@ -375,3 +394,53 @@ gimp_image_rotate_sample_points (GimpImage        *image,
         }
     }
 }
+
+static GList *
+gimp_image_rotate_prepare (GimpImage        *image,
+                           GimpContext      *context,
+                           GimpRotationType  rotate_type,
+                           gdouble           center_x,
+                           gdouble           center_y)
+{
+  GList *prepared = NULL;
+  GList *layers;
+  GList *list;
+
+  layers = gimp_image_get_layer_list (image);
+
+  for (list = layers; list; list = g_list_next (list))
+    {
+      GimpLayer *layer = list->data;
+
+      /*  layer groups only rotate their children  */
+      if (gimp_viewable_get_children (GIMP_VIEWABLE (layer)))
+        continue;
+
+      prepared = g_list_prepend (prepared, g_object_ref (layer));
+
+      if (gimp_layer_get_mask (layer))
+        prepared = g_list_prepend (prepared,
+                                   g_object_ref (gimp_layer_get_mask (layer)));
+    }
+
+  g_list_free (layers);
+
+  prepared = g_list_prepend (prepared,
+                             g_object_ref (gimp_image_get_mask (image)));
+
+  for (list = gimp_image_get_channel_iter (image);
+       list;
+       list = g_list_next (list))
+    {
+      prepared = g_list_prepend (prepared, g_object_ref (list->data));
+    }
+
+  for (list = prepared; list; list = g_list_next (list))
+    {
+      gimp_drawable_transform_prepare_rotate (list->data, context,
+                                              rotate_type,
+                                              center_x, center_y);
+    }
+
+  return prepared;
+}
@@ -23,7 +23,9 @@
 #include "core-types.h"
 
 #include "gimp.h"
+#include "gimpchannel.h"
 #include "gimpcontainer.h"
+#include "gimpdrawable-transform.h"
 #include "gimpguide.h"
 #include "gimpgrouplayer.h"
 #include "gimpimage.h"
@@ -32,7 +34,9 @@
 #include "gimpimage-scale.h"
 #include "gimpimage-undo.h"
 #include "gimpimage-undo-push.h"
+#include "gimpitemstack.h"
 #include "gimplayer.h"
+#include "gimplayermask.h"
 #include "gimpobjectqueue.h"
 #include "gimpprogress.h"
 #include "gimpprojection.h"
@@ -42,6 +46,33 @@
 #include "gimp-intl.h"
 
 
+static GList * gimp_image_scale_prepare_drawable (GList                 *prepared,
+                                                  GimpDrawable          *drawable,
+                                                  gint                   new_width,
+                                                  gint                   new_height,
+                                                  GimpInterpolationType  interpolation_type);
+static GList * gimp_image_scale_prepare_item     (GList                 *prepared,
+                                                  GimpItem              *item,
+                                                  gdouble                w_factor,
+                                                  gdouble                h_factor,
+                                                  gint                   origin_x,
+                                                  gint                   origin_y,
+                                                  gint                   new_origin_x,
+                                                  gint                   new_origin_y,
+                                                  GimpInterpolationType  interpolation_type);
+static GList * gimp_image_scale_prepare_items    (GList                 *prepared,
+                                                  GList                 *items,
+                                                  gdouble                w_factor,
+                                                  gdouble                h_factor,
+                                                  gint                   origin_x,
+                                                  gint                   origin_y,
+                                                  gint                   new_origin_x,
+                                                  gint                   new_origin_y,
+                                                  GimpInterpolationType  interpolation_type);
+
+
+/*  public functions  */
+
 void
 gimp_image_scale (GimpImage             *image,
                   gint                   new_width,
@@ -51,6 +82,7 @@ gimp_image_scale (GimpImage             *image,
 {
   GimpObjectQueue *queue;
   GimpItem        *item;
+  GList           *prepared;
   GList           *list;
   gint             old_width;
   gint             old_height;
@@ -103,6 +135,25 @@ gimp_image_scale (GimpImage             *image,
                 "height", new_height,
                 NULL);
 
+  /*  Compute the new pixels of all drawables in parallel, below loop
+   *  only commits them
+   */
+  prepared = gimp_image_scale_prepare_items (NULL,
+                                             gimp_image_get_layer_iter (image),
+                                             img_scale_w, img_scale_h,
+                                             0, 0, 0, 0,
+                                             interpolation_type);
+  prepared = gimp_image_scale_prepare_item  (prepared,
+                                             GIMP_ITEM (gimp_image_get_mask (image)),
+                                             img_scale_w, img_scale_h,
+                                             0, 0, 0, 0,
+                                             interpolation_type);
+  prepared = gimp_image_scale_prepare_items (prepared,
+                                             gimp_image_get_channel_iter (image),
+                                             img_scale_w, img_scale_h,
+                                             0, 0, 0, 0,
+                                             interpolation_type);
+
   /*  Scale all layers, channels (including selection mask), and vectors  */
   while ((item = gimp_object_queue_pop (queue)))
     {
@@ -120,6 +171,11 @@ gimp_image_scale (GimpImage             *image,
         }
     }
 
+  for (list = prepared; list; list = g_list_next (list))
+    gimp_drawable_transform_drop_prepared (list->data);
+
+  g_list_free_full (prepared, g_object_unref);
+
   /*  Scale all Guides  */
   for (list = gimp_image_get_guides (image);
        list;
@@ -258,3 +314,115 @@ gimp_image_scale_check (GimpImage *image,
 
   return GIMP_IMAGE_SCALE_OK;
 }
+
+
+/*  private functions  */
+
+static GList *
+gimp_image_scale_prepare_drawable (GList                 *prepared,
+                                   GimpDrawable          *drawable,
+                                   gint                   new_width,
+                                   gint                   new_height,
+                                   GimpInterpolationType  interpolation_type)
+{
+  /*  gimp_channel_scale() doesn't scale empty channels  */
+  if (GIMP_IS_CHANNEL (drawable) &&
+      GIMP_CHANNEL (drawable)->bounds_known &&
+      GIMP_CHANNEL (drawable)->empty)
+    {
+      return prepared;
+    }
+
+  gimp_drawable_transform_prepare_scale (drawable, new_width, new_height,
+                                         interpolation_type);
+
+  return g_list_prepend (prepared, g_object_ref (drawable));
+}
+
+/*  mirrors the geometry gimp_item_scale_by_factors_with_origin() and
+ *  gimp_group_layer_scale() are going to use
+ */
+static GList *
+gimp_image_scale_prepare_item (GList                 *prepared,
+                               GimpItem              *item,
+                               gdouble                w_factor,
+                               gdouble                h_factor,
+                               gint                   origin_x,
+                               gint                   origin_y,
+                               gint                   new_origin_x,
+                               gint                   new_origin_y,
+                               GimpInterpolationType  interpolation_type)
+{
+  GimpContainer *children;
+  gint           new_offset_x;
+  gint           new_offset_y;
+  gint           new_width;
+  gint           new_height;
+
+  if (! gimp_item_scale_by_factors_bounds (item,
+                                           w_factor, h_factor,
+                                           origin_x, origin_y,
+                                           new_origin_x, new_origin_y,
+                                           &new_offset_x, &new_offset_y,
+                                           &new_width, &new_height))
+    {
+      return prepared;
+    }
+
+  children = gimp_viewable_get_children (GIMP_VIEWABLE (item));
+
+  if (children)
+    {
+      return gimp_image_scale_prepare_items (
+        prepared,
+        gimp_item_stack_get_item_iter (GIMP_ITEM_STACK (children)),
+        (gdouble) new_width  / (gdouble) gimp_item_get_width  (item),
+        (gdouble) new_height / (gdouble) gimp_item_get_height (item),
+        gimp_item_get_offset_x (item),
+        gimp_item_get_offset_y (item),
+        new_offset_x,
+        new_offset_y,
+        interpolation_type);
+    }
+
+  prepared = gimp_image_scale_prepare_drawable (prepared,
+                                                GIMP_DRAWABLE (item),
+                                                new_width, new_height,
+                                                interpolation_type);
+
+  if (GIMP_IS_LAYER (item) && gimp_layer_get_mask (GIMP_LAYER (item)))
+    {
+      prepared = gimp_image_scale_prepare_drawable (
+        prepared,
+        GIMP_DRAWABLE (gimp_layer_get_mask (GIMP_LAYER (item))),
+        new_width, new_height,
+        interpolation_type);
+    }
+
+  return prepared;
+}
+
+static GList *
+gimp_image_scale_prepare_items (GList                 *prepared,
+                                GList                 *items,
+                                gdouble                w_factor,
+                                gdouble                h_factor,
+                                gint                   origin_x,
+                                gint                   origin_y,
+                                gint                   new_origin_x,
+                                gint                   new_origin_y,
+                                GimpInterpolationType  interpolation_type)
+{
+  GList *list;
+
+  for (list = items; list; list = g_list_next (list))
+    {
+      prepared = gimp_image_scale_prepare_item (prepared, list->data,
+                                                w_factor, h_factor,
+                                                origin_x, origin_y,
+                                                new_origin_x, new_origin_y,
+                                                interpolation_type);
+    }
+
+  return prepared;
+}
@@ -248,7 +248,8 @@ gimp_image_undo_push_drawable (GimpImage    *image,
                                GimpDrawable *drawable,
                                GeglBuffer   *buffer,
                                gint          x,
-                               gint          y)
+                               gint          y,
+                               gboolean      sparse)
 {
   GimpItem *item;
 
@@ -267,6 +268,7 @@ gimp_image_undo_push_drawable (GimpImage    *image,
                                "buffer", buffer,
                                "x",      x,
                                "y",      y,
+                               "sparse", sparse,
                                NULL);
 }
 
@@ -20,12 +20,15 @@
 #include <gdk-pixbuf/gdk-pixbuf.h>
 #include <gegl.h>
 
+#include "libgimpconfig/gimpconfig.h"
+
 #include "core-types.h"
 
 #include "config/gimpcoreconfig.h"
 
 #include "gimp.h"
 #include "gimp-utils.h"
+#include "gimpdrawableundo.h"
 #include "gimpimage.h"
 #include "gimpimage-private.h"
 #include "gimpimage-undo.h"
@@ -34,6 +37,10 @@
 #include "gimpundostack.h"
 
 
+/*  the number of most recent undo steps which are never compressed  */
+#define GIMP_IMAGE_UNDO_N_HOT_STEPS 2
+
+
 /*  local function prototypes  */
 
 static void          gimp_image_undo_pop_stack       (GimpImage     *image,
@@ -41,6 +48,9 @@ static void          gimp_image_undo_pop_stack       (GimpImage     *image,
                                                       GimpUndoStack *redo_stack,
                                                       GimpUndoMode   undo_mode);
 static void          gimp_image_undo_free_space      (GimpImage     *image);
+static GList       * gimp_image_undo_get_cold_undos  (GimpImage     *image);
+static void          gimp_image_undo_compress        (GimpImage     *image);
+static gboolean      gimp_image_undo_spill           (GimpImage     *image);
 static void          gimp_image_undo_free_redo       (GimpImage     *image);
 
 static GimpDirtyMask gimp_image_undo_dirty_from_type (GimpUndoType   undo_type);
@@ -533,6 +543,21 @@ gimp_image_undo_free_space (GimpImage *image)
               (glong) gimp_object_get_memsize (GIMP_OBJECT (container), NULL));
 #endif
 
+  /*  compress the pixels of older steps in the background, and move
+   *  them to disk before freeing any steps if memory runs short
+   */
+  gimp_image_undo_compress (image);
+
+  while (gimp_object_get_memsize (GIMP_OBJECT (container), NULL) > undo_size &&
+         gimp_image_undo_spill (image))
+    {
+#ifdef DEBUG_IMAGE_UNDO
+      g_printerr ("spilled one step: undo_bytes: %ld\n",
+                  (glong) gimp_object_get_memsize (GIMP_OBJECT (container),
+                                                   NULL));
+#endif
+    }
+
   /*  keep at least min_undo_levels undo steps  */
   if (gimp_container_get_n_children (container) <= min_undo_levels)
     return;
@@ -559,6 +584,91 @@ gimp_image_undo_free_space (GimpImage *image)
     }
 }
 
+static void
+gimp_image_undo_collect_drawable_undos (GimpUndo  *undo,
+                                        GList    **list)
+{
+  if (GIMP_IS_DRAWABLE_UNDO (undo))
+    {
+      *list = g_list_prepend (*list, undo);
+    }
+  else if (GIMP_IS_UNDO_STACK (undo))
+    {
+      GList *iter;
+
+      for (iter = GIMP_LIST (GIMP_UNDO_STACK (undo)->undos)->queue->head;
+           iter;
+           iter = g_list_next (iter))
+        {
+          gimp_image_undo_collect_drawable_undos (iter->data, list);
+        }
+    }
+}
+
+/*  returns the drawable undos of all but the most recent undo steps,
+ *  oldest first
+ */
+static GList *
+gimp_image_undo_get_cold_undos (GimpImage *image)
+{
+  GimpImagePrivate *private = GIMP_IMAGE_GET_PRIVATE (image);
+  GList            *undos   = NULL;
+  GList            *iter;
+
+  iter = g_list_nth (GIMP_LIST (private->undo_stack->undos)->queue->head,
+                     GIMP_IMAGE_UNDO_N_HOT_STEPS);
+
+  for (; iter; iter = g_list_next (iter))
+    gimp_image_undo_collect_drawable_undos (iter->data, &undos);
+
+  return undos;
+}
+
+static void
+gimp_image_undo_compress (GimpImage *image)
+{
+  GList *undos = gimp_image_undo_get_cold_undos (image);
+  GList *iter;
+
+  for (iter = undos; iter; iter = g_list_next (iter))
+    gimp_drawable_undo_compress (iter->data);
+
+  g_list_free (undos);
+}
+
+/*  starts spilling the oldest undo step which isn't spilled yet, the
+ *  step stops counting against undo-size right away
+ */
+static gboolean
+gimp_image_undo_spill (GimpImage *image)
+{
+  GList    *undos;
+  GList    *iter;
+  GFile    *swap_dir;
+  gboolean  spilled = FALSE;
+
+  swap_dir = gimp_drawable_undo_get_swap_dir (image->gimp);
+
+  if (! swap_dir)
+    return FALSE;
+
+  undos = gimp_image_undo_get_cold_undos (image);
+
+  for (iter = undos; iter; iter = g_list_next (iter))
+    {
+      if (gimp_drawable_undo_spill (iter->data, swap_dir))
+        {
+          spilled = TRUE;
+          break;
+        }
+    }
+
+  g_object_unref (swap_dir);
+  g_list_free (undos);
+
+  return spilled;
+}
+
 static void
 gimp_image_undo_free_redo (GimpImage *image)
 {
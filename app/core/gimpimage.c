@@ -70,6 +70,7 @@
 #include "gimpmarshal.h"
 #include "gimpparasitelist.h"
 #include "gimppickable.h"
+#include "gimppickable-contiguous-region.h"
 #include "gimpprojectable.h"
 #include "gimpprojection.h"
 #include "gimpsamplepoint.h"
@@ -1159,6 +1160,8 @@ gimp_image_get_memsize (GimpObject *object,
   memsize += gimp_object_get_memsize (GIMP_OBJECT (private->projection),
                                       gui_size);
 
+  memsize += gimp_pickable_contiguous_region_get_cache_memsize (GIMP_PICKABLE (image));
+
   memsize += gimp_g_list_get_memsize (gimp_image_get_guides (image),
                                       sizeof (GimpGuide));
 
@@ -2524,6 +2527,26 @@ gimp_image_get_xcf_version (GimpImage    *image,
       version = MAX (8, version);
     }
 
+  /* Glimpse's own extensions use versions from 900 on, which don't
+   * collide with the versions of upstream GIMP, see xcf-private.h
+   */
+
+  /* need version 900 for per-tile codecs */
+  if (image->gimp->config->xcf_fast_compression)
+    {
+      ADD_REASON (g_strdup_printf (_("Fast internal compression was "
+                                     "added in %s"), "Glimpse 0.2"));
+      version = MAX (900, version);
+    }
+
+  /* need version 901 for mipmap levels */
+  if (image->gimp->config->xcf_save_mipmaps)
+    {
+      ADD_REASON (g_strdup_printf (_("Saving reduced-size layer copies was "
+                                     "added in %s"), "Glimpse 0.2"));
+      version = MAX (901, version);
+    }
+
   /* if version is 10 (lots of new layer modes), go to version 11 with
    * 64 bit offsets right away
    */
@@ -2570,6 +2593,12 @@ gimp_image_get_xcf_version (GimpImage    *image,
       if (gimp_version)   *gimp_version   = 210;
       if (version_string) *version_string = "GIMP 2.10";
       break;
+
+    case 900:
+    case 901:
+      if (gimp_version)   *gimp_version   = 210;
+      if (version_string) *version_string = "Glimpse 0.2";
+      break;
     }
 
   if (version_reason && reasons)
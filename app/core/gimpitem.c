@@ -1441,15 +1441,12 @@ gimp_item_scale_by_factors_with_origin (GimpItem              *item,
                                         GimpInterpolationType  interpolation,
                                         GimpProgress          *progress)
 {
-  GimpItemPrivate *private;
-  gint             new_width, new_height;
-  gint             new_offset_x, new_offset_y;
+  gint new_width, new_height;
+  gint new_offset_x, new_offset_y;
 
   g_return_val_if_fail (GIMP_IS_ITEM (item), FALSE);
   g_return_val_if_fail (progress == NULL || GIMP_IS_PROGRESS (progress), FALSE);
 
-  private = GET_PRIVATE (item);
-
   if (w_factor <= 0.0 || h_factor <= 0.0)
     {
       g_warning ("%s: requested width or height scale is non-positive",
@@ -1457,19 +1454,12 @@ gimp_item_scale_by_factors_with_origin (GimpItem              *item,
       return FALSE;
     }
 
-  new_offset_x = SIGNED_ROUND (w_factor * (private->offset_x - origin_x));
-  new_offset_y = SIGNED_ROUND (h_factor * (private->offset_y - origin_y));
-  new_width    = SIGNED_ROUND (w_factor * (private->offset_x - origin_x +
-                                           gimp_item_get_width (item))) -
-                 new_offset_x;
-  new_height   = SIGNED_ROUND (h_factor * (private->offset_y - origin_y +
-                                           gimp_item_get_height (item))) -
-                 new_offset_y;
-
-  new_offset_x += new_origin_x;
-  new_offset_y += new_origin_y;
-
-  if (new_width > 0 && new_height > 0)
+  if (gimp_item_scale_by_factors_bounds (item,
+                                         w_factor, h_factor,
+                                         origin_x, origin_y,
+                                         new_origin_x, new_origin_y,
+                                         &new_offset_x, &new_offset_y,
+                                         &new_width, &new_height))
     {
       gimp_item_scale (item,
                        new_width, new_height,
@@ -1481,6 +1471,63 @@ gimp_item_scale_by_factors_with_origin (GimpItem              *item,
   return FALSE;
 }
 
+/**
+ * gimp_item_scale_by_factors_bounds:
+ * @item:         an item
+ * @w_factor:     scale factor to apply to width and horizontal offset
+ * @h_factor:     scale factor to apply to height and vertical offset
+ * @origin_x:     x-coordinate of the transformation input origin
+ * @origin_y:     y-coordinate of the transformation input origin
+ * @new_origin_x: x-coordinate of the transformation output origin
+ * @new_origin_y: y-coordinate of the transformation output origin
+ * @new_offset_x: return location for the new horizontal offset
+ * @new_offset_y: return location for the new vertical offset
+ * @new_width:    return location for the new width
+ * @new_height:   return location for the new height
+ *
+ * Computes the geometry gimp_item_scale_by_factors_with_origin()
+ * would give @item, without scaling it.
+ *
+ * Returns: #TRUE, if the scaled item has positive dimensions
+ *          #FALSE if the scaled item has at least one zero dimension
+ **/
+gboolean
+gimp_item_scale_by_factors_bounds (GimpItem *item,
+                                   gdouble   w_factor,
+                                   gdouble   h_factor,
+                                   gint      origin_x,
+                                   gint      origin_y,
+                                   gint      new_origin_x,
+                                   gint      new_origin_y,
+                                   gint     *new_offset_x,
+                                   gint     *new_offset_y,
+                                   gint     *new_width,
+                                   gint     *new_height)
+{
+  GimpItemPrivate *private;
+  gint             offset_x, offset_y;
+
+  g_return_val_if_fail (GIMP_IS_ITEM (item), FALSE);
+  g_return_val_if_fail (new_offset_x != NULL && new_offset_y != NULL, FALSE);
+  g_return_val_if_fail (new_width != NULL && new_height != NULL, FALSE);
+
+  private = GET_PRIVATE (item);
+
+  offset_x    = SIGNED_ROUND (w_factor * (private->offset_x - origin_x));
+  offset_y    = SIGNED_ROUND (h_factor * (private->offset_y - origin_y));
+  *new_width  = SIGNED_ROUND (w_factor * (private->offset_x - origin_x +
+                                          gimp_item_get_width (item))) -
+                offset_x;
+  *new_height = SIGNED_ROUND (h_factor * (private->offset_y - origin_y +
+                                          gimp_item_get_height (item))) -
+                offset_y;
+
+  *new_offset_x = offset_x + new_origin_x;
+  *new_offset_y = offset_y + new_origin_y;
+
+  return (*new_width > 0 && *new_height > 0);
+}
+
 /**
  * gimp_item_scale_by_origin:
  * @item:         The item to be transformed by width & height scale factors
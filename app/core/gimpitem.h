@@ -255,6 +255,18 @@ gboolean
                                               gint                new_origin_y,
                                               GimpInterpolationType interpolation,
                                               GimpProgress       *progress);
+gboolean
+      gimp_item_scale_by_factors_bounds      (GimpItem           *item,
+                                              gdouble             w_factor,
+                                              gdouble             h_factor,
+                                              gint                origin_x,
+                                              gint                origin_y,
+                                              gint                new_origin_x,
+                                              gint                new_origin_y,
+                                              gint               *new_offset_x,
+                                              gint               *new_offset_y,
+                                              gint               *new_width,
+                                              gint               *new_height);
 void            gimp_item_scale_by_origin    (GimpItem           *item,
                                               gint                new_width,
                                               gint                new_height,
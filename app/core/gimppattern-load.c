@@ -217,3 +217,65 @@ gimp_pattern_load_pixbuf (GimpContext   *context,
 
   return g_list_prepend (NULL, pattern);
 }
+
+/**
+ * gimp_pattern_load_mask:
+ * @file:  a pattern file
+ * @error: return location for errors
+ *
+ * Loads only the pixels of the pattern in @file, using the same
+ * loader the pattern factory would use.
+ *
+ * Returns: the pattern's mask, or %NULL on error.
+ **/
+GimpTempBuf *
+gimp_pattern_load_mask (GFile   *file,
+                        GError **error)
+{
+  GInputStream *input;
+  GList        *list = NULL;
+  GimpTempBuf  *mask = NULL;
+
+  g_return_val_if_fail (G_IS_FILE (file), NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  input = G_INPUT_STREAM (g_file_read (file, NULL, error));
+
+  if (! input)
+    {
+      g_prefix_error (error,
+                      _("Could not open '%s' for reading: "),
+                      gimp_file_get_utf8_name (file));
+      return NULL;
+    }
+
+  if (gimp_file_has_extension (file, GIMP_PATTERN_FILE_EXTENSION))
+    list = gimp_pattern_load (NULL, file, input, error);
+  else
+    list = gimp_pattern_load_pixbuf (NULL, file, input, error);
+
+  g_object_unref (input);
+
+  if (list)
+    {
+      GimpPattern *pattern = list->data;
+
+      mask = gimp_temp_buf_ref (pattern->mask);
+
+      g_list_free_full (list, (GDestroyNotify) g_object_unref);
+    }
+  else if (error && ! *error)
+    {
+      g_set_error (error, GIMP_DATA_ERROR, GIMP_DATA_ERROR_READ,
+                   _("Error loading '%s'"),
+                   gimp_file_get_utf8_name (file));
+    }
+  else
+    {
+      g_prefix_error (error,
+                      _("Error loading '%s': "),
+                      gimp_file_get_utf8_name (file));
+    }
+
+  return mask;
+}
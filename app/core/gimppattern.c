@@ -28,6 +28,7 @@
 
 #include "gegl/gimp-gegl-loops.h"
 
+#include "gimpdataindex.h"
 #include "gimppattern.h"
 #include "gimppattern-load.h"
 #include "gimppattern-save.h"
@@ -37,6 +38,13 @@
 #include "gimp-intl.h"
 
 
+/*  serializes loading the masks of patterns created from the index,
+ *  and protects their index_checksum and index_preview, which are
+ *  freed once the mask is loaded
+ */
+G_LOCK_DEFINE_STATIC (pattern_mask);
+
+
 static void          gimp_pattern_tagged_iface_init (GimpTaggedInterface  *iface);
 static void          gimp_pattern_finalize          (GObject              *object);
 
@@ -107,6 +115,8 @@ gimp_pattern_finalize (GObject *object)
   GimpPattern *pattern = GIMP_PATTERN (object);
 
   g_clear_pointer (&pattern->mask, gimp_temp_buf_unref);
+  g_clear_pointer (&pattern->index_checksum, g_free);
+  g_clear_pointer (&pattern->index_preview, gimp_temp_buf_unref);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -118,7 +128,12 @@ gimp_pattern_get_memsize (GimpObject *object,
   GimpPattern *pattern = GIMP_PATTERN (object);
   gint64       memsize = 0;
 
+  G_LOCK (pattern_mask);
+
   memsize += gimp_temp_buf_get_memsize (pattern->mask);
+  memsize += gimp_temp_buf_get_memsize (pattern->index_preview);
+
+  G_UNLOCK (pattern_mask);
 
   return memsize + GIMP_OBJECT_CLASS (parent_class)->get_memsize (object,
                                                                   gui_size);
@@ -131,8 +146,20 @@ gimp_pattern_get_size (GimpViewable *viewable,
 {
   GimpPattern *pattern = GIMP_PATTERN (viewable);
 
-  *width  = gimp_temp_buf_get_width  (pattern->mask);
-  *height = gimp_temp_buf_get_height (pattern->mask);
+  G_LOCK (pattern_mask);
+
+  if (pattern->mask)
+    {
+      *width  = gimp_temp_buf_get_width  (pattern->mask);
+      *height = gimp_temp_buf_get_height (pattern->mask);
+    }
+  else
+    {
+      *width  = pattern->index_width;
+      *height = pattern->index_height;
+    }
+
+  G_UNLOCK (pattern_mask);
 
   return TRUE;
 }
@@ -144,19 +171,42 @@ gimp_pattern_get_new_preview (GimpViewable *viewable,
                               gint          height)
 {
   GimpPattern *pattern = GIMP_PATTERN (viewable);
+  GimpTempBuf *mask    = NULL;
   GimpTempBuf *temp_buf;
   GeglBuffer  *src_buffer;
   GeglBuffer  *dest_buffer;
+  gint         pattern_width;
+  gint         pattern_height;
   gint         copy_width;
   gint         copy_height;
 
-  copy_width  = MIN (width,  gimp_temp_buf_get_width  (pattern->mask));
-  copy_height = MIN (height, gimp_temp_buf_get_height (pattern->mask));
+  gimp_pattern_get_size (viewable, &pattern_width, &pattern_height);
+
+  copy_width  = MIN (width,  pattern_width);
+  copy_height = MIN (height, pattern_height);
+
+  /*  the preview is the pattern's top-left corner, so as long as it
+   *  fits into the one from the index, don't load the whole pattern
+   */
+  G_LOCK (pattern_mask);
+
+  if (! pattern->mask          &&
+      pattern->index_preview   &&
+      copy_width  <= gimp_temp_buf_get_width  (pattern->index_preview) &&
+      copy_height <= gimp_temp_buf_get_height (pattern->index_preview))
+    {
+      mask = gimp_temp_buf_ref (pattern->index_preview);
+    }
+
+  G_UNLOCK (pattern_mask);
+
+  if (! mask)
+    mask = gimp_temp_buf_ref (gimp_pattern_get_mask (pattern));
 
   temp_buf = gimp_temp_buf_new (copy_width, copy_height,
-                                gimp_temp_buf_get_format (pattern->mask));
+                                gimp_temp_buf_get_format (mask));
 
-  src_buffer  = gimp_temp_buf_create_buffer (pattern->mask);
+  src_buffer  = gimp_temp_buf_create_buffer (mask);
   dest_buffer = gimp_temp_buf_create_buffer (temp_buf);
 
   gimp_gegl_buffer_copy (src_buffer,
@@ -167,6 +217,8 @@ gimp_pattern_get_new_preview (GimpViewable *viewable,
   g_object_unref (src_buffer);
   g_object_unref (dest_buffer);
 
+  gimp_temp_buf_unref (mask);
+
   return temp_buf;
 }
 
@@ -175,11 +227,14 @@ gimp_pattern_get_description (GimpViewable  *viewable,
                               gchar        **tooltip)
 {
   GimpPattern *pattern = GIMP_PATTERN (viewable);
+  gint         width;
+  gint         height;
+
+  gimp_pattern_get_size (viewable, &width, &height);
 
   return g_strdup_printf ("%s (%d × %d)",
                           gimp_object_get_name (pattern),
-                          gimp_temp_buf_get_width  (pattern->mask),
-                          gimp_temp_buf_get_height (pattern->mask));
+                          width, height);
 }
 
 static const gchar *
@@ -196,7 +251,7 @@ gimp_pattern_copy (GimpData *data,
   GimpPattern *src_pattern = GIMP_PATTERN (src_data);
 
   g_clear_pointer (&pattern->mask, gimp_temp_buf_unref);
-  pattern->mask = gimp_temp_buf_copy (src_pattern->mask);
+  pattern->mask = gimp_temp_buf_copy (gimp_pattern_get_mask (src_pattern));
 
   gimp_data_dirty (data);
 }
@@ -205,14 +260,30 @@ static gchar *
 gimp_pattern_get_checksum (GimpTagged *tagged)
 {
   GimpPattern *pattern         = GIMP_PATTERN (tagged);
+  GimpTempBuf *mask;
   gchar       *checksum_string = NULL;
 
-  if (pattern->mask)
+  /*  the tag cache asks for the checksum of all patterns, don't load
+   *  them just for that
+   */
+  G_LOCK (pattern_mask);
+
+  if (! pattern->mask)
+    checksum_string = g_strdup (pattern->index_checksum);
+
+  G_UNLOCK (pattern_mask);
+
+  if (checksum_string)
+    return checksum_string;
+
+  mask = g_atomic_pointer_get (&pattern->mask);
+
+  if (mask)
     {
       GChecksum *checksum = g_checksum_new (G_CHECKSUM_MD5);
 
-      g_checksum_update (checksum, gimp_temp_buf_get_data (pattern->mask),
-                         gimp_temp_buf_get_data_size (pattern->mask));
+      g_checksum_update (checksum, gimp_temp_buf_get_data (mask),
+                         gimp_temp_buf_get_data_size (mask));
 
       checksum_string = g_strdup (g_checksum_get_string (checksum));
 
@@ -270,12 +341,138 @@ gimp_pattern_get_standard (GimpContext *context)
   return standard_pattern;
 }
 
+/**
+ * gimp_pattern_new_from_index:
+ * @context: a #GimpContext
+ * @entry:   the pattern's entry in the data index
+ *
+ * Creates a pattern from what the data index knows about it, without
+ * reading its file.  The pattern's pixels are loaded from the file
+ * set with gimp_data_set_file() the first time they are needed.
+ *
+ * Returns: a new #GimpPattern
+ **/
+GimpData *
+gimp_pattern_new_from_index (GimpContext              *context,
+                             const GimpDataIndexEntry *entry)
+{
+  GimpPattern *pattern;
+
+  g_return_val_if_fail (entry != NULL, NULL);
+  g_return_val_if_fail (entry->name != NULL, NULL);
+
+  if (entry->width < 1 || entry->height < 1)
+    return NULL;
+
+  pattern = g_object_new (GIMP_TYPE_PATTERN,
+                          "name",      entry->name,
+                          "mime-type", "image/x-gimp-pat",
+                          NULL);
+
+  pattern->index_width    = entry->width;
+  pattern->index_height   = entry->height;
+  pattern->index_checksum = g_strdup (entry->checksum);
+
+  if (entry->preview)
+    pattern->index_preview = gimp_temp_buf_ref (entry->preview);
+
+  return GIMP_DATA (pattern);
+}
+
+/**
+ * gimp_pattern_fill_index_entry:
+ * @data:  a #GimpPattern
+ * @entry: a data index entry
+ *
+ * Stores what gimp_pattern_new_from_index() needs to recreate @data
+ * in @entry.  Only GIMP patterns can be indexed, patterns loaded
+ * through GdkPixbuf are rejected.
+ *
+ * Returns: %TRUE on success.
+ **/
+gboolean
+gimp_pattern_fill_index_entry (GimpData           *data,
+                               GimpDataIndexEntry *entry)
+{
+  GimpPattern *pattern;
+
+  g_return_val_if_fail (GIMP_IS_PATTERN (data), FALSE);
+  g_return_val_if_fail (entry != NULL, FALSE);
+
+  pattern = GIMP_PATTERN (data);
+
+  if (g_strcmp0 (gimp_data_get_mime_type (data), "image/x-gimp-pat") ||
+      ! pattern->mask)
+    {
+      return FALSE;
+    }
+
+  gimp_pattern_get_size (GIMP_VIEWABLE (pattern),
+                         &entry->width, &entry->height);
+
+  g_free (entry->checksum);
+  entry->checksum = gimp_pattern_get_checksum (GIMP_TAGGED (pattern));
+
+  g_clear_pointer (&entry->preview, gimp_temp_buf_unref);
+  entry->preview = gimp_pattern_get_new_preview (GIMP_VIEWABLE (pattern),
+                                                 NULL,
+                                                 GIMP_DATA_INDEX_PREVIEW_SIZE,
+                                                 GIMP_DATA_INDEX_PREVIEW_SIZE);
+
+  return TRUE;
+}
+
 GimpTempBuf *
 gimp_pattern_get_mask (GimpPattern *pattern)
 {
+  GimpTempBuf *mask;
+
   g_return_val_if_fail (GIMP_IS_PATTERN (pattern), NULL);
 
-  return pattern->mask;
+  mask = g_atomic_pointer_get (&pattern->mask);
+
+  if (G_UNLIKELY (! mask))
+    {
+      G_LOCK (pattern_mask);
+
+      mask = pattern->mask;
+
+      if (! mask)
+        {
+          GFile  *file  = gimp_data_get_file (GIMP_DATA (pattern));
+          GError *error = NULL;
+
+          if (file)
+            mask = gimp_pattern_load_mask (file, &error);
+
+          if (! mask)
+            {
+              if (error)
+                {
+                  g_printerr ("%s\n", error->message);
+                  g_clear_error (&error);
+                }
+
+              /*  keep the promised size, and don't retry every time  */
+              mask = gimp_temp_buf_new (MAX (pattern->index_width,  1),
+                                        MAX (pattern->index_height, 1),
+                                        babl_format ("R'G'B' u8"));
+              gimp_temp_buf_data_clear (mask);
+            }
+
+          g_clear_pointer (&pattern->index_checksum, g_free);
+          g_clear_pointer (&pattern->index_preview, gimp_temp_buf_unref);
+
+          /*  publish the mask only once it is complete, since readers
+           *  don't take the lock once it is set
+           */
+          g_atomic_pointer_set (&pattern->mask, mask);
+        }
+
+      G_UNLOCK (pattern_mask);
+    }
+
+  return mask;
 }
 
 GeglBuffer *
@@ -283,5 +480,5 @@ gimp_pattern_create_buffer (GimpPattern *pattern)
 {
   g_return_val_if_fail (GIMP_IS_PATTERN (pattern), NULL);
 
-  return gimp_temp_buf_create_buffer (pattern->mask);
+  return gimp_temp_buf_create_buffer (gimp_pattern_get_mask (pattern));
 }
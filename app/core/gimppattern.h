@@ -37,6 +37,14 @@ struct _GimpPattern
   GimpData     parent_instance;
 
   GimpTempBuf *mask;
+
+  /*  what the data index knows about the pattern, until the mask is
+   *  loaded on first use, see gimp_pattern_new_from_index()
+   */
+  gint         index_width;
+  gint         index_height;
+  gchar       *index_checksum;
+  GimpTempBuf *index_preview;
 };
 
 struct _GimpPatternClass
@@ -45,14 +53,19 @@ struct _GimpPatternClass
 };
 
 
-GType         gimp_pattern_get_type      (void) G_GNUC_CONST;
+GType         gimp_pattern_get_type          (void) G_GNUC_CONST;
+
+GimpData    * gimp_pattern_new               (GimpContext              *context,
+                                              const gchar              *name);
+GimpData    * gimp_pattern_get_standard      (GimpContext              *context);
 
-GimpData    * gimp_pattern_new           (GimpContext *context,
-                                          const gchar *name);
-GimpData    * gimp_pattern_get_standard  (GimpContext *context);
+GimpData    * gimp_pattern_new_from_index    (GimpContext              *context,
+                                              const GimpDataIndexEntry *entry);
+gboolean      gimp_pattern_fill_index_entry  (GimpData                 *data,
+                                              GimpDataIndexEntry       *entry);
 
-GimpTempBuf * gimp_pattern_get_mask      (GimpPattern *pattern);
-GeglBuffer  * gimp_pattern_create_buffer (GimpPattern *pattern);
+GimpTempBuf * gimp_pattern_get_mask          (GimpPattern              *pattern);
+GeglBuffer  * gimp_pattern_create_buffer     (GimpPattern              *pattern);
 
 
 #endif /* __GIMP_PATTERN_H__ */
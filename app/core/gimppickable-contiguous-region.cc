@@ -18,6 +18,7 @@
 #include "config.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 #include <cairo.h>
 #include <gegl.h>
@@ -46,6 +47,14 @@ extern "C"
 #define PIXELS_PER_THREAD \
   (/* each thread costs as much as */ 64.0 * 64.0 /* pixels */)
 
+#define CACHE_DATA_KEY "gimp-pickable-contiguous-region-cache"
+
+/*  an unused cache is dropped after this many seconds  */
+#define CACHE_IDLE_TIMEOUT 30
+
+/*  the largest fraction of the tile cache a labeling may take  */
+#define CACHE_MAX_TILE_CACHE_FRACTION 0.25
+
 
 typedef struct
 {
@@ -54,6 +63,38 @@ typedef struct
   gint   level;
 } BorderPixel;
 
+typedef struct
+{
+  GimpPickable        *pickable;      /* the cache's owner                  */
+  GeglBuffer          *src_buffer;    /* weak pointer                       */
+  gint                 valid;         /* cleared when src_buffer changes    */
+  guint                idle_id;       /* drops the cache when unused        */
+
+  const Babl          *format;
+  gint                 n_components;
+  gboolean             has_alpha;
+  gboolean             select_transparent;
+  GimpSelectCriterion  select_criterion;
+  gboolean             antialias;
+  gfloat               threshold;
+  gboolean             diagonal_neighbors;
+  gfloat               col[MAX_CHANNELS];
+
+  GeglRectangle        extent;
+  gint                 tile_width;
+  gint                 tile_height;
+  gint                 n_tile_cols;
+  gint                 n_tile_rows;
+
+  GeglBuffer          *label_buffer;  /* tile-local labels, 0 = unselected,
+                                       * NULL until the cache is reused     */
+  GeglBuffer          *diff_buffer;   /* antialiased mask values            */
+  guint32             *label_offsets; /* per tile, first global label - 1   */
+  guint32             *parents;       /* global label -> component root     */
+  guint32              n_labels;
+  gint64               memsize;
+} ContiguousRegionCache;
+
 
 /*  local function prototypes  */
 
@@ -114,6 +155,29 @@ static void     find_contiguous_region    (GeglBuffer          *src_buffer,
                                            gint                 y,
                                            const gfloat        *col);
 
+static void     contiguous_region_cache_free        (ContiguousRegionCache *cache);
+static void     contiguous_region_cache_src_changed (GeglBuffer            *buffer,
+                                                     const GeglRectangle   *rect,
+                                                     ContiguousRegionCache *cache);
+static gboolean contiguous_region_cache_idle_drop   (ContiguousRegionCache *cache);
+static ContiguousRegionCache *
+                contiguous_region_cache_get         (GimpPickable          *pickable,
+                                                     GeglBuffer            *src_buffer,
+                                                     const Babl            *format,
+                                                     gint                   n_components,
+                                                     gboolean               has_alpha,
+                                                     gboolean               select_transparent,
+                                                     GimpSelectCriterion    select_criterion,
+                                                     gboolean               antialias,
+                                                     gfloat                 threshold,
+                                                     gboolean               diagonal_neighbors,
+                                                     const gfloat          *col);
+static gboolean contiguous_region_cache_label       (ContiguousRegionCache *cache);
+static void     contiguous_region_cache_extract     (ContiguousRegionCache *cache,
+                                                     GeglBuffer            *mask_buffer,
+                                                     gint                   x,
+                                                     gint                   y);
+
 static void            line_art_queue_pixel (GQueue              *queue,
                                              gint                 x,
                                              gint                 y,
@@ -173,13 +237,33 @@ gimp_pickable_contiguous_region_by_seed (GimpPickable        *pickable,
   if (x >= extent.x && x < (extent.x + extent.width) &&
       y >= extent.y && y < (extent.y + extent.height))
     {
+      ContiguousRegionCache *cache;
+
       GIMP_TIMER_START();
 
-      find_contiguous_region (src_buffer, mask_buffer,
-                              format, n_components, has_alpha,
-                              select_transparent, select_criterion,
-                              antialias, threshold, diagonal_neighbors,
-                              x, y, start_col);
+      cache = contiguous_region_cache_get (pickable, src_buffer,
+                                           format, n_components, has_alpha,
+                                           select_transparent, select_criterion,
+                                           antialias, threshold,
+                                           diagonal_neighbors, start_col);
+
+      /*  labeling the whole pickable only pays off when it's reused, so
+       *  the first fill of a color uses the scanline fill, which only
+       *  visits the seed's region, and the pickable is labeled on the
+       *  second one
+       */
+      if (cache && cache->label_buffer)
+        {
+          contiguous_region_cache_extract (cache, mask_buffer, x, y);
+        }
+      else
+        {
+          find_contiguous_region (src_buffer, mask_buffer,
+                                  format, n_components, has_alpha,
+                                  select_transparent, select_criterion,
+                                  antialias, threshold, diagonal_neighbors,
+                                  x, y, start_col);
+        }
 
       GIMP_TIMER_END("foo");
     }
@@ -187,6 +271,19 @@ gimp_pickable_contiguous_region_by_seed (GimpPickable        *pickable,
   return mask_buffer;
 }
 
+gint64
+gimp_pickable_contiguous_region_get_cache_memsize (GimpPickable *pickable)
+{
+  ContiguousRegionCache *cache;
+
+  g_return_val_if_fail (GIMP_IS_PICKABLE (pickable), 0);
+
+  cache = (ContiguousRegionCache *) g_object_get_data (G_OBJECT (pickable),
+                                                       CACHE_DATA_KEY);
+
+  return cache ? cache->memsize : 0;
+}
+
 GeglBuffer *
 gimp_pickable_contiguous_region_by_color (GimpPickable        *pickable,
                                           gboolean             antialias,
@@ -1101,6 +1198,656 @@ find_contiguous_region (GeglBuffer          *src_buffer,
 #endif
 }
 
+/*  Once the same color is filled or selected a second time, with the
+ *  same options, the by-seed region is computed by labeling the
+ *  connected components of all pixels matching the seed color: every
+ *  tile is labeled on its own, in parallel, and the labels of
+ *  neighboring tiles are then merged along the tile borders using a
+ *  union-find forest.  The result is kept on the pickable, so that
+ *  further fills only need to extract a component.  The cache is
+ *  dropped when it's unused for a while, and isn't built at all when it
+ *  would take too large a share of the tile cache.
+ */
+
+static void
+contiguous_region_cache_free (ContiguousRegionCache *cache)
+{
+  if (cache->idle_id)
+    g_source_remove (cache->idle_id);
+
+  if (cache->src_buffer)
+    {
+      g_signal_handlers_disconnect_by_func (
+        cache->src_buffer,
+        (gpointer) contiguous_region_cache_src_changed,
+        cache);
+
+      g_object_remove_weak_pointer (G_OBJECT (cache->src_buffer),
+                                    (gpointer *) &cache->src_buffer);
+    }
+
+  g_clear_object (&cache->diff_buffer);
+  g_clear_object (&cache->label_buffer);
+
+  g_free (cache->label_offsets);
+  g_free (cache->parents);
+
+  g_slice_free (ContiguousRegionCache, cache);
+}
+
+static gboolean
+contiguous_region_cache_idle_drop (ContiguousRegionCache *cache)
+{
+  cache->idle_id = 0;
+
+  g_object_set_data (G_OBJECT (cache->pickable), CACHE_DATA_KEY, NULL);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+contiguous_region_cache_src_changed (GeglBuffer            *buffer,
+                                     const GeglRectangle   *rect,
+                                     ContiguousRegionCache *cache)
+{
+  /*  may be called from any thread  */
+  g_atomic_int_set (&cache->valid, FALSE);
+}
+
+static gboolean
+contiguous_region_cache_matches (ContiguousRegionCache *cache,
+                                 GeglBuffer            *src_buffer,
+                                 const Babl            *format,
+                                 gboolean               select_transparent,
+                                 GimpSelectCriterion    select_criterion,
+                                 gboolean               antialias,
+                                 gfloat                 threshold,
+                                 gboolean               diagonal_neighbors,
+                                 const gfloat          *col)
+{
+  return (g_atomic_int_get (&cache->valid)                           &&
+          cache->src_buffer         == src_buffer                    &&
+          gegl_rectangle_equal (&cache->extent,
+                                gegl_buffer_get_extent (src_buffer)) &&
+          cache->format             == format                        &&
+          cache->select_transparent == select_transparent            &&
+          cache->select_criterion   == select_criterion              &&
+          cache->antialias          == antialias                     &&
+          cache->threshold          == threshold                     &&
+          cache->diagonal_neighbors == diagonal_neighbors            &&
+          ! memcmp (cache->col, col,
+                    cache->n_components * sizeof (gfloat)));
+}
+
+static void
+contiguous_region_cache_get_tile (ContiguousRegionCache *cache,
+                                  gint                   tile,
+                                  GeglRectangle         *rect)
+{
+  gint tile_x = tile % cache->n_tile_cols;
+  gint tile_y = tile / cache->n_tile_cols;
+
+  rect->x      = cache->extent.x + tile_x * cache->tile_width;
+  rect->y      = cache->extent.y + tile_y * cache->tile_height;
+  rect->width  = MIN (cache->tile_width,
+                      cache->extent.x + cache->extent.width - rect->x);
+  rect->height = MIN (cache->tile_height,
+                      cache->extent.y + cache->extent.height - rect->y);
+}
+
+static inline guint32
+contiguous_region_cache_get_label (ContiguousRegionCache *cache,
+                                   gint                   x,
+                                   gint                   y,
+                                   guint32                local_label)
+{
+  gint tile;
+
+  if (! local_label)
+    return 0;
+
+  tile = ((y - cache->extent.y) / cache->tile_height) * cache->n_tile_cols +
+         ((x - cache->extent.x) / cache->tile_width);
+
+  return cache->label_offsets[tile] + local_label;
+}
+
+static inline guint32
+label_find (guint32 *parents,
+            guint32  label)
+{
+  while (parents[label] != label)
+    {
+      parents[label] = parents[parents[label]];
+      label          = parents[label];
+    }
+
+  return label;
+}
+
+static inline void
+label_union (guint32 *parents,
+             guint32  label1,
+             guint32  label2)
+{
+  label1 = label_find (parents, label1);
+  label2 = label_find (parents, label2);
+
+  /*  always link to the smaller root, so that parents[label] <= label  */
+  if (label1 < label2)
+    parents[label2] = label1;
+  else if (label2 < label1)
+    parents[label1] = label2;
+}
+
+static guint32
+label_tile (const gfloat *diff,
+            guint32      *labels,
+            guint32      *parents,
+            gint          width,
+            gint          height,
+            gboolean      diagonal_neighbors)
+{
+  guint32 n_labels = 0;
+  guint32 n_roots  = 0;
+  guint32 label;
+  gint    x, y;
+  gint    i;
+
+  for (y = 0, i = 0; y < height; y++)
+    {
+      for (x = 0; x < width; x++, i++)
+        {
+          guint32 neighbors[4];
+          gint    n_neighbors = 0;
+          gint    j;
+
+          if (diff[i] == 0.0)
+            {
+              labels[i] = 0;
+
+              continue;
+            }
+
+          if (x > 0)
+            neighbors[n_neighbors++] = labels[i - 1];
+
+          if (y > 0)
+            {
+              neighbors[n_neighbors++] = labels[i - width];
+
+              if (diagonal_neighbors)
+                {
+                  if (x > 0)
+                    neighbors[n_neighbors++] = labels[i - width - 1];
+
+                  if (x < width - 1)
+                    neighbors[n_neighbors++] = labels[i - width + 1];
+                }
+            }
+
+          label = 0;
+
+          for (j = 0; j < n_neighbors; j++)
+            {
+              if (! neighbors[j])
+                continue;
+
+              if (! label)
+                label = neighbors[j];
+              else
+                label_union (parents, label, neighbors[j]);
+            }
+
+          if (! label)
+            {
+              label          = ++n_labels;
+              parents[label] = label;
+            }
+
+          labels[i] = label;
+        }
+    }
+
+  /*  number the components consecutively.  since parents[label] <= label,
+   *  a single pass in label order sees every root before its children.
+   */
+  for (label = 1; label <= n_labels; label++)
+    {
+      if (parents[label] == label)
+        parents[label] = ++n_roots;
+      else
+        parents[label] = parents[parents[label]];
+    }
+
+  for (i = 0; i < width * height; i++)
+    labels[i] = parents[labels[i]];
+
+  return n_roots;
+}
+
+/*  creates a cache which only remembers the fill options, the pickable
+ *  is labeled by contiguous_region_cache_label() once they're reused
+ */
+static ContiguousRegionCache *
+contiguous_region_cache_new (GimpPickable        *pickable,
+                             GeglBuffer          *src_buffer,
+                             const Babl          *format,
+                             gint                 n_components,
+                             gboolean             has_alpha,
+                             gboolean             select_transparent,
+                             GimpSelectCriterion  select_criterion,
+                             gboolean             antialias,
+                             gfloat               threshold,
+                             gboolean             diagonal_neighbors,
+                             const gfloat        *col)
+{
+  ContiguousRegionCache *cache = g_slice_new0 (ContiguousRegionCache);
+
+  cache->pickable           = pickable;
+  cache->src_buffer         = src_buffer;
+  cache->valid              = TRUE;
+  cache->format             = format;
+  cache->n_components       = n_components;
+  cache->has_alpha          = has_alpha;
+  cache->select_transparent = select_transparent;
+  cache->select_criterion   = select_criterion;
+  cache->antialias          = antialias;
+  cache->threshold          = threshold;
+  cache->diagonal_neighbors = diagonal_neighbors;
+  cache->extent             = *gegl_buffer_get_extent (src_buffer);
+
+  memcpy (cache->col, col, n_components * sizeof (gfloat));
+
+  g_object_add_weak_pointer (G_OBJECT (src_buffer),
+                             (gpointer *) &cache->src_buffer);
+
+  gegl_buffer_signal_connect (src_buffer, "changed",
+                              G_CALLBACK (contiguous_region_cache_src_changed),
+                              cache);
+
+  g_object_get (src_buffer,
+                "tile-width",  &cache->tile_width,
+                "tile-height", &cache->tile_height,
+                NULL);
+
+  cache->n_tile_cols = (cache->extent.width  + cache->tile_width  - 1) /
+                       cache->tile_width;
+  cache->n_tile_rows = (cache->extent.height + cache->tile_height - 1) /
+                       cache->tile_height;
+
+  return cache;
+}
+
+static gboolean
+contiguous_region_cache_label (ContiguousRegionCache *cache)
+{
+  const Babl          *label_format       = babl_format ("Y u32");
+  GeglBuffer          *src_buffer         = cache->src_buffer;
+  const Babl          *format             = cache->format;
+  gint                 n_components       = cache->n_components;
+  gboolean             has_alpha          = cache->has_alpha;
+  gboolean             select_transparent = cache->select_transparent;
+  GimpSelectCriterion  select_criterion   = cache->select_criterion;
+  gboolean             antialias          = cache->antialias;
+  gfloat               threshold          = cache->threshold;
+  gboolean             diagonal_neighbors = cache->diagonal_neighbors;
+  const gfloat        *col                = cache->col;
+  guint64              tile_cache_size;
+  gint64               memsize;
+  guint32             *label_counts;
+  guint32             *strip;
+  gint                 n_tiles;
+  gint                 t;
+  gint                 i;
+
+  /*  4 bytes of labels per pixel, and as many of antialiased values  */
+  memsize = (gint64) cache->extent.width * cache->extent.height *
+            (antialias && threshold > 0.0 ? 8 : 4);
+
+  g_object_get (gegl_config (),
+                "tile-cache-size", &tile_cache_size,
+                NULL);
+
+  if (memsize > tile_cache_size * CACHE_MAX_TILE_CACHE_FRACTION)
+    return FALSE;
+
+  n_tiles = cache->n_tile_cols * cache->n_tile_rows;
+
+  cache->label_buffer = gegl_buffer_new (&cache->extent, label_format);
+
+  /*  without antialiasing, every pixel of the region is fully selected  */
+  if (antialias && threshold > 0.0)
+    {
+      cache->diff_buffer = gegl_buffer_new (&cache->extent,
+                                            babl_format ("Y float"));
+    }
+
+  label_counts = g_new0 (guint32, n_tiles);
+
+  gegl_parallel_distribute_range (
+    n_tiles, 1,
+    [=] (gint offset, gint size)
+    {
+      gint     n_pixels = cache->tile_width * cache->tile_height;
+      gfloat  *src      = g_new (gfloat,  n_pixels * n_components);
+      gfloat  *diff     = g_new (gfloat,  n_pixels);
+      guint32 *labels   = g_new (guint32, n_pixels);
+      guint32 *parents  = g_new (guint32, n_pixels + 1);
+      gint     tile;
+
+      for (tile = offset; tile < offset + size; tile++)
+        {
+          GeglRectangle  rect;
+          const gfloat  *s;
+          gint           j;
+
+          contiguous_region_cache_get_tile (cache, tile, &rect);
+
+          gegl_buffer_get (src_buffer, &rect, 1.0, format, src,
+                           GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+          for (j = 0, s = src; j < rect.width * rect.height; j++)
+            {
+              diff[j] = pixel_difference (col, s,
+                                          antialias,
+                                          threshold,
+                                          n_components,
+                                          has_alpha,
+                                          select_transparent,
+                                          select_criterion);
+
+              s += n_components;
+            }
+
+          label_counts[tile] = label_tile (diff, labels, parents,
+                                           rect.width, rect.height,
+                                           diagonal_neighbors);
+
+          if (label_counts[tile])
+            {
+              gegl_buffer_set (cache->label_buffer, &rect, 0, label_format,
+                               labels, GEGL_AUTO_ROWSTRIDE);
+
+              if (cache->diff_buffer)
+                {
+                  gegl_buffer_set (cache->diff_buffer, &rect, 0,
+                                   babl_format ("Y float"), diff,
+                                   GEGL_AUTO_ROWSTRIDE);
+                }
+            }
+        }
+
+      g_free (src);
+      g_free (diff);
+      g_free (labels);
+      g_free (parents);
+    });
+
+  /*  the tile-local labels of tile i map to label_offsets[i] + 1 ...
+   *  label_offsets[i + 1] in the global forest, 0 stays unlabeled
+   */
+  cache->label_offsets = g_new (guint32, n_tiles + 1);
+  cache->label_offsets[0] = 0;
+
+  for (t = 0; t < n_tiles; t++)
+    {
+      cache->label_offsets[t + 1] = cache->label_offsets[t] +
+                                    label_counts[t];
+    }
+
+  g_free (label_counts);
+
+  cache->n_labels = cache->label_offsets[n_tiles];
+  cache->parents  = g_new (guint32, cache->n_labels + 1);
+
+  for (i = 0; i <= (gint) cache->n_labels; i++)
+    cache->parents[i] = i;
+
+  /*  merge the components across vertical tile borders  */
+  strip = g_new (guint32, 2 * MAX (cache->extent.width, cache->extent.height));
+
+  for (i = 1; i < cache->n_tile_cols; i++)
+    {
+      gint x = cache->extent.x + i * cache->tile_width;
+      gint y;
+
+      gegl_buffer_get (cache->label_buffer,
+                       GEGL_RECTANGLE (x - 1, cache->extent.y,
+                                       2, cache->extent.height),
+                       1.0, label_format, strip,
+                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+      for (y = 0; y < cache->extent.height; y++)
+        {
+          guint32 left = contiguous_region_cache_get_label (
+                           cache, x - 1, cache->extent.y + y, strip[2 * y]);
+          gint    dy;
+
+          if (! left)
+            continue;
+
+          for (dy = diagonal_neighbors ? -1 : 0;
+               dy <= (diagonal_neighbors ? 1 : 0);
+               dy++)
+            {
+              guint32 right;
+
+              if (y + dy < 0 || y + dy >= cache->extent.height)
+                continue;
+
+              right = contiguous_region_cache_get_label (
+                        cache, x, cache->extent.y + y + dy,
+                        strip[2 * (y + dy) + 1]);
+
+              if (right)
+                label_union (cache->parents, left, right);
+            }
+        }
+    }
+
+  /*  ... and horizontal ones  */
+  for (i = 1; i < cache->n_tile_rows; i++)
+    {
+      gint y = cache->extent.y + i * cache->tile_height;
+      gint x;
+
+      gegl_buffer_get (cache->label_buffer,
+                       GEGL_RECTANGLE (cache->extent.x, y - 1,
+                                       cache->extent.width, 2),
+                       1.0, label_format, strip,
+                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+      for (x = 0; x < cache->extent.width; x++)
+        {
+          guint32 above = contiguous_region_cache_get_label (
+                            cache, cache->extent.x + x, y - 1, strip[x]);
+          gint    dx;
+
+          if (! above)
+            continue;
+
+          for (dx = diagonal_neighbors ? -1 : 0;
+               dx <= (diagonal_neighbors ? 1 : 0);
+               dx++)
+            {
+              guint32 below;
+
+              if (x + dx < 0 || x + dx >= cache->extent.width)
+                continue;
+
+              below = contiguous_region_cache_get_label (
+                        cache, cache->extent.x + x + dx, y,
+                        strip[cache->extent.width + x + dx]);
+
+              if (below)
+                label_union (cache->parents, above, below);
+            }
+        }
+    }
+
+  g_free (strip);
+
+  /*  point every label directly at its root  */
+  for (i = 1; i <= (gint) cache->n_labels; i++)
+    cache->parents[i] = cache->parents[cache->parents[i]];
+
+  cache->memsize = memsize +
+                   (gint64) (cache->n_labels + 1) * sizeof (guint32) +
+                   (gint64) (n_tiles + 1)         * sizeof (guint32);
+
+  return TRUE;
+}
+
+static ContiguousRegionCache *
+contiguous_region_cache_get (GimpPickable        *pickable,
+                             GeglBuffer          *src_buffer,
+                             const Babl          *format,
+                             gint                 n_components,
+                             gboolean             has_alpha,
+                             gboolean             select_transparent,
+                             GimpSelectCriterion  select_criterion,
+                             gboolean             antialias,
+                             gfloat               threshold,
+                             gboolean             diagonal_neighbors,
+                             const gfloat        *col)
+{
+  ContiguousRegionCache *cache;
+
+  cache = (ContiguousRegionCache *) g_object_get_data (G_OBJECT (pickable),
+                                                       CACHE_DATA_KEY);
+
+  if (cache &&
+      contiguous_region_cache_matches (cache, src_buffer, format,
+                                       select_transparent, select_criterion,
+                                       antialias, threshold,
+                                       diagonal_neighbors, col))
+    {
+      /*  the options are reused, label the pickable unless it's too
+       *  large to keep around
+       */
+      if (! cache->label_buffer && ! contiguous_region_cache_label (cache))
+        {
+          g_object_set_data (G_OBJECT (pickable), CACHE_DATA_KEY, NULL);
+
+          return NULL;
+        }
+    }
+  else
+    {
+      cache = contiguous_region_cache_new (pickable, src_buffer, format,
+                                           n_components, has_alpha,
+                                           select_transparent,
+                                           select_criterion,
+                                           antialias, threshold,
+                                           diagonal_neighbors, col);
+
+      g_object_set_data_full (G_OBJECT (pickable), CACHE_DATA_KEY, cache,
+                              (GDestroyNotify) contiguous_region_cache_free);
+    }
+
+  if (cache->idle_id)
+    g_source_remove (cache->idle_id);
+
+  cache->idle_id =
+    g_timeout_add_seconds (CACHE_IDLE_TIMEOUT,
+                           (GSourceFunc) contiguous_region_cache_idle_drop,
+                           cache);
+
+  return cache;
+}
+
+static void
+contiguous_region_cache_extract (ContiguousRegionCache *cache,
+                                 GeglBuffer            *mask_buffer,
+                                 gint                   x,
+                                 gint                   y)
+{
+  const Babl *label_format = babl_format ("Y u32");
+  guint32     label;
+  guint32     root;
+
+  gegl_buffer_get (cache->label_buffer, GEGL_RECTANGLE (x, y, 1, 1), 1.0,
+                   label_format, &label,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+  label = contiguous_region_cache_get_label (cache, x, y, label);
+
+  /*  the seed pixel itself doesn't match  */
+  if (! label)
+    return;
+
+  root = cache->parents[label];
+
+  gegl_parallel_distribute_range (
+    cache->n_tile_cols * cache->n_tile_rows, 1,
+    [=] (gint offset, gint size)
+    {
+      gint     n_pixels = cache->tile_width * cache->tile_height;
+      guint32 *labels   = g_new (guint32, n_pixels);
+      gfloat  *mask     = g_new (gfloat,  n_pixels);
+      gint     tile;
+
+      for (tile = offset; tile < offset + size; tile++)
+        {
+          const guint32 *parents = cache->parents +
+                                   cache->label_offsets[tile];
+          guint32        n_labels;
+          GeglRectangle  rect;
+          guint32        l;
+          gint           i;
+
+          n_labels = cache->label_offsets[tile + 1] -
+                     cache->label_offsets[tile];
+
+          /*  skip tiles the region doesn't reach  */
+          for (l = 1; l <= n_labels; l++)
+            {
+              if (parents[l] == root)
+                break;
+            }
+
+          if (l > n_labels)
+            continue;
+
+          contiguous_region_cache_get_tile (cache, tile, &rect);
+
+          gegl_buffer_get (cache->label_buffer, &rect, 1.0,
+                           label_format, labels,
+                           GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+          if (cache->diff_buffer)
+            {
+              gegl_buffer_get (cache->diff_buffer, &rect, 1.0,
+                               babl_format ("Y float"), mask,
+                               GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+              for (i = 0; i < rect.width * rect.height; i++)
+                {
+                  if (! labels[i] || parents[labels[i]] != root)
+                    mask[i] = 0.0;
+                }
+            }
+          else
+            {
+              for (i = 0; i < rect.width * rect.height; i++)
+                {
+                  if (labels[i] && parents[labels[i]] == root)
+                    mask[i] = 1.0;
+                  else
+                    mask[i] = 0.0;
+                }
+            }
+
+          gegl_buffer_set (mask_buffer, &rect, 0, babl_format ("Y float"),
+                           mask, GEGL_AUTO_ROWSTRIDE);
+        }
+
+      g_free (labels);
+      g_free (mask);
+    });
+}
+
 static void
 line_art_queue_pixel (GQueue *queue,
                       gint    x,
@@ -28,6 +28,8 @@ GeglBuffer * gimp_pickable_contiguous_region_by_seed                (GimpPickabl
                                                                      gint                 x,
                                                                      gint                 y);
 
+gint64       gimp_pickable_contiguous_region_get_cache_memsize      (GimpPickable        *pickable);
+
 GeglBuffer * gimp_pickable_contiguous_region_by_color               (GimpPickable        *pickable,
                                                                      gboolean             antialias,
                                                                      gfloat               threshold,
@@ -35,6 +35,9 @@
 
 #include "gimp.h"
 #include "gimp-memsize.h"
+#include "gimp-parallel.h"
+#include "gimpasync.h"
+#include "gimpcancelable.h"
 #include "gimpchunkiterator.h"
 #include "gimpimage.h"
 #include "gimpmarshal.h"
@@ -42,6 +45,7 @@
 #include "gimpprojectable.h"
 #include "gimpprojection.h"
 #include "gimptilehandlerprojectable.h"
+#include "gimpwaitable.h"
 
 #include "gimp-log.h"
 #include "gimp-priorities.h"
@@ -52,6 +56,15 @@
 #define GIMP_PROJECTION_UPDATE_CHUNK_HEIGHT 32
 
 
+/*  the state of the worker rendering the async chunk  */
+typedef enum
+{
+  ASYNC_STATE_PAUSED,   /* not started yet, or paused between rects */
+  ASYNC_STATE_RUNNING,
+  ASYNC_STATE_DONE
+} AsyncState;
+
+
 enum
 {
   UPDATE,
@@ -79,6 +92,9 @@ struct _GimpProjectionPrivate
   GimpChunkIterator         *iter;
   guint                      idle_id;
 
+  GimpAsync                 *async;
+  GArray                    *async_rects;
+
   gboolean                   invalidate_preview;
 };
 
@@ -87,6 +103,7 @@ struct _GimpProjectionPrivate
 
 static void   gimp_projection_pickable_iface_init (GimpPickableInterface  *iface);
 
+static void        gimp_projection_dispose               (GObject         *object);
 static void        gimp_projection_finalize              (GObject         *object);
 static void        gimp_projection_set_property          (GObject         *object,
                                                           guint            property_id,
@@ -141,6 +158,30 @@ static void        gimp_projection_chunk_render_stop     (GimpProjection  *proj,
                                                           gboolean         merge);
 static gboolean    gimp_projection_chunk_render_callback (GimpProjection  *proj);
 static gboolean    gimp_projection_chunk_render_iteration(GimpProjection  *proj);
+static void        gimp_projection_chunk_render_finished (GimpProjection  *proj);
+static gboolean    gimp_projection_chunk_render_can_async(void);
+static void        gimp_projection_chunk_render_async    (GimpProjection  *proj);
+static void        gimp_projection_chunk_render_async_func
+                                                         (GimpAsync       *async,
+                                                          GimpProjection  *proj);
+static gboolean    gimp_projection_chunk_render_async_next
+                                                         (GimpAsync       *async,
+                                                          GimpProjection  *proj,
+                                                          GeglRectangle   *rect);
+static void        gimp_projection_chunk_render_async_callback
+                                                         (GimpAsync       *async,
+                                                          GimpProjection  *proj);
+static gboolean    gimp_projection_chunk_render_pause    (GimpProjection  *proj);
+static void        gimp_projection_chunk_render_resume   (GimpProjection  *proj);
+static void        gimp_projection_chunk_render_wake     (void);
+static void        gimp_projection_chunk_render_wait     (GimpProjection  *proj);
+
+static gboolean    gimp_projection_sync_source_prepare   (GSource         *source,
+                                                          gint            *timeout);
+static gboolean    gimp_projection_sync_source_check     (GSource         *source);
+static gboolean    gimp_projection_sync_source_dispatch  (GSource         *source,
+                                                          GSourceFunc      callback,
+                                                          gpointer         user_data);
 static void        gimp_projection_paint_area            (GimpProjection  *proj,
                                                           gboolean         now,
                                                           gint             x,
@@ -177,6 +218,35 @@ G_DEFINE_TYPE_WITH_CODE (GimpProjection, gimp_projection, GIMP_TYPE_OBJECT,
 
 static guint projection_signals[LAST_SIGNAL] = { 0 };
 
+static gint            gimp_projection_no_async_render = -1;
+
+/*  the projection currently rendering a chunk on a worker thread.  only a
+ *  single chunk is rendered asynchronously at any time, since validating a
+ *  projection may modify the graph of the projectable (see
+ *  gimp_projectable_begin_render()), which may be shared with other
+ *  projections.
+ */
+static GimpProjection *gimp_projection_async_render   = NULL;
+static GSource        *gimp_projection_sync_source    = NULL;
+
+/*  the worker pauses between rects while the main thread dispatches other
+ *  sources, see the sync source below.  'suspended' is set while the
+ *  worker is paused and validation has been ended on the main thread.
+ */
+static GMutex          gimp_projection_async_mutex;
+static GCond           gimp_projection_async_cond;
+static AsyncState      gimp_projection_async_state     = ASYNC_STATE_DONE;
+static gboolean        gimp_projection_async_pause     = FALSE;
+static gboolean        gimp_projection_async_suspended = FALSE;
+
+static GSourceFuncs    gimp_projection_sync_source_funcs =
+{
+  gimp_projection_sync_source_prepare,
+  gimp_projection_sync_source_check,
+  gimp_projection_sync_source_dispatch,
+  NULL
+};
+
 
 static void
 gimp_projection_class_init (GimpProjectionClass *klass)
@@ -198,6 +268,7 @@ gimp_projection_class_init (GimpProjectionClass *klass)
                   G_TYPE_INT,
                   G_TYPE_INT);
 
+  object_class->dispose          = gimp_projection_dispose;
   object_class->finalize         = gimp_projection_finalize;
   object_class->set_property     = gimp_projection_set_property;
   object_class->get_property     = gimp_projection_get_property;
@@ -228,6 +299,16 @@ gimp_projection_pickable_iface_init (GimpPickableInterface *iface)
   iface->srgb_to_pixel         = gimp_projection_srgb_to_pixel;
 }
 
+static void
+gimp_projection_dispose (GObject *object)
+{
+  GimpProjection *proj = GIMP_PROJECTION (object);
+
+  gimp_projection_chunk_render_wait (proj);
+
+  G_OBJECT_CLASS (parent_class)->dispose (object);
+}
+
 static void
 gimp_projection_finalize (GObject *object)
 {
@@ -235,6 +316,8 @@ gimp_projection_finalize (GObject *object)
 
   gimp_projection_free_buffer (proj);
 
+  g_clear_pointer (&proj->priv->async_rects, g_array_unref);
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -363,6 +446,9 @@ gimp_projection_get_buffer (GimpPickable *pickable)
 {
   GimpProjection *proj = GIMP_PROJECTION (pickable);
 
+  /*  the buffer may not be accessed while a chunk is being validated  */
+  gimp_projection_chunk_render_wait (proj);
+
   if (! proj->priv->buffer)
     {
       gint width;
@@ -545,6 +631,8 @@ gimp_projection_finish_draw (GimpProjection *proj)
 {
   g_return_if_fail (GIMP_IS_PROJECTION (proj));
 
+  gimp_projection_chunk_render_wait (proj);
+
   if (proj->priv->iter)
     {
       gimp_chunk_iterator_set_priority_rect (proj->priv->iter, NULL);
@@ -644,6 +732,8 @@ gimp_projection_flush_whenever (GimpProjection *proj,
                                 gboolean        now,
                                 gboolean        direct)
 {
+  gimp_projection_chunk_render_wait (proj);
+
   if (proj->priv->update_region)
     {
       /* Make sure we have a buffer */
@@ -692,7 +782,10 @@ gimp_projection_flush_whenever (GimpProjection *proj,
 static void
 gimp_projection_update_priority_rect (GimpProjection *proj)
 {
-  if (proj->priv->iter)
+  /*  the iterator is owned by the worker thread while a chunk is being
+   *  rendered; the priority rect is applied once the chunk is done.
+   */
+  if (proj->priv->iter && ! proj->priv->async)
     {
       GeglRectangle rect;
       gint          off_x, off_y;
@@ -721,9 +814,13 @@ gimp_projection_update_priority_rect (GimpProjection *proj)
 static void
 gimp_projection_chunk_render_start (GimpProjection *proj)
 {
-  cairo_region_t *region             = proj->priv->update_region;
+  cairo_region_t *region;
   gboolean        invalidate_preview = FALSE;
 
+  gimp_projection_chunk_render_wait (proj);
+
+  region = proj->priv->update_region;
+
   if (proj->priv->iter)
     {
       region = gimp_chunk_iterator_stop (proj->priv->iter, FALSE);
@@ -749,7 +846,7 @@ gimp_projection_chunk_render_start (GimpProjection *proj)
 
       gimp_projection_update_priority_rect (proj);
 
-      if (! proj->priv->idle_id)
+      if (! proj->priv->idle_id && ! proj->priv->async)
         {
           proj->priv->idle_id = g_idle_add_full (
             GIMP_PRIORITY_PROJECTION_IDLE + proj->priv->priority,
@@ -784,6 +881,8 @@ static void
 gimp_projection_chunk_render_stop (GimpProjection *proj,
                                    gboolean        merge)
 {
+  gimp_projection_chunk_render_wait (proj);
+
   if (proj->priv->idle_id)
     {
       g_source_remove (proj->priv->idle_id);
@@ -821,7 +920,15 @@ gimp_projection_chunk_render_stop (GimpProjection *proj,
 static gboolean
 gimp_projection_chunk_render_callback (GimpProjection *proj)
 {
-  if (gimp_projection_chunk_render_iteration (proj))
+  if (gimp_projection_chunk_render_can_async ())
+    {
+      proj->priv->idle_id = 0;
+
+      gimp_projection_chunk_render_async (proj);
+
+      return G_SOURCE_REMOVE;
+    }
+  else if (gimp_projection_chunk_render_iteration (proj))
     {
       return G_SOURCE_CONTINUE;
     }
@@ -855,21 +962,356 @@ gimp_projection_chunk_render_iteration (GimpProjection *proj)
     }
   else
     {
-      proj->priv->iter = NULL;
+      gimp_projection_chunk_render_finished (proj);
+
+      /* FINISHED */
+      return FALSE;
+    }
+}
+
+static void
+gimp_projection_chunk_render_finished (GimpProjection *proj)
+{
+  proj->priv->iter = NULL;
+
+  if (proj->priv->invalidate_preview)
+    {
+      /* invalidate the preview here since it is constructed from
+       * the projection
+       */
+      proj->priv->invalidate_preview = FALSE;
+
+      gimp_projectable_invalidate_preview (proj->priv->projectable);
+    }
+}
+
+static gboolean
+gimp_projection_chunk_render_can_async (void)
+{
+  if (gimp_projection_no_async_render < 0)
+    {
+      gimp_projection_no_async_render =
+        (g_getenv ("GIMP_NO_ASYNC_PROJECTION") != NULL);
+    }
+
+  /*  only render asynchronously when called from the outermost main loop.
+   *  nested main loops are usually spun by code which is in the middle of
+   *  modifying the image, and which resumes without returning to the main
+   *  loop, so the sync source below can't protect it.
+   */
+  return ! gimp_projection_no_async_render && g_main_depth () == 1;
+}
+
+static void
+gimp_projection_chunk_render_async (GimpProjection *proj)
+{
+  GimpAsync *async;
+
+  if (gimp_projection_async_render)
+    gimp_projection_chunk_render_wait (gimp_projection_async_render);
+
+  if (! gimp_chunk_iterator_next (proj->priv->iter))
+    {
+      gimp_projection_chunk_render_finished (proj);
+
+      return;
+    }
+
+  if (! gimp_projection_sync_source)
+    {
+      gimp_projection_sync_source =
+        g_source_new (&gimp_projection_sync_source_funcs, sizeof (GSource));
+
+      g_source_set_priority (gimp_projection_sync_source,
+                             GIMP_PRIORITY_PROJECTION_SYNC);
+      g_source_set_name (gimp_projection_sync_source,
+                         "gimp-projection-sync");
+
+      g_source_attach (gimp_projection_sync_source, NULL);
+    }
+
+  if (! proj->priv->async_rects)
+    proj->priv->async_rects = g_array_new (FALSE, FALSE, sizeof (GeglRectangle));
+
+  /*  begin validation on the main thread, since it may modify the graph  */
+  gimp_tile_handler_validate_begin_validate (proj->priv->validate_handler);
+
+  gimp_projection_async_render = proj;
+
+  g_mutex_lock (&gimp_projection_async_mutex);
+
+  gimp_projection_async_state = ASYNC_STATE_PAUSED;
+  gimp_projection_async_pause = FALSE;
+
+  g_mutex_unlock (&gimp_projection_async_mutex);
+
+  async = gimp_parallel_run_async (
+    (GimpParallelRunAsyncFunc) gimp_projection_chunk_render_async_func,
+    proj);
+
+  proj->priv->async = async;
+
+  /*  may call the callback right away, if the async is already stopped.
+   *  the projection waits for the async before being disposed.
+   */
+  gimp_async_add_callback (
+    async,
+    (GimpAsyncCallback) gimp_projection_chunk_render_async_callback,
+    proj);
+}
+
+static void
+gimp_projection_chunk_render_async_func (GimpAsync      *async,
+                                         GimpProjection *proj)
+{
+  GeglRectangle rect;
+
+  /*  the chunk iterator, validate handler and buffer are left alone by the
+   *  main thread until the async is stopped, and pausing and cancellation
+   *  are checked between rects, so that the main thread never has to wait
+   *  for more than a single rect.
+   */
+  while (gimp_projection_chunk_render_async_next (async, proj, &rect))
+    {
+      gimp_tile_handler_validate_validate (proj->priv->validate_handler,
+                                           proj->priv->buffer,
+                                           &rect,
+                                           FALSE);
+
+      g_array_append_val (proj->priv->async_rects, rect);
+    }
+
+  g_mutex_lock (&gimp_projection_async_mutex);
+
+  gimp_projection_async_state = ASYNC_STATE_DONE;
+  g_cond_broadcast (&gimp_projection_async_cond);
+
+  g_mutex_unlock (&gimp_projection_async_mutex);
+
+  gimp_async_finish (async, NULL);
+}
+
+/*  called on the worker before each rect.  blocks while the main thread
+ *  has paused the worker, and returns FALSE when the chunk is done.
+ */
+static gboolean
+gimp_projection_chunk_render_async_next (GimpAsync      *async,
+                                         GimpProjection *proj,
+                                         GeglRectangle  *rect)
+{
+  g_mutex_lock (&gimp_projection_async_mutex);
+
+  if (gimp_projection_async_pause)
+    {
+      gimp_projection_async_state = ASYNC_STATE_PAUSED;
+      g_cond_broadcast (&gimp_projection_async_cond);
+
+      while (gimp_projection_async_pause && ! gimp_async_is_canceled (async))
+        g_cond_wait (&gimp_projection_async_cond,
+                     &gimp_projection_async_mutex);
+    }
+
+  gimp_projection_async_state = ASYNC_STATE_RUNNING;
+
+  g_mutex_unlock (&gimp_projection_async_mutex);
+
+  return ! gimp_async_is_canceled (async) &&
+         gimp_chunk_iterator_get_rect (proj->priv->iter, rect);
+}
+
+static void
+gimp_projection_chunk_render_async_callback (GimpAsync      *async,
+                                             GimpProjection *proj)
+{
+  GArray *rects = proj->priv->async_rects;
+  gint    off_x, off_y;
+  gint    width, height;
+  guint   i;
+
+  gimp_projection_async_render = NULL;
+  g_clear_object (&proj->priv->async);
 
-      if (proj->priv->invalidate_preview)
+  /*  validation was already ended when the worker was paused  */
+  if (gimp_projection_async_suspended)
+    gimp_projection_async_suspended = FALSE;
+  else
+    gimp_tile_handler_validate_end_validate (proj->priv->validate_handler);
+
+  gimp_projectable_get_offset (proj->priv->projectable, &off_x, &off_y);
+  gimp_projectable_get_size   (proj->priv->projectable, &width, &height);
+
+  /*  post the validated rects to the display  */
+  for (i = 0; i < rects->len; i++)
+    {
+      GeglRectangle rect = g_array_index (rects, GeglRectangle, i);
+
+      if (gegl_rectangle_intersect (&rect,
+                                    &rect,
+                                    GEGL_RECTANGLE (0, 0, width, height)))
         {
-          /* invalidate the preview here since it is constructed from
-           * the projection
+          /*  add the projectable's offsets because the list of update
+           *  areas is in tile-pyramid coordinates, but our external API
+           *  is always in terms of image coordinates.
            */
-          proj->priv->invalidate_preview = FALSE;
+          g_signal_emit (proj, projection_signals[UPDATE], 0,
+                         TRUE,
+                         rect.x + off_x,
+                         rect.y + off_y,
+                         rect.width,
+                         rect.height);
+        }
+    }
 
-          gimp_projectable_invalidate_preview (proj->priv->projectable);
+  g_array_set_size (rects, 0);
+
+  if (proj->priv->iter)
+    {
+      gimp_projection_update_priority_rect (proj);
+
+      if (! proj->priv->idle_id)
+        {
+          proj->priv->idle_id = g_idle_add_full (
+            GIMP_PRIORITY_PROJECTION_IDLE + proj->priv->priority,
+            (GSourceFunc) gimp_projection_chunk_render_callback,
+            proj, NULL);
         }
+    }
+}
 
-      /* FINISHED */
-      return FALSE;
+/*  pauses the worker between two rects, and ends validation, so that the
+ *  main thread may modify the image.  returns FALSE, without pausing, if
+ *  the worker is done with the chunk already.
+ */
+static gboolean
+gimp_projection_chunk_render_pause (GimpProjection *proj)
+{
+  AsyncState state;
+
+  g_mutex_lock (&gimp_projection_async_mutex);
+
+  gimp_projection_async_pause = TRUE;
+
+  while (gimp_projection_async_state == ASYNC_STATE_RUNNING)
+    g_cond_wait (&gimp_projection_async_cond, &gimp_projection_async_mutex);
+
+  state = gimp_projection_async_state;
+
+  g_mutex_unlock (&gimp_projection_async_mutex);
+
+  if (state == ASYNC_STATE_DONE)
+    return FALSE;
+
+  /*  set first, since ending validation may reconnect the graph, and
+   *  reenter gimp_projection_chunk_render_wait()
+   */
+  gimp_projection_async_suspended = TRUE;
+
+  gimp_tile_handler_validate_end_validate (proj->priv->validate_handler);
+
+  return TRUE;
+}
+
+static void
+gimp_projection_chunk_render_resume (GimpProjection *proj)
+{
+  /*  cleared first, so that gimp_projection_chunk_render_async_callback()
+   *  ends validation if beginning it reenters
+   *  gimp_projection_chunk_render_wait()
+   */
+  gimp_projection_async_suspended = FALSE;
+
+  gimp_tile_handler_validate_begin_validate (proj->priv->validate_handler);
+
+  gimp_projection_chunk_render_wake ();
+}
+
+static void
+gimp_projection_chunk_render_wake (void)
+{
+  g_mutex_lock (&gimp_projection_async_mutex);
+
+  gimp_projection_async_pause = FALSE;
+  g_cond_broadcast (&gimp_projection_async_cond);
+
+  g_mutex_unlock (&gimp_projection_async_mutex);
+}
+
+/*  waits for the in-flight chunk when its result is needed, canceling its
+ *  remaining rects
+ */
+static void
+gimp_projection_chunk_render_wait (GimpProjection *proj)
+{
+  if (proj->priv->async)
+    {
+      GimpAsync *async = g_object_ref (proj->priv->async);
+
+      gimp_cancelable_cancel (GIMP_CANCELABLE (async));
+
+      /*  a paused worker only notices the cancellation when woken  */
+      gimp_projection_chunk_render_wake ();
+
+      /*  runs gimp_projection_chunk_render_async_callback()  */
+      gimp_waitable_wait (GIMP_WAITABLE (async));
+
+      g_object_unref (async);
+    }
+}
+
+/*  the sync source makes sure that no other source is dispatched while a
+ *  chunk is being rendered on a worker thread:  rendering proceeds while
+ *  the main loop is idle.  when the main loop wakes up, check() pauses the
+ *  worker after its current rect, and ends validation, before any other
+ *  source is dispatched; prepare() resumes it before the main loop goes
+ *  back to sleep.  the chunk is neither canceled nor waited for, unless
+ *  its result is needed by one of the projection's entry points, which
+ *  call gimp_projection_chunk_render_wait().  only a chunk which is done
+ *  already is completed from dispatch().
+ */
+static gboolean
+gimp_projection_sync_source_prepare (GSource *source,
+                                     gint    *timeout)
+{
+  if (gimp_projection_async_render && gimp_projection_async_suspended)
+    gimp_projection_chunk_render_resume (gimp_projection_async_render);
+
+  *timeout = -1;
+
+  return FALSE;
+}
+
+static gboolean
+gimp_projection_sync_source_check (GSource *source)
+{
+  if (gimp_projection_async_render && ! gimp_projection_async_suspended)
+    {
+      /*  let the other sources be dispatched while the worker is paused,
+       *  or complete the chunk in dispatch() if it's done
+       */
+      return ! gimp_projection_chunk_render_pause (gimp_projection_async_render);
     }
+
+  return FALSE;
+}
+
+static gboolean
+gimp_projection_sync_source_dispatch (GSource     *source,
+                                      GSourceFunc  callback,
+                                      gpointer     user_data)
+{
+  if (gimp_projection_async_render)
+    {
+      GimpAsync *async = g_object_ref (gimp_projection_async_render->priv->async);
+
+      /*  the worker is done, this doesn't block.  runs
+       *  gimp_projection_chunk_render_async_callback()
+       */
+      gimp_waitable_wait (GIMP_WAITABLE (async));
+
+      g_object_unref (async);
+    }
+
+  return G_SOURCE_CONTINUE;
 }
 
 static void
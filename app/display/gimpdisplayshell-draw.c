@@ -47,6 +47,27 @@
 
 /* #define GIMP_DISPLAY_RENDER_ENABLE_SCALING 1 */
 
+/*  the scale divisor of the quick first pass over large areas  */
+#define GIMP_DISPLAY_RENDER_LOW_RES_FACTOR 4
+
+/*  the time, in microseconds, spent refining the cache per idle run  */
+#define GIMP_DISPLAY_RENDER_IDLE_TIME      (G_TIME_SPAN_MILLISECOND * 8)
+
+
+static void       gimp_display_shell_draw_image_chunks        (GimpDisplayShell *shell,
+                                                               cairo_t          *cr,
+                                                               gint              x,
+                                                               gint              y,
+                                                               gint              w,
+                                                               gint              h,
+                                                               gboolean          low_res);
+static void       gimp_display_shell_draw_image_to_cache      (GimpDisplayShell *shell,
+                                                               cairo_region_t   *region,
+                                                               gboolean          low_res);
+static gboolean   gimp_display_shell_draw_image_idle          (GimpDisplayShell *shell);
+static void       gimp_display_shell_draw_ensure_render_cache (GimpDisplayShell *shell);
+static gboolean   gimp_display_shell_draw_brick_wall          (void);
+
 
 /*  public functions  */
 
@@ -125,6 +146,109 @@ gimp_display_shell_draw_image (GimpDisplayShell *shell,
                                gint              y,
                                gint              w,
                                gint              h)
+{
+  cairo_rectangle_int_t  rect = { x, y, w, h };
+  cairo_region_t        *missing;
+
+  g_return_if_fail (GIMP_IS_DISPLAY_SHELL (shell));
+  g_return_if_fail (gimp_display_get_image (shell->display));
+  g_return_if_fail (cr != NULL);
+
+  gimp_display_shell_draw_ensure_render_cache (shell);
+
+  missing = cairo_region_create_rectangle (&rect);
+  cairo_region_subtract (missing, shell->render_cache_valid);
+
+  if (! cairo_region_is_empty (missing))
+    {
+      cairo_region_t        *image;
+      cairo_rectangle_int_t  extents;
+      gboolean               low_res;
+
+      /*  render areas which changed in the image, like the ones updated
+       *  while painting, right away, regardless of their size
+       */
+      image = cairo_region_copy (missing);
+      cairo_region_intersect (image, shell->render_cache_image);
+
+      if (! cairo_region_is_empty (image))
+        {
+          gimp_display_shell_draw_image_to_cache (shell, image, FALSE);
+
+          cairo_region_union (shell->render_cache_valid, image);
+          cairo_region_subtract (shell->render_cache_image, image);
+          cairo_region_subtract (missing, image);
+        }
+
+      cairo_region_destroy (image);
+
+      /*  the rest was scrolled or zoomed into view, or fully invalidated.
+       *  fill it at a lower resolution first if it is large, and refine
+       *  it in the background.
+       */
+      cairo_region_get_extents (missing, &extents);
+
+      low_res = ((gint64) extents.width * extents.height >
+                 (gint64) GIMP_DISPLAY_RENDER_BUF_WIDTH *
+                          GIMP_DISPLAY_RENDER_BUF_HEIGHT);
+
+      if (! cairo_region_is_empty (missing))
+        gimp_display_shell_draw_image_to_cache (shell, missing, low_res);
+
+      cairo_region_union (shell->render_cache_valid, missing);
+
+      if (low_res)
+        {
+          cairo_region_union (shell->render_cache_dirty, missing);
+
+          if (! shell->render_idle_id)
+            {
+              shell->render_idle_id =
+                g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
+                                 (GSourceFunc) gimp_display_shell_draw_image_idle,
+                                 shell, NULL);
+            }
+        }
+    }
+
+  cairo_region_destroy (missing);
+
+  cairo_save (cr);
+
+  cairo_rectangle (cr, x, y, w, h);
+  cairo_clip (cr);
+
+  cairo_set_source_surface (cr, shell->render_cache, 0.0, 0.0);
+  cairo_paint (cr);
+
+  cairo_restore (cr);
+
+  /* if the GIMP_BRICK_WALL environment variable is defined,
+   * show the low-resolution parts of the cache which are still to
+   * be refined
+   */
+  if (gimp_display_shell_draw_brick_wall ())
+    {
+      cairo_save (cr);
+      gdk_cairo_region (cr, shell->render_cache_dirty);
+      cairo_clip (cr);
+      cairo_set_source_rgba (cr, 1.0, 0.0, 0.0, 0.1);
+      cairo_paint (cr);
+      cairo_restore (cr);
+    }
+}
+
+
+/*  private functions  */
+
+static void
+gimp_display_shell_draw_image_chunks (GimpDisplayShell *shell,
+                                      cairo_t          *cr,
+                                      gint              x,
+                                      gint              y,
+                                      gint              w,
+                                      gint              h,
+                                      gboolean          low_res)
 {
   gdouble chunk_width;
   gdouble chunk_height;
@@ -133,10 +257,6 @@ gimp_display_shell_draw_image (GimpDisplayShell *shell,
   gint    n_cols;
   gint    r, c;
 
-  g_return_if_fail (GIMP_IS_DISPLAY_SHELL (shell));
-  g_return_if_fail (gimp_display_get_image (shell->display));
-  g_return_if_fail (cr != NULL);
-
   /*  display the image in RENDER_BUF_WIDTH x RENDER_BUF_HEIGHT
    *  maximally-sized image-space chunks.  adjust the screen-space
    *  chunk size as necessary, to accommodate for the display
@@ -166,6 +286,10 @@ gimp_display_shell_draw_image (GimpDisplayShell *shell,
   scale  = MIN (scale, GIMP_DISPLAY_RENDER_MAX_SCALE);
   scale *= MAX (shell->scale_x, shell->scale_y);
 
+  /*  a quick, blurry preview, which is refined later  */
+  if (low_res)
+    scale /= GIMP_DISPLAY_RENDER_LOW_RES_FACTOR;
+
   if (scale != shell->scale_x)
     chunk_width  = (chunk_width  - 1.0) * (shell->scale_x / scale);
   if (scale != shell->scale_y)
@@ -228,19 +352,156 @@ gimp_display_shell_draw_image (GimpDisplayShell *shell,
           /* if the GIMP_BRICK_WALL environment variable is defined,
            * show chunk bounds
            */
-          {
-            static gint brick_wall = -1;
-
-            if (brick_wall < 0)
-              brick_wall = (g_getenv ("GIMP_BRICK_WALL") != NULL);
-
-            if (brick_wall)
-              {
-                cairo_set_source_rgb (cr, 0.0, 0.0, 0.0);
-                cairo_rectangle (cr, x1, y1, x2 - x1, y2 - y1);
-                cairo_stroke (cr);
-              }
-          }
+          if (gimp_display_shell_draw_brick_wall ())
+            {
+              cairo_set_source_rgb (cr, 0.0, 0.0, 0.0);
+              cairo_rectangle (cr, x1, y1, x2 - x1, y2 - y1);
+              cairo_stroke (cr);
+            }
         }
     }
 }
+
+static void
+gimp_display_shell_draw_image_to_cache (GimpDisplayShell *shell,
+                                        cairo_region_t   *region,
+                                        gboolean          low_res)
+{
+  cairo_t *cr;
+  gint     image_width;
+  gint     image_height;
+  gint     n_rects;
+  gint     i;
+
+  gimp_display_shell_scale_get_image_size (shell, &image_width, &image_height);
+
+  cr = cairo_create (shell->render_cache);
+
+  n_rects = cairo_region_num_rectangles (region);
+
+  for (i = 0; i < n_rects; i++)
+    {
+      cairo_rectangle_int_t rect;
+
+      cairo_region_get_rectangle (region, i, &rect);
+
+      cairo_save (cr);
+
+      cairo_rectangle (cr, rect.x, rect.y, rect.width, rect.height);
+      cairo_clip (cr);
+
+      cairo_set_operator (cr, CAIRO_OPERATOR_CLEAR);
+      cairo_paint (cr);
+      cairo_set_operator (cr, CAIRO_OPERATOR_OVER);
+
+      /*  only render inside the image, like the canvas does  */
+      if (shell->rotate_transform)
+        cairo_transform (cr, shell->rotate_transform);
+
+      cairo_rectangle (cr,
+                       - shell->offset_x, - shell->offset_y,
+                       image_width, image_height);
+      cairo_identity_matrix (cr);
+      cairo_clip (cr);
+
+      gimp_display_shell_draw_image_chunks (shell, cr,
+                                            rect.x, rect.y,
+                                            rect.width, rect.height,
+                                            low_res);
+
+      cairo_restore (cr);
+    }
+
+  cairo_destroy (cr);
+
+  cairo_surface_flush (shell->render_cache);
+}
+
+static gboolean
+gimp_display_shell_draw_image_idle (GimpDisplayShell *shell)
+{
+  gint64 start = g_get_monotonic_time ();
+
+  if (! shell->display || ! gimp_display_get_image (shell->display))
+    {
+      shell->render_idle_id = 0;
+
+      return G_SOURCE_REMOVE;
+    }
+
+  /*  refine the low-resolution parts of the render cache, one chunk
+   *  at a time, until the time budget for this idle run is used up
+   */
+  while (shell->render_cache_dirty &&
+         ! cairo_region_is_empty (shell->render_cache_dirty))
+    {
+      cairo_rectangle_int_t  rect;
+      cairo_region_t        *chunk;
+
+      cairo_region_get_rectangle (shell->render_cache_dirty, 0, &rect);
+
+      rect.width  = MIN (rect.width,  GIMP_DISPLAY_RENDER_BUF_WIDTH);
+      rect.height = MIN (rect.height, GIMP_DISPLAY_RENDER_BUF_HEIGHT);
+
+      chunk = cairo_region_create_rectangle (&rect);
+
+      gimp_display_shell_draw_image_to_cache (shell, chunk, FALSE);
+
+      cairo_region_subtract (shell->render_cache_dirty, chunk);
+      cairo_region_destroy (chunk);
+
+      gtk_widget_queue_draw_area (shell->canvas,
+                                  rect.x, rect.y, rect.width, rect.height);
+
+      if (g_get_monotonic_time () - start >= GIMP_DISPLAY_RENDER_IDLE_TIME)
+        return G_SOURCE_CONTINUE;
+    }
+
+  shell->render_idle_id = 0;
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+gimp_display_shell_draw_ensure_render_cache (GimpDisplayShell *shell)
+{
+  GtkAllocation allocation;
+
+  gtk_widget_get_allocation (shell->canvas, &allocation);
+
+  allocation.width  = MAX (allocation.width,  1);
+  allocation.height = MAX (allocation.height, 1);
+
+  if (shell->render_cache &&
+      cairo_image_surface_get_width  (shell->render_cache) == allocation.width &&
+      cairo_image_surface_get_height (shell->render_cache) == allocation.height)
+    {
+      return;
+    }
+
+  g_clear_pointer (&shell->render_cache, cairo_surface_destroy);
+
+  shell->render_cache = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+                                                    allocation.width,
+                                                    allocation.height);
+
+  if (! shell->render_cache_valid)
+    {
+      shell->render_cache_valid = cairo_region_create ();
+      shell->render_cache_dirty = cairo_region_create ();
+      shell->render_cache_image = cairo_region_create ();
+    }
+
+  gimp_display_shell_render_invalidate_full (shell);
+}
+
+static gboolean
+gimp_display_shell_draw_brick_wall (void)
+{
+  static gint brick_wall = -1;
+
+  if (brick_wall < 0)
+    brick_wall = (g_getenv ("GIMP_BRICK_WALL") != NULL);
+
+  return brick_wall;
+}
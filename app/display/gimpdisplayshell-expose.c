@@ -24,6 +24,7 @@
 
 #include "gimpdisplayshell.h"
 #include "gimpdisplayshell-expose.h"
+#include "gimpdisplayshell-render.h"
 
 
 void
@@ -72,5 +73,7 @@ gimp_display_shell_expose_full (GimpDisplayShell *shell)
 {
   g_return_if_fail (GIMP_IS_DISPLAY_SHELL (shell));
 
+  gimp_display_shell_render_invalidate_full (shell);
+
   gtk_widget_queue_draw (shell->canvas);
 }
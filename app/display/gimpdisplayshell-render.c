@@ -342,3 +342,125 @@ gimp_display_shell_render (GimpDisplayShell *shell,
                           y - mask_src_y);
     }
 }
+
+void
+gimp_display_shell_render_invalidate_full (GimpDisplayShell *shell)
+{
+  g_return_if_fail (GIMP_IS_DISPLAY_SHELL (shell));
+
+  if (shell->render_cache_valid)
+    {
+      cairo_region_destroy (shell->render_cache_valid);
+      cairo_region_destroy (shell->render_cache_dirty);
+      cairo_region_destroy (shell->render_cache_image);
+
+      shell->render_cache_valid = cairo_region_create ();
+      shell->render_cache_dirty = cairo_region_create ();
+      shell->render_cache_image = cairo_region_create ();
+    }
+}
+
+void
+gimp_display_shell_render_invalidate_area (GimpDisplayShell *shell,
+                                           gint              x,
+                                           gint              y,
+                                           gint              width,
+                                           gint              height)
+{
+  cairo_rectangle_int_t rect = { x, y, width, height };
+
+  g_return_if_fail (GIMP_IS_DISPLAY_SHELL (shell));
+
+  if (shell->render_cache_valid)
+    {
+      cairo_region_subtract_rectangle (shell->render_cache_valid, &rect);
+      cairo_region_subtract_rectangle (shell->render_cache_dirty, &rect);
+
+      /*  remember that the area changed in the image, as opposed to
+       *  having been scrolled or zoomed into view
+       */
+      if (shell->render_cache)
+        {
+          cairo_rectangle_int_t bounds;
+
+          bounds.x      = 0;
+          bounds.y      = 0;
+          bounds.width  = cairo_image_surface_get_width  (shell->render_cache);
+          bounds.height = cairo_image_surface_get_height (shell->render_cache);
+
+          if (gdk_rectangle_intersect (&rect, &bounds, &rect))
+            cairo_region_union_rectangle (shell->render_cache_image, &rect);
+        }
+    }
+}
+
+void
+gimp_display_shell_render_scroll (GimpDisplayShell *shell,
+                                  gint              x_offset,
+                                  gint              y_offset)
+{
+  cairo_surface_t       *surface;
+  cairo_t               *cr;
+  cairo_rectangle_int_t  bounds;
+
+  g_return_if_fail (GIMP_IS_DISPLAY_SHELL (shell));
+
+  if (! shell->render_cache)
+    return;
+
+  bounds.x      = 0;
+  bounds.y      = 0;
+  bounds.width  = cairo_image_surface_get_width  (shell->render_cache);
+  bounds.height = cairo_image_surface_get_height (shell->render_cache);
+
+  if (ABS (x_offset) >= bounds.width ||
+      ABS (y_offset) >= bounds.height)
+    {
+      gimp_display_shell_render_invalidate_full (shell);
+
+      return;
+    }
+
+  /*  move the still-valid part of the cache along with the canvas, so
+   *  that only the newly exposed strips need to be rendered
+   */
+  surface = cairo_surface_create_similar_image (shell->render_cache,
+                                                CAIRO_FORMAT_ARGB32,
+                                                bounds.width,
+                                                bounds.height);
+
+  cr = cairo_create (surface);
+  cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+  cairo_set_source_surface (cr, shell->render_cache, -x_offset, -y_offset);
+  cairo_paint (cr);
+  cairo_destroy (cr);
+
+  cairo_surface_destroy (shell->render_cache);
+  shell->render_cache = surface;
+
+  cairo_region_translate (shell->render_cache_valid, -x_offset, -y_offset);
+  cairo_region_intersect_rectangle (shell->render_cache_valid, &bounds);
+
+  cairo_region_translate (shell->render_cache_dirty, -x_offset, -y_offset);
+  cairo_region_intersect_rectangle (shell->render_cache_dirty, &bounds);
+
+  cairo_region_translate (shell->render_cache_image, -x_offset, -y_offset);
+  cairo_region_intersect_rectangle (shell->render_cache_image, &bounds);
+}
+
+void
+gimp_display_shell_render_cache_free (GimpDisplayShell *shell)
+{
+  g_return_if_fail (GIMP_IS_DISPLAY_SHELL (shell));
+
+  if (shell->render_idle_id)
+    {
+      g_source_remove (shell->render_idle_id);
+      shell->render_idle_id = 0;
+    }
+
+  g_clear_pointer (&shell->render_cache,       cairo_surface_destroy);
+  g_clear_pointer (&shell->render_cache_valid, cairo_region_destroy);
+  g_clear_pointer (&shell->render_cache_dirty, cairo_region_destroy);
+  g_clear_pointer (&shell->render_cache_image, cairo_region_destroy);
+}
@@ -69,7 +69,7 @@ static void      selection_undraw         (Selection          *selection);
 
 static void      selection_render_mask    (Selection          *selection);
 
-static void      selection_zoom_segs      (Selection          *selection,
+static gint      selection_zoom_segs      (Selection          *selection,
                                            const GimpBoundSeg *src_segs,
                                            GimpSegment        *dest_segs,
                                            gint                n_segs);
@@ -306,29 +306,67 @@ selection_render_mask (Selection *selection)
   cairo_surface_destroy (surface);
 }
 
-static void
+static gint
 selection_zoom_segs (Selection          *selection,
                      const GimpBoundSeg *src_segs,
                      GimpSegment        *dest_segs,
                      gint                n_segs)
 {
-  const gint xclamp = selection->shell->disp_width + 1;
-  const gint yclamp = selection->shell->disp_height + 1;
-  gint       i;
-
-  gimp_display_shell_zoom_segments (selection->shell,
+  GimpDisplayShell *shell  = selection->shell;
+  const gint        xclamp = shell->disp_width + 1;
+  const gint        yclamp = shell->disp_height + 1;
+  gdouble           x1, y1;
+  gdouble           x2, y2;
+  gint              n_dest = 0;
+  gint              i;
+
+  gimp_display_shell_zoom_segments (shell,
                                     src_segs, dest_segs, n_segs,
                                     0.0, 0.0);
 
+  /*  the visible part of the canvas in unrotated display coordinates,
+   *  with a small margin for the line caps and the one pixel offset
+   *  of closing segments below
+   */
+  if (shell->rotate_transform)
+    {
+      gimp_display_shell_unrotate_bounds (shell,
+                                          0.0, 0.0,
+                                          shell->disp_width,
+                                          shell->disp_height,
+                                          &x1, &y1, &x2, &y2);
+    }
+  else
+    {
+      x1 = 0.0;
+      y1 = 0.0;
+      x2 = shell->disp_width;
+      y2 = shell->disp_height;
+    }
+
+  x1 -= 2.0;
+  y1 -= 2.0;
+  x2 += 2.0;
+  y2 += 2.0;
+
   for (i = 0; i < n_segs; i++)
     {
-      if (! selection->shell->rotate_transform)
+      GimpSegment seg = dest_segs[i];
+
+      /*  Cull segments which are completely outside the viewport, so
+       *  they never make it into the canvas path
+       */
+      if (MAX (seg.x1, seg.x2) < x1 || MIN (seg.x1, seg.x2) > x2 ||
+          MAX (seg.y1, seg.y2) < y1 || MIN (seg.y1, seg.y2) > y2)
+        continue;
+
+      if (! shell->rotate_transform)
         {
-          dest_segs[i].x1 = CLAMP (dest_segs[i].x1, -1, xclamp);
-          dest_segs[i].y1 = CLAMP (dest_segs[i].y1, -1, yclamp);
+          seg.x1 = CLAMP (seg.x1, -1, xclamp);
+          seg.y1 = CLAMP (seg.y1, -1, yclamp);
 
-          dest_segs[i].x2 = CLAMP (dest_segs[i].x2, -1, xclamp);
-          dest_segs[i].y2 = CLAMP (dest_segs[i].y2, -1, yclamp);
+          seg.x2 = CLAMP (seg.x2, -1, xclamp);
+          seg.y2 = CLAMP (seg.y2, -1, yclamp);
         }
 
       /*  If this segment is a closing segment && the segments lie inside
@@ -339,18 +377,22 @@ selection_zoom_segs (Selection          *selection,
       if (! src_segs[i].open)
         {
           /*  If it is vertical  */
-          if (dest_segs[i].x1 == dest_segs[i].x2)
+          if (seg.x1 == seg.x2)
             {
-              dest_segs[i].x1 -= 1;
-              dest_segs[i].x2 -= 1;
+              seg.x1 -= 1;
+              seg.x2 -= 1;
             }
           else
             {
-              dest_segs[i].y1 -= 1;
-              dest_segs[i].y2 -= 1;
+              seg.y1 -= 1;
+              seg.y2 -= 1;
             }
         }
+
+      dest_segs[n_dest++] = seg;
     }
+
+  return n_dest;
 }
 
 static void
@@ -371,26 +413,32 @@ selection_generate_segs (Selection *selection)
   if (selection->n_segs_in)
     {
       selection->segs_in = g_new (GimpSegment, selection->n_segs_in);
-      selection_zoom_segs (selection, segs_in,
-                           selection->segs_in, selection->n_segs_in);
+      selection->n_segs_in = selection_zoom_segs (selection, segs_in,
+                                                  selection->segs_in,
+                                                  selection->n_segs_in);
+    }
 
+  if (selection->n_segs_in)
+    {
       selection_render_mask (selection);
     }
   else
     {
-      selection->segs_in = NULL;
+      g_clear_pointer (&selection->segs_in, g_free);
     }
 
   /*  Possible secondary boundary representation  */
   if (selection->n_segs_out)
     {
       selection->segs_out = g_new (GimpSegment, selection->n_segs_out);
-      selection_zoom_segs (selection, segs_out,
-                           selection->segs_out, selection->n_segs_out);
+      selection->n_segs_out = selection_zoom_segs (selection, segs_out,
+                                                   selection->segs_out,
+                                                   selection->n_segs_out);
     }
-  else
+
+  if (! selection->n_segs_out)
     {
-      selection->segs_out = NULL;
+      g_clear_pointer (&selection->segs_out, g_free);
     }
 }
 
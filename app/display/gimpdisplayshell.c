@@ -826,6 +826,8 @@ gimp_display_shell_dispose (GObject *object)
   g_clear_pointer (&shell->mask_surface, cairo_surface_destroy);
   g_clear_pointer (&shell->checkerboard, cairo_pattern_destroy);
 
+  gimp_display_shell_render_cache_free (shell);
+
   gimp_display_shell_profile_finalize (shell);
 
   g_clear_object (&shell->filter_buffer);
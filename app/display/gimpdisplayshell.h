@@ -170,6 +170,12 @@ struct _GimpDisplayShell
   cairo_surface_t   *mask_surface;     /*  buffer for rendering the mask      */
   cairo_pattern_t   *checkerboard;     /*  checkerboard pattern               */
 
+  cairo_surface_t   *render_cache;       /*  rendered image, in screen space  */
+  cairo_region_t    *render_cache_valid; /*  valid areas of render_cache      */
+  cairo_region_t    *render_cache_dirty; /*  low-resolution areas to refine   */
+  cairo_region_t    *render_cache_image; /*  areas invalidated by the image   */
+  guint              render_idle_id;
+
   gint               paused_count;
 
   GimpTreeHandler   *vectors_freeze_handler;
@@ -19,6 +19,11 @@
 #define __GIMP_PRIORITIES_H__
 
 
+/*  above everything else, so that no other source is dispatched while
+ *  the projection is rendering on a worker thread
+ */
+#define GIMP_PRIORITY_PROJECTION_SYNC (G_PRIORITY_HIGH - 100)
+
 /* #define G_PRIORITY_HIGH -100 */
 
 /* #define G_PRIORITY_DEFAULT 0 */
@@ -24,6 +24,8 @@
 #include <glib-object.h>
 #include <gegl.h>
 
+#include "libgimpbase/gimpbase.h"
+
 #include "../operations-types.h"
 
 #include "gegl/gimp-babl.h"
@@ -1103,6 +1105,64 @@ static const GimpLayerMode layer_mode_groups[][2] =
   }
 };
 
+#if COMPILE_AVX2_INTRINISICS
+static const struct
+{
+  GimpLayerModeBlendFunc generic;
+  GimpLayerModeBlendFunc avx2;
+} layer_mode_blend_functions_avx2[] =
+{
+  { gimp_operation_layer_mode_blend_addition,
+    gimp_operation_layer_mode_blend_addition_avx2      },
+  { gimp_operation_layer_mode_blend_burn,
+    gimp_operation_layer_mode_blend_burn_avx2          },
+  { gimp_operation_layer_mode_blend_darken_only,
+    gimp_operation_layer_mode_blend_darken_only_avx2   },
+  { gimp_operation_layer_mode_blend_difference,
+    gimp_operation_layer_mode_blend_difference_avx2    },
+  { gimp_operation_layer_mode_blend_divide,
+    gimp_operation_layer_mode_blend_divide_avx2        },
+  { gimp_operation_layer_mode_blend_dodge,
+    gimp_operation_layer_mode_blend_dodge_avx2         },
+  { gimp_operation_layer_mode_blend_exclusion,
+    gimp_operation_layer_mode_blend_exclusion_avx2     },
+  { gimp_operation_layer_mode_blend_grain_extract,
+    gimp_operation_layer_mode_blend_grain_extract_avx2 },
+  { gimp_operation_layer_mode_blend_grain_merge,
+    gimp_operation_layer_mode_blend_grain_merge_avx2   },
+  { gimp_operation_layer_mode_blend_hard_mix,
+    gimp_operation_layer_mode_blend_hard_mix_avx2      },
+  { gimp_operation_layer_mode_blend_hardlight,
+    gimp_operation_layer_mode_blend_hardlight_avx2     },
+  { gimp_operation_layer_mode_blend_lighten_only,
+    gimp_operation_layer_mode_blend_lighten_only_avx2  },
+  { gimp_operation_layer_mode_blend_linear_burn,
+    gimp_operation_layer_mode_blend_linear_burn_avx2   },
+  { gimp_operation_layer_mode_blend_linear_light,
+    gimp_operation_layer_mode_blend_linear_light_avx2  },
+  { gimp_operation_layer_mode_blend_multiply,
+    gimp_operation_layer_mode_blend_multiply_avx2      },
+  { gimp_operation_layer_mode_blend_overlay,
+    gimp_operation_layer_mode_blend_overlay_avx2       },
+  { gimp_operation_layer_mode_blend_pin_light,
+    gimp_operation_layer_mode_blend_pin_light_avx2     },
+  { gimp_operation_layer_mode_blend_screen,
+    gimp_operation_layer_mode_blend_screen_avx2        },
+  { gimp_operation_layer_mode_blend_softlight,
+    gimp_operation_layer_mode_blend_softlight_avx2     },
+  { gimp_operation_layer_mode_blend_subtract,
+    gimp_operation_layer_mode_blend_subtract_avx2      },
+  { gimp_operation_layer_mode_blend_vivid_light,
+    gimp_operation_layer_mode_blend_vivid_light_avx2   }
+};
+#endif /* COMPILE_AVX2_INTRINISICS */
+
+/*  the blend function actually used for each mode, which may be a
+ *  vectorized variant of the one in layer_mode_infos.  filled in by
+ *  gimp_layer_modes_init().
+ */
+static GimpLayerModeBlendFunc layer_mode_blend_functions[G_N_ELEMENTS (layer_mode_infos)];
+
 
 /*  public functions  */
 
@@ -1111,9 +1171,38 @@ gimp_layer_modes_init (void)
 {
   gint i;
 
+#if COMPILE_AVX2_INTRINISICS
+  const GimpCpuAccelFlags avx2_fma = GIMP_CPU_ACCEL_X86_AVX2 |
+                                     GIMP_CPU_ACCEL_X86_FMA;
+  gboolean                use_avx2;
+
+  use_avx2 = (gimp_cpu_accel_get_support () & avx2_fma) == avx2_fma;
+#endif
+
   for (i = 0; i < G_N_ELEMENTS (layer_mode_infos); i++)
     {
       gimp_assert ((GimpLayerMode) i == layer_mode_infos[i].layer_mode);
+
+      layer_mode_blend_functions[i] = layer_mode_infos[i].blend_function;
+
+#if COMPILE_AVX2_INTRINISICS
+      if (use_avx2)
+        {
+          gint j;
+
+          for (j = 0; j < G_N_ELEMENTS (layer_mode_blend_functions_avx2); j++)
+            {
+              if (layer_mode_blend_functions[i] ==
+                  layer_mode_blend_functions_avx2[j].generic)
+                {
+                  layer_mode_blend_functions[i] =
+                    layer_mode_blend_functions_avx2[j].avx2;
+
+                  break;
+                }
+            }
+        }
+#endif
     }
 }
 
@@ -1296,6 +1385,12 @@ gimp_layer_mode_get_blend_function (GimpLayerMode mode)
   if (! info)
     return NULL;
 
+  /* fall back to the generic function if gimp_layer_modes_init() was not
+   * called yet
+   */
+  if (layer_mode_blend_functions[info->layer_mode])
+    return layer_mode_blend_functions[info->layer_mode];
+
   return info->blend_function;
 }
 
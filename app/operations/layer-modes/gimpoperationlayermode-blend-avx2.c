@@ -0,0 +1,347 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimpoperationlayermode-blend-avx2.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <gegl-plugin.h>
+#include <cairo.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#include "../operations-types.h"
+
+#include "gimpoperationlayermode-blend.h"
+
+
+#if COMPILE_AVX2_INTRINISICS
+
+/* AVX2 and FMA */
+#include <immintrin.h>
+
+
+#define EPSILON      1e-6f
+
+#define SAFE_DIV_MIN EPSILON
+#define SAFE_DIV_MAX (1.0f / SAFE_DIV_MIN)
+
+#define ALPHA_BLEND_MASK 0x88
+
+
+/*  each 256-bit vector holds two RGBA samples.  the scalar functions only
+ *  compute comp[RED..BLUE] when both in[ALPHA] and layer[ALPHA] are nonzero,
+ *  and leave it unconstrained otherwise, so the kernels below compute the
+ *  color lanes unconditionally, and the alpha lanes are then taken from
+ *  layer.  an odd trailing sample is handed to the scalar function.
+ */
+
+#define DEFINE_BLEND_FUNCTION(name)                                           \
+void                                                                          \
+gimp_operation_layer_mode_blend_##name##_avx2 (GeglOperation *operation,      \
+                                               const gfloat  *in,             \
+                                               const gfloat  *layer,          \
+                                               gfloat        *comp,           \
+                                               gint           samples)        \
+{                                                                             \
+  for (; samples >= 2; samples -= 2)                                          \
+    {                                                                         \
+      __m256 v_in    = _mm256_loadu_ps (in);                                  \
+      __m256 v_layer = _mm256_loadu_ps (layer);                               \
+      __m256 v_comp  = blend_##name (v_in, v_layer);                          \
+                                                                              \
+      _mm256_storeu_ps (comp, _mm256_blend_ps (v_comp, v_layer,               \
+                                               ALPHA_BLEND_MASK));            \
+                                                                              \
+      comp  += 8;                                                             \
+      layer += 8;                                                             \
+      in    += 8;                                                             \
+    }                                                                         \
+                                                                              \
+  if (samples)                                                                \
+    {                                                                         \
+      gimp_operation_layer_mode_blend_##name (operation, in, layer, comp,     \
+                                              samples);                       \
+    }                                                                         \
+}
+
+
+/*  private functions  */
+
+
+static inline __m256
+v_set1 (gfloat value)
+{
+  return _mm256_set1_ps (value);
+}
+
+/* returns a / b, clamped to [-SAFE_DIV_MAX, SAFE_DIV_MAX].
+ * if -SAFE_DIV_MIN <= a <= SAFE_DIV_MIN, returns 0.
+ */
+static inline __m256
+safe_div (__m256 a,
+          __m256 b)
+{
+  __m256 abs_a  = _mm256_andnot_ps (v_set1 (-0.0f), a);
+  __m256 result = _mm256_div_ps (a, b);
+
+  result = _mm256_min_ps (_mm256_max_ps (result, v_set1 (-SAFE_DIV_MAX)),
+                          v_set1 (SAFE_DIV_MAX));
+
+  return _mm256_and_ps (result,
+                        _mm256_cmp_ps (abs_a, v_set1 (SAFE_DIV_MIN),
+                                       _CMP_GT_OQ));
+}
+
+static inline __m256
+blend_addition (__m256 in,
+                __m256 layer)
+{
+  return _mm256_add_ps (in, layer);
+}
+
+static inline __m256
+blend_burn (__m256 in,
+            __m256 layer)
+{
+  return _mm256_sub_ps (v_set1 (1.0f),
+                        safe_div (_mm256_sub_ps (v_set1 (1.0f), in), layer));
+}
+
+static inline __m256
+blend_darken_only (__m256 in,
+                   __m256 layer)
+{
+  return _mm256_min_ps (in, layer);
+}
+
+static inline __m256
+blend_difference (__m256 in,
+                  __m256 layer)
+{
+  return _mm256_andnot_ps (v_set1 (-0.0f), _mm256_sub_ps (in, layer));
+}
+
+static inline __m256
+blend_divide (__m256 in,
+              __m256 layer)
+{
+  return safe_div (in, layer);
+}
+
+static inline __m256
+blend_dodge (__m256 in,
+             __m256 layer)
+{
+  return safe_div (in, _mm256_sub_ps (v_set1 (1.0f), layer));
+}
+
+static inline __m256
+blend_exclusion (__m256 in,
+                 __m256 layer)
+{
+  /* 0.5 - 2 * (in - 0.5) * (layer - 0.5) */
+  return _mm256_fnmadd_ps (_mm256_mul_ps (v_set1 (2.0f),
+                                          _mm256_sub_ps (in, v_set1 (0.5f))),
+                           _mm256_sub_ps (layer, v_set1 (0.5f)),
+                           v_set1 (0.5f));
+}
+
+static inline __m256
+blend_grain_extract (__m256 in,
+                     __m256 layer)
+{
+  return _mm256_add_ps (_mm256_sub_ps (in, layer), v_set1 (0.5f));
+}
+
+static inline __m256
+blend_grain_merge (__m256 in,
+                   __m256 layer)
+{
+  return _mm256_sub_ps (_mm256_add_ps (in, layer), v_set1 (0.5f));
+}
+
+static inline __m256
+blend_hard_mix (__m256 in,
+                __m256 layer)
+{
+  return _mm256_and_ps (v_set1 (1.0f),
+                        _mm256_cmp_ps (_mm256_add_ps (in, layer),
+                                       v_set1 (1.0f), _CMP_NLT_UQ));
+}
+
+static inline __m256
+blend_hardlight (__m256 in,
+                 __m256 layer)
+{
+  __m256 high;
+  __m256 low;
+
+  /* MIN (1 - (1 - in) * (1 - (layer - 0.5) * 2), 1) */
+  high = _mm256_mul_ps (_mm256_sub_ps (v_set1 (1.0f), in),
+                        _mm256_fnmadd_ps (_mm256_sub_ps (layer, v_set1 (0.5f)),
+                                          v_set1 (2.0f), v_set1 (1.0f)));
+  high = _mm256_min_ps (_mm256_sub_ps (v_set1 (1.0f), high), v_set1 (1.0f));
+
+  /* MIN (in * (layer * 2), 1) */
+  low  = _mm256_mul_ps (in, _mm256_mul_ps (layer, v_set1 (2.0f)));
+  low  = _mm256_min_ps (low, v_set1 (1.0f));
+
+  return _mm256_blendv_ps (low, high,
+                           _mm256_cmp_ps (layer, v_set1 (0.5f), _CMP_GT_OQ));
+}
+
+static inline __m256
+blend_lighten_only (__m256 in,
+                    __m256 layer)
+{
+  return _mm256_max_ps (in, layer);
+}
+
+static inline __m256
+blend_linear_burn (__m256 in,
+                   __m256 layer)
+{
+  return _mm256_sub_ps (_mm256_add_ps (in, layer), v_set1 (1.0f));
+}
+
+static inline __m256
+blend_linear_light (__m256 in,
+                    __m256 layer)
+{
+  __m256 low  = _mm256_sub_ps (_mm256_fmadd_ps (v_set1 (2.0f), layer, in),
+                               v_set1 (1.0f));
+  __m256 high = _mm256_fmadd_ps (v_set1 (2.0f),
+                                 _mm256_sub_ps (layer, v_set1 (0.5f)), in);
+
+  return _mm256_blendv_ps (high, low,
+                           _mm256_cmp_ps (layer, v_set1 (0.5f), _CMP_LE_OQ));
+}
+
+static inline __m256
+blend_multiply (__m256 in,
+                __m256 layer)
+{
+  return _mm256_mul_ps (in, layer);
+}
+
+static inline __m256
+blend_overlay (__m256 in,
+               __m256 layer)
+{
+  __m256 low  = _mm256_mul_ps (_mm256_mul_ps (v_set1 (2.0f), in), layer);
+  __m256 high = _mm256_fnmadd_ps (_mm256_mul_ps (v_set1 (2.0f),
+                                                 _mm256_sub_ps (v_set1 (1.0f),
+                                                                layer)),
+                                  _mm256_sub_ps (v_set1 (1.0f), in),
+                                  v_set1 (1.0f));
+
+  return _mm256_blendv_ps (high, low,
+                           _mm256_cmp_ps (in, v_set1 (0.5f), _CMP_LT_OQ));
+}
+
+static inline __m256
+blend_pin_light (__m256 in,
+                 __m256 layer)
+{
+  __m256 high = _mm256_max_ps (in,
+                               _mm256_mul_ps (v_set1 (2.0f),
+                                              _mm256_sub_ps (layer,
+                                                             v_set1 (0.5f))));
+  __m256 low  = _mm256_min_ps (in, _mm256_mul_ps (v_set1 (2.0f), layer));
+
+  return _mm256_blendv_ps (low, high,
+                           _mm256_cmp_ps (layer, v_set1 (0.5f), _CMP_GT_OQ));
+}
+
+static inline __m256
+blend_screen (__m256 in,
+              __m256 layer)
+{
+  return _mm256_fnmadd_ps (_mm256_sub_ps (v_set1 (1.0f), in),
+                           _mm256_sub_ps (v_set1 (1.0f), layer),
+                           v_set1 (1.0f));
+}
+
+static inline __m256
+blend_softlight (__m256 in,
+                 __m256 layer)
+{
+  __m256 multiply = _mm256_mul_ps (in, layer);
+  __m256 screen   = blend_screen (in, layer);
+
+  /* (1 - in) * multiply + in * screen */
+  return _mm256_fmadd_ps (_mm256_sub_ps (v_set1 (1.0f), in), multiply,
+                          _mm256_mul_ps (in, screen));
+}
+
+static inline __m256
+blend_subtract (__m256 in,
+                __m256 layer)
+{
+  return _mm256_sub_ps (in, layer);
+}
+
+static inline __m256
+blend_vivid_light (__m256 in,
+                   __m256 layer)
+{
+  __m256 low;
+  __m256 high;
+
+  /* MAX (1 - safe_div (1 - in, 2 * layer), 0) */
+  low  = safe_div (_mm256_sub_ps (v_set1 (1.0f), in),
+                   _mm256_mul_ps (v_set1 (2.0f), layer));
+  low  = _mm256_max_ps (_mm256_sub_ps (v_set1 (1.0f), low),
+                        _mm256_setzero_ps ());
+
+  /* MIN (safe_div (in, 2 * (1 - layer)), 1) */
+  high = safe_div (in,
+                   _mm256_mul_ps (v_set1 (2.0f),
+                                  _mm256_sub_ps (v_set1 (1.0f), layer)));
+  high = _mm256_min_ps (high, v_set1 (1.0f));
+
+  return _mm256_blendv_ps (high, low,
+                           _mm256_cmp_ps (layer, v_set1 (0.5f), _CMP_LE_OQ));
+}
+
+
+/*  public functions  */
+
+
+DEFINE_BLEND_FUNCTION (addition)
+DEFINE_BLEND_FUNCTION (burn)
+DEFINE_BLEND_FUNCTION (darken_only)
+DEFINE_BLEND_FUNCTION (difference)
+DEFINE_BLEND_FUNCTION (divide)
+DEFINE_BLEND_FUNCTION (dodge)
+DEFINE_BLEND_FUNCTION (exclusion)
+DEFINE_BLEND_FUNCTION (grain_extract)
+DEFINE_BLEND_FUNCTION (grain_merge)
+DEFINE_BLEND_FUNCTION (hard_mix)
+DEFINE_BLEND_FUNCTION (hardlight)
+DEFINE_BLEND_FUNCTION (lighten_only)
+DEFINE_BLEND_FUNCTION (linear_burn)
+DEFINE_BLEND_FUNCTION (linear_light)
+DEFINE_BLEND_FUNCTION (multiply)
+DEFINE_BLEND_FUNCTION (overlay)
+DEFINE_BLEND_FUNCTION (pin_light)
+DEFINE_BLEND_FUNCTION (screen)
+DEFINE_BLEND_FUNCTION (softlight)
+DEFINE_BLEND_FUNCTION (subtract)
+DEFINE_BLEND_FUNCTION (vivid_light)
+
+#endif /* COMPILE_AVX2_INTRINISICS */
@@ -197,4 +197,117 @@ void gimp_operation_layer_mode_blend_color_erase       (GeglOperation *operation
                                                         gint           samples);
 
 
+#if COMPILE_AVX2_INTRINISICS
+
+/*  AVX2 variants of the per-channel blend functions  */
+
+void gimp_operation_layer_mode_blend_addition_avx2    (GeglOperation *operation,
+                                                       const gfloat  *in,
+                                                       const gfloat  *layer,
+                                                       gfloat        *comp,
+                                                       gint           samples);
+void gimp_operation_layer_mode_blend_burn_avx2        (GeglOperation *operation,
+                                                       const gfloat  *in,
+                                                       const gfloat  *layer,
+                                                       gfloat        *comp,
+                                                       gint           samples);
+void gimp_operation_layer_mode_blend_darken_only_avx2 (GeglOperation *operation,
+                                                       const gfloat  *in,
+                                                       const gfloat  *layer,
+                                                       gfloat        *comp,
+                                                       gint           samples);
+void gimp_operation_layer_mode_blend_difference_avx2  (GeglOperation *operation,
+                                                       const gfloat  *in,
+                                                       const gfloat  *layer,
+                                                       gfloat        *comp,
+                                                       gint           samples);
+void gimp_operation_layer_mode_blend_divide_avx2      (GeglOperation *operation,
+                                                       const gfloat  *in,
+                                                       const gfloat  *layer,
+                                                       gfloat        *comp,
+                                                       gint           samples);
+void gimp_operation_layer_mode_blend_dodge_avx2       (GeglOperation *operation,
+                                                       const gfloat  *in,
+                                                       const gfloat  *layer,
+                                                       gfloat        *comp,
+                                                       gint           samples);
+void gimp_operation_layer_mode_blend_exclusion_avx2   (GeglOperation *operation,
+                                                       const gfloat  *in,
+                                                       const gfloat  *layer,
+                                                       gfloat        *comp,
+                                                       gint           samples);
+void gimp_operation_layer_mode_blend_grain_extract_avx2(GeglOperation *operation,
+                                                       const gfloat  *in,
+                                                       const gfloat  *layer,
+                                                       gfloat        *comp,
+                                                       gint           samples);
+void gimp_operation_layer_mode_blend_grain_merge_avx2 (GeglOperation *operation,
+                                                       const gfloat  *in,
+                                                       const gfloat  *layer,
+                                                       gfloat        *comp,
+                                                       gint           samples);
+void gimp_operation_layer_mode_blend_hard_mix_avx2    (GeglOperation *operation,
+                                                       const gfloat  *in,
+                                                       const gfloat  *layer,
+                                                       gfloat        *comp,
+                                                       gint           samples);
+void gimp_operation_layer_mode_blend_hardlight_avx2   (GeglOperation *operation,
+                                                       const gfloat  *in,
+                                                       const gfloat  *layer,
+                                                       gfloat        *comp,
+                                                       gint           samples);
+void gimp_operation_layer_mode_blend_lighten_only_avx2(GeglOperation *operation,
+                                                       const gfloat  *in,
+                                                       const gfloat  *layer,
+                                                       gfloat        *comp,
+                                                       gint           samples);
+void gimp_operation_layer_mode_blend_linear_burn_avx2 (GeglOperation *operation,
+                                                       const gfloat  *in,
+                                                       const gfloat  *layer,
+                                                       gfloat        *comp,
+                                                       gint           samples);
+void gimp_operation_layer_mode_blend_linear_light_avx2(GeglOperation *operation,
+                                                       const gfloat  *in,
+                                                       const gfloat  *layer,
+                                                       gfloat        *comp,
+                                                       gint           samples);
+void gimp_operation_layer_mode_blend_multiply_avx2    (GeglOperation *operation,
+                                                       const gfloat  *in,
+                                                       const gfloat  *layer,
+                                                       gfloat        *comp,
+                                                       gint           samples);
+void gimp_operation_layer_mode_blend_overlay_avx2     (GeglOperation *operation,
+                                                       const gfloat  *in,
+                                                       const gfloat  *layer,
+                                                       gfloat        *comp,
+                                                       gint           samples);
+void gimp_operation_layer_mode_blend_pin_light_avx2   (GeglOperation *operation,
+                                                       const gfloat  *in,
+                                                       const gfloat  *layer,
+                                                       gfloat        *comp,
+                                                       gint           samples);
+void gimp_operation_layer_mode_blend_screen_avx2      (GeglOperation *operation,
+                                                       const gfloat  *in,
+                                                       const gfloat  *layer,
+                                                       gfloat        *comp,
+                                                       gint           samples);
+void gimp_operation_layer_mode_blend_softlight_avx2   (GeglOperation *operation,
+                                                       const gfloat  *in,
+                                                       const gfloat  *layer,
+                                                       gfloat        *comp,
+                                                       gint           samples);
+void gimp_operation_layer_mode_blend_subtract_avx2    (GeglOperation *operation,
+                                                       const gfloat  *in,
+                                                       const gfloat  *layer,
+                                                       gfloat        *comp,
+                                                       gint           samples);
+void gimp_operation_layer_mode_blend_vivid_light_avx2 (GeglOperation *operation,
+                                                       const gfloat  *in,
+                                                       const gfloat  *layer,
+                                                       gfloat        *comp,
+                                                       gint           samples);
+
+#endif /* COMPILE_AVX2_INTRINISICS */
+
+
 #endif /* __GIMP_OPERATION_LAYER_MODE_BLEND_H__ */
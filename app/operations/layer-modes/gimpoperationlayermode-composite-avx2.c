@@ -0,0 +1,288 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimpoperationlayermode-composite-avx2.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <gegl-plugin.h>
+#include <cairo.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#include "../operations-types.h"
+
+#include "gimpoperationlayermode-composite.h"
+
+
+#if COMPILE_AVX2_INTRINISICS
+
+/* AVX2 and FMA */
+#include <immintrin.h>
+
+
+/*  each 256-bit vector holds two RGBA samples.  the alpha component of each
+ *  sample is broadcast to all four lanes of its half, so that the per-sample
+ *  conditions of the scalar code become per-lane selects.  selecting, rather
+ *  than multiplying by a 0/1 mask, keeps the unconstrained (possibly NaN)
+ *  color values of comp out of the result.
+ */
+
+#define ALPHA_BLEND_MASK 0x88
+
+
+static inline __m256
+broadcast_alpha (__m256 v)
+{
+  return _mm256_permute_ps (v, _MM_SHUFFLE (3, 3, 3, 3));
+}
+
+static inline __m256
+load_mask (const gfloat *mask)
+{
+  return _mm256_insertf128_ps (_mm256_castps128_ps256 (_mm_set1_ps (mask[0])),
+                               _mm_set1_ps (mask[1]), 1);
+}
+
+static inline __m256
+is_zero (__m256 v)
+{
+  return _mm256_cmp_ps (v, _mm256_setzero_ps (), _CMP_EQ_OQ);
+}
+
+
+/*  non-subtractive compositing functions.  these functions expect comp[ALPHA]
+ *  to be the same as layer[ALPHA].  when in[ALPHA] or layer[ALPHA] are zero,
+ *  the value of comp[RED..BLUE] is unconstrained (in particular, it may be
+ *  NaN).
+ */
+
+
+void
+gimp_operation_layer_mode_composite_union_avx2 (const gfloat *in,
+                                                const gfloat *layer,
+                                                const gfloat *comp,
+                                                const gfloat *mask,
+                                                gfloat        opacity,
+                                                gfloat       *out,
+                                                gint          samples)
+{
+  const __m256 v_one     = _mm256_set1_ps (1.0f);
+  const __m256 v_opacity = _mm256_set1_ps (opacity);
+
+  for (; samples >= 2; samples -= 2)
+    {
+      __m256 v_in          = _mm256_loadu_ps (in);
+      __m256 v_layer       = _mm256_loadu_ps (layer);
+      __m256 v_comp        = _mm256_loadu_ps (comp);
+      __m256 v_in_alpha    = broadcast_alpha (v_in);
+      __m256 v_layer_alpha = _mm256_mul_ps (broadcast_alpha (v_layer),
+                                            v_opacity);
+      __m256 v_new_alpha;
+      __m256 v_ratio;
+      __m256 v_blended;
+      __m256 v_out;
+
+      if (mask)
+        {
+          v_layer_alpha = _mm256_mul_ps (v_layer_alpha, load_mask (mask));
+
+          mask += 2;
+        }
+
+      /* layer_alpha + (1 - layer_alpha) * in_alpha */
+      v_new_alpha = _mm256_fmadd_ps (_mm256_sub_ps (v_one, v_layer_alpha),
+                                     v_in_alpha, v_layer_alpha);
+
+      /* ratio * (in_alpha * (comp - layer) + layer - in) + in */
+      v_ratio   = _mm256_div_ps (v_layer_alpha, v_new_alpha);
+      v_blended = _mm256_fmadd_ps (v_in_alpha,
+                                   _mm256_sub_ps (v_comp, v_layer),
+                                   _mm256_sub_ps (v_layer, v_in));
+      v_blended = _mm256_fmadd_ps (v_ratio, v_blended, v_in);
+
+      v_out = _mm256_blendv_ps (v_blended, v_layer, is_zero (v_in_alpha));
+      v_out = _mm256_blendv_ps (v_out, v_in,
+                                _mm256_or_ps (is_zero (v_layer_alpha),
+                                              is_zero (v_new_alpha)));
+      v_out = _mm256_blend_ps (v_out, v_new_alpha, ALPHA_BLEND_MASK);
+
+      _mm256_storeu_ps (out, v_out);
+
+      in    += 8;
+      layer += 8;
+      comp  += 8;
+      out   += 8;
+    }
+
+  if (samples)
+    {
+      gimp_operation_layer_mode_composite_union (in, layer, comp, mask,
+                                                 opacity, out, samples);
+    }
+}
+
+void
+gimp_operation_layer_mode_composite_clip_to_backdrop_avx2 (const gfloat *in,
+                                                           const gfloat *layer,
+                                                           const gfloat *comp,
+                                                           const gfloat *mask,
+                                                           gfloat        opacity,
+                                                           gfloat       *out,
+                                                           gint          samples)
+{
+  const __m256 v_opacity = _mm256_set1_ps (opacity);
+
+  for (; samples >= 2; samples -= 2)
+    {
+      __m256 v_in          = _mm256_loadu_ps (in);
+      __m256 v_comp        = _mm256_loadu_ps (comp);
+      __m256 v_in_alpha    = broadcast_alpha (v_in);
+      __m256 v_layer_alpha = _mm256_mul_ps (broadcast_alpha (v_comp),
+                                            v_opacity);
+      __m256 v_blended;
+      __m256 v_out;
+
+      if (mask)
+        {
+          v_layer_alpha = _mm256_mul_ps (v_layer_alpha, load_mask (mask));
+
+          mask += 2;
+        }
+
+      /* comp * layer_alpha + in * (1 - layer_alpha) */
+      v_blended = _mm256_fmadd_ps (_mm256_sub_ps (v_comp, v_in),
+                                   v_layer_alpha, v_in);
+
+      v_out = _mm256_blendv_ps (v_blended, v_in,
+                                _mm256_or_ps (is_zero (v_in_alpha),
+                                              is_zero (v_layer_alpha)));
+      v_out = _mm256_blend_ps (v_out, v_in, ALPHA_BLEND_MASK);
+
+      _mm256_storeu_ps (out, v_out);
+
+      in    += 8;
+      comp  += 8;
+      out   += 8;
+    }
+
+  if (samples)
+    {
+      gimp_operation_layer_mode_composite_clip_to_backdrop (in, layer, comp,
+                                                            mask, opacity, out,
+                                                            samples);
+    }
+}
+
+void
+gimp_operation_layer_mode_composite_clip_to_layer_avx2 (const gfloat *in,
+                                                        const gfloat *layer,
+                                                        const gfloat *comp,
+                                                        const gfloat *mask,
+                                                        gfloat        opacity,
+                                                        gfloat       *out,
+                                                        gint          samples)
+{
+  const __m256 v_opacity = _mm256_set1_ps (opacity);
+
+  for (; samples >= 2; samples -= 2)
+    {
+      __m256 v_in          = _mm256_loadu_ps (in);
+      __m256 v_layer       = _mm256_loadu_ps (layer);
+      __m256 v_comp        = _mm256_loadu_ps (comp);
+      __m256 v_in_alpha    = broadcast_alpha (v_in);
+      __m256 v_layer_alpha = _mm256_mul_ps (broadcast_alpha (v_layer),
+                                            v_opacity);
+      __m256 v_blended;
+      __m256 v_out;
+
+      if (mask)
+        {
+          v_layer_alpha = _mm256_mul_ps (v_layer_alpha, load_mask (mask));
+
+          mask += 2;
+        }
+
+      /* comp * in_alpha + layer * (1 - in_alpha) */
+      v_blended = _mm256_fmadd_ps (_mm256_sub_ps (v_comp, v_layer),
+                                   v_in_alpha, v_layer);
+
+      v_out = _mm256_blendv_ps (v_blended, v_layer, is_zero (v_in_alpha));
+      v_out = _mm256_blendv_ps (v_out, v_in, is_zero (v_layer_alpha));
+      v_out = _mm256_blend_ps (v_out, v_layer_alpha, ALPHA_BLEND_MASK);
+
+      _mm256_storeu_ps (out, v_out);
+
+      in    += 8;
+      layer += 8;
+      comp  += 8;
+      out   += 8;
+    }
+
+  if (samples)
+    {
+      gimp_operation_layer_mode_composite_clip_to_layer (in, layer, comp,
+                                                         mask, opacity, out,
+                                                         samples);
+    }
+}
+
+void
+gimp_operation_layer_mode_composite_intersection_avx2 (const gfloat *in,
+                                                       const gfloat *layer,
+                                                       const gfloat *comp,
+                                                       const gfloat *mask,
+                                                       gfloat        opacity,
+                                                       gfloat       *out,
+                                                       gint          samples)
+{
+  const __m256 v_opacity = _mm256_set1_ps (opacity);
+
+  for (; samples >= 2; samples -= 2)
+    {
+      __m256 v_in        = _mm256_loadu_ps (in);
+      __m256 v_comp      = _mm256_loadu_ps (comp);
+      __m256 v_new_alpha = _mm256_mul_ps (_mm256_mul_ps (broadcast_alpha (v_in),
+                                                         broadcast_alpha (v_comp)),
+                                          v_opacity);
+      __m256 v_out;
+
+      if (mask)
+        {
+          v_new_alpha = _mm256_mul_ps (v_new_alpha, load_mask (mask));
+
+          mask += 2;
+        }
+
+      v_out = _mm256_blendv_ps (v_comp, v_in, is_zero (v_new_alpha));
+      v_out = _mm256_blend_ps (v_out, v_new_alpha, ALPHA_BLEND_MASK);
+
+      _mm256_storeu_ps (out, v_out);
+
+      in    += 8;
+      comp  += 8;
+      out   += 8;
+    }
+
+  if (samples)
+    {
+      gimp_operation_layer_mode_composite_intersection (in, layer, comp,
+                                                        mask, opacity, out,
+                                                        samples);
+    }
+}
+
+#endif /* COMPILE_AVX2_INTRINISICS */
@@ -223,6 +223,17 @@ gimp_operation_layer_mode_class_init (GimpOperationLayerModeClass *klass)
   if (gimp_cpu_accel_get_support () & GIMP_CPU_ACCEL_X86_SSE2)
     composite_clip_to_backdrop = gimp_operation_layer_mode_composite_clip_to_backdrop_sse2;
 #endif
+
+#if COMPILE_AVX2_INTRINISICS
+  if ((gimp_cpu_accel_get_support () & GIMP_CPU_ACCEL_X86_AVX2) &&
+      (gimp_cpu_accel_get_support () & GIMP_CPU_ACCEL_X86_FMA))
+    {
+      composite_union            = gimp_operation_layer_mode_composite_union_avx2;
+      composite_clip_to_backdrop = gimp_operation_layer_mode_composite_clip_to_backdrop_avx2;
+      composite_clip_to_layer    = gimp_operation_layer_mode_composite_clip_to_layer_avx2;
+      composite_intersection     = gimp_operation_layer_mode_composite_intersection_avx2;
+    }
+#endif
 }
 
 static void
@@ -0,0 +1,338 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <gegl.h>
+#include <gegl-plugin.h>
+#include <cairo.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#include "libgimpbase/gimpbase.h"
+
+#include "app/operations/operations-types.h"
+
+#include "app/operations/layer-modes/gimpoperationlayermode-blend.h"
+#include "app/operations/layer-modes/gimpoperationlayermode-composite.h"
+
+
+/*  FMA changes the rounding, so the AVX2 functions are compared against
+ *  the scalar ones with a relative tolerance
+ */
+#define TOLERANCE 1e-4
+
+/*  written past the end of the output, to catch overruns  */
+#define GUARD     12345.0f
+
+#define MAX_SAMPLES 67
+
+
+#if COMPILE_AVX2_INTRINISICS
+
+typedef void (* BlendFunc)     (GeglOperation *operation,
+                                const gfloat  *in,
+                                const gfloat  *layer,
+                                gfloat        *comp,
+                                gint           samples);
+
+typedef void (* CompositeFunc) (const gfloat  *in,
+                                const gfloat  *layer,
+                                const gfloat  *comp,
+                                const gfloat  *mask,
+                                gfloat         opacity,
+                                gfloat        *out,
+                                gint           samples);
+
+#define BLEND_FUNCS(name)                                   \
+  { #name,                                                  \
+    gimp_operation_layer_mode_blend_##name,                 \
+    gimp_operation_layer_mode_blend_##name##_avx2 }
+
+static const struct
+{
+  const gchar *name;
+  BlendFunc    scalar;
+  BlendFunc    avx2;
+} blend_funcs[] =
+{
+  BLEND_FUNCS (addition),
+  BLEND_FUNCS (burn),
+  BLEND_FUNCS (darken_only),
+  BLEND_FUNCS (difference),
+  BLEND_FUNCS (divide),
+  BLEND_FUNCS (dodge),
+  BLEND_FUNCS (exclusion),
+  BLEND_FUNCS (grain_extract),
+  BLEND_FUNCS (grain_merge),
+  BLEND_FUNCS (hard_mix),
+  BLEND_FUNCS (hardlight),
+  BLEND_FUNCS (lighten_only),
+  BLEND_FUNCS (linear_burn),
+  BLEND_FUNCS (linear_light),
+  BLEND_FUNCS (multiply),
+  BLEND_FUNCS (overlay),
+  BLEND_FUNCS (pin_light),
+  BLEND_FUNCS (screen),
+  BLEND_FUNCS (softlight),
+  BLEND_FUNCS (subtract),
+  BLEND_FUNCS (vivid_light)
+};
+
+#undef BLEND_FUNCS
+
+#define COMPOSITE_FUNCS(name)                               \
+  { #name,                                                  \
+    gimp_operation_layer_mode_composite_##name,             \
+    gimp_operation_layer_mode_composite_##name##_avx2 }
+
+static const struct
+{
+  const gchar   *name;
+  CompositeFunc  scalar;
+  CompositeFunc  avx2;
+} composite_funcs[] =
+{
+  COMPOSITE_FUNCS (union),
+  COMPOSITE_FUNCS (clip_to_backdrop),
+  COMPOSITE_FUNCS (clip_to_layer),
+  COMPOSITE_FUNCS (intersection)
+};
+
+#undef COMPOSITE_FUNCS
+
+/*  odd counts exercise the scalar tail of the AVX2 functions  */
+static const gint sample_counts[] = { 0, 1, 2, 3, 7, 8, 15, 16, 33, MAX_SAMPLES };
+
+
+static gboolean
+have_avx2 (void)
+{
+  const GimpCpuAccelFlags avx2_fma = GIMP_CPU_ACCEL_X86_AVX2 |
+                                     GIMP_CPU_ACCEL_X86_FMA;
+
+  if ((gimp_cpu_accel_get_support () & avx2_fma) != avx2_fma)
+    {
+      g_test_skip ("the CPU doesn't support AVX2 and FMA");
+
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+/*  fills 'pixels' with colors slightly outside of [0, 1], and alphas
+ *  which are often exactly 0 or 1
+ */
+static void
+fill_pixels (GRand  *rand,
+             gfloat *pixels,
+             gint    samples)
+{
+  gint i;
+
+  for (i = 0; i < samples; i++)
+    {
+      gint c;
+
+      for (c = RED; c < ALPHA; c++)
+        pixels[4 * i + c] = g_rand_double_range (rand, -0.1, 1.1);
+
+      switch (g_rand_int_range (rand, 0, 4))
+        {
+        case 0:  pixels[4 * i + ALPHA] = 0.0f;                            break;
+        case 1:  pixels[4 * i + ALPHA] = 1.0f;                            break;
+        default: pixels[4 * i + ALPHA] = g_rand_double_range (rand, 0, 1); break;
+        }
+    }
+}
+
+static void
+assert_close (const gchar *name,
+              gint         samples,
+              gint         index,
+              gfloat       expected,
+              gfloat       actual)
+{
+  if (isnan (expected) && isnan (actual))
+    return;
+
+  if (expected == actual)
+    return;
+
+  if (fabs (expected - actual) <= TOLERANCE * MAX (1.0, fabs (expected)))
+    return;
+
+  g_error ("%s (%d samples): value %d is %.9g, expected %.9g",
+           name, samples, index, actual, expected);
+}
+
+static void
+test_blend (void)
+{
+  GRand  *rand;
+  gfloat  in[4 * MAX_SAMPLES];
+  gfloat  layer[4 * MAX_SAMPLES];
+  gfloat  comp_scalar[4 * MAX_SAMPLES + 4];
+  gfloat  comp_avx2[4 * MAX_SAMPLES + 4];
+  gint    f;
+  gint    n;
+
+  if (! have_avx2 ())
+    return;
+
+  rand = g_rand_new_with_seed (1);
+
+  for (f = 0; f < G_N_ELEMENTS (blend_funcs); f++)
+    {
+      for (n = 0; n < G_N_ELEMENTS (sample_counts); n++)
+        {
+          gint samples = sample_counts[n];
+          gint i;
+
+          fill_pixels (rand, in,    samples);
+          fill_pixels (rand, layer, samples);
+
+          for (i = 0; i < 4 * samples + 4; i++)
+            comp_scalar[i] = comp_avx2[i] = GUARD;
+
+          blend_funcs[f].scalar (NULL, in, layer, comp_scalar, samples);
+          blend_funcs[f].avx2   (NULL, in, layer, comp_avx2,   samples);
+
+          for (i = 0; i < samples; i++)
+            {
+              gint c;
+
+              /*  comp[RED..BLUE] is unconstrained when either alpha is 0  */
+              if (in[4 * i + ALPHA] != 0.0f && layer[4 * i + ALPHA] != 0.0f)
+                {
+                  for (c = RED; c < ALPHA; c++)
+                    {
+                      assert_close (blend_funcs[f].name, samples, 4 * i + c,
+                                    comp_scalar[4 * i + c],
+                                    comp_avx2[4 * i + c]);
+                    }
+                }
+
+              g_assert_cmpfloat (comp_avx2[4 * i + ALPHA], ==,
+                                 layer[4 * i + ALPHA]);
+            }
+
+          for (i = 4 * samples; i < 4 * samples + 4; i++)
+            g_assert_cmpfloat (comp_avx2[i], ==, GUARD);
+        }
+    }
+
+  g_rand_free (rand);
+}
+
+static void
+test_composite (void)
+{
+  static const gfloat opacities[] = { 0.0f, 0.5f, 1.0f };
+  GRand              *rand;
+  gfloat              in[4 * MAX_SAMPLES];
+  gfloat              layer[4 * MAX_SAMPLES];
+  gfloat              comp[4 * MAX_SAMPLES];
+  gfloat              mask[MAX_SAMPLES];
+  gfloat              out_scalar[4 * MAX_SAMPLES + 4];
+  gfloat              out_avx2[4 * MAX_SAMPLES + 4];
+  gint                f;
+  gint                n;
+  gint                o;
+  gint                m;
+
+  if (! have_avx2 ())
+    return;
+
+  rand = g_rand_new_with_seed (2);
+
+  for (f = 0; f < G_N_ELEMENTS (composite_funcs); f++)
+    for (n = 0; n < G_N_ELEMENTS (sample_counts); n++)
+      for (o = 0; o < G_N_ELEMENTS (opacities); o++)
+        for (m = 0; m < 2; m++)
+          {
+            gint          samples  = sample_counts[n];
+            const gfloat *mask_ptr = m ? mask : NULL;
+            gint          i;
+
+            fill_pixels (rand, in,    samples);
+            fill_pixels (rand, layer, samples);
+            fill_pixels (rand, comp,  samples);
+
+            for (i = 0; i < samples; i++)
+              {
+                gint c;
+
+                /*  the blend functions may leave NaN where either alpha
+                 *  is 0, which must not leak into the output
+                 */
+                if (in[4 * i + ALPHA] == 0.0f || layer[4 * i + ALPHA] == 0.0f)
+                  {
+                    for (c = RED; c < ALPHA; c++)
+                      comp[4 * i + c] = NAN;
+                  }
+
+                comp[4 * i + ALPHA] = layer[4 * i + ALPHA];
+
+                switch (g_rand_int_range (rand, 0, 3))
+                  {
+                  case 0:  mask[i] = 0.0f;                            break;
+                  case 1:  mask[i] = 1.0f;                            break;
+                  default: mask[i] = g_rand_double_range (rand, 0, 1); break;
+                  }
+              }
+
+            for (i = 0; i < 4 * samples + 4; i++)
+              out_scalar[i] = out_avx2[i] = GUARD;
+
+            composite_funcs[f].scalar (in, layer, comp, mask_ptr,
+                                       opacities[o], out_scalar, samples);
+            composite_funcs[f].avx2   (in, layer, comp, mask_ptr,
+                                       opacities[o], out_avx2,   samples);
+
+            for (i = 0; i < 4 * samples; i++)
+              {
+                assert_close (composite_funcs[f].name, samples, i,
+                              out_scalar[i], out_avx2[i]);
+              }
+
+            for (i = 4 * samples; i < 4 * samples + 4; i++)
+              g_assert_cmpfloat (out_avx2[i], ==, GUARD);
+          }
+
+  g_rand_free (rand);
+}
+
+#endif /* COMPILE_AVX2_INTRINISICS */
+
+
+gint
+main (gint     argc,
+      gchar ** argv)
+{
+  g_test_init (&argc, &argv, NULL);
+
+#if COMPILE_AVX2_INTRINISICS
+  g_test_add_func ("/layer-modes-avx2/blend",     test_blend);
+  g_test_add_func ("/layer-modes-avx2/composite", test_composite);
+#endif
+
+  return g_test_run ();
+}
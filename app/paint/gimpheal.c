@@ -58,8 +58,11 @@
  * corrected, I1 is the reference pattern. Then we solve DeltaI=0
  * (Laplace) with I2 Dirichlet conditions at the borders of the
  * mask. The solver is a red/black checker Gauss-Seidel with over-relaxation.
- * It could benefit from a multi-grid evaluation of an initial solution
- * before the main iteration loop.
+ * For large areas, it is used as the smoother of a multigrid V-cycle
+ * instead, which removes the low frequencies of the error on coarser
+ * grids, where the relaxation alone needs hundreds of iterations for
+ * them.  The cells of one color don't depend on each other, so each half
+ * of a multigrid relaxation is split among threads.
  *
  * I reduced the convergence criteria to 0.1% (0.001) as we are
  * dealing here with RGB integer components, more is overkill.
@@ -67,6 +70,53 @@
  * Jean-Yves Couleaud cjyves@free.fr
  */
 
+/* Tolerate a total deviation-from-smoothness of 0.1 LSBs at 8bit depth. */
+#define EPSILON            (0.1/255)
+#define MAX_ITER           500
+
+/* the multigrid solver runs V-cycles until the same tolerance is met */
+#define MAX_CYCLES         50
+#define N_SMOOTH           2
+
+/* grids smaller than this are not coarsened any further */
+#define LAPLACE_MIN_SIZE   16
+
+/* areas smaller than this are solved faster without multigrid */
+#define MULTIGRID_MIN_AREA (128 * 128)
+
+/* the number of cells relaxed by a thread in one go */
+#define LAPLACE_BLOCK_SIZE 4096
+
+
+typedef struct
+{
+  gint    width;
+  gint    height;
+  gint    depth;
+  guchar *mask;
+  gfloat *Adiag;
+  gfloat *Ainv;
+  gint   *Aidx;
+  gint    nmask;
+  gint    nred;
+  gfloat *x;
+  gfloat *x_alloc;
+  gfloat *rhs;
+  gfloat *rhs_alloc;
+  gfloat *res;
+  gfloat *res_alloc;
+} LaplaceLevel;
+
+typedef struct
+{
+  LaplaceLevel *level;
+  gint          start;
+  gint          end;
+  gfloat        omega;
+  gfloat       *errors;
+} LaplaceSweepData;
+
+
 static gboolean     gimp_heal_start              (GimpPaintCore    *paint_core,
                                                   GimpDrawable     *drawable,
                                                   GimpPaintOptions *paint_options,
@@ -345,23 +395,21 @@ gimp_heal_laplace_iteration (gfloat *pixels,
   return err;
 }
 
-/* Solve the laplace equation for pixels and store the result in-place.
+/* Construct the system of equations for the cells in mask, and return
+ * the number of unknowns.  The first nred unknowns are the red cells.
  */
-static void
-gimp_heal_laplace_loop (gfloat *pixels,
-                        gint    height,
-                        gint    depth,
-                        gint    width,
-                        guchar *mask)
+static gint
+gimp_heal_laplace_build (const guchar  *mask,
+                         gint           height,
+                         gint           depth,
+                         gint           width,
+                         gfloat       **Adiag_out,
+                         gint         **Aidx_out,
+                         gint          *nred_out)
 {
-  /* Tolerate a total deviation-from-smoothness of 0.1 LSBs at 8bit depth. */
-#define EPSILON  (0.1/255)
-#define MAX_ITER 500
-
-  gint    i, j, iter, parity, nmask, zero;
+  gint    i, j, parity, nmask, nred, zero;
   gfloat *Adiag;
   gint   *Aidx;
-  gfloat  w;
 
   Adiag = g_new (gfloat, width * height);
   Aidx  = g_new (gint, 5 * width * height);
@@ -373,13 +421,12 @@ gimp_heal_laplace_loop (gfloat *pixels,
    * coefs can put them in a dummy column to be multiplied by an empty pixel.
    */
   zero = depth * width * height;
-  memset (pixels + zero, 0, depth * sizeof (gfloat));
 
-  /* Construct the system of equations.
-   * Arrange Aidx in checkerboard order, so that a single linear pass over that
+  /* Arrange Aidx in checkerboard order, so that a single linear pass over that
    * array results updating all of the red cells and then all of the black cells.
    */
   nmask = 0;
+  nred  = 0;
   for (parity = 0; parity < 2; parity++)
     for (i = 0; i < height; i++)
       for (j = (i&1)^parity; j < width; j+=2)
@@ -401,8 +448,36 @@ gimp_heal_laplace_loop (gfloat *pixels,
             A_NEIGHBOR (3,  0, -1);
             A_NEIGHBOR (4, -1,  0);
             nmask++;
+            nred += ! parity;
           }
 
+  *Adiag_out = Adiag;
+  *Aidx_out  = Aidx;
+  *nred_out  = nred;
+
+  return nmask;
+}
+
+/* Solve the laplace equation with single-threaded Gauss-Seidel and
+ * successive over-relaxation, and return the number of iterations.
+ */
+static gint
+gimp_heal_laplace_sor (gfloat       *pixels,
+                       gint          height,
+                       gint          depth,
+                       gint          width,
+                       const guchar *mask)
+{
+  gint    i, iter, nmask, nred;
+  gfloat *Adiag;
+  gint   *Aidx;
+  gfloat  w;
+
+  memset (pixels + depth * width * height, 0, depth * sizeof (gfloat));
+
+  nmask = gimp_heal_laplace_build (mask, height, depth, width,
+                                   &Adiag, &Aidx, &nred);
+
   /* Empirically optimal over-relaxation factor. (Benchmarked on
    * round brushes, at least. I don't know whether aspect ratio
    * affects it.)
@@ -413,7 +488,7 @@ gimp_heal_laplace_loop (gfloat *pixels,
     Adiag[i] *= w;
 
   /* Gauss-Seidel with successive over-relaxation */
-  for (iter = 0; iter < MAX_ITER; iter++)
+  for (iter = 1; iter <= MAX_ITER; iter++)
     {
       gfloat err = gimp_heal_laplace_iteration (pixels, Adiag, Aidx,
                                                 w, nmask, depth);
@@ -423,6 +498,583 @@ gimp_heal_laplace_loop (gfloat *pixels,
 
   g_free (Adiag);
   g_free (Aidx);
+
+  return MIN (iter, MAX_ITER);
+}
+
+#if defined(__SSE__) && defined(__GNUC__) && __GNUC__ >= 4
+static float
+gimp_heal_laplace_smooth_sse (gfloat       *x,
+                              const gfloat *rhs,
+                              const gfloat *Adiag,
+                              const gfloat *Ainv,
+                              const gint   *Aidx,
+                              gfloat        omega,
+                              gint          n)
+{
+  typedef float v4sf __attribute__((vector_size(16)));
+  gint i;
+  v4sf err = { 0, 0, 0, 0 };
+  union { v4sf v; float f[4]; } erru;
+
+#define XV(j) (*(v4sf*)&x[Aidx[i * 5 + j]])
+#define RHSV  (*(const v4sf*)&rhs[Aidx[i * 5]])
+
+  for (i = 0; i < n; i++)
+    {
+      gfloat f  = omega * Ainv[i];
+      v4sf   a  = { Adiag[i], Adiag[i], Adiag[i], Adiag[i] };
+      v4sf   fv = { f, f, f, f };
+      v4sf   r  = RHSV - (a * XV(0) - (XV(1) + XV(2) + XV(3) + XV(4)));
+
+      XV(0) += fv * r;
+      err += r * r;
+    }
+
+  erru.v = err;
+
+  return erru.f[0] + erru.f[1] + erru.f[2] + erru.f[3];
+}
+
+static float
+gimp_heal_laplace_residual_sse (const gfloat *x,
+                                const gfloat *rhs,
+                                gfloat       *res,
+                                const gfloat *Adiag,
+                                const gint   *Aidx,
+                                gint          n)
+{
+  typedef float v4sf __attribute__((vector_size(16)));
+  gint i;
+  v4sf err = { 0, 0, 0, 0 };
+  union { v4sf v; float f[4]; } erru;
+
+  for (i = 0; i < n; i++)
+    {
+      v4sf a = { Adiag[i], Adiag[i], Adiag[i], Adiag[i] };
+      v4sf r = RHSV - (a * XV(0) - (XV(1) + XV(2) + XV(3) + XV(4)));
+
+      *(v4sf*)&res[Aidx[i * 5]] = r;
+      err += r * r;
+    }
+
+#undef XV
+#undef RHSV
+
+  erru.v = err;
+
+  return erru.f[0] + erru.f[1] + erru.f[2] + erru.f[3];
+}
+#endif
+
+/* Perform one iteration of Gauss-Seidel for A x = rhs on n cells, and
+ * return the sum squared residual.
+ */
+static float
+gimp_heal_laplace_smooth (gfloat       *x,
+                          const gfloat *rhs,
+                          const gfloat *Adiag,
+                          const gfloat *Ainv,
+                          const gint   *Aidx,
+                          gfloat        omega,
+                          gint          n,
+                          gint          depth)
+{
+  gint   i, k;
+  gfloat err = 0;
+
+#if defined(__SSE__) && defined(__GNUC__) && __GNUC__ >= 4
+  if (depth == 4)
+    return gimp_heal_laplace_smooth_sse (x, rhs, Adiag, Ainv, Aidx, omega, n);
+#endif
+
+  for (i = 0; i < n; i++)
+    {
+      gint   j0 = Aidx[i * 5 + 0];
+      gint   j1 = Aidx[i * 5 + 1];
+      gint   j2 = Aidx[i * 5 + 2];
+      gint   j3 = Aidx[i * 5 + 3];
+      gint   j4 = Aidx[i * 5 + 4];
+      gfloat a  = Adiag[i];
+      gfloat f  = omega * Ainv[i];
+
+      for (k = 0; k < depth; k++)
+        {
+          gfloat r = rhs[j0 + k] - (a * x[j0 + k] -
+                                    (x[j1 + k] +
+                                     x[j2 + k] +
+                                     x[j3 + k] +
+                                     x[j4 + k]));
+
+          x[j0 + k] += f * r;
+          err += r * r;
+        }
+    }
+
+  return err;
+}
+
+/* Store the residual of A x = rhs on n cells in res, and return its sum
+ * of squares.
+ */
+static float
+gimp_heal_laplace_residual (const gfloat *x,
+                            const gfloat *rhs,
+                            gfloat       *res,
+                            const gfloat *Adiag,
+                            const gint   *Aidx,
+                            gint          n,
+                            gint          depth)
+{
+  gint   i, k;
+  gfloat err = 0;
+
+#if defined(__SSE__) && defined(__GNUC__) && __GNUC__ >= 4
+  if (depth == 4)
+    return gimp_heal_laplace_residual_sse (x, rhs, res, Adiag, Aidx, n);
+#endif
+
+  for (i = 0; i < n; i++)
+    {
+      gint   j0 = Aidx[i * 5 + 0];
+      gint   j1 = Aidx[i * 5 + 1];
+      gint   j2 = Aidx[i * 5 + 2];
+      gint   j3 = Aidx[i * 5 + 3];
+      gint   j4 = Aidx[i * 5 + 4];
+      gfloat a  = Adiag[i];
+
+      for (k = 0; k < depth; k++)
+        {
+          gfloat r = rhs[j0 + k] - (a * x[j0 + k] -
+                                    (x[j1 + k] +
+                                     x[j2 + k] +
+                                     x[j3 + k] +
+                                     x[j4 + k]));
+
+          res[j0 + k] = r;
+          err += r * r;
+        }
+    }
+
+  return err;
+}
+
+static void
+gimp_heal_laplace_smooth_blocks (gint              offset,
+                                 gint              size,
+                                 LaplaceSweepData *data)
+{
+  LaplaceLevel *level = data->level;
+  gint          block;
+
+  for (block = offset; block < offset + size; block++)
+    {
+      gint start = data->start + block * LAPLACE_BLOCK_SIZE;
+      gint end   = MIN (start + LAPLACE_BLOCK_SIZE, data->end);
+
+      data->errors[block] =
+        gimp_heal_laplace_smooth (level->x, level->rhs,
+                                  level->Adiag + start,
+                                  level->Ainv  + start,
+                                  level->Aidx  + start * 5,
+                                  data->omega, end - start, level->depth);
+    }
+}
+
+static void
+gimp_heal_laplace_residual_blocks (gint              offset,
+                                   gint              size,
+                                   LaplaceSweepData *data)
+{
+  LaplaceLevel *level = data->level;
+  gint          block;
+
+  for (block = offset; block < offset + size; block++)
+    {
+      gint start = data->start + block * LAPLACE_BLOCK_SIZE;
+      gint end   = MIN (start + LAPLACE_BLOCK_SIZE, data->end);
+
+      data->errors[block] =
+        gimp_heal_laplace_residual (level->x, level->rhs, level->res,
+                                    level->Adiag + start,
+                                    level->Aidx  + start * 5,
+                                    end - start, level->depth);
+    }
+}
+
+/* Run func on the cells from start to end using all threads, and return
+ * the sum of the errors of all blocks.  The cells must not depend on each
+ * other, which is true for cells of the same color.
+ */
+static gfloat
+gimp_heal_laplace_distribute (LaplaceLevel                    *level,
+                              gint                             start,
+                              gint                             end,
+                              gfloat                           omega,
+                              GeglParallelDistributeRangeFunc  func)
+{
+  LaplaceSweepData data;
+  gint             n_blocks;
+  gint             i;
+  gfloat           err = 0;
+
+  n_blocks = (end - start + LAPLACE_BLOCK_SIZE - 1) / LAPLACE_BLOCK_SIZE;
+
+  if (n_blocks < 1)
+    return 0;
+
+  data.level  = level;
+  data.start  = start;
+  data.end    = end;
+  data.omega  = omega;
+  data.errors = g_new (gfloat, n_blocks);
+
+  gegl_parallel_distribute_range (n_blocks, 1, func, &data);
+
+  /* Sum up in a fixed order, so that the number of iterations doesn't
+   * depend on the number of threads.
+   */
+  for (i = 0; i < n_blocks; i++)
+    err += data.errors[i];
+
+  g_free (data.errors);
+
+  return err;
+}
+
+static gfloat
+gimp_heal_laplace_level_smooth (LaplaceLevel *level,
+                                gfloat        omega)
+{
+  gfloat err;
+
+  /* all red cells need to be done before the black ones */
+  err  = gimp_heal_laplace_distribute (
+    level, 0, level->nred, omega,
+    (GeglParallelDistributeRangeFunc) gimp_heal_laplace_smooth_blocks);
+  err += gimp_heal_laplace_distribute (
+    level, level->nred, level->nmask, omega,
+    (GeglParallelDistributeRangeFunc) gimp_heal_laplace_smooth_blocks);
+
+  return err;
+}
+
+static void
+gimp_heal_laplace_restrict_rows (gint          offset,
+                                 gint          size,
+                                 LaplaceLevel *fine)
+{
+  LaplaceLevel *coarse = fine + 1;
+  gint          depth  = fine->depth;
+  gint          ci, cj, i, j, k;
+
+  for (ci = offset; ci < offset + size; ci++)
+    for (cj = 0; cj < coarse->width; cj++)
+      {
+        gint    c   = ci * coarse->width + cj;
+        gfloat *rhs = coarse->rhs + c * depth;
+
+        memset (coarse->x + c * depth, 0, depth * sizeof (gfloat));
+
+        if (! coarse->mask[c])
+          continue;
+
+        /* the coarse operator is four times the fine one, so the
+         * residuals are summed rather than averaged
+         */
+        memset (rhs, 0, depth * sizeof (gfloat));
+
+        for (i = ci * 2; i < MIN (ci * 2 + 2, fine->height); i++)
+          for (j = cj * 2; j < MIN (cj * 2 + 2, fine->width); j++)
+            {
+              const gfloat *res = fine->res + (i * fine->width + j) * depth;
+
+              for (k = 0; k < depth; k++)
+                rhs[k] += res[k];
+            }
+      }
+}
+
+static void
+gimp_heal_laplace_prolong_rows (gint          offset,
+                                gint          size,
+                                LaplaceLevel *fine)
+{
+  LaplaceLevel *coarse = fine + 1;
+  gint          depth  = fine->depth;
+  gint          i, j, k;
+
+  /* Bilinear interpolation between the cell centers: each fine cell
+   * takes 3/4 of its own coarse cell and 1/4 of the nearer neighbor.
+   */
+  for (i = offset; i < offset + size; i++)
+    {
+      gint ci0 = i / 2;
+      gint ci1 = CLAMP ((i & 1) ? ci0 + 1 : ci0 - 1, 0, coarse->height - 1);
+
+      for (j = 0; j < fine->width; j++)
+        {
+          gint          cj0 = j / 2;
+          gint          cj1 = CLAMP ((j & 1) ? cj0 + 1 : cj0 - 1,
+                                     0, coarse->width - 1);
+          gfloat       *x;
+          const gfloat *c00, *c01, *c10, *c11;
+
+          if (! fine->mask[i * fine->width + j])
+            continue;
+
+          x   = fine->x   + (i   * fine->width   + j)   * depth;
+          c00 = coarse->x + (ci0 * coarse->width + cj0) * depth;
+          c01 = coarse->x + (ci0 * coarse->width + cj1) * depth;
+          c10 = coarse->x + (ci1 * coarse->width + cj0) * depth;
+          c11 = coarse->x + (ci1 * coarse->width + cj1) * depth;
+
+          for (k = 0; k < depth; k++)
+            {
+              x[k] += 0.75f * (0.75f * c00[k] + 0.25f * c01[k]) +
+                      0.25f * (0.75f * c10[k] + 0.25f * c11[k]);
+            }
+        }
+    }
+}
+
+/* Perform one multigrid V-cycle for level, and all coarser levels, and
+ * return the sum squared residual of its last relaxation.
+ */
+static gfloat
+gimp_heal_laplace_vcycle (LaplaceLevel *level,
+                          gint          n_levels)
+{
+  gfloat err = 0;
+  gint   i;
+
+  if (n_levels == 1)
+    {
+      /* Relax the coarsest level until its residual is small compared
+       * to the one it started with, using the same over-relaxation
+       * factor as the single-grid solver.
+       */
+      gfloat omega = 2.0 - 1.0 / (0.1575 * sqrt (level->nmask) + 0.8);
+      gfloat err0  = 0;
+
+      for (i = 0; i < MAX_ITER; i++)
+        {
+          err = gimp_heal_laplace_level_smooth (level, omega);
+
+          if (i == 0)
+            err0 = err;
+          else if (err <= err0 * 1e-6)
+            break;
+        }
+
+      return err;
+    }
+
+  for (i = 0; i < N_SMOOTH; i++)
+    gimp_heal_laplace_level_smooth (level, 1.0);
+
+  gimp_heal_laplace_distribute (
+    level, 0, level->nmask, 0.0,
+    (GeglParallelDistributeRangeFunc) gimp_heal_laplace_residual_blocks);
+
+  gegl_parallel_distribute_range (
+    (level + 1)->height, 1,
+    (GeglParallelDistributeRangeFunc) gimp_heal_laplace_restrict_rows,
+    level);
+
+  gimp_heal_laplace_vcycle (level + 1, n_levels - 1);
+
+  gegl_parallel_distribute_range (
+    level->height, 1,
+    (GeglParallelDistributeRangeFunc) gimp_heal_laplace_prolong_rows,
+    level);
+
+  for (i = 0; i < N_SMOOTH; i++)
+    err = gimp_heal_laplace_level_smooth (level, 1.0);
+
+  return err;
+}
+
+static gfloat *
+gimp_heal_laplace_alloc (gint     n,
+                         gfloat **alloc)
+{
+  *alloc = g_new0 (gfloat, 4 + n);
+
+  return (gfloat*)(((uintptr_t)*alloc + 15) & ~15);
+}
+
+/* Build the grid hierarchy, each level of half the resolution of the
+ * previous one.
+ */
+static gint
+gimp_heal_laplace_levels_new (gfloat         *pixels,
+                              gint            height,
+                              gint            depth,
+                              gint            width,
+                              const guchar   *mask,
+                              LaplaceLevel  **levels_out)
+{
+  LaplaceLevel *levels;
+  gint          n_levels = 1;
+  gint          max_levels;
+  gint          l, i, j;
+
+  max_levels = 1;
+
+  for (i = MIN (width, height); i >= 2 * LAPLACE_MIN_SIZE; i = (i + 1) / 2)
+    max_levels++;
+
+  levels = g_new0 (LaplaceLevel, max_levels);
+
+  levels[0].width  = width;
+  levels[0].height = height;
+  levels[0].depth  = depth;
+  levels[0].mask   = g_memdup (mask, width * height);
+  levels[0].x      = pixels;
+  levels[0].rhs    = gimp_heal_laplace_alloc (width * height * depth,
+                                              &levels[0].rhs_alloc);
+
+  for (l = 1; l < max_levels; l++)
+    {
+      LaplaceLevel *fine   = &levels[l - 1];
+      LaplaceLevel *coarse = &levels[l];
+      gboolean      unknown = FALSE;
+
+      coarse->width  = (fine->width  + 1) / 2;
+      coarse->height = (fine->height + 1) / 2;
+      coarse->depth  = depth;
+      coarse->mask   = g_new0 (guchar, coarse->width * coarse->height);
+
+      /* A coarse cell is unknown only if all of its fine cells are,
+       * a coarse cell straddling the border of the mask would
+       * overcorrect its fine cells.
+       */
+      for (i = 0; i < coarse->height; i++)
+        for (j = 0; j < coarse->width; j++)
+          {
+            gboolean all = TRUE;
+            gint     fi, fj;
+
+            for (fi = i * 2; fi < MIN (i * 2 + 2, fine->height); fi++)
+              for (fj = j * 2; fj < MIN (j * 2 + 2, fine->width); fj++)
+                all &= fine->mask[fi * fine->width + fj] != 0;
+
+            if (all)
+              {
+                coarse->mask[i * coarse->width + j] = 255;
+                unknown = TRUE;
+              }
+          }
+
+      if (! unknown)
+        {
+          g_free (coarse->mask);
+          break;
+        }
+
+      coarse->x   = gimp_heal_laplace_alloc ((coarse->width * coarse->height + 1) *
+                                             depth,
+                                             &coarse->x_alloc);
+      coarse->rhs = gimp_heal_laplace_alloc (coarse->width * coarse->height *
+                                             depth,
+                                             &coarse->rhs_alloc);
+      fine->res   = gimp_heal_laplace_alloc (fine->width * fine->height *
+                                             depth,
+                                             &fine->res_alloc);
+
+      n_levels++;
+    }
+
+  for (l = 0; l < n_levels; l++)
+    {
+      LaplaceLevel *level = &levels[l];
+
+      level->nmask = gimp_heal_laplace_build (level->mask,
+                                              level->height, depth,
+                                              level->width,
+                                              &level->Adiag, &level->Aidx,
+                                              &level->nred);
+
+      level->Ainv = g_new (gfloat, level->nmask);
+
+      for (i = 0; i < level->nmask; i++)
+        level->Ainv[i] = 1.0f / level->Adiag[i];
+    }
+
+  *levels_out = levels;
+
+  return n_levels;
+}
+
+static void
+gimp_heal_laplace_levels_free (LaplaceLevel *levels,
+                               gint          n_levels)
+{
+  gint l;
+
+  for (l = 0; l < n_levels; l++)
+    {
+      g_free (levels[l].mask);
+      g_free (levels[l].Adiag);
+      g_free (levels[l].Ainv);
+      g_free (levels[l].Aidx);
+      g_free (levels[l].x_alloc);
+      g_free (levels[l].rhs_alloc);
+      g_free (levels[l].res_alloc);
+    }
+
+  g_free (levels);
+}
+
+/* Solve the laplace equation for pixels and store the result in-place,
+ * and return the number of iterations, or V-cycles.  Without multigrid,
+ * or when the area is too small to be coarsened, this is the plain
+ * single-threaded relaxation.
+ */
+gint
+gimp_heal_laplace_solve (gfloat       *pixels,
+                         gint          height,
+                         gint          depth,
+                         gint          width,
+                         const guchar *mask,
+                         gboolean      multigrid)
+{
+  LaplaceLevel *levels;
+  gint          n_levels;
+  gint          cycle;
+
+  if (! multigrid                         ||
+      width * height < MULTIGRID_MIN_AREA ||
+      width          < 2 * LAPLACE_MIN_SIZE ||
+      height         < 2 * LAPLACE_MIN_SIZE)
+    {
+      return gimp_heal_laplace_sor (pixels, height, depth, width, mask);
+    }
+
+  memset (pixels + depth * width * height, 0, depth * sizeof (gfloat));
+
+  n_levels = gimp_heal_laplace_levels_new (pixels, height, depth, width,
+                                           mask, &levels);
+
+  if (n_levels < 2)
+    {
+      gimp_heal_laplace_levels_free (levels, n_levels);
+
+      return gimp_heal_laplace_sor (pixels, height, depth, width, mask);
+    }
+
+  for (cycle = 1; cycle <= MAX_CYCLES; cycle++)
+    {
+      gfloat err = gimp_heal_laplace_vcycle (levels, n_levels);
+
+      if (err < EPSILON * EPSILON)
+        break;
+    }
+
+  gimp_heal_laplace_levels_free (levels, n_levels);
+
+  return MIN (cycle, MAX_CYCLES);
 }
 
 /* Original Algorithm Design:
@@ -480,7 +1132,7 @@ gimp_heal (GeglBuffer          *src_buffer,
   gegl_buffer_get (mask_buffer, mask_rect, 1.0, babl_format ("Y u8"),
                    mask, GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
 
-  gimp_heal_laplace_loop (diff, height, src_components, width, mask);
+  gimp_heal_laplace_solve (diff, height, src_components, width, mask, TRUE);
 
   g_free (mask);
 
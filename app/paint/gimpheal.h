@@ -43,10 +43,17 @@ struct _GimpHealClass
 };
 
 
-void    gimp_heal_register (Gimp                      *gimp,
-                            GimpPaintRegisterCallback  callback);
+void    gimp_heal_register      (Gimp                      *gimp,
+                                 GimpPaintRegisterCallback  callback);
 
-GType   gimp_heal_get_type (void) G_GNUC_CONST;
+GType   gimp_heal_get_type      (void) G_GNUC_CONST;
+
+gint    gimp_heal_laplace_solve (gfloat                    *pixels,
+                                 gint                       height,
+                                 gint                       depth,
+                                 gint                       width,
+                                 const guchar              *mask,
+                                 gboolean                   multigrid);
 
 
 #endif  /*  __GIMP_HEAL_H__  */
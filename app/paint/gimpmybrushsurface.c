@@ -32,16 +32,71 @@
 #include "gimpmybrushsurface.h"
 
 
+/*  the size of the tiles of the float working copy  */
+#define TILE_SIZE        64
+
+/*  the number of cached tiles above which the tiles which were not used
+ *  by the last motion are dropped again
+ */
+#define MAX_CACHED_TILES 1024
+
+
+typedef struct
+{
+  GeglRectangle  rect;
+  gfloat        *pixels;  /*  R'G'B'A float  */
+  gfloat        *mask;    /*  Y float, or NULL without a paint mask  */
+  gboolean       dirty;
+  gboolean       queued;
+  guint          stamp;
+} GimpMybrushSurfaceTile;
+
+typedef struct
+{
+  GeglRectangle roi;
+  gfloat        x;
+  gfloat        y;
+  gfloat        radius;
+  gfloat        color_r;
+  gfloat        color_g;
+  gfloat        color_b;
+  gfloat        color_a;
+  gfloat        hardness;
+  gfloat        aspect_ratio;
+  gfloat        one_over_radius2;
+  gfloat        cs;
+  gfloat        sn;
+  gfloat        segment1_slope;
+  gfloat        segment2_slope;
+  gfloat        r_aa_start;
+  gfloat        normal_mode;
+  gfloat        colorize;
+} GimpMybrushDab;
+
 struct _GimpMybrushSurface
 {
-  MyPaintSurface surface;
-  GeglBuffer *buffer;
-  GeglBuffer *paint_mask;
-  gint        paint_mask_x;
-  gint        paint_mask_y;
-  GeglRectangle dirty;
-  GimpComponentMask component_mask;
-  GimpMybrushOptions *options;
+  MyPaintSurface            surface;
+  GeglBuffer               *buffer;
+  GeglBuffer               *paint_mask;
+  gint                      paint_mask_x;
+  gint                      paint_mask_y;
+  GeglRectangle             dirty;
+  GimpComponentMask         component_mask;
+  GimpMybrushOptions       *options;
+
+  /*  float working copy of the tiles touched during the stroke  */
+  GeglRectangle             extent;
+  gint                      n_tile_cols;
+  gint                      n_tile_rows;
+  GimpMybrushSurfaceTile  **tiles;
+  gint                      n_cached_tiles;
+  GPtrArray                *dirty_tiles;
+  guint                     stamp;
+
+  /*  dabs queued between begin_atomic() and end_atomic()  */
+  GArray                   *dabs;
+  GPtrArray                *batch_tiles;
+  gint                      atomic;
 };
 
 /* --- Taken from mypaint-tiled-surface.c --- */
@@ -229,6 +284,343 @@ calculate_dab_roi (float x,
   return *GEGL_RECTANGLE (x0, y0, x1 - x0, y1 - y0);
 }
 
+static GimpMybrushSurfaceTile *
+gimp_mypaint_surface_get_tile (GimpMybrushSurface *surface,
+                               gint                col,
+                               gint                row)
+{
+  GimpMybrushSurfaceTile **tile;
+
+  tile = &surface->tiles[row * surface->n_tile_cols + col];
+
+  if (! *tile)
+    {
+      GimpMybrushSurfaceTile *new_tile = g_slice_new0 (GimpMybrushSurfaceTile);
+      GeglRectangle          *rect     = &new_tile->rect;
+
+      rect->x      = surface->extent.x + col * TILE_SIZE;
+      rect->y      = surface->extent.y + row * TILE_SIZE;
+      rect->width  = MIN (TILE_SIZE,
+                          surface->extent.x + surface->extent.width  - rect->x);
+      rect->height = MIN (TILE_SIZE,
+                          surface->extent.y + surface->extent.height - rect->y);
+
+      new_tile->pixels = g_new (gfloat, 4 * rect->width * rect->height);
+
+      gegl_buffer_get (surface->buffer, rect, 1.0,
+                       babl_format ("R'G'B'A float"), new_tile->pixels,
+                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+      if (surface->paint_mask)
+        {
+          GeglRectangle mask_roi = *rect;
+
+          mask_roi.x -= surface->paint_mask_x;
+          mask_roi.y -= surface->paint_mask_y;
+
+          new_tile->mask = g_new (gfloat, rect->width * rect->height);
+
+          gegl_buffer_get (surface->paint_mask, &mask_roi, 1.0,
+                           babl_format ("Y float"), new_tile->mask,
+                           GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+        }
+
+      surface->n_cached_tiles++;
+
+      *tile = new_tile;
+    }
+
+  (*tile)->stamp = surface->stamp;
+
+  return *tile;
+}
+
+static void
+gimp_mypaint_surface_free_tile (GimpMybrushSurfaceTile *tile)
+{
+  g_free (tile->pixels);
+  g_free (tile->mask);
+
+  g_slice_free (GimpMybrushSurfaceTile, tile);
+}
+
+static void
+gimp_mypaint_surface_render_dab (const GimpMybrushDab   *dab,
+                                 GimpMybrushSurfaceTile *tile,
+                                 const GeglRectangle    *roi,
+                                 GimpComponentMask       component_mask,
+                                 gboolean                no_erasing)
+{
+  gfloat rr[TILE_SIZE];
+  gfloat base_alpha[TILE_SIZE];
+  gfloat alpha[TILE_SIZE];
+  gint   iy;
+
+  for (iy = roi->y; iy < roi->y + roi->height; iy++)
+    {
+      gint    offset = (iy      - tile->rect.y) * tile->rect.width +
+                       (roi->x  - tile->rect.x);
+      gfloat *pixel  = tile->pixels + 4 * offset;
+      gint    i;
+
+      /*  compute the dab's coverage of the whole row first, the loops
+       *  don't carry anything from one pixel to the next, so they can
+       *  be vectorized by the compiler
+       */
+      if (dab->radius < 3.0f)
+        {
+          for (i = 0; i < roi->width; i++)
+            rr[i] = calculate_rr_antialiased (roi->x + i, iy, dab->x, dab->y,
+                                              dab->aspect_ratio,
+                                              dab->sn, dab->cs,
+                                              dab->one_over_radius2,
+                                              dab->r_aa_start);
+        }
+      else
+        {
+          for (i = 0; i < roi->width; i++)
+            rr[i] = calculate_rr (roi->x + i, iy, dab->x, dab->y,
+                                  dab->aspect_ratio,
+                                  dab->sn, dab->cs,
+                                  dab->one_over_radius2);
+        }
+
+      for (i = 0; i < roi->width; i++)
+        base_alpha[i] = calculate_alpha_for_rr (rr[i], dab->hardness,
+                                                dab->segment1_slope,
+                                                dab->segment2_slope);
+
+      if (tile->mask)
+        {
+          const gfloat *mask = tile->mask + offset;
+
+          for (i = 0; i < roi->width; i++)
+            alpha[i] = base_alpha[i] * dab->normal_mode * mask[i];
+        }
+      else
+        {
+          for (i = 0; i < roi->width; i++)
+            alpha[i] = base_alpha[i] * dab->normal_mode;
+        }
+
+      for (i = 0; i < roi->width; i++, pixel += 4)
+        {
+          float a_src = alpha[i];
+          float dst_alpha, r, g, b, a;
+
+          /*  the pixel would be left as it is  */
+          if (a_src == 0.0f &&
+              (dab->colorize <= 0.0f || base_alpha[i] <= 0.0f))
+            continue;
+
+          dst_alpha = pixel[ALPHA];
+          /* a = alpha * color_a + dst_alpha * (1.0f - alpha);
+           * which converts to: */
+          a = a_src * (dab->color_a - dst_alpha) + dst_alpha;
+          r = pixel[RED];
+          g = pixel[GREEN];
+          b = pixel[BLUE];
+
+          if (a > 0.0f)
+            {
+              /* By definition the ratio between each color[] and pixel[] component in a non-pre-multipled blend always sums to 1.0f.
+               * Originally this would have been "(color[n] * alpha * color_a + pixel[n] * dst_alpha * (1.0f - alpha)) / a",
+               * instead we only calculate the cheaper term. */
+              float src_term = (a_src * dab->color_a) / a;
+              float dst_term = 1.0f - src_term;
+              r = dab->color_r * src_term + r * dst_term;
+              g = dab->color_g * src_term + g * dst_term;
+              b = dab->color_b * src_term + b * dst_term;
+            }
+
+          if (dab->colorize > 0.0f && base_alpha[i] > 0.0f)
+            {
+              a_src = base_alpha[i] * dab->colorize;
+              a = a_src + dst_alpha - a_src * dst_alpha;
+              if (a > 0.0f)
+                {
+                  GimpHSL pixel_hsl, out_hsl;
+                  GimpRGB pixel_rgb = {dab->color_r, dab->color_g, dab->color_b};
+                  GimpRGB out_rgb   = {r, g, b};
+                  float src_term = a_src / a;
+                  float dst_term = 1.0f - src_term;
+
+                  gimp_rgb_to_hsl (&pixel_rgb, &pixel_hsl);
+                  gimp_rgb_to_hsl (&out_rgb, &out_hsl);
+
+                  out_hsl.h = pixel_hsl.h;
+                  out_hsl.s = pixel_hsl.s;
+                  gimp_hsl_to_rgb (&out_hsl, &out_rgb);
+
+                  r = (float)out_rgb.r * src_term + r * dst_term;
+                  g = (float)out_rgb.g * src_term + g * dst_term;
+                  b = (float)out_rgb.b * src_term + b * dst_term;
+                }
+            }
+
+          if (no_erasing)
+            a = MAX (a, pixel[ALPHA]);
+
+          if (component_mask != GIMP_COMPONENT_MASK_ALL)
+            {
+              if (component_mask & GIMP_COMPONENT_MASK_RED)
+                pixel[RED]   = r;
+              if (component_mask & GIMP_COMPONENT_MASK_GREEN)
+                pixel[GREEN] = g;
+              if (component_mask & GIMP_COMPONENT_MASK_BLUE)
+                pixel[BLUE]  = b;
+              if (component_mask & GIMP_COMPONENT_MASK_ALPHA)
+                pixel[ALPHA] = a;
+            }
+          else
+            {
+              pixel[RED]   = r;
+              pixel[GREEN] = g;
+              pixel[BLUE]  = b;
+              pixel[ALPHA] = a;
+            }
+        }
+    }
+}
+
+static void
+gimp_mypaint_surface_render_tiles (gint                offset,
+                                   gint                size,
+                                   GimpMybrushSurface *surface)
+{
+  GimpComponentMask component_mask = surface->component_mask;
+  gboolean          no_erasing     = surface->options->no_erasing;
+  gint              i;
+
+  for (i = offset; i < offset + size; i++)
+    {
+      GimpMybrushSurfaceTile *tile = g_ptr_array_index (surface->batch_tiles,
+                                                        i);
+      gint                    j;
+
+      /*  the dabs are applied in the order they were drawn, so the
+       *  result doesn't depend on how the tiles are distributed
+       */
+      for (j = 0; j < surface->dabs->len; j++)
+        {
+          const GimpMybrushDab *dab = &g_array_index (surface->dabs,
+                                                      GimpMybrushDab, j);
+          GeglRectangle         roi;
+
+          if (gegl_rectangle_intersect (&roi, &dab->roi, &tile->rect))
+            {
+              gimp_mypaint_surface_render_dab (dab, tile, &roi,
+                                               component_mask, no_erasing);
+            }
+        }
+    }
+}
+
+static void
+gimp_mypaint_surface_flush_dabs (GimpMybrushSurface *surface)
+{
+  gint i;
+
+  if (surface->dabs->len == 0)
+    return;
+
+  for (i = 0; i < surface->dabs->len; i++)
+    {
+      const GimpMybrushDab *dab = &g_array_index (surface->dabs,
+                                                  GimpMybrushDab, i);
+      gint                  col1, col2;
+      gint                  row1, row2;
+      gint                  col, row;
+
+      col1 = (dab->roi.x - surface->extent.x) / TILE_SIZE;
+      row1 = (dab->roi.y - surface->extent.y) / TILE_SIZE;
+      col2 = (dab->roi.x + dab->roi.width  - 1 - surface->extent.x) / TILE_SIZE;
+      row2 = (dab->roi.y + dab->roi.height - 1 - surface->extent.y) / TILE_SIZE;
+
+      for (row = row1; row <= row2; row++)
+        {
+          for (col = col1; col <= col2; col++)
+            {
+              GimpMybrushSurfaceTile *tile;
+
+              tile = gimp_mypaint_surface_get_tile (surface, col, row);
+
+              if (! tile->queued)
+                {
+                  tile->queued = TRUE;
+                  g_ptr_array_add (surface->batch_tiles, tile);
+                }
+
+              if (! tile->dirty)
+                {
+                  tile->dirty = TRUE;
+                  g_ptr_array_add (surface->dirty_tiles, tile);
+                }
+            }
+        }
+    }
+
+  /*  the tiles don't overlap, so they can be painted concurrently  */
+  gegl_parallel_distribute_range (
+    surface->batch_tiles->len, 1,
+    (GeglParallelDistributeRangeFunc) gimp_mypaint_surface_render_tiles,
+    surface);
+
+  for (i = 0; i < surface->batch_tiles->len; i++)
+    {
+      GimpMybrushSurfaceTile *tile = g_ptr_array_index (surface->batch_tiles,
+                                                        i);
+
+      tile->queued = FALSE;
+    }
+
+  g_ptr_array_set_size (surface->batch_tiles, 0);
+  g_array_set_size (surface->dabs, 0);
+}
+
+static void
+gimp_mypaint_surface_write_tiles (GimpMybrushSurface *surface)
+{
+  gint i;
+
+  for (i = 0; i < surface->dirty_tiles->len; i++)
+    {
+      GimpMybrushSurfaceTile *tile = g_ptr_array_index (surface->dirty_tiles,
+                                                        i);
+
+      gegl_buffer_set (surface->buffer, &tile->rect, 0,
+                       babl_format ("R'G'B'A float"), tile->pixels,
+                       GEGL_AUTO_ROWSTRIDE);
+
+      tile->dirty = FALSE;
+    }
+
+  g_ptr_array_set_size (surface->dirty_tiles, 0);
+}
+
+static void
+gimp_mypaint_surface_trim_tiles (GimpMybrushSurface *surface)
+{
+  gint n_tiles = surface->n_tile_cols * surface->n_tile_rows;
+  gint i;
+
+  if (surface->n_cached_tiles <= MAX_CACHED_TILES)
+    return;
+
+  for (i = 0; i < n_tiles; i++)
+    {
+      GimpMybrushSurfaceTile *tile = surface->tiles[i];
+
+      if (tile && ! tile->dirty && tile->stamp != surface->stamp)
+        {
+          gimp_mypaint_surface_free_tile (tile);
+          surface->tiles[i] = NULL;
+
+          surface->n_cached_tiles--;
+        }
+    }
+}
+
 static void
 gimp_mypaint_surface_get_color (MyPaintSurface *base_surface,
                                 float           x,
@@ -240,7 +632,7 @@ gimp_mypaint_surface_get_color (MyPaintSurface *base_surface,
                                 float          *color_a)
 {
   GimpMybrushSurface *surface = (GimpMybrushSurface *)base_surface;
-  GeglRectangle dabRect;
+  GeglRectangle       dabRect;
 
   if (radius < 1.0f)
     radius = 1.0f;
@@ -252,65 +644,66 @@ gimp_mypaint_surface_get_color (MyPaintSurface *base_surface,
   *color_b = 0.0f;
   *color_a = 0.0f;
 
+  if (gegl_rectangle_is_empty (&surface->extent))
+    return;
+
+  /*  the color must include the dabs which are still queued  */
+  gimp_mypaint_surface_flush_dabs (surface);
+
   if (dabRect.width > 0 || dabRect.height > 0)
   {
+    const GeglRectangle *extent = &surface->extent;
     const float one_over_radius2 = 1.0f / (radius * radius);
     float sum_weight = 0.0f;
     float sum_r = 0.0f;
     float sum_g = 0.0f;
     float sum_b = 0.0f;
     float sum_a = 0.0f;
+    int iy, ix;
 
-     /* Read in clamp mode to avoid transparency bleeding in at the edges */
-    GeglBufferIterator *iter = gegl_buffer_iterator_new (surface->buffer, &dabRect, 0,
-                                                         babl_format ("R'aG'aB'aA float"),
-                                                         GEGL_BUFFER_READ,
-                                                         GEGL_ABYSS_CLAMP, 2);
-    if (surface->paint_mask)
+    for (iy = dabRect.y; iy < dabRect.y + dabRect.height; iy++)
       {
-        GeglRectangle mask_roi = dabRect;
-        mask_roi.x -= surface->paint_mask_x;
-        mask_roi.y -= surface->paint_mask_y;
-        gegl_buffer_iterator_add (iter, surface->paint_mask, &mask_roi, 0,
-                                  babl_format ("Y float"),
-                                  GEGL_ACCESS_READ, GEGL_ABYSS_NONE);
-      }
+        /* Clamp to the edges to avoid transparency bleeding in, the
+         * paint mask is sampled at the same clamped position */
+        int cy = CLAMP (iy, extent->y, extent->y + extent->height - 1);
+        int row = (cy - extent->y) / TILE_SIZE;
+        int col = -1;
+        float yy = (iy + 0.5f - y);
+        GimpMybrushSurfaceTile *tile = NULL;
+
+        for (ix = dabRect.x; ix < dabRect.x + dabRect.width; ix++)
+          {
+            /* pixel_weight == a standard dab with hardness = 0.5, aspect_ratio = 1.0, and angle = 0.0 */
+            int cx = CLAMP (ix, extent->x, extent->x + extent->width - 1);
+            float xx = (ix + 0.5f - x);
+            float rr = (yy * yy + xx * xx) * one_over_radius2;
+            float pixel_weight;
+            float *pixel;
+            int offset;
 
-    while (gegl_buffer_iterator_next (iter))
-      {
-        float *pixel = (float *)iter->items[0].data;
-        float *mask;
-        int iy, ix;
+            if (rr > 1.0f)
+              continue;
 
-        if (surface->paint_mask)
-          mask = iter->items[1].data;
-        else
-          mask = NULL;
+            pixel_weight = 1.0f - rr;
 
-        for (iy = iter->items[0].roi.y; iy < iter->items[0].roi.y + iter->items[0].roi.height; iy++)
-          {
-            float yy = (iy + 0.5f - y);
-            for (ix = iter->items[0].roi.x; ix < iter->items[0].roi.x +  iter->items[0].roi.width; ix++)
+            if ((cx - extent->x) / TILE_SIZE != col)
               {
-                /* pixel_weight == a standard dab with hardness = 0.5, aspect_ratio = 1.0, and angle = 0.0 */
-                float xx = (ix + 0.5f - x);
-                float rr = (yy * yy + xx * xx) * one_over_radius2;
-                float pixel_weight = 0.0f;
-                if (rr <= 1.0f)
-                  pixel_weight = 1.0f - rr;
-                if (mask)
-                  pixel_weight *= *mask;
-
-                sum_r += pixel_weight * pixel[RED];
-                sum_g += pixel_weight * pixel[GREEN];
-                sum_b += pixel_weight * pixel[BLUE];
-                sum_a += pixel_weight * pixel[ALPHA];
-                sum_weight += pixel_weight;
-
-                pixel += 4;
-                if (mask)
-                  mask += 1;
+                col  = (cx - extent->x) / TILE_SIZE;
+                tile = gimp_mypaint_surface_get_tile (surface, col, row);
               }
+
+            offset = (cy - tile->rect.y) * tile->rect.width +
+                     (cx - tile->rect.x);
+            pixel  = tile->pixels + 4 * offset;
+
+            if (tile->mask)
+              pixel_weight *= tile->mask[offset];
+
+            sum_r += pixel_weight * pixel[RED]   * pixel[ALPHA];
+            sum_g += pixel_weight * pixel[GREEN] * pixel[ALPHA];
+            sum_b += pixel_weight * pixel[BLUE]  * pixel[ALPHA];
+            sum_a += pixel_weight * pixel[ALPHA];
+            sum_weight += pixel_weight;
           }
       }
 
@@ -352,150 +745,53 @@ gimp_mypaint_surface_draw_dab (MyPaintSurface *base_surface,
                                float           colorize)
 {
   GimpMybrushSurface *surface = (GimpMybrushSurface *)base_surface;
-  GeglBufferIterator *iter;
+  GimpMybrushDab      dab;
   GeglRectangle       dabRect;
-  GimpComponentMask   component_mask = surface->component_mask;
 
-  const float one_over_radius2 = 1.0f / (radius * radius);
   const double angle_rad = angle / 360 * 2 * M_PI;
-  const float cs = cos(angle_rad);
-  const float sn = sin(angle_rad);
-  float normal_mode;
-  float segment1_slope;
-  float segment2_slope;
-  float r_aa_start;
-
-  hardness = CLAMP (hardness, 0.0f, 1.0f);
-  segment1_slope = -(1.0f / hardness - 1.0f);
-  segment2_slope = -hardness / (1.0f - hardness);
-  aspect_ratio = MAX (1.0f, aspect_ratio);
-
-  r_aa_start = radius - 1.0f;
-  r_aa_start = MAX (r_aa_start, 0);
-  r_aa_start = (r_aa_start * r_aa_start) / aspect_ratio;
-
-  normal_mode = opaque * (1.0f - colorize);
-  colorize = opaque * colorize;
 
   /* FIXME: This should use the real matrix values to trim aspect_ratio dabs */
   dabRect = calculate_dab_roi (x, y, radius);
-  gegl_rectangle_intersect (&dabRect, &dabRect, gegl_buffer_get_extent (surface->buffer));
+  gegl_rectangle_intersect (&dabRect, &dabRect, &surface->extent);
 
   if (dabRect.width <= 0 || dabRect.height <= 0)
     return 0;
 
   gegl_rectangle_bounding_box (&surface->dirty, &surface->dirty, &dabRect);
 
-  iter = gegl_buffer_iterator_new (surface->buffer, &dabRect, 0,
-                                   babl_format ("R'G'B'A float"),
-                                   GEGL_BUFFER_READWRITE,
-                                   GEGL_ABYSS_NONE, 2);
-  if (surface->paint_mask)
-    {
-      GeglRectangle mask_roi = dabRect;
-      mask_roi.x -= surface->paint_mask_x;
-      mask_roi.y -= surface->paint_mask_y;
-      gegl_buffer_iterator_add (iter, surface->paint_mask, &mask_roi, 0,
-                                babl_format ("Y float"),
-                                GEGL_ACCESS_READ, GEGL_ABYSS_NONE);
-    }
+  hardness = CLAMP (hardness, 0.0f, 1.0f);
+  aspect_ratio = MAX (1.0f, aspect_ratio);
 
-  while (gegl_buffer_iterator_next (iter))
+  dab.roi              = dabRect;
+  dab.x                = x;
+  dab.y                = y;
+  dab.radius           = radius;
+  dab.color_r          = color_r;
+  dab.color_g          = color_g;
+  dab.color_b          = color_b;
+  dab.color_a          = color_a;
+  dab.hardness         = hardness;
+  dab.aspect_ratio     = aspect_ratio;
+  dab.one_over_radius2 = 1.0f / (radius * radius);
+  dab.cs               = cos (angle_rad);
+  dab.sn               = sin (angle_rad);
+  dab.segment1_slope   = -(1.0f / hardness - 1.0f);
+  dab.segment2_slope   = -hardness / (1.0f - hardness);
+
+  dab.r_aa_start       = radius - 1.0f;
+  dab.r_aa_start       = MAX (dab.r_aa_start, 0);
+  dab.r_aa_start       = (dab.r_aa_start * dab.r_aa_start) / aspect_ratio;
+
+  dab.normal_mode      = opaque * (1.0f - colorize);
+  dab.colorize         = opaque * colorize;
+
+  g_array_append_val (surface->dabs, dab);
+
+  /*  dabs outside of an atomic block are painted right away  */
+  if (! surface->atomic)
     {
-      float *pixel = (float *)iter->items[0].data;
-      float *mask;
-      int iy, ix;
-
-      if (surface->paint_mask)
-        mask = iter->items[1].data;
-      else
-        mask = NULL;
-
-      for (iy = iter->items[0].roi.y; iy < iter->items[0].roi.y + iter->items[0].roi.height; iy++)
-        {
-          for (ix = iter->items[0].roi.x; ix < iter->items[0].roi.x +  iter->items[0].roi.width; ix++)
-            {
-              float rr, base_alpha, alpha, dst_alpha, r, g, b, a;
-              if (radius < 3.0f)
-                rr = calculate_rr_antialiased (ix, iy, x, y, aspect_ratio, sn, cs, one_over_radius2, r_aa_start);
-              else
-                rr = calculate_rr (ix, iy, x, y, aspect_ratio, sn, cs, one_over_radius2);
-              base_alpha = calculate_alpha_for_rr (rr, hardness, segment1_slope, segment2_slope);
-              alpha = base_alpha * normal_mode;
-              if (mask)
-                alpha *= *mask;
-              dst_alpha = pixel[ALPHA];
-              /* a = alpha * color_a + dst_alpha * (1.0f - alpha);
-               * which converts to: */
-              a = alpha * (color_a - dst_alpha) + dst_alpha;
-              r = pixel[RED];
-              g = pixel[GREEN];
-              b = pixel[BLUE];
-
-              if (a > 0.0f)
-                {
-                  /* By definition the ratio between each color[] and pixel[] component in a non-pre-multipled blend always sums to 1.0f.
-                   * Originally this would have been "(color[n] * alpha * color_a + pixel[n] * dst_alpha * (1.0f - alpha)) / a",
-                   * instead we only calculate the cheaper term. */
-                  float src_term = (alpha * color_a) / a;
-                  float dst_term = 1.0f - src_term;
-                  r = color_r * src_term + r * dst_term;
-                  g = color_g * src_term + g * dst_term;
-                  b = color_b * src_term + b * dst_term;
-                }
-
-              if (colorize > 0.0f && base_alpha > 0.0f)
-                {
-                  alpha = base_alpha * colorize;
-                  a = alpha + dst_alpha - alpha * dst_alpha;
-                  if (a > 0.0f)
-                    {
-                      GimpHSL pixel_hsl, out_hsl;
-                      GimpRGB pixel_rgb = {color_r, color_g, color_b};
-                      GimpRGB out_rgb   = {r, g, b};
-                      float src_term = alpha / a;
-                      float dst_term = 1.0f - src_term;
-
-                      gimp_rgb_to_hsl (&pixel_rgb, &pixel_hsl);
-                      gimp_rgb_to_hsl (&out_rgb, &out_hsl);
-
-                      out_hsl.h = pixel_hsl.h;
-                      out_hsl.s = pixel_hsl.s;
-                      gimp_hsl_to_rgb (&out_hsl, &out_rgb);
-
-                      r = (float)out_rgb.r * src_term + r * dst_term;
-                      g = (float)out_rgb.g * src_term + g * dst_term;
-                      b = (float)out_rgb.b * src_term + b * dst_term;
-                    }
-                }
-
-              if (surface->options->no_erasing)
-                a = MAX (a, pixel[ALPHA]);
-
-              if (component_mask != GIMP_COMPONENT_MASK_ALL)
-                {
-                  if (component_mask & GIMP_COMPONENT_MASK_RED)
-                    pixel[RED]   = r;
-                  if (component_mask & GIMP_COMPONENT_MASK_GREEN)
-                    pixel[GREEN] = g;
-                  if (component_mask & GIMP_COMPONENT_MASK_BLUE)
-                    pixel[BLUE]  = b;
-                  if (component_mask & GIMP_COMPONENT_MASK_ALPHA)
-                    pixel[ALPHA] = a;
-                }
-              else
-                {
-                  pixel[RED]   = r;
-                  pixel[GREEN] = g;
-                  pixel[BLUE]  = b;
-                  pixel[ALPHA] = a;
-                }
-
-              pixel += 4;
-              if (mask)
-                mask += 1;
-            }
-        }
+      gimp_mypaint_surface_flush_dabs (surface);
+      gimp_mypaint_surface_write_tiles (surface);
     }
 
   return 1;
@@ -504,7 +800,9 @@ gimp_mypaint_surface_draw_dab (MyPaintSurface *base_surface,
 static void
 gimp_mypaint_surface_begin_atomic (MyPaintSurface *base_surface)
 {
+  GimpMybrushSurface *surface = (GimpMybrushSurface *)base_surface;
 
+  surface->atomic++;
 }
 
 static void
@@ -513,6 +811,14 @@ gimp_mypaint_surface_end_atomic (MyPaintSurface   *base_surface,
 {
   GimpMybrushSurface *surface = (GimpMybrushSurface *)base_surface;
 
+  surface->atomic = MAX (surface->atomic - 1, 0);
+
+  gimp_mypaint_surface_flush_dabs (surface);
+  gimp_mypaint_surface_write_tiles (surface);
+  gimp_mypaint_surface_trim_tiles (surface);
+
+  surface->stamp++;
+
   roi->x         = surface->dirty.x;
   roi->y         = surface->dirty.y;
   roi->width     = surface->dirty.width;
@@ -524,6 +830,23 @@ static void
 gimp_mypaint_surface_destroy (MyPaintSurface *base_surface)
 {
   GimpMybrushSurface *surface = (GimpMybrushSurface *)base_surface;
+  gint                n_tiles = surface->n_tile_cols * surface->n_tile_rows;
+  gint                i;
+
+  /*  don't lose dabs which were drawn outside of end_atomic()  */
+  gimp_mypaint_surface_flush_dabs (surface);
+  gimp_mypaint_surface_write_tiles (surface);
+
+  for (i = 0; i < n_tiles; i++)
+    {
+      if (surface->tiles[i])
+        gimp_mypaint_surface_free_tile (surface->tiles[i]);
+    }
+
+  g_clear_pointer (&surface->tiles, g_free);
+  g_clear_pointer (&surface->dirty_tiles, g_ptr_array_unref);
+  g_clear_pointer (&surface->batch_tiles, g_ptr_array_unref);
+  g_clear_pointer (&surface->dabs, g_array_unref);
 
   g_clear_object (&surface->buffer);
   g_clear_object (&surface->paint_mask);
@@ -556,5 +879,18 @@ gimp_mypaint_surface_new (GeglBuffer         *buffer,
   surface->paint_mask_y         = paint_mask_y;
   surface->dirty                = *GEGL_RECTANGLE (0, 0, 0, 0);
 
+  surface->extent               = *gegl_buffer_get_extent (buffer);
+  surface->n_tile_cols          = (surface->extent.width  + TILE_SIZE - 1) /
+                                  TILE_SIZE;
+  surface->n_tile_rows          = (surface->extent.height + TILE_SIZE - 1) /
+                                  TILE_SIZE;
+  surface->tiles                = g_new0 (GimpMybrushSurfaceTile *,
+                                          surface->n_tile_cols *
+                                          surface->n_tile_rows);
+  surface->dirty_tiles          = g_ptr_array_new ();
+  surface->batch_tiles          = g_ptr_array_new ();
+  surface->dabs                 = g_array_new (FALSE, FALSE,
+                                               sizeof (GimpMybrushDab));
+
   return surface;
 }
@@ -63,6 +63,13 @@ static void gimp_plug_in_handle_tile_put         (GimpPlugIn      *plug_in,
                                                   GPTileReq       *request);
 static void gimp_plug_in_handle_tile_get         (GimpPlugIn      *plug_in,
                                                   GPTileReq       *request);
+static void gimp_plug_in_handle_tile_batch_request
+                                                 (GimpPlugIn      *plug_in,
+                                                  GPTileBatchReq  *request);
+static void gimp_plug_in_handle_tile_batch_put   (GimpPlugIn      *plug_in,
+                                                  GPTileBatchReq  *request);
+static void gimp_plug_in_handle_tile_batch_get   (GimpPlugIn      *plug_in,
+                                                  GPTileBatchReq  *request);
 static void gimp_plug_in_handle_proc_run         (GimpPlugIn      *plug_in,
                                                   GPProcRun       *proc_run);
 static void gimp_plug_in_handle_proc_return      (GimpPlugIn      *plug_in,
@@ -160,6 +167,19 @@ gimp_plug_in_handle_message (GimpPlugIn      *plug_in,
     case GP_HAS_INIT:
       gimp_plug_in_handle_has_init (plug_in);
       break;
+
+    case GP_TILE_BATCH_REQ:
+      gimp_plug_in_handle_tile_batch_request (plug_in, msg->data);
+      break;
+
+    case GP_TILE_BATCH_DATA:
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "Plug-in \"%s\"\n(%s)\n\n"
+                    "sent a TILE_BATCH_DATA message.  This should not happen.",
+                    gimp_object_get_name (plug_in),
+                    gimp_file_get_utf8_name (plug_in->file));
+      gimp_plug_in_close (plug_in, TRUE);
+      break;
     }
 }
 
@@ -172,93 +192,46 @@ gimp_plug_in_handle_quit (GimpPlugIn *plug_in)
   gimp_plug_in_close (plug_in, FALSE);
 }
 
-static void
-gimp_plug_in_handle_tile_request (GimpPlugIn *plug_in,
-                                  GPTileReq  *request)
+static GeglBuffer *
+gimp_plug_in_get_tile_buffer (GimpPlugIn  *plug_in,
+                              gint32       drawable_ID,
+                              gboolean     shadow,
+                              gboolean     write,
+                              const Babl **format)
 {
-  g_return_if_fail (request != NULL);
-
-  if (request->drawable_ID == -1)
-    gimp_plug_in_handle_tile_put (plug_in, request);
-  else
-    gimp_plug_in_handle_tile_get (plug_in, request);
-}
-
-static void
-gimp_plug_in_handle_tile_put (GimpPlugIn *plug_in,
-                              GPTileReq  *request)
-{
-  GPTileData       tile_data;
-  GPTileData      *tile_info;
-  GimpWireMessage  msg;
-  GimpDrawable    *drawable;
-  GeglBuffer      *buffer;
-  const Babl      *format;
-  GeglRectangle    tile_rect;
-
-  tile_data.drawable_ID = -1;
-  tile_data.tile_num    = 0;
-  tile_data.shadow      = 0;
-  tile_data.bpp         = 0;
-  tile_data.width       = 0;
-  tile_data.height      = 0;
-  tile_data.use_shm     = (plug_in->manager->shm != NULL);
-  tile_data.data        = NULL;
-
-  if (! gp_tile_data_write (plug_in->my_write, &tile_data, plug_in))
-    {
-      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
-                    "%s: ERROR", G_STRFUNC);
-      gimp_plug_in_close (plug_in, TRUE);
-      return;
-    }
-
-  if (! gimp_wire_read_msg (plug_in->my_read, &msg, plug_in))
-    {
-      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
-                    "%s: ERROR", G_STRFUNC);
-      gimp_plug_in_close (plug_in, TRUE);
-      return;
-    }
-
-  if (msg.type != GP_TILE_DATA)
-    {
-      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
-                    "expected tile data and received: %d", msg.type);
-      gimp_plug_in_close (plug_in, TRUE);
-      return;
-    }
-
-  tile_info = msg.data;
+  GimpDrawable *drawable;
+  GeglBuffer   *buffer;
 
   drawable = (GimpDrawable *) gimp_item_get_by_ID (plug_in->manager->gimp,
-                                                   tile_info->drawable_ID);
+                                                   drawable_ID);
 
   if (! GIMP_IS_DRAWABLE (drawable))
     {
       gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
                     "Plug-in \"%s\"\n(%s)\n\n"
-                    "tried writing to invalid drawable %d (killing)",
+                    "tried %s invalid drawable %d (killing)",
                     gimp_object_get_name (plug_in),
                     gimp_file_get_utf8_name (plug_in->file),
-                    tile_info->drawable_ID);
+                    write ? "writing to" : "reading from",
+                    drawable_ID);
       gimp_plug_in_close (plug_in, TRUE);
-      return;
+      return NULL;
     }
   else if (gimp_item_is_removed (GIMP_ITEM (drawable)))
     {
       gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
                     "Plug-in \"%s\"\n(%s)\n\n"
-                    "tried writing to drawable %d which was removed "
+                    "tried %s drawable %d which was removed "
                     "from the image (killing)",
                     gimp_object_get_name (plug_in),
                     gimp_file_get_utf8_name (plug_in->file),
-                    tile_info->drawable_ID);
+                    write ? "writing to" : "reading from",
+                    drawable_ID);
       gimp_plug_in_close (plug_in, TRUE);
-      return;
+      return NULL;
     }
 
-  if (tile_info->shadow)
+  if (shadow)
     {
 
       /*  don't check whether the drawable is a group or locked here,
@@ -272,37 +245,53 @@ gimp_plug_in_handle_tile_put (GimpPlugIn *plug_in,
     }
   else
     {
-      if (gimp_item_is_content_locked (GIMP_ITEM (drawable)))
+      if (write && gimp_item_is_content_locked (GIMP_ITEM (drawable)))
         {
           gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
                         "Plug-in \"%s\"\n(%s)\n\n"
                         "tried writing to a locked drawable %d (killing)",
                         gimp_object_get_name (plug_in),
                         gimp_file_get_utf8_name (plug_in->file),
-                        tile_info->drawable_ID);
+                        drawable_ID);
           gimp_plug_in_close (plug_in, TRUE);
-          return;
+          return NULL;
         }
-      else if (gimp_viewable_get_children (GIMP_VIEWABLE (drawable)))
+      else if (write && gimp_viewable_get_children (GIMP_VIEWABLE (drawable)))
         {
           gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
                         "Plug-in \"%s\"\n(%s)\n\n"
                         "tried writing to a group layer %d (killing)",
                         gimp_object_get_name (plug_in),
                         gimp_file_get_utf8_name (plug_in->file),
-                        tile_info->drawable_ID);
+                        drawable_ID);
           gimp_plug_in_close (plug_in, TRUE);
-          return;
+          return NULL;
         }
 
       buffer = gimp_drawable_get_buffer (drawable);
     }
 
+  *format = gegl_buffer_get_format (buffer);
+
+  if (! gimp_plug_in_precision_enabled (plug_in))
+    {
+      *format = gimp_babl_compat_u8_format (*format);
+    }
+
+  return buffer;
+}
+
+static gboolean
+gimp_plug_in_get_tile_rect (GimpPlugIn    *plug_in,
+                            GeglBuffer    *buffer,
+                            gint           tile_num,
+                            GeglRectangle *tile_rect)
+{
   if (! gimp_gegl_buffer_get_tile_rect (buffer,
                                         GIMP_PLUG_IN_TILE_WIDTH,
                                         GIMP_PLUG_IN_TILE_HEIGHT,
-                                        tile_info->tile_num,
-                                        &tile_rect))
+                                        tile_num,
+                                        tile_rect))
     {
       gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
                     "Plug-in \"%s\"\n(%s)\n\n"
@@ -310,14 +299,81 @@ gimp_plug_in_handle_tile_put (GimpPlugIn *plug_in,
                     gimp_object_get_name (plug_in),
                     gimp_file_get_utf8_name (plug_in->file));
       gimp_plug_in_close (plug_in, TRUE);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static void
+gimp_plug_in_handle_tile_request (GimpPlugIn *plug_in,
+                                  GPTileReq  *request)
+{
+  g_return_if_fail (request != NULL);
+
+  if (request->drawable_ID == -1)
+    gimp_plug_in_handle_tile_put (plug_in, request);
+  else
+    gimp_plug_in_handle_tile_get (plug_in, request);
+}
+
+static void
+gimp_plug_in_handle_tile_put (GimpPlugIn *plug_in,
+                              GPTileReq  *request)
+{
+  GPTileData       tile_data;
+  GPTileData      *tile_info;
+  GimpWireMessage  msg;
+  GeglBuffer      *buffer;
+  const Babl      *format;
+  GeglRectangle    tile_rect;
+
+  tile_data.drawable_ID = -1;
+  tile_data.tile_num    = 0;
+  tile_data.shadow      = 0;
+  tile_data.bpp         = 0;
+  tile_data.width       = 0;
+  tile_data.height      = 0;
+  tile_data.use_shm     = (plug_in->manager->shm != NULL);
+  tile_data.data        = NULL;
+
+  if (! gp_tile_data_write (plug_in->my_write, &tile_data, plug_in))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "%s: ERROR", G_STRFUNC);
+      gimp_plug_in_close (plug_in, TRUE);
       return;
     }
 
-  format = gegl_buffer_get_format (buffer);
+  if (! gimp_wire_read_msg (plug_in->my_read, &msg, plug_in))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "%s: ERROR", G_STRFUNC);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
 
-  if (! gimp_plug_in_precision_enabled (plug_in))
+  if (msg.type != GP_TILE_DATA)
     {
-      format = gimp_babl_compat_u8_format (format);
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "expected tile data and received: %d", msg.type);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+
+  tile_info = msg.data;
+
+  buffer = gimp_plug_in_get_tile_buffer (plug_in,
+                                         tile_info->drawable_ID,
+                                         tile_info->shadow,
+                                         TRUE, &format);
+
+  if (! buffer ||
+      ! gimp_plug_in_get_tile_rect (plug_in, buffer,
+                                    tile_info->tile_num, &tile_rect))
+    {
+      gimp_wire_destroy (&msg);
+      return;
     }
 
   if (tile_data.use_shm)
@@ -350,106 +406,312 @@ gimp_plug_in_handle_tile_get (GimpPlugIn *plug_in,
 {
   GPTileData       tile_data;
   GimpWireMessage  msg;
-  GimpDrawable    *drawable;
   GeglBuffer      *buffer;
   const Babl      *format;
   GeglRectangle    tile_rect;
   gint             tile_size;
 
-  drawable = (GimpDrawable *) gimp_item_get_by_ID (plug_in->manager->gimp,
-                                                   request->drawable_ID);
+  buffer = gimp_plug_in_get_tile_buffer (plug_in,
+                                         request->drawable_ID,
+                                         request->shadow,
+                                         FALSE, &format);
 
-  if (! GIMP_IS_DRAWABLE (drawable))
+  if (! buffer ||
+      ! gimp_plug_in_get_tile_rect (plug_in, buffer,
+                                    request->tile_num, &tile_rect))
+    {
+      return;
+    }
+
+  tile_size = (babl_format_get_bytes_per_pixel (format) *
+               tile_rect.width * tile_rect.height);
+
+  tile_data.drawable_ID = request->drawable_ID;
+  tile_data.tile_num    = request->tile_num;
+  tile_data.shadow      = request->shadow;
+  tile_data.bpp         = babl_format_get_bytes_per_pixel (format);
+  tile_data.width       = tile_rect.width;
+  tile_data.height      = tile_rect.height;
+  tile_data.use_shm     = (plug_in->manager->shm != NULL);
+
+  if (tile_data.use_shm)
+    {
+      gegl_buffer_get (buffer, &tile_rect, 1.0, format,
+                       gimp_plug_in_shm_get_addr (plug_in->manager->shm),
+                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+    }
+  else
+    {
+      tile_data.data = g_malloc (tile_size);
+
+      gegl_buffer_get (buffer, &tile_rect, 1.0, format,
+                       tile_data.data,
+                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+    }
+
+  if (! gp_tile_data_write (plug_in->my_write, &tile_data, plug_in))
     {
       gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
-                    "Plug-in \"%s\"\n(%s)\n\n"
-                    "tried reading from invalid drawable %d (killing)",
-                    gimp_object_get_name (plug_in),
-                    gimp_file_get_utf8_name (plug_in->file),
-                    request->drawable_ID);
+                    "%s: ERROR", G_STRFUNC);
       gimp_plug_in_close (plug_in, TRUE);
       return;
     }
-  else if (gimp_item_is_removed (GIMP_ITEM (drawable)))
+
+  if (! gimp_wire_read_msg (plug_in->my_read, &msg, plug_in))
     {
       gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
-                    "Plug-in \"%s\"\n(%s)\n\n"
-                    "tried reading from drawable %d which was removed "
-                    "from the image (killing)",
-                    gimp_object_get_name (plug_in),
-                    gimp_file_get_utf8_name (plug_in->file),
-                    request->drawable_ID);
+                    "%s: ERROR", G_STRFUNC);
       gimp_plug_in_close (plug_in, TRUE);
       return;
     }
 
-  if (request->shadow)
+  if (msg.type != GP_TILE_ACK)
     {
-      buffer = gimp_drawable_get_shadow_buffer (drawable);
-
-      gimp_plug_in_cleanup_add_shadow (plug_in, drawable);
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "expected tile ack and received: %d", msg.type);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
     }
+
+  gimp_wire_destroy (&msg);
+}
+
+static gsize
+gimp_plug_in_get_tile_batch_size (GimpPlugIn *plug_in)
+{
+  if (plug_in->manager->shm)
+    return gimp_plug_in_shm_get_size (plug_in->manager->shm);
+  else
+    return GP_TILE_BATCH_PIPE_SIZE;
+}
+
+static void
+gimp_plug_in_handle_tile_batch_request (GimpPlugIn     *plug_in,
+                                        GPTileBatchReq *request)
+{
+  g_return_if_fail (request != NULL);
+
+  if (request->drawable_ID == -1)
+    gimp_plug_in_handle_tile_batch_put (plug_in, request);
   else
+    gimp_plug_in_handle_tile_batch_get (plug_in, request);
+}
+
+static void
+gimp_plug_in_handle_tile_batch_put (GimpPlugIn     *plug_in,
+                                    GPTileBatchReq *request)
+{
+  GPTileBatchData  batch_data = { 0, };
+  GPTileBatchData *batch_info;
+  GimpWireMessage  msg;
+  GeglBuffer      *buffer;
+  const Babl      *format;
+  const guchar    *data;
+  gsize            offset = 0;
+  gint             bpp;
+  gint             i;
+
+  /*  tell the plug-in whether to use shared memory, and wait for the
+   *  tiles.  the shared memory segment is ours until we ack them.
+   */
+  batch_data.drawable_ID = -1;
+  batch_data.use_shm     = (plug_in->manager->shm != NULL);
+
+  if (! gp_tile_batch_data_write (plug_in->my_write, &batch_data, plug_in))
     {
-      buffer = gimp_drawable_get_buffer (drawable);
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "%s: ERROR", G_STRFUNC);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
     }
 
-  if (! gimp_gegl_buffer_get_tile_rect (buffer,
-                                        GIMP_PLUG_IN_TILE_WIDTH,
-                                        GIMP_PLUG_IN_TILE_HEIGHT,
-                                        request->tile_num,
-                                        &tile_rect))
+  if (! gimp_wire_read_msg (plug_in->my_read, &msg, plug_in))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "%s: ERROR", G_STRFUNC);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+
+  if (msg.type != GP_TILE_BATCH_DATA)
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "expected tile batch data and received: %d", msg.type);
+      gimp_wire_destroy (&msg);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+
+  batch_info = msg.data;
+
+  buffer = gimp_plug_in_get_tile_buffer (plug_in,
+                                         batch_info->drawable_ID,
+                                         batch_info->shadow,
+                                         TRUE, &format);
+
+  if (! buffer)
+    {
+      gimp_wire_destroy (&msg);
+      return;
+    }
+
+  bpp = babl_format_get_bytes_per_pixel (format);
+
+  if (batch_info->bpp    != bpp ||
+      batch_info->length >  gimp_plug_in_get_tile_batch_size (plug_in))
     {
       gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
                     "Plug-in \"%s\"\n(%s)\n\n"
-                    "requested invalid tile (killing)",
+                    "sent invalid tile batch (killing)",
                     gimp_object_get_name (plug_in),
                     gimp_file_get_utf8_name (plug_in->file));
+      gimp_wire_destroy (&msg);
       gimp_plug_in_close (plug_in, TRUE);
       return;
     }
 
-  format = gegl_buffer_get_format (buffer);
+  if (batch_data.use_shm)
+    data = gimp_plug_in_shm_get_addr (plug_in->manager->shm);
+  else
+    data = batch_info->data;
 
-  if (! gimp_plug_in_precision_enabled (plug_in))
+  for (i = 0; i < batch_info->n_tiles; i++)
     {
-      format = gimp_babl_compat_u8_format (format);
+      GeglRectangle tile_rect;
+      gsize         tile_size;
+
+      if (! gimp_plug_in_get_tile_rect (plug_in, buffer,
+                                        batch_info->tile_nums[i], &tile_rect))
+        {
+          gimp_wire_destroy (&msg);
+          return;
+        }
+
+      tile_size = (gsize) bpp * tile_rect.width * tile_rect.height;
+
+      if (offset + tile_size > batch_info->length)
+        {
+          gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                        "Plug-in \"%s\"\n(%s)\n\n"
+                        "sent truncated tile batch (killing)",
+                        gimp_object_get_name (plug_in),
+                        gimp_file_get_utf8_name (plug_in->file));
+          gimp_wire_destroy (&msg);
+          gimp_plug_in_close (plug_in, TRUE);
+          return;
+        }
+
+      gegl_buffer_set (buffer, &tile_rect, 0, format,
+                       data + offset,
+                       GEGL_AUTO_ROWSTRIDE);
+
+      offset += tile_size;
     }
 
-  tile_size = (babl_format_get_bytes_per_pixel (format) *
-               tile_rect.width * tile_rect.height);
+  gimp_wire_destroy (&msg);
 
-  tile_data.drawable_ID = request->drawable_ID;
-  tile_data.tile_num    = request->tile_num;
-  tile_data.shadow      = request->shadow;
-  tile_data.bpp         = babl_format_get_bytes_per_pixel (format);
-  tile_data.width       = tile_rect.width;
-  tile_data.height      = tile_rect.height;
-  tile_data.use_shm     = (plug_in->manager->shm != NULL);
+  if (! gp_tile_ack_write (plug_in->my_write, plug_in))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "%s: ERROR", G_STRFUNC);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+}
 
-  if (tile_data.use_shm)
+static void
+gimp_plug_in_handle_tile_batch_get (GimpPlugIn     *plug_in,
+                                    GPTileBatchReq *request)
+{
+  GPTileBatchData  batch_data = { 0, };
+  GimpWireMessage  msg;
+  GeglBuffer      *buffer;
+  const Babl      *format;
+  GeglRectangle   *tile_rects;
+  guchar          *data;
+  gsize            max_length;
+  gsize            length = 0;
+  gint             bpp;
+  gint             n_tiles;
+  gint             i;
+
+  buffer = gimp_plug_in_get_tile_buffer (plug_in,
+                                         request->drawable_ID,
+                                         request->shadow,
+                                         FALSE, &format);
+
+  if (! buffer)
+    return;
+
+  bpp        = babl_format_get_bytes_per_pixel (format);
+  max_length = gimp_plug_in_get_tile_batch_size (plug_in);
+  tile_rects = g_new (GeglRectangle, MAX (request->n_tiles, 1));
+
+  /*  send as many of the requested tiles as fit into one batch, the
+   *  plug-in asks again for the rest.
+   */
+  for (n_tiles = 0; n_tiles < request->n_tiles; n_tiles++)
     {
-      gegl_buffer_get (buffer, &tile_rect, 1.0, format,
-                       gimp_plug_in_shm_get_addr (plug_in->manager->shm),
-                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+      gsize tile_size;
+
+      if (! gimp_plug_in_get_tile_rect (plug_in, buffer,
+                                        request->tile_nums[n_tiles],
+                                        &tile_rects[n_tiles]))
+        {
+          g_free (tile_rects);
+          return;
+        }
+
+      tile_size = ((gsize) bpp *
+                   tile_rects[n_tiles].width * tile_rects[n_tiles].height);
+
+      if (length + tile_size > max_length)
+        break;
+
+      length += tile_size;
+    }
+
+  batch_data.drawable_ID = request->drawable_ID;
+  batch_data.shadow      = request->shadow;
+  batch_data.bpp         = bpp;
+  batch_data.n_tiles     = n_tiles;
+  batch_data.tile_nums   = request->tile_nums;
+  batch_data.use_shm     = (plug_in->manager->shm != NULL);
+  batch_data.length      = length;
+
+  if (batch_data.use_shm)
+    {
+      data = gimp_plug_in_shm_get_addr (plug_in->manager->shm);
     }
   else
     {
-      tile_data.data = g_malloc (tile_size);
+      batch_data.data = g_malloc (MAX (length, 1));
 
-      gegl_buffer_get (buffer, &tile_rect, 1.0, format,
-                       tile_data.data,
+      data = batch_data.data;
+    }
+
+  for (i = 0; i < n_tiles; i++)
+    {
+      gegl_buffer_get (buffer, &tile_rects[i], 1.0, format,
+                       data,
                        GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+      data += (gsize) bpp * tile_rects[i].width * tile_rects[i].height;
     }
 
-  if (! gp_tile_data_write (plug_in->my_write, &tile_data, plug_in))
+  g_free (tile_rects);
+
+  if (! gp_tile_batch_data_write (plug_in->my_write, &batch_data, plug_in))
     {
       gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
                     "%s: ERROR", G_STRFUNC);
+      g_free (batch_data.data);
       gimp_plug_in_close (plug_in, TRUE);
       return;
     }
 
+  g_free (batch_data.data);
+
   if (! gimp_wire_read_msg (plug_in->my_read, &msg, plug_in))
     {
       gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
@@ -462,6 +724,7 @@ gimp_plug_in_handle_tile_get (GimpPlugIn *plug_in,
     {
       gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
                     "expected tile ack and received: %d", msg.type);
+      gimp_wire_destroy (&msg);
       gimp_plug_in_close (plug_in, TRUE);
       return;
     }
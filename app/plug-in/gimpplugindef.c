@@ -67,6 +67,7 @@ gimp_plug_in_def_finalize (GObject *object)
   g_free (plug_in_def->locale_domain_path);
   g_free (plug_in_def->help_domain_name);
   g_free (plug_in_def->help_domain_uri);
+  g_free (plug_in_def->checksum);
 
   g_slist_free_full (plug_in_def->procedures, (GDestroyNotify) g_object_unref);
 
@@ -85,6 +86,7 @@ gimp_plug_in_def_get_memsize (GimpObject *object,
   memsize += gimp_string_get_memsize (plug_in_def->locale_domain_path);
   memsize += gimp_string_get_memsize (plug_in_def->help_domain_name);
   memsize += gimp_string_get_memsize (plug_in_def->help_domain_uri);
+  memsize += gimp_string_get_memsize (plug_in_def->checksum);
 
   memsize += gimp_g_slist_get_memsize (plug_in_def->procedures, 0);
 
@@ -216,6 +218,16 @@ gimp_plug_in_def_set_mtime (GimpPlugInDef *plug_in_def,
     }
 }
 
+void
+gimp_plug_in_def_set_checksum (GimpPlugInDef *plug_in_def,
+                               const gchar   *checksum)
+{
+  g_return_if_fail (GIMP_IS_PLUG_IN_DEF (plug_in_def));
+
+  g_free (plug_in_def->checksum);
+  plug_in_def->checksum = g_strdup (checksum);
+}
+
 void
 gimp_plug_in_def_set_needs_query (GimpPlugInDef *plug_in_def,
                                   gboolean       needs_query)
@@ -44,6 +44,7 @@ struct _GimpPlugInDef
   gchar      *help_domain_name;
   gchar      *help_domain_uri;
   gint64      mtime;
+  gchar      *checksum;     /* Content hash of the plug-in file          */
   gboolean    needs_query;  /* Does the plug-in need to be queried ?     */
   gboolean    has_init;     /* Does the plug-in need to be initialized ? */
 };
@@ -73,6 +74,8 @@ void   gimp_plug_in_def_set_help_domain   (GimpPlugInDef       *plug_in_def,
 
 void   gimp_plug_in_def_set_mtime         (GimpPlugInDef       *plug_in_def,
                                            gint64               mtime);
+void   gimp_plug_in_def_set_checksum      (GimpPlugInDef       *plug_in_def,
+                                           const gchar         *checksum);
 void   gimp_plug_in_def_set_needs_query   (GimpPlugInDef       *plug_in_def,
                                            gboolean             needs_query);
 void   gimp_plug_in_def_set_has_init      (GimpPlugInDef       *plug_in_def,
@@ -61,18 +61,44 @@ gimp_allow_set_foreground_window (GimpPlugIn *plug_in)
 #endif
 }
 
-/*  public functions  */
+static void
+gimp_plug_in_manager_call_get_pollfd (GimpPlugIn *plug_in,
+                                      GPollFD    *pollfd)
+{
+#ifdef G_OS_WIN32
+  g_io_channel_win32_make_pollfd (plug_in->my_read,
+                                  G_IO_IN | G_IO_PRI | G_IO_ERR | G_IO_HUP,
+                                  pollfd);
+#else
+  pollfd->fd      = g_io_channel_unix_get_fd (plug_in->my_read);
+  pollfd->events  = G_IO_IN | G_IO_PRI | G_IO_ERR | G_IO_HUP;
+  pollfd->revents = 0;
+#endif
+}
 
-void
-gimp_plug_in_manager_call_query (GimpPlugInManager *manager,
-                                 GimpContext       *context,
-                                 GimpPlugInDef     *plug_in_def)
+static void
+gimp_plug_in_manager_call_recv_message (GimpPlugIn *plug_in)
 {
-  GimpPlugIn *plug_in;
+  GimpWireMessage msg;
 
-  g_return_if_fail (GIMP_IS_PLUG_IN_MANAGER (manager));
-  g_return_if_fail (GIMP_IS_PDB_CONTEXT (context));
-  g_return_if_fail (GIMP_IS_PLUG_IN_DEF (plug_in_def));
+  if (! gimp_wire_read_msg (plug_in->my_read, &msg, plug_in))
+    {
+      gimp_plug_in_close (plug_in, TRUE);
+    }
+  else
+    {
+      gimp_plug_in_handle_message (plug_in, &msg);
+      gimp_wire_destroy (&msg);
+    }
+}
+
+static void
+gimp_plug_in_manager_call_sync (GimpPlugInManager  *manager,
+                                GimpContext        *context,
+                                GimpPlugInDef      *plug_in_def,
+                                GimpPlugInCallMode  call_mode)
+{
+  GimpPlugIn *plug_in;
 
   plug_in = gimp_plug_in_new (manager, context, NULL,
                               NULL, plug_in_def->file);
@@ -81,66 +107,156 @@ gimp_plug_in_manager_call_query (GimpPlugInManager *manager,
     {
       plug_in->plug_in_def = plug_in_def;
 
-      if (gimp_plug_in_open (plug_in, GIMP_PLUG_IN_CALL_QUERY, TRUE))
+      if (gimp_plug_in_open (plug_in, call_mode, TRUE))
         {
           while (plug_in->open)
-            {
-              GimpWireMessage msg;
-
-              if (! gimp_wire_read_msg (plug_in->my_read, &msg, plug_in))
-                {
-                  gimp_plug_in_close (plug_in, TRUE);
-                }
-              else
-                {
-                  gimp_plug_in_handle_message (plug_in, &msg);
-                  gimp_wire_destroy (&msg);
-                }
-            }
+            gimp_plug_in_manager_call_recv_message (plug_in);
         }
 
       g_object_unref (plug_in);
     }
 }
 
+
+/*  public functions  */
+
+void
+gimp_plug_in_manager_call_query (GimpPlugInManager *manager,
+                                 GimpContext       *context,
+                                 GimpPlugInDef     *plug_in_def)
+{
+  g_return_if_fail (GIMP_IS_PLUG_IN_MANAGER (manager));
+  g_return_if_fail (GIMP_IS_PDB_CONTEXT (context));
+  g_return_if_fail (GIMP_IS_PLUG_IN_DEF (plug_in_def));
+
+  gimp_plug_in_manager_call_sync (manager, context, plug_in_def,
+                                  GIMP_PLUG_IN_CALL_QUERY);
+}
+
 void
 gimp_plug_in_manager_call_init (GimpPlugInManager *manager,
                                 GimpContext       *context,
                                 GimpPlugInDef     *plug_in_def)
 {
-  GimpPlugIn *plug_in;
-
   g_return_if_fail (GIMP_IS_PLUG_IN_MANAGER (manager));
   g_return_if_fail (GIMP_IS_PDB_CONTEXT (context));
   g_return_if_fail (GIMP_IS_PLUG_IN_DEF (plug_in_def));
 
-  plug_in = gimp_plug_in_new (manager, context, NULL,
-                              NULL, plug_in_def->file);
+  gimp_plug_in_manager_call_sync (manager, context, plug_in_def,
+                                  GIMP_PLUG_IN_CALL_INIT);
+}
 
-  if (plug_in)
+void
+gimp_plug_in_manager_call_parallel (GimpPlugInManager  *manager,
+                                    GimpContext        *context,
+                                    GimpPlugInCallMode  call_mode,
+                                    GSList             *plug_in_defs,
+                                    gint                n_parallel,
+                                    GimpInitStatusFunc  status_callback)
+{
+  GPtrArray *running;
+  GArray    *pollfds;
+  GSList    *list;
+  gint       n_plug_ins;
+  gint       n_done = 0;
+
+  g_return_if_fail (GIMP_IS_PLUG_IN_MANAGER (manager));
+  g_return_if_fail (GIMP_IS_PDB_CONTEXT (context));
+  g_return_if_fail (call_mode == GIMP_PLUG_IN_CALL_QUERY ||
+                    call_mode == GIMP_PLUG_IN_CALL_INIT);
+  g_return_if_fail (status_callback != NULL);
+
+  n_parallel = MAX (n_parallel, 1);
+  n_plug_ins = g_slist_length (plug_in_defs);
+
+  running = g_ptr_array_new ();
+  pollfds = g_array_new (FALSE, TRUE, sizeof (GPollFD));
+
+  list = plug_in_defs;
+
+  while (list || running->len > 0)
     {
-      plug_in->plug_in_def = plug_in_def;
+      gint i;
 
-      if (gimp_plug_in_open (plug_in, GIMP_PLUG_IN_CALL_INIT, TRUE))
+      /*  keep up to n_parallel plug-ins running.  their messages are
+       *  still handled one at a time, from this thread, so the query()
+       *  and init() handlers don't need to know about each other.
+       */
+      while (list && (gint) running->len < n_parallel)
         {
-          while (plug_in->open)
+          GimpPlugInDef *plug_in_def = list->data;
+          GimpPlugIn    *plug_in;
+
+          list = g_slist_next (list);
+
+          if (manager->gimp->be_verbose)
+            g_print (call_mode == GIMP_PLUG_IN_CALL_QUERY ?
+                     "Querying plug-in: '%s'\n" :
+                     "Initializing plug-in: '%s'\n",
+                     gimp_file_get_utf8_name (plug_in_def->file));
+
+          plug_in = gimp_plug_in_new (manager, context, NULL,
+                                      NULL, plug_in_def->file);
+
+          if (plug_in)
             {
-              GimpWireMessage msg;
+              plug_in->plug_in_def = plug_in_def;
 
-              if (! gimp_wire_read_msg (plug_in->my_read, &msg, plug_in))
-                {
-                  gimp_plug_in_close (plug_in, TRUE);
-                }
-              else
+              if (gimp_plug_in_open (plug_in, call_mode, TRUE))
                 {
-                  gimp_plug_in_handle_message (plug_in, &msg);
-                  gimp_wire_destroy (&msg);
+                  g_ptr_array_add (running, plug_in);
+                  continue;
                 }
+
+              g_object_unref (plug_in);
             }
+
+          n_done++;
         }
 
-      g_object_unref (plug_in);
+      if (running->len == 0)
+        continue;
+
+      g_array_set_size (pollfds, running->len);
+
+      for (i = 0; i < running->len; i++)
+        {
+          gimp_plug_in_manager_call_get_pollfd (g_ptr_array_index (running, i),
+                                                &g_array_index (pollfds,
+                                                                GPollFD, i));
+        }
+
+      if (g_poll ((GPollFD *) pollfds->data, pollfds->len, -1) <= 0)
+        continue;
+
+      for (i = running->len - 1; i >= 0; i--)
+        {
+          GimpPlugIn *plug_in = g_ptr_array_index (running, i);
+
+          if (! g_array_index (pollfds, GPollFD, i).revents)
+            continue;
+
+          /*  a closed pipe makes the read fail, which closes the plug-in  */
+          gimp_plug_in_manager_call_recv_message (plug_in);
+
+          if (! plug_in->open)
+            {
+              gchar *basename;
+
+              basename =
+                g_path_get_basename (gimp_file_get_utf8_name (plug_in->file));
+              status_callback (NULL, basename,
+                               (gdouble) ++n_done / (gdouble) n_plug_ins);
+              g_free (basename);
+
+              g_ptr_array_remove_index (running, i);
+              g_object_unref (plug_in);
+            }
+        }
     }
+
+  g_array_free (pollfds, TRUE);
+  g_ptr_array_free (running, TRUE);
 }
 
 GimpValueArray *
@@ -229,6 +345,8 @@ gimp_plug_in_manager_call_run (GimpPlugInManager   *manager,
       config.tile_cache_size  = gegl_config->tile_cache_size;
       config.swap_path        = gegl_config->swap_path;
       config.num_processors   = gegl_config->num_processors;
+      config.shm_size         = (manager->shm ?
+                                 gimp_plug_in_shm_get_size (manager->shm) : 0);
 
       proc_run.name    = GIMP_PROCEDURE (procedure)->original_name;
       proc_run.nparams = gimp_value_array_length (args);
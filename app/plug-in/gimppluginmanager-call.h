@@ -37,6 +37,16 @@ void             gimp_plug_in_manager_call_init     (GimpPlugInManager      *man
                                                      GimpContext            *context,
                                                      GimpPlugInDef          *plug_in_def);
 
+/*  Call the query() or init() functions of a list of plug-ins,
+ *  running up to @n_parallel of them at the same time
+ */
+void             gimp_plug_in_manager_call_parallel (GimpPlugInManager      *manager,
+                                                     GimpContext            *context,
+                                                     GimpPlugInCallMode      call_mode,
+                                                     GSList                 *plug_in_defs,
+                                                     gint                    n_parallel,
+                                                     GimpInitStatusFunc      status_callback);
+
 /*  Run a plug-in as if it were a procedure database procedure
  */
 GimpValueArray * gimp_plug_in_manager_call_run      (GimpPlugInManager      *manager,
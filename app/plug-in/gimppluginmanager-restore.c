@@ -46,6 +46,7 @@
 #include "gimppluginmanager-locale-domain.h"
 #include "gimppluginmanager-restore.h"
 #include "gimppluginprocedure.h"
+#include "plug-in-cache.h"
 #include "plug-in-rc.h"
 
 #include "gimp-intl.h"
@@ -56,9 +57,14 @@ static void    gimp_plug_in_manager_search            (GimpPlugInManager    *man
 static void    gimp_plug_in_manager_search_directory  (GimpPlugInManager    *manager,
                                                        GFile                *directory);
 static GFile * gimp_plug_in_manager_get_pluginrc      (GimpPlugInManager    *manager);
+static GFile * gimp_plug_in_manager_get_plug_in_cache (GFile                *pluginrc);
 static void    gimp_plug_in_manager_read_pluginrc     (GimpPlugInManager    *manager,
                                                        GFile                *file,
+                                                       GFile                *cache,
                                                        GimpInitStatusFunc    status_callback);
+static void    gimp_plug_in_manager_write_pluginrc    (GimpPlugInManager    *manager,
+                                                       GFile                *file,
+                                                       GFile                *cache);
 static void    gimp_plug_in_manager_query_new         (GimpPlugInManager    *manager,
                                                        GimpContext          *context,
                                                        GimpInitStatusFunc    status_callback);
@@ -74,6 +80,7 @@ static void    gimp_plug_in_manager_add_from_file     (GimpPlugInManager    *man
                                                        guint64               mtime);
 static void    gimp_plug_in_manager_add_from_rc       (GimpPlugInManager    *manager,
                                                        GimpPlugInDef        *plug_in_def);
+static gchar * gimp_plug_in_manager_get_checksum      (GFile                *file);
 static void    gimp_plug_in_manager_add_to_db         (GimpPlugInManager    *manager,
                                                        GimpContext          *context,
                                                        GimpPlugInProcedure  *proc);
@@ -91,8 +98,8 @@ gimp_plug_in_manager_restore (GimpPlugInManager  *manager,
 {
   Gimp   *gimp;
   GFile  *pluginrc;
+  GFile  *cache;
   GSList *list;
-  GError *error = NULL;
 
   g_return_if_fail (GIMP_IS_PLUG_IN_MANAGER (manager));
   g_return_if_fail (GIMP_IS_CONTEXT (context));
@@ -106,10 +113,12 @@ gimp_plug_in_manager_restore (GimpPlugInManager  *manager,
   /* search for binaries in the plug-in directory path */
   gimp_plug_in_manager_search (manager, status_callback);
 
-  /* read the pluginrc file for cached data */
+  /* read the plug-in cache, or the pluginrc file, for cached data */
   pluginrc = gimp_plug_in_manager_get_pluginrc (manager);
+  cache    = gimp_plug_in_manager_get_plug_in_cache (pluginrc);
 
-  gimp_plug_in_manager_read_pluginrc (manager, pluginrc, status_callback);
+  gimp_plug_in_manager_read_pluginrc (manager, pluginrc, cache,
+                                      status_callback);
 
   /* query any plug-ins that changed since we last wrote out pluginrc */
   gimp_plug_in_manager_query_new (manager, context, status_callback);
@@ -129,22 +138,15 @@ gimp_plug_in_manager_restore (GimpPlugInManager  *manager,
         }
     }
 
-  /* write the pluginrc file if necessary */
+  /* write the pluginrc file and the plug-in cache if necessary */
   if (manager->write_pluginrc)
     {
-      if (gimp->be_verbose)
-        g_print ("Writing '%s'\n", gimp_file_get_utf8_name (pluginrc));
-
-      if (! plug_in_rc_write (manager->plug_in_defs, pluginrc, &error))
-        {
-          gimp_message_literal (gimp,
-                                NULL, GIMP_MESSAGE_ERROR, error->message);
-          g_clear_error (&error);
-        }
+      gimp_plug_in_manager_write_pluginrc (manager, pluginrc, cache);
 
       manager->write_pluginrc = FALSE;
     }
 
+  g_object_unref (cache);
   g_object_unref (pluginrc);
 
   /* create locale and help domain lists */
@@ -383,10 +385,32 @@ gimp_plug_in_manager_get_pluginrc (GimpPlugInManager *manager)
   return pluginrc;
 }
 
-/* read the pluginrc file for cached data */
+/* the binary plug-in cache lives next to pluginrc */
+static GFile *
+gimp_plug_in_manager_get_plug_in_cache (GFile *pluginrc)
+{
+  GFile *parent = g_file_get_parent (pluginrc);
+  GFile *cache;
+  gchar *basename;
+  gchar *name;
+
+  basename = g_file_get_basename (pluginrc);
+  name     = g_strconcat (basename, ".cache", NULL);
+
+  cache = g_file_get_child (parent, name);
+
+  g_free (name);
+  g_free (basename);
+  g_object_unref (parent);
+
+  return cache;
+}
+
+/* read the plug-in cache, or the pluginrc file, for cached data */
 static void
 gimp_plug_in_manager_read_pluginrc (GimpPlugInManager  *manager,
                                     GFile              *pluginrc,
+                                    GFile              *cache,
                                     GimpInitStatusFunc  status_callback)
 {
   GSList *rc_defs;
@@ -396,9 +420,27 @@ gimp_plug_in_manager_read_pluginrc (GimpPlugInManager  *manager,
                    gimp_file_get_utf8_name (pluginrc), 0.0);
 
   if (manager->gimp->be_verbose)
-    g_print ("Parsing '%s'\n", gimp_file_get_utf8_name (pluginrc));
+    g_print ("Reading '%s'\n", gimp_file_get_utf8_name (cache));
+
+  rc_defs = plug_in_cache_read (manager->gimp, cache, pluginrc, &error);
 
-  rc_defs = plug_in_rc_parse (manager->gimp, pluginrc, &error);
+  if (! rc_defs)
+    {
+      /*  fall back to the text pluginrc, e.g. when the cache was
+       *  written by another version, and write a fresh cache
+       */
+      if (error && manager->gimp->be_verbose)
+        g_print ("%s\n", error->message);
+
+      g_clear_error (&error);
+
+      if (manager->gimp->be_verbose)
+        g_print ("Parsing '%s'\n", gimp_file_get_utf8_name (pluginrc));
+
+      rc_defs = plug_in_rc_parse (manager->gimp, pluginrc, &error);
+
+      manager->write_pluginrc = TRUE;
+    }
 
   if (rc_defs)
     {
@@ -419,6 +461,56 @@ gimp_plug_in_manager_read_pluginrc (GimpPlugInManager  *manager,
     }
 }
 
+static void
+gimp_plug_in_manager_write_pluginrc (GimpPlugInManager *manager,
+                                     GFile             *pluginrc,
+                                     GFile             *cache)
+{
+  Gimp   *gimp  = manager->gimp;
+  GSList *list;
+  GError *error = NULL;
+
+  /* plug-ins read from an old cache, or from pluginrc, may lack a
+   * checksum, compute it once so it can be compared on later starts
+   */
+  for (list = manager->plug_in_defs; list; list = list->next)
+    {
+      GimpPlugInDef *plug_in_def = list->data;
+
+      if (! plug_in_def->checksum && plug_in_def->procedures)
+        {
+          plug_in_def->checksum =
+            gimp_plug_in_manager_get_checksum (plug_in_def->file);
+        }
+    }
+
+  if (gimp->be_verbose)
+    g_print ("Writing '%s'\n", gimp_file_get_utf8_name (pluginrc));
+
+  if (! plug_in_rc_write (manager->plug_in_defs, pluginrc, &error))
+    {
+      gimp_message_literal (gimp,
+                            NULL, GIMP_MESSAGE_ERROR, error->message);
+      g_clear_error (&error);
+
+      /*  the cache is only valid along with the pluginrc it was
+       *  written with, keep the old pair rather than a mismatched one
+       */
+      return;
+    }
+
+  if (gimp->be_verbose)
+    g_print ("Writing '%s'\n", gimp_file_get_utf8_name (cache));
+
+  if (! plug_in_cache_write (manager->plug_in_defs, cache, pluginrc,
+                             &error))
+    {
+      gimp_message_literal (gimp,
+                            NULL, GIMP_MESSAGE_ERROR, error->message);
+      g_clear_error (&error);
+    }
+}
+
 /* query any plug-ins that changed since we last wrote out pluginrc */
 static void
 gimp_plug_in_manager_query_new (GimpPlugInManager  *manager,
@@ -426,45 +518,43 @@ gimp_plug_in_manager_query_new (GimpPlugInManager  *manager,
                                 GimpInitStatusFunc  status_callback)
 {
   GSList *list;
-  gint    n_plugins;
+  GSList *query_defs = NULL;
 
   status_callback (_("Querying new Plug-ins"), "", 0.0);
 
-  for (list = manager->plug_in_defs, n_plugins = 0; list; list = list->next)
+  for (list = manager->plug_in_defs; list; list = list->next)
     {
       GimpPlugInDef *plug_in_def = list->data;
 
       if (plug_in_def->needs_query)
-        n_plugins++;
+        query_defs = g_slist_prepend (query_defs, plug_in_def);
     }
 
-  if (n_plugins)
+  if (query_defs)
     {
-      gint nth;
-
       manager->write_pluginrc = TRUE;
 
-      for (list = manager->plug_in_defs, nth = 0; list; list = list->next)
-        {
-          GimpPlugInDef *plug_in_def = list->data;
-
-          if (plug_in_def->needs_query)
-            {
-              gchar *basename;
+      query_defs = g_slist_reverse (query_defs);
 
-              basename =
-                g_path_get_basename (gimp_file_get_utf8_name (plug_in_def->file));
-              status_callback (NULL, basename,
-                               (gdouble) nth++ / (gdouble) n_plugins);
-              g_free (basename);
+      gimp_plug_in_manager_call_parallel (manager, context,
+                                          GIMP_PLUG_IN_CALL_QUERY,
+                                          query_defs,
+                                          GIMP_GEGL_CONFIG (manager->gimp->config)->num_processors,
+                                          status_callback);
 
-              if (manager->gimp->be_verbose)
-                g_print ("Querying plug-in: '%s'\n",
-                         gimp_file_get_utf8_name (plug_in_def->file));
+      /* the checksum of a plug-in is computed after querying it, if
+       * it is replaced meanwhile, it is simply queried again next time
+       */
+      for (list = query_defs; list; list = list->next)
+        {
+          GimpPlugInDef *plug_in_def = list->data;
 
-              gimp_plug_in_manager_call_query (manager, context, plug_in_def);
-            }
+          if (! plug_in_def->checksum)
+            plug_in_def->checksum =
+              gimp_plug_in_manager_get_checksum (plug_in_def->file);
         }
+
+      g_slist_free (query_defs);
     }
 
   status_callback (NULL, "", 1.0);
@@ -477,43 +567,29 @@ gimp_plug_in_manager_init_plug_ins (GimpPlugInManager  *manager,
                                     GimpInitStatusFunc  status_callback)
 {
   GSList *list;
-  gint    n_plugins;
+  GSList *init_defs = NULL;
 
   status_callback (_("Initializing Plug-ins"), "", 0.0);
 
-  for (list = manager->plug_in_defs, n_plugins = 0; list; list = list->next)
+  for (list = manager->plug_in_defs; list; list = list->next)
     {
       GimpPlugInDef *plug_in_def = list->data;
 
       if (plug_in_def->has_init)
-        n_plugins++;
+        init_defs = g_slist_prepend (init_defs, plug_in_def);
     }
 
-  if (n_plugins)
+  if (init_defs)
     {
-      gint nth;
+      init_defs = g_slist_reverse (init_defs);
 
-      for (list = manager->plug_in_defs, nth = 0; list; list = list->next)
-        {
-          GimpPlugInDef *plug_in_def = list->data;
+      gimp_plug_in_manager_call_parallel (manager, context,
+                                          GIMP_PLUG_IN_CALL_INIT,
+                                          init_defs,
+                                          GIMP_GEGL_CONFIG (manager->gimp->config)->num_processors,
+                                          status_callback);
 
-          if (plug_in_def->has_init)
-            {
-              gchar *basename;
-
-              basename =
-                g_path_get_basename (gimp_file_get_utf8_name (plug_in_def->file));
-              status_callback (NULL, basename,
-                               (gdouble) nth++ / (gdouble) n_plugins);
-              g_free (basename);
-
-              if (manager->gimp->be_verbose)
-                g_print ("Initializing plug-in: '%s'\n",
-                         gimp_file_get_utf8_name (plug_in_def->file));
-
-              gimp_plug_in_manager_call_init (manager, context, plug_in_def);
-            }
-        }
+      g_slist_free (init_defs);
     }
 
   status_callback (NULL, "", 1.0);
@@ -773,9 +849,36 @@ gimp_plug_in_manager_add_from_rc (GimpPlugInManager *manager,
 
       if (! strcmp (basename1, basename2))
         {
+          gboolean unchanged = FALSE;
+
           if (g_file_equal (plug_in_def->file,
-                            ondisk_plug_in_def->file) &&
-              (plug_in_def->mtime == ondisk_plug_in_def->mtime))
+                            ondisk_plug_in_def->file))
+            {
+              if (plug_in_def->mtime == ondisk_plug_in_def->mtime)
+                {
+                  unchanged = TRUE;
+                }
+              else if (plug_in_def->checksum)
+                {
+                  /* the file was touched, only hash it if it was,
+                   * so unchanged plug-ins are never read
+                   */
+                  ondisk_plug_in_def->checksum =
+                    gimp_plug_in_manager_get_checksum (ondisk_plug_in_def->file);
+
+                  if (! g_strcmp0 (plug_in_def->checksum,
+                                   ondisk_plug_in_def->checksum))
+                    {
+                      gimp_plug_in_def_set_mtime (plug_in_def,
+                                                  ondisk_plug_in_def->mtime);
+
+                      manager->write_pluginrc = TRUE;
+                      unchanged = TRUE;
+                    }
+                }
+            }
+
+          if (unchanged)
             {
               /* Use pluginrc entry, deleting on-disk entry */
               list->data = plug_in_def;
@@ -811,6 +914,34 @@ gimp_plug_in_manager_add_from_rc (GimpPlugInManager *manager,
   g_object_unref (plug_in_def);
 }
 
+static gchar *
+gimp_plug_in_manager_get_checksum (GFile *file)
+{
+  GMappedFile *mapped;
+  gchar       *path;
+  gchar       *checksum;
+
+  path = g_file_get_path (file);
+
+  if (! path)
+    return NULL;
+
+  mapped = g_mapped_file_new (path, FALSE, NULL);
+  g_free (path);
+
+  if (! mapped)
+    return NULL;
+
+  checksum =
+    g_compute_checksum_for_data (G_CHECKSUM_SHA256,
+                                 (const guchar *) g_mapped_file_get_contents (mapped),
+                                 g_mapped_file_get_length (mapped));
+
+  g_mapped_file_unref (mapped);
+
+  return checksum;
+}
+
 
 static void
 gimp_plug_in_manager_add_to_db (GimpPlugInManager   *manager,
@@ -254,7 +254,7 @@ gimp_plug_in_manager_initialize (GimpPlugInManager  *manager,
    *  we'll fall back on sending the data over the pipe.
    */
   if (manager->gimp->use_shm)
-    manager->shm = gimp_plug_in_shm_new ();
+    manager->shm = gimp_plug_in_shm_new (config->plug_in_shm_size);
 
   manager->debug = gimp_plug_in_debug_new ();
 }
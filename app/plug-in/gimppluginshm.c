@@ -80,6 +80,7 @@ struct _GimpPlugInShm
 {
   gint    shm_ID;
   guchar *shm_addr;
+  gsize   shm_size;
 
 #if defined(USE_WIN32_SHM)
   HANDLE  shm_handle;
@@ -88,7 +89,7 @@ struct _GimpPlugInShm
 
 
 GimpPlugInShm *
-gimp_plug_in_shm_new (void)
+gimp_plug_in_shm_new (gsize size)
 {
   /* allocate a piece of shared memory for use in transporting tiles
    *  to plug-ins. if we can't allocate a piece of shared memory then
@@ -99,11 +100,16 @@ gimp_plug_in_shm_new (void)
 
   shm->shm_ID = -1;
 
+  /*  the segment must hold at least one tile of the widest format,
+   *  round it to a whole number of such tiles.
+   */
+  shm->shm_size = MAX (size / TILE_MAP_SIZE, 1) * TILE_MAP_SIZE;
+
 #if defined(USE_SYSV_SHM)
 
   /* Use SysV shared memory mechanisms for transferring tile data. */
   {
-    shm->shm_ID = shmget (IPC_PRIVATE, TILE_MAP_SIZE, IPC_CREAT | 0600);
+    shm->shm_ID = shmget (IPC_PRIVATE, shm->shm_size, IPC_CREAT | 0600);
 
     if (shm->shm_ID != -1)
       {
@@ -145,7 +151,7 @@ gimp_plug_in_shm_new (void)
     /* Create the file mapping into paging space */
     shm->shm_handle = CreateFileMapping (INVALID_HANDLE_VALUE, NULL,
                                          PAGE_READWRITE, 0,
-                                         TILE_MAP_SIZE,
+                                         shm->shm_size,
                                          fileMapName);
 
     if (shm->shm_handle)
@@ -153,7 +159,7 @@ gimp_plug_in_shm_new (void)
         /* Map the shared memory into our address space for use */
         shm->shm_addr = (guchar *) MapViewOfFile (shm->shm_handle,
                                                   FILE_MAP_ALL_ACCESS,
-                                                  0, 0, TILE_MAP_SIZE);
+                                                  0, 0, shm->shm_size);
 
         /* Verify that we mapped our view */
         if (shm->shm_addr)
@@ -192,10 +198,10 @@ gimp_plug_in_shm_new (void)
 
     if (shm_fd != -1)
       {
-        if (ftruncate (shm_fd, TILE_MAP_SIZE) != -1)
+        if (ftruncate (shm_fd, shm->shm_size) != -1)
           {
             /* Map the shared memory into our address space for use */
-            shm->shm_addr = (guchar *) mmap (NULL, TILE_MAP_SIZE,
+            shm->shm_addr = (guchar *) mmap (NULL, shm->shm_size,
                                              PROT_READ | PROT_WRITE, MAP_SHARED,
                                              shm_fd, 0);
 
@@ -238,7 +244,8 @@ gimp_plug_in_shm_new (void)
     }
   else
     {
-      GIMP_LOG (SHM, "attached shared memory segment ID = %d", shm->shm_ID);
+      GIMP_LOG (SHM, "attached shared memory segment ID = %d, size = %"
+                G_GSIZE_FORMAT, shm->shm_ID, shm->shm_size);
     }
 
   return shm;
@@ -269,7 +276,7 @@ gimp_plug_in_shm_free (GimpPlugInShm *shm)
 
       gchar shm_handle[32];
 
-      munmap (shm->shm_addr, TILE_MAP_SIZE);
+      munmap (shm->shm_addr, shm->shm_size);
 
       g_snprintf (shm_handle, sizeof (shm_handle), "/gimp-shm-%d",
                   shm->shm_ID);
@@ -299,3 +306,11 @@ gimp_plug_in_shm_get_addr (GimpPlugInShm *shm)
 
   return shm->shm_addr;
 }
+
+gsize
+gimp_plug_in_shm_get_size (GimpPlugInShm *shm)
+{
+  g_return_val_if_fail (shm != NULL, 0);
+
+  return shm->shm_size;
+}
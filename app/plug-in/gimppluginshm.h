@@ -21,11 +21,12 @@
 #define __GIMP_PLUG_IN_SHM_H__
 
 
-GimpPlugInShm * gimp_plug_in_shm_new      (void);
+GimpPlugInShm * gimp_plug_in_shm_new      (gsize          size);
 void            gimp_plug_in_shm_free     (GimpPlugInShm *shm);
 
 gint            gimp_plug_in_shm_get_ID   (GimpPlugInShm *shm);
 guchar        * gimp_plug_in_shm_get_addr (GimpPlugInShm *shm);
+gsize           gimp_plug_in_shm_get_size (GimpPlugInShm *shm);
 
 
 #endif /* __GIMP_PLUG_IN_SHM_H__ */
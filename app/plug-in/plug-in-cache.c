@@ -0,0 +1,894 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * plug-in-cache.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*  The plug-in cache is a binary version of pluginrc.  It is a single
+ *  serialized GVariant, which is memory-mapped and read in place, so
+ *  restoring the plug-ins doesn't need to tokenize anything.  It is
+ *  written in the host's byte order; a cache written on a machine
+ *  with a different byte order fails the magic number check and is
+ *  simply regenerated.
+ *
+ *  The cache records the modification time and size of the pluginrc
+ *  it was written along with, and is only used as long as pluginrc is
+ *  unchanged, so that editing or removing pluginrc still takes effect.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include <gegl.h>
+
+#include "libgimpbase/gimpbase.h"
+#include "libgimpbase/gimpprotocol.h"
+#include "libgimpconfig/gimpconfig.h"
+
+#include "plug-in-types.h"
+
+#include "core/gimp.h"
+
+#include "pdb/gimp-pdb-compat.h"
+
+#include "gimpplugindef.h"
+#include "gimppluginprocedure.h"
+#include "plug-in-cache.h"
+
+#include "gimp-intl.h"
+
+
+#define PLUG_IN_CACHE_MAGIC        0x47504943 /* 'GPIC' */
+#define PLUG_IN_CACHE_FILE_VERSION 2
+
+#define PLUG_IN_CACHE_ARG_TYPE     "(iayay)"
+#define PLUG_IN_CACHE_PROC_TYPE    "(ayiayayayayayayaayiaybayayayiaybbayay" \
+                                   "a" PLUG_IN_CACHE_ARG_TYPE               \
+                                   "a" PLUG_IN_CACHE_ARG_TYPE ")"
+#define PLUG_IN_CACHE_DEF_TYPE     "(ayxayayayayayb"                         \
+                                   "a" PLUG_IN_CACHE_PROC_TYPE ")"
+#define PLUG_IN_CACHE_TYPE         "(uuuxta" PLUG_IN_CACHE_DEF_TYPE ")"
+
+
+enum
+{
+  CACHE_MAGIC,
+  CACHE_PROTOCOL_VERSION,
+  CACHE_FILE_VERSION,
+  CACHE_PLUGINRC_MTIME,
+  CACHE_PLUGINRC_SIZE,
+  CACHE_PLUG_IN_DEFS,
+  N_CACHE_FIELDS
+};
+
+enum
+{
+  DEF_PATH,
+  DEF_MTIME,
+  DEF_CHECKSUM,
+  DEF_LOCALE_DOMAIN_NAME,
+  DEF_LOCALE_DOMAIN_PATH,
+  DEF_HELP_DOMAIN_NAME,
+  DEF_HELP_DOMAIN_URI,
+  DEF_HAS_INIT,
+  DEF_PROCEDURES,
+  N_DEF_FIELDS
+};
+
+enum
+{
+  PROC_NAME,
+  PROC_TYPE,
+  PROC_BLURB,
+  PROC_HELP,
+  PROC_AUTHOR,
+  PROC_COPYRIGHT,
+  PROC_DATE,
+  PROC_MENU_LABEL,
+  PROC_MENU_PATHS,
+  PROC_ICON_TYPE,
+  PROC_ICON_DATA,
+  PROC_FILE_PROC,
+  PROC_EXTENSIONS,
+  PROC_PREFIXES,
+  PROC_MAGICS,
+  PROC_PRIORITY,
+  PROC_MIME_TYPES,
+  PROC_HANDLES_URI,
+  PROC_HANDLES_RAW,
+  PROC_THUMB_LOADER,
+  PROC_IMAGE_TYPES,
+  PROC_ARGS,
+  PROC_VALUES,
+  N_PROC_FIELDS
+};
+
+enum
+{
+  ARG_TYPE,
+  ARG_NAME,
+  ARG_DESC,
+  N_ARG_FIELDS
+};
+
+
+static gboolean              plug_in_cache_query_pluginrc   (GFile               *pluginrc,
+                                                             gint64              *mtime,
+                                                             guint64             *size,
+                                                             GError             **error);
+
+static GimpPlugInDef       * plug_in_cache_def_deserialize  (Gimp                *gimp,
+                                                             GVariant            *variant);
+static GimpPlugInProcedure * plug_in_cache_proc_deserialize (Gimp                *gimp,
+                                                             GFile               *file,
+                                                             GVariant            *variant);
+static void                  plug_in_cache_args_deserialize (Gimp                *gimp,
+                                                             GimpProcedure       *procedure,
+                                                             GVariant            *variant,
+                                                             gboolean             return_values);
+
+static GVariant            * plug_in_cache_def_serialize    (GimpPlugInDef       *plug_in_def);
+static GVariant            * plug_in_cache_proc_serialize   (GimpPlugInProcedure *proc);
+static GVariant            * plug_in_cache_args_serialize   (GParamSpec         **pspecs,
+                                                             gint                 n_pspecs);
+
+static GVariant            * plug_in_cache_string_new       (const gchar         *str);
+static gchar               * plug_in_cache_get_string       (GVariant            *tuple,
+                                                             gint                 field);
+static gint                  plug_in_cache_get_int          (GVariant            *tuple,
+                                                             gint                 field);
+static gboolean              plug_in_cache_get_boolean      (GVariant            *tuple,
+                                                             gint                 field);
+
+
+GSList *
+plug_in_cache_read (Gimp    *gimp,
+                    GFile   *file,
+                    GFile   *pluginrc,
+                    GError **error)
+{
+  GMappedFile *mapped;
+  GBytes      *bytes;
+  GVariant    *cache;
+  GVariant    *defs;
+  GSList      *plug_in_defs = NULL;
+  gchar       *path;
+  GError      *my_error     = NULL;
+  gint64       pluginrc_mtime;
+  guint64      pluginrc_size;
+  gint64       cache_mtime;
+  guint64      cache_size;
+  gsize        n_defs;
+  gsize        i;
+
+  g_return_val_if_fail (GIMP_IS_GIMP (gimp), NULL);
+  g_return_val_if_fail (G_IS_FILE (file), NULL);
+  g_return_val_if_fail (G_IS_FILE (pluginrc), NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  /*  without pluginrc, the cache is stale by definition  */
+  if (! plug_in_cache_query_pluginrc (pluginrc,
+                                      &pluginrc_mtime, &pluginrc_size,
+                                      &my_error))
+    {
+      g_set_error (error, GIMP_CONFIG_ERROR, GIMP_CONFIG_ERROR_VERSION,
+                   _("Skipping '%s': %s"),
+                   gimp_file_get_utf8_name (file), my_error->message);
+      g_clear_error (&my_error);
+
+      return NULL;
+    }
+
+  path = g_file_get_path (file);
+
+  if (! path)
+    {
+      g_set_error (error, GIMP_CONFIG_ERROR, GIMP_CONFIG_ERROR_OPEN,
+                   _("Could not open '%s' for reading: %s"),
+                   gimp_file_get_utf8_name (file), "not a local file");
+      return NULL;
+    }
+
+  mapped = g_mapped_file_new (path, FALSE, &my_error);
+  g_free (path);
+
+  if (! mapped)
+    {
+      g_set_error (error, GIMP_CONFIG_ERROR,
+                   g_error_matches (my_error,
+                                    G_FILE_ERROR, G_FILE_ERROR_NOENT) ?
+                   GIMP_CONFIG_ERROR_OPEN_ENOENT : GIMP_CONFIG_ERROR_OPEN,
+                   _("Could not open '%s' for reading: %s"),
+                   gimp_file_get_utf8_name (file), my_error->message);
+      g_clear_error (&my_error);
+
+      return NULL;
+    }
+
+  bytes = g_mapped_file_get_bytes (mapped);
+  g_mapped_file_unref (mapped);
+
+  /*  GVariant never reads outside of the serialized data, so a
+   *  truncated or otherwise broken file yields default values rather
+   *  than a crash; those are caught by the checks below.
+   */
+  cache = g_variant_new_from_bytes (G_VARIANT_TYPE (PLUG_IN_CACHE_TYPE),
+                                    bytes, FALSE);
+  g_variant_ref_sink (cache);
+  g_bytes_unref (bytes);
+
+  if ((guint32) plug_in_cache_get_int (cache, CACHE_MAGIC) !=
+      PLUG_IN_CACHE_MAGIC)
+    {
+      g_set_error (error, GIMP_CONFIG_ERROR, GIMP_CONFIG_ERROR_PARSE,
+                   _("Skipping '%s': not a plug-in cache."),
+                   gimp_file_get_utf8_name (file));
+      goto out;
+    }
+
+  if (plug_in_cache_get_int (cache, CACHE_PROTOCOL_VERSION) !=
+      GIMP_PROTOCOL_VERSION)
+    {
+      g_set_error (error, GIMP_CONFIG_ERROR, GIMP_CONFIG_ERROR_VERSION,
+                   _("Skipping '%s': wrong GIMP protocol version."),
+                   gimp_file_get_utf8_name (file));
+      goto out;
+    }
+
+  if (plug_in_cache_get_int (cache, CACHE_FILE_VERSION) !=
+      PLUG_IN_CACHE_FILE_VERSION)
+    {
+      g_set_error (error, GIMP_CONFIG_ERROR, GIMP_CONFIG_ERROR_VERSION,
+                   _("Skipping '%s': wrong plug-in cache format version."),
+                   gimp_file_get_utf8_name (file));
+      goto out;
+    }
+
+  g_variant_get_child (cache, CACHE_PLUGINRC_MTIME, "x", &cache_mtime);
+  g_variant_get_child (cache, CACHE_PLUGINRC_SIZE,  "t", &cache_size);
+
+  if (cache_mtime != pluginrc_mtime || cache_size != pluginrc_size)
+    {
+      g_set_error (error, GIMP_CONFIG_ERROR, GIMP_CONFIG_ERROR_VERSION,
+                   _("Skipping '%s': '%s' has changed."),
+                   gimp_file_get_utf8_name (file),
+                   gimp_file_get_utf8_name (pluginrc));
+      goto out;
+    }
+
+  defs   = g_variant_get_child_value (cache, CACHE_PLUG_IN_DEFS);
+  n_defs = g_variant_n_children (defs);
+
+  for (i = 0; i < n_defs; i++)
+    {
+      GVariant      *variant = g_variant_get_child_value (defs, i);
+      GimpPlugInDef *plug_in_def;
+
+      plug_in_def = plug_in_cache_def_deserialize (gimp, variant);
+
+      g_variant_unref (variant);
+
+      if (! plug_in_def)
+        {
+          g_set_error (error, GIMP_CONFIG_ERROR, GIMP_CONFIG_ERROR_PARSE,
+                       _("Skipping '%s': the plug-in cache is corrupt."),
+                       gimp_file_get_utf8_name (file));
+
+          g_slist_free_full (plug_in_defs, (GDestroyNotify) g_object_unref);
+          plug_in_defs = NULL;
+          break;
+        }
+
+      plug_in_defs = g_slist_prepend (plug_in_defs, plug_in_def);
+    }
+
+  g_variant_unref (defs);
+
+ out:
+  g_variant_unref (cache);
+
+  return g_slist_reverse (plug_in_defs);
+}
+
+/*  must be called after 'pluginrc' was written, the cache is tied to
+ *  its current modification time and size
+ */
+gboolean
+plug_in_cache_write (GSList  *plug_in_defs,
+                     GFile   *file,
+                     GFile   *pluginrc,
+                     GError **error)
+{
+  GVariantBuilder  builder;
+  GVariant        *cache;
+  GSList          *list;
+  GError          *my_error = NULL;
+  gint64           pluginrc_mtime;
+  guint64          pluginrc_size;
+  gboolean         success;
+
+  g_return_val_if_fail (G_IS_FILE (file), FALSE);
+  g_return_val_if_fail (G_IS_FILE (pluginrc), FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  if (! plug_in_cache_query_pluginrc (pluginrc,
+                                      &pluginrc_mtime, &pluginrc_size,
+                                      &my_error))
+    {
+      g_set_error (error, GIMP_CONFIG_ERROR, GIMP_CONFIG_ERROR_WRITE,
+                   _("Error writing '%s': %s"),
+                   gimp_file_get_utf8_name (file), my_error->message);
+      g_clear_error (&my_error);
+
+      return FALSE;
+    }
+
+  g_variant_builder_init (&builder,
+                          G_VARIANT_TYPE ("a" PLUG_IN_CACHE_DEF_TYPE));
+
+  for (list = plug_in_defs; list; list = g_slist_next (list))
+    {
+      GimpPlugInDef *plug_in_def = list->data;
+      GVariant      *variant;
+
+      if (! plug_in_def->procedures)
+        continue;
+
+      variant = plug_in_cache_def_serialize (plug_in_def);
+
+      if (variant)
+        g_variant_builder_add_value (&builder, variant);
+    }
+
+  cache = g_variant_new ("(uuuxt@a" PLUG_IN_CACHE_DEF_TYPE ")",
+                         (guint32) PLUG_IN_CACHE_MAGIC,
+                         (guint32) GIMP_PROTOCOL_VERSION,
+                         (guint32) PLUG_IN_CACHE_FILE_VERSION,
+                         pluginrc_mtime,
+                         pluginrc_size,
+                         g_variant_builder_end (&builder));
+  g_variant_ref_sink (cache);
+
+  /*  g_file_replace_contents() writes to a temporary file and renames
+   *  it, so a cache which is currently mapped is never modified
+   */
+  success = g_file_replace_contents (file,
+                                     g_variant_get_data (cache),
+                                     g_variant_get_size (cache),
+                                     NULL, FALSE, G_FILE_CREATE_NONE,
+                                     NULL, NULL, &my_error);
+
+  if (! success)
+    {
+      g_set_error (error, GIMP_CONFIG_ERROR, GIMP_CONFIG_ERROR_WRITE,
+                   _("Error writing '%s': %s"),
+                   gimp_file_get_utf8_name (file), my_error->message);
+      g_clear_error (&my_error);
+    }
+
+  g_variant_unref (cache);
+
+  return success;
+}
+
+
+/*  private functions  */
+
+static gboolean
+plug_in_cache_query_pluginrc (GFile    *pluginrc,
+                              gint64   *mtime,
+                              guint64  *size,
+                              GError  **error)
+{
+  GFileInfo *info;
+
+  info = g_file_query_info (pluginrc,
+                            G_FILE_ATTRIBUTE_TIME_MODIFIED ","
+                            G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC ","
+                            G_FILE_ATTRIBUTE_STANDARD_SIZE,
+                            G_FILE_QUERY_INFO_NONE,
+                            NULL, error);
+
+  if (! info)
+    return FALSE;
+
+  *mtime = (gint64) g_file_info_get_attribute_uint64 (
+                      info, G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC +
+           g_file_info_get_attribute_uint32 (
+             info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+  *size  = g_file_info_get_size (info);
+
+  g_object_unref (info);
+
+  return TRUE;
+}
+
+static GimpPlugInDef *
+plug_in_cache_def_deserialize (Gimp     *gimp,
+                               GVariant *variant)
+{
+  GimpPlugInDef *plug_in_def;
+  GVariant      *procs;
+  GFile         *file;
+  gchar         *path;
+  gchar         *domain_name;
+  gchar         *domain_path;
+  gchar         *expanded_path = NULL;
+  gint64         mtime;
+  gsize          n_procs;
+  gsize          i;
+
+  path = plug_in_cache_get_string (variant, DEF_PATH);
+
+  if (! (path && *path))
+    {
+      g_free (path);
+      return NULL;
+    }
+
+  file = gimp_file_new_for_config_path (path, NULL);
+  g_free (path);
+
+  if (! file)
+    return NULL;
+
+  plug_in_def = gimp_plug_in_def_new (file);
+  g_object_unref (file);
+
+  g_variant_get_child (variant, DEF_MTIME, "x", &mtime);
+  plug_in_def->mtime = mtime;
+
+  plug_in_def->checksum = plug_in_cache_get_string (variant, DEF_CHECKSUM);
+
+  procs   = g_variant_get_child_value (variant, DEF_PROCEDURES);
+  n_procs = g_variant_n_children (procs);
+
+  for (i = 0; i < n_procs; i++)
+    {
+      GVariant            *proc_variant = g_variant_get_child_value (procs, i);
+      GimpPlugInProcedure *proc;
+
+      proc = plug_in_cache_proc_deserialize (gimp, plug_in_def->file,
+                                             proc_variant);
+
+      g_variant_unref (proc_variant);
+
+      if (! proc)
+        {
+          g_variant_unref (procs);
+          g_object_unref (plug_in_def);
+
+          return NULL;
+        }
+
+      gimp_plug_in_def_add_procedure (plug_in_def, proc);
+      g_object_unref (proc);
+    }
+
+  g_variant_unref (procs);
+
+  domain_name = plug_in_cache_get_string (variant, DEF_LOCALE_DOMAIN_NAME);
+  domain_path = plug_in_cache_get_string (variant, DEF_LOCALE_DOMAIN_PATH);
+
+  if (domain_path)
+    expanded_path = gimp_config_path_expand (domain_path, TRUE, NULL);
+
+  if (domain_name)
+    gimp_plug_in_def_set_locale_domain (plug_in_def,
+                                        domain_name, expanded_path);
+
+  g_free (domain_name);
+  g_free (domain_path);
+  g_free (expanded_path);
+
+  domain_name = plug_in_cache_get_string (variant, DEF_HELP_DOMAIN_NAME);
+  domain_path = plug_in_cache_get_string (variant, DEF_HELP_DOMAIN_URI);
+
+  if (domain_name)
+    gimp_plug_in_def_set_help_domain (plug_in_def, domain_name, domain_path);
+
+  g_free (domain_name);
+  g_free (domain_path);
+
+  gimp_plug_in_def_set_has_init (plug_in_def,
+                                 plug_in_cache_get_boolean (variant,
+                                                            DEF_HAS_INIT));
+
+  return plug_in_def;
+}
+
+static GimpPlugInProcedure *
+plug_in_cache_proc_deserialize (Gimp     *gimp,
+                                GFile    *file,
+                                GVariant *variant)
+{
+  GimpProcedure       *procedure;
+  GimpPlugInProcedure *proc;
+  GVariant            *child;
+  GEnumClass          *enum_class;
+  gchar               *str;
+  gint                 proc_type;
+  gint                 icon_type;
+  gsize                n_children;
+  gsize                i;
+
+  str       = plug_in_cache_get_string (variant, PROC_NAME);
+  proc_type = plug_in_cache_get_int (variant, PROC_TYPE);
+
+  if (! (str && *str) ||
+      (proc_type != GIMP_PLUGIN && proc_type != GIMP_EXTENSION))
+    {
+      g_free (str);
+      return NULL;
+    }
+
+  icon_type  = plug_in_cache_get_int (variant, PROC_ICON_TYPE);
+  enum_class = g_type_class_ref (GIMP_TYPE_ICON_TYPE);
+
+  if (! g_enum_get_value (enum_class, icon_type))
+    {
+      g_type_class_unref (enum_class);
+      g_free (str);
+      return NULL;
+    }
+
+  g_type_class_unref (enum_class);
+
+  procedure = gimp_plug_in_procedure_new (proc_type, file);
+  proc      = GIMP_PLUG_IN_PROCEDURE (procedure);
+
+  gimp_object_take_name (GIMP_OBJECT (procedure),
+                         gimp_canonicalize_identifier (str));
+
+  procedure->original_name = str;
+
+  procedure->blurb     = plug_in_cache_get_string (variant, PROC_BLURB);
+  procedure->help      = plug_in_cache_get_string (variant, PROC_HELP);
+  procedure->author    = plug_in_cache_get_string (variant, PROC_AUTHOR);
+  procedure->copyright = plug_in_cache_get_string (variant, PROC_COPYRIGHT);
+  procedure->date      = plug_in_cache_get_string (variant, PROC_DATE);
+  proc->menu_label     = plug_in_cache_get_string (variant, PROC_MENU_LABEL);
+
+  child      = g_variant_get_child_value (variant, PROC_MENU_PATHS);
+  n_children = g_variant_n_children (child);
+
+  for (i = 0; i < n_children; i++)
+    {
+      gchar *menu_path = plug_in_cache_get_string (child, i);
+
+      if (menu_path)
+        proc->menu_paths = g_list_append (proc->menu_paths, menu_path);
+    }
+
+  g_variant_unref (child);
+
+  switch (icon_type)
+    {
+    case GIMP_ICON_TYPE_ICON_NAME:
+    case GIMP_ICON_TYPE_IMAGE_FILE:
+      str = plug_in_cache_get_string (variant, PROC_ICON_DATA);
+
+      if (str)
+        gimp_plug_in_procedure_take_icon (proc, icon_type,
+                                          (guint8 *) str, -1);
+      break;
+
+    case GIMP_ICON_TYPE_INLINE_PIXBUF:
+      {
+        const guint8 *data;
+        gsize         length;
+
+        child = g_variant_get_child_value (variant, PROC_ICON_DATA);
+        data  = g_variant_get_fixed_array (child, &length, sizeof (guint8));
+
+        if (length > 0)
+          gimp_plug_in_procedure_set_icon (proc, icon_type, data, length);
+
+        g_variant_unref (child);
+      }
+      break;
+    }
+
+  if (plug_in_cache_get_boolean (variant, PROC_FILE_PROC))
+    {
+      proc->file_proc  = TRUE;
+      proc->extensions = plug_in_cache_get_string (variant, PROC_EXTENSIONS);
+      proc->prefixes   = plug_in_cache_get_string (variant, PROC_PREFIXES);
+      proc->magics     = plug_in_cache_get_string (variant, PROC_MAGICS);
+
+      gimp_plug_in_procedure_set_priority (proc,
+                                           plug_in_cache_get_int (variant,
+                                                                  PROC_PRIORITY));
+
+      str = plug_in_cache_get_string (variant, PROC_MIME_TYPES);
+      if (str)
+        gimp_plug_in_procedure_set_mime_types (proc, str);
+      g_free (str);
+
+      if (plug_in_cache_get_boolean (variant, PROC_HANDLES_URI))
+        gimp_plug_in_procedure_set_handles_uri (proc);
+
+      if (plug_in_cache_get_boolean (variant, PROC_HANDLES_RAW))
+        gimp_plug_in_procedure_set_handles_raw (proc);
+
+      str = plug_in_cache_get_string (variant, PROC_THUMB_LOADER);
+      if (str)
+        gimp_plug_in_procedure_set_thumb_loader (proc, str);
+      g_free (str);
+    }
+
+  str = plug_in_cache_get_string (variant, PROC_IMAGE_TYPES);
+  gimp_plug_in_procedure_set_image_types (proc, str);
+  g_free (str);
+
+  child = g_variant_get_child_value (variant, PROC_ARGS);
+  plug_in_cache_args_deserialize (gimp, procedure, child, FALSE);
+  g_variant_unref (child);
+
+  child = g_variant_get_child_value (variant, PROC_VALUES);
+  plug_in_cache_args_deserialize (gimp, procedure, child, TRUE);
+  g_variant_unref (child);
+
+  return proc;
+}
+
+static void
+plug_in_cache_args_deserialize (Gimp          *gimp,
+                                GimpProcedure *procedure,
+                                GVariant      *variant,
+                                gboolean       return_values)
+{
+  gsize n_args = g_variant_n_children (variant);
+  gsize i;
+
+  for (i = 0; i < n_args; i++)
+    {
+      GVariant   *arg = g_variant_get_child_value (variant, i);
+      GParamSpec *pspec;
+      gchar      *name;
+      gchar      *desc;
+
+      name = plug_in_cache_get_string (arg, ARG_NAME);
+      desc = plug_in_cache_get_string (arg, ARG_DESC);
+
+      pspec = gimp_pdb_compat_param_spec (gimp,
+                                          plug_in_cache_get_int (arg, ARG_TYPE),
+                                          name, desc);
+
+      if (return_values)
+        gimp_procedure_add_return_value (procedure, pspec);
+      else
+        gimp_procedure_add_argument (procedure, pspec);
+
+      g_free (name);
+      g_free (desc);
+
+      g_variant_unref (arg);
+    }
+}
+
+static GVariant *
+plug_in_cache_def_serialize (GimpPlugInDef *plug_in_def)
+{
+  GVariant        *fields[N_DEF_FIELDS];
+  GVariantBuilder  procs;
+  GSList          *list;
+  gchar           *path;
+
+  path = gimp_file_get_config_path (plug_in_def->file, NULL);
+  if (! path)
+    return NULL;
+
+  fields[DEF_PATH]     = plug_in_cache_string_new (path);
+  fields[DEF_MTIME]    = g_variant_new_int64 (plug_in_def->mtime);
+  fields[DEF_CHECKSUM] = plug_in_cache_string_new (plug_in_def->checksum);
+
+  g_free (path);
+
+  fields[DEF_LOCALE_DOMAIN_NAME] =
+    plug_in_cache_string_new (plug_in_def->locale_domain_name);
+
+  path = NULL;
+  if (plug_in_def->locale_domain_name && plug_in_def->locale_domain_path)
+    path = gimp_config_path_unexpand (plug_in_def->locale_domain_path,
+                                      TRUE, NULL);
+
+  fields[DEF_LOCALE_DOMAIN_PATH] = plug_in_cache_string_new (path);
+  g_free (path);
+
+  fields[DEF_HELP_DOMAIN_NAME] =
+    plug_in_cache_string_new (plug_in_def->help_domain_name);
+  fields[DEF_HELP_DOMAIN_URI] =
+    plug_in_cache_string_new (plug_in_def->help_domain_name ?
+                              plug_in_def->help_domain_uri : NULL);
+
+  fields[DEF_HAS_INIT] = g_variant_new_boolean (plug_in_def->has_init);
+
+  g_variant_builder_init (&procs,
+                          G_VARIANT_TYPE ("a" PLUG_IN_CACHE_PROC_TYPE));
+
+  for (list = plug_in_def->procedures; list; list = g_slist_next (list))
+    {
+      GimpPlugInProcedure *proc = list->data;
+
+      if (proc->installed_during_init)
+        continue;
+
+      g_variant_builder_add_value (&procs,
+                                   plug_in_cache_proc_serialize (proc));
+    }
+
+  fields[DEF_PROCEDURES] = g_variant_builder_end (&procs);
+
+  return g_variant_new_tuple (fields, N_DEF_FIELDS);
+}
+
+static GVariant *
+plug_in_cache_proc_serialize (GimpPlugInProcedure *proc)
+{
+  GimpProcedure   *procedure = GIMP_PROCEDURE (proc);
+  GVariant        *fields[N_PROC_FIELDS];
+  GVariantBuilder  menu_paths;
+  GList           *list;
+
+  fields[PROC_NAME]       = plug_in_cache_string_new (procedure->original_name);
+  fields[PROC_TYPE]       = g_variant_new_int32 (procedure->proc_type);
+  fields[PROC_BLURB]      = plug_in_cache_string_new (procedure->blurb);
+  fields[PROC_HELP]       = plug_in_cache_string_new (procedure->help);
+  fields[PROC_AUTHOR]     = plug_in_cache_string_new (procedure->author);
+  fields[PROC_COPYRIGHT]  = plug_in_cache_string_new (procedure->copyright);
+  fields[PROC_DATE]       = plug_in_cache_string_new (procedure->date);
+  fields[PROC_MENU_LABEL] = plug_in_cache_string_new (proc->menu_label);
+
+  g_variant_builder_init (&menu_paths, G_VARIANT_TYPE ("aay"));
+
+  for (list = proc->menu_paths; list; list = g_list_next (list))
+    g_variant_builder_add_value (&menu_paths,
+                                 plug_in_cache_string_new (list->data));
+
+  fields[PROC_MENU_PATHS] = g_variant_builder_end (&menu_paths);
+
+  fields[PROC_ICON_TYPE] = g_variant_new_int32 (proc->icon_type);
+
+  switch (proc->icon_type)
+    {
+    case GIMP_ICON_TYPE_ICON_NAME:
+    case GIMP_ICON_TYPE_IMAGE_FILE:
+      fields[PROC_ICON_DATA] =
+        plug_in_cache_string_new ((const gchar *) proc->icon_data);
+      break;
+
+    case GIMP_ICON_TYPE_INLINE_PIXBUF:
+    default:
+      fields[PROC_ICON_DATA] =
+        g_variant_new_fixed_array (G_VARIANT_TYPE_BYTE,
+                                   proc->icon_data,
+                                   proc->icon_data ?
+                                   MAX (proc->icon_data_length, 0) : 0,
+                                   sizeof (guint8));
+      break;
+    }
+
+  fields[PROC_FILE_PROC]    = g_variant_new_boolean (proc->file_proc);
+  fields[PROC_EXTENSIONS]   = plug_in_cache_string_new (proc->extensions);
+  fields[PROC_PREFIXES]     = plug_in_cache_string_new (proc->prefixes);
+  fields[PROC_MAGICS]       = plug_in_cache_string_new (proc->magics);
+  fields[PROC_PRIORITY]     = g_variant_new_int32 (proc->priority);
+  fields[PROC_MIME_TYPES]   = plug_in_cache_string_new (proc->mime_types);
+  fields[PROC_HANDLES_URI]  = g_variant_new_boolean (proc->handles_uri);
+  fields[PROC_HANDLES_RAW]  = g_variant_new_boolean (proc->handles_raw &&
+                                                     ! proc->image_types);
+  fields[PROC_THUMB_LOADER] = plug_in_cache_string_new (proc->thumb_loader);
+  fields[PROC_IMAGE_TYPES]  = plug_in_cache_string_new (proc->image_types);
+
+  fields[PROC_ARGS]   = plug_in_cache_args_serialize (procedure->args,
+                                                      procedure->num_args);
+  fields[PROC_VALUES] = plug_in_cache_args_serialize (procedure->values,
+                                                      procedure->num_values);
+
+  return g_variant_new_tuple (fields, N_PROC_FIELDS);
+}
+
+static GVariant *
+plug_in_cache_args_serialize (GParamSpec **pspecs,
+                              gint         n_pspecs)
+{
+  GVariantBuilder builder;
+  gint            i;
+
+  g_variant_builder_init (&builder,
+                          G_VARIANT_TYPE ("a" PLUG_IN_CACHE_ARG_TYPE));
+
+  for (i = 0; i < n_pspecs; i++)
+    {
+      GParamSpec *pspec = pspecs[i];
+      GVariant   *fields[N_ARG_FIELDS];
+
+      fields[ARG_TYPE] =
+        g_variant_new_int32 (gimp_pdb_compat_arg_type_from_gtype (G_PARAM_SPEC_VALUE_TYPE (pspec)));
+      fields[ARG_NAME] =
+        plug_in_cache_string_new (g_param_spec_get_name (pspec));
+      fields[ARG_DESC] =
+        plug_in_cache_string_new (g_param_spec_get_blurb (pspec));
+
+      g_variant_builder_add_value (&builder,
+                                   g_variant_new_tuple (fields, N_ARG_FIELDS));
+    }
+
+  return g_variant_builder_end (&builder);
+}
+
+/*  strings are stored as byte arrays, including the terminating nul
+ *  byte, so they don't need to be valid UTF-8 (magics aren't) and
+ *  NULL can be told apart from "" by its empty array.
+ */
+static GVariant *
+plug_in_cache_string_new (const gchar *str)
+{
+  return g_variant_new_fixed_array (G_VARIANT_TYPE_BYTE,
+                                    str, str ? strlen (str) + 1 : 0,
+                                    sizeof (gchar));
+}
+
+static gchar *
+plug_in_cache_get_string (GVariant *tuple,
+                          gint      field)
+{
+  GVariant    *child;
+  const gchar *data;
+  gchar       *str = NULL;
+  gsize        length;
+
+  child = g_variant_get_child_value (tuple, field);
+  data  = g_variant_get_fixed_array (child, &length, sizeof (gchar));
+
+  if (length > 0 && data[length - 1] == '\0')
+    str = g_strdup (data);
+
+  g_variant_unref (child);
+
+  return str;
+}
+
+static gint
+plug_in_cache_get_int (GVariant *tuple,
+                       gint      field)
+{
+  GVariant *child = g_variant_get_child_value (tuple, field);
+  gint      value;
+
+  if (g_variant_is_of_type (child, G_VARIANT_TYPE_UINT32))
+    value = g_variant_get_uint32 (child);
+  else
+    value = g_variant_get_int32 (child);
+
+  g_variant_unref (child);
+
+  return value;
+}
+
+static gboolean
+plug_in_cache_get_boolean (GVariant *tuple,
+                           gint      field)
+{
+  gboolean value;
+
+  g_variant_get_child (tuple, field, "b", &value);
+
+  return value;
+}
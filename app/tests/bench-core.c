@@ -0,0 +1,623 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <gegl.h>
+#include <gtk/gtk.h>
+
+#include "libgimpbase/gimpbase.h"
+#include "libgimpmath/gimpmath.h"
+
+#include "core/core-types.h"
+#include "paint/paint-types.h"
+
+#include "gegl/gimp-babl.h"
+
+#include "operations/layer-modes/gimp-layer-modes.h"
+
+#include "core/gimp.h"
+#include "core/gimpbrush.h"
+#include "core/gimpcontainer.h"
+#include "core/gimpcontext.h"
+#include "core/gimpdrawable.h"
+#include "core/gimpdrawable-bucket-fill.h"
+#include "core/gimpfilloptions.h"
+#include "core/gimpimage.h"
+#include "core/gimpimage-convert-indexed.h"
+#include "core/gimpimage-duplicate.h"
+#include "core/gimpimage-undo.h"
+#include "core/gimplayer.h"
+#include "core/gimplayer-new.h"
+#include "core/gimppaintinfo.h"
+#include "core/gimpprojection.h"
+
+#include "paint/gimpheal.h"
+#include "paint/gimppaintcore.h"
+#include "paint/gimppaintcore-stroke.h"
+#include "paint/gimppaintoptions.h"
+
+#include "xcf/xcf.h"
+
+#include "tests.h"
+
+#include "gimp-app-test-utils.h"
+#include "gimp-app-bench-utils.h"
+
+
+#define BENCH_N_RUNS           3
+#define BENCH_N_LAYERS         8
+#define BENCH_N_STROKE_COORDS  64
+#define BENCH_HEAL_DEPTH       4
+
+
+typedef struct
+{
+  Gimp             *gimp;
+  GimpContext      *context;
+  GimpImage        *image;
+  GimpImage        *copy;
+  GBytes           *xcf;
+  GimpPaintInfo    *paint_info;
+  GimpPaintOptions *paint_options;
+  GimpFillOptions  *fill_options;
+
+  gint              heal_size;
+  gboolean          heal_multigrid;
+  gint              heal_iterations;
+  gfloat           *heal_pixels;
+  gfloat           *heal_alloc;
+  guchar           *heal_mask;
+} BenchCore;
+
+
+static const GimpPrecision bench_precisions[] =
+{
+  GIMP_PRECISION_U8_GAMMA,
+  GIMP_PRECISION_U16_GAMMA,
+  GIMP_PRECISION_FLOAT_LINEAR
+};
+
+static const gint bench_sizes[] =
+{
+  512,
+  2048
+};
+
+
+static GimpImage *
+bench_core_create_image (Gimp          *gimp,
+                         GimpPrecision  precision,
+                         gint           size,
+                         gint           n_layers)
+{
+  GimpImage *image;
+  gint       i;
+
+  image = gimp_image_new (gimp, size, size, GIMP_RGB, precision);
+
+  /*  the benchmarks are run repeatedly, don't let the undo stack grow  */
+  gimp_image_undo_disable (image);
+
+  for (i = 0; i < n_layers; i++)
+    {
+      GimpLayer          *layer;
+      GeglBuffer         *buffer;
+      GeglBufferIterator *iter;
+      GRand              *rand;
+      gchar              *name;
+
+      name  = g_strdup_printf ("layer%d", i);
+      layer = gimp_layer_new (image, size, size,
+                              gimp_image_get_layer_format (image, TRUE),
+                              name,
+                              GIMP_OPACITY_OPAQUE,
+                              GIMP_LAYER_MODE_NORMAL);
+      g_free (name);
+
+      buffer = gimp_drawable_get_buffer (GIMP_DRAWABLE (layer));
+      rand   = g_rand_new_with_seed (i);
+
+      /*  gradients plus some noise, with varying alpha above the
+       *  bottom layer, so that compositing does real work
+       */
+      iter = gegl_buffer_iterator_new (buffer, NULL, 0,
+                                       babl_format ("R'G'B'A float"),
+                                       GEGL_ACCESS_WRITE, GEGL_ABYSS_NONE, 1);
+
+      while (gegl_buffer_iterator_next (iter))
+        {
+          const GeglRectangle *roi  = &iter->items[0].roi;
+          gfloat              *data = iter->items[0].data;
+          gint                 x, y;
+
+          for (y = roi->y; y < roi->y + roi->height; y++)
+            {
+              for (x = roi->x; x < roi->x + roi->width; x++)
+                {
+                  guint noise = g_rand_int (rand);
+
+                  data[0] = (((x >> 3) + i * 64) & 0xff) / 255.0f +
+                            (noise         & 0xff) / 65536.0f;
+                  data[1] = (((y >> 3) + i * 32) & 0xff) / 255.0f +
+                            ((noise >> 8)  & 0xff) / 65536.0f;
+                  data[2] = ((((x + y) >> 4) * 3) & 0xff) / 255.0f +
+                            ((noise >> 16) & 0xff) / 65536.0f;
+                  data[3] = i == 0 ? 1.0f :
+                            (((x ^ y) + i * 16) & 0xff) / 255.0f;
+
+                  data += 4;
+                }
+            }
+        }
+
+      g_rand_free (rand);
+
+      gimp_image_add_layer (image, layer, NULL, -1, FALSE);
+    }
+
+  return image;
+}
+
+static GimpLayer *
+bench_core_get_top_layer (GimpImage *image)
+{
+  return gimp_image_get_layer_iter (image)->data;
+}
+
+
+/*  projection  */
+
+static void
+bench_core_projection (gpointer data)
+{
+  BenchCore *bench = data;
+
+  gimp_image_invalidate (bench->image,
+                         0, 0,
+                         gimp_image_get_width  (bench->image),
+                         gimp_image_get_height (bench->image));
+
+  gimp_projection_flush_now (gimp_image_get_projection (bench->image), TRUE);
+}
+
+
+/*  paint  */
+
+static void
+bench_core_paint (gpointer data)
+{
+  BenchCore     *bench = data;
+  GimpPaintCore *core;
+  GimpDrawable  *drawable;
+  GimpCoords     coords[BENCH_N_STROKE_COORDS];
+  gint           size;
+  GError        *error = NULL;
+  gint           i;
+
+  drawable = GIMP_DRAWABLE (bench_core_get_top_layer (bench->image));
+  size     = gimp_image_get_width (bench->image);
+
+  /*  a zig-zag stroke across the image  */
+  for (i = 0; i < BENCH_N_STROKE_COORDS; i++)
+    {
+      coords[i]   = (GimpCoords) GIMP_COORDS_DEFAULT_VALUES;
+      coords[i].x = (gdouble) size * i / BENCH_N_STROKE_COORDS;
+      coords[i].y = (i & 1) ? size * 0.75 : size * 0.25;
+    }
+
+  core = g_object_new (bench->paint_info->paint_type,
+                       "undo-desc", bench->paint_info->blurb,
+                       NULL);
+
+  if (! gimp_paint_core_stroke (core, drawable, bench->paint_options,
+                                coords, BENCH_N_STROKE_COORDS, FALSE,
+                                &error))
+    {
+      g_error ("painting failed: %s", error->message);
+    }
+
+  g_object_unref (core);
+}
+
+
+/*  heal  */
+
+static void
+bench_core_heal_setup (gpointer data)
+{
+  BenchCore *bench  = data;
+  gint       size   = bench->heal_size;
+  gdouble    radius = size * 0.45;
+  gint       x, y, k;
+
+  /*  a round dab in the middle, and smooth but uneven borders  */
+  for (y = 0; y < size; y++)
+    {
+      for (x = 0; x < size; x++)
+        {
+          gdouble  dx    = x + 0.5 - size / 2.0;
+          gdouble  dy    = y + 0.5 - size / 2.0;
+          gboolean inner = dx * dx + dy * dy < radius * radius;
+          gfloat  *pixel = bench->heal_pixels +
+                           (y * size + x) * BENCH_HEAL_DEPTH;
+
+          bench->heal_mask[y * size + x] = inner ? 255 : 0;
+
+          for (k = 0; k < BENCH_HEAL_DEPTH; k++)
+            {
+              pixel[k] = inner ? 0.5f :
+                         sin (x * 0.01 + k) * cos (y * 0.013);
+            }
+        }
+    }
+}
+
+static void
+bench_core_heal (gpointer data)
+{
+  BenchCore *bench = data;
+
+  bench->heal_iterations = gimp_heal_laplace_solve (bench->heal_pixels,
+                                                    bench->heal_size,
+                                                    BENCH_HEAL_DEPTH,
+                                                    bench->heal_size,
+                                                    bench->heal_mask,
+                                                    bench->heal_multigrid);
+}
+
+
+/*  xcf  */
+
+static void
+bench_core_xcf_save (gpointer data)
+{
+  BenchCore     *bench = data;
+  GOutputStream *output;
+  GError        *error = NULL;
+
+  output = g_memory_output_stream_new_resizable ();
+
+  if (! xcf_save_stream (bench->gimp, bench->image, output,
+                         NULL, NULL, &error))
+    {
+      g_error ("saving failed: %s", error->message);
+    }
+
+  g_clear_pointer (&bench->xcf, g_bytes_unref);
+
+  g_output_stream_close (output, NULL, NULL);
+  bench->xcf = g_memory_output_stream_steal_as_bytes (
+    G_MEMORY_OUTPUT_STREAM (output));
+
+  g_object_unref (output);
+}
+
+static void
+bench_core_xcf_load (gpointer data)
+{
+  BenchCore    *bench = data;
+  GInputStream *input;
+  GError       *error = NULL;
+
+  input = g_memory_input_stream_new_from_bytes (bench->xcf);
+
+  bench->copy = xcf_load_stream (bench->gimp, input, NULL, NULL, &error);
+
+  if (! bench->copy)
+    g_error ("loading failed: %s", error->message);
+
+  g_object_unref (input);
+}
+
+
+/*  operations on a copy of the image  */
+
+static void
+bench_core_copy_setup (gpointer data)
+{
+  BenchCore *bench = data;
+
+  bench->copy = gimp_image_duplicate (bench->image);
+
+  gimp_image_undo_disable (bench->copy);
+}
+
+static void
+bench_core_copy_teardown (gpointer data)
+{
+  BenchCore *bench = data;
+
+  g_clear_object (&bench->copy);
+}
+
+static void
+bench_core_convert_indexed (gpointer data)
+{
+  BenchCore *bench = data;
+  GError    *error = NULL;
+
+  if (! gimp_image_convert_indexed (bench->copy,
+                                    GIMP_CONVERT_PALETTE_GENERATE, 256,
+                                    FALSE,
+                                    GIMP_CONVERT_DITHER_FS, FALSE, FALSE,
+                                    NULL, NULL, &error))
+    {
+      g_error ("indexed conversion failed: %s", error->message);
+    }
+}
+
+static void
+bench_core_bucket_fill (gpointer data)
+{
+  BenchCore *bench = data;
+  gint       size  = gimp_image_get_width (bench->copy);
+
+  gimp_drawable_bucket_fill (GIMP_DRAWABLE (bench_core_get_top_layer (bench->copy)),
+                             bench->fill_options,
+                             FALSE, GIMP_SELECT_CRITERION_COMPOSITE,
+                             0.1, FALSE, FALSE,
+                             size / 2.0, size / 2.0);
+}
+
+static void
+bench_core_transform_scale (gpointer data)
+{
+  BenchCore *bench = data;
+
+  gimp_item_scale_by_factors (GIMP_ITEM (bench_core_get_top_layer (bench->copy)),
+                              1.5, 1.5,
+                              GIMP_INTERPOLATION_CUBIC, NULL);
+}
+
+static void
+bench_core_transform_rotate (gpointer data)
+{
+  BenchCore   *bench = data;
+  GimpMatrix3  matrix;
+  gdouble      center = gimp_image_get_width (bench->copy) / 2.0;
+
+  gimp_matrix3_identity (&matrix);
+  gimp_matrix3_translate (&matrix, -center, -center);
+  gimp_matrix3_rotate (&matrix, G_PI / 6.0);
+  gimp_matrix3_translate (&matrix, center, center);
+
+  gimp_item_transform (GIMP_ITEM (bench_core_get_top_layer (bench->copy)),
+                       bench->context, &matrix,
+                       GIMP_TRANSFORM_FORWARD,
+                       GIMP_INTERPOLATION_CUBIC,
+                       GIMP_TRANSFORM_RESIZE_ADJUST,
+                       NULL);
+}
+
+static void
+bench_core_transform_flip (gpointer data)
+{
+  BenchCore *bench = data;
+  gdouble    center = gimp_image_get_width (bench->copy) / 2.0;
+
+  gimp_item_flip (GIMP_ITEM (bench_core_get_top_layer (bench->copy)),
+                  bench->context,
+                  GIMP_ORIENTATION_HORIZONTAL, center, FALSE);
+}
+
+
+/*  driver  */
+
+static void
+bench_core_add (GimpBenchReport *report,
+                BenchCore       *bench,
+                const gchar     *name,
+                GimpBenchFunc    setup,
+                GimpBenchFunc    func,
+                GimpBenchFunc    teardown)
+{
+  gdouble time;
+
+  time = gimp_bench_run (setup, func, teardown, bench, BENCH_N_RUNS);
+
+  gimp_bench_report_add (report, name,
+                         gimp_image_get_precision (bench->image),
+                         gimp_image_get_width  (bench->image),
+                         gimp_image_get_height (bench->image),
+                         time);
+}
+
+static void
+bench_core_run_layer_modes (GimpBenchReport *report,
+                            BenchCore       *bench)
+{
+  const GimpLayerMode *modes;
+  GimpLayer           *layer;
+  gint                 n_modes;
+  gint                 i;
+
+  layer = bench_core_get_top_layer (bench->image);
+  modes = gimp_layer_mode_get_group_array (GIMP_LAYER_MODE_GROUP_DEFAULT,
+                                           &n_modes);
+
+  for (i = 0; i < n_modes; i++)
+    {
+      const gchar *mode_name = NULL;
+      gchar       *name;
+
+      gimp_enum_get_value (GIMP_TYPE_LAYER_MODE, modes[i],
+                           NULL, &mode_name, NULL, NULL);
+
+      gimp_layer_set_mode (layer, modes[i], FALSE);
+
+      name = g_strdup_printf ("layer-mode/%s", mode_name);
+      bench_core_add (report, bench, name,
+                      NULL, bench_core_projection, NULL);
+      g_free (name);
+    }
+
+  gimp_layer_set_mode (layer, GIMP_LAYER_MODE_NORMAL, FALSE);
+}
+
+static void
+bench_core_run_heal (GimpBenchReport *report,
+                     BenchCore       *bench,
+                     gint             size)
+{
+  const gchar *names[] = { "heal/laplace-sor", "heal/laplace-multigrid" };
+  gint         i;
+
+  /*  the solver needs room for an empty pixel after the area, and
+   *  aligned pixels
+   */
+  bench->heal_size   = size / 4;
+  bench->heal_alloc  = g_new (gfloat,
+                              4 + (bench->heal_size * bench->heal_size + 1) *
+                                  BENCH_HEAL_DEPTH);
+  bench->heal_pixels = (gfloat *) (((guintptr) bench->heal_alloc + 15) & ~15);
+  bench->heal_mask   = g_new (guchar, bench->heal_size * bench->heal_size);
+
+  for (i = 0; i < G_N_ELEMENTS (names); i++)
+    {
+      gdouble time;
+
+      bench->heal_multigrid = i > 0;
+
+      time = gimp_bench_run (bench_core_heal_setup, bench_core_heal, NULL,
+                             bench, BENCH_N_RUNS);
+
+      gimp_bench_report_add (report, names[i],
+                             GIMP_PRECISION_FLOAT_LINEAR,
+                             bench->heal_size, bench->heal_size,
+                             time);
+
+      g_print ("%-40s  %d iterations\n", names[i], bench->heal_iterations);
+    }
+
+  g_free (bench->heal_mask);
+  g_free (bench->heal_alloc);
+}
+
+static void
+bench_core_run (GimpBenchReport *report,
+                BenchCore       *bench,
+                GimpPrecision    precision,
+                gint             size)
+{
+  /*  a deep layer stack for the projection  */
+  bench->image = bench_core_create_image (bench->gimp, precision, size,
+                                          BENCH_N_LAYERS);
+
+  bench_core_add (report, bench, "projection/stack",
+                  NULL, bench_core_projection, NULL);
+
+  bench_core_add (report, bench, "xcf/save",
+                  NULL, bench_core_xcf_save, NULL);
+  bench_core_add (report, bench, "xcf/load",
+                  NULL, bench_core_xcf_load, bench_core_copy_teardown);
+
+  g_clear_pointer (&bench->xcf, g_bytes_unref);
+  g_clear_object (&bench->image);
+
+  /*  two layers for everything else  */
+  bench->image = bench_core_create_image (bench->gimp, precision, size, 2);
+
+  bench_core_run_layer_modes (report, bench);
+
+  bench_core_add (report, bench, "paint/paintbrush",
+                  NULL, bench_core_paint, NULL);
+
+  /*  indexed images only exist in 8 bit gamma  */
+  if (gimp_babl_is_valid (GIMP_INDEXED, precision))
+    {
+      bench_core_add (report, bench, "convert/indexed",
+                      bench_core_copy_setup,
+                      bench_core_convert_indexed,
+                      bench_core_copy_teardown);
+    }
+
+  bench_core_add (report, bench, "fill/bucket",
+                  bench_core_copy_setup,
+                  bench_core_bucket_fill,
+                  bench_core_copy_teardown);
+
+  bench_core_add (report, bench, "transform/scale",
+                  bench_core_copy_setup,
+                  bench_core_transform_scale,
+                  bench_core_copy_teardown);
+  bench_core_add (report, bench, "transform/rotate",
+                  bench_core_copy_setup,
+                  bench_core_transform_rotate,
+                  bench_core_copy_teardown);
+  bench_core_add (report, bench, "transform/flip",
+                  bench_core_copy_setup,
+                  bench_core_transform_flip,
+                  bench_core_copy_teardown);
+
+  g_clear_object (&bench->image);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  GimpBenchReport *report;
+  BenchCore        bench = { 0, };
+  gint             i, j;
+
+  g_test_init (&argc, &argv, NULL);
+
+  report = gimp_bench_report_new ("core", &argc, &argv);
+
+  gimp_test_utils_set_gimp2_directory ("GIMP_TESTING_ABS_TOP_SRCDIR",
+                                       "app/tests/gimpdir");
+
+  bench.gimp    = gimp_init_for_testing ();
+  bench.context = gimp_get_user_context (bench.gimp);
+
+  gimp_context_set_brush (bench.context,
+                          GIMP_BRUSH (gimp_brush_get_standard (bench.context)));
+
+  bench.paint_info = GIMP_PAINT_INFO (
+    gimp_container_get_child_by_name (bench.gimp->paint_info_list,
+                                      "gimp-paintbrush"));
+
+  bench.paint_options = gimp_paint_options_new (bench.paint_info);
+  gimp_context_define_properties (GIMP_CONTEXT (bench.paint_options),
+                                  GIMP_CONTEXT_PROP_MASK_PAINT, FALSE);
+  gimp_context_set_parent (GIMP_CONTEXT (bench.paint_options),
+                           bench.context);
+
+  bench.fill_options = gimp_fill_options_new (bench.gimp, bench.context, TRUE);
+
+  for (i = 0; i < G_N_ELEMENTS (bench_sizes); i++)
+    {
+      g_object_set (bench.paint_options,
+                    "brush-size", bench_sizes[i] / 16.0,
+                    NULL);
+
+      for (j = 0; j < G_N_ELEMENTS (bench_precisions); j++)
+        bench_core_run (report, &bench, bench_precisions[j], bench_sizes[i]);
+
+      bench_core_run_heal (report, &bench, bench_sizes[i]);
+    }
+
+  g_object_unref (bench.fill_options);
+  g_object_unref (bench.paint_options);
+
+  gimp_bench_report_finish (report);
+
+  gimp_exit (bench.gimp, TRUE);
+
+  return 0;
+}
@@ -0,0 +1,335 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <gegl.h>
+#include <glib/gstdio.h>
+#include <gtk/gtk.h>
+
+#include <tiffio.h>
+
+#include "libgimpbase/gimpbase.h"
+
+#include "core/core-types.h"
+
+#include "core/gimp.h"
+#include "core/gimpdrawable.h"
+#include "core/gimpimage.h"
+
+#include "file/file-open.h"
+
+#include "tests.h"
+
+#include "gimp-app-test-utils.h"
+#include "gimp-app-bench-utils.h"
+
+
+#define BENCH_IMAGE_WIDTH  4096
+#define BENCH_IMAGE_HEIGHT 4096
+#define BENCH_TILE_SIZE    256
+#define BENCH_STRIP_ROWS   64
+#define BENCH_N_RUNS       3
+
+
+typedef struct
+{
+  const gchar *name;
+  gboolean     tiled;
+  guint16      compression;
+} BenchTiffLayout;
+
+
+static const BenchTiffLayout layouts[] =
+{
+  { "tiled-lzw",       TRUE,  COMPRESSION_LZW           },
+  { "tiled-deflate",   TRUE,  COMPRESSION_ADOBE_DEFLATE },
+  { "striped-lzw",     FALSE, COMPRESSION_LZW           },
+  { "striped-deflate", FALSE, COMPRESSION_ADOBE_DEFLATE }
+};
+
+
+/* fills 'rows' rows of 'width' RGB pixels, starting at 'x', 'y', with
+ * gradients plus some noise, so that the chunks are neither trivially
+ * compressible nor incompressible.
+ */
+static void
+bench_tiff_fill (guchar *data,
+                 gint    x,
+                 gint    y,
+                 gint    width,
+                 gint    rows,
+                 GRand  *rand)
+{
+  gint i, j;
+
+  for (j = y; j < y + rows; j++)
+    {
+      for (i = x; i < x + width; i++)
+        {
+          guint noise = g_rand_int (rand);
+
+          *data++ = ((i >> 3) & 0xff) + (noise         & 0x03);
+          *data++ = ((j >> 3) & 0xff) + ((noise >> 8)  & 0x03);
+          *data++ = (((i + j) >> 4) & 0xff) + ((noise >> 16) & 0x03);
+        }
+    }
+}
+
+static void
+bench_tiff_write (const gchar           *filename,
+                  const BenchTiffLayout *layout)
+{
+  TIFF   *tif;
+  GRand  *rand;
+  guchar *data;
+
+  tif = TIFFOpen (filename, "w");
+
+  if (! tif)
+    g_error ("can't create %s", filename);
+
+  TIFFSetField (tif, TIFFTAG_IMAGEWIDTH,      BENCH_IMAGE_WIDTH);
+  TIFFSetField (tif, TIFFTAG_IMAGELENGTH,     BENCH_IMAGE_HEIGHT);
+  TIFFSetField (tif, TIFFTAG_BITSPERSAMPLE,   8);
+  TIFFSetField (tif, TIFFTAG_SAMPLESPERPIXEL, 3);
+  TIFFSetField (tif, TIFFTAG_PHOTOMETRIC,     PHOTOMETRIC_RGB);
+  TIFFSetField (tif, TIFFTAG_PLANARCONFIG,    PLANARCONFIG_CONTIG);
+  TIFFSetField (tif, TIFFTAG_COMPRESSION,     layout->compression);
+  TIFFSetField (tif, TIFFTAG_PREDICTOR,       PREDICTOR_HORIZONTAL);
+
+  rand = g_rand_new_with_seed (0);
+
+  if (layout->tiled)
+    {
+      gint x, y;
+
+      TIFFSetField (tif, TIFFTAG_TILEWIDTH,  BENCH_TILE_SIZE);
+      TIFFSetField (tif, TIFFTAG_TILELENGTH, BENCH_TILE_SIZE);
+
+      data = g_malloc (BENCH_TILE_SIZE * BENCH_TILE_SIZE * 3);
+
+      for (y = 0; y < BENCH_IMAGE_HEIGHT; y += BENCH_TILE_SIZE)
+        for (x = 0; x < BENCH_IMAGE_WIDTH; x += BENCH_TILE_SIZE)
+          {
+            bench_tiff_fill (data, x, y,
+                             BENCH_TILE_SIZE, BENCH_TILE_SIZE, rand);
+
+            if (TIFFWriteTile (tif, data, x, y, 0, 0) < 0)
+              g_error ("writing %s failed", filename);
+          }
+    }
+  else
+    {
+      gint strip;
+
+      TIFFSetField (tif, TIFFTAG_ROWSPERSTRIP, BENCH_STRIP_ROWS);
+
+      data = g_malloc (BENCH_IMAGE_WIDTH * BENCH_STRIP_ROWS * 3);
+
+      for (strip = 0;
+           strip < BENCH_IMAGE_HEIGHT / BENCH_STRIP_ROWS;
+           strip++)
+        {
+          bench_tiff_fill (data, 0, strip * BENCH_STRIP_ROWS,
+                           BENCH_IMAGE_WIDTH, BENCH_STRIP_ROWS, rand);
+
+          if (TIFFWriteEncodedStrip (tif, strip, data,
+                                     BENCH_IMAGE_WIDTH *
+                                     BENCH_STRIP_ROWS * 3) < 0)
+            g_error ("writing %s failed", filename);
+        }
+    }
+
+  g_free (data);
+  g_rand_free (rand);
+
+  TIFFClose (tif);
+}
+
+/* loads 'file' through the TIFF plug-in, with its decoding limited to
+ * 'n_threads' threads, and returns the pixels of the loaded layer.
+ */
+static GBytes *
+bench_tiff_load (Gimp    *gimp,
+                 GFile   *file,
+                 gint     n_threads,
+                 gdouble *time)
+{
+  GimpImage         *image;
+  GimpDrawable      *drawable;
+  GimpPDBStatusType  status;
+  GError            *error = NULL;
+  gchar             *threads;
+  guchar            *pixels;
+  gint64             start;
+
+  /* the plug-in process inherits our environment */
+  threads = g_strdup_printf ("%d", n_threads);
+  g_setenv ("GIMP_TIFF_LOAD_THREADS", threads, TRUE);
+  g_free (threads);
+
+  start = g_get_monotonic_time ();
+
+  image = file_open_image (gimp,
+                           gimp_get_user_context (gimp),
+                           NULL /*progress*/,
+                           file,
+                           file,
+                           FALSE /*as_new*/,
+                           NULL /*file_proc*/,
+                           GIMP_RUN_NONINTERACTIVE,
+                           &status,
+                           NULL /*mime_type*/,
+                           &error);
+
+  if (! image)
+    g_error ("loading failed: %s", error ? error->message : "no image");
+
+  *time = (g_get_monotonic_time () - start) / (gdouble) G_TIME_SPAN_SECOND;
+
+  drawable = gimp_image_get_active_drawable (image);
+  pixels   = g_malloc (BENCH_IMAGE_WIDTH * BENCH_IMAGE_HEIGHT * 3);
+
+  gegl_buffer_get (gimp_drawable_get_buffer (drawable),
+                   GEGL_RECTANGLE (0, 0,
+                                   BENCH_IMAGE_WIDTH, BENCH_IMAGE_HEIGHT),
+                   1.0, babl_format ("R'G'B' u8"), pixels,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+  g_object_unref (image);
+
+  return g_bytes_new_take (pixels, BENCH_IMAGE_WIDTH * BENCH_IMAGE_HEIGHT * 3);
+}
+
+static void
+bench_tiff_run (GimpBenchReport       *report,
+                Gimp                  *gimp,
+                const gchar           *dir,
+                const BenchTiffLayout *layout)
+{
+  GFile   *file;
+  GBytes  *reference = NULL;
+  gchar   *filename;
+  gchar   *basename;
+  gdouble  size_mb;
+  gint     max_threads;
+  gint     n_threads;
+
+  basename = g_strdup_printf ("%s.tif", layout->name);
+  filename = g_build_filename (dir, basename, NULL);
+  g_free (basename);
+
+  bench_tiff_write (filename, layout);
+
+  file = g_file_new_for_path (filename);
+
+  size_mb = (gdouble) BENCH_IMAGE_WIDTH * BENCH_IMAGE_HEIGHT * 3 /
+            (1024.0 * 1024.0);
+
+  max_threads = g_get_num_processors ();
+
+  for (n_threads = 1; n_threads <= max_threads; n_threads *= 2)
+    {
+      gdouble load_time = G_MAXDOUBLE;
+      gchar  *name;
+      gint    i;
+
+      for (i = 0; i < BENCH_N_RUNS; i++)
+        {
+          GBytes  *bytes;
+          gdouble  time;
+
+          bytes = bench_tiff_load (gimp, file, n_threads, &time);
+          load_time = MIN (load_time, time);
+
+          /* the result must not depend on the number of threads */
+          if (! reference)
+            reference = g_bytes_ref (bytes);
+          else if (! g_bytes_equal (bytes, reference))
+            g_error ("%s result differs with %d threads",
+                     layout->name, n_threads);
+
+          g_bytes_unref (bytes);
+        }
+
+      g_print ("%-15s  %3d threads  load: %8.2f MB/s\n",
+               layout->name, n_threads, size_mb / load_time);
+
+      name = g_strdup_printf ("tiff-%s/load/%d-threads",
+                              layout->name, n_threads);
+      gimp_bench_report_add (report, name,
+                             GIMP_PRECISION_U8_GAMMA,
+                             BENCH_IMAGE_WIDTH, BENCH_IMAGE_HEIGHT,
+                             load_time);
+      g_free (name);
+    }
+
+  g_unsetenv ("GIMP_TIFF_LOAD_THREADS");
+
+  g_bytes_unref (reference);
+  g_object_unref (file);
+
+  g_unlink (filename);
+  g_free (filename);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  GimpBenchReport *report;
+  Gimp            *gimp;
+  gchar           *dir;
+  gint             i;
+
+  gimp_test_bail_if_no_display ();
+  gtk_test_init (&argc, &argv, NULL);
+
+  report = gimp_bench_report_new ("tiff", &argc, &argv);
+
+  gimp_test_utils_set_gimp2_directory ("GIMP_TESTING_ABS_TOP_SRCDIR",
+                                       "app/tests/gimpdir");
+  gimp_test_utils_setup_menus_path ();
+
+  /* the TIFF loader is a plug-in, so we need a GIMP which runs them */
+  gimp = gimp_init_for_gui_testing (FALSE /*show_gui*/);
+  gimp_test_run_mainloop_until_idle ();
+
+  dir = g_dir_make_tmp ("gimp-bench-tiff-XXXXXX", NULL);
+
+  if (! dir)
+    g_error ("can't create a temporary directory");
+
+  for (i = 0; i < G_N_ELEMENTS (layouts); i++)
+    bench_tiff_run (report, gimp, dir, &layouts[i]);
+
+  g_rmdir (dir);
+  g_free (dir);
+
+  gimp_bench_report_finish (report);
+
+  /* Don't write files to the source dir */
+  gimp_test_utils_set_gimp2_directory ("GIMP_TESTING_ABS_TOP_BUILDDIR",
+                                       "app/tests/gimpdir-output");
+
+  gimp_exit (gimp, TRUE);
+
+  return 0;
+}
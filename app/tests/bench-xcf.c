@@ -0,0 +1,317 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <gegl.h>
+#include <gtk/gtk.h>
+
+#include "libgimpbase/gimpbase.h"
+
+#include "core/core-types.h"
+
+#include "core/gimp.h"
+#include "core/gimpdrawable.h"
+#include "core/gimpimage.h"
+#include "core/gimplayer.h"
+#include "core/gimplayer-new.h"
+
+#include "xcf/xcf.h"
+
+#include "tests.h"
+
+#include "gimp-app-test-utils.h"
+#include "gimp-app-bench-utils.h"
+
+
+#define BENCH_IMAGE_WIDTH  2048
+#define BENCH_IMAGE_HEIGHT 2048
+#define BENCH_N_LAYERS     4
+#define BENCH_N_RUNS       3
+
+
+typedef enum
+{
+  BENCH_XCF_RLE,
+  BENCH_XCF_ZLIB,
+  BENCH_XCF_FAST
+} BenchXcfCompression;
+
+
+static const gchar *compression_names[] =
+{
+  "rle",
+  "zlib",
+  "fast"
+};
+
+
+static GimpImage *
+bench_xcf_create_image (Gimp          *gimp,
+                        GimpPrecision  precision)
+{
+  GimpImage *image;
+  gint       i;
+
+  image = gimp_image_new (gimp,
+                          BENCH_IMAGE_WIDTH, BENCH_IMAGE_HEIGHT,
+                          GIMP_RGB, precision);
+
+  for (i = 0; i < BENCH_N_LAYERS; i++)
+    {
+      GimpLayer          *layer;
+      GeglBuffer         *buffer;
+      GeglBufferIterator *iter;
+      GRand              *rand;
+      gchar              *name;
+
+      name  = g_strdup_printf ("layer%d", i);
+      layer = gimp_layer_new (image,
+                              BENCH_IMAGE_WIDTH, BENCH_IMAGE_HEIGHT,
+                              gimp_image_get_layer_format (image, TRUE),
+                              name,
+                              GIMP_OPACITY_OPAQUE,
+                              GIMP_LAYER_MODE_NORMAL);
+      g_free (name);
+
+      buffer = gimp_drawable_get_buffer (GIMP_DRAWABLE (layer));
+      rand   = g_rand_new_with_seed (i);
+
+      /* fill the layer with gradients plus some noise, so that the
+       * tiles are neither trivially compressible nor incompressible.
+       */
+      iter = gegl_buffer_iterator_new (buffer, NULL, 0,
+                                       babl_format ("R'G'B'A float"),
+                                       GEGL_ACCESS_WRITE, GEGL_ABYSS_NONE, 1);
+
+      while (gegl_buffer_iterator_next (iter))
+        {
+          const GeglRectangle *roi  = &iter->items[0].roi;
+          gfloat              *data = iter->items[0].data;
+          gint                 x, y;
+
+          for (y = roi->y; y < roi->y + roi->height; y++)
+            {
+              for (x = roi->x; x < roi->x + roi->width; x++)
+                {
+                  guint noise = g_rand_int (rand);
+
+                  data[0] = (((x >> 3) + i * 64) & 0xff) / 255.0f +
+                            (noise         & 0xff) / 65536.0f;
+                  data[1] = (((y >> 3) + i * 32) & 0xff) / 255.0f +
+                            ((noise >> 8)  & 0xff) / 65536.0f;
+                  data[2] = ((((x + y) >> 4) * 3) & 0xff) / 255.0f +
+                            ((noise >> 16) & 0xff) / 65536.0f;
+                  data[3] = 1.0f;
+
+                  data += 4;
+                }
+            }
+        }
+
+      g_rand_free (rand);
+
+      gimp_image_add_layer (image, layer, NULL, -1, FALSE);
+    }
+
+  return image;
+}
+
+static GBytes *
+bench_xcf_save (Gimp      *gimp,
+                GimpImage *image,
+                gdouble   *time)
+{
+  GOutputStream *output;
+  GBytes        *bytes;
+  GError        *error = NULL;
+  gint64         start;
+
+  output = g_memory_output_stream_new_resizable ();
+
+  start = g_get_monotonic_time ();
+
+  if (! xcf_save_stream (gimp, image, output, NULL, NULL, &error))
+    g_error ("saving failed: %s", error->message);
+
+  *time = (g_get_monotonic_time () - start) / (gdouble) G_TIME_SPAN_SECOND;
+
+  bytes = g_memory_output_stream_steal_as_bytes (
+    G_MEMORY_OUTPUT_STREAM (output));
+
+  g_object_unref (output);
+
+  return bytes;
+}
+
+static void
+bench_xcf_load (Gimp    *gimp,
+                GBytes  *bytes,
+                gdouble *time)
+{
+  GInputStream *input;
+  GimpImage    *image;
+  GError       *error = NULL;
+  gint64        start;
+
+  input = g_memory_input_stream_new_from_bytes (bytes);
+
+  start = g_get_monotonic_time ();
+
+  image = xcf_load_stream (gimp, input, NULL, NULL, &error);
+
+  if (! image)
+    g_error ("loading failed: %s", error->message);
+
+  *time = (g_get_monotonic_time () - start) / (gdouble) G_TIME_SPAN_SECOND;
+
+  g_object_unref (image);
+  g_object_unref (input);
+}
+
+static void
+bench_xcf_run (GimpBenchReport     *report,
+               Gimp                *gimp,
+               GimpImage           *image,
+               BenchXcfCompression  compression)
+{
+  GBytes      *reference = NULL;
+  const gchar *precision_name;
+  gdouble      size_mb;
+  gint         max_threads;
+  gint         n_threads;
+
+  gimp_image_set_xcf_compression (image, compression == BENCH_XCF_ZLIB);
+
+  g_object_set (gimp->config,
+                "xcf-fast-compression", compression == BENCH_XCF_FAST,
+                NULL);
+
+  gimp_enum_get_value (GIMP_TYPE_COMPONENT_TYPE,
+                       gimp_image_get_component_type (image),
+                       NULL, &precision_name, NULL, NULL);
+
+  size_mb = (gdouble) BENCH_IMAGE_WIDTH * BENCH_IMAGE_HEIGHT * BENCH_N_LAYERS *
+            babl_format_get_bytes_per_pixel (
+              gimp_image_get_layer_format (image, TRUE)) /
+            (1024.0 * 1024.0);
+
+  max_threads = g_get_num_processors ();
+
+  for (n_threads = 1; n_threads <= max_threads; n_threads *= 2)
+    {
+      gdouble save_time = G_MAXDOUBLE;
+      gdouble load_time = G_MAXDOUBLE;
+      gchar  *name;
+      gint    i;
+
+      g_object_set (gimp->config,
+                    "num-processors", n_threads,
+                    NULL);
+
+      for (i = 0; i < BENCH_N_RUNS; i++)
+        {
+          GBytes  *bytes;
+          gdouble  time;
+
+          bytes = bench_xcf_save (gimp, image, &time);
+          save_time = MIN (save_time, time);
+
+          /* the output must not depend on the number of threads */
+          if (! reference)
+            reference = g_bytes_ref (bytes);
+          else if (! g_bytes_equal (bytes, reference))
+            g_error ("%s output differs with %d threads",
+                     compression_names[compression], n_threads);
+
+          bench_xcf_load (gimp, bytes, &time);
+          load_time = MIN (load_time, time);
+
+          g_bytes_unref (bytes);
+        }
+
+      g_print ("%-4s  %-5s  %3d threads  "
+               "save: %8.2f MB/s  load: %8.2f MB/s  ratio: %5.2f\n",
+               compression_names[compression],
+               precision_name,
+               n_threads,
+               size_mb / save_time,
+               size_mb / load_time,
+               size_mb * 1024.0 * 1024.0 / g_bytes_get_size (reference));
+
+      name = g_strdup_printf ("xcf-%s/save/%d-threads",
+                              compression_names[compression], n_threads);
+      gimp_bench_report_add (report, name,
+                             gimp_image_get_precision (image),
+                             BENCH_IMAGE_WIDTH, BENCH_IMAGE_HEIGHT,
+                             save_time);
+      g_free (name);
+
+      name = g_strdup_printf ("xcf-%s/load/%d-threads",
+                              compression_names[compression], n_threads);
+      gimp_bench_report_add (report, name,
+                             gimp_image_get_precision (image),
+                             BENCH_IMAGE_WIDTH, BENCH_IMAGE_HEIGHT,
+                             load_time);
+      g_free (name);
+    }
+
+  g_bytes_unref (reference);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  const GimpPrecision precisions[] =
+  {
+    GIMP_PRECISION_U8_GAMMA,
+    GIMP_PRECISION_U16_GAMMA,
+    GIMP_PRECISION_FLOAT_LINEAR
+  };
+  GimpBenchReport *report;
+  Gimp            *gimp;
+  gint             i;
+
+  g_test_init (&argc, &argv, NULL);
+
+  report = gimp_bench_report_new ("xcf", &argc, &argv);
+
+  gimp_test_utils_set_gimp2_directory ("GIMP_TESTING_ABS_TOP_SRCDIR",
+                                       "app/tests/gimpdir");
+
+  gimp = gimp_init_for_testing ();
+
+  for (i = 0; i < G_N_ELEMENTS (precisions); i++)
+    {
+      GimpImage *image = bench_xcf_create_image (gimp, precisions[i]);
+
+      bench_xcf_run (report, gimp, image, BENCH_XCF_RLE);
+      bench_xcf_run (report, gimp, image, BENCH_XCF_ZLIB);
+      bench_xcf_run (report, gimp, image, BENCH_XCF_FAST);
+
+      g_object_unref (image);
+    }
+
+  gimp_bench_report_finish (report);
+
+  gimp_exit (gimp, TRUE);
+
+  return 0;
+}
@@ -0,0 +1,321 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <gio/gio.h>
+
+#include "libgimpbase/gimpbase.h"
+
+#include "gimp-app-bench-utils.h"
+
+
+typedef struct
+{
+  gchar         *name;
+  GimpPrecision  precision;
+  gint           width;
+  gint           height;
+  gdouble        time;
+} GimpBenchResult;
+
+struct _GimpBenchReport
+{
+  gchar  *suite;
+  gchar  *output;
+  GArray *results;
+};
+
+
+static void    gimp_bench_result_clear       (GimpBenchResult *result);
+static void    gimp_bench_json_append_string (GString         *str,
+                                              const gchar     *value);
+static void    gimp_bench_json_append_double (GString         *str,
+                                              gdouble          value);
+static gchar * gimp_bench_report_to_json     (GimpBenchReport *report);
+
+
+/*  public functions  */
+
+/**
+ * gimp_bench_report_new:
+ * @suite: the name of the benchmark suite
+ * @argc:  pointer to the program's argc
+ * @argv:  pointer to the program's argv
+ *
+ * Creates a report collecting benchmark results.  Parses the
+ * "--output FILE" option from the command line; if given, the results
+ * are written to FILE as JSON by gimp_bench_report_finish().
+ *
+ * Returns: a new #GimpBenchReport
+ **/
+GimpBenchReport *
+gimp_bench_report_new (const gchar   *suite,
+                       gint          *argc,
+                       gchar       ***argv)
+{
+  GimpBenchReport *report;
+  GOptionContext  *context;
+  gchar           *output = NULL;
+  GError          *error  = NULL;
+
+  const GOptionEntry entries[] =
+  {
+    {
+      "output", 'o', 0, G_OPTION_ARG_FILENAME, &output,
+      "Write the results as JSON to FILE", "FILE"
+    },
+    { NULL }
+  };
+
+  g_return_val_if_fail (suite != NULL, NULL);
+
+  context = g_option_context_new (NULL);
+  g_option_context_set_ignore_unknown_options (context, TRUE);
+  g_option_context_add_main_entries (context, entries, NULL);
+
+  if (! g_option_context_parse (context, argc, argv, &error))
+    g_error ("%s", error->message);
+
+  g_option_context_free (context);
+
+  report = g_slice_new0 (GimpBenchReport);
+
+  report->suite   = g_strdup (suite);
+  report->output  = output;
+  report->results = g_array_new (FALSE, FALSE, sizeof (GimpBenchResult));
+
+  g_array_set_clear_func (report->results,
+                          (GDestroyNotify) gimp_bench_result_clear);
+
+  return report;
+}
+
+/**
+ * gimp_bench_report_add:
+ * @report:    a #GimpBenchReport
+ * @name:      the name of the benchmark, such as "projection/normal"
+ * @precision: the precision of the benchmarked image
+ * @width:     the width of the benchmarked image
+ * @height:    the height of the benchmarked image
+ * @time:      the run time, in seconds
+ *
+ * Adds a result to @report, and prints it.
+ **/
+void
+gimp_bench_report_add (GimpBenchReport *report,
+                       const gchar     *name,
+                       GimpPrecision    precision,
+                       gint             width,
+                       gint             height,
+                       gdouble          time)
+{
+  GimpBenchResult  result;
+  const gchar     *precision_name = NULL;
+
+  g_return_if_fail (report != NULL);
+  g_return_if_fail (name != NULL);
+
+  result.name      = g_strdup (name);
+  result.precision = precision;
+  result.width     = width;
+  result.height    = height;
+  result.time      = time;
+
+  g_array_append_val (report->results, result);
+
+  gimp_enum_get_value (GIMP_TYPE_PRECISION, precision,
+                       NULL, &precision_name, NULL, NULL);
+
+  g_print ("%-40s  %-16s  %5d x %-5d  %10.4f s  %10.2f Mpx/s\n",
+           name, precision_name, width, height, time,
+           (gdouble) width * height / 1e6 / MAX (time, 1e-9));
+}
+
+/**
+ * gimp_bench_report_finish:
+ * @report: a #GimpBenchReport
+ *
+ * Writes the results to the file given by "--output", if any, and
+ * frees @report.
+ **/
+void
+gimp_bench_report_finish (GimpBenchReport *report)
+{
+  g_return_if_fail (report != NULL);
+
+  if (report->output)
+    {
+      gchar  *json  = gimp_bench_report_to_json (report);
+      GError *error = NULL;
+
+      if (! g_file_set_contents (report->output, json, -1, &error))
+        g_error ("writing '%s' failed: %s", report->output, error->message);
+
+      g_free (json);
+    }
+
+  g_array_free (report->results, TRUE);
+  g_free (report->output);
+  g_free (report->suite);
+
+  g_slice_free (GimpBenchReport, report);
+}
+
+/**
+ * gimp_bench_run:
+ * @setup:    (nullable): called before each run, not timed
+ * @func:     the function to time
+ * @teardown: (nullable): called after each run, not timed
+ * @data:     data passed to all functions
+ * @n_runs:   the number of runs
+ *
+ * Runs @func @n_runs times.
+ *
+ * Returns: the shortest run time, in seconds
+ **/
+gdouble
+gimp_bench_run (GimpBenchFunc setup,
+                GimpBenchFunc func,
+                GimpBenchFunc teardown,
+                gpointer      data,
+                gint          n_runs)
+{
+  gdouble min_time = G_MAXDOUBLE;
+  gint    i;
+
+  g_return_val_if_fail (func != NULL, 0.0);
+  g_return_val_if_fail (n_runs > 0, 0.0);
+
+  for (i = 0; i < n_runs; i++)
+    {
+      gint64 start;
+
+      if (setup)
+        setup (data);
+
+      start = g_get_monotonic_time ();
+
+      func (data);
+
+      min_time = MIN (min_time,
+                      (g_get_monotonic_time () - start) /
+                      (gdouble) G_TIME_SPAN_SECOND);
+
+      if (teardown)
+        teardown (data);
+    }
+
+  return min_time;
+}
+
+
+/*  private functions  */
+
+static void
+gimp_bench_result_clear (GimpBenchResult *result)
+{
+  g_free (result->name);
+}
+
+static void
+gimp_bench_json_append_string (GString     *str,
+                               const gchar *value)
+{
+  const gchar *p;
+
+  g_string_append_c (str, '"');
+
+  for (p = value; *p; p++)
+    {
+      switch (*p)
+        {
+        case '"':  g_string_append (str, "\\\""); break;
+        case '\\': g_string_append (str, "\\\\"); break;
+        case '\n': g_string_append (str, "\\n");  break;
+
+        default:
+          if ((guchar) *p < 0x20)
+            g_string_append_printf (str, "\\u%04x", (guchar) *p);
+          else
+            g_string_append_c (str, *p);
+          break;
+        }
+    }
+
+  g_string_append_c (str, '"');
+}
+
+static void
+gimp_bench_json_append_double (GString *str,
+                               gdouble  value)
+{
+  gchar buf[G_ASCII_DTOSTR_BUF_SIZE];
+
+  /*  JSON numbers always use '.', whatever the locale  */
+  g_string_append (str, g_ascii_formatd (buf, sizeof (buf), "%.6f", value));
+}
+
+static gchar *
+gimp_bench_report_to_json (GimpBenchReport *report)
+{
+  GString   *str = g_string_new (NULL);
+  GDateTime *now = g_date_time_new_now_utc ();
+  gchar     *date;
+  gint       i;
+
+  date = g_date_time_format (now, "%Y-%m-%dT%H:%M:%SZ");
+
+  g_string_append (str, "{\n  \"suite\": ");
+  gimp_bench_json_append_string (str, report->suite);
+  g_string_append (str, ",\n  \"version\": ");
+  gimp_bench_json_append_string (str, GIMP_VERSION);
+  g_string_append (str, ",\n  \"date\": ");
+  gimp_bench_json_append_string (str, date);
+  g_string_append_printf (str, ",\n  \"n-processors\": %d",
+                          g_get_num_processors ());
+  g_string_append (str, ",\n  \"results\": [");
+
+  for (i = 0; i < report->results->len; i++)
+    {
+      GimpBenchResult *result = &g_array_index (report->results,
+                                                GimpBenchResult, i);
+      const gchar     *precision_name = NULL;
+
+      gimp_enum_get_value (GIMP_TYPE_PRECISION, result->precision,
+                           NULL, &precision_name, NULL, NULL);
+
+      g_string_append (str, i == 0 ? "\n" : ",\n");
+
+      g_string_append (str, "    { \"name\": ");
+      gimp_bench_json_append_string (str, result->name);
+      g_string_append (str, ", \"precision\": ");
+      gimp_bench_json_append_string (str, precision_name);
+      g_string_append_printf (str, ", \"width\": %d, \"height\": %d",
+                              result->width, result->height);
+      g_string_append (str, ", \"time\": ");
+      gimp_bench_json_append_double (str, result->time);
+      g_string_append (str, " }");
+    }
+
+  g_string_append (str, "\n  ]\n}\n");
+
+  g_free (date);
+  g_date_time_unref (now);
+
+  return g_string_free (str, FALSE);
+}
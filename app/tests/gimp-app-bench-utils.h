@@ -0,0 +1,45 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef  __GIMP_APP_BENCH_UTILS_H__
+#define  __GIMP_APP_BENCH_UTILS_H__
+
+
+typedef struct _GimpBenchReport GimpBenchReport;
+
+typedef void (* GimpBenchFunc) (gpointer data);
+
+
+GimpBenchReport * gimp_bench_report_new    (const gchar      *suite,
+                                            gint             *argc,
+                                            gchar          ***argv);
+void              gimp_bench_report_add    (GimpBenchReport  *report,
+                                            const gchar      *name,
+                                            GimpPrecision     precision,
+                                            gint              width,
+                                            gint              height,
+                                            gdouble           time);
+void              gimp_bench_report_finish (GimpBenchReport  *report);
+
+gdouble           gimp_bench_run           (GimpBenchFunc     setup,
+                                            GimpBenchFunc     func,
+                                            GimpBenchFunc     teardown,
+                                            gpointer          data,
+                                            gint              n_runs);
+
+
+#endif /* __GIMP_APP_BENCH_UTILS_H__ */
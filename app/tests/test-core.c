@@ -0,0 +1,728 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 2009 Martin Nordholts
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include <gegl.h>
+#include <glib/gstdio.h>
+#include <gtk/gtk.h>
+
+#include "widgets/widgets-types.h"
+
+#include "widgets/gimpuimanager.h"
+
+#include "core/gimp.h"
+#include "core/gimpboundary.h"
+#include "core/gimpchannel.h"
+#include "core/gimpchannel-combine.h"
+#include "core/gimpcontext.h"
+#include "core/gimpdataindex.h"
+#include "core/gimpdrawableundo.h"
+#include "core/gimpimage.h"
+#include "core/gimpimage-flip.h"
+#include "core/gimpimage-undo.h"
+#include "core/gimplayer.h"
+#include "core/gimplayer-new.h"
+#include "core/gimppickable.h"
+#include "core/gimppickable-contiguous-region.h"
+#include "core/gimptempbuf.h"
+#include "core/gimpundostack.h"
+
+#include "operations/gimplevelsconfig.h"
+
+#include "tests.h"
+
+#include "gimp-app-test-utils.h"
+
+
+#define GIMP_TEST_IMAGE_SIZE 100
+#define GIMP_TEST_LAYER_SIZE 512
+
+#define ADD_IMAGE_TEST(function) \
+  g_test_add ("/gimp-core/" #function, \
+              GimpTestFixture, \
+              gimp, \
+              gimp_test_image_setup, \
+              function, \
+              gimp_test_image_teardown);
+
+#define ADD_TEST(function) \
+  g_test_add ("/gimp-core/" #function, \
+              GimpTestFixture, \
+              gimp, \
+              NULL, \
+              function, \
+              NULL);
+
+
+typedef struct
+{
+  GimpImage *image;
+} GimpTestFixture;
+
+
+static void gimp_test_image_setup    (GimpTestFixture *fixture,
+                                      gconstpointer    data);
+static void gimp_test_image_teardown (GimpTestFixture *fixture,
+                                      gconstpointer    data);
+
+
+/**
+ * gimp_test_image_setup:
+ * @fixture:
+ * @data:
+ *
+ * Test fixture setup for a single image.
+ **/
+static void
+gimp_test_image_setup (GimpTestFixture *fixture,
+                       gconstpointer    data)
+{
+  Gimp *gimp = GIMP (data);
+
+  fixture->image = gimp_image_new (gimp,
+                                   GIMP_TEST_IMAGE_SIZE,
+                                   GIMP_TEST_IMAGE_SIZE,
+                                   GIMP_RGB,
+                                   GIMP_PRECISION_FLOAT_LINEAR);
+}
+
+/**
+ * gimp_test_image_teardown:
+ * @fixture:
+ * @data:
+ *
+ * Test fixture teardown for a single image.
+ **/
+static void
+gimp_test_image_teardown (GimpTestFixture *fixture,
+                          gconstpointer    data)
+{
+  g_object_unref (fixture->image);
+}
+
+/**
+ * rotate_non_overlapping:
+ * @fixture:
+ * @data:
+ *
+ * Super basic test that makes sure we can add a layer
+ * and call gimp_item_rotate with center at (0, -10)
+ * without triggering a failed assertion .
+ **/
+static void
+rotate_non_overlapping (GimpTestFixture *fixture,
+                        gconstpointer    data)
+{
+  Gimp        *gimp    = GIMP (data);
+  GimpImage   *image   = fixture->image;
+  GimpLayer   *layer;
+  GimpContext *context = gimp_context_new (gimp, "Test", NULL /*template*/);
+  gboolean     result;
+
+  g_assert_cmpint (gimp_image_get_n_layers (image), ==, 0);
+
+  layer = gimp_layer_new (image,
+                          GIMP_TEST_IMAGE_SIZE,
+                          GIMP_TEST_IMAGE_SIZE,
+                          babl_format ("R'G'B'A u8"),
+                          "Test Layer",
+                          GIMP_OPACITY_OPAQUE,
+                          GIMP_LAYER_MODE_NORMAL);
+
+  g_assert_cmpint (GIMP_IS_LAYER (layer), ==, TRUE);
+
+  result = gimp_image_add_layer (image,
+                                 layer,
+                                 GIMP_IMAGE_ACTIVE_PARENT,
+                                 0,
+                                 FALSE);
+
+  gimp_item_rotate (GIMP_ITEM (layer), context, GIMP_ROTATE_90, 0., -10., TRUE);
+
+  g_assert_cmpint (result, ==, TRUE);
+  g_assert_cmpint (gimp_image_get_n_layers (image), ==, 1);
+  g_object_unref (context);
+}
+
+/**
+ * add_layer:
+ * @fixture:
+ * @data:
+ *
+ * Super basic test that makes sure we can add a layer.
+ **/
+static void
+add_layer (GimpTestFixture *fixture,
+           gconstpointer    data)
+{
+  GimpImage *image = fixture->image;
+  GimpLayer *layer;
+  gboolean   result;
+
+  g_assert_cmpint (gimp_image_get_n_layers (image), ==, 0);
+
+  layer = gimp_layer_new (image,
+                          GIMP_TEST_IMAGE_SIZE,
+                          GIMP_TEST_IMAGE_SIZE,
+                          babl_format ("R'G'B'A u8"),
+                          "Test Layer",
+                          GIMP_OPACITY_OPAQUE,
+                          GIMP_LAYER_MODE_NORMAL);
+
+  g_assert_cmpint (GIMP_IS_LAYER (layer), ==, TRUE);
+
+  result = gimp_image_add_layer (image,
+                                 layer,
+                                 GIMP_IMAGE_ACTIVE_PARENT,
+                                 0,
+                                 FALSE);
+
+  g_assert_cmpint (result, ==, TRUE);
+  g_assert_cmpint (gimp_image_get_n_layers (image), ==, 1);
+}
+
+/**
+ * remove_layer:
+ * @fixture:
+ * @data:
+ *
+ * Super basic test that makes sure we can remove a layer.
+ **/
+static void
+remove_layer (GimpTestFixture *fixture,
+              gconstpointer    data)
+{
+  GimpImage *image = fixture->image;
+  GimpLayer *layer;
+  gboolean   result;
+
+  g_assert_cmpint (gimp_image_get_n_layers (image), ==, 0);
+
+  layer = gimp_layer_new (image,
+                          GIMP_TEST_IMAGE_SIZE,
+                          GIMP_TEST_IMAGE_SIZE,
+                          babl_format ("R'G'B'A u8"),
+                          "Test Layer",
+                          GIMP_OPACITY_OPAQUE,
+                          GIMP_LAYER_MODE_NORMAL);
+
+  g_assert_cmpint (GIMP_IS_LAYER (layer), ==, TRUE);
+
+  result = gimp_image_add_layer (image,
+                                 layer,
+                                 GIMP_IMAGE_ACTIVE_PARENT,
+                                 0,
+                                 FALSE);
+
+  g_assert_cmpint (result, ==, TRUE);
+  g_assert_cmpint (gimp_image_get_n_layers (image), ==, 1);
+
+  gimp_image_remove_layer (image,
+                           layer,
+                           FALSE,
+                           NULL);
+
+  g_assert_cmpint (gimp_image_get_n_layers (image), ==, 0);
+}
+
+static void
+assert_pixel (GimpDrawable *drawable,
+              gint          x,
+              gint          y,
+              const guchar *expected)
+{
+  guchar pixel[4];
+
+  gegl_buffer_sample (gimp_drawable_get_buffer (drawable), x, y, NULL,
+                      pixel, babl_format ("R'G'B'A u8"),
+                      GEGL_SAMPLER_NEAREST, GEGL_ABYSS_NONE);
+
+  g_assert_cmpmem (pixel, 4, expected, 4);
+}
+
+/**
+ * sparse_drawable_undo:
+ * @fixture:
+ * @data:
+ *
+ * Makes sure that a drawable undo pushed after the drawable was
+ * modified only keeps the changed tiles, and that it restores the
+ * original pixels, also after being moved to a swap file.
+ **/
+static void
+sparse_drawable_undo (GimpTestFixture *fixture,
+                      gconstpointer    data)
+{
+  static const guchar  clear[4] = { 0,   0, 0,   0 };
+  static const guchar  red[4]   = { 255, 0, 0, 255 };
+  GimpImage           *image    = fixture->image;
+  GimpDrawable        *drawable;
+  GimpLayer           *layer;
+  GimpDrawableUndo    *undo;
+  GeglBuffer          *original;
+  GeglColor           *color;
+  GFile               *swap_dir;
+  gchar               *swap_path;
+  const GeglRectangle *rect;
+
+  layer = gimp_layer_new (image,
+                          GIMP_TEST_LAYER_SIZE,
+                          GIMP_TEST_LAYER_SIZE,
+                          babl_format ("R'G'B'A u8"),
+                          "Test Layer",
+                          GIMP_OPACITY_OPAQUE,
+                          GIMP_LAYER_MODE_NORMAL);
+  gimp_image_add_layer (image, layer, GIMP_IMAGE_ACTIVE_PARENT, 0, FALSE);
+
+  drawable = GIMP_DRAWABLE (layer);
+
+  original = gegl_buffer_dup (gimp_drawable_get_buffer (drawable));
+
+  color = gegl_color_new ("red");
+  gegl_buffer_set_color (gimp_drawable_get_buffer (drawable),
+                         GEGL_RECTANGLE (10, 10, 4, 4), color);
+  g_object_unref (color);
+
+  gimp_drawable_push_undo (drawable, "Test", original,
+                           0, 0,
+                           GIMP_TEST_LAYER_SIZE, GIMP_TEST_LAYER_SIZE);
+  g_object_unref (original);
+
+  undo = GIMP_DRAWABLE_UNDO (gimp_undo_stack_peek (gimp_image_get_undo_stack (image)));
+
+  /*  only the tile containing the modified pixels is kept  */
+  g_assert_cmpint (undo->tiles->len, ==, 1);
+
+  rect = &g_array_index (undo->tiles, GeglRectangle, 0);
+  g_assert_cmpint (rect->x, ==, 0);
+  g_assert_cmpint (rect->y, ==, 0);
+  g_assert_cmpint (rect->width,  <, GIMP_TEST_LAYER_SIZE);
+  g_assert_cmpint (rect->height, <, GIMP_TEST_LAYER_SIZE);
+
+  gimp_image_undo (image);
+  assert_pixel (drawable, 11, 11, clear);
+
+  gimp_image_redo (image);
+  assert_pixel (drawable, 11, 11, red);
+
+  swap_path = g_dir_make_tmp ("gimp-test-XXXXXX", NULL);
+  g_assert_nonnull (swap_path);
+
+  swap_dir = g_file_new_for_path (swap_path);
+
+  g_assert_true (gimp_drawable_undo_spill (undo, swap_dir));
+  g_assert_true (gimp_drawable_undo_is_spilled (undo));
+
+  /*  the spill happens in the background  */
+  gimp_drawable_undo_wait (undo);
+  g_assert_true (gimp_drawable_undo_is_spilled (undo));
+  g_assert_nonnull (undo->swap_file);
+  g_assert_null (undo->buffer);
+  g_assert_null (undo->compressed);
+
+  /*  a second spill is a no-op  */
+  g_assert_false (gimp_drawable_undo_spill (undo, swap_dir));
+
+  gimp_image_undo (image);
+  assert_pixel (drawable, 11, 11, clear);
+  g_assert_false (gimp_drawable_undo_is_spilled (undo));
+
+  g_object_unref (swap_dir);
+  g_rmdir (swap_path);
+  g_free (swap_path);
+}
+
+/**
+ * contiguous_region_by_seed:
+ * @fixture:
+ * @data:
+ *
+ * Makes sure a region spanning several tiles is found as a whole, that
+ * unconnected pixels of the same color are left out, both by the
+ * scanline fill and the labeling, that the pickable is only labeled
+ * once the fill is repeated, and that a cached labeling isn't reused
+ * once the drawable changes.
+ **/
+static void
+contiguous_region_by_seed (GimpTestFixture *fixture,
+                           gconstpointer    data)
+{
+  GimpImage    *image = fixture->image;
+  GimpDrawable *drawable;
+  GimpLayer    *layer;
+  GeglBuffer   *mask;
+  GeglColor    *color;
+  gfloat        value;
+  gint          i;
+
+  layer = gimp_layer_new (image,
+                          GIMP_TEST_LAYER_SIZE,
+                          GIMP_TEST_LAYER_SIZE,
+                          babl_format ("R'G'B'A u8"),
+                          "Test Layer",
+                          GIMP_OPACITY_OPAQUE,
+                          GIMP_LAYER_MODE_NORMAL);
+  gimp_image_add_layer (image, layer, GIMP_IMAGE_ACTIVE_PARENT, 0, FALSE);
+
+  drawable = GIMP_DRAWABLE (layer);
+
+  color = gegl_color_new ("red");
+  gegl_buffer_set_color (gimp_drawable_get_buffer (drawable),
+                         GEGL_RECTANGLE (10, 60, 300, 10), color);
+  gegl_buffer_set_color (gimp_drawable_get_buffer (drawable),
+                         GEGL_RECTANGLE (400, 400, 20, 20), color);
+
+  /*  the first run uses the scanline fill, the second labels the
+   *  pickable, and the third uses the cached labeling
+   */
+  for (i = 0; i < 3; i++)
+    {
+      mask = gimp_pickable_contiguous_region_by_seed (GIMP_PICKABLE (drawable),
+                                                      FALSE, 0.0, FALSE,
+                                                      GIMP_SELECT_CRITERION_COMPOSITE,
+                                                      FALSE, 20, 65);
+
+      gegl_buffer_sample (mask, 300, 69, NULL, &value, babl_format ("Y float"),
+                          GEGL_SAMPLER_NEAREST, GEGL_ABYSS_NONE);
+      g_assert_cmpfloat (value, ==, 1.0);
+
+      gegl_buffer_sample (mask, 300, 70, NULL, &value, babl_format ("Y float"),
+                          GEGL_SAMPLER_NEAREST, GEGL_ABYSS_NONE);
+      g_assert_cmpfloat (value, ==, 0.0);
+
+      gegl_buffer_sample (mask, 410, 410, NULL, &value, babl_format ("Y float"),
+                          GEGL_SAMPLER_NEAREST, GEGL_ABYSS_NONE);
+      g_assert_cmpfloat (value, ==, 0.0);
+
+      g_object_unref (mask);
+
+      if (i == 0)
+        g_assert_cmpint (gimp_pickable_contiguous_region_get_cache_memsize (GIMP_PICKABLE (drawable)), ==, 0);
+      else
+        g_assert_cmpint (gimp_pickable_contiguous_region_get_cache_memsize (GIMP_PICKABLE (drawable)), >, 0);
+    }
+
+  /*  connect the square to the bar  */
+  gegl_buffer_set_color (gimp_drawable_get_buffer (drawable),
+                         GEGL_RECTANGLE (300, 60, 110, 350), color);
+  g_object_unref (color);
+
+  mask = gimp_pickable_contiguous_region_by_seed (GIMP_PICKABLE (drawable),
+                                                  FALSE, 0.0, FALSE,
+                                                  GIMP_SELECT_CRITERION_COMPOSITE,
+                                                  FALSE, 20, 65);
+
+  gegl_buffer_sample (mask, 410, 410, NULL, &value, babl_format ("Y float"),
+                      GEGL_SAMPLER_NEAREST, GEGL_ABYSS_NONE);
+  g_assert_cmpfloat (value, ==, 1.0);
+
+  g_object_unref (mask);
+}
+
+/**
+ * incremental_channel_boundary:
+ * @fixture:
+ * @data:
+ *
+ * Makes sure that the boundary of a channel which is rebuilt from its
+ * per-tile cache after a local change is the same as the boundary
+ * computed from scratch.
+ **/
+static void
+incremental_channel_boundary (GimpTestFixture *fixture,
+                              gconstpointer    data)
+{
+  GimpImage          *image = fixture->image;
+  GimpChannel        *channel;
+  GimpChannel        *copy;
+  const GimpBoundSeg *segs_in;
+  const GimpBoundSeg *segs_out;
+  const GimpBoundSeg *copy_segs_in;
+  const GimpBoundSeg *copy_segs_out;
+  gint                n_segs_in;
+  gint                n_segs_out;
+  gint                n_copy_segs_in;
+  gint                n_copy_segs_out;
+  gint                i;
+
+  channel = gimp_channel_new (image,
+                              GIMP_TEST_LAYER_SIZE,
+                              GIMP_TEST_LAYER_SIZE,
+                              "Test Channel",
+                              NULL);
+  g_object_ref_sink (channel);
+
+  gimp_channel_combine_rect (channel, GIMP_CHANNEL_OP_ADD, 20, 20, 400, 300);
+  gimp_channel_combine_rect (channel, GIMP_CHANNEL_OP_ADD, 100, 350, 50, 50);
+
+  gimp_channel_boundary (channel,
+                         &segs_in, &segs_out, &n_segs_in, &n_segs_out,
+                         0, 0, GIMP_TEST_LAYER_SIZE, GIMP_TEST_LAYER_SIZE);
+  g_assert_cmpint (n_segs_in, >, 0);
+
+  /*  only the tiles touched by the ellipse are recomputed  */
+  gimp_channel_combine_ellipse (channel, GIMP_CHANNEL_OP_SUBTRACT,
+                                300, 250, 150, 100, FALSE);
+
+  gimp_channel_boundary (channel,
+                         &segs_in, &segs_out, &n_segs_in, &n_segs_out,
+                         0, 0, GIMP_TEST_LAYER_SIZE, GIMP_TEST_LAYER_SIZE);
+
+  copy = GIMP_CHANNEL (gimp_item_duplicate (GIMP_ITEM (channel),
+                                            GIMP_TYPE_CHANNEL));
+  g_object_ref_sink (copy);
+
+  gimp_channel_boundary (copy,
+                         &copy_segs_in, &copy_segs_out,
+                         &n_copy_segs_in, &n_copy_segs_out,
+                         0, 0, GIMP_TEST_LAYER_SIZE, GIMP_TEST_LAYER_SIZE);
+
+  g_assert_cmpint (n_segs_in,  ==, n_copy_segs_in);
+  g_assert_cmpint (n_segs_out, ==, n_copy_segs_out);
+
+  for (i = 0; i < n_segs_in; i++)
+    {
+      g_assert_cmpint (segs_in[i].x1,   ==, copy_segs_in[i].x1);
+      g_assert_cmpint (segs_in[i].y1,   ==, copy_segs_in[i].y1);
+      g_assert_cmpint (segs_in[i].x2,   ==, copy_segs_in[i].x2);
+      g_assert_cmpint (segs_in[i].y2,   ==, copy_segs_in[i].y2);
+      g_assert_cmpint (segs_in[i].open, ==, copy_segs_in[i].open);
+    }
+
+  g_object_unref (copy);
+  g_object_unref (channel);
+}
+
+/**
+ * image_flip_layers:
+ * @fixture:
+ * @data:
+ *
+ * Makes sure that flipping the image, which flips the pixels of all
+ * layers in parallel, moves each layer and its pixels to where
+ * flipping them one by one would.
+ **/
+static void
+image_flip_layers (GimpTestFixture *fixture,
+                   gconstpointer    data)
+{
+  static const guchar  clear[4] = { 0,   0, 0,   0 };
+  static const guchar  red[4]   = { 255, 0, 0, 255 };
+  Gimp                *gimp     = GIMP (data);
+  GimpImage           *image    = fixture->image;
+  GimpContext         *context  = gimp_context_new (gimp, "Test", NULL);
+  GimpLayer           *layers[2];
+  GeglColor           *color;
+  gint                 i;
+
+  color = gegl_color_new ("red");
+
+  for (i = 0; i < G_N_ELEMENTS (layers); i++)
+    {
+      layers[i] = gimp_layer_new (image,
+                                  40, 30,
+                                  babl_format ("R'G'B'A u8"),
+                                  "Test Layer",
+                                  GIMP_OPACITY_OPAQUE,
+                                  GIMP_LAYER_MODE_NORMAL);
+      gimp_image_add_layer (image, layers[i],
+                            GIMP_IMAGE_ACTIVE_PARENT, 0, FALSE);
+
+      gimp_item_set_offset (GIMP_ITEM (layers[i]), 10, 20 + 40 * i);
+
+      gegl_buffer_set_color (gimp_drawable_get_buffer (GIMP_DRAWABLE (layers[i])),
+                             GEGL_RECTANGLE (0, 0, 5, 30), color);
+    }
+
+  g_object_unref (color);
+
+  gimp_image_flip (image, context, GIMP_ORIENTATION_HORIZONTAL, NULL);
+
+  for (i = 0; i < G_N_ELEMENTS (layers); i++)
+    {
+      GimpDrawable *drawable = GIMP_DRAWABLE (layers[i]);
+
+      g_assert_cmpint (gimp_item_get_offset_x (GIMP_ITEM (drawable)), ==, 50);
+      g_assert_cmpint (gimp_item_get_offset_y (GIMP_ITEM (drawable)), ==,
+                       20 + 40 * i);
+
+      assert_pixel (drawable,  0, 0, clear);
+      assert_pixel (drawable, 34, 0, clear);
+      assert_pixel (drawable, 35, 0, red);
+      assert_pixel (drawable, 39, 29, red);
+    }
+
+  gimp_image_undo (image);
+
+  for (i = 0; i < G_N_ELEMENTS (layers); i++)
+    {
+      GimpDrawable *drawable = GIMP_DRAWABLE (layers[i]);
+
+      g_assert_cmpint (gimp_item_get_offset_x (GIMP_ITEM (drawable)), ==, 10);
+
+      assert_pixel (drawable,  0, 0, red);
+      assert_pixel (drawable, 39, 0, clear);
+    }
+
+  g_object_unref (context);
+}
+
+/**
+ * white_graypoint_in_red_levels:
+ * @fixture:
+ * @data:
+ *
+ * Makes sure the levels algorithm can handle when the graypoint is
+ * white. It's easy to get a divide by zero problem when trying to
+ * calculate what gamma will give a white graypoint.
+ **/
+static void
+white_graypoint_in_red_levels (GimpTestFixture *fixture,
+                               gconstpointer    data)
+{
+  GimpRGB              black   = { 0, 0, 0, 0 };
+  GimpRGB              gray    = { 1, 1, 1, 1 };
+  GimpRGB              white   = { 1, 1, 1, 1 };
+  GimpHistogramChannel channel = GIMP_HISTOGRAM_RED;
+  GimpLevelsConfig    *config;
+
+  config = g_object_new (GIMP_TYPE_LEVELS_CONFIG, NULL);
+
+  gimp_levels_config_adjust_by_colors (config,
+                                       channel,
+                                       &black,
+                                       &gray,
+                                       &white);
+
+  /* Make sure we didn't end up with an invalid gamma value */
+  g_object_set (config,
+                "gamma", config->gamma[channel],
+                NULL);
+}
+
+/**
+ * data_index_round_trip:
+ * @fixture:
+ * @data:
+ *
+ * Makes sure a saved data index reads back the same entries, and
+ * that an entry is only returned while the file's mtime and size
+ * still match.
+ **/
+static void
+data_index_round_trip (GimpTestFixture *fixture,
+                       gconstpointer    data)
+{
+  GimpDataIndex            *index;
+  GimpDataIndexEntry       *entry;
+  const GimpDataIndexEntry *found;
+  GFile                    *index_file;
+  GFile                    *data_file;
+  GFileIOStream            *iostream;
+  GError                   *error = NULL;
+
+  index_file = g_file_new_tmp ("gimp-data-index-XXXXXX", &iostream, &error);
+  g_assert_no_error (error);
+  g_object_unref (iostream);
+
+  data_file = g_file_new_for_path ("/nonexistent/pattern.pat");
+
+  index = gimp_data_index_new (index_file);
+
+  entry = gimp_data_index_insert (index, data_file, 1234, 5678);
+  entry->name     = g_strdup ("Pattern");
+  entry->checksum = g_strdup ("0123456789abcdef");
+  entry->width    = 100;
+  entry->height   = 80;
+  entry->spacing  = 25;
+  entry->preview  = gimp_temp_buf_new (64, 64, babl_format ("R'G'B' u8"));
+  memset (gimp_temp_buf_get_data (entry->preview), 42,
+          gimp_temp_buf_get_data_size (entry->preview));
+
+  g_assert (gimp_data_index_is_dirty (index));
+  g_assert (gimp_data_index_save (index, &error));
+  g_assert_no_error (error);
+  gimp_data_index_free (index);
+
+  index = gimp_data_index_new (index_file);
+  g_assert (gimp_data_index_load (index, &error));
+  g_assert_no_error (error);
+  g_assert (! gimp_data_index_is_dirty (index));
+
+  found = gimp_data_index_lookup (index, data_file, 1234, 5678);
+  g_assert (found != NULL);
+  g_assert_cmpstr (found->name,     ==, "Pattern");
+  g_assert_cmpstr (found->checksum, ==, "0123456789abcdef");
+  g_assert_cmpint (found->width,    ==, 100);
+  g_assert_cmpint (found->height,   ==, 80);
+  g_assert_cmpint (found->spacing,  ==, 25);
+  g_assert (found->preview != NULL);
+  g_assert_cmpint (gimp_temp_buf_get_width (found->preview), ==, 64);
+  g_assert (gimp_temp_buf_get_format (found->preview) ==
+            babl_format ("R'G'B' u8"));
+  g_assert_cmpint (gimp_temp_buf_get_data (found->preview)[0], ==, 42);
+
+  /*  a modified file invalidates its entry  */
+  g_assert (gimp_data_index_lookup (index, data_file, 1235, 5678) == NULL);
+  g_assert (gimp_data_index_is_dirty (index));
+
+  gimp_data_index_free (index);
+
+  g_file_delete (index_file, NULL, NULL);
+  g_object_unref (index_file);
+  g_object_unref (data_file);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  Gimp *gimp;
+  int   result;
+
+  g_test_init (&argc, &argv, NULL);
+
+  gimp_test_utils_set_gimp2_directory ("GIMP_TESTING_ABS_TOP_SRCDIR",
+                                       "app/tests/gimpdir");
+
+  /* We share the same application instance across all tests */
+  gimp = gimp_init_for_testing ();
+
+  /* Add tests */
+  ADD_IMAGE_TEST (add_layer);
+  ADD_IMAGE_TEST (remove_layer);
+  ADD_IMAGE_TEST (rotate_non_overlapping);
+  ADD_IMAGE_TEST (sparse_drawable_undo);
+  ADD_IMAGE_TEST (contiguous_region_by_seed);
+  ADD_IMAGE_TEST (incremental_channel_boundary);
+  ADD_IMAGE_TEST (image_flip_layers);
+  ADD_TEST (data_index_round_trip);
+  ADD_TEST (white_graypoint_in_red_levels);
+
+  /* Run the tests */
+  result = g_test_run ();
+
+  /* Don't write files to the source dir */
+  gimp_test_utils_set_gimp2_directory ("GIMP_TESTING_ABS_TOP_BUILDDIR",
+                                       "app/tests/gimpdir-output");
+
+  /* Exit so we don't break script-fu plug-in wire */
+  gimp_exit (gimp, TRUE);
+
+  return result;
+}
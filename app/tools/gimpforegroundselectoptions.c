@@ -51,7 +51,8 @@ enum
   PROP_ENGINE,
   PROP_ITERATIONS,
   PROP_LEVELS,
-  PROP_ACTIVE_LEVELS
+  PROP_ACTIVE_LEVELS,
+  PROP_PROGRESSIVE
 };
 
 
@@ -131,6 +132,14 @@ gimp_foreground_select_options_class_init (GimpForegroundSelectOptionsClass *kla
                          _("Number of iterations to perform"),
                          1, 10, 2,
                          GIMP_PARAM_STATIC_STRINGS);
+
+  GIMP_CONFIG_PROP_BOOLEAN (object_class, PROP_PROGRESSIVE,
+                            "progressive",
+                            _("Progressive preview"),
+                            _("Show a preview computed at a lower resolution "
+                              "first, and refine it in the background"),
+                            TRUE,
+                            GIMP_PARAM_STATIC_STRINGS);
 }
 
 static void
@@ -181,6 +190,10 @@ gimp_foreground_select_options_set_property (GObject      *object,
       options->iterations = g_value_get_int (value);
       break;
 
+    case PROP_PROGRESSIVE:
+      options->progressive = g_value_get_boolean (value);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -225,6 +238,10 @@ gimp_foreground_select_options_get_property (GObject    *object,
       g_value_set_int (value, options->iterations);
       break;
 
+    case PROP_PROGRESSIVE:
+      g_value_set_boolean (value, options->progressive);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -362,6 +379,11 @@ gimp_foreground_select_options_gui (GimpToolOptions *tool_options)
                                GINT_TO_POINTER (GIMP_MATTING_ENGINE_GLOBAL),
                                NULL);
 
+  /*  progressive preview  */
+  button = gimp_prop_check_button_new (config, "progressive", NULL);
+  gtk_box_pack_start (GTK_BOX (vbox), button, FALSE, FALSE, 0);
+  gtk_widget_show (button);
+
   return vbox;
 }
 
@@ -45,6 +45,7 @@ struct _GimpForegroundSelectOptions
   gint                  levels;
   gint                  active_levels;
   gint                  iterations;
+  gboolean              progressive;
 };
 
 struct _GimpForegroundSelectOptionsClass
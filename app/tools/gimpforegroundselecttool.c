@@ -37,6 +37,9 @@
 #include "gegl/gimp-gegl-mask.h"
 
 #include "core/gimp.h"
+#include "core/gimp-gui.h"
+#include "core/gimpasync.h"
+#include "core/gimpcancelable.h"
 #include "core/gimpchannel-select.h"
 #include "core/gimpdrawable-foreground-extract.h"
 #include "core/gimperror.h"
@@ -45,6 +48,9 @@
 #include "core/gimplayermask.h"
 #include "core/gimpprogress.h"
 #include "core/gimpscanconvert.h"
+#include "core/gimptoolinfo.h"
+#include "core/gimpuncancelablewaitable.h"
+#include "core/gimpwaitable.h"
 
 #include "widgets/gimphelp-ids.h"
 #include "widgets/gimpwidgets-utils.h"
@@ -149,6 +155,11 @@ static void   gimp_foreground_select_tool_set_trimap     (GimpForegroundSelectTo
 static void   gimp_foreground_select_tool_set_preview    (GimpForegroundSelectTool *fg_select);
 static void   gimp_foreground_select_tool_preview        (GimpForegroundSelectTool *fg_select);
 
+static void   gimp_foreground_select_tool_refine_callback(GimpAsync                *async,
+                                                          GimpForegroundSelectTool *fg_select);
+static void   gimp_foreground_select_tool_refine_cancel  (GimpForegroundSelectTool *fg_select);
+static void   gimp_foreground_select_tool_refine_wait    (GimpForegroundSelectTool *fg_select);
+
 static void   gimp_foreground_select_tool_stroke_paint   (GimpForegroundSelectTool *fg_select);
 static void   gimp_foreground_select_tool_cancel_paint   (GimpForegroundSelectTool *fg_select);
 
@@ -262,6 +273,9 @@ gimp_foreground_select_tool_finalize (GObject *object)
   if (fg_select->mask)
     g_warning ("%s: mask should be NULL at this point", G_STRLOC);
 
+  if (fg_select->refine_async)
+    g_warning ("%s: refine_async should be NULL at this point", G_STRLOC);
+
   if (fg_select->trimap)
     g_warning ("%s: mask should be NULL at this point", G_STRLOC);
 
@@ -394,6 +408,9 @@ gimp_foreground_select_tool_button_press (GimpTool            *tool,
     {
       GimpVector2 point = gimp_vector2_new (coords->x, coords->y);
 
+      /*  the trimap is about to change, the refined mask would be stale  */
+      gimp_foreground_select_tool_refine_cancel (fg_select);
+
       gimp_draw_tool_pause (draw_tool);
 
       if (gimp_draw_tool_is_active (draw_tool) && draw_tool->display != display)
@@ -930,8 +947,11 @@ gimp_foreground_select_tool_halt (GimpForegroundSelectTool *fg_select)
 {
   GimpTool *tool = GIMP_TOOL (fg_select);
 
+  gimp_foreground_select_tool_refine_cancel (fg_select);
+
   g_clear_object (&fg_select->trimap);
   g_clear_object (&fg_select->mask);
+  fg_select->mask_coarse = FALSE;
 
   if (fg_select->undo_stack)
     {
@@ -991,6 +1011,32 @@ gimp_foreground_select_tool_commit (GimpForegroundSelectTool *fg_select)
       if (fg_select->state != MATTING_STATE_PREVIEW_MASK)
         gimp_foreground_select_tool_preview (fg_select);
 
+      gimp_foreground_select_tool_refine_wait (fg_select);
+
+      /*  never commit the downsampled preview, if its refinement was
+       *  canceled, compute the mask at full resolution instead
+       */
+      if (fg_select->mask_coarse)
+        {
+          GimpForegroundSelectOptions *fg_options;
+          GimpDrawable                *drawable;
+
+          fg_options = GIMP_FOREGROUND_SELECT_TOOL_GET_OPTIONS (tool);
+          drawable   = gimp_image_get_active_drawable (image);
+
+          g_clear_object (&fg_select->mask);
+
+          fg_select->mask =
+            gimp_drawable_foreground_extract (drawable,
+                                              fg_options->engine,
+                                              fg_options->iterations,
+                                              fg_options->levels,
+                                              fg_options->active_levels,
+                                              fg_select->trimap,
+                                              GIMP_PROGRESS (fg_select));
+          fg_select->mask_coarse = FALSE;
+        }
+
       gimp_channel_select_buffer (gimp_image_get_mask (image),
                                   C_("command", "Foreground Select"),
                                   fg_select->mask,
@@ -1079,19 +1125,133 @@ gimp_foreground_select_tool_preview (GimpForegroundSelectTool *fg_select)
 
   options  = GIMP_FOREGROUND_SELECT_TOOL_GET_OPTIONS (tool);
 
+  gimp_foreground_select_tool_refine_cancel (fg_select);
+
   g_clear_object (&fg_select->mask);
 
-  fg_select->mask = gimp_drawable_foreground_extract (drawable,
-                                                      options->engine,
-                                                      options->iterations,
-                                                      options->levels,
-                                                      options->active_levels,
-                                                      fg_select->trimap,
-                                                      GIMP_PROGRESS (fg_select));
+  if (options->progressive)
+    {
+      gboolean coarse;
+
+      fg_select->mask =
+        gimp_drawable_foreground_extract_preview (drawable,
+                                                  options->engine,
+                                                  options->iterations,
+                                                  options->levels,
+                                                  options->active_levels,
+                                                  fg_select->trimap,
+                                                  GIMP_PROGRESS (fg_select),
+                                                  &coarse);
+
+      fg_select->mask_coarse = coarse;
+
+      /*  show the coarse mask right away, and replace it once the
+       *  uncertain band has been refined at full resolution
+       */
+      if (coarse)
+        {
+          fg_select->refine_async =
+            gimp_drawable_foreground_extract_refine_async (drawable,
+                                                           options->engine,
+                                                           options->iterations,
+                                                           options->levels,
+                                                           options->active_levels,
+                                                           fg_select->trimap,
+                                                           fg_select->mask);
+
+          gimp_async_add_callback_for_object (
+            fg_select->refine_async,
+            (GimpAsyncCallback) gimp_foreground_select_tool_refine_callback,
+            fg_select,
+            fg_select);
+        }
+    }
+  else
+    {
+      fg_select->mask =
+        gimp_drawable_foreground_extract (drawable,
+                                          options->engine,
+                                          options->iterations,
+                                          options->levels,
+                                          options->active_levels,
+                                          fg_select->trimap,
+                                          GIMP_PROGRESS (fg_select));
+      fg_select->mask_coarse = FALSE;
+    }
 
   gimp_foreground_select_tool_set_preview (fg_select);
 }
 
+static void
+gimp_foreground_select_tool_refine_callback (GimpAsync                *async,
+                                             GimpForegroundSelectTool *fg_select)
+{
+  if (gimp_async_is_finished (async))
+    {
+      g_clear_object (&fg_select->mask);
+      fg_select->mask        = g_object_ref (gimp_async_get_result (async));
+      fg_select->mask_coarse = FALSE;
+
+      if (fg_select->state == MATTING_STATE_PREVIEW_MASK)
+        gimp_foreground_select_tool_set_preview (fg_select);
+    }
+
+  g_clear_object (&fg_select->refine_async);
+}
+
+static void
+gimp_foreground_select_tool_refine_cancel (GimpForegroundSelectTool *fg_select)
+{
+  if (fg_select->refine_async)
+    {
+      gimp_async_remove_callback (
+        fg_select->refine_async,
+        (GimpAsyncCallback) gimp_foreground_select_tool_refine_callback,
+        fg_select);
+
+      /*  don't wait for the block the worker is solving, it only works
+       *  on copies, and notices the cancellation before the next one
+       */
+      gimp_cancelable_cancel (GIMP_CANCELABLE (fg_select->refine_async));
+
+      g_clear_object (&fg_select->refine_async);
+    }
+}
+
+static void
+gimp_foreground_select_tool_refine_wait (GimpForegroundSelectTool *fg_select)
+{
+  GimpTool     *tool = GIMP_TOOL (fg_select);
+  GimpAsync    *async;
+  GimpWaitable *waitable;
+
+  if (! fg_select->refine_async)
+    return;
+
+  async = g_object_ref (fg_select->refine_async);
+
+  gimp_async_remove_callback (
+    async,
+    (GimpAsyncCallback) gimp_foreground_select_tool_refine_callback,
+    fg_select);
+
+  /*  the commit can't be undone by canceling the wait, since the tool
+   *  is halted right after it
+   */
+  waitable = gimp_uncancelable_waitable_new (GIMP_WAITABLE (async));
+
+  gimp_wait (tool->tool_info->gimp, waitable,
+             _("Refining foreground mask..."));
+
+  g_object_unref (waitable);
+
+  gimp_waitable_wait (GIMP_WAITABLE (async));
+
+  gimp_foreground_select_tool_refine_callback (async, fg_select);
+
+  g_object_unref (async);
+}
+
 static void
 gimp_foreground_select_tool_stroke_paint (GimpForegroundSelectTool *fg_select)
 {
@@ -53,6 +53,8 @@ struct _GimpForegroundSelectTool
   GArray                *stroke;
   GeglBuffer            *trimap;
   GeglBuffer            *mask;
+  gboolean               mask_coarse;  /*  mask is a downsampled preview  */
+  GimpAsync             *refine_async;
 
   GList                 *undo_stack;
   GList                 *redo_stack;
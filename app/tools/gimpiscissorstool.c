@@ -83,8 +83,10 @@
 #define  GRADIENT_SEARCH   32  /* how far to look when snapping to an edge */
 #define  EXTEND_BY         0.2 /* proportion to expand cost map by */
 #define  FIXED             5   /* additional fixed size to expand cost map */
+#define  N_LIVEWIRES       2   /* number of path searches to keep around */
 
 #define  COST_WIDTH        2   /* number of bytes for each pixel in cost map  */
+#define  BLOCK_SIZE        64  /* size of the gradient map blocks of a search */
 
 /* weight to give between gradient (_G) and direction (_D) */
 #define  OMEGA_D           0.2
@@ -112,6 +114,40 @@ struct _ICurve
   gboolean  closed;
 };
 
+/*  A shortest path search from a seed point, expanded on demand.  Each
+ *  pixel of dp_buf holds the cost of the cheapest path to the seed point,
+ *  and the link to follow to get there, like the dynamic programming
+ *  buffer this search replaces.  The gradient map is fetched in blocks
+ *  of BLOCK_SIZE x BLOCK_SIZE pixels, when the search first reaches them.
+ */
+struct _ILivewire
+{
+  gint           seed_x, seed_y;
+  GeglRectangle  area;          /*  the area searched                  */
+  GeglBuffer    *gradient_map;
+  gint           block_x;       /*  the first block column and row     */
+  gint           block_y;
+  gint           n_block_cols;
+  gint           n_block_rows;
+  guint8       **blocks;        /*  the gradient map blocks, or NULL   */
+  GimpTempBuf   *dp_buf;        /*  costs and links                    */
+  guint8        *state;         /*  LivewireState of each pixel        */
+  GArray        *queue;         /*  binary heap of LivewireNodes       */
+};
+
+typedef enum
+{
+  LIVEWIRE_UNSEEN,
+  LIVEWIRE_QUEUED,
+  LIVEWIRE_SETTLED
+} LivewireState;
+
+typedef struct
+{
+  guint32 cost;
+  gint32  offset;               /*  of the pixel in dp_buf             */
+} LivewireNode;
+
 
 /*  local function prototypes  */
 
@@ -173,20 +209,25 @@ static void          iscissors_convert         (GimpIscissorsTool *iscissors,
                                                 GimpDisplay       *display);
 static GeglBuffer  * gradient_map_new          (GimpPickable      *pickable);
 
-static void          find_optimal_path         (GeglBuffer        *gradient_map,
-                                                GimpTempBuf       *dp_buf,
-                                                gint               x1,
-                                                gint               y1,
-                                                gint               x2,
-                                                gint               y2,
-                                                gint               xs,
-                                                gint               ys);
+static ILivewire   * livewire_new              (GeglBuffer        *gradient_map,
+                                                const GeglRectangle *area,
+                                                gint               seed_x,
+                                                gint               seed_y);
+static void          livewire_free             (ILivewire         *livewire);
+static ILivewire   * livewire_get              (GimpIscissorsTool *iscissors,
+                                                const GeglRectangle *area,
+                                                gint               seed_x,
+                                                gint               seed_y);
+static void          livewire_search           (ILivewire         *livewire,
+                                                gint               x,
+                                                gint               y);
 static void          find_max_gradient         (GimpIscissorsTool *iscissors,
                                                 GimpPickable      *pickable,
                                                 gint              *x,
                                                 gint              *y);
 static void          calculate_segment         (GimpIscissorsTool *iscissors,
-                                                ISegment          *segment);
+                                                ISegment          *segment,
+                                                gboolean           from_end);
 static GimpCanvasItem * iscissors_draw_segment (GimpDrawTool      *draw_tool,
                                                 ISegment          *segment);
 
@@ -467,7 +508,7 @@ gimp_iscissors_tool_button_press (GimpTool            *tool,
               iscissors->segment1->y1 = iscissors->y;
 
               if (options->interactive)
-                calculate_segment (iscissors, iscissors->segment1);
+                calculate_segment (iscissors, iscissors->segment1, TRUE);
             }
 
           if (iscissors->segment2)
@@ -476,7 +517,7 @@ gimp_iscissors_tool_button_press (GimpTool            *tool,
               iscissors->segment2->y2 = iscissors->y;
 
               if (options->interactive)
-                calculate_segment (iscissors, iscissors->segment2);
+                calculate_segment (iscissors, iscissors->segment2, FALSE);
             }
         }
       /*  If the iscissors is closed, check if the click was inside  */
@@ -504,7 +545,7 @@ gimp_iscissors_tool_button_press (GimpTool            *tool,
               last->y2 = iscissors->y;
 
               if (options->interactive)
-                calculate_segment (iscissors, last);
+                calculate_segment (iscissors, last, FALSE);
             }
           else
             {
@@ -515,7 +556,7 @@ gimp_iscissors_tool_button_press (GimpTool            *tool,
                                                iscissors->y);
 
               if (options->interactive)
-                calculate_segment (iscissors, segment);
+                calculate_segment (iscissors, segment, FALSE);
             }
         }
       break;
@@ -597,7 +638,7 @@ gimp_iscissors_tool_button_release (GimpTool              *tool,
                   if (! options->interactive)
                     {
                       segment = g_queue_peek_tail (iscissors->curve->segments);
-                      calculate_segment (iscissors, segment);
+                      calculate_segment (iscissors, segment, FALSE);
                     }
 
                   gimp_iscissors_tool_free_redo (iscissors);
@@ -610,7 +651,7 @@ gimp_iscissors_tool_button_release (GimpTool              *tool,
                       segment->y1 != segment->y2)
                     {
                       if (! options->interactive)
-                        calculate_segment (iscissors, segment);
+                        calculate_segment (iscissors, segment, FALSE);
 
                       gimp_iscissors_tool_free_redo (iscissors);
                     }
@@ -636,7 +677,7 @@ gimp_iscissors_tool_button_release (GimpTool              *tool,
                   icurve_delete_segment (iscissors->curve,
                                          iscissors->segment2);
 
-                  calculate_segment (iscissors, iscissors->segment1);
+                  calculate_segment (iscissors, iscissors->segment1, FALSE);
                 }
             }
           else
@@ -646,13 +687,13 @@ gimp_iscissors_tool_button_release (GimpTool              *tool,
               if (iscissors->segment1)
                 {
                   if (! options->interactive)
-                    calculate_segment (iscissors, iscissors->segment1);
+                    calculate_segment (iscissors, iscissors->segment1, TRUE);
                 }
 
               if (iscissors->segment2)
                 {
                   if (! options->interactive)
-                    calculate_segment (iscissors, iscissors->segment2);
+                    calculate_segment (iscissors, iscissors->segment2, FALSE);
                 }
             }
 
@@ -733,7 +774,7 @@ gimp_iscissors_tool_motion (GimpTool         *tool,
       else
         {
           if (options->interactive)
-            calculate_segment (iscissors, segment);
+            calculate_segment (iscissors, segment, FALSE);
         }
       break;
 
@@ -744,7 +785,7 @@ gimp_iscissors_tool_motion (GimpTool         *tool,
           iscissors->segment1->y1 = iscissors->y;
 
           if (options->interactive)
-            calculate_segment (iscissors, iscissors->segment1);
+            calculate_segment (iscissors, iscissors->segment1, TRUE);
         }
 
       if (iscissors->segment2)
@@ -753,7 +794,7 @@ gimp_iscissors_tool_motion (GimpTool         *tool,
           iscissors->segment2->y2 = iscissors->y;
 
           if (options->interactive)
-            calculate_segment (iscissors, iscissors->segment2);
+            calculate_segment (iscissors, iscissors->segment2, FALSE);
         }
       break;
 
@@ -1263,6 +1304,12 @@ gimp_iscissors_tool_halt (GimpIscissorsTool *iscissors,
       iscissors->redo_stack = NULL;
     }
 
+  if (iscissors->livewires)
+    {
+      g_list_free_full (iscissors->livewires, (GDestroyNotify) livewire_free);
+      iscissors->livewires = NULL;
+    }
+
   g_clear_object (&iscissors->gradient_map);
   g_clear_object (&iscissors->mask);
 }
@@ -1290,7 +1337,7 @@ gimp_iscissors_tool_commit (GimpIscissorsTool *iscissors,
                                            first->x1,
                                            first->y1);
           icurve_close (iscissors->curve);
-          calculate_segment (iscissors, segment);
+          calculate_segment (iscissors, segment, FALSE);
 
           iscissors_convert (iscissors, display);
         }
@@ -1477,17 +1524,23 @@ clicked_on_segment (GimpIscissorsTool *iscissors,
 }
 
 
+/*  searches from the segment's end instead of its start if from_end is
+ *  TRUE, so that the search is reused while only the start moves, as
+ *  when dragging a vertex.
+ */
 static void
 calculate_segment (GimpIscissorsTool *iscissors,
-                   ISegment          *segment)
+                   ISegment          *segment,
+                   gboolean           from_end)
 {
-  GimpDisplay  *display  = GIMP_TOOL (iscissors)->display;
-  GimpPickable *pickable = GIMP_PICKABLE (gimp_display_get_image (display));
-  gint          width;
-  gint          height;
-  gint          xs, ys, xe, ye;
-  gint          x1, y1, x2, y2;
-  gint          ewidth, eheight;
+  GimpDisplay   *display  = GIMP_TOOL (iscissors)->display;
+  GimpPickable  *pickable = GIMP_PICKABLE (gimp_display_get_image (display));
+  ILivewire     *livewire;
+  gint           width;
+  gint           height;
+  gint           xs, ys, xe, ye;
+  gint           x1, y1, x2, y2;
+  gint           ewidth, eheight;
 
   /* Initialise the gradient map buffer for this pickable if we don't
    * already have one.
@@ -1502,17 +1555,27 @@ calculate_segment (GimpIscissorsTool *iscissors,
    *  by the parameter "segment".
    *    Here are the steps:
    *      1)  Calculate the appropriate working area for this operation
-   *      2)  Allocate a temp buf for the dynamic programming array
-   *      3)  Run the dynamic programming algorithm to find the optimal path
+   *      2)  Find or start a search from the first vertex covering that area
+   *      3)  Expand the search until it reaches the second vertex
    *      4)  Translate the optimal path into pixels in the isegment data
    *            structure.
    */
 
   /*  Get the bounding box  */
-  xs = CLAMP (segment->x1, 0, width  - 1);
-  ys = CLAMP (segment->y1, 0, height - 1);
-  xe = CLAMP (segment->x2, 0, width  - 1);
-  ye = CLAMP (segment->y2, 0, height - 1);
+  if (from_end)
+    {
+      xs = CLAMP (segment->x2, 0, width  - 1);
+      ys = CLAMP (segment->y2, 0, height - 1);
+      xe = CLAMP (segment->x1, 0, width  - 1);
+      ye = CLAMP (segment->y1, 0, height - 1);
+    }
+  else
+    {
+      xs = CLAMP (segment->x1, 0, width  - 1);
+      ys = CLAMP (segment->y1, 0, height - 1);
+      xe = CLAMP (segment->x2, 0, width  - 1);
+      ye = CLAMP (segment->y2, 0, height - 1);
+    }
   x1 = MIN (xs, xe);
   y1 = MIN (ys, ye);
   x2 = MAX (xs, xe) + 1;  /*  +1 because if xe = 199 & xs = 0, x2 - x1, width = 200  */
@@ -1545,125 +1608,132 @@ calculate_segment (GimpIscissorsTool *iscissors,
       segment->points = NULL;
     }
 
-  if ((x2 - x1) && (y2 - y1))
-    {
-      /*  If the bounding box has width and height...  */
-
-      GimpTempBuf *dp_buf; /*  dynamic programming buffer  */
-      gint         dp_width  = (x2 - x1);
-      gint         dp_height = (y2 - y1);
+  livewire = livewire_get (iscissors,
+                           GEGL_RECTANGLE (x1, y1, x2 - x1, y2 - y1),
+                           xs, ys);
 
-      dp_buf = gimp_temp_buf_new (dp_width, dp_height,
-                                  babl_format ("Y u32"));
+  /*  find the optimal path of pixels from (xs, ys) to (xe, ye)  */
+  livewire_search (livewire, xe, ye);
 
-      /*  find the optimal path of pixels from (x1, y1) to (x2, y2)  */
-      find_optimal_path (iscissors->gradient_map, dp_buf,
-                         x1, y1, x2, y2, xs, ys);
+  /*  get a list of the pixels in the optimal path  */
+  segment->points = plot_pixels (livewire->dp_buf,
+                                 livewire->area.x, livewire->area.y,
+                                 xs, ys, xe, ye);
 
-      /*  get a list of the pixels in the optimal path  */
-      segment->points = plot_pixels (dp_buf, x1, y1, xs, ys, xe, ye);
-
-      gimp_temp_buf_unref (dp_buf);
-    }
-  else if ((x2 - x1) == 0)
+  /*  the points go from the search's target back to its seed, keep
+   *  them going from the segment's end to its start
+   */
+  if (from_end)
     {
-      /*  If the bounding box has no width  */
-
-      /*  plot a vertical line  */
-      gint y   = ys;
-      gint dir = (ys > ye) ? -1 : 1;
+      gpointer *points = segment->points->pdata;
+      gint      n      = segment->points->len;
+      gint      i;
 
-      segment->points = g_ptr_array_new ();
-      while (y != ye)
+      for (i = 0; i < n / 2; i++)
         {
-          g_ptr_array_add (segment->points, GINT_TO_POINTER ((y << 16) + xs));
-          y += dir;
-        }
-    }
-  else if ((y2 - y1) == 0)
-    {
-      /*  If the bounding box has no height  */
-
-      /*  plot a horizontal line  */
-      gint x   = xs;
-      gint dir = (xs > xe) ? -1 : 1;
+          gpointer tmp = points[i];
 
-      segment->points = g_ptr_array_new ();
-      while (x != xe)
-        {
-          g_ptr_array_add (segment->points, GINT_TO_POINTER ((ys << 16) + x));
-          x += dir;
+          points[i]         = points[n - 1 - i];
+          points[n - 1 - i] = tmp;
         }
     }
 }
 
 
-/* badly need to get a replacement - this is _way_ too expensive */
-static gboolean
-gradient_map_value (GeglSampler         *map_sampler,
-                    const GeglRectangle *map_extent,
-                    gint                 x,
-                    gint                 y,
-                    guint8              *grad,
-                    guint8              *dir)
+static guint8 *
+livewire_fetch_block (ILivewire *livewire,
+                      gint       col,
+                      gint       row)
 {
-  if (x >= map_extent->x     &&
-      y >= map_extent->y     &&
-      x <  map_extent->width &&
-      y <  map_extent->height)
+  GeglRectangle  rect;
+  guint8        *block;
+
+  rect.x      = (livewire->block_x + col) * BLOCK_SIZE;
+  rect.y      = (livewire->block_y + row) * BLOCK_SIZE;
+  rect.width  = BLOCK_SIZE;
+  rect.height = BLOCK_SIZE;
+
+  gegl_rectangle_intersect (&rect, &rect, &livewire->area);
+
+  block = g_new (guint8, COST_WIDTH * BLOCK_SIZE * BLOCK_SIZE);
+
+  /*  keep the block's layout fixed, so that samples are found the same
+   *  way in clipped blocks
+   */
+  gegl_buffer_get (livewire->gradient_map, &rect, 1.0, NULL,
+                   block + COST_WIDTH * ((rect.y % BLOCK_SIZE) * BLOCK_SIZE +
+                                         (rect.x % BLOCK_SIZE)),
+                   COST_WIDTH * BLOCK_SIZE, GEGL_ABYSS_NONE);
+
+  livewire->blocks[row * livewire->n_block_cols + col] = block;
+
+  return block;
+}
+
+static inline void
+gradient_map_value (ILivewire *livewire,
+                    gint       x,
+                    gint       y,
+                    guint8    *grad,
+                    guint8    *dir)
+{
+  if (x >= livewire->area.x                         &&
+      y >= livewire->area.y                         &&
+      x <  livewire->area.x + livewire->area.width  &&
+      y <  livewire->area.y + livewire->area.height)
     {
-      guint8 sample[2];
+      gint          col   = x / BLOCK_SIZE - livewire->block_x;
+      gint          row   = y / BLOCK_SIZE - livewire->block_y;
+      const guint8 *block = livewire->blocks[row * livewire->n_block_cols + col];
+      const guint8 *sample;
+
+      if (G_UNLIKELY (! block))
+        block = livewire_fetch_block (livewire, col, row);
 
-      gegl_sampler_get (map_sampler, x, y, NULL, sample, GEGL_ABYSS_NONE);
+      sample = block + COST_WIDTH * ((y % BLOCK_SIZE) * BLOCK_SIZE +
+                                     (x % BLOCK_SIZE));
 
       *grad = sample[0];
       *dir  = sample[1];
-
-      return TRUE;
     }
-
-  return FALSE;
+  else
+    {
+      *grad = 0;
+      *dir  = 255;
+    }
 }
 
+/*  the cost of reaching the pixel at (x, y) from its neighbor in the
+ *  direction of link
+ */
 static gint
-calculate_link (GeglSampler         *map_sampler,
-                const GeglRectangle *map_extent,
-                gint                 x,
-                gint                 y,
-                guint32              pixel,
-                gint                 link)
+calculate_link (ILivewire *livewire,
+                gint       x,
+                gint       y,
+                gint       link)
 {
   gint   value = 0;
+  gint   dir   = link & 3;
   guint8 grad1, dir1, grad2, dir2;
 
-  if (! gradient_map_value (map_sampler, map_extent, x, y, &grad1, &dir1))
-    {
-      grad1 = 0;
-      dir1 = 255;
-    }
+  gradient_map_value (livewire, x, y, &grad1, &dir1);
 
   /* Convert the gradient into a cost: large gradients are good, and
    * so have low cost. */
   grad1 = 255 - grad1;
 
   /*  calculate the contribution of the gradient magnitude  */
-  if (link > 1)
+  if (dir > 1)
     value += diagonal_weight[grad1] * OMEGA_G;
   else
     value += grad1 * OMEGA_G;
 
   /*  calculate the contribution of the gradient direction  */
-  x += (gint8)(pixel & 0xff);
-  y += (gint8)((pixel & 0xff00) >> 8);
-
-  if (! gradient_map_value (map_sampler, map_extent, x, y, &grad2, &dir2))
-    {
-      grad2 = 0;
-      dir2 = 255;
-    }
+  gradient_map_value (livewire, x + move[link][0], y + move[link][1],
+                      &grad2, &dir2);
 
   value +=
-    (direction_value[dir1][link] + direction_value[dir2][link]) * OMEGA_D;
+    (direction_value[dir1][dir] + direction_value[dir2][dir]) * OMEGA_D;
 
   return value;
 }
@@ -1712,157 +1782,256 @@ plot_pixels (GimpTempBuf *dp_buf,
 }
 
 
-#define PACK(x, y)    ((((y) & 0xff) << 8) | ((x) & 0xff))
-#define OFFSET(pixel) ((gint8)((pixel) & 0xff) + \
-                       ((gint8)(((pixel) & 0xff00) >> 8)) * \
-                       gimp_temp_buf_get_width (dp_buf))
+static void
+livewire_queue_push (GArray  *queue,
+                     guint32  cost,
+                     gint32   offset)
+{
+  LivewireNode *nodes;
+  gint          i;
+
+  g_array_set_size (queue, queue->len + 1);
+
+  nodes = (LivewireNode *) queue->data;
+
+  for (i = queue->len - 1; i > 0; i = (i - 1) / 2)
+    {
+      gint parent = (i - 1) / 2;
+
+      if (nodes[parent].cost <= cost)
+        break;
+
+      nodes[i] = nodes[parent];
+    }
+
+  nodes[i].cost   = cost;
+  nodes[i].offset = offset;
+}
+
+static LivewireNode
+livewire_queue_pop (GArray *queue)
+{
+  LivewireNode *nodes = (LivewireNode *) queue->data;
+  LivewireNode  top   = nodes[0];
+  LivewireNode  last  = nodes[queue->len - 1];
+  gint          n     = queue->len - 1;
+  gint          i     = 0;
+
+  while (2 * i + 1 < n)
+    {
+      gint child = 2 * i + 1;
+
+      if (child + 1 < n && nodes[child + 1].cost < nodes[child].cost)
+        child++;
+
+      if (last.cost <= nodes[child].cost)
+        break;
+
+      nodes[i] = nodes[child];
+      i = child;
+    }
+
+  nodes[i] = last;
+
+  g_array_set_size (queue, n);
+
+  return top;
+}
+
+static ILivewire *
+livewire_new (GeglBuffer          *gradient_map,
+              const GeglRectangle *area,
+              gint                 seed_x,
+              gint                 seed_y)
+{
+  ILivewire *livewire = g_slice_new0 (ILivewire);
+  guint32   *data;
+  gint32     offset;
+
+  livewire->seed_x       = seed_x;
+  livewire->seed_y       = seed_y;
+  livewire->area         = *area;
+  livewire->gradient_map = g_object_ref (gradient_map);
+
+  /*  the search rarely needs the whole area, so only fetch the blocks
+   *  of the gradient map it actually reaches
+   */
+  livewire->block_x      = area->x / BLOCK_SIZE;
+  livewire->block_y      = area->y / BLOCK_SIZE;
+  livewire->n_block_cols = (area->x + area->width  - 1) / BLOCK_SIZE -
+                           livewire->block_x + 1;
+  livewire->n_block_rows = (area->y + area->height - 1) / BLOCK_SIZE -
+                           livewire->block_y + 1;
+  livewire->blocks       = g_new0 (guint8 *,
+                                   livewire->n_block_cols *
+                                   livewire->n_block_rows);
+
+  livewire->dp_buf  = gimp_temp_buf_new (area->width, area->height,
+                                         babl_format ("Y u32"));
+  livewire->state   = g_new0 (guint8, area->width * area->height);
+  livewire->queue   = g_array_new (FALSE, FALSE, sizeof (LivewireNode));
+
+  data = (guint32 *) gimp_temp_buf_data_clear (livewire->dp_buf);
+
+  offset = (seed_y - area->y) * area->width + (seed_x - area->x);
+
+  data[offset] = SEED_POINT;
+
+  livewire->state[offset] = LIVEWIRE_QUEUED;
+
+  livewire_queue_push (livewire->queue, 0, offset);
+
+  return livewire;
+}
 
 static void
-find_optimal_path (GeglBuffer  *gradient_map,
-                   GimpTempBuf *dp_buf,
-                   gint         x1,
-                   gint         y1,
-                   gint         x2,
-                   gint         y2,
-                   gint         xs,
-                   gint         ys)
+livewire_free (ILivewire *livewire)
 {
-  GeglSampler         *map_sampler;
-  const GeglRectangle *map_extent;
-  gint                 i, j, k;
-  gint                 x, y;
-  gint                 link;
-  gint                 linkdir;
-  gint                 dirx, diry;
-  gint                 min_cost;
-  gint                 new_cost;
-  gint                 offset;
-  gint                 cum_cost[8];
-  gint                 link_cost[8];
-  gint                 pixel_cost[8];
-  guint32              pixel[8];
-  guint32             *data;
-  guint32             *d;
-  gint                 dp_buf_width  = gimp_temp_buf_get_width  (dp_buf);
-  gint                 dp_buf_height = gimp_temp_buf_get_height (dp_buf);
+  gint i;
+
+  for (i = 0; i < livewire->n_block_cols * livewire->n_block_rows; i++)
+    g_free (livewire->blocks[i]);
+
+  g_free (livewire->blocks);
+  g_object_unref (livewire->gradient_map);
+  gimp_temp_buf_unref (livewire->dp_buf);
+  g_free (livewire->state);
+  g_array_free (livewire->queue, TRUE);
+
+  g_slice_free (ILivewire, livewire);
+}
+
+/*  returns a search from (seed_x, seed_y) which covers area, reusing
+ *  the one of a previous call if possible
+ */
+static ILivewire *
+livewire_get (GimpIscissorsTool   *iscissors,
+              const GeglRectangle *area,
+              gint                 seed_x,
+              gint                 seed_y)
+{
+  ILivewire     *livewire;
+  GeglRectangle  extended;
+  GList         *list;
+  gint           width;
+  gint           height;
+
+  for (list = iscissors->livewires; list; list = g_list_next (list))
+    {
+      livewire = list->data;
+
+      if (livewire->seed_x == seed_x &&
+          livewire->seed_y == seed_y &&
+          gegl_rectangle_contains (&livewire->area, area))
+        {
+          iscissors->livewires = g_list_remove_link (iscissors->livewires,
+                                                     list);
+          iscissors->livewires = g_list_concat (list, iscissors->livewires);
+
+          return livewire;
+        }
+    }
+
+  /*  search a larger area than needed right now, so that the search
+   *  can be reused while the pointer moves on
+   */
+  width  = gegl_buffer_get_width  (iscissors->gradient_map);
+  height = gegl_buffer_get_height (iscissors->gradient_map);
+
+  extended.x      = MAX (area->x - area->width  / 2, 0);
+  extended.y      = MAX (area->y - area->height / 2, 0);
+  extended.width  = MIN (area->x + area->width  + area->width  / 2,
+                         width)  - extended.x;
+  extended.height = MIN (area->y + area->height + area->height / 2,
+                         height) - extended.y;
+
+  livewire = livewire_new (iscissors->gradient_map, &extended,
+                           seed_x, seed_y);
+
+  iscissors->livewires = g_list_prepend (iscissors->livewires, livewire);
+
+  list = g_list_nth (iscissors->livewires, N_LIVEWIRES);
 
-  /*  initialize the gradient map sampler and extent  */
-  map_sampler = gegl_buffer_sampler_new (gradient_map,
-                                         gegl_buffer_get_format (gradient_map),
-                                         GEGL_SAMPLER_NEAREST);
-  map_extent  = gegl_buffer_get_extent (gradient_map);
+  if (list)
+    {
+      list->prev->next = NULL;
+      list->prev       = NULL;
 
-  /*  initialize the dynamic programming buffer  */
-  data = (guint32 *) gimp_temp_buf_data_clear (dp_buf);
+      g_list_free_full (list, (GDestroyNotify) livewire_free);
+    }
+
+  return livewire;
+}
+
+/*  expands the search, in order of increasing cost, until the cost of
+ *  the pixel at (x, y) is final.  the search is resumed from where it
+ *  stopped by later calls.
+ */
+static void
+livewire_search (ILivewire *livewire,
+                 gint       x,
+                 gint       y)
+{
+  const GeglRectangle *area = &livewire->area;
+  guint32             *data;
+  gint32               target;
 
-  /*  what directions are we filling the array in according to?  */
-  dirx = (xs - x1 == 0) ? 1 : -1;
-  diry = (ys - y1 == 0) ? 1 : -1;
-  linkdir = (dirx * diry);
+  data = (guint32 *) gimp_temp_buf_get_data (livewire->dp_buf);
 
-  y = ys;
+  target = (y - area->y) * area->width + (x - area->x);
 
-  for (i = 0; i < dp_buf_height; i++)
+  while (livewire->state[target] != LIVEWIRE_SETTLED &&
+         livewire->queue->len > 0)
     {
-      x = xs;
+      LivewireNode node = livewire_queue_pop (livewire->queue);
+      gint         px;
+      gint         py;
+      gint         k;
+
+      /*  skip stale entries of pixels which were queued more than once  */
+      if (livewire->state[node.offset] == LIVEWIRE_SETTLED)
+        continue;
 
-      d = data + (y-y1) * dp_buf_width + (x-x1);
+      livewire->state[node.offset] = LIVEWIRE_SETTLED;
 
-      for (j = 0; j < dp_buf_width; j++)
+      px = area->x + node.offset % area->width;
+      py = area->y + node.offset / area->width;
+
+      for (k = 0; k < 8; k++)
         {
-          min_cost = G_MAXINT;
-
-          /* pixel[] array encodes how to get to a neighbour, if possible.
-           * 0 means no connection (eg edge).
-           * Rest packed as bottom two bytes: y offset then x offset.
-           * Initially, we assume we can't get anywhere.
-           */
-          for (k = 0; k < 8; k++)
-            pixel[k] = 0;
-
-          /*  Find the valid neighboring pixels  */
-          /*  the previous pixel  */
-          if (j)
-            pixel[((dirx == 1) ? 4 : 0)] = PACK (-dirx, 0);
-
-          /*  the previous row of pixels  */
-          if (i)
-            {
-              pixel[((diry == 1) ? 5 : 1)] = PACK (0, -diry);
+          gint    nx = px + move[k][0];
+          gint    ny = py + move[k][1];
+          gint32  offset;
+          gint    link;
+          guint32 cost;
 
-              link = (linkdir == 1) ? 3 : 2;
-              if (j)
-                pixel[((diry == 1) ? (link + 4) : link)] = PACK (-dirx, -diry);
+          if (nx <  area->x               ||
+              ny <  area->y               ||
+              nx >= area->x + area->width ||
+              ny >= area->y + area->height)
+            continue;
 
-              link = (linkdir == 1) ? 2 : 3;
-              if (j != dp_buf_width - 1)
-                pixel[((diry == 1) ? (link + 4) : link)] = PACK (dirx, -diry);
-            }
+          offset = (ny - area->y) * area->width + (nx - area->x);
 
-          /*  find the minimum cost of going through each neighbor to reach the
-           *  seed point...
-           */
-          link = -1;
-          for (k = 0; k < 8; k ++)
-            if (pixel[k])
-              {
-                link_cost[k] = calculate_link (map_sampler, map_extent,
-                                               xs + j*dirx, ys + i*diry,
-                                               pixel [k],
-                                               ((k > 3) ? k - 4 : k));
-                offset = OFFSET (pixel [k]);
-                pixel_cost[k] = PIXEL_COST (d[offset]);
-                cum_cost[k] = pixel_cost[k] + link_cost[k];
-                if (cum_cost[k] < min_cost)
-                  {
-                    min_cost = cum_cost[k];
-                    link = k;
-                  }
-              }
-
-          /*  If anything can be done...  */
-          if (link >= 0)
-            {
-              /*  set the cumulative cost of this pixel and the new direction
-               */
-              *d = (cum_cost[link] << 8) + link;
-
-              /*  possibly change the links from the other pixels to this pixel...
-               *  these changes occur if a neighboring pixel will receive a lower
-               *  cumulative cost by going through this pixel.
-               */
-              for (k = 0; k < 8; k ++)
-                if (pixel[k] && k != link)
-                  {
-                    /*  if the cumulative cost at the neighbor is greater than
-                     *  the cost through the link to the current pixel, change the
-                     *  neighbor's link to point to the current pixel.
-                     */
-                    new_cost = link_cost[k] + cum_cost[link];
-                    if (pixel_cost[k] > new_cost)
-                    {
-                      /*  reverse the link direction   /--------------------\ */
-                      offset = OFFSET (pixel[k]);
-                      d[offset] = (new_cost << 8) + ((k > 3) ? k - 4 : k + 4);
-                    }
-                  }
-            }
-          /*  Set the seed point  */
-          else if (!i && !j)
+          if (livewire->state[offset] == LIVEWIRE_SETTLED)
+            continue;
+
+          /*  the link from the neighbor back to this pixel  */
+          link = (k > 3) ? k - 4 : k + 4;
+
+          cost = node.cost + calculate_link (livewire, nx, ny, link);
+
+          if (livewire->state[offset] == LIVEWIRE_UNSEEN ||
+              cost < PIXEL_COST (data[offset]))
             {
-              *d = SEED_POINT;
-            }
+              livewire->state[offset] = LIVEWIRE_QUEUED;
 
-          /*  increment the data pointer and the x counter  */
-          d += dirx;
-          x += dirx;
-        }
+              data[offset] = (cost << 8) + link;
 
-      /*  increment the y counter  */
-      y += diry;
+              livewire_queue_push (livewire->queue, cost, offset);
+            }
+        }
     }
-
-  g_object_unref (map_sampler);
 }
 
 static GeglBuffer *
@@ -43,8 +43,9 @@ typedef enum
   ISCISSORS_OP_IMPOSSIBLE
 } IscissorsOps;
 
-typedef struct _ISegment ISegment;
-typedef struct _ICurve   ICurve;
+typedef struct _ISegment  ISegment;
+typedef struct _ICurve    ICurve;
+typedef struct _ILivewire ILivewire;
 
 
 #define GIMP_TYPE_ISCISSORS_TOOL            (gimp_iscissors_tool_get_type ())
@@ -79,6 +80,7 @@ struct _GimpIscissorsTool
   IscissorsState  state;        /*  state of iscissors                      */
 
   GeglBuffer     *gradient_map; /*  lazily filled gradient map              */
+  GList          *livewires;    /*  path searches from recent seed points   */
   GimpChannel    *mask;         /*  selection mask                          */
 };
 
@@ -26,8 +26,6 @@
 
 #include "tools-types.h"
 
-#include "gegl/gimp-gegl-loops.h"
-
 #include "core/gimppickable.h"
 
 #include "gimptilehandleriscissors.h"
@@ -143,27 +141,6 @@ gimp_tile_handler_iscissors_get_property (GObject    *object,
     }
 }
 
-static const gfloat horz_deriv[9] =
-{
-  1,  0, -1,
-  2,  0, -2,
-  1,  0, -1,
-};
-
-static const gfloat vert_deriv[9] =
-{
-  1,  2,  1,
-  0,  0,  0,
-  -1, -2, -1,
-};
-
-static const gfloat blur_32[9] =
-{
-  1,  1,  1,
-  1, 24,  1,
-  1,  1,  1,
-};
-
 #define  MAX_GRADIENT 179.606  /* == sqrt (127^2 + 127^2) */
 #define  MIN_GRADIENT  63      /* gradients < this are directionless */
 #define  COST_WIDTH     2      /* number of bytes for each pixel in cost map */
@@ -177,16 +154,12 @@ gimp_tile_handler_iscissors_validate (GimpTileHandlerValidate *validate,
 {
   GimpTileHandlerIscissors *iscissors = GIMP_TILE_HANDLER_ISCISSORS (validate);
   GeglBuffer               *src;
-  GeglBuffer               *temp0;
-  GeglBuffer               *temp1;
-  GeglBuffer               *temp2;
-  gint                      stride1;
-  gint                      stride2;
-  gint                      i, j;
-
-  /*  temporary convolution buffers --  */
-  guchar *maxgrad_conv1;
-  guchar *maxgrad_conv2;
+  GeglRectangle             src_rect;
+  guint8                   *src_data;
+  guint8                   *blur_data;
+  gint                      src_stride;
+  gint                      blur_stride;
+  gint                      i, j, b;
 
 #if 0
   g_printerr ("validating at %d %d %d %d\n",
@@ -200,88 +173,94 @@ gimp_tile_handler_iscissors_validate (GimpTileHandlerValidate *validate,
 
   src = gimp_pickable_get_buffer (iscissors->pickable);
 
-  temp0 = gegl_buffer_new (GEGL_RECTANGLE (0, 0,
-                                           rect->width,
-                                           rect->height),
-                           babl_format ("R'G'B'A u8"));
-
-  temp1 = gegl_buffer_new (GEGL_RECTANGLE (0, 0,
-                                           rect->width,
-                                           rect->height),
-                           babl_format ("R'G'B'A u8"));
-
-  temp2 = gegl_buffer_new (GEGL_RECTANGLE (0, 0,
-                                           rect->width,
-                                           rect->height),
-                           babl_format ("R'G'B'A u8"));
-
-  /* XXX tile edges? */
-
-  /*  Blur the source to get rid of noise  */
-  gimp_gegl_convolve (src,   rect,
-                      temp0, GEGL_RECTANGLE (0, 0, rect->width, rect->height),
-                      blur_32, 3, 32, GIMP_NORMAL_CONVOL, FALSE);
-
-  /*  Use this blurred region as the new source  */
-
-  /*  Get the horizontal derivative  */
-  gimp_gegl_convolve (temp0, GEGL_RECTANGLE (0, 0, rect->width, rect->height),
-                      temp1, GEGL_RECTANGLE (0, 0, rect->width, rect->height),
-                      horz_deriv, 3, 1, GIMP_NEGATIVE_CONVOL, FALSE);
-
-  /*  Get the vertical derivative  */
-  gimp_gegl_convolve (temp0, GEGL_RECTANGLE (0, 0, rect->width, rect->height),
-                      temp2, GEGL_RECTANGLE (0, 0, rect->width, rect->height),
-                      vert_deriv, 3, 1, GIMP_NEGATIVE_CONVOL, FALSE);
-
-  maxgrad_conv1 =
-    (guchar *) gegl_buffer_linear_open (temp1,
-                                        GEGL_RECTANGLE (0, 0,
-                                                        rect->width,
-                                                        rect->height),
-                                        &stride1, NULL);
-
-  maxgrad_conv2 =
-    (guchar *) gegl_buffer_linear_open (temp2,
-                                        GEGL_RECTANGLE (0, 0,
-                                                        rect->width,
-                                                        rect->height),
-                                        &stride2, NULL);
+  /*  read the source, with the two pixel border needed by the blur and
+   *  the derivatives, straight into memory, and do the filtering on
+   *  that, instead of going through intermediate buffers
+   */
+  src_rect.x      = rect->x      - 2;
+  src_rect.y      = rect->y      - 2;
+  src_rect.width  = rect->width  + 4;
+  src_rect.height = rect->height + 4;
+
+  src_stride = 4 * src_rect.width;
+  src_data   = g_new (guint8, src_stride * src_rect.height);
+
+  gegl_buffer_get (src, &src_rect, 1.0, babl_format ("R'G'B'A u8"),
+                   src_data, src_stride, GEGL_ABYSS_CLAMP);
+
+  /*  Blur the source to get rid of noise, with a one pixel border  */
+  blur_stride = 4 * (rect->width + 2);
+  blur_data   = g_new (guint8, blur_stride * (rect->height + 2));
+
+  for (i = 0; i < rect->height + 2; i++)
+    {
+      const guint8 *above = src_data + src_stride * i;
+      const guint8 *s     = above + src_stride;
+      const guint8 *below = s     + src_stride;
+      guint8       *d     = blur_data + blur_stride * i;
+
+      for (j = 0; j < 4 * (rect->width + 2); j++)
+        {
+          gint sum;
+
+          /*  1  1  1
+           *  1 24  1   / 32
+           *  1  1  1
+           */
+          sum = above[j] + above[j + 4] + above[j + 8] +
+                s[j]     + 24 * s[j + 4] + s[j + 8] +
+                below[j] + below[j + 4] + below[j + 8];
+
+          d[j] = (sum + 16) / 32;
+        }
+    }
+
+  g_free (src_data);
 
   /* calculate overall gradient */
 
   for (i = 0; i < rect->height; i++)
     {
-      const guint8 *datah   = maxgrad_conv1 + stride1 * i;
-      const guint8 *datav   = maxgrad_conv2 + stride2 * i;
+      const guint8 *above   = blur_data + blur_stride * i;
+      const guint8 *row     = above + blur_stride;
+      const guint8 *below   = row   + blur_stride;
       guint8       *gradmap = (guint8 *) dest_buf + dest_stride * i;
 
       for (j = 0; j < rect->width; j++)
         {
-          gint8  hmax = datah[0] - 128;
-          gint8  vmax = datav[0] - 128;
+          gint   hmax = 0;
+          gint   vmax = 0;
           gfloat gradient;
-          gint   b;
 
-          for (b = 1; b < 4; b++)
+          /*  the horizontal and vertical sobel derivatives, the largest
+           *  of the channels' is used
+           */
+          for (b = 0; b < 4; b++)
             {
-              if (abs (datah[b] - 128) > abs (hmax))
-                hmax = datah[b] - 128;
+              gint l = 4 * j + b;
+              gint r = l + 8;
+              gint c = l + 4;
+              gint h;
+              gint v;
 
-              if (abs (datav[b] - 128) > abs (vmax))
-                vmax = datav[b] - 128;
-            }
+              h = (above[l] + 2 * row[l] + below[l]) -
+                  (above[r] + 2 * row[r] + below[r]);
+              v = (above[l] + 2 * above[c] + above[r]) -
+                  (below[l] + 2 * below[c] + below[r]);
 
-          if (i == 0 || j == 0 || i == rect->height - 1 || j == rect->width - 1)
-            {
-              gradmap[j * COST_WIDTH + 0] = 0;
-              gradmap[j * COST_WIDTH + 1] = 255;
-              goto contin;
+              h = CLAMP (h, -128, 127);
+              v = CLAMP (v, -128, 127);
+
+              if (abs (h) > abs (hmax))
+                hmax = h;
+
+              if (abs (v) > abs (vmax))
+                vmax = v;
             }
 
           /* 1 byte absolute magnitude first */
           gradient = sqrt (SQR (hmax) + SQR (vmax));
-          gradmap[j * COST_WIDTH] = gradient * 255 / MAX_GRADIENT;
+          gradmap[j * COST_WIDTH] = MIN (gradient * 255 / MAX_GRADIENT, 255);
 
           /* then 1 byte direction */
           if (gradient > MIN_GRADIENT)
@@ -304,19 +283,10 @@ gimp_tile_handler_iscissors_validate (GimpTileHandlerValidate *validate,
             {
               gradmap[j * COST_WIDTH + 1] = 255; /* reserved for weak gradient */
             }
-
-        contin:
-          datah += 4;
-          datav += 4;
         }
     }
 
-  gegl_buffer_linear_close (temp1, maxgrad_conv1);
-  gegl_buffer_linear_close (temp2, maxgrad_conv2);
-
-  g_object_unref (temp0);
-  g_object_unref (temp1);
-  g_object_unref (temp2);
+  g_free (blur_data);
 }
 
 GeglTileHandler *
@@ -59,6 +59,7 @@
 #include "core/gimp-parallel.h"
 #include "core/gimpasync.h"
 #include "core/gimpbacktrace.h"
+#include "core/gimpbrushcache.h"
 #include "core/gimptempbuf.h"
 #include "core/gimpwaitable.h"
 
@@ -142,6 +143,8 @@ typedef enum
   VARIABLE_TILE_ALLOC_TOTAL,
   VARIABLE_SCRATCH_TOTAL,
   VARIABLE_TEMP_BUF_TOTAL,
+  VARIABLE_BRUSH_CACHE_TOTAL,
+  VARIABLE_BRUSH_CACHE_HIT_MISS,
 
 
   N_VARIABLES,
@@ -359,6 +362,8 @@ static void       gimp_dashboard_sample_variable_rate_of_change (GimpDashboard
                                                                  Variable             variable);
 static void       gimp_dashboard_sample_swap_limit              (GimpDashboard       *dashboard,
                                                                  Variable             variable);
+static void       gimp_dashboard_sample_brush_cache_hit_miss    (GimpDashboard       *dashboard,
+                                                                 Variable             variable);
 #ifdef HAVE_CPU_GROUP
 static void       gimp_dashboard_sample_cpu_usage               (GimpDashboard       *dashboard,
                                                                  Variable             variable);
@@ -728,6 +733,23 @@ static const VariableInfo variables[] =
     .type             = VARIABLE_TYPE_SIZE,
     .sample_func      = gimp_dashboard_sample_function,
     .data             = gimp_temp_buf_get_total_memsize
+  },
+
+  [VARIABLE_BRUSH_CACHE_TOTAL] =
+  { .name             = "brush-cache-total",
+    .title            = NC_("dashboard-variable", "Brush cache"),
+    .description      = N_("Total size of cached brush transforms"),
+    .type             = VARIABLE_TYPE_SIZE,
+    .sample_func      = gimp_dashboard_sample_function,
+    .data             = gimp_brush_cache_get_total_memsize
+  },
+
+  [VARIABLE_BRUSH_CACHE_HIT_MISS] =
+  { .name             = "brush-cache-hit-miss",
+    .title            = NC_("dashboard-variable", "Brush hit/miss"),
+    .description      = N_("Brush cache hit/miss ratio"),
+    .type             = VARIABLE_TYPE_INT_RATIO,
+    .sample_func      = gimp_dashboard_sample_brush_cache_hit_miss
   }
 };
 
@@ -940,6 +962,15 @@ static const GroupInfo groups[] =
                             .default_active = TRUE
                           },
 
+                          { VARIABLE_SEPARATOR },
+
+                          { .variable       = VARIABLE_BRUSH_CACHE_TOTAL,
+                            .default_active = TRUE
+                          },
+                          { .variable       = VARIABLE_BRUSH_CACHE_HIT_MISS,
+                            .default_active = FALSE
+                          },
+
                           {}
                         }
   },
@@ -2173,6 +2204,19 @@ gimp_dashboard_sample_swap_limit (GimpDashboard *dashboard,
     }
 }
 
+static void
+gimp_dashboard_sample_brush_cache_hit_miss (GimpDashboard *dashboard,
+                                            Variable       variable)
+{
+  GimpDashboardPrivate *priv          = dashboard->priv;
+  VariableData         *variable_data = &priv->variables[variable];
+
+  gimp_brush_cache_get_hit_miss (&variable_data->value.int_ratio.antecedent,
+                                 &variable_data->value.int_ratio.consequent);
+
+  variable_data->available = TRUE;
+}
+
 #ifdef HAVE_CPU_GROUP
 
 #ifdef HAVE_SYS_TIMES_H
@@ -32,7 +32,6 @@
 #include "config/gimpcoreconfig.h"
 
 #include "gegl/gimp-babl.h"
-#include "gegl/gimp-gegl-tile-compat.h"
 
 #include "core/gimp.h"
 #include "core/gimpcontainer.h"
@@ -73,6 +72,7 @@
 #include "xcf-load.h"
 #include "xcf-read.h"
 #include "xcf-seek.h"
+#include "xcf-tile-backend.h"
 #include "xcf-utils.h"
 
 #include "gimp-log.h"
@@ -84,6 +84,24 @@
 /* #define GIMP_XCF_PATH_DEBUG */
 
 
+typedef struct
+{
+  XcfInfo    *info;
+  GeglBuffer *buffer;
+  const Babl *format;
+  gint        level;
+  gint        width;
+  gint        height;
+  gint        max_data_length;
+  gint        first_tile;
+  guchar     *tiles_data;
+  gint       *tiles_length;
+  gint        success;
+  GMutex      error_mutex;
+  GError     *error;
+} XcfLoadLevelData;
+
+
 static void            xcf_load_add_masks     (GimpImage     *image);
 static gboolean        xcf_load_image_props   (XcfInfo       *info,
                                                GimpImage     *image);
@@ -110,23 +128,51 @@ static GimpChannel   * xcf_load_channel       (XcfInfo       *info,
 static GimpLayerMask * xcf_load_layer_mask    (XcfInfo       *info,
                                                GimpImage     *image);
 static gboolean        xcf_load_buffer        (XcfInfo       *info,
-                                               GeglBuffer    *buffer);
-static gboolean        xcf_load_level         (XcfInfo       *info,
-                                               GeglBuffer    *buffer);
-static gboolean        xcf_load_tile          (XcfInfo       *info,
-                                               GeglBuffer    *buffer,
-                                               GeglRectangle *tile_rect,
-                                               const Babl    *format);
-static gboolean        xcf_load_tile_rle      (XcfInfo       *info,
+                                               GimpDrawable  *drawable);
+static gboolean        xcf_load_buffer_lazy   (XcfInfo       *info,
+                                               GimpDrawable  *drawable,
+                                               const goffset *offsets,
+                                               gint           n_levels);
+static gboolean        xcf_load_level_offsets (XcfInfo       *info,
                                                GeglBuffer    *buffer,
-                                               GeglRectangle *tile_rect,
-                                               const Babl    *format,
-                                               gint           data_length);
-static gboolean        xcf_load_tile_zlib     (XcfInfo       *info,
+                                               gint           level,
+                                               goffset      **offset_table,
+                                               guint         *ntiles);
+static gboolean        xcf_load_level         (XcfInfo       *info,
                                                GeglBuffer    *buffer,
-                                               GeglRectangle *tile_rect,
-                                               const Babl    *format,
-                                               gint           data_length);
+                                               gint           level);
+static void            xcf_load_level_decode_tiles
+                                              (gsize             offset,
+                                               gsize             size,
+                                               XcfLoadLevelData *data);
+static gboolean        xcf_load_tile          (gint                 file_version,
+                                               const GeglRectangle *tile_rect,
+                                               const Babl          *format,
+                                               const guchar        *xcfdata,
+                                               gint                 data_length,
+                                               guchar              *tile_data,
+                                               GError             **error);
+static gboolean        xcf_load_tile_rle      (gint                 file_version,
+                                               const GeglRectangle *tile_rect,
+                                               const Babl          *format,
+                                               const guchar        *xcfdata,
+                                               gint                 data_length,
+                                               guchar              *tile_data,
+                                               GError             **error);
+static gboolean        xcf_load_tile_zlib     (gint                 file_version,
+                                               const GeglRectangle *tile_rect,
+                                               const Babl          *format,
+                                               const guchar        *xcfdata,
+                                               gint                 data_length,
+                                               guchar              *tile_data,
+                                               GError             **error);
+static gboolean        xcf_load_tile_codec    (gint                 file_version,
+                                               const GeglRectangle *tile_rect,
+                                               const Babl          *format,
+                                               const guchar        *xcfdata,
+                                               gint                 data_length,
+                                               guchar              *tile_data,
+                                               GError             **error);
 static GimpParasite  * xcf_load_parasite      (XcfInfo       *info);
 static gboolean        xcf_load_old_paths     (XcfInfo       *info,
                                                GimpImage     *image);
@@ -736,7 +782,8 @@ xcf_load_image_props (XcfInfo   *info,
             if ((compression != COMPRESS_NONE) &&
                 (compression != COMPRESS_RLE) &&
                 (compression != COMPRESS_ZLIB) &&
-                (compression != COMPRESS_FRACTAL))
+                (compression != COMPRESS_FRACTAL) &&
+                (compression != COMPRESS_TILE_CODEC))
               {
                 gimp_message (info->gimp, G_OBJECT (info->progress),
                               GIMP_MESSAGE_ERROR,
@@ -748,7 +795,8 @@ xcf_load_image_props (XcfInfo   *info,
             info->compression = compression;
 
             gimp_image_set_xcf_compression (image,
-                                            compression >= COMPRESS_ZLIB);
+                                            compression == COMPRESS_ZLIB ||
+                                            compression == COMPRESS_FRACTAL);
 
             GIMP_LOG (XCF, "prop compression=%d", compression);
           }
@@ -1777,8 +1825,7 @@ xcf_load_layer (XcfInfo    *info,
 
       GIMP_LOG (XCF, "loading buffer");
 
-      if (! xcf_load_buffer (info,
-                             gimp_drawable_get_buffer (GIMP_DRAWABLE (layer))))
+      if (! xcf_load_buffer (info, GIMP_DRAWABLE (layer)))
         goto error;
 
       GIMP_LOG (XCF, "buffer loaded");
@@ -1874,8 +1921,7 @@ xcf_load_channel (XcfInfo   *info,
   if (! xcf_seek_pos (info, hierarchy_offset, NULL))
     goto error;
 
-  if (! xcf_load_buffer (info,
-                         gimp_drawable_get_buffer (GIMP_DRAWABLE (channel))))
+  if (! xcf_load_buffer (info, GIMP_DRAWABLE (channel)))
     goto error;
 
   xcf_progress_update (info);
@@ -1939,8 +1985,7 @@ xcf_load_layer_mask (XcfInfo   *info,
   if (! xcf_seek_pos (info, hierarchy_offset, NULL))
     goto error;
 
-  if (! xcf_load_buffer (info,
-                         gimp_drawable_get_buffer (GIMP_DRAWABLE (layer_mask))))
+  if (! xcf_load_buffer (info, GIMP_DRAWABLE (layer_mask)))
     goto error;
 
   xcf_progress_update (info);
@@ -1957,14 +2002,17 @@ xcf_load_layer_mask (XcfInfo   *info,
 }
 
 static gboolean
-xcf_load_buffer (XcfInfo    *info,
-                 GeglBuffer *buffer)
+xcf_load_buffer (XcfInfo      *info,
+                 GimpDrawable *drawable)
 {
+  GeglBuffer *buffer = gimp_drawable_get_buffer (drawable);
   const Babl *format;
-  goffset     offset;
+  goffset     offsets[XCF_MAX_LEVELS];
+  gint        n_levels;
   gint        width;
   gint        height;
   gint        bpp;
+  gint        i;
 
   format = gegl_buffer_get_format (buffer);
 
@@ -1980,49 +2028,157 @@ xcf_load_buffer (XcfInfo    *info,
       bpp    != babl_format_get_bytes_per_pixel (format))
     return FALSE;
 
-  xcf_read_offset (info, &offset, 1); /* top level */
+  xcf_read_offset (info, &offsets[0], 1); /* top level */
+  n_levels = 1;
 
-  /* seek to the level offset */
-  if (! xcf_seek_pos (info, offset, NULL))
-    return FALSE;
+  /* from version XCF_EXT_VERSION_MIPMAPS on, the levels below the
+   * first one are real, downscaled copies of the buffer, which we load
+   * into the buffer's own mipmap levels, so that they don't need to be
+   * rendered for zoomed-out views.  in older files, discard levels
+   * below first.
+   */
+  if (info->file_version >= XCF_EXT_VERSION_MIPMAPS)
+    {
+      while (n_levels < XCF_MAX_LEVELS)
+        {
+          xcf_read_offset (info, &offsets[n_levels], 1);
 
-  /* read in the level */
-  if (! xcf_load_level (info, buffer))
-    return FALSE;
+          if (offsets[n_levels] == 0)
+            break;
 
-  /* discard levels below first.
+          n_levels++;
+        }
+    }
+
+  if (info->mapped)
+    return xcf_load_buffer_lazy (info, drawable, offsets, n_levels);
+
+  /* the first level must be loaded first, since writing to it
+   * invalidates the buffer's other levels.
    */
+  for (i = 0; i < n_levels; i++)
+    {
+      /* seek to the level offset */
+      if (! xcf_seek_pos (info, offsets[i], NULL))
+        return FALSE;
+
+      /* read in the level */
+      if (! xcf_load_level (info, buffer, i))
+        return FALSE;
+    }
 
   return TRUE;
 }
 
+static gboolean
+xcf_load_buffer_lazy (XcfInfo       *info,
+                      GimpDrawable  *drawable,
+                      const goffset *offsets,
+                      gint           n_levels)
+{
+  GeglBuffer      *buffer = gimp_drawable_get_buffer (drawable);
+  GeglTileBackend *backend;
+  GeglBuffer      *lazy_buffer;
+  gint             tile_width;
+  gint             tile_height;
+  gint             i;
+
+  /* use the tile size of the drawable's buffer, which is GEGL's tile
+   * size, so that copies of the lazy buffer share its tiles
+   */
+  g_object_get (buffer,
+                "tile-width",  &tile_width,
+                "tile-height", &tile_height,
+                NULL);
+
+  backend = xcf_tile_backend_new (info->file,
+                                  info->mapped,
+                                  info->compression,
+                                  info->file_version,
+                                  gegl_buffer_get_format (buffer),
+                                  gegl_buffer_get_width (buffer),
+                                  gegl_buffer_get_height (buffer),
+                                  tile_width,
+                                  tile_height);
+
+  /* only read the tile offset tables, the tiles themselves are decoded
+   * by the backend when they are first accessed.
+   */
+  for (i = 0; i < n_levels; i++)
+    {
+      goffset *offset_table;
+      guint    ntiles;
+
+      if (! xcf_seek_pos (info, offsets[i], NULL) ||
+          ! xcf_load_level_offsets (info, buffer, i, &offset_table, &ntiles))
+        {
+          g_object_unref (backend);
+
+          return FALSE;
+        }
+
+      if (offset_table)
+        xcf_tile_backend_add_level (XCF_TILE_BACKEND (backend), i,
+                                    offset_table, ntiles);
+    }
+
+  lazy_buffer = gegl_buffer_new_for_backend (gegl_buffer_get_extent (buffer),
+                                             backend);
+  g_object_unref (backend);
+
+  /* read a single pixel of the smallest level, so that GEGL tracks the
+   * buffer's levels, and invalidates the stored ones when the first
+   * level is modified.
+   */
+  if (n_levels > 1)
+    {
+      guchar pixel;
+
+      gegl_buffer_get (lazy_buffer, GEGL_RECTANGLE (0, 0, 1, 1),
+                       1.0 / (1 << (n_levels - 1)),
+                       babl_format ("Y u8"), &pixel,
+                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+    }
+
+  gimp_drawable_set_buffer (drawable, FALSE, NULL, lazy_buffer);
+  g_object_unref (lazy_buffer);
+
+  return TRUE;
+}
 
 static gboolean
-xcf_load_level (XcfInfo    *info,
-                GeglBuffer *buffer)
+xcf_load_level_offsets (XcfInfo     *info,
+                        GeglBuffer  *buffer,
+                        gint         level,
+                        goffset    **offset_table,
+                        guint       *ntiles)
 {
   const Babl *format;
-  gint        bpp;
-  goffset     saved_pos;
-  goffset     offset;
-  goffset     offset2;
+  goffset    *offsets;
   goffset     max_data_length;
-  gint        n_tile_rows;
-  gint        n_tile_cols;
-  guint       ntiles;
+  gint        bpp;
+  gint        level_width;
+  gint        level_height;
   gint        width;
   gint        height;
   gint        i;
-  gint        fail;
+
+  *offset_table = NULL;
+  *ntiles       = 0;
 
   format = gegl_buffer_get_format (buffer);
   bpp    = babl_format_get_bytes_per_pixel (format);
 
+  xcf_level_get_size (gegl_buffer_get_width (buffer),
+                      gegl_buffer_get_height (buffer),
+                      level,
+                      &level_width, &level_height);
+
   xcf_read_int32 (info, (guint32 *) &width,  1);
   xcf_read_int32 (info, (guint32 *) &height, 1);
 
-  if (width  != gegl_buffer_get_width (buffer) ||
-      height != gegl_buffer_get_height (buffer))
+  if (width  != level_width ||
+      height != level_height)
     return FALSE;
 
   /* maximal allowable size of on-disk tile data.  make it somewhat bigger than
@@ -2032,193 +2188,368 @@ xcf_load_level (XcfInfo    *info,
   max_data_length = XCF_TILE_WIDTH * XCF_TILE_HEIGHT * bpp *
                     XCF_TILE_MAX_DATA_LENGTH_FACTOR /* = 1.5, currently */;
 
+  *ntiles = xcf_level_get_n_tiles (width, height);
+
+  /* read in the whole offset table, including the terminating '0',
+   * so that the tiles can be read in order without seeking back to
+   * the table after each tile.
+   */
+  offsets = g_new0 (goffset, *ntiles + 1);
+
   /* read in the first tile offset.
    *  if it is '0', then this tile level is empty
    *  and we can simply return.
    */
-  xcf_read_offset (info, &offset, 1);
-  if (offset == 0)
-    return TRUE;
+  xcf_read_offset (info, offsets, 1);
+  if (offsets[0] == 0)
+    {
+      g_free (offsets);
 
-  n_tile_rows = gimp_gegl_buffer_get_n_tile_rows (buffer, XCF_TILE_HEIGHT);
-  n_tile_cols = gimp_gegl_buffer_get_n_tile_cols (buffer, XCF_TILE_WIDTH);
+      return TRUE;
+    }
 
-  ntiles = n_tile_rows * n_tile_cols;
-  for (i = 0; i < ntiles; i++)
-    {
-      GeglRectangle rect;
+  xcf_read_offset (info, offsets + 1, *ntiles);
 
-      fail = FALSE;
+  for (i = 0; i < *ntiles; i++)
+    {
+      goffset offset  = offsets[i];
+      goffset offset2 = offsets[i + 1];
 
       if (offset == 0)
         {
           gimp_message_literal (info->gimp, G_OBJECT (info->progress),
                                 GIMP_MESSAGE_ERROR,
                                 "not enough tiles found in level");
+          g_free (offsets);
+
           return FALSE;
         }
 
-      /* save the current position as it is where the
-       *  next tile offset is stored.
-       */
-      saved_pos = info->cp;
-
-      /* read in the offset of the next tile so we can calculate the amount
-       * of data needed for this tile
-       */
-      xcf_read_offset (info, &offset2, 1);
-
       /* if the offset is 0 then we need to read in the maximum possible
        * allowing for negative compression
        */
       if (offset2 == 0)
         offset2 = offset + max_data_length;
 
-      /* seek to the tile offset */
-      if (! xcf_seek_pos (info, offset, NULL))
-        return FALSE;
-
       if (offset2 < offset || offset2 - offset > max_data_length)
         {
           gimp_message (info->gimp, G_OBJECT (info->progress),
                         GIMP_MESSAGE_ERROR,
                         "invalid tile data length: %" G_GOFFSET_FORMAT,
                         offset2 - offset);
+          g_free (offsets);
+
           return FALSE;
         }
+    }
 
-      /* get buffer rectangle to write to */
-      gimp_gegl_buffer_get_tile_rect (buffer,
-                                      XCF_TILE_WIDTH, XCF_TILE_HEIGHT,
-                                      i, &rect);
+  if (offsets[*ntiles] != 0)
+    {
+      gimp_message (info->gimp, G_OBJECT (info->progress), GIMP_MESSAGE_ERROR,
+                    "encountered garbage after reading level: %" G_GOFFSET_FORMAT,
+                    offsets[*ntiles]);
+      g_free (offsets);
 
-      GIMP_LOG (XCF, "loading tile %d/%d", i + 1, ntiles);
+      return FALSE;
+    }
+
+  *offset_table = offsets;
+
+  return TRUE;
+}
 
-      /* read in the tile */
-      switch (info->compression)
+static gboolean
+xcf_load_level (XcfInfo    *info,
+                GeglBuffer *buffer,
+                gint        level)
+{
+  XcfLoadLevelData  data;
+  const Babl       *format;
+  gint              bpp;
+  goffset           saved_pos;
+  goffset          *offset_table;
+  goffset           max_data_length;
+  guint             ntiles;
+  gint              width;
+  gint              height;
+  gint              i;
+
+  format = gegl_buffer_get_format (buffer);
+  bpp    = babl_format_get_bytes_per_pixel (format);
+
+  xcf_level_get_size (gegl_buffer_get_width (buffer),
+                      gegl_buffer_get_height (buffer),
+                      level,
+                      &width, &height);
+
+  if (! xcf_load_level_offsets (info, buffer, level, &offset_table, &ntiles))
+    return FALSE;
+
+  /* the level is empty */
+  if (! offset_table)
+    return TRUE;
+
+  /* remember the position after the offset table, so we can leave the
+   * stream there when we're done, like when reading the tiles one by
+   * one.
+   */
+  saved_pos = info->cp;
+
+  max_data_length = XCF_TILE_WIDTH * XCF_TILE_HEIGHT * bpp *
+                    XCF_TILE_MAX_DATA_LENGTH_FACTOR /* = 1.5, currently */;
+
+  /* the tile data is read from the file in batches by this thread, and
+   * then decoded and stored in the buffer by multiple threads.
+   */
+  data.info            = info;
+  data.buffer          = buffer;
+  data.format          = format;
+  data.level           = level;
+  data.width           = width;
+  data.height          = height;
+  data.max_data_length = max_data_length;
+  data.tiles_data      = g_malloc (MIN (ntiles, XCF_TILE_BATCH_SIZE) *
+                                   max_data_length);
+  data.tiles_length    = g_new (gint, MIN (ntiles, XCF_TILE_BATCH_SIZE));
+  data.error           = NULL;
+
+  g_mutex_init (&data.error_mutex);
+
+  for (i = 0; i < ntiles; i += XCF_TILE_BATCH_SIZE)
+    {
+      gint n_batch_tiles = MIN (ntiles - i, XCF_TILE_BATCH_SIZE);
+      gint j;
+
+      GIMP_LOG (XCF, "loading tiles %d-%d/%d",
+                i + 1, i + n_batch_tiles, ntiles);
+
+      for (j = 0; j < n_batch_tiles; j++)
         {
-        case COMPRESS_NONE:
-          if (! xcf_load_tile (info, buffer, &rect, format))
-            fail = TRUE;
-          break;
-        case COMPRESS_RLE:
-          if (! xcf_load_tile_rle (info, buffer, &rect, format,
-                                   offset2 - offset))
-            fail = TRUE;
-          break;
-        case COMPRESS_ZLIB:
-          if (! xcf_load_tile_zlib (info, buffer, &rect, format,
-                                    offset2 - offset))
-            fail = TRUE;
-          break;
-        case COMPRESS_FRACTAL:
-          g_printerr ("xcf: fractal compression unimplemented. "
-                      "Possibly corrupt XCF file.");
-          fail = TRUE;
-          break;
-        default:
-          g_printerr ("xcf: unknown compression. "
-                      "Possibly corrupt XCF file.");
-          fail = TRUE;
-          break;
+          goffset  offset      = offset_table[i + j];
+          goffset  offset2     = offset_table[i + j + 1];
+          guchar  *tile_data   = data.tiles_data + j * max_data_length;
+          gsize    bytes_read  = 0;
+
+          if (offset2 == 0)
+            offset2 = offset + max_data_length;
+
+          /* seek to the tile offset */
+          if (! xcf_seek_pos (info, offset, NULL))
+            {
+              g_mutex_clear (&data.error_mutex);
+              g_free (data.tiles_data);
+              g_free (data.tiles_length);
+              g_free (offset_table);
+
+              return FALSE;
+            }
+
+          /* we have to read directly instead of xcf_read_* because we
+           * may be reading past the end of the file here
+           */
+          g_input_stream_read_all (info->input, tile_data, offset2 - offset,
+                                   &bytes_read, NULL, NULL);
+          info->cp += bytes_read;
+
+          data.tiles_length[j] = bytes_read;
         }
 
-      if (fail)
-        return FALSE;
+      data.first_tile = i;
+      data.success    = TRUE;
 
-      GIMP_LOG (XCF, "loaded tile %d/%d", i + 1, ntiles);
+      gegl_parallel_distribute_range (
+        n_batch_tiles, 1,
+        (GeglParallelDistributeRangeFunc) xcf_load_level_decode_tiles,
+        &data);
 
-      /* restore the saved position so we'll be ready to
-       *  read the next offset.
-       */
-      if (!xcf_seek_pos (info, saved_pos, NULL))
-        return FALSE;
+      if (! data.success)
+        {
+          /* the workers only record the first error, report it here */
+          if (data.error)
+            {
+              gimp_message_literal (info->gimp, G_OBJECT (info->progress),
+                                    GIMP_MESSAGE_ERROR, data.error->message);
+              g_clear_error (&data.error);
+            }
 
-      /* read in the offset of the next tile */
-      xcf_read_offset (info, &offset, 1);
-    }
+          g_mutex_clear (&data.error_mutex);
+          g_free (data.tiles_data);
+          g_free (data.tiles_length);
+          g_free (offset_table);
 
-  if (offset != 0)
-    {
-      gimp_message (info->gimp, G_OBJECT (info->progress), GIMP_MESSAGE_ERROR,
-                    "encountered garbage after reading level: %" G_GOFFSET_FORMAT,
-                    offset);
-      return FALSE;
+          return FALSE;
+        }
+
+      GIMP_LOG (XCF, "loaded tiles %d-%d/%d",
+                i + 1, i + n_batch_tiles, ntiles);
     }
 
+  g_mutex_clear (&data.error_mutex);
+  g_free (data.tiles_data);
+  g_free (data.tiles_length);
+  g_free (offset_table);
+
+  /* restore the position after the offset table */
+  if (! xcf_seek_pos (info, saved_pos, NULL))
+    return FALSE;
+
   return TRUE;
 }
 
-static gboolean
-xcf_load_tile (XcfInfo       *info,
-               GeglBuffer    *buffer,
-               GeglRectangle *tile_rect,
-               const Babl    *format)
+static void
+xcf_load_level_decode_tiles (gsize             offset,
+                             gsize             size,
+                             XcfLoadLevelData *data)
 {
-  gint    bpp       = babl_format_get_bytes_per_pixel (format);
-  gint    tile_size = bpp * tile_rect->width * tile_rect->height;
-  guchar *tile_data = g_alloca (tile_size);
+  gint    bpp       = babl_format_get_bytes_per_pixel (data->format);
+  guchar *tile_data = g_alloca (XCF_TILE_WIDTH * XCF_TILE_HEIGHT * bpp);
+  gsize   i;
 
-  if (info->file_version <= 11)
+  for (i = offset; i < offset + size; i++)
     {
-      xcf_read_int8 (info, tile_data, tile_size);
+      XcfInfo       *info    = data->info;
+      guchar        *xcfdata = data->tiles_data + i * data->max_data_length;
+      gint           length  = data->tiles_length[i];
+      GeglRectangle  rect;
+      GError        *error   = NULL;
+
+      if (! g_atomic_int_get (&data->success))
+        return;
+
+      /* get buffer rectangle to write to */
+      xcf_level_get_tile_rect (data->width, data->height,
+                               data->first_tile + i, &rect);
+
+      /* decode the tile */
+      if (! xcf_load_decode_tile (info->compression, info->file_version,
+                                  &rect, data->format,
+                                  xcfdata, length, tile_data, &error))
+        {
+          /* errors can't be reported from the worker threads, keep the
+           * first one for xcf_load_level()
+           */
+          g_mutex_lock (&data->error_mutex);
+
+          if (! data->error)
+            data->error = error;
+          else
+            g_clear_error (&error);
+
+          g_mutex_unlock (&data->error_mutex);
+
+          g_atomic_int_set (&data->success, FALSE);
+
+          return;
+        }
+
+      if (! xcf_data_is_zero (tile_data, rect.width * rect.height * bpp))
+        {
+          gegl_buffer_set (data->buffer, &rect, data->level, data->format,
+                           tile_data, GEGL_AUTO_ROWSTRIDE);
+        }
     }
-  else
+}
+
+gboolean
+xcf_load_decode_tile (XcfCompressionType   compression,
+                      gint                 file_version,
+                      const GeglRectangle *tile_rect,
+                      const Babl          *format,
+                      const guchar        *xcfdata,
+                      gint                 data_length,
+                      guchar              *tile_data,
+                      GError             **error)
+{
+  switch (compression)
     {
-      gint n_components = babl_format_get_n_components (format);
+    case COMPRESS_NONE:
+      return xcf_load_tile (file_version, tile_rect, format,
+                            xcfdata, data_length, tile_data, error);
+
+    case COMPRESS_RLE:
+      return xcf_load_tile_rle (file_version, tile_rect, format,
+                                xcfdata, data_length, tile_data, error);
+
+    case COMPRESS_ZLIB:
+      return xcf_load_tile_zlib (file_version, tile_rect, format,
+                                 xcfdata, data_length, tile_data, error);
+
+    case COMPRESS_FRACTAL:
+      g_set_error_literal (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                           "xcf: fractal compression unimplemented. "
+                           "Possibly corrupt XCF file.");
+      return FALSE;
 
-      xcf_read_component (info, bpp / n_components, tile_data,
-                          tile_size / bpp * n_components);
+    case COMPRESS_TILE_CODEC:
+      return xcf_load_tile_codec (file_version, tile_rect, format,
+                                  xcfdata, data_length, tile_data, error);
     }
 
-  if (! xcf_data_is_zero (tile_data, tile_size))
+  g_set_error_literal (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                       "xcf: unknown compression. "
+                       "Possibly corrupt XCF file.");
+
+  return FALSE;
+}
+
+static gboolean
+xcf_load_tile (gint                 file_version,
+               const GeglRectangle *tile_rect,
+               const Babl          *format,
+               const guchar        *xcfdata,
+               gint                 data_length,
+               guchar              *tile_data,
+               GError             **error)
+{
+  gint bpp       = babl_format_get_bytes_per_pixel (format);
+  gint tile_size = bpp * tile_rect->width * tile_rect->height;
+
+  /* if the file ends prematurely, treat the missing data as zeros. */
+  data_length = CLAMP (data_length, 0, tile_size);
+
+  memcpy (tile_data, xcfdata, data_length);
+  memset (tile_data + data_length, 0, tile_size - data_length);
+
+  if (file_version >= 12)
     {
-      gegl_buffer_set (buffer, tile_rect, 0, format, tile_data,
-                       GEGL_AUTO_ROWSTRIDE);
+      gint n_components = babl_format_get_n_components (format);
+
+      xcf_read_from_be (bpp / n_components, tile_data,
+                        tile_size / bpp * n_components);
     }
 
   return TRUE;
 }
 
 static gboolean
-xcf_load_tile_rle (XcfInfo       *info,
-                   GeglBuffer    *buffer,
-                   GeglRectangle *tile_rect,
-                   const Babl    *format,
-                   gint           data_length)
+xcf_load_tile_rle (gint                 file_version,
+                   const GeglRectangle *tile_rect,
+                   const Babl          *format,
+                   const guchar        *xcfdata,
+                   gint                 data_length,
+                   guchar              *tile_data,
+                   GError             **error)
 {
-  gint    bpp       = babl_format_get_bytes_per_pixel (format);
-  gint    tile_size = bpp * tile_rect->width * tile_rect->height;
-  guchar *tile_data = g_alloca (tile_size);
-  guchar  nonzero   = FALSE;
-  gsize   bytes_read;
-  gint    i;
-  guchar *xcfdata;
-  guchar *xcfodata;
-  guchar *xcfdatalimit;
+  gint          bpp       = babl_format_get_bytes_per_pixel (format);
+  gint          tile_size = bpp * tile_rect->width * tile_rect->height;
+  guchar        nonzero   = FALSE;
+  gint          i;
+  const guchar *xcfdatalimit;
 
   /* Workaround for bug #357809: avoid crashing on g_malloc() and skip
-   * this tile (return TRUE without storing data) as if it did not
+   * this tile (return TRUE with an empty tile) as if it did not
    * contain any data.  It is better than returning FALSE, which would
    * skip the whole hierarchy while there may still be some valid
    * tiles in the file.
    */
   if (data_length <= 0)
-    return TRUE;
-
-  xcfdata = xcfodata = g_alloca (data_length);
-
-  /* we have to read directly instead of xcf_read_* because we may be
-   * reading past the end of the file here
-   */
-  g_input_stream_read_all (info->input, xcfdata, data_length,
-                           &bytes_read, NULL, NULL);
-  info->cp += bytes_read;
+    {
+      memset (tile_data, 0, tile_size);
 
-  if (bytes_read == 0)
-    return TRUE;
+      return TRUE;
+    }
 
-  xcfdatalimit = &xcfodata[bytes_read - 1];
+  xcfdatalimit = &xcfdata[data_length - 1];
 
   for (i = 0; i < bpp; i++)
     {
@@ -2312,62 +2643,50 @@ xcf_load_tile_rle (XcfInfo       *info,
         }
     }
 
-  if (nonzero)
+  if (nonzero && file_version >= 12)
     {
-      if (info->file_version >= 12)
-        {
-          gint n_components = babl_format_get_n_components (format);
-
-          xcf_read_from_be (bpp / n_components, tile_data,
-                            tile_size / bpp * n_components);
-        }
+      gint n_components = babl_format_get_n_components (format);
 
-      gegl_buffer_set (buffer, tile_rect, 0, format, tile_data,
-                       GEGL_AUTO_ROWSTRIDE);
+      xcf_read_from_be (bpp / n_components, tile_data,
+                        tile_size / bpp * n_components);
     }
 
   return TRUE;
 
  bogus_rle:
+  g_set_error_literal (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                       "xcf: bogus RLE tile data. "
+                       "Possibly corrupt XCF file.");
   return FALSE;
 }
 
 static gboolean
-xcf_load_tile_zlib (XcfInfo       *info,
-                    GeglBuffer    *buffer,
-                    GeglRectangle *tile_rect,
-                    const Babl    *format,
-                    gint           data_length)
+xcf_load_tile_zlib (gint                 file_version,
+                    const GeglRectangle *tile_rect,
+                    const Babl          *format,
+                    const guchar        *xcfdata,
+                    gint                 data_length,
+                    guchar              *tile_data,
+                    GError             **error)
 {
   z_stream  strm;
   int       action;
   int       status;
   gint      bpp       = babl_format_get_bytes_per_pixel (format);
   gint      tile_size = bpp * tile_rect->width * tile_rect->height;
-  guchar   *tile_data = g_alloca (tile_size);
-  gsize     bytes_read;
-  guchar   *xcfdata;
 
   /* Workaround for bug #357809: avoid crashing on g_malloc() and skip
-   * this tile (return TRUE without storing data) as if it did not
+   * this tile (return TRUE with an empty tile) as if it did not
    * contain any data.  It is better than returning FALSE, which would
    * skip the whole hierarchy while there may still be some valid
    * tiles in the file.
    */
   if (data_length <= 0)
-    return TRUE;
-
-  xcfdata = g_alloca (data_length);
-
-  /* we have to read directly instead of xcf_read_* because we may be
-   * reading past the end of the file here
-   */
-  g_input_stream_read_all (info->input, xcfdata, data_length,
-                           &bytes_read, NULL, NULL);
-  info->cp += bytes_read;
+    {
+      memset (tile_data, 0, tile_size);
 
-  if (bytes_read == 0)
-    return TRUE;
+      return TRUE;
+    }
 
   strm.next_out  = tile_data;
   strm.avail_out = tile_size;
@@ -2375,13 +2694,17 @@ xcf_load_tile_zlib (XcfInfo       *info,
   strm.zalloc    = Z_NULL;
   strm.zfree     = Z_NULL;
   strm.opaque    = Z_NULL;
-  strm.next_in   = xcfdata;
-  strm.avail_in  = bytes_read;
+  strm.next_in   = (Bytef *) xcfdata;
+  strm.avail_in  = data_length;
 
   /* Initialize the stream decompression. */
   status = inflateInit (&strm);
   if (status != Z_OK)
-    return FALSE;
+    {
+      g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                   "xcf: tile decompression failed: %s", zError (status));
+      return FALSE;
+    }
 
   action = Z_NO_FLUSH;
 
@@ -2401,33 +2724,127 @@ xcf_load_tile_zlib (XcfInfo       *info,
         }
       else if (status == Z_BUF_ERROR)
         {
-          g_printerr ("xcf: decompressed tile bigger than the expected size.");
+          g_set_error_literal (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                               "xcf: decompressed tile bigger than the "
+                               "expected size.");
           inflateEnd (&strm);
           return FALSE;
         }
       else if (status != Z_OK)
         {
-          g_printerr ("xcf: tile decompression failed: %s", zError (status));
+          g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                       "xcf: tile decompression failed: %s", zError (status));
           inflateEnd (&strm);
           return FALSE;
         }
     }
 
-  if (! xcf_data_is_zero (tile_data, tile_size))
+  /* a short stream leaves the rest of the tile empty */
+  memset (strm.next_out, 0, strm.avail_out);
+
+  if (! xcf_data_is_zero (tile_data, tile_size) && file_version >= 12)
     {
-      if (info->file_version >= 12)
-        {
-          gint n_components = babl_format_get_n_components (format);
+      gint n_components = babl_format_get_n_components (format);
+
+      xcf_read_from_be (bpp / n_components, tile_data,
+                        tile_size / bpp * n_components);
+    }
+
+  inflateEnd (&strm);
 
-          xcf_read_from_be (bpp / n_components, tile_data,
-                            tile_size / bpp * n_components);
+  return TRUE;
+}
+
+static gboolean
+xcf_load_tile_codec (gint                 file_version,
+                     const GeglRectangle *tile_rect,
+                     const Babl          *format,
+                     const guchar        *xcfdata,
+                     gint                 data_length,
+                     guchar              *tile_data,
+                     GError             **error)
+{
+  gint           bpp       = babl_format_get_bytes_per_pixel (format);
+  gint           n_pixels  = tile_rect->width * tile_rect->height;
+  gint           tile_size = bpp * n_pixels;
+  guchar        *filtered  = g_alloca (tile_size);
+  XcfTileCodec   codec;
+  XcfTileFilter  filter;
+  gint           n_components;
+
+  /* same as in xcf_load_tile_rle() and xcf_load_tile_zlib(), treat
+   * missing data as an empty tile.
+   */
+  if (data_length <= 0)
+    {
+      memset (tile_data, 0, tile_size);
+
+      return TRUE;
+    }
+
+  codec  = xcfdata[0] & XCF_TILE_CODEC_MASK;
+  filter = xcfdata[0] >> XCF_TILE_FILTER_SHIFT;
+
+  xcfdata++;
+  data_length--;
+
+  if (filter != XCF_TILE_FILTER_NONE    &&
+      filter != XCF_TILE_FILTER_SHUFFLE &&
+      filter != XCF_TILE_FILTER_DELTA)
+    {
+      g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                   "xcf: unknown tile filter %d. "
+                   "Possibly corrupt XCF file.", filter);
+      return FALSE;
+    }
+
+  switch (codec)
+    {
+    case XCF_TILE_CODEC_RAW:
+      if (data_length < tile_size)
+        {
+          g_set_error_literal (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                               "xcf: truncated tile data. "
+                               "Possibly corrupt XCF file.");
+          return FALSE;
         }
 
-      gegl_buffer_set (buffer, tile_rect, 0, format, tile_data,
-                       GEGL_AUTO_ROWSTRIDE);
+      memcpy (filtered, xcfdata, tile_size);
+      break;
+
+    case XCF_TILE_CODEC_ZLIB:
+      {
+        uLongf size = tile_size;
+
+        /* uncompress() stops at the end of the stream, so it doesn't
+         * matter if we read past the tile's data
+         */
+        if (uncompress (filtered, &size, xcfdata, data_length) != Z_OK ||
+            size != tile_size)
+          {
+            g_set_error_literal (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                                 "xcf: tile decompression failed.");
+            return FALSE;
+          }
+      }
+      break;
+
+    default:
+      g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                   "xcf: unknown tile codec %d. "
+                   "Possibly corrupt XCF file.", codec);
+      return FALSE;
     }
 
-  inflateEnd (&strm);
+  xcf_tile_unfilter (filter, bpp, filtered, tile_data, n_pixels);
+
+  if (! xcf_data_is_zero (tile_data, tile_size))
+    {
+      n_components = babl_format_get_n_components (format);
+
+      xcf_read_from_be (bpp / n_components, tile_data,
+                        tile_size / bpp * n_components);
+    }
 
   return TRUE;
 }
@@ -23,6 +23,28 @@
 #define XCF_TILE_HEIGHT                 64
 #define XCF_TILE_MAX_DATA_LENGTH_FACTOR 1.5
 
+/* number of tiles which are encoded/decoded in parallel, before being
+ * written to/after being read from the file in order
+ */
+#define XCF_TILE_BATCH_SIZE             128
+
+/* maximal number of mipmap levels read from a hierarchy, enough for
+ * GIMP_MAX_IMAGE_SIZE
+ */
+#define XCF_MAX_LEVELS                  32
+
+/* Glimpse's own format extensions use a separate version range, far
+ * above the versions used by upstream GIMP (which keeps assigning
+ * versions from 14 on) and by CinePaint (v100 upwards), so that no
+ * other reader ever mistakes them for a file it knows how to load.
+ * Each extension version implies all features of XCF version 13.
+ * Keep in sync with gimp_image_get_xcf_version().
+ */
+#define XCF_EXT_VERSION_TILE_CODEC      900
+#define XCF_EXT_VERSION_MIPMAPS         901
+#define XCF_EXT_VERSION_MIN             XCF_EXT_VERSION_TILE_CODEC
+#define XCF_EXT_VERSION_MAX             XCF_EXT_VERSION_MIPMAPS
+
 typedef enum
 {
   PROP_END                =  0,
@@ -72,9 +94,31 @@ typedef enum
   COMPRESS_NONE              =  0,
   COMPRESS_RLE               =  1,
   COMPRESS_ZLIB              =  2,  /* unused */
-  COMPRESS_FRACTAL           =  3   /* unused */
+  COMPRESS_FRACTAL           =  3,  /* unused */
+  COMPRESS_TILE_CODEC        =  4   /* per-tile codec, since version 900 */
 } XcfCompressionType;
 
+/* with COMPRESS_TILE_CODEC, the data of each tile starts with a single
+ * byte, holding the XcfTileCodec used for the rest of the tile data in
+ * the low nibble, and the XcfTileFilter which was applied to the
+ * big-endian pixel data before compressing it in the high nibble.
+ */
+#define XCF_TILE_CODEC_MASK   0x0f
+#define XCF_TILE_FILTER_SHIFT 4
+
+typedef enum
+{
+  XCF_TILE_CODEC_RAW         =  0,
+  XCF_TILE_CODEC_ZLIB        =  1   /* other values are reserved */
+} XcfTileCodec;
+
+typedef enum
+{
+  XCF_TILE_FILTER_NONE       =  0,
+  XCF_TILE_FILTER_SHUFFLE    =  1,  /* group the n-th bytes of all pixels */
+  XCF_TILE_FILTER_DELTA      =  2   /* shuffle, then byte-wise difference */
+} XcfTileFilter;
+
 typedef enum
 {
   XCF_ORIENTATION_HORIZONTAL = 1,
@@ -112,6 +156,7 @@ struct _XcfInfo
   goffset             floating_sel_offset;
   XcfCompressionType  compression;
   gint                file_version;
+  GMappedFile        *mapped;
 };
 
 
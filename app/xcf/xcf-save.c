@@ -29,8 +29,8 @@
 
 #include "core/core-types.h"
 
+#include "gegl/gimp-babl.h"
 #include "gegl/gimp-babl-compat.h"
-#include "gegl/gimp-gegl-tile-compat.h"
 
 #include "core/gimp.h"
 #include "core/gimpcontainer.h"
@@ -68,11 +68,30 @@
 #include "xcf-read.h"
 #include "xcf-save.h"
 #include "xcf-seek.h"
+#include "xcf-utils.h"
 #include "xcf-write.h"
 
 #include "gimp-intl.h"
 
 
+typedef struct
+{
+  XcfInfo    *info;
+  GeglBuffer *buffer;
+  const Babl *format;
+  gint        level;
+  gint        width;
+  gint        height;
+  gint        max_data_length;
+  gint        first_tile;
+  guchar     *tiles_data;
+  gint       *tiles_length;
+  gint        success;
+  GMutex      error_mutex;
+  GError     *error;
+} XcfSaveLevelData;
+
+
 static gboolean xcf_save_image_props   (XcfInfo           *info,
                                         GimpImage         *image,
                                         GError           **error);
@@ -102,23 +121,43 @@ static gboolean xcf_save_buffer        (XcfInfo           *info,
                                         GError           **error);
 static gboolean xcf_save_level         (XcfInfo           *info,
                                         GeglBuffer        *buffer,
+                                        gint               level,
                                         GError           **error);
+static void     xcf_save_level_encode_tiles
+                                       (gsize              offset,
+                                        gsize              size,
+                                        XcfSaveLevelData  *data);
 static gboolean xcf_save_tile          (XcfInfo           *info,
                                         GeglBuffer        *buffer,
                                         GeglRectangle     *tile_rect,
+                                        gint               level,
                                         const Babl        *format,
-                                        GError           **error);
+                                        guchar            *tile_data,
+                                        gint              *length);
 static gboolean xcf_save_tile_rle      (XcfInfo           *info,
                                         GeglBuffer        *buffer,
                                         GeglRectangle     *tile_rect,
+                                        gint               level,
                                         const Babl        *format,
                                         guchar            *rlebuf,
+                                        gint              *length,
                                         GError           **error);
 static gboolean xcf_save_tile_zlib     (XcfInfo           *info,
                                         GeglBuffer        *buffer,
                                         GeglRectangle     *tile_rect,
+                                        gint               level,
                                         const Babl        *format,
+                                        guchar            *zlibbuf,
+                                        gint               max_length,
+                                        gint              *length,
                                         GError           **error);
+static gboolean xcf_save_tile_codec    (XcfInfo           *info,
+                                        GeglBuffer        *buffer,
+                                        GeglRectangle     *tile_rect,
+                                        gint               level,
+                                        const Babl        *format,
+                                        guchar            *codecbuf,
+                                        gint              *length);
 static gboolean xcf_save_parasite      (XcfInfo           *info,
                                         GimpParasite      *parasite,
                                         GError           **error);
@@ -1540,10 +1579,13 @@ xcf_save_buffer (XcfInfo     *info,
       /* seek to the level offset and save the level */
       xcf_check_error (xcf_seek_pos (info, offset, error));
 
-      if (i == 0)
+      if (i == 0 || info->file_version >= XCF_EXT_VERSION_MIPMAPS)
         {
-          /* write out the level. */
-          xcf_check_error (xcf_save_level (info, buffer, error));
+          /* write out the level.  from version XCF_EXT_VERSION_MIPMAPS
+           * on, the levels below the first one are real, downscaled
+           * copies of the buffer.
+           */
+          xcf_check_error (xcf_save_level (info, buffer, i, error));
         }
       else
         {
@@ -1579,30 +1621,31 @@ xcf_save_buffer (XcfInfo     *info,
 static gboolean
 xcf_save_level (XcfInfo     *info,
                 GeglBuffer  *buffer,
+                gint         level,
                 GError     **error)
 {
-  const Babl *format;
-  goffset    *offset_table;
-  goffset    *next_offset;
-  goffset     saved_pos;
-  goffset     offset;
-  goffset     max_data_length;
-  guint32     width;
-  guint32     height;
-  gint        bpp;
-  gint        n_tile_rows;
-  gint        n_tile_cols;
-  guint       ntiles;
-  gint        i;
-  guchar     *rlebuf    = NULL;
-  GError     *tmp_error = NULL;
+  XcfSaveLevelData  data;
+  const Babl       *format;
+  goffset          *offset_table;
+  goffset          *next_offset;
+  goffset           saved_pos;
+  goffset           offset;
+  goffset           max_data_length;
+  guint32           width;
+  guint32           height;
+  gint              bpp;
+  guint             ntiles;
+  gint              i;
+  GError           *tmp_error = NULL;
 
   format = gegl_buffer_get_format (buffer);
-
-  width  = gegl_buffer_get_width (buffer);
-  height = gegl_buffer_get_height (buffer);
   bpp    = babl_format_get_bytes_per_pixel (format);
 
+  xcf_level_get_size (gegl_buffer_get_width (buffer),
+                      gegl_buffer_get_height (buffer),
+                      level,
+                      (gint *) &width, (gint *) &height);
+
   xcf_write_int32_check_error (info, (guint32 *) &width,  1);
   xcf_write_int32_check_error (info, (guint32 *) &height, 1);
 
@@ -1615,16 +1658,7 @@ xcf_save_level (XcfInfo     *info,
   max_data_length = XCF_TILE_WIDTH * XCF_TILE_HEIGHT * bpp *
                     XCF_TILE_MAX_DATA_LENGTH_FACTOR /* = 1.5, currently */;
 
-  /* allocate a temporary buffer to store the rle data before it is
-   * written to disk
-   */
-  if (info->compression == COMPRESS_RLE)
-    rlebuf = g_alloca (max_data_length);
-
-  n_tile_rows = gimp_gegl_buffer_get_n_tile_rows (buffer, XCF_TILE_HEIGHT);
-  n_tile_cols = gimp_gegl_buffer_get_n_tile_cols (buffer, XCF_TILE_WIDTH);
-
-  ntiles = n_tile_rows * n_tile_cols;
+  ntiles = xcf_level_get_n_tiles (width, height);
 
   /* allocate an offset table so we don't have to seek back after each
    * tile, see bug #686862. allocate ntiles + 1 slots because a zero
@@ -1643,51 +1677,98 @@ xcf_save_level (XcfInfo     *info,
   /* 'offset' is where we will write the next tile */
   offset = info->cp;
 
-  for (i = 0; i < ntiles; i++)
+  /* the tiles are encoded in batches by multiple threads, each tile into
+   * its own slot of 'data.tiles_data'.  the encoded tiles of each batch
+   * are then written to the file in order by this thread, so that the
+   * result is identical to encoding and writing the tiles one by one.
+   */
+  data.info            = info;
+  data.buffer          = buffer;
+  data.format          = format;
+  data.level           = level;
+  data.width           = width;
+  data.height          = height;
+  data.max_data_length = max_data_length;
+  data.tiles_data      = g_malloc (MIN (ntiles, XCF_TILE_BATCH_SIZE) *
+                                   max_data_length);
+  data.tiles_length    = g_new (gint, MIN (ntiles, XCF_TILE_BATCH_SIZE));
+  data.error           = NULL;
+
+  g_mutex_init (&data.error_mutex);
+
+  for (i = 0; i < ntiles; i += XCF_TILE_BATCH_SIZE)
     {
-      GeglRectangle rect;
+      gint n_batch_tiles = MIN (ntiles - i, XCF_TILE_BATCH_SIZE);
+      gint j;
 
-      /* store the offset in the table and increment the next pointer */
-      *next_offset++ = offset;
+      data.first_tile = i;
+      data.success    = TRUE;
 
-      gimp_gegl_buffer_get_tile_rect (buffer,
-                                      XCF_TILE_WIDTH, XCF_TILE_HEIGHT,
-                                      i, &rect);
+      gegl_parallel_distribute_range (
+        n_batch_tiles, 1,
+        (GeglParallelDistributeRangeFunc) xcf_save_level_encode_tiles,
+        &data);
 
-      /* write out the tile. */
-      switch (info->compression)
+      if (! data.success)
         {
-        case COMPRESS_NONE:
-          xcf_check_error (xcf_save_tile (info, buffer, &rect, format,
-                                          error));
-          break;
-        case COMPRESS_RLE:
-          xcf_check_error (xcf_save_tile_rle (info, buffer, &rect, format,
-                                              rlebuf, error));
-          break;
-        case COMPRESS_ZLIB:
-          xcf_check_error (xcf_save_tile_zlib (info, buffer, &rect, format,
-                                               error));
-          break;
-        case COMPRESS_FRACTAL:
-          g_warning ("xcf: fractal compression unimplemented");
+          /* the workers only record the first error, report it here */
+          g_propagate_error (error, data.error);
+
+          g_mutex_clear (&data.error_mutex);
+          g_free (data.tiles_data);
+          g_free (data.tiles_length);
+
           return FALSE;
         }
 
-      /* make sure the on-disk tile data didn't end up being too big.
-       * xcf_load_level() would refuse to load the file if it did.
-       */
-      if (info->cp < offset || info->cp - offset > max_data_length)
+      for (j = 0; j < n_batch_tiles; j++)
         {
-          g_message ("xcf: invalid tile data length: %" G_GOFFSET_FORMAT,
-                     info->cp - offset);
-          return FALSE;
-        }
+          guchar *tile_data   = data.tiles_data + j * max_data_length;
+          gint    tile_length = data.tiles_length[j];
 
-      /* the next tile's offset is after the tile we just wrote */
-      offset = info->cp;
+          /* store the offset in the table and increment the next pointer */
+          *next_offset++ = offset;
+
+          /* write out the tile. */
+          xcf_write_int8 (info, tile_data, tile_length, &tmp_error);
+
+          if (tmp_error)
+            {
+              g_propagate_error (error, tmp_error);
+
+              g_mutex_clear (&data.error_mutex);
+              g_free (data.tiles_data);
+              g_free (data.tiles_length);
+
+              return FALSE;
+            }
+
+          /* make sure the on-disk tile data didn't end up being too big.
+           * xcf_load_level() would refuse to load the file if it did.
+           */
+          if (info->cp < offset || info->cp - offset > max_data_length)
+            {
+              g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                           _("Error writing XCF: invalid tile data length: "
+                             "%" G_GOFFSET_FORMAT),
+                           info->cp - offset);
+
+              g_mutex_clear (&data.error_mutex);
+              g_free (data.tiles_data);
+              g_free (data.tiles_length);
+
+              return FALSE;
+            }
+
+          /* the next tile's offset is after the tile we just wrote */
+          offset = info->cp;
+        }
     }
 
+  g_mutex_clear (&data.error_mutex);
+  g_free (data.tiles_data);
+  g_free (data.tiles_length);
+
   /* seek back to the offset table and write it  */
   xcf_check_error (xcf_seek_pos (info, saved_pos, error));
   xcf_write_offset_check_error (info, offset_table, ntiles + 1);
@@ -1698,33 +1779,102 @@ xcf_save_level (XcfInfo     *info,
   return TRUE;
 }
 
+static void
+xcf_save_level_encode_tiles (gsize             offset,
+                             gsize             size,
+                             XcfSaveLevelData *data)
+{
+  gsize i;
+
+  for (i = offset; i < offset + size; i++)
+    {
+      XcfInfo       *info      = data->info;
+      guchar        *tile_data = data->tiles_data + i * data->max_data_length;
+      gint          *length    = &data->tiles_length[i];
+      GeglRectangle  rect;
+      gboolean       success   = FALSE;
+      GError        *error     = NULL;
+
+      if (! g_atomic_int_get (&data->success))
+        return;
+
+      xcf_level_get_tile_rect (data->width, data->height,
+                               data->first_tile + i, &rect);
+
+      /* encode the tile. */
+      switch (info->compression)
+        {
+        case COMPRESS_NONE:
+          success = xcf_save_tile (info, data->buffer, &rect, data->level,
+                                   data->format, tile_data, length);
+          break;
+        case COMPRESS_RLE:
+          success = xcf_save_tile_rle (info, data->buffer, &rect, data->level,
+                                       data->format, tile_data, length,
+                                       &error);
+          break;
+        case COMPRESS_ZLIB:
+          success = xcf_save_tile_zlib (info, data->buffer, &rect, data->level,
+                                        data->format, tile_data,
+                                        data->max_data_length, length,
+                                        &error);
+          break;
+        case COMPRESS_FRACTAL:
+          g_set_error_literal (&error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                               "xcf: fractal compression unimplemented");
+          break;
+        case COMPRESS_TILE_CODEC:
+          success = xcf_save_tile_codec (info, data->buffer, &rect, data->level,
+                                         data->format, tile_data, length);
+          break;
+        }
+
+      if (! success)
+        {
+          /* errors can't be reported from the worker threads, keep the
+           * first one for xcf_save_level()
+           */
+          g_mutex_lock (&data->error_mutex);
+
+          if (! data->error)
+            data->error = error;
+          else
+            g_clear_error (&error);
+
+          g_mutex_unlock (&data->error_mutex);
+
+          g_atomic_int_set (&data->success, FALSE);
+
+          return;
+        }
+    }
+}
+
 static gboolean
 xcf_save_tile (XcfInfo        *info,
                GeglBuffer     *buffer,
                GeglRectangle  *tile_rect,
+               gint            level,
                const Babl     *format,
-               GError        **error)
+               guchar         *tile_data,
+               gint           *length)
 {
-  gint    bpp       = babl_format_get_bytes_per_pixel (format);
-  gint    tile_size = bpp * tile_rect->width * tile_rect->height;
-  guchar *tile_data = g_alloca (tile_size);
-  GError *tmp_error = NULL;
+  gint bpp       = babl_format_get_bytes_per_pixel (format);
+  gint tile_size = bpp * tile_rect->width * tile_rect->height;
 
-  gegl_buffer_get (buffer, tile_rect, 1.0, format, tile_data,
+  gegl_buffer_get (buffer, tile_rect, 1.0 / (1 << level), format, tile_data,
                    GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
 
-  if (info->file_version <= 11)
-    {
-      xcf_write_int8_check_error (info, tile_data, tile_size);
-    }
-  else
+  if (info->file_version >= 12)
     {
       gint n_components = babl_format_get_n_components (format);
 
-      xcf_write_component_check_error (info, bpp / n_components, tile_data,
-                                       tile_size / bpp * n_components);
+      xcf_write_to_be (bpp / n_components, tile_data,
+                       tile_size / bpp * n_components);
     }
 
+  *length = tile_size;
+
   return TRUE;
 }
 
@@ -1732,8 +1882,10 @@ static gboolean
 xcf_save_tile_rle (XcfInfo        *info,
                    GeglBuffer     *buffer,
                    GeglRectangle  *tile_rect,
+                   gint            level,
                    const Babl     *format,
                    guchar         *rlebuf,
+                   gint           *length,
                    GError        **error)
 {
   gint    bpp       = babl_format_get_bytes_per_pixel (format);
@@ -1741,9 +1893,8 @@ xcf_save_tile_rle (XcfInfo        *info,
   guchar *tile_data = g_alloca (tile_size);
   gint    len       = 0;
   gint    i, j;
-  GError *tmp_error  = NULL;
 
-  gegl_buffer_get (buffer, tile_rect, 1.0, format, tile_data,
+  gegl_buffer_get (buffer, tile_rect, 1.0 / (1 << level), format, tile_data,
                    GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
 
   if (info->file_version >= 12)
@@ -1854,10 +2005,14 @@ xcf_save_tile_rle (XcfInfo        *info,
         }
 
       if (count != (tile_rect->width * tile_rect->height))
-        g_message ("xcf: uh oh! xcf rle tile saving error: %d", count);
+        {
+          g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                       "xcf: uh oh! xcf rle tile saving error: %d", count);
+          return FALSE;
+        }
     }
 
-  xcf_write_int8_check_error (info, rlebuf, len);
+  *length = len;
 
   return TRUE;
 }
@@ -1866,20 +2021,21 @@ static gboolean
 xcf_save_tile_zlib (XcfInfo        *info,
                     GeglBuffer     *buffer,
                     GeglRectangle  *tile_rect,
+                    gint            level,
                     const Babl     *format,
+                    guchar         *zlibbuf,
+                    gint            max_length,
+                    gint           *length,
                     GError        **error)
 {
   gint      bpp       = babl_format_get_bytes_per_pixel (format);
   gint      tile_size = bpp * tile_rect->width * tile_rect->height;
   guchar   *tile_data = g_alloca (tile_size);
-  /* The buffer for compressed data. */
-  guchar   *buf       = g_alloca (tile_size);
-  GError   *tmp_error = NULL;
   z_stream  strm;
   int       action;
   int       status;
 
-  gegl_buffer_get (buffer, tile_rect, 1.0, format, tile_data,
+  gegl_buffer_get (buffer, tile_rect, 1.0 / (1 << level), format, tile_data,
                    GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
 
   if (info->file_version >= 12)
@@ -1897,16 +2053,21 @@ xcf_save_tile_zlib (XcfInfo        *info,
 
   status = deflateInit (&strm, Z_DEFAULT_COMPRESSION);
   if (status != Z_OK)
-    return FALSE;
+    {
+      g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                   _("Error writing XCF: tile compression failed: %s"),
+                   zError (status));
+      return FALSE;
+    }
 
   strm.next_in   = tile_data;
   strm.avail_in  = tile_size;
-  strm.next_out  = buf;
-  strm.avail_out = tile_size;
+  strm.next_out  = zlibbuf;
+  strm.avail_out = max_length;
 
   action = Z_NO_FLUSH;
 
-  while (status == Z_OK || status == Z_BUF_ERROR)
+  while (status == Z_OK)
     {
       if (strm.avail_in == 0)
         {
@@ -1916,28 +2077,110 @@ xcf_save_tile_zlib (XcfInfo        *info,
 
       status = deflate (&strm, action);
 
-      if (status == Z_STREAM_END || status == Z_BUF_ERROR)
+      if (status == Z_OK && strm.avail_out == 0)
         {
-          size_t write_size = tile_size - strm.avail_out;
-
-          xcf_write_int8_check_error (info, buf, write_size);
-
-          /* Reset next_out and avail_out. */
-          strm.next_out  = buf;
-          strm.avail_out = tile_size;
+          /* the compressed data doesn't fit in the maximal allowable
+           * tile data length.  xcf_load_level() would refuse to load
+           * the file.
+           */
+          g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                       _("Error writing XCF: invalid tile data length: "
+                         "> %d"),
+                       max_length);
+          deflateEnd (&strm);
+          return FALSE;
         }
-      else if (status != Z_OK)
+      else if (status != Z_OK && status != Z_STREAM_END)
         {
-          g_printerr ("xcf: tile compression failed: %s", zError (status));
+          g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                       _("Error writing XCF: tile compression failed: %s"),
+                       zError (status));
           deflateEnd (&strm);
           return FALSE;
         }
     }
 
+  *length = max_length - strm.avail_out;
+
   deflateEnd (&strm);
   return TRUE;
 }
 
+/* encodes the tile using the tile codec, prefixed by the codec tag byte.
+ * the only codec is zlib at its fastest level, applied after a byte
+ * shuffle or delta filter; the tag byte leaves room for other codecs.
+ * tiles which don't compress are stored uncompressed, so the encoded
+ * tile is never more than one byte larger than the raw tile data.
+ */
+static gboolean
+xcf_save_tile_codec (XcfInfo        *info,
+                     GeglBuffer     *buffer,
+                     GeglRectangle  *tile_rect,
+                     gint            level,
+                     const Babl     *format,
+                     guchar         *codecbuf,
+                     gint           *length)
+{
+  gint           bpp       = babl_format_get_bytes_per_pixel (format);
+  gint           n_pixels  = tile_rect->width * tile_rect->height;
+  gint           tile_size = bpp * n_pixels;
+  guchar        *tile_data = g_alloca (tile_size);
+  guchar        *filtered  = g_alloca (tile_size);
+  gint           n_components;
+  XcfTileFilter  filter;
+  uLongf         compressed_length = tile_size - 1;
+
+  gegl_buffer_get (buffer, tile_rect, 1.0 / (1 << level), format, tile_data,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+  n_components = babl_format_get_n_components (format);
+
+  xcf_write_to_be (bpp / n_components, tile_data,
+                   tile_size / bpp * n_components);
+
+  /* byte-wise differences only make sense for integer components, for
+   * floating point components, only group the corresponding bytes
+   * of the pixels.
+   */
+  switch (gimp_babl_format_get_component_type (format))
+    {
+    case GIMP_COMPONENT_TYPE_HALF:
+    case GIMP_COMPONENT_TYPE_FLOAT:
+    case GIMP_COMPONENT_TYPE_DOUBLE:
+      filter = XCF_TILE_FILTER_SHUFFLE;
+      break;
+
+    default:
+      filter = XCF_TILE_FILTER_DELTA;
+      break;
+    }
+
+  xcf_tile_filter (filter, bpp, tile_data, filtered, n_pixels);
+
+  /* limit the compressed data to less than the raw data, so that
+   * incompressible tiles fail to compress, and are stored raw instead.
+   */
+  if (compress2 (codecbuf + 1, &compressed_length,
+                 filtered, tile_size,
+                 Z_BEST_SPEED) == Z_OK)
+    {
+      codecbuf[0] = XCF_TILE_CODEC_ZLIB | (filter << XCF_TILE_FILTER_SHIFT);
+
+      *length = compressed_length + 1;
+    }
+  else
+    {
+      codecbuf[0] = XCF_TILE_CODEC_RAW |
+                    (XCF_TILE_FILTER_NONE << XCF_TILE_FILTER_SHIFT);
+
+      memcpy (codecbuf + 1, tile_data, tile_size);
+
+      *length = tile_size + 1;
+    }
+
+  return TRUE;
+}
+
 static gboolean
 xcf_save_parasite (XcfInfo       *info,
                    GimpParasite  *parasite,
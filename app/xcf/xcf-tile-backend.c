@@ -0,0 +1,769 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <cairo.h>
+#include <gegl.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#include "libgimpbase/gimpbase.h"
+
+#include "core/core-types.h"
+
+#include "xcf-private.h"
+#include "xcf-load.h"
+#include "xcf-tile-backend.h"
+#include "xcf-utils.h"
+
+
+/* the keys of file tiles pack the tile coordinates into 24, 24 and 16
+ * bits; even with 1x1 tiles, the largest image has fewer tiles.
+ */
+#define XCF_TILE_KEY_MAX_XY (1 << 24)
+
+G_STATIC_ASSERT (GIMP_MAX_IMAGE_SIZE < XCF_TILE_KEY_MAX_XY);
+G_STATIC_ASSERT (XCF_MAX_LEVELS < (1 << 15));
+
+
+/* the backend's tiles have GEGL's tile size, so that the buffer's tiles
+ * can be shared with the drawable's other buffers, and are assembled
+ * from the XCF tiles of the file, which are always 64x64.
+ */
+typedef struct
+{
+  gint     width;
+  gint     height;
+  gint     n_cols;       /* in backend tiles */
+  gint     n_rows;
+  gint     n_tile_cols;  /* in XCF tiles */
+  gint     n_tile_rows;
+  goffset *offsets;
+} XcfTileBackendLevel;
+
+struct _XcfTileBackendPrivate
+{
+  /* only clean tiles are decoded from the file.  the mapping is
+   * protected by 'file_lock', since it is dropped when the file is
+   * about to be overwritten.
+   */
+  GFile               *file;
+  GMappedFile         *mapped;
+  GRWLock              file_lock;
+  XcfCompressionType   compression;
+  gint                 file_version;
+  const Babl          *format;
+  gint                 width;
+  gint                 height;
+  gint                 tile_width;
+  gint                 tile_height;
+  goffset              max_data_length;
+  gint                 decode_failed;
+
+  XcfTileBackendLevel  levels[XCF_MAX_LEVELS];
+
+  /* tiles written by GEGL go to a regular, swap-backed buffer, so they
+   * are subject to GEGL's cache and swap limits like any other tile.
+   */
+  GeglBuffer          *store;
+  GeglTileSource      *store_backend;
+  /* keys of the file tiles whose data in the file is no longer valid;
+   * these, and all tiles outside of the file, are looked up in the store.
+   */
+  GHashTable          *overridden;
+  GMutex               mutex;
+
+  /* our entry in 'backends' */
+  GWeakRef            *weak_ref;
+};
+
+
+static void       xcf_tile_backend_finalize    (GObject         *object);
+
+static gpointer   xcf_tile_backend_command     (GeglTileSource  *tile_store,
+                                                GeglTileCommand  command,
+                                                gint             x,
+                                                gint             y,
+                                                gint             z,
+                                                gpointer         data);
+
+static GeglTile * xcf_tile_backend_get_tile    (XcfTileBackend  *backend,
+                                                gint             x,
+                                                gint             y,
+                                                gint             z);
+static void       xcf_tile_backend_set_tile    (XcfTileBackend  *backend,
+                                                gint             x,
+                                                gint             y,
+                                                gint             z,
+                                                GeglTile        *tile);
+static void       xcf_tile_backend_void_tile   (XcfTileBackend  *backend,
+                                                gint             x,
+                                                gint             y,
+                                                gint             z);
+static gboolean   xcf_tile_backend_tile_exists (XcfTileBackend  *backend,
+                                                gint             x,
+                                                gint             y,
+                                                gint             z);
+static GeglTile * xcf_tile_backend_decode_tile (XcfTileBackend  *backend,
+                                                gint             x,
+                                                gint             y,
+                                                gint             z);
+static void       xcf_tile_backend_release     (XcfTileBackend  *backend);
+
+
+G_DEFINE_TYPE_WITH_PRIVATE (XcfTileBackend, xcf_tile_backend,
+                            GEGL_TYPE_TILE_BACKEND)
+
+#define parent_class xcf_tile_backend_parent_class
+
+
+/* weak references to all backends which map a file, for
+ * xcf_tile_backend_release_file().  the references are only cleared
+ * in finalize, but a backend which is being destroyed can't be
+ * resurrected through them.
+ */
+static GMutex  backends_mutex;
+static GList  *backends = NULL;
+
+
+static void
+xcf_tile_backend_class_init (XcfTileBackendClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = xcf_tile_backend_finalize;
+}
+
+static void
+xcf_tile_backend_init (XcfTileBackend *backend)
+{
+  GeglTileSource *source = GEGL_TILE_SOURCE (backend);
+
+  backend->priv = xcf_tile_backend_get_instance_private (backend);
+
+  source->command = xcf_tile_backend_command;
+
+  backend->priv->overridden = g_hash_table_new_full (g_int64_hash,
+                                                     g_int64_equal,
+                                                     g_free, NULL);
+
+  g_rw_lock_init (&backend->priv->file_lock);
+  g_mutex_init (&backend->priv->mutex);
+}
+
+static void
+xcf_tile_backend_finalize (GObject *object)
+{
+  XcfTileBackend        *backend = XCF_TILE_BACKEND (object);
+  XcfTileBackendPrivate *priv    = backend->priv;
+  gint                   i;
+
+  if (priv->weak_ref)
+    {
+      g_mutex_lock (&backends_mutex);
+      backends = g_list_remove (backends, priv->weak_ref);
+      g_mutex_unlock (&backends_mutex);
+
+      g_weak_ref_clear (priv->weak_ref);
+      g_clear_pointer (&priv->weak_ref, g_free);
+    }
+
+  for (i = 0; i < XCF_MAX_LEVELS; i++)
+    g_free (priv->levels[i].offsets);
+
+  g_clear_pointer (&priv->overridden, g_hash_table_unref);
+
+  g_clear_object (&priv->store);
+  g_clear_pointer (&priv->mapped, g_mapped_file_unref);
+  g_clear_object (&priv->file);
+
+  g_rw_lock_clear (&priv->file_lock);
+  g_mutex_clear (&priv->mutex);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static gpointer
+xcf_tile_backend_command (GeglTileSource  *tile_store,
+                          GeglTileCommand  command,
+                          gint             x,
+                          gint             y,
+                          gint             z,
+                          gpointer         data)
+{
+  XcfTileBackend *backend = XCF_TILE_BACKEND (tile_store);
+  gpointer        result  = NULL;
+
+  switch (command)
+    {
+    case GEGL_TILE_GET:
+      result = xcf_tile_backend_get_tile (backend, x, y, z);
+      break;
+
+    case GEGL_TILE_SET:
+      xcf_tile_backend_set_tile (backend, x, y, z, data);
+
+      gegl_tile_mark_as_stored (data);
+      break;
+
+    case GEGL_TILE_VOID:
+      xcf_tile_backend_void_tile (backend, x, y, z);
+      break;
+
+    case GEGL_TILE_EXIST:
+      result = GINT_TO_POINTER (xcf_tile_backend_tile_exists (backend,
+                                                              x, y, z));
+      break;
+
+    default:
+      result = gegl_tile_backend_command (GEGL_TILE_BACKEND (tile_store),
+                                          command, x, y, z, data);
+      break;
+    }
+
+  return result;
+}
+
+/* returns TRUE if the tile is one of the file's tiles.  the levels are
+ * never modified after loading, so this doesn't need the lock.
+ */
+static gboolean
+xcf_tile_backend_in_file (XcfTileBackend *backend,
+                          gint            x,
+                          gint            y,
+                          gint            z)
+{
+  XcfTileBackendPrivate *priv = backend->priv;
+
+  return z >= 0 && z < XCF_MAX_LEVELS &&
+         priv->levels[z].offsets      &&
+         x >= 0 && x < priv->levels[z].n_cols &&
+         y >= 0 && y < priv->levels[z].n_rows;
+}
+
+static gint64
+xcf_tile_backend_key (gint x,
+                      gint y,
+                      gint z)
+{
+  g_assert (x >= 0 && x < XCF_TILE_KEY_MAX_XY);
+  g_assert (y >= 0 && y < XCF_TILE_KEY_MAX_XY);
+  g_assert (z >= 0 && z < XCF_MAX_LEVELS);
+
+  return ((gint64) z << 48) | ((gint64) y << 24) | (gint64) x;
+}
+
+static void
+xcf_tile_backend_override (XcfTileBackend *backend,
+                           gint            x,
+                           gint            y,
+                           gint            z)
+{
+  gint64 *key = g_new (gint64, 1);
+
+  *key = xcf_tile_backend_key (x, y, z);
+
+  g_hash_table_add (backend->priv->overridden, key);
+}
+
+static gboolean
+xcf_tile_backend_is_overridden (XcfTileBackend *backend,
+                                gint            x,
+                                gint            y,
+                                gint            z)
+{
+  gint64 key = xcf_tile_backend_key (x, y, z);
+
+  return g_hash_table_contains (backend->priv->overridden, &key);
+}
+
+static GeglTileSource *
+xcf_tile_backend_get_store (XcfTileBackend *backend)
+{
+  XcfTileBackendPrivate *priv = backend->priv;
+
+  if (! priv->store)
+    {
+      priv->store = g_object_new (GEGL_TYPE_BUFFER,
+                                  "x",           0,
+                                  "y",           0,
+                                  "width",       priv->width,
+                                  "height",      priv->height,
+                                  "tile-width",  priv->tile_width,
+                                  "tile-height", priv->tile_height,
+                                  "format",      priv->format,
+                                  NULL);
+
+      /* talk to the store's backend directly, the buffer on top of
+       * this backend already caches the tiles
+       */
+      priv->store_backend =
+        GEGL_TILE_SOURCE (gegl_buffer_backend (priv->store));
+    }
+
+  return priv->store_backend;
+}
+
+static void
+xcf_tile_backend_invalidate_levels (XcfTileBackend *backend,
+                                    gint            x,
+                                    gint            y,
+                                    gint            z)
+{
+  gint level;
+
+  /* the file's tiles of the levels above a modified tile don't match
+   * the buffer anymore
+   */
+  for (level = z + 1; level < XCF_MAX_LEVELS; level++)
+    {
+      x >>= 1;
+      y >>= 1;
+
+      if (xcf_tile_backend_in_file (backend, x, y, level))
+        xcf_tile_backend_override (backend, x, y, level);
+    }
+}
+
+static GeglTile *
+xcf_tile_backend_get_tile (XcfTileBackend *backend,
+                           gint            x,
+                           gint            y,
+                           gint            z)
+{
+  XcfTileBackendPrivate *priv = backend->priv;
+  GeglTile              *tile = NULL;
+  gboolean               from_file;
+
+  /* the mapping is only dropped under the write lock, after moving the
+   * file's tiles to the store, so the tile can't move in between
+   */
+  g_rw_lock_reader_lock (&priv->file_lock);
+
+  g_mutex_lock (&priv->mutex);
+
+  from_file = xcf_tile_backend_in_file (backend, x, y, z) &&
+              ! xcf_tile_backend_is_overridden (backend, x, y, z);
+
+  if (! from_file && priv->store)
+    tile = gegl_tile_source_get_tile (priv->store_backend, x, y, z);
+
+  g_mutex_unlock (&priv->mutex);
+
+  /* the level tables are never modified, so we can decode without
+   * holding the mutex
+   */
+  if (from_file)
+    tile = xcf_tile_backend_decode_tile (backend, x, y, z);
+
+  g_rw_lock_reader_unlock (&priv->file_lock);
+
+  return tile;
+}
+
+static void
+xcf_tile_backend_set_tile (XcfTileBackend *backend,
+                           gint            x,
+                           gint            y,
+                           gint            z,
+                           GeglTile       *tile)
+{
+  XcfTileBackendPrivate *priv = backend->priv;
+
+  g_mutex_lock (&priv->mutex);
+
+  gegl_tile_source_set_tile (xcf_tile_backend_get_store (backend),
+                             x, y, z, tile);
+
+  if (xcf_tile_backend_in_file (backend, x, y, z))
+    xcf_tile_backend_override (backend, x, y, z);
+
+  xcf_tile_backend_invalidate_levels (backend, x, y, z);
+
+  g_mutex_unlock (&priv->mutex);
+}
+
+static void
+xcf_tile_backend_void_tile (XcfTileBackend *backend,
+                            gint            x,
+                            gint            y,
+                            gint            z)
+{
+  XcfTileBackendPrivate *priv = backend->priv;
+
+  g_mutex_lock (&priv->mutex);
+
+  if (priv->store)
+    gegl_tile_source_void (priv->store_backend, x, y, z);
+
+  if (xcf_tile_backend_in_file (backend, x, y, z))
+    xcf_tile_backend_override (backend, x, y, z);
+
+  xcf_tile_backend_invalidate_levels (backend, x, y, z);
+
+  g_mutex_unlock (&priv->mutex);
+}
+
+static gboolean
+xcf_tile_backend_tile_exists (XcfTileBackend *backend,
+                              gint            x,
+                              gint            y,
+                              gint            z)
+{
+  XcfTileBackendPrivate *priv = backend->priv;
+  gboolean               exists;
+
+  g_mutex_lock (&priv->mutex);
+
+  if (xcf_tile_backend_in_file (backend, x, y, z) &&
+      ! xcf_tile_backend_is_overridden (backend, x, y, z))
+    {
+      exists = TRUE;
+    }
+  else
+    {
+      exists = priv->store &&
+               gegl_tile_source_exist (priv->store_backend, x, y, z);
+    }
+
+  g_mutex_unlock (&priv->mutex);
+
+  return exists;
+}
+
+/* tiles are decoded in GEGL's threads, where we can't show messages.
+ * print the first failure of each backend, the undecodable parts of
+ * the tile are left empty.
+ */
+static void
+xcf_tile_backend_decode_failed (XcfTileBackend *backend,
+                                gint            tile_num,
+                                gint            z,
+                                const GError   *error)
+{
+  XcfTileBackendPrivate *priv = backend->priv;
+
+  if (g_atomic_int_compare_and_exchange (&priv->decode_failed, FALSE, TRUE))
+    {
+      gchar *name = g_file_get_parse_name (priv->file);
+
+      g_printerr ("xcf: failed to decode tile %d of level %d of '%s': %s\n"
+                  "The tile is left empty.\n",
+                  tile_num, z, name, error->message);
+
+      g_free (name);
+    }
+}
+
+/* must be called with 'file_lock' held */
+static GeglTile *
+xcf_tile_backend_decode_tile (XcfTileBackend *backend,
+                              gint            x,
+                              gint            y,
+                              gint            z)
+{
+  XcfTileBackendPrivate *priv = backend->priv;
+  XcfTileBackendLevel   *level;
+  GeglTile              *tile;
+  GeglRectangle          tile_rect;
+  const guchar          *contents;
+  goffset                file_size;
+  guchar                *xcf_data;
+  guchar                *dest;
+  gint                   bpp;
+  gint                   tile_size;
+  gint                   col, first_col, last_col;
+  gint                   row, first_row, last_row;
+
+  /* the file was released, its tiles were moved to the store */
+  if (! priv->mapped)
+    return NULL;
+
+  level = &priv->levels[z];
+
+  contents  = (const guchar *) g_mapped_file_get_contents (priv->mapped);
+  file_size = g_mapped_file_get_length (priv->mapped);
+
+  tile_rect.x      = x * priv->tile_width;
+  tile_rect.y      = y * priv->tile_height;
+  tile_rect.width  = priv->tile_width;
+  tile_rect.height = priv->tile_height;
+
+  bpp       = babl_format_get_bytes_per_pixel (priv->format);
+  tile_size = priv->tile_width * priv->tile_height * bpp;
+  xcf_data  = g_alloca (XCF_TILE_WIDTH * XCF_TILE_HEIGHT * bpp);
+
+  tile = gegl_tile_new (tile_size);
+  dest = gegl_tile_get_data (tile);
+
+  memset (dest, 0, tile_size);
+
+  /* decode all XCF tiles which intersect the tile */
+  first_col = tile_rect.x / XCF_TILE_WIDTH;
+  first_row = tile_rect.y / XCF_TILE_HEIGHT;
+  last_col  = MIN ((tile_rect.x + tile_rect.width  - 1) / XCF_TILE_WIDTH,
+                   level->n_tile_cols - 1);
+  last_row  = MIN ((tile_rect.y + tile_rect.height - 1) / XCF_TILE_HEIGHT,
+                   level->n_tile_rows - 1);
+
+  for (row = first_row; row <= last_row; row++)
+    for (col = first_col; col <= last_col; col++)
+      {
+        GeglRectangle rect;
+        GeglRectangle isect;
+        goffset       offset;
+        goffset       offset2;
+        gint          tile_num = row * level->n_tile_cols + col;
+        gint          i;
+        GError       *error    = NULL;
+
+        offset  = level->offsets[tile_num];
+        offset2 = level->offsets[tile_num + 1];
+
+        /* the last tile of a level has no end offset, and the file may
+         * end prematurely, like in xcf_load_level().
+         */
+        if (offset2 == 0)
+          offset2 = offset + priv->max_data_length;
+
+        offset  = MIN (offset,  file_size);
+        offset2 = MIN (offset2, file_size);
+
+        xcf_level_get_tile_rect (level->width, level->height, tile_num,
+                                 &rect);
+
+        if (! xcf_load_decode_tile (priv->compression, priv->file_version,
+                                    &rect, priv->format,
+                                    contents + offset, offset2 - offset,
+                                    xcf_data, &error))
+          {
+            xcf_tile_backend_decode_failed (backend, tile_num, z, error);
+            g_clear_error (&error);
+
+            continue;
+          }
+
+        gegl_rectangle_intersect (&isect, &rect, &tile_rect);
+
+        for (i = 0; i < isect.height; i++)
+          {
+            memcpy (dest     + ((isect.y - tile_rect.y + i) * tile_rect.width +
+                                (isect.x - tile_rect.x)) * bpp,
+                    xcf_data + ((isect.y - rect.y + i) * rect.width +
+                                (isect.x - rect.x)) * bpp,
+                    isect.width * bpp);
+          }
+      }
+
+  /* let GEGL use its shared empty tile */
+  if (xcf_data_is_zero (dest, tile_size))
+    {
+      gegl_tile_unref (tile);
+
+      return NULL;
+    }
+
+  gegl_tile_mark_as_stored (tile);
+
+  return tile;
+}
+
+/* moves all file tiles which are still valid to the store, and drops
+ * the mapping, after which the file may be modified.
+ */
+static void
+xcf_tile_backend_release (XcfTileBackend *backend)
+{
+  XcfTileBackendPrivate *priv = backend->priv;
+  gint                   z;
+
+  g_rw_lock_writer_lock (&priv->file_lock);
+  g_mutex_lock (&priv->mutex);
+
+  for (z = 0; z < XCF_MAX_LEVELS && priv->mapped; z++)
+    {
+      XcfTileBackendLevel *level = &priv->levels[z];
+      gint                 x, y;
+
+      if (! level->offsets)
+        continue;
+
+      for (y = 0; y < level->n_rows; y++)
+        for (x = 0; x < level->n_cols; x++)
+          {
+            GeglTile *tile;
+
+            if (xcf_tile_backend_is_overridden (backend, x, y, z))
+              continue;
+
+            tile = xcf_tile_backend_decode_tile (backend, x, y, z);
+
+            if (tile)
+              {
+                gegl_tile_source_set_tile (xcf_tile_backend_get_store (backend),
+                                           x, y, z, tile);
+                gegl_tile_unref (tile);
+              }
+
+            xcf_tile_backend_override (backend, x, y, z);
+          }
+    }
+
+  g_clear_pointer (&priv->mapped, g_mapped_file_unref);
+
+  g_mutex_unlock (&priv->mutex);
+  g_rw_lock_writer_unlock (&priv->file_lock);
+}
+
+
+/*  public functions  */
+
+GeglTileBackend *
+xcf_tile_backend_new (GFile              *file,
+                      GMappedFile        *mapped,
+                      XcfCompressionType  compression,
+                      gint                file_version,
+                      const Babl         *format,
+                      gint                width,
+                      gint                height,
+                      gint                tile_width,
+                      gint                tile_height)
+{
+  GeglTileBackend *backend;
+  XcfTileBackend  *xcf_backend;
+
+  g_return_val_if_fail (G_IS_FILE (file), NULL);
+  g_return_val_if_fail (mapped != NULL, NULL);
+  g_return_val_if_fail (format != NULL, NULL);
+  g_return_val_if_fail (tile_width > 0 && tile_height > 0, NULL);
+
+  backend = g_object_new (XCF_TYPE_TILE_BACKEND,
+                          "tile-width",  tile_width,
+                          "tile-height", tile_height,
+                          "format",      format,
+                          NULL);
+
+  xcf_backend = XCF_TILE_BACKEND (backend);
+
+  xcf_backend->priv->file            = g_object_ref (file);
+  xcf_backend->priv->mapped          = g_mapped_file_ref (mapped);
+  xcf_backend->priv->compression     = compression;
+  xcf_backend->priv->file_version    = file_version;
+  xcf_backend->priv->format          = format;
+  xcf_backend->priv->width           = width;
+  xcf_backend->priv->height          = height;
+  xcf_backend->priv->tile_width      = tile_width;
+  xcf_backend->priv->tile_height     = tile_height;
+  xcf_backend->priv->max_data_length =
+    XCF_TILE_WIDTH * XCF_TILE_HEIGHT *
+    babl_format_get_bytes_per_pixel (format) *
+    XCF_TILE_MAX_DATA_LENGTH_FACTOR;
+
+  gegl_tile_backend_set_extent (backend,
+                                GEGL_RECTANGLE (0, 0, width, height));
+
+  xcf_backend->priv->weak_ref = g_new0 (GWeakRef, 1);
+  g_weak_ref_init (xcf_backend->priv->weak_ref, backend);
+
+  g_mutex_lock (&backends_mutex);
+  backends = g_list_prepend (backends, xcf_backend->priv->weak_ref);
+  g_mutex_unlock (&backends_mutex);
+
+  return backend;
+}
+
+/* takes ownership of 'offsets', which must hold 'n_tiles' validated
+ * tile offsets, followed by a '0'.  must be called before the backend
+ * is used.
+ */
+void
+xcf_tile_backend_add_level (XcfTileBackend *backend,
+                            gint            level,
+                            goffset        *offsets,
+                            gint            n_tiles)
+{
+  XcfTileBackendPrivate *priv;
+  XcfTileBackendLevel   *backend_level;
+
+  g_return_if_fail (XCF_IS_TILE_BACKEND (backend));
+  g_return_if_fail (level >= 0 && level < XCF_MAX_LEVELS);
+  g_return_if_fail (offsets != NULL);
+
+  priv          = backend->priv;
+  backend_level = &priv->levels[level];
+
+  g_free (backend_level->offsets);
+
+  xcf_level_get_size (priv->width, priv->height, level,
+                      &backend_level->width, &backend_level->height);
+
+  backend_level->n_tile_cols = (backend_level->width  + XCF_TILE_WIDTH  - 1) /
+                               XCF_TILE_WIDTH;
+  backend_level->n_tile_rows = (backend_level->height + XCF_TILE_HEIGHT - 1) /
+                               XCF_TILE_HEIGHT;
+  backend_level->n_cols      = (backend_level->width  + priv->tile_width  - 1) /
+                               priv->tile_width;
+  backend_level->n_rows      = (backend_level->height + priv->tile_height - 1) /
+                               priv->tile_height;
+  backend_level->offsets     = offsets;
+
+  g_return_if_fail (n_tiles == backend_level->n_tile_cols *
+                               backend_level->n_tile_rows);
+}
+
+/* makes all backends which map 'file' stop using it, so that it can be
+ * overwritten.  must be called before saving over a file, since
+ * truncating a mapped file makes accessing the mapping crash.
+ */
+void
+xcf_tile_backend_release_file (GFile *file)
+{
+  GList *list;
+  GList *iter;
+
+  g_return_if_fail (G_IS_FILE (file));
+
+  g_mutex_lock (&backends_mutex);
+
+  list = NULL;
+
+  /* only backends which are still alive can be referenced.  the last
+   * reference may be dropped below, so don't drop it under the lock,
+   * which finalize takes.
+   */
+  for (iter = backends; iter; iter = g_list_next (iter))
+    {
+      XcfTileBackend *backend = g_weak_ref_get (iter->data);
+
+      if (backend)
+        list = g_list_prepend (list, backend);
+    }
+
+  g_mutex_unlock (&backends_mutex);
+
+  for (iter = list; iter; iter = g_list_next (iter))
+    {
+      XcfTileBackend *backend = iter->data;
+
+      if (g_file_equal (backend->priv->file, file))
+        xcf_tile_backend_release (backend);
+    }
+
+  g_list_free_full (list, g_object_unref);
+}
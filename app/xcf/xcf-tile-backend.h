@@ -0,0 +1,82 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __XCF_TILE_BACKEND_H__
+#define __XCF_TILE_BACKEND_H__
+
+#include <gegl-buffer-backend.h>
+
+/***
+ * XcfTileBackend is a GeglTileBackend which decodes the tiles of a
+ * drawable from a memory-mapped XCF file when they are first accessed.
+ * Its tiles have the size of the drawable's buffer's tiles, not of the
+ * XCF tiles, so that copies of the buffer can share them.
+ * Modified tiles are handed to a regular swap-backed buffer, the file
+ * is never written to.
+ */
+
+G_BEGIN_DECLS
+
+#define XCF_TYPE_TILE_BACKEND            (xcf_tile_backend_get_type ())
+#define XCF_TILE_BACKEND(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), XCF_TYPE_TILE_BACKEND, XcfTileBackend))
+#define XCF_TILE_BACKEND_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass),  XCF_TYPE_TILE_BACKEND, XcfTileBackendClass))
+#define XCF_IS_TILE_BACKEND(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), XCF_TYPE_TILE_BACKEND))
+#define XCF_IS_TILE_BACKEND_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass),  XCF_TYPE_TILE_BACKEND))
+#define XCF_TILE_BACKEND_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj),  XCF_TYPE_TILE_BACKEND, XcfTileBackendClass))
+
+
+typedef struct _XcfTileBackend        XcfTileBackend;
+typedef struct _XcfTileBackendClass   XcfTileBackendClass;
+typedef struct _XcfTileBackendPrivate XcfTileBackendPrivate;
+
+struct _XcfTileBackend
+{
+  GeglTileBackend        parent_instance;
+
+  XcfTileBackendPrivate *priv;
+};
+
+struct _XcfTileBackendClass
+{
+  GeglTileBackendClass  parent_class;
+};
+
+
+GType             xcf_tile_backend_get_type  (void) G_GNUC_CONST;
+
+GeglTileBackend * xcf_tile_backend_new       (GFile              *file,
+                                              GMappedFile        *mapped,
+                                              XcfCompressionType  compression,
+                                              gint                file_version,
+                                              const Babl         *format,
+                                              gint                width,
+                                              gint                height,
+                                              gint                tile_width,
+                                              gint                tile_height);
+
+void              xcf_tile_backend_add_level (XcfTileBackend     *backend,
+                                              gint                level,
+                                              goffset            *offsets,
+                                              gint                n_tiles);
+
+void              xcf_tile_backend_release_file
+                                             (GFile              *file);
+
+
+G_END_DECLS
+
+#endif /* __XCF_TILE_BACKEND_H__ */
@@ -17,10 +17,15 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include <cairo.h>
 #include <gegl.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
 
+#include "core/core-types.h"
+
+#include "xcf-private.h"
 #include "xcf-utils.h"
 
 
@@ -51,3 +56,121 @@ xcf_data_is_zero (const void *data,
 
   return TRUE;
 }
+
+/* apply 'filter' to the 'n_pixels' pixels of 'bpp' bytes each in 'src',
+ * and store the result in 'dest'.  'src' and 'dest' may not overlap.
+ */
+void
+xcf_tile_filter (XcfTileFilter  filter,
+                 gint           bpp,
+                 const guint8  *src,
+                 guint8        *dest,
+                 gint           n_pixels)
+{
+  gint b;
+  gint p;
+
+  if (filter == XCF_TILE_FILTER_NONE)
+    {
+      memcpy (dest, src, bpp * n_pixels);
+
+      return;
+    }
+
+  for (b = 0; b < bpp; b++)
+    {
+      const guint8 *s    = src + b;
+      guint8       *d    = dest + b * n_pixels;
+      guint8        prev = 0;
+
+      for (p = 0; p < n_pixels; p++)
+        {
+          guint8 value = *s;
+
+          if (filter == XCF_TILE_FILTER_DELTA)
+            *d++ = value - prev;
+          else
+            *d++ = value;
+
+          prev  = value;
+          s    += bpp;
+        }
+    }
+}
+
+/* revert xcf_tile_filter().  'src' and 'dest' may not overlap.
+ */
+void
+xcf_tile_unfilter (XcfTileFilter  filter,
+                   gint           bpp,
+                   const guint8  *src,
+                   guint8        *dest,
+                   gint           n_pixels)
+{
+  gint b;
+  gint p;
+
+  if (filter == XCF_TILE_FILTER_NONE)
+    {
+      memcpy (dest, src, bpp * n_pixels);
+
+      return;
+    }
+
+  for (b = 0; b < bpp; b++)
+    {
+      const guint8 *s    = src + b * n_pixels;
+      guint8       *d    = dest + b;
+      guint8        prev = 0;
+
+      for (p = 0; p < n_pixels; p++)
+        {
+          guint8 value = *s++;
+
+          if (filter == XCF_TILE_FILTER_DELTA)
+            value += prev;
+
+          *d    = value;
+          prev  = value;
+          d    += bpp;
+        }
+    }
+}
+
+/* the size of mipmap level 'level' of a 'width' x 'height' drawable.
+ * unlike the dummy levels of older files, which were truncated, real
+ * levels are rounded up, so that they cover the whole drawable, like
+ * the corresponding GeglBuffer levels.
+ */
+void
+xcf_level_get_size (gint  width,
+                    gint  height,
+                    gint  level,
+                    gint *level_width,
+                    gint *level_height)
+{
+  *level_width  = (width  + (1 << level) - 1) >> level;
+  *level_height = (height + (1 << level) - 1) >> level;
+}
+
+gint
+xcf_level_get_n_tiles (gint level_width,
+                       gint level_height)
+{
+  return ((level_width  + XCF_TILE_WIDTH  - 1) / XCF_TILE_WIDTH) *
+         ((level_height + XCF_TILE_HEIGHT - 1) / XCF_TILE_HEIGHT);
+}
+
+void
+xcf_level_get_tile_rect (gint           level_width,
+                         gint           level_height,
+                         gint           tile_num,
+                         GeglRectangle *rect)
+{
+  gint n_tile_cols = (level_width + XCF_TILE_WIDTH - 1) / XCF_TILE_WIDTH;
+
+  rect->x      = (tile_num % n_tile_cols) * XCF_TILE_WIDTH;
+  rect->y      = (tile_num / n_tile_cols) * XCF_TILE_HEIGHT;
+  rect->width  = MIN (XCF_TILE_WIDTH,  level_width  - rect->x);
+  rect->height = MIN (XCF_TILE_HEIGHT, level_height - rect->y);
+}
@@ -19,8 +19,33 @@
 #define __XCF_UTILS_H__
 
 
-gboolean   xcf_data_is_zero (const void *data,
-                             gint        size);
+gboolean   xcf_data_is_zero     (const void    *data,
+                                 gint           size);
+
+void       xcf_tile_filter      (XcfTileFilter  filter,
+                                 gint           bpp,
+                                 const guint8  *src,
+                                 guint8        *dest,
+                                 gint           n_pixels);
+void       xcf_tile_unfilter    (XcfTileFilter  filter,
+                                 gint           bpp,
+                                 const guint8  *src,
+                                 guint8        *dest,
+                                 gint           n_pixels);
+
+void       xcf_level_get_size   (gint           width,
+                                 gint           height,
+                                 gint           level,
+                                 gint          *level_width,
+                                 gint          *level_height);
+gint       xcf_level_get_n_tiles
+                                (gint           level_width,
+                                 gint           level_height);
+void       xcf_level_get_tile_rect
+                                (gint           level_width,
+                                 gint           level_height,
+                                 gint           tile_num,
+                                 GeglRectangle *rect);
 
 
 #endif  /* __XCF_UTILS_H__ */
@@ -29,6 +29,8 @@
 
 #include "core/core-types.h"
 
+#include "config/gimpcoreconfig.h"
+
 #include "core/gimp.h"
 #include "core/gimpimage.h"
 #include "core/gimpparamspecs.h"
@@ -42,6 +44,7 @@
 #include "xcf-load.h"
 #include "xcf-read.h"
 #include "xcf-save.h"
+#include "xcf-tile-backend.h"
 
 #include "gimp-intl.h"
 
@@ -279,6 +282,22 @@ xcf_load_stream (Gimp          *gimp,
   info.file             = input_file;
   info.compression      = COMPRESS_NONE;
 
+  /* when loading lazily, the tiles are decoded from a mapping of the
+   * file when they are first accessed.  fall back to loading
+   * everything right away if the file can't be mapped.
+   */
+  if (gimp->config->xcf_lazy_loading && input_file)
+    {
+      gchar *path = g_file_get_path (input_file);
+
+      if (path)
+        {
+          info.mapped = g_mapped_file_new (path, FALSE, NULL);
+
+          g_free (path);
+        }
+    }
+
   if (progress)
     gimp_progress_start (progress, FALSE, _("Opening '%s'"), filename);
 
@@ -314,6 +333,16 @@ xcf_load_stream (Gimp          *gimp,
         {
           image = (*(xcf_loaders[info.file_version])) (gimp, &info, error);
 
+          if (! image)
+            success = FALSE;
+
+          g_input_stream_close (info.input, NULL, NULL);
+        }
+      else if (info.file_version >= XCF_EXT_VERSION_MIN &&
+               info.file_version <= XCF_EXT_VERSION_MAX)
+        {
+          image = xcf_load_image (gimp, &info, error);
+
           if (! image)
             success = FALSE;
 
@@ -328,6 +357,8 @@ xcf_load_stream (Gimp          *gimp,
         }
     }
 
+  g_clear_pointer (&info.mapped, g_mapped_file_unref);
+
   if (progress)
     gimp_progress_end (progress);
 
@@ -367,7 +398,9 @@ xcf_save_stream (Gimp           *gimp,
   info.progress         = progress;
   info.file             = output_file;
 
-  if (gimp_image_get_xcf_compression (image))
+  if (gimp->config->xcf_fast_compression)
+    info.compression = COMPRESS_TILE_CODEC;
+  else if (gimp_image_get_xcf_compression (image))
     info.compression = COMPRESS_ZLIB;
   else
     info.compression = COMPRESS_RLE;
@@ -488,6 +521,9 @@ xcf_save_invoker (GimpProcedure         *procedure,
   uri   = g_value_get_string (gimp_value_array_index (args, 3));
   file  = g_file_new_for_uri (uri);
 
+  /* the file may be replaced in place, stop using any mapping of it */
+  xcf_tile_backend_release_file (file);
+
   output = G_OUTPUT_STREAM (g_file_replace (file,
                                             NULL, FALSE, G_FILE_CREATE_NONE,
                                             NULL, &my_error));
@@ -134,8 +134,6 @@
  **/
 
 
-#define TILE_MAP_SIZE (_tile_width * _tile_height * 32)
-
 #define ERRMSG_SHM_FAILED "Could not attach to gimp shared memory segment"
 
 /* Maybe this should go in a public header if we add other things to it */
@@ -153,8 +151,9 @@ typedef enum
 
 #define WRITE_BUFFER_SIZE  1024
 
-void gimp_read_expect_msg   (GimpWireMessage *msg,
-                             gint             type);
+void  gimp_read_expect_msg   (GimpWireMessage *msg,
+                              gint             type);
+gsize _gimp_shm_size         (void);
 
 
 static void       gimp_close                   (void);
@@ -213,6 +212,7 @@ static gint           _tile_width        = -1;
 static gint           _tile_height       = -1;
 static gint           _shm_ID            = -1;
 static guchar        *_shm_addr          = NULL;
+static gsize          _shm_size          = 0;
 static gboolean       _show_tool_tips    = TRUE;
 static gboolean       _show_help_button  = TRUE;
 static gboolean       _export_profile    = FALSE;
@@ -1178,6 +1178,11 @@ gimp_run_procedure2 (const gchar     *name,
   proc_run.nparams = n_params;
   proc_run.params  = (GPParam *) params;
 
+  /*  the procedure might access drawables, so let the core see our
+   *  pending tile writes, and don't trust our read-ahead afterwards
+   */
+  _gimp_tile_sync ();
+
   gp_lock ();
   if (! gp_proc_run_write (_writechannel, &proc_run, NULL))
     gimp_quit ();
@@ -1360,6 +1365,12 @@ gimp_shm_addr (void)
   return _shm_addr;
 }
 
+gsize
+_gimp_shm_size (void)
+{
+  return _shm_size;
+}
+
 /**
  * gimp_gamma:
  *
@@ -1914,7 +1925,7 @@ gimp_close (void)
 #elif defined(USE_POSIX_SHM)
 
   if ((_shm_ID != -1) && (_shm_addr != MAP_FAILED))
-    munmap (_shm_addr, TILE_MAP_SIZE);
+    munmap (_shm_addr, _shm_size);
 
 #endif
 
@@ -2260,6 +2271,8 @@ gimp_loop (void)
         case GP_TILE_REQ:
         case GP_TILE_ACK:
         case GP_TILE_DATA:
+        case GP_TILE_BATCH_REQ:
+        case GP_TILE_BATCH_DATA:
           g_warning ("unexpected tile message received (should not happen)");
           break;
 
@@ -2322,6 +2335,7 @@ gimp_config (GPConfig *config)
   _tile_width       = config->tile_width;
   _tile_height      = config->tile_height;
   _shm_ID           = config->shm_ID;
+  _shm_size         = config->shm_size;
   _check_size       = config->check_size;
   _check_type       = config->check_type;
   _show_tool_tips   = config->show_tooltips    ? TRUE : FALSE;
@@ -2388,7 +2402,7 @@ gimp_config (GPConfig *config)
           /* Map the shared memory into our address space for use */
           _shm_addr = (guchar *) MapViewOfFile (shm_handle,
                                                 FILE_MAP_ALL_ACCESS,
-                                                0, 0, TILE_MAP_SIZE);
+                                                0, 0, _shm_size);
 
           /* Verify that we mapped our view */
           if (!_shm_addr)
@@ -2419,7 +2433,7 @@ gimp_config (GPConfig *config)
       if (shm_fd != -1)
         {
           /* Map the shared memory into our address space for use */
-          _shm_addr = (guchar *) mmap (NULL, TILE_MAP_SIZE,
+          _shm_addr = (guchar *) mmap (NULL, _shm_size,
                                        PROT_READ | PROT_WRITE, MAP_SHARED,
                                        shm_fd, 0);
 
@@ -2456,6 +2470,8 @@ gimp_proc_run (GPProcRun *proc_run)
                                  (GimpParam *) proc_run->params,
                                  &n_return_vals, &return_vals);
 
+      _gimp_tile_sync ();
+
       proc_return.name    = proc_run->name;
       proc_return.nparams = n_return_vals;
       proc_return.params  = (GPParam *) return_vals;
@@ -2484,11 +2500,15 @@ gimp_temp_proc_run (GPProcRun *proc_run)
         }
 #endif
 
+      _gimp_tile_sync ();
+
       (* run_proc) (proc_run->name,
                     proc_run->nparams,
                     (GimpParam *) proc_run->params,
                     &n_return_vals, &return_vals);
 
+      _gimp_tile_sync ();
+
       proc_return.name    = proc_run->name;
       proc_return.nparams = n_return_vals;
       proc_return.params  = (GPParam *) return_vals;
@@ -2512,6 +2532,8 @@ gimp_process_message (GimpWireMessage *msg)
     case GP_TILE_REQ:
     case GP_TILE_ACK:
     case GP_TILE_DATA:
+    case GP_TILE_BATCH_REQ:
+    case GP_TILE_BATCH_DATA:
       g_warning ("unexpected tile message received (should not happen)");
       break;
     case GP_PROC_RUN:
@@ -48,14 +48,39 @@
  */
 #define FREE_QUANTUM 0.1
 
+/*  The maximal number of tiles read ahead in a single batch.  The
+ *  read-ahead window starts at one tile and doubles as long as tiles
+ *  are requested in order.
+ */
+#define READ_AHEAD_MAX_TILES 256
+
+
+typedef struct _GimpTileWriteBack GimpTileWriteBack;
+
+struct _GimpTileWriteBack
+{
+  guint32  tile_num;
+  guchar  *data;
+  gsize    size;
+};
+
 
-void         gimp_read_expect_msg   (GimpWireMessage *msg,
-                                     gint             type);
+void         gimp_read_expect_msg          (GimpWireMessage *msg,
+                                            gint             type);
+gsize        _gimp_shm_size                (void);
 
-static void  gimp_tile_get          (GimpTile        *tile);
-static void  gimp_tile_put          (GimpTile        *tile);
-static void  gimp_tile_cache_insert (GimpTile        *tile);
-static void  gimp_tile_cache_flush  (GimpTile        *tile);
+static void     gimp_tile_get              (GimpTile        *tile);
+static void     gimp_tile_put              (GimpTile        *tile,
+                                            gboolean         steal_data);
+static void     gimp_tile_cache_insert     (GimpTile        *tile);
+static void     gimp_tile_cache_flush      (GimpTile        *tile);
+
+static gsize    gimp_tile_batch_size       (void);
+static gboolean gimp_tile_read_ahead_take  (GimpTile        *tile);
+static void     gimp_tile_read_ahead_drop  (GimpTile        *tile);
+static void     gimp_tile_read_ahead_clear (void);
+static void     gimp_tile_read_ahead_fetch (GimpTile        *tile);
+static void     gimp_tile_write_back_flush (void);
 
 
 /*  private variables  */
@@ -67,6 +92,27 @@ static gulong       max_tile_size   = 0;
 static gulong       cur_cache_size  = 0;
 static gulong       max_cache_size  = 0;
 
+/*  tiles fetched from the core in one batch, which were not yet
+ *  referenced, and dirty tiles which were not yet sent back.  both
+ *  refer to a single drawable at a time.  batching makes fewer round
+ *  trips to the core, but each tile's pixels are still copied once to
+ *  or from the shared memory segment.
+ */
+static GMutex       tile_batch_mutex;
+
+static gint32       read_ahead_drawable_ID  = -1;
+static gboolean     read_ahead_shadow       = FALSE;
+static guint        read_ahead_first        = 0;
+static gint         read_ahead_n_tiles      = 0;
+static gint         read_ahead_window       = 1;
+static guchar      *read_ahead_data[READ_AHEAD_MAX_TILES];
+
+static gint32       write_back_drawable_ID  = -1;
+static gboolean     write_back_shadow       = FALSE;
+static guint        write_back_bpp          = 0;
+static gsize        write_back_length       = 0;
+static GArray      *write_back_tiles        = NULL;
+
 
 /*  public functions  */
 
@@ -133,7 +179,15 @@ gimp_tile_unref (GimpTile *tile,
 
   if (tile->ref_count == 0)
     {
-      gimp_tile_flush (tile);
+      /*  nobody uses the data any longer, so hand it over to the
+       *  write-back queue instead of copying it
+       */
+      if (tile->data && tile->dirty)
+        {
+          gimp_tile_put (tile, TRUE);
+          tile->dirty = FALSE;
+        }
+
       g_free (tile->data);
       tile->data = NULL;
     }
@@ -146,7 +200,7 @@ gimp_tile_flush (GimpTile *tile)
 
   if (tile->data && tile->dirty)
     {
-      gimp_tile_put (tile);
+      gimp_tile_put (tile, FALSE);
       tile->dirty = FALSE;
     }
 }
@@ -204,109 +258,116 @@ _gimp_tile_cache_flush_drawable (GimpDrawable *drawable)
       if (tile->drawable == drawable)
         gimp_tile_cache_flush (tile);
     }
-}
 
+  g_mutex_lock (&tile_batch_mutex);
 
-/*  private functions  */
+  gimp_tile_write_back_flush ();
 
-static void
-gimp_tile_get (GimpTile *tile)
+  g_mutex_unlock (&tile_batch_mutex);
+}
+
+/*  Sends all pending tile writes to the core, and forgets about the
+ *  tiles read ahead.  Called before anything that lets the core look
+ *  at, or change, drawable pixels.
+ */
+void
+_gimp_tile_sync (void)
 {
-  extern GIOChannel *_writechannel;
+  g_mutex_lock (&tile_batch_mutex);
 
-  GPTileReq        tile_req;
-  GPTileData      *tile_data;
-  GimpWireMessage  msg;
+  gimp_tile_write_back_flush ();
+  gimp_tile_read_ahead_clear ();
 
-  tile_req.drawable_ID = tile->drawable->drawable_id;
-  tile_req.tile_num    = tile->tile_num;
-  tile_req.shadow      = tile->shadow;
+  g_mutex_unlock (&tile_batch_mutex);
+}
 
-  gp_lock ();
-  if (! gp_tile_req_write (_writechannel, &tile_req, NULL))
-    gimp_quit ();
 
-  gimp_read_expect_msg (&msg, GP_TILE_DATA);
+/*  private functions  */
 
-  tile_data = msg.data;
-  if (tile_data->drawable_ID != tile->drawable->drawable_id ||
-      tile_data->tile_num    != tile->tile_num              ||
-      tile_data->shadow      != tile->shadow                ||
-      tile_data->width       != tile->ewidth                ||
-      tile_data->height      != tile->eheight               ||
-      tile_data->bpp         != tile->bpp)
-    {
-      g_message ("received tile info did not match computed tile info");
-      gimp_quit ();
-    }
+static void
+gimp_tile_get (GimpTile *tile)
+{
+  g_mutex_lock (&tile_batch_mutex);
 
-  if (tile_data->use_shm)
-    {
-      tile->data = g_memdup (gimp_shm_addr (),
-                             tile->ewidth * tile->eheight * tile->bpp);
-    }
-  else
+  if (! gimp_tile_read_ahead_take (tile))
     {
-      tile->data = tile_data->data;
-      tile_data->data = NULL;
-    }
+      /*  the core must see our own changes before we read them back  */
+      gimp_tile_write_back_flush ();
 
-  if (! gp_tile_ack_write (_writechannel, NULL))
-    gimp_quit ();
-  gp_unlock ();
+      gimp_tile_read_ahead_fetch (tile);
 
-  gimp_wire_destroy (&msg);
+      if (! gimp_tile_read_ahead_take (tile))
+        {
+          g_message ("received tile info did not match computed tile info");
+          gimp_quit ();
+        }
+    }
+
+  g_mutex_unlock (&tile_batch_mutex);
 }
 
 static void
-gimp_tile_put (GimpTile *tile)
+gimp_tile_put (GimpTile *tile,
+               gboolean  steal_data)
 {
-  extern GIOChannel *_writechannel;
+  GimpTileWriteBack  write_back;
+  gint32             drawable_ID = tile->drawable->drawable_id;
+  gint               i;
 
-  GPTileReq        tile_req;
-  GPTileData       tile_data;
-  GPTileData      *tile_info;
-  GimpWireMessage  msg;
+  write_back.tile_num = tile->tile_num;
+  write_back.size     = tile->ewidth * tile->eheight * tile->bpp;
 
-  tile_req.drawable_ID = -1;
-  tile_req.tile_num    = 0;
-  tile_req.shadow      = 0;
-
-  gp_lock ();
-  if (! gp_tile_req_write (_writechannel, &tile_req, NULL))
-    gimp_quit ();
+  g_mutex_lock (&tile_batch_mutex);
 
-  gimp_read_expect_msg (&msg, GP_TILE_DATA);
+  if (! write_back_tiles)
+    write_back_tiles = g_array_new (FALSE, FALSE, sizeof (GimpTileWriteBack));
 
-  tile_info = msg.data;
+  /*  a batch only holds tiles of a single drawable  */
+  if (drawable_ID       != write_back_drawable_ID ||
+      tile->shadow      != write_back_shadow      ||
+      write_back_length +  write_back.size > gimp_tile_batch_size ())
+    {
+      gimp_tile_write_back_flush ();
+    }
 
-  tile_data.drawable_ID = tile->drawable->drawable_id;
-  tile_data.tile_num    = tile->tile_num;
-  tile_data.shadow      = tile->shadow;
-  tile_data.bpp         = tile->bpp;
-  tile_data.width       = tile->ewidth;
-  tile_data.height      = tile->eheight;
-  tile_data.use_shm     = tile_info->use_shm;
-  tile_data.data        = NULL;
+  /*  our read-ahead copy of the tile is outdated now  */
+  gimp_tile_read_ahead_drop (tile);
 
-  if (tile_info->use_shm)
-    memcpy (gimp_shm_addr (),
-            tile->data,
-            tile->ewidth * tile->eheight * tile->bpp);
+  if (steal_data)
+    {
+      write_back.data = tile->data;
+      tile->data      = NULL;
+    }
   else
-    tile_data.data = tile->data;
+    {
+      write_back.data = g_memdup (tile->data, write_back.size);
+    }
 
-  if (! gp_tile_data_write (_writechannel, &tile_data, NULL))
-    gimp_quit ();
+  write_back_drawable_ID = drawable_ID;
+  write_back_shadow      = tile->shadow;
+  write_back_bpp         = tile->bpp;
 
-  if (! tile_info->use_shm)
-    tile_data.data = NULL;
+  /*  replace the data if the tile is already queued  */
+  for (i = 0; i < write_back_tiles->len; i++)
+    {
+      GimpTileWriteBack *queued = &g_array_index (write_back_tiles,
+                                                  GimpTileWriteBack, i);
 
-  gimp_wire_destroy (&msg);
+      if (queued->tile_num == write_back.tile_num)
+        {
+          g_free (queued->data);
+          queued->data = write_back.data;
 
-  gimp_read_expect_msg (&msg, GP_TILE_ACK);
-  gp_unlock ();
-  gimp_wire_destroy (&msg);
+          g_mutex_unlock (&tile_batch_mutex);
+
+          return;
+        }
+    }
+
+  g_array_append_val (write_back_tiles, write_back);
+  write_back_length += write_back.size;
+
+  g_mutex_unlock (&tile_batch_mutex);
 }
 
 /* This function is nearly identical to the function 'tile_cache_insert'
@@ -434,3 +495,255 @@ gimp_tile_cache_flush (GimpTile *tile)
       gimp_tile_unref (tile, FALSE);
     }
 }
+
+/*  The maximal amount of pixel data in a tile batch  */
+static gsize
+gimp_tile_batch_size (void)
+{
+  if (gimp_shm_addr ())
+    return _gimp_shm_size ();
+  else
+    return GP_TILE_BATCH_PIPE_SIZE;
+}
+
+/*  The functions below must be called with tile_batch_mutex held  */
+
+static gboolean
+gimp_tile_read_ahead_take (GimpTile *tile)
+{
+  gint i;
+
+  if (tile->drawable->drawable_id != read_ahead_drawable_ID ||
+      tile->shadow                != read_ahead_shadow      ||
+      tile->tile_num              <  read_ahead_first       ||
+      tile->tile_num              >= read_ahead_first + read_ahead_n_tiles)
+    {
+      return FALSE;
+    }
+
+  i = tile->tile_num - read_ahead_first;
+
+  if (! read_ahead_data[i])
+    return FALSE;
+
+  tile->data         = read_ahead_data[i];
+  read_ahead_data[i] = NULL;
+
+  return TRUE;
+}
+
+static void
+gimp_tile_read_ahead_drop (GimpTile *tile)
+{
+  if (tile->drawable->drawable_id == read_ahead_drawable_ID &&
+      tile->shadow                == read_ahead_shadow      &&
+      tile->tile_num              >= read_ahead_first       &&
+      tile->tile_num              <  read_ahead_first + read_ahead_n_tiles)
+    {
+      gint i = tile->tile_num - read_ahead_first;
+
+      g_clear_pointer (&read_ahead_data[i], g_free);
+    }
+}
+
+static void
+gimp_tile_read_ahead_clear (void)
+{
+  gint i;
+
+  for (i = 0; i < read_ahead_n_tiles; i++)
+    g_clear_pointer (&read_ahead_data[i], g_free);
+
+  read_ahead_n_tiles = 0;
+}
+
+static void
+gimp_tile_read_ahead_fetch (GimpTile *tile)
+{
+  extern GIOChannel *_writechannel;
+
+  GimpDrawable     *drawable = tile->drawable;
+  GimpTile         *tiles;
+  GPTileBatchReq    batch_req;
+  GPTileBatchData  *batch_data;
+  GimpWireMessage   msg;
+  guint32           tile_nums[READ_AHEAD_MAX_TILES];
+  const guchar     *data;
+  gsize             offset = 0;
+  gint              n_tiles;
+  gint              max_tiles;
+  gint              i;
+
+  tiles = tile->shadow ? drawable->shadow_tiles : drawable->tiles;
+
+  /*  grow the window while the tiles are read in order, as they are
+   *  when iterating over a region, and start over otherwise
+   */
+  if (drawable->drawable_id == read_ahead_drawable_ID &&
+      tile->shadow          == read_ahead_shadow      &&
+      tile->tile_num        == read_ahead_first + read_ahead_n_tiles)
+    {
+      read_ahead_window = MIN (read_ahead_window * 2, READ_AHEAD_MAX_TILES);
+    }
+  else
+    {
+      read_ahead_window = 1;
+    }
+
+  gimp_tile_read_ahead_clear ();
+
+  max_tiles = gimp_tile_batch_size () / (tile->ewidth * tile->eheight *
+                                         tile->bpp);
+  max_tiles = CLAMP (max_tiles, 1, read_ahead_window);
+  max_tiles = MIN (max_tiles,
+                   drawable->ntile_rows * drawable->ntile_cols -
+                   tile->tile_num);
+
+  /*  stop at tiles we already have  */
+  tile_nums[0] = tile->tile_num;
+
+  for (n_tiles = 1; n_tiles < max_tiles; n_tiles++)
+    {
+      if (tiles[tile->tile_num + n_tiles].data)
+        break;
+
+      tile_nums[n_tiles] = tile->tile_num + n_tiles;
+    }
+
+  batch_req.drawable_ID = drawable->drawable_id;
+  batch_req.shadow      = tile->shadow;
+  batch_req.n_tiles     = n_tiles;
+  batch_req.tile_nums   = tile_nums;
+
+  gp_lock ();
+  if (! gp_tile_batch_req_write (_writechannel, &batch_req, NULL))
+    gimp_quit ();
+
+  gimp_read_expect_msg (&msg, GP_TILE_BATCH_DATA);
+
+  batch_data = msg.data;
+  if (batch_data->drawable_ID != drawable->drawable_id ||
+      batch_data->shadow      != tile->shadow          ||
+      batch_data->bpp         != tile->bpp             ||
+      batch_data->n_tiles     <  1                     ||
+      batch_data->n_tiles     >  n_tiles)
+    {
+      g_message ("received tile info did not match computed tile info");
+      gimp_quit ();
+    }
+
+  if (batch_data->use_shm)
+    data = gimp_shm_addr ();
+  else
+    data = batch_data->data;
+
+  for (i = 0; i < batch_data->n_tiles; i++)
+    {
+      GimpTile *batch_tile = &tiles[tile_nums[i]];
+      gsize     size;
+
+      size = batch_tile->ewidth * batch_tile->eheight * batch_tile->bpp;
+
+      if (batch_data->tile_nums[i] != tile_nums[i] ||
+          offset + size > batch_data->length)
+        {
+          g_message ("received tile info did not match computed tile info");
+          gimp_quit ();
+        }
+
+      read_ahead_data[i] = g_memdup (data + offset, size);
+
+      offset += size;
+    }
+
+  read_ahead_drawable_ID = drawable->drawable_id;
+  read_ahead_shadow      = tile->shadow;
+  read_ahead_first       = tile->tile_num;
+  read_ahead_n_tiles     = batch_data->n_tiles;
+
+  if (! gp_tile_ack_write (_writechannel, NULL))
+    gimp_quit ();
+  gp_unlock ();
+
+  gimp_wire_destroy (&msg);
+}
+
+static void
+gimp_tile_write_back_flush (void)
+{
+  extern GIOChannel *_writechannel;
+
+  GPTileBatchReq    batch_req;
+  GPTileBatchData   batch_data;
+  GPTileBatchData  *batch_info;
+  GimpWireMessage   msg;
+  guint32          *tile_nums;
+  guchar           *data;
+  gint              i;
+
+  if (! write_back_tiles || write_back_tiles->len == 0)
+    return;
+
+  tile_nums = g_new (guint32, write_back_tiles->len);
+
+  batch_req.drawable_ID = -1;
+  batch_req.shadow      = 0;
+  batch_req.n_tiles     = 0;
+  batch_req.tile_nums   = NULL;
+
+  gp_lock ();
+  if (! gp_tile_batch_req_write (_writechannel, &batch_req, NULL))
+    gimp_quit ();
+
+  gimp_read_expect_msg (&msg, GP_TILE_BATCH_DATA);
+
+  batch_info = msg.data;
+
+  batch_data.drawable_ID = write_back_drawable_ID;
+  batch_data.shadow      = write_back_shadow;
+  batch_data.bpp         = write_back_bpp;
+  batch_data.n_tiles     = write_back_tiles->len;
+  batch_data.tile_nums   = tile_nums;
+  batch_data.use_shm     = batch_info->use_shm;
+  batch_data.length      = write_back_length;
+  batch_data.data        = NULL;
+
+  if (batch_info->use_shm)
+    {
+      data = gimp_shm_addr ();
+    }
+  else
+    {
+      batch_data.data = g_malloc (write_back_length);
+
+      data = batch_data.data;
+    }
+
+  for (i = 0; i < write_back_tiles->len; i++)
+    {
+      GimpTileWriteBack *write_back = &g_array_index (write_back_tiles,
+                                                      GimpTileWriteBack, i);
+
+      tile_nums[i] = write_back->tile_num;
+
+      memcpy (data, write_back->data, write_back->size);
+      data += write_back->size;
+
+      g_free (write_back->data);
+    }
+
+  if (! gp_tile_batch_data_write (_writechannel, &batch_data, NULL))
+    gimp_quit ();
+
+  g_free (batch_data.data);
+  g_free (tile_nums);
+
+  gimp_wire_destroy (&msg);
+
+  gimp_read_expect_msg (&msg, GP_TILE_ACK);
+  gp_unlock ();
+  gimp_wire_destroy (&msg);
+
+  g_array_set_size (write_back_tiles, 0);
+  write_back_length = 0;
+}
@@ -67,6 +67,8 @@ G_GNUC_INTERNAL void _gimp_tile_ref_nocache          (GimpTile     *tile,
 
 G_GNUC_INTERNAL void _gimp_tile_cache_flush_drawable (GimpDrawable *drawable);
 
+G_GNUC_INTERNAL void _gimp_tile_sync                 (void);
+
 
 G_END_DECLS
 
@@ -126,11 +126,30 @@ enum
 {
   ARCH_X86_INTEL_FEATURE_PNI      = 1 << 0,
   ARCH_X86_INTEL_FEATURE_SSSE3    = 1 << 9,
+  ARCH_X86_INTEL_FEATURE_FMA      = 1 << 12,
   ARCH_X86_INTEL_FEATURE_SSE4_1   = 1 << 19,
   ARCH_X86_INTEL_FEATURE_SSE4_2   = 1 << 20,
+  ARCH_X86_INTEL_FEATURE_OSXSAVE  = 1 << 27,
   ARCH_X86_INTEL_FEATURE_AVX      = 1 << 28
 };
 
+/* extended features, cpuid leaf 7, sub-leaf 0, ebx */
+enum
+{
+  ARCH_X86_INTEL_FEATURE_AVX2     = 1 << 5,
+  ARCH_X86_INTEL_FEATURE_AVX512F  = 1 << 16
+};
+
+/* state components enabled by the OS in XCR0 */
+enum
+{
+  ARCH_X86_XCR0_SSE               = 1 << 1,
+  ARCH_X86_XCR0_AVX               = 1 << 2,
+  ARCH_X86_XCR0_OPMASK            = 1 << 5,
+  ARCH_X86_XCR0_ZMM_HI256         = 1 << 6,
+  ARCH_X86_XCR0_HI16_ZMM          = 1 << 7
+};
+
 #if !defined(ARCH_X86_64) && (defined(PIC) || defined(__PIC__))
 #define cpuid(op,eax,ebx,ecx,edx)  \
   __asm__ ("movl %%ebx, %%esi\n\t" \
@@ -151,6 +170,33 @@ enum
            : "0" (op))
 #endif
 
+#if !defined(ARCH_X86_64) && (defined(PIC) || defined(__PIC__))
+#define cpuid_count(op,count,eax,ebx,ecx,edx) \
+  __asm__ ("movl %%ebx, %%esi\n\t"           \
+           "cpuid\n\t"                       \
+           "xchgl %%ebx,%%esi"               \
+           : "=a" (eax),                     \
+             "=S" (ebx),                     \
+             "=c" (ecx),                     \
+             "=d" (edx)                      \
+           : "0" (op), "2" (count))
+#else
+#define cpuid_count(op,count,eax,ebx,ecx,edx) \
+  __asm__ ("cpuid"                           \
+           : "=a" (eax),                     \
+             "=b" (ebx),                     \
+             "=c" (ecx),                     \
+             "=d" (edx)                      \
+           : "0" (op), "2" (count))
+#endif
+
+/* xgetbv is emitted as raw bytes so that old assemblers accept it */
+#define xgetbv(index,eax,edx)                \
+  __asm__ (".byte 0x0f, 0x01, 0xd0"          \
+           : "=a" (eax),                     \
+             "=d" (edx)                      \
+           : "c" (index))
+
 
 static X86Vendor
 arch_get_vendor (void)
@@ -264,8 +310,44 @@ arch_accel_intel (void)
     if (ecx & ARCH_X86_INTEL_FEATURE_SSE4_2)
       caps |= GIMP_CPU_ACCEL_X86_SSE4_2;
 
-    if (ecx & ARCH_X86_INTEL_FEATURE_AVX)
-      caps |= GIMP_CPU_ACCEL_X86_AVX;
+    /*  AVX and its successors are only usable when the OS saves the
+     *  extended register state on context switches
+     */
+    if ((ecx & ARCH_X86_INTEL_FEATURE_OSXSAVE) &&
+        (ecx & ARCH_X86_INTEL_FEATURE_AVX))
+      {
+        guint32 xcr0_lo, xcr0_hi;
+        guint32 max_leaf;
+
+        xgetbv (0, xcr0_lo, xcr0_hi);
+
+        if ((xcr0_lo & (ARCH_X86_XCR0_SSE | ARCH_X86_XCR0_AVX)) ==
+            (ARCH_X86_XCR0_SSE | ARCH_X86_XCR0_AVX))
+          {
+            caps |= GIMP_CPU_ACCEL_X86_AVX;
+
+            if (ecx & ARCH_X86_INTEL_FEATURE_FMA)
+              caps |= GIMP_CPU_ACCEL_X86_FMA;
+
+            cpuid (0, max_leaf, ebx, ecx, edx);
+
+            if (max_leaf >= 7)
+              {
+                const guint32 zmm_state = (ARCH_X86_XCR0_OPMASK    |
+                                           ARCH_X86_XCR0_ZMM_HI256 |
+                                           ARCH_X86_XCR0_HI16_ZMM);
+
+                cpuid_count (7, 0, eax, ebx, ecx, edx);
+
+                if (ebx & ARCH_X86_INTEL_FEATURE_AVX2)
+                  caps |= GIMP_CPU_ACCEL_X86_AVX2;
+
+                if ((ebx & ARCH_X86_INTEL_FEATURE_AVX512F) &&
+                    (xcr0_lo & zmm_state) == zmm_state)
+                  caps |= GIMP_CPU_ACCEL_X86_AVX512F;
+              }
+          }
+      }
 #endif /* USE_SSE */
   }
 #endif /* USE_MMX */
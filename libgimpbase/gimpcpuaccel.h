@@ -39,6 +39,9 @@ G_BEGIN_DECLS
  * @GIMP_CPU_ACCEL_X86_SSE4_1:  SSE4_1
  * @GIMP_CPU_ACCEL_X86_SSE4_2:  SSE4_2
  * @GIMP_CPU_ACCEL_X86_AVX:     AVX
+ * @GIMP_CPU_ACCEL_X86_AVX2:    AVX2
+ * @GIMP_CPU_ACCEL_X86_FMA:     FMA
+ * @GIMP_CPU_ACCEL_X86_AVX512F: AVX512F
  * @GIMP_CPU_ACCEL_PPC_ALTIVEC: Altivec
  *
  * Types of detectable CPU accelerations
@@ -58,6 +61,9 @@ typedef enum
   GIMP_CPU_ACCEL_X86_SSE4_1  = 0x00800000,
   GIMP_CPU_ACCEL_X86_SSE4_2  = 0x00400000,
   GIMP_CPU_ACCEL_X86_AVX     = 0x00200000,
+  GIMP_CPU_ACCEL_X86_AVX2    = 0x00100000,
+  GIMP_CPU_ACCEL_X86_FMA     = 0x00080000,
+  GIMP_CPU_ACCEL_X86_AVX512F = 0x00040000,
 
   /* powerpc accelerations */
   GIMP_CPU_ACCEL_PPC_ALTIVEC = 0x04000000
@@ -141,6 +141,22 @@ static void _gp_has_init_write           (GIOChannel       *channel,
                                           gpointer          user_data);
 static void _gp_has_init_destroy         (GimpWireMessage  *msg);
 
+static void _gp_tile_batch_req_read      (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_tile_batch_req_write     (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_tile_batch_req_destroy   (GimpWireMessage  *msg);
+
+static void _gp_tile_batch_data_read     (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_tile_batch_data_write    (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_tile_batch_data_destroy  (GimpWireMessage  *msg);
+
 
 
 void
@@ -198,6 +214,14 @@ gp_init (void)
                       _gp_has_init_read,
                       _gp_has_init_write,
                       _gp_has_init_destroy);
+  gimp_wire_register (GP_TILE_BATCH_REQ,
+                      _gp_tile_batch_req_read,
+                      _gp_tile_batch_req_write,
+                      _gp_tile_batch_req_destroy);
+  gimp_wire_register (GP_TILE_BATCH_DATA,
+                      _gp_tile_batch_data_read,
+                      _gp_tile_batch_data_write,
+                      _gp_tile_batch_data_destroy);
 }
 
 gboolean
@@ -443,6 +467,44 @@ gp_has_init_write (GIOChannel *channel,
   return TRUE;
 }
 
+gboolean
+gp_tile_batch_req_write (GIOChannel     *channel,
+                         GPTileBatchReq *tile_batch_req,
+                         gpointer        user_data)
+{
+  GimpWireMessage msg;
+
+  msg.type = GP_TILE_BATCH_REQ;
+  msg.data = tile_batch_req;
+
+  if (! gimp_wire_write_msg (channel, &msg, user_data))
+    return FALSE;
+
+  if (! gimp_wire_flush (channel, user_data))
+    return FALSE;
+
+  return TRUE;
+}
+
+gboolean
+gp_tile_batch_data_write (GIOChannel      *channel,
+                          GPTileBatchData *tile_batch_data,
+                          gpointer         user_data)
+{
+  GimpWireMessage msg;
+
+  msg.type = GP_TILE_BATCH_DATA;
+  msg.data = tile_batch_data;
+
+  if (! gimp_wire_write_msg (channel, &msg, user_data))
+    return FALSE;
+
+  if (! gimp_wire_flush (channel, user_data))
+    return FALSE;
+
+  return TRUE;
+}
+
 /*  quit  */
 
 static void
@@ -567,6 +629,13 @@ _gp_config_read (GIOChannel      *channel,
                                user_data))
     goto cleanup;
 
+  if (config->version < 0x001A)
+    goto end;
+
+  if (! _gimp_wire_read_int64 (channel,
+                               &config->shm_size, 1, user_data))
+    goto cleanup;
+
  end:
   msg->data = config;
   return;
@@ -686,6 +755,13 @@ _gp_config_write (GIOChannel      *channel,
                                 (const guint32 *) &config->num_processors, 1,
                                 user_data))
     return;
+
+  if (config->version < 0x001A)
+    return;
+
+  if (! _gimp_wire_write_int64 (channel,
+                                &config->shm_size, 1, user_data))
+    return;
 }
 
 static void
@@ -1929,3 +2005,199 @@ static void
 _gp_has_init_destroy (GimpWireMessage *msg)
 {
 }
+
+/*  tile_batch_req  */
+
+static void
+_gp_tile_batch_req_read (GIOChannel      *channel,
+                         GimpWireMessage *msg,
+                         gpointer         user_data)
+{
+  GPTileBatchReq *tile_batch_req = g_slice_new0 (GPTileBatchReq);
+
+  if (! _gimp_wire_read_int32 (channel,
+                               (guint32 *) &tile_batch_req->drawable_ID, 1,
+                               user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &tile_batch_req->shadow, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &tile_batch_req->n_tiles, 1, user_data))
+    goto cleanup;
+
+  if (tile_batch_req->n_tiles > 0)
+    {
+      tile_batch_req->tile_nums = g_new (guint32, tile_batch_req->n_tiles);
+
+      if (! _gimp_wire_read_int32 (channel,
+                                   tile_batch_req->tile_nums,
+                                   tile_batch_req->n_tiles, user_data))
+        goto cleanup;
+    }
+
+  msg->data = tile_batch_req;
+  return;
+
+ cleanup:
+  g_free (tile_batch_req->tile_nums);
+  g_slice_free (GPTileBatchReq, tile_batch_req);
+  msg->data = NULL;
+}
+
+static void
+_gp_tile_batch_req_write (GIOChannel      *channel,
+                          GimpWireMessage *msg,
+                          gpointer         user_data)
+{
+  GPTileBatchReq *tile_batch_req = msg->data;
+
+  if (! _gimp_wire_write_int32 (channel,
+                                (const guint32 *) &tile_batch_req->drawable_ID,
+                                1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &tile_batch_req->shadow, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &tile_batch_req->n_tiles, 1, user_data))
+    return;
+
+  if (tile_batch_req->n_tiles > 0)
+    {
+      if (! _gimp_wire_write_int32 (channel,
+                                    tile_batch_req->tile_nums,
+                                    tile_batch_req->n_tiles, user_data))
+        return;
+    }
+}
+
+static void
+_gp_tile_batch_req_destroy (GimpWireMessage *msg)
+{
+  GPTileBatchReq *tile_batch_req = msg->data;
+
+  if (tile_batch_req)
+    {
+      g_free (tile_batch_req->tile_nums);
+      g_slice_free (GPTileBatchReq, tile_batch_req);
+    }
+}
+
+/*  tile_batch_data  */
+
+static void
+_gp_tile_batch_data_read (GIOChannel      *channel,
+                          GimpWireMessage *msg,
+                          gpointer         user_data)
+{
+  GPTileBatchData *tile_batch_data = g_slice_new0 (GPTileBatchData);
+
+  if (! _gimp_wire_read_int32 (channel,
+                               (guint32 *) &tile_batch_data->drawable_ID, 1,
+                               user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &tile_batch_data->shadow, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &tile_batch_data->bpp, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &tile_batch_data->n_tiles, 1, user_data))
+    goto cleanup;
+
+  if (tile_batch_data->n_tiles > 0)
+    {
+      tile_batch_data->tile_nums = g_new (guint32, tile_batch_data->n_tiles);
+
+      if (! _gimp_wire_read_int32 (channel,
+                                   tile_batch_data->tile_nums,
+                                   tile_batch_data->n_tiles, user_data))
+        goto cleanup;
+    }
+
+  if (! _gimp_wire_read_int32 (channel,
+                               &tile_batch_data->use_shm, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &tile_batch_data->length, 1, user_data))
+    goto cleanup;
+
+  if (! tile_batch_data->use_shm && tile_batch_data->length > 0)
+    {
+      tile_batch_data->data = g_new (guchar, tile_batch_data->length);
+
+      if (! _gimp_wire_read_int8 (channel,
+                                  (guint8 *) tile_batch_data->data,
+                                  tile_batch_data->length, user_data))
+        goto cleanup;
+    }
+
+  msg->data = tile_batch_data;
+  return;
+
+ cleanup:
+  g_free (tile_batch_data->tile_nums);
+  g_free (tile_batch_data->data);
+  g_slice_free (GPTileBatchData, tile_batch_data);
+  msg->data = NULL;
+}
+
+static void
+_gp_tile_batch_data_write (GIOChannel      *channel,
+                           GimpWireMessage *msg,
+                           gpointer         user_data)
+{
+  GPTileBatchData *tile_batch_data = msg->data;
+
+  if (! _gimp_wire_write_int32 (channel,
+                                (const guint32 *) &tile_batch_data->drawable_ID,
+                                1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &tile_batch_data->shadow, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &tile_batch_data->bpp, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &tile_batch_data->n_tiles, 1, user_data))
+    return;
+
+  if (tile_batch_data->n_tiles > 0)
+    {
+      if (! _gimp_wire_write_int32 (channel,
+                                    tile_batch_data->tile_nums,
+                                    tile_batch_data->n_tiles, user_data))
+        return;
+    }
+
+  if (! _gimp_wire_write_int32 (channel,
+                                &tile_batch_data->use_shm, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &tile_batch_data->length, 1, user_data))
+    return;
+
+  if (! tile_batch_data->use_shm && tile_batch_data->length > 0)
+    {
+      if (! _gimp_wire_write_int8 (channel,
+                                   (const guint8 *) tile_batch_data->data,
+                                   tile_batch_data->length, user_data))
+        return;
+    }
+}
+
+static void
+_gp_tile_batch_data_destroy (GimpWireMessage *msg)
+{
+  GPTileBatchData *tile_batch_data = msg->data;
+
+  if (tile_batch_data)
+    {
+      g_free (tile_batch_data->tile_nums);
+      g_free (tile_batch_data->data);
+      g_slice_free (GPTileBatchData, tile_batch_data);
+    }
+}
@@ -26,7 +26,18 @@ G_BEGIN_DECLS
 
 /* Increment every time the protocol changes
  */
-#define GIMP_PROTOCOL_VERSION  0x0019
+#define GIMP_PROTOCOL_VERSION  0x001A
+
+/* The maximal amount of pixel data in a single GP_TILE_BATCH_DATA
+ * message when no shared memory is used.  With shared memory, it's
+ * the size of the segment.
+ *
+ * Batches save round trips, not copies: the segment is shared by all
+ * plug-ins, so the pixels are still copied between it and each tile's
+ * own buffer on the plug-in side, and between it and the drawable's
+ * buffer in the core.
+ */
+#define GP_TILE_BATCH_PIPE_SIZE  (1 << 21)
 
 
 enum
@@ -43,7 +54,9 @@ enum
   GP_PROC_INSTALL,
   GP_PROC_UNINSTALL,
   GP_EXTENSION_ACK,
-  GP_HAS_INIT
+  GP_HAS_INIT,
+  GP_TILE_BATCH_REQ,
+  GP_TILE_BATCH_DATA
 };
 
 
@@ -51,6 +64,8 @@ typedef struct _GPConfig        GPConfig;
 typedef struct _GPTileReq       GPTileReq;
 typedef struct _GPTileAck       GPTileAck;
 typedef struct _GPTileData      GPTileData;
+typedef struct _GPTileBatchReq  GPTileBatchReq;
+typedef struct _GPTileBatchData GPTileBatchData;
 typedef struct _GPParam         GPParam;
 typedef struct _GPParamDef      GPParamDef;
 typedef struct _GPProcRun       GPProcRun;
@@ -90,6 +105,9 @@ struct _GPConfig
   guint64  tile_cache_size;
   gchar   *swap_path;
   gint32   num_processors;
+
+  /* since protocol version 0x001A: */
+  guint64  shm_size;
 };
 
 struct _GPTileReq
@@ -111,6 +129,26 @@ struct _GPTileData
   guchar  *data;
 };
 
+struct _GPTileBatchReq
+{
+  gint32   drawable_ID;
+  guint32  shadow;
+  guint32  n_tiles;
+  guint32 *tile_nums;
+};
+
+struct _GPTileBatchData
+{
+  gint32   drawable_ID;
+  guint32  shadow;
+  guint32  bpp;
+  guint32  n_tiles;
+  guint32 *tile_nums;
+  guint32  use_shm;
+  guint32  length;
+  guchar  *data;
+};
+
 struct _GPParam
 {
   guint32 type;
@@ -232,6 +270,12 @@ gboolean  gp_extension_ack_write    (GIOChannel      *channel,
                                      gpointer         user_data);
 gboolean  gp_has_init_write         (GIOChannel      *channel,
                                      gpointer         user_data);
+gboolean  gp_tile_batch_req_write   (GIOChannel      *channel,
+                                     GPTileBatchReq  *tile_batch_req,
+                                     gpointer         user_data);
+gboolean  gp_tile_batch_data_write  (GIOChannel      *channel,
+                                     GPTileBatchData *tile_batch_data,
+                                     gpointer         user_data);
 
 void      gp_params_destroy         (GPParam         *params,
                                      gint             nparams);
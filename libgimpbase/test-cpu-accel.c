@@ -31,6 +31,20 @@ cpu_accel_print_results (void)
               (support & GIMP_CPU_ACCEL_X86_SSE2)    ? "yes" : "no");
   g_printerr ("  sse3    : %s\n",
               (support & GIMP_CPU_ACCEL_X86_SSE3)    ? "yes" : "no");
+  g_printerr ("  ssse3   : %s\n",
+              (support & GIMP_CPU_ACCEL_X86_SSSE3)   ? "yes" : "no");
+  g_printerr ("  sse4_1  : %s\n",
+              (support & GIMP_CPU_ACCEL_X86_SSE4_1)  ? "yes" : "no");
+  g_printerr ("  sse4_2  : %s\n",
+              (support & GIMP_CPU_ACCEL_X86_SSE4_2)  ? "yes" : "no");
+  g_printerr ("  avx     : %s\n",
+              (support & GIMP_CPU_ACCEL_X86_AVX)     ? "yes" : "no");
+  g_printerr ("  avx2    : %s\n",
+              (support & GIMP_CPU_ACCEL_X86_AVX2)    ? "yes" : "no");
+  g_printerr ("  fma     : %s\n",
+              (support & GIMP_CPU_ACCEL_X86_FMA)     ? "yes" : "no");
+  g_printerr ("  avx512f : %s\n",
+              (support & GIMP_CPU_ACCEL_X86_AVX512F) ? "yes" : "no");
 #endif
 #ifdef ARCH_PPC
   g_printerr ("  altivec : %s\n",
@@ -65,23 +65,119 @@ enum
 };
 
 
+/*  the number of transforms kept alive by the transform cache  */
+#define TRANSFORM_CACHE_SIZE 32
+
+/*  the number of grid points along each axis of a transform's 3D LUT  */
+#define LUT_GRID_POINTS      33
+
+/*  our own flags, which must not be passed on to lcms  */
+#define GIMP_COLOR_TRANSFORM_FLAGS_PRIVATE \
+  (GIMP_COLOR_TRANSFORM_FLAGS_APPROXIMATE_LUT)
+
+#define PIXELS_PER_THREAD \
+  (/* each thread costs as much as */ 64.0 * 64.0 /* pixels */)
+
+
+typedef struct _TransformCacheEntry TransformCacheEntry;
+typedef struct _PixelLayout         PixelLayout;
+typedef struct _ColorLut            ColorLut;
+typedef struct _ProcessBufferData   ProcessBufferData;
+
+/*  the location of the components of an 8- or 16-bit RGB(A) pixel  */
+struct _PixelLayout
+{
+  gint bytes;      /* bytes per component               */
+  gint n_channels; /* components per pixel              */
+  gint rgb[3];     /* offset of red, green and blue     */
+  gint alpha;      /* offset of the alpha, or -1        */
+};
+
+/*  a precomputed RGB -> RGB transform, sampled on a regular grid and
+ *  evaluated using tetrahedral interpolation
+ */
+struct _ColorLut
+{
+  PixelLayout  src;
+  PixelLayout  dest;
+  guint16     *table;
+};
+
+/*  lcms transforms are expensive to create, and the same ones are created
+ *  over and over (for example, whenever the display or image profile is set),
+ *  so they are shared between GimpColorTransforms through a process-wide
+ *  cache, keyed by everything that went into creating them.
+ */
+struct _TransformCacheEntry
+{
+  gint                      ref_count;
+
+  GimpColorProfile         *src_profile;
+  cmsUInt32Number           lcms_src_format;
+  GimpColorProfile         *dest_profile;
+  cmsUInt32Number           lcms_dest_format;
+  GimpColorProfile         *proof_profile;
+  GimpColorRenderingIntent  intent;
+  GimpColorRenderingIntent  proofing_intent; /* proof -> dest, if proofing */
+  GimpColorTransformFlags   flags;
+  cmsUInt16Number           alarm_codes[cmsMAXCHANNELS];
+
+  cmsHTRANSFORM             transform;
+  ColorLut                 *lut;
+};
+
+struct _ProcessBufferData
+{
+  GimpColorTransform *transform;
+  GeglBuffer         *src_buffer;
+  GeglBuffer         *dest_buffer;
+  gint                dest_offset_x;
+  gint                dest_offset_y;
+  GThread            *thread;
+  GMutex              progress_mutex;
+  gint64              done_pixels;
+  gint64              total_pixels;
+};
+
+
 struct _GimpColorTransformPrivate
 {
-  GimpColorProfile *src_profile;
-  const Babl       *src_format;
-  const Babl       *src_space_format;
+  GimpColorProfile    *src_profile;
+  const Babl          *src_format;
+  const Babl          *src_space_format;
 
-  GimpColorProfile *dest_profile;
-  const Babl       *dest_format;
-  const Babl       *dest_space_format;
+  GimpColorProfile    *dest_profile;
+  const Babl          *dest_format;
+  const Babl          *dest_space_format;
 
-  cmsHTRANSFORM     transform;
-  const Babl       *fish;
+  TransformCacheEntry *cache_entry;
+  cmsHTRANSFORM        transform;
+  const Babl          *fish;
 };
 
 
 static void   gimp_color_transform_finalize (GObject *object);
 
+static TransformCacheEntry *
+              transform_cache_entry_get     (const TransformCacheEntry *key);
+static void   transform_cache_entry_unref   (TransformCacheEntry       *entry);
+
+static ColorLut *
+              color_lut_new                 (const TransformCacheEntry *key);
+static void   color_lut_free                (ColorLut                  *lut);
+static void   color_lut_process             (const ColorLut            *lut,
+                                             gconstpointer              src,
+                                             gpointer                   dest,
+                                             gsize                      length);
+
+static void   gimp_color_transform_do       (GimpColorTransform        *transform,
+                                             gconstpointer              src,
+                                             gpointer                   dest,
+                                             gsize                      length);
+static void   gimp_color_transform_process_area
+                                            (const GeglRectangle       *area,
+                                             ProcessBufferData         *data);
+
 
 G_DEFINE_TYPE_WITH_PRIVATE (GimpColorTransform, gimp_color_transform,
                             G_TYPE_OBJECT)
@@ -92,6 +188,9 @@ static guint gimp_color_transform_signals[LAST_SIGNAL] = { 0 };
 
 static gchar *lcms_last_error = NULL;
 
+static GQueue transform_cache       = G_QUEUE_INIT;
+static GMutex transform_cache_mutex;
+
 
 static void
 lcms_error_clear (void)
@@ -148,7 +247,9 @@ gimp_color_transform_finalize (GObject *object)
   g_clear_object (&transform->priv->src_profile);
   g_clear_object (&transform->priv->dest_profile);
 
-  g_clear_pointer (&transform->priv->transform, cmsDeleteTransform);
+  /*  the lcms transform is owned by the cache entry  */
+  transform->priv->transform = NULL;
+  g_clear_pointer (&transform->priv->cache_entry, transform_cache_entry_unref);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -165,6 +266,11 @@ gimp_color_transform_finalize (GObject *object)
  *
  * This function creates an color transform.
  *
+ * If @flags include %GIMP_COLOR_TRANSFORM_FLAGS_APPROXIMATE_LUT, 8 and
+ * 16 bit RGB pixels of optimized transforms are converted through a 3D
+ * lookup table, which is much faster, but less accurate, than lcms.
+ * This is meant for transforms whose result is only displayed.
+ *
  * Return value: the #GimpColorTransform, or %NULL if no transform is needed
  *               to convert between pixels of @src_profile and @dest_profile.
  *
@@ -180,8 +286,7 @@ gimp_color_transform_new (GimpColorProfile         *src_profile,
 {
   GimpColorTransform        *transform;
   GimpColorTransformPrivate *priv;
-  cmsHPROFILE                src_lcms;
-  cmsHPROFILE                dest_lcms;
+  TransformCacheEntry        key   = { 0, };
   cmsUInt32Number            lcms_src_format;
   cmsUInt32Number            lcms_dest_format;
   GError                    *error = NULL;
@@ -244,33 +349,23 @@ gimp_color_transform_new (GimpColorProfile         *src_profile,
   priv->dest_format = gimp_color_profile_get_lcms_format (dest_format,
                                                           &lcms_dest_format);
 
-  src_lcms  = gimp_color_profile_get_lcms_profile (src_profile);
-  dest_lcms = gimp_color_profile_get_lcms_profile (dest_profile);
-
-  lcms_error_clear ();
+  key.src_profile      = src_profile;
+  key.lcms_src_format  = lcms_src_format;
+  key.dest_profile     = dest_profile;
+  key.lcms_dest_format = lcms_dest_format;
+  key.intent           = rendering_intent;
+  key.flags            = flags;
 
-  priv->transform = cmsCreateTransform (src_lcms,  lcms_src_format,
-                                        dest_lcms, lcms_dest_format,
-                                        rendering_intent,
-                                        flags |
-                                        cmsFLAGS_COPY_ALPHA);
+  priv->cache_entry = transform_cache_entry_get (&key);
 
-  if (lcms_last_error)
+  if (! priv->cache_entry)
     {
-      if (priv->transform)
-        {
-          cmsDeleteTransform (priv->transform);
-          priv->transform = NULL;
-        }
+      g_object_unref (transform);
 
-      g_printerr ("%s\n", lcms_last_error);
+      return NULL;
     }
 
-  if (! priv->transform)
-    {
-      g_object_unref (transform);
-      transform = NULL;
-    }
+  priv->transform = priv->cache_entry->transform;
 
   return transform;
 }
@@ -304,9 +399,7 @@ gimp_color_transform_new_proofing (GimpColorProfile         *src_profile,
 {
   GimpColorTransform        *transform;
   GimpColorTransformPrivate *priv;
-  cmsHPROFILE                src_lcms;
-  cmsHPROFILE                dest_lcms;
-  cmsHPROFILE                proof_lcms;
+  TransformCacheEntry        key = { 0, };
   cmsUInt32Number            lcms_src_format;
   cmsUInt32Number            lcms_dest_format;
 
@@ -320,42 +413,30 @@ gimp_color_transform_new_proofing (GimpColorProfile         *src_profile,
 
   priv = transform->priv;
 
-  src_lcms   = gimp_color_profile_get_lcms_profile (src_profile);
-  dest_lcms  = gimp_color_profile_get_lcms_profile (dest_profile);
-  proof_lcms = gimp_color_profile_get_lcms_profile (proof_profile);
-
   priv->src_format  = gimp_color_profile_get_lcms_format (src_format,
                                                           &lcms_src_format);
   priv->dest_format = gimp_color_profile_get_lcms_format (dest_format,
                                                           &lcms_dest_format);
 
-  lcms_error_clear ();
+  key.src_profile      = src_profile;
+  key.lcms_src_format  = lcms_src_format;
+  key.dest_profile     = dest_profile;
+  key.lcms_dest_format = lcms_dest_format;
+  key.proof_profile    = proof_profile;
+  key.intent           = proof_intent;
+  key.proofing_intent  = display_intent;
+  key.flags            = flags;
 
-  priv->transform = cmsCreateProofingTransform (src_lcms,  lcms_src_format,
-                                                dest_lcms, lcms_dest_format,
-                                                proof_lcms,
-                                                proof_intent,
-                                                display_intent,
-                                                flags                 |
-                                                cmsFLAGS_SOFTPROOFING |
-                                                cmsFLAGS_COPY_ALPHA);
+  priv->cache_entry = transform_cache_entry_get (&key);
 
-  if (lcms_last_error)
+  if (! priv->cache_entry)
     {
-      if (priv->transform)
-        {
-          cmsDeleteTransform (priv->transform);
-          priv->transform = NULL;
-        }
+      g_object_unref (transform);
 
-      g_printerr ("%s\n", lcms_last_error);
+      return NULL;
     }
 
-  if (! priv->transform)
-    {
-      g_object_unref (transform);
-      transform = NULL;
-    }
+  priv->transform = priv->cache_entry->transform;
 
   return transform;
 }
@@ -415,14 +496,7 @@ gimp_color_transform_process_pixels (GimpColorTransform *transform,
       dest = dest_pixels;
     }
 
-  if (priv->transform)
-    {
-      cmsDoTransform (priv->transform, src, dest, length);
-    }
-  else
-    {
-      babl_process (priv->fish, src, dest, length);
-    }
+  gimp_color_transform_do (transform, src, dest, length);
 
   if (src_format != priv->src_format)
     {
@@ -447,7 +521,9 @@ gimp_color_transform_process_pixels (GimpColorTransform *transform,
  * @dest_buffer: destination #GeglBuffer
  * @dest_rect:   rectangle in @dest_buffer
  *
- * This function transforms buffer into another buffer.
+ * This function transforms buffer into another buffer. The work is
+ * distributed among multiple threads; the "progress" signal is only
+ * emitted in the calling thread.
  *
  * Since: 2.10
  **/
@@ -458,86 +534,35 @@ gimp_color_transform_process_buffer (GimpColorTransform  *transform,
                                      GeglBuffer          *dest_buffer,
                                      const GeglRectangle *dest_rect)
 {
-  GimpColorTransformPrivate *priv;
-  GeglBufferIterator        *iter;
-  gint                       total_pixels;
-  gint                       done_pixels = 0;
+  ProcessBufferData data;
 
   g_return_if_fail (GIMP_IS_COLOR_TRANSFORM (transform));
   g_return_if_fail (GEGL_IS_BUFFER (src_buffer));
   g_return_if_fail (GEGL_IS_BUFFER (dest_buffer));
 
-  priv = transform->priv;
+  if (! src_rect)
+    src_rect = gegl_buffer_get_extent (src_buffer);
 
-  if (src_rect)
-    {
-      total_pixels = src_rect->width * src_rect->height;
-    }
-  else
-    {
-      total_pixels = (gegl_buffer_get_width  (src_buffer) *
-                      gegl_buffer_get_height (src_buffer));
-    }
+  if (! dest_rect)
+    dest_rect = gegl_buffer_get_extent (dest_buffer);
 
-  if (src_buffer != dest_buffer)
-    {
-      iter = gegl_buffer_iterator_new (src_buffer, src_rect, 0,
-                                       priv->src_format,
-                                       GEGL_ACCESS_READ,
-                                       GEGL_ABYSS_NONE, 2);
+  data.transform     = transform;
+  data.src_buffer    = src_buffer;
+  data.dest_buffer   = dest_buffer;
+  data.dest_offset_x = dest_rect->x - src_rect->x;
+  data.dest_offset_y = dest_rect->y - src_rect->y;
+  data.thread        = g_thread_self ();
+  data.done_pixels   = 0;
+  data.total_pixels  = (gint64) src_rect->width * src_rect->height;
 
-      gegl_buffer_iterator_add (iter, dest_buffer, dest_rect, 0,
-                                priv->dest_format,
-                                GEGL_ACCESS_WRITE,
-                                GEGL_ABYSS_NONE);
+  g_mutex_init (&data.progress_mutex);
 
-      while (gegl_buffer_iterator_next (iter))
-        {
-          if (priv->transform)
-            {
-              cmsDoTransform (priv->transform,
-                              iter->items[0].data, iter->items[1].data, iter->length);
-            }
-          else
-            {
-              babl_process (priv->fish,
-                            iter->items[0].data, iter->items[1].data, iter->length);
-            }
-
-          done_pixels += iter->items[0].roi.width * iter->items[0].roi.height;
-
-          g_signal_emit (transform, gimp_color_transform_signals[PROGRESS], 0,
-                         (gdouble) done_pixels /
-                         (gdouble) total_pixels);
-        }
-    }
-  else
-    {
-      iter = gegl_buffer_iterator_new (src_buffer, src_rect, 0,
-                                       priv->src_format,
-                                       GEGL_ACCESS_READWRITE,
-                                       GEGL_ABYSS_NONE, 1);
+  gegl_parallel_distribute_area (
+    src_rect, PIXELS_PER_THREAD, GEGL_SPLIT_STRATEGY_AUTO,
+    (GeglParallelDistributeAreaFunc) gimp_color_transform_process_area,
+    &data);
 
-      while (gegl_buffer_iterator_next (iter))
-        {
-          if (priv->transform)
-            {
-              cmsDoTransform (priv->transform,
-                              iter->items[0].data, iter->items[0].data, iter->length);
-            }
-          else
-            {
-              babl_process (priv->fish,
-                            iter->items[0].data, iter->items[0].data, iter->length);
-            }
-
-          done_pixels += iter->items[0].roi.width * iter->items[0].roi.height;
-
-          g_signal_emit (transform, gimp_color_transform_signals[PROGRESS], 0,
-                         (gdouble) done_pixels /
-                         (gdouble) total_pixels);
-        }
-    }
+  g_mutex_clear (&data.progress_mutex);
 
   g_signal_emit (transform, gimp_color_transform_signals[PROGRESS], 0,
                  1.0);
@@ -594,3 +619,579 @@ gimp_color_transform_can_gegl_copy (GimpColorProfile *src_profile,
 
   return FALSE;
 }
+
+
+/*  private functions  */
+
+static cmsHTRANSFORM
+transform_cache_create_lcms_transform (const TransformCacheEntry *key,
+                                       cmsUInt32Number            lcms_src_format,
+                                       cmsUInt32Number            lcms_dest_format,
+                                       cmsUInt32Number            lcms_flags)
+{
+  cmsHTRANSFORM transform;
+  cmsHPROFILE   src_lcms;
+  cmsHPROFILE   dest_lcms;
+
+  lcms_flags &= ~GIMP_COLOR_TRANSFORM_FLAGS_PRIVATE;
+
+  src_lcms  = gimp_color_profile_get_lcms_profile (key->src_profile);
+  dest_lcms = gimp_color_profile_get_lcms_profile (key->dest_profile);
+
+  lcms_error_clear ();
+
+  if (key->proof_profile)
+    {
+      cmsHPROFILE proof_lcms;
+
+      proof_lcms = gimp_color_profile_get_lcms_profile (key->proof_profile);
+
+      transform = cmsCreateProofingTransform (src_lcms,  lcms_src_format,
+                                              dest_lcms, lcms_dest_format,
+                                              proof_lcms,
+                                              key->intent,
+                                              key->proofing_intent,
+                                              lcms_flags |
+                                              cmsFLAGS_SOFTPROOFING);
+    }
+  else
+    {
+      transform = cmsCreateTransform (src_lcms,  lcms_src_format,
+                                      dest_lcms, lcms_dest_format,
+                                      key->intent,
+                                      lcms_flags);
+    }
+
+  if (lcms_last_error)
+    {
+      if (transform)
+        {
+          cmsDeleteTransform (transform);
+          transform = NULL;
+        }
+
+      g_printerr ("%s\n", lcms_last_error);
+    }
+
+  return transform;
+}
+
+static gboolean
+transform_cache_entry_matches (const TransformCacheEntry *entry,
+                               const TransformCacheEntry *key)
+{
+  if (entry->lcms_src_format  != key->lcms_src_format  ||
+      entry->lcms_dest_format != key->lcms_dest_format ||
+      entry->intent           != key->intent           ||
+      entry->proofing_intent  != key->proofing_intent  ||
+      entry->flags            != key->flags)
+    {
+      return FALSE;
+    }
+
+  if (memcmp (entry->alarm_codes, key->alarm_codes,
+              sizeof (entry->alarm_codes)))
+    {
+      return FALSE;
+    }
+
+  if (! entry->proof_profile != ! key->proof_profile)
+    return FALSE;
+
+  return gimp_color_profile_is_equal (entry->src_profile,  key->src_profile)  &&
+         gimp_color_profile_is_equal (entry->dest_profile, key->dest_profile) &&
+         (! key->proof_profile ||
+          gimp_color_profile_is_equal (entry->proof_profile,
+                                       key->proof_profile));
+}
+
+/*  returns a new reference to the cache entry matching @key, creating the
+ *  entry if necessary, or %NULL if lcms fails to create the transform.
+ */
+static TransformCacheEntry *
+transform_cache_entry_get (const TransformCacheEntry *key)
+{
+  TransformCacheEntry  lookup = *key;
+  TransformCacheEntry *entry;
+  GList               *list;
+
+  /*  the gamut alarm color is global lcms state, which is baked into
+   *  gamut-checking transforms when they are created
+   */
+  if (lookup.flags & GIMP_COLOR_TRANSFORM_FLAGS_GAMUT_CHECK)
+    cmsGetAlarmCodes (lookup.alarm_codes);
+
+  g_mutex_lock (&transform_cache_mutex);
+
+  for (list = transform_cache.head; list; list = g_list_next (list))
+    {
+      entry = list->data;
+
+      if (transform_cache_entry_matches (entry, &lookup))
+        {
+          g_queue_unlink (&transform_cache, list);
+          g_queue_push_head_link (&transform_cache, list);
+
+          g_atomic_int_inc (&entry->ref_count);
+
+          g_mutex_unlock (&transform_cache_mutex);
+
+          return entry;
+        }
+    }
+
+  g_mutex_unlock (&transform_cache_mutex);
+
+  /*  create the transform without holding the lock.  if another thread
+   *  creates the same transform in the meantime, both end up in the cache,
+   *  and the older one eventually falls off its end.
+   */
+  lookup.transform = transform_cache_create_lcms_transform (
+                       &lookup,
+                       lookup.lcms_src_format,
+                       lookup.lcms_dest_format,
+                       lookup.flags | cmsFLAGS_COPY_ALPHA);
+
+  if (! lookup.transform)
+    return NULL;
+
+  entry = g_slice_new (TransformCacheEntry);
+
+  *entry = lookup;
+
+  entry->ref_count = 2; /* one for the cache, one for the caller */
+
+  g_object_ref (entry->src_profile);
+  g_object_ref (entry->dest_profile);
+
+  if (entry->proof_profile)
+    g_object_ref (entry->proof_profile);
+
+  entry->lut = color_lut_new (entry);
+
+  g_mutex_lock (&transform_cache_mutex);
+
+  g_queue_push_head (&transform_cache, entry);
+
+  while (g_queue_get_length (&transform_cache) > TRANSFORM_CACHE_SIZE)
+    transform_cache_entry_unref (g_queue_pop_tail (&transform_cache));
+
+  g_mutex_unlock (&transform_cache_mutex);
+
+  return entry;
+}
+
+static void
+transform_cache_entry_unref (TransformCacheEntry *entry)
+{
+  if (g_atomic_int_dec_and_test (&entry->ref_count))
+    {
+      g_clear_pointer (&entry->lut, color_lut_free);
+
+      cmsDeleteTransform (entry->transform);
+
+      g_object_unref (entry->src_profile);
+      g_object_unref (entry->dest_profile);
+      g_clear_object (&entry->proof_profile);
+
+      g_slice_free (TransformCacheEntry, entry);
+    }
+}
+
+/*  fills @layout according to the lcms pixel format @format, and returns
+ *  %TRUE if the format is an interleaved 8- or 16-bit RGB(A) format.
+ */
+static gboolean
+pixel_layout_init (PixelLayout     *layout,
+                   cmsUInt32Number  format)
+{
+  gint extra = T_EXTRA (format);
+
+  if (T_COLORSPACE (format) != PT_RGB ||
+      T_CHANNELS (format)   != 3      ||
+      extra                  > 1      ||
+      T_FLOAT (format)                ||
+      T_PLANAR (format)               ||
+      T_FLAVOR (format)               ||
+      T_ENDIAN16 (format)             ||
+      (T_BYTES (format) != 1 && T_BYTES (format) != 2))
+    {
+      return FALSE;
+    }
+
+  layout->bytes      = T_BYTES (format);
+  layout->n_channels = 3 + extra;
+
+  if (! extra)
+    {
+      /*  RGB or BGR  */
+      layout->rgb[0] = T_DOSWAP (format) ? 2 : 0;
+      layout->rgb[1] = 1;
+      layout->rgb[2] = T_DOSWAP (format) ? 0 : 2;
+      layout->alpha  = -1;
+    }
+  else if (T_DOSWAP (format) && T_SWAPFIRST (format))
+    {
+      /*  BGRA  */
+      layout->rgb[0] = 2;
+      layout->rgb[1] = 1;
+      layout->rgb[2] = 0;
+      layout->alpha  = 3;
+    }
+  else if (T_DOSWAP (format))
+    {
+      /*  ABGR  */
+      layout->rgb[0] = 3;
+      layout->rgb[1] = 2;
+      layout->rgb[2] = 1;
+      layout->alpha  = 0;
+    }
+  else if (T_SWAPFIRST (format))
+    {
+      /*  ARGB  */
+      layout->rgb[0] = 1;
+      layout->rgb[1] = 2;
+      layout->rgb[2] = 3;
+      layout->alpha  = 0;
+    }
+  else
+    {
+      /*  RGBA  */
+      layout->rgb[0] = 0;
+      layout->rgb[1] = 1;
+      layout->rgb[2] = 2;
+      layout->alpha  = 3;
+    }
+
+  return TRUE;
+}
+
+/*  creates the 3D LUT for @key, if the transform asked for one and its
+ *  formats allow it.  the LUT trades some accuracy for speed, so it is
+ *  only used for optimized transforms, and never for gamut checks, whose
+ *  alarm color would bleed into the neighboring in-gamut colors.
+ */
+static ColorLut *
+color_lut_new (const TransformCacheEntry *key)
+{
+  ColorLut      *lut;
+  cmsHTRANSFORM  sampler;
+  guint16       *grid;
+  const gint     n = LUT_GRID_POINTS;
+  gint           r, g, b;
+  gint           i;
+
+  if (! (key->flags & GIMP_COLOR_TRANSFORM_FLAGS_APPROXIMATE_LUT))
+    return NULL;
+
+  if (key->flags & (GIMP_COLOR_TRANSFORM_FLAGS_NOOPTIMIZE |
+                    GIMP_COLOR_TRANSFORM_FLAGS_GAMUT_CHECK))
+    {
+      return NULL;
+    }
+
+  if (g_getenv ("GIMP_COLOR_TRANSFORM_DISABLE_LUT"))
+    return NULL;
+
+  lut = g_slice_new (ColorLut);
+
+  if (! pixel_layout_init (&lut->src,  key->lcms_src_format)  ||
+      ! pixel_layout_init (&lut->dest, key->lcms_dest_format) ||
+      (lut->dest.alpha >= 0 && lut->src.alpha < 0))
+    {
+      g_slice_free (ColorLut, lut);
+
+      return NULL;
+    }
+
+  /*  sample the unoptimized transform, so that the LUT doesn't compound
+   *  the error of lcms' own precalculated tables
+   */
+  sampler = transform_cache_create_lcms_transform (key,
+                                                   TYPE_RGB_16, TYPE_RGB_16,
+                                                   key->flags |
+                                                   cmsFLAGS_NOOPTIMIZE);
+
+  if (! sampler)
+    {
+      g_slice_free (ColorLut, lut);
+
+      return NULL;
+    }
+
+  grid       = g_new (guint16, n * n * n * 3);
+  lut->table = g_new (guint16, n * n * n * 3);
+
+  for (r = 0, i = 0; r < n; r++)
+    for (g = 0; g < n; g++)
+      for (b = 0; b < n; b++, i += 3)
+        {
+          grid[i + 0] = (r * 65535 + (n - 1) / 2) / (n - 1);
+          grid[i + 1] = (g * 65535 + (n - 1) / 2) / (n - 1);
+          grid[i + 2] = (b * 65535 + (n - 1) / 2) / (n - 1);
+        }
+
+  cmsDoTransform (sampler, grid, lut->table, n * n * n);
+
+  cmsDeleteTransform (sampler);
+  g_free (grid);
+
+  return lut;
+}
+
+static void
+color_lut_free (ColorLut *lut)
+{
+  g_free (lut->table);
+
+  g_slice_free (ColorLut, lut);
+}
+
+static inline guint
+color_lut_read (const guint8 *pixel,
+                gint          bytes,
+                gint          offset)
+{
+  if (bytes == 1)
+    return pixel[offset] * 257;
+  else
+    return ((const guint16 *) pixel)[offset];
+}
+
+static inline void
+color_lut_write (guint8 *pixel,
+                 gint    bytes,
+                 gint    offset,
+                 guint   value)
+{
+  if (bytes == 1)
+    pixel[offset] = (value * 255 + 32767) / 65535;
+  else
+    ((guint16 *) pixel)[offset] = value;
+}
+
+/*  interpolates the LUT at the 16-bit color (@r, @g, @b), by splitting the
+ *  grid cell containing it into six tetrahedra sharing its main diagonal,
+ *  and interpolating between the four vertices of the one containing it.
+ */
+static inline void
+color_lut_interpolate (const ColorLut *lut,
+                       guint           r,
+                       guint           g,
+                       guint           b,
+                       guint           out[3])
+{
+  const gint     n         = LUT_GRID_POINTS;
+  const gint     stride_r  = n * n * 3;
+  const gint     stride_g  = n * 3;
+  const gint     stride_b  = 3;
+  const guint16 *c000;
+  const guint16 *c1;
+  const guint16 *c2;
+  const guint16 *c111;
+  gfloat         w1, w2, w3;
+  gint           ir, ig, ib;
+  gfloat         fr, fg, fb;
+  gint           c;
+
+  fr = r * (gfloat) (n - 1) / 65535.0f;
+  fg = g * (gfloat) (n - 1) / 65535.0f;
+  fb = b * (gfloat) (n - 1) / 65535.0f;
+
+  ir = MIN ((gint) fr, n - 2);
+  ig = MIN ((gint) fg, n - 2);
+  ib = MIN ((gint) fb, n - 2);
+
+  fr -= ir;
+  fg -= ig;
+  fb -= ib;
+
+  c000 = lut->table + ir * stride_r + ig * stride_g + ib * stride_b;
+  c111 = c000 + stride_r + stride_g + stride_b;
+
+  /*  walk from c000 to c111 along the edges in order of decreasing
+   *  fractional part; c1 and c2 are the intermediate vertices
+   */
+  if (fr >= fg)
+    {
+      if (fg >= fb)
+        {
+          c1 = c000 + stride_r;
+          c2 = c1   + stride_g;
+          w1 = fr; w2 = fg; w3 = fb;
+        }
+      else if (fr >= fb)
+        {
+          c1 = c000 + stride_r;
+          c2 = c1   + stride_b;
+          w1 = fr; w2 = fb; w3 = fg;
+        }
+      else
+        {
+          c1 = c000 + stride_b;
+          c2 = c1   + stride_r;
+          w1 = fb; w2 = fr; w3 = fg;
+        }
+    }
+  else
+    {
+      if (fr >= fb)
+        {
+          c1 = c000 + stride_g;
+          c2 = c1   + stride_r;
+          w1 = fg; w2 = fr; w3 = fb;
+        }
+      else if (fg >= fb)
+        {
+          c1 = c000 + stride_g;
+          c2 = c1   + stride_b;
+          w1 = fg; w2 = fb; w3 = fr;
+        }
+      else
+        {
+          c1 = c000 + stride_b;
+          c2 = c1   + stride_g;
+          w1 = fb; w2 = fg; w3 = fr;
+        }
+    }
+
+  for (c = 0; c < 3; c++)
+    {
+      gfloat value = c000[c]                   +
+                     w1 * (c1[c]   - c000[c]) +
+                     w2 * (c2[c]   - c1[c])   +
+                     w3 * (c111[c] - c2[c]);
+
+      out[c] = CLAMP (value + 0.5f, 0.0f, 65535.0f);
+    }
+}
+
+static void
+color_lut_process (const ColorLut *lut,
+                   gconstpointer   src,
+                   gpointer        dest,
+                   gsize           length)
+{
+  const guint8 *s           = src;
+  guint8       *d           = dest;
+  const gint    src_stride  = lut->src.bytes  * lut->src.n_channels;
+  const gint    dest_stride = lut->dest.bytes * lut->dest.n_channels;
+
+  while (length--)
+    {
+      guint rgb[3];
+
+      color_lut_interpolate (lut,
+                             color_lut_read (s, lut->src.bytes,
+                                             lut->src.rgb[0]),
+                             color_lut_read (s, lut->src.bytes,
+                                             lut->src.rgb[1]),
+                             color_lut_read (s, lut->src.bytes,
+                                             lut->src.rgb[2]),
+                             rgb);
+
+      color_lut_write (d, lut->dest.bytes, lut->dest.rgb[0], rgb[0]);
+      color_lut_write (d, lut->dest.bytes, lut->dest.rgb[1], rgb[1]);
+      color_lut_write (d, lut->dest.bytes, lut->dest.rgb[2], rgb[2]);
+
+      if (lut->dest.alpha >= 0)
+        {
+          color_lut_write (d, lut->dest.bytes, lut->dest.alpha,
+                           color_lut_read (s, lut->src.bytes,
+                                           lut->src.alpha));
+        }
+
+      s += src_stride;
+      d += dest_stride;
+    }
+}
+
+static void
+gimp_color_transform_do (GimpColorTransform *transform,
+                         gconstpointer       src,
+                         gpointer            dest,
+                         gsize               length)
+{
+  GimpColorTransformPrivate *priv = transform->priv;
+
+  if (priv->cache_entry && priv->cache_entry->lut)
+    {
+      color_lut_process (priv->cache_entry->lut, src, dest, length);
+    }
+  else if (priv->transform)
+    {
+      cmsDoTransform (priv->transform, src, dest, length);
+    }
+  else
+    {
+      babl_process (priv->fish, src, dest, length);
+    }
+}
+
+static void
+gimp_color_transform_process_area (const GeglRectangle *area,
+                                   ProcessBufferData   *data)
+{
+  GimpColorTransformPrivate *priv = data->transform->priv;
+  GeglBufferIterator        *iter;
+  gint                       dest_index;
+
+  if (data->src_buffer != data->dest_buffer)
+    {
+      GeglRectangle dest_area = *area;
+
+      dest_area.x += data->dest_offset_x;
+      dest_area.y += data->dest_offset_y;
+
+      iter = gegl_buffer_iterator_new (data->src_buffer, area, 0,
+                                       priv->src_format,
+                                       GEGL_ACCESS_READ,
+                                       GEGL_ABYSS_NONE, 2);
+
+      dest_index = gegl_buffer_iterator_add (iter, data->dest_buffer,
+                                             &dest_area, 0,
+                                             priv->dest_format,
+                                             GEGL_ACCESS_WRITE,
+                                             GEGL_ABYSS_NONE);
+    }
+  else
+    {
+      iter = gegl_buffer_iterator_new (data->src_buffer, area, 0,
+                                       priv->src_format,
+                                       GEGL_ACCESS_READWRITE,
+                                       GEGL_ABYSS_NONE, 1);
+
+      dest_index = 0;
+    }
+
+  while (gegl_buffer_iterator_next (iter))
+    {
+      gint64 done_pixels;
+
+      gimp_color_transform_do (data->transform,
+                               iter->items[0].data,
+                               iter->items[dest_index].data,
+                               iter->length);
+
+      /*  there are no 64 bit atomics, and a gint counter overflows on
+       *  large images
+       */
+      g_mutex_lock (&data->progress_mutex);
+
+      data->done_pixels += iter->length;
+      done_pixels        = data->done_pixels;
+
+      g_mutex_unlock (&data->progress_mutex);
+
+      /*  progress handlers may touch the UI, so only report progress from
+       *  the calling thread, which accounts for the other threads' work, too
+       */
+      if (g_thread_self () == data->thread)
+        {
+          g_signal_emit (data->transform,
+                         gimp_color_transform_signals[PROGRESS], 0,
+                         (gdouble) done_pixels /
+                         (gdouble) data->total_pixels);
+        }
+    }
+}
@@ -32,11 +32,33 @@ G_BEGIN_DECLS
 /* For information look into the C source or the html documentation */
 
 
+/**
+ * GimpColorTransformFlags:
+ * @GIMP_COLOR_TRANSFORM_FLAGS_NOOPTIMIZE:               optimization is
+ *                                                       disabled
+ * @GIMP_COLOR_TRANSFORM_FLAGS_GAMUT_CHECK:              out-of-gamut colors
+ *                                                       are marked
+ * @GIMP_COLOR_TRANSFORM_FLAGS_BLACK_POINT_COMPENSATION: black point
+ *                                                       compensation is used
+ * @GIMP_COLOR_TRANSFORM_FLAGS_APPROXIMATE_LUT:          8 and 16 bit RGB
+ *                                                       pixels are converted
+ *                                                       through a 3D lookup
+ *                                                       table, which is
+ *                                                       faster but less
+ *                                                       accurate, meant for
+ *                                                       display transforms
+ *                                                       (Since 2.10.14)
+ *
+ * Flags for modifying the way a #GimpColorTransform converts pixels.
+ *
+ * Since: 2.10
+ **/
 typedef enum
 {
   GIMP_COLOR_TRANSFORM_FLAGS_NOOPTIMIZE               = 0x0100,
   GIMP_COLOR_TRANSFORM_FLAGS_GAMUT_CHECK              = 0x1000,
   GIMP_COLOR_TRANSFORM_FLAGS_BLACK_POINT_COMPENSATION = 0x2000,
+  GIMP_COLOR_TRANSFORM_FLAGS_APPROXIMATE_LUT          = 0x10000000,
 } GimpColorTransformFlags;
 
 
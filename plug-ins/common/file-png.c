@@ -49,6 +49,7 @@
 #include <libgimp/gimpui.h>
 
 #include <png.h>                /* PNG library definitions */
+#include <zlib.h>
 
 #include "libgimp/stdplugins-intl.h"
 
@@ -73,6 +74,9 @@
 
 #define PNG_DEFAULTS_PARASITE  "png-save-defaults"
 
+#define DEFLATE_BAND_SIZE      (256 * 1024) /* filtered bytes per band       */
+#define DEFLATE_WINDOW_SIZE    32768        /* size of the deflate dictionary */
+
 /*
  * Structures...
  */
@@ -143,6 +147,35 @@ typedef struct
 }
 PngGlobals;
 
+/* A band of rows, filtered and deflated on its own thread */
+typedef struct
+{
+  gint      first_row;        /* first row, relative to the batch      */
+  gint      n_rows;           /* number of rows                        */
+  guchar   *data;             /* deflated data, see save_deflate_bands */
+  gsize     size;             /* size of the deflated data             */
+  uLong     adler;            /* adler32 of the filtered data          */
+}
+PngBand;
+
+/* A batch of rows, processed by save_rows_parallel() */
+typedef struct
+{
+  const guchar *raw;          /* rows, preceded by the previous row    */
+  gsize         raw_stride;
+  guchar       *filtered;     /* filtered rows, preceded by the tail   */
+  gsize         dict_size;    /* of the previously filtered data       */
+  gsize         rowbytes;
+  gint          filter_bpp;
+  gboolean      all_filters;
+  gint          level;
+  gint          strategy;
+  gboolean      last_batch;
+  PngBand      *bands;
+  gint          n_bands;
+}
+PngDeflateData;
+
 
 /*
  * Local functions...
@@ -165,6 +198,30 @@ static gboolean  save_image                (const gchar      *filename,
                                             gint32            orig_image_ID,
                                             GError          **error);
 
+static void      save_fixup_rows           (png_structp       pp,
+                                            png_infop         info,
+                                            guchar           *pixel,
+                                            gint              num,
+                                            gint              width,
+                                            gint              bpp,
+                                            const guchar     *remap);
+static void      save_rows_parallel        (png_structp       pp,
+                                            png_infop         info,
+                                            GeglBuffer       *buffer,
+                                            const Babl       *file_format,
+                                            gint              width,
+                                            gint              height,
+                                            gint              bpp,
+                                            gint              bit_depth,
+                                            gint              color_type,
+                                            const guchar     *remap);
+static void      save_filter_rows          (PngDeflateData   *data,
+                                            gint              first_row,
+                                            gint              n_rows);
+static void      save_deflate_bands        (PngDeflateData   *data,
+                                            gint              first_band,
+                                            gint              n_bands);
+
 static int       respin_cmap               (png_structp       pp,
                                             png_infop         info,
                                             guchar           *remap,
@@ -1450,7 +1507,7 @@ save_image (const gchar  *filename,
             gint32        orig_image_ID,
             GError      **error)
 {
-  gint              i, k;             /* Looping vars */
+  gint              i;                /* Looping var */
   gint              bpp = 0;          /* Bytes per pixel */
   gint              type;             /* Type of drawable/layer */
   gint              num_passes;       /* Number of interlace passes in file */
@@ -1470,7 +1527,6 @@ save_image (const gchar  *filename,
   png_infop         info;             /* PNG info pointer */
   gint              offx, offy;       /* Drawable offsets from origin */
   guchar          **pixels;           /* Pixel rows */
-  guchar           *fixed;            /* Fixed-up pixel data */
   guchar           *pixel;            /* Pixel data */
   gdouble           xres, yres;       /* GIMP resolution (dpi) */
   png_color_16      background;       /* Background color */
@@ -2006,155 +2062,586 @@ save_image (const gchar  *filename,
     png_set_text (pp, info, text, 1);
 
   png_write_info (pp, info);
-  if (G_BYTE_ORDER == G_LITTLE_ENDIAN)
-    png_set_swap (pp);
-
   /*
-   * Turn on interlace handling...
+   * Non-interlaced images without packed pixels are filtered and
+   * compressed on multiple threads, see save_rows_parallel().
    */
 
-  if (pngvals.interlaced)
-    num_passes = png_set_interlace_handling (pp);
+  if (! pngvals.interlaced && bit_depth >= 8 &&
+      g_get_num_processors () > 1 &&
+      (gsize) height * png_get_rowbytes (pp, info) > DEFLATE_BAND_SIZE)
+    {
+      save_rows_parallel (pp, info, buffer, file_format,
+                          width, height, bpp, bit_depth, color_type, remap);
+    }
   else
-    num_passes = 1;
+    {
+      if (G_BYTE_ORDER == G_LITTLE_ENDIAN)
+        png_set_swap (pp);
 
-  /*
-   * Convert unpacked pixels to packed if necessary
-   */
+      /*
+       * Turn on interlace handling...
+       */
 
-  if (color_type == PNG_COLOR_TYPE_PALETTE &&
-      bit_depth < 8)
-    png_set_packing (pp);
+      if (pngvals.interlaced)
+        num_passes = png_set_interlace_handling (pp);
+      else
+        num_passes = 1;
+
+      /*
+       * Convert unpacked pixels to packed if necessary
+       */
+
+      if (color_type == PNG_COLOR_TYPE_PALETTE &&
+          bit_depth < 8)
+        png_set_packing (pp);
+
+      /*
+       * Allocate memory for "tile_height" rows and export the image...
+       */
+
+      tile_height = gimp_tile_height ();
+      pixel = g_new (guchar, tile_height * width * bpp);
+      pixels = g_new (guchar *, tile_height);
+
+      for (i = 0; i < tile_height; i++)
+        pixels[i] = pixel + width * bpp * i;
+
+      for (pass = 0; pass < num_passes; pass++)
+        {
+          /* This works if you are only writing one row at a time... */
+          for (begin = 0, end = tile_height;
+               begin < height; begin += tile_height, end += tile_height)
+            {
+              if (end > height)
+                end = height;
+
+              num = end - begin;
+
+              gegl_buffer_get (buffer,
+                               GEGL_RECTANGLE (0, begin, width, num),
+                               1.0,
+                               file_format,
+                               pixel,
+                               GEGL_AUTO_ROWSTRIDE,
+                               GEGL_ABYSS_NONE);
+
+              save_fixup_rows (pp, info, pixel, num, width, bpp, remap);
+
+              png_write_rows (pp, pixels, num);
+
+              gimp_progress_update (((double) pass + (double) end /
+                                     (double) height) /
+                                    (double) num_passes);
+            }
+        }
+
+      gimp_progress_update (1.0);
+
+      png_write_end (pp, info);
+
+      g_free (pixel);
+      g_free (pixels);
+    }
+
+  png_destroy_write_struct (&pp, &info);
 
   /*
-   * Allocate memory for "tile_height" rows and export the image...
+   * Done with the file...
    */
 
-  tile_height = gimp_tile_height ();
-  pixel = g_new (guchar, tile_height * width * bpp);
-  pixels = g_new (guchar *, tile_height);
+  if (text)
+    {
+      g_free (text[0].text);
+      g_free (text);
+    }
 
-  for (i = 0; i < tile_height; i++)
-    pixels[i] = pixel + width * bpp * i;
+  free (pp);
+  free (info);
 
-  for (pass = 0; pass < num_passes; pass++)
+  fclose (fp);
+
+  return TRUE;
+}
+
+/*
+ * 'save_fixup_rows()' - Prepare rows of pixel data for writing.
+ *
+ * The rows are expected at @pixel, each one @width * @bpp bytes wide.
+ * Indexed rows are written back as one byte per pixel, at the start
+ * of each row.
+ */
+
+static void
+save_fixup_rows (png_structp   pp,
+                 png_infop     info,
+                 guchar       *pixel,
+                 gint          num,
+                 gint          width,
+                 gint          bpp,
+                 const guchar *remap)
+{
+  guchar *fixed;
+  gint    i, k;
+
+  /* If we are with a RGBA image and have to pre-multiply the
+     alpha channel */
+  if (bpp == 4 && ! pngvals.save_transp_pixels)
     {
-      /* This works if you are only writing one row at a time... */
-      for (begin = 0, end = tile_height;
-           begin < height; begin += tile_height, end += tile_height)
+      for (i = 0; i < num; ++i)
         {
-          if (end > height)
-            end = height;
+          fixed = pixel + width * bpp * i;
+          for (k = 0; k < width; ++k)
+            {
+              if (!fixed[3])
+                fixed[0] = fixed[1] = fixed[2] = 0;
+              fixed += bpp;
+            }
+        }
+    }
 
-          num = end - begin;
+  if (bpp == 8 && ! pngvals.save_transp_pixels)
+    {
+      for (i = 0; i < num; ++i)
+        {
+          fixed = pixel + width * bpp * i;
+          for (k = 0; k < width; ++k)
+            {
+              if (!fixed[6] && !fixed[7])
+                fixed[0] = fixed[1] = fixed[2] =
+                    fixed[3] = fixed[4] = fixed[5] = 0;
+              fixed += bpp;
+            }
+        }
+    }
 
-          gegl_buffer_get (buffer,
-                           GEGL_RECTANGLE (0, begin, width, num),
-                           1.0,
-                           file_format,
-                           pixel,
-                           GEGL_AUTO_ROWSTRIDE,
-                           GEGL_ABYSS_NONE);
+  /* If we're dealing with a paletted image with
+   * transparency set, write out the remapped palette */
+  if (png_get_valid (pp, info, PNG_INFO_tRNS))
+    {
+      guchar inverse_remap[256];
+
+      for (i = 0; i < 256; i++)
+        inverse_remap[ remap[i] ] = i;
 
-          /* If we are with a RGBA image and have to pre-multiply the
-             alpha channel */
-          if (bpp == 4 && ! pngvals.save_transp_pixels)
+      for (i = 0; i < num; ++i)
+        {
+          fixed = pixel + width * bpp * i;
+          for (k = 0; k < width; ++k)
             {
-              for (i = 0; i < num; ++i)
-                {
-                  fixed = pixels[i];
-                  for (k = 0; k < width; ++k)
-                    {
-                      if (!fixed[3])
-                        fixed[0] = fixed[1] = fixed[2] = 0;
-                      fixed += bpp;
-                    }
-                }
+              fixed[k] = (fixed[k*2+1] > 127) ?
+                         inverse_remap[ fixed[k*2] ] :
+                         0;
             }
+        }
+    }
 
-          if (bpp == 8 && ! pngvals.save_transp_pixels)
+  /* Otherwise if we have a paletted image and transparency
+   * couldn't be set, we ignore the alpha channel */
+  else if (png_get_valid (pp, info, PNG_INFO_PLTE) &&
+           bpp == 2)
+    {
+      for (i = 0; i < num; ++i)
+        {
+          fixed = pixel + width * bpp * i;
+          for (k = 0; k < width; ++k)
             {
-              for (i = 0; i < num; ++i)
-                {
-                  fixed = pixels[i];
-                  for (k = 0; k < width; ++k)
-                    {
-                      if (!fixed[6] && !fixed[7])
-                        fixed[0] = fixed[1] = fixed[2] =
-                            fixed[3] = fixed[4] = fixed[5] = 0;
-                      fixed += bpp;
-                    }
-                }
+              fixed[k] = fixed[k * 2];
             }
+        }
+    }
+}
 
-          /* If we're dealing with a paletted image with
-           * transparency set, write out the remapped palette */
-          if (png_get_valid (pp, info, PNG_INFO_tRNS))
+/*
+ * 'save_rows_parallel()' - Write the image data using multiple threads.
+ *
+ * Instead of handing the rows to libpng, the image is read in batches,
+ * which are split into bands of roughly DEFLATE_BAND_SIZE filtered
+ * bytes.  The bands of a batch are filtered, and then deflated, in
+ * parallel.  Each band is compressed as a raw deflate stream, using the
+ * preceding 32k of filtered data as its dictionary, and ends with a
+ * sync flush, so that the bands can simply be concatenated.  The zlib
+ * header and the adler32 checksum, combined from the checksums of the
+ * bands, are added around the whole, and every band is written as its
+ * own IDAT chunk.  The result is a regular PNG file.
+ *
+ * Interlaced images and packed pixels are not supported.
+ */
+
+static void
+save_rows_parallel (png_structp   pp,
+                    png_infop     info,
+                    GeglBuffer   *buffer,
+                    const Babl   *file_format,
+                    gint          width,
+                    gint          height,
+                    gint          bpp,
+                    gint          bit_depth,
+                    gint          color_type,
+                    const guchar *remap)
+{
+  PngDeflateData  data;
+  guchar         *raw;
+  guchar         *filtered;
+  gsize           raw_stride;
+  gsize           rowbytes;
+  gint            band_rows;
+  gint            batch_rows;
+  gint            max_bands;
+  gint            begin;
+  uLong           adler;
+  gboolean        first_band = TRUE;
+
+  rowbytes   = png_get_rowbytes (pp, info);
+  raw_stride = (gsize) width * bpp;
+
+  band_rows  = MAX (1, DEFLATE_BAND_SIZE / (rowbytes + 1));
+  max_bands  = 2 * g_get_num_processors ();
+  batch_rows = band_rows * max_bands;
+
+  /* the raw rows are preceded by the last row of the previous batch,
+   * which is all zeros for the first row of the image
+   */
+  raw = g_malloc0 (raw_stride * (batch_rows + 1));
+
+  /* the filtered rows are preceded by the tail of the previously
+   * filtered data, used as the dictionary of the first band
+   */
+  filtered = g_malloc (DEFLATE_WINDOW_SIZE + (rowbytes + 1) * batch_rows);
+
+  data.raw         = raw + raw_stride;
+  data.raw_stride  = raw_stride;
+  data.filtered    = filtered + DEFLATE_WINDOW_SIZE;
+  data.dict_size   = 0;
+  data.rowbytes    = rowbytes;
+  data.filter_bpp  = MAX (1, rowbytes / width);
+  data.bands       = g_new0 (PngBand, max_bands);
+
+  /* the same defaults libpng uses */
+  data.all_filters = (color_type != PNG_COLOR_TYPE_PALETTE);
+  data.level       = pngvals.compression_level;
+  data.strategy    = data.all_filters ? Z_FILTERED : Z_DEFAULT_STRATEGY;
+
+  adler = adler32 (0L, Z_NULL, 0);
+
+  for (begin = 0; begin < height; begin += batch_rows)
+    {
+      gint num = MIN (batch_rows, height - begin);
+      gint i;
+
+      gegl_buffer_get (buffer,
+                       GEGL_RECTANGLE (0, begin, width, num),
+                       1.0,
+                       file_format,
+                       raw + raw_stride,
+                       raw_stride,
+                       GEGL_ABYSS_NONE);
+
+      save_fixup_rows (pp, info, raw + raw_stride, num, width, bpp, remap);
+
+      if (bit_depth == 16 && G_BYTE_ORDER == G_LITTLE_ENDIAN)
+        {
+          for (i = 0; i < num; i++)
             {
-              guchar inverse_remap[256];
+              guint16 *p = (guint16 *) (raw + raw_stride * (i + 1));
+              gsize    k;
 
-              for (i = 0; i < 256; i++)
-                inverse_remap[ remap[i] ] = i;
+              for (k = 0; k < rowbytes / 2; k++)
+                p[k] = GUINT16_SWAP_LE_BE (p[k]);
+            }
+        }
 
-              for (i = 0; i < num; ++i)
-                {
-                  fixed = pixels[i];
-                  for (k = 0; k < width; ++k)
-                    {
-                      fixed[k] = (fixed[k*2+1] > 127) ?
-                                 inverse_remap[ fixed[k*2] ] :
-                                 0;
-                    }
-                }
+      data.last_batch = (begin + num == height);
+      data.n_bands    = (num + band_rows - 1) / band_rows;
+
+      for (i = 0; i < data.n_bands; i++)
+        {
+          data.bands[i].first_row = i * band_rows;
+          data.bands[i].n_rows    = MIN (band_rows, num - i * band_rows);
+        }
+
+      gegl_parallel_distribute_range (
+        num, 16,
+        (GeglParallelDistributeRangeFunc) save_filter_rows,
+        &data);
+
+      gegl_parallel_distribute_range (
+        data.n_bands, 1,
+        (GeglParallelDistributeRangeFunc) save_deflate_bands,
+        &data);
+
+      for (i = 0; i < data.n_bands; i++)
+        {
+          PngBand *band = &data.bands[i];
+          guchar  *start;
+          gsize    size;
+
+          adler = adler32_combine (adler, band->adler,
+                                   (gsize) band->n_rows * (rowbytes + 1));
+
+          /* the deflated data has room for the zlib header in front,
+           * and the checksum at the end
+           */
+          start = band->data + 2;
+          size  = band->size;
+
+          if (first_band)
+            {
+              gint level = data.level;
+              gint flevel;
+              gint header;
+
+              if (level < 2)
+                flevel = 0;
+              else if (level < 6)
+                flevel = 1;
+              else if (level == 6)
+                flevel = 2;
+              else
+                flevel = 3;
+
+              /* deflate, 32k window */
+              header  = (0x78 << 8) | (flevel << 6);
+              header += (31 - header % 31) % 31;
+
+              start[-2] = header >> 8;
+              start[-1] = header & 0xff;
+
+              start -= 2;
+              size  += 2;
+
+              first_band = FALSE;
             }
 
-          /* Otherwise if we have a paletted image and transparency
-           * couldn't be set, we ignore the alpha channel */
-          else if (png_get_valid (pp, info, PNG_INFO_PLTE) &&
-                   bpp == 2)
+          if (data.last_batch && i == data.n_bands - 1)
             {
-              for (i = 0; i < num; ++i)
-                {
-                  fixed = pixels[i];
-                  for (k = 0; k < width; ++k)
-                    {
-                      fixed[k] = fixed[k * 2];
-                    }
-                }
+              start[size++] = (adler >> 24) & 0xff;
+              start[size++] = (adler >> 16) & 0xff;
+              start[size++] = (adler >>  8) & 0xff;
+              start[size++] = (adler >>  0) & 0xff;
             }
 
-          png_write_rows (pp, pixels, num);
+          png_write_chunk (pp, (png_const_bytep) "IDAT", start, size);
 
-          gimp_progress_update (((double) pass + (double) end /
-                                 (double) height) /
-                                (double) num_passes);
+          g_clear_pointer (&band->data, g_free);
         }
+
+      /* keep the tail of the filtered data, and the last row */
+      if (! data.last_batch)
+        {
+          gsize size = (gsize) num * (rowbytes + 1);
+
+          memmove (filtered,
+                   data.filtered + size - DEFLATE_WINDOW_SIZE,
+                   DEFLATE_WINDOW_SIZE);
+
+          data.dict_size = MIN (data.dict_size + size, DEFLATE_WINDOW_SIZE);
+
+          memcpy (raw, raw + raw_stride * num, raw_stride);
+        }
+
+      gimp_progress_update ((gdouble) (begin + num) / (gdouble) height);
     }
 
-  gimp_progress_update (1.0);
+  /* png_write_end() insists on writing the IDAT chunks itself */
+  png_write_chunk (pp, (png_const_bytep) "IEND", NULL, 0);
 
-  png_write_end (pp, info);
-  png_destroy_write_struct (&pp, &info);
+  g_free (data.bands);
+  g_free (filtered);
+  g_free (raw);
+}
 
-  g_free (pixel);
-  g_free (pixels);
+static inline gsize
+save_filter_sum (const guchar *row,
+                 gsize         rowbytes)
+{
+  gsize sum = 0;
+  gsize i;
 
-  /*
-   * Done with the file...
-   */
+  /* the sum of absolute values of the bytes, taken as signed */
+  for (i = 0; i < rowbytes; i++)
+    sum += row[i] < 128 ? row[i] : 256 - row[i];
 
-  if (text)
+  return sum;
+}
+
+/*
+ * 'save_filter_rows()' - Filter a range of rows of a batch.
+ *
+ * Like libpng, every filter is tried, and the one which minimizes the
+ * sum of absolute differences is chosen.  The filters are written as
+ * plain loops over the bytes, which the compiler can vectorize.
+ */
+
+static void
+save_filter_rows (PngDeflateData *data,
+                  gint            first_row,
+                  gint            n_rows)
+{
+  const gsize  rowbytes = data->rowbytes;
+  const gsize  bpp      = data->filter_bpp;
+  guchar      *scratch;
+  gint         y;
+
+  scratch = g_malloc (4 * rowbytes);
+
+  for (y = first_row; y < first_row + n_rows; y++)
     {
-      g_free (text[0].text);
-      g_free (text);
+      const guchar *row  = data->raw + data->raw_stride * y;
+      const guchar *prev = row - data->raw_stride;
+      guchar       *out  = data->filtered + (rowbytes + 1) * y;
+      const guchar *best = row;
+      gint          type = PNG_FILTER_VALUE_NONE;
+
+      if (data->all_filters)
+        {
+          guchar *sub   = scratch;
+          guchar *up    = scratch + rowbytes;
+          guchar *avg   = scratch + rowbytes * 2;
+          guchar *paeth = scratch + rowbytes * 3;
+          gsize   sum;
+          gsize   min_sum;
+          gsize   i;
+
+          for (i = 0; i < bpp; i++)
+            {
+              sub[i]   = row[i];
+              up[i]    = row[i] - prev[i];
+              avg[i]   = row[i] - (prev[i] >> 1);
+              paeth[i] = row[i] - prev[i];
+            }
+
+          for (i = bpp; i < rowbytes; i++)
+            sub[i] = row[i] - row[i - bpp];
+
+          for (i = bpp; i < rowbytes; i++)
+            up[i] = row[i] - prev[i];
+
+          for (i = bpp; i < rowbytes; i++)
+            avg[i] = row[i] - ((row[i - bpp] + prev[i]) >> 1);
+
+          for (i = bpp; i < rowbytes; i++)
+            {
+              gint a  = row[i - bpp];
+              gint b  = prev[i];
+              gint c  = prev[i - bpp];
+              gint pa = ABS (b - c);
+              gint pb = ABS (a - c);
+              gint pc = ABS (a + b - 2 * c);
+              gint p;
+
+              p = (pb <= pc) ? b : c;
+              p = (pa <= pb && pa <= pc) ? a : p;
+
+              paeth[i] = row[i] - p;
+            }
+
+          min_sum = save_filter_sum (row, rowbytes);
+
+          sum = save_filter_sum (sub, rowbytes);
+          if (sum < min_sum)
+            {
+              min_sum = sum;
+              best    = sub;
+              type    = PNG_FILTER_VALUE_SUB;
+            }
+
+          sum = save_filter_sum (up, rowbytes);
+          if (sum < min_sum)
+            {
+              min_sum = sum;
+              best    = up;
+              type    = PNG_FILTER_VALUE_UP;
+            }
+
+          sum = save_filter_sum (avg, rowbytes);
+          if (sum < min_sum)
+            {
+              min_sum = sum;
+              best    = avg;
+              type    = PNG_FILTER_VALUE_AVG;
+            }
+
+          sum = save_filter_sum (paeth, rowbytes);
+          if (sum < min_sum)
+            {
+              min_sum = sum;
+              best    = paeth;
+              type    = PNG_FILTER_VALUE_PAETH;
+            }
+        }
+
+      out[0] = type;
+      memcpy (out + 1, best, rowbytes);
     }
 
-  free (pp);
-  free (info);
+  g_free (scratch);
+}
 
-  fclose (fp);
+/*
+ * 'save_deflate_bands()' - Compress a range of bands of a batch.
+ *
+ * The deflated data of each band is stored two bytes into band->data,
+ * with four more bytes to spare at the end, see save_rows_parallel().
+ */
 
-  return TRUE;
+static void
+save_deflate_bands (PngDeflateData *data,
+                    gint            first_band,
+                    gint            n_bands)
+{
+  gint b;
+
+  for (b = first_band; b < first_band + n_bands; b++)
+    {
+      PngBand  *band  = &data->bands[b];
+      guchar   *in    = data->filtered + (data->rowbytes + 1) * band->first_row;
+      gsize     size  = (gsize) (data->rowbytes + 1) * band->n_rows;
+      gboolean  last  = data->last_batch && b == data->n_bands - 1;
+      gsize     dict_size;
+      gsize     alloc;
+      z_stream  zs  = { 0, };
+      gint      ret;
+
+      band->adler = adler32 (adler32 (0L, Z_NULL, 0), in, size);
+
+      deflateInit2 (&zs, data->level, Z_DEFLATED,
+                    -15 /* raw deflate, 32k window */, 8, data->strategy);
+
+      /* the filtered data preceding the band, which is either part of
+       * this batch, or the tail kept from the previous one
+       */
+      dict_size = MIN (DEFLATE_WINDOW_SIZE,
+                       data->dict_size +
+                       (gsize) (data->rowbytes + 1) * band->first_row);
+
+      if (dict_size > 0)
+        deflateSetDictionary (&zs, in - dict_size, dict_size);
+
+      /* room for the sync flush marker, the zlib header and checksum */
+      alloc      = deflateBound (&zs, size) + 16;
+      band->data = g_malloc (alloc);
+
+      zs.next_in   = in;
+      zs.avail_in  = size;
+      zs.next_out  = band->data + 2;
+      zs.avail_out = alloc - 2 - 4;
+
+      while ((ret = deflate (&zs, last ? Z_FINISH : Z_SYNC_FLUSH)) == Z_OK &&
+             (zs.avail_in > 0 || zs.avail_out == 0))
+        {
+          gsize used = zs.next_out - band->data;
+
+          alloc        *= 2;
+          band->data    = g_realloc (band->data, alloc);
+          zs.next_out   = band->data + used;
+          zs.avail_out  = alloc - used - 4;
+        }
+
+      band->size = zs.next_out - (band->data + 2);
+
+      deflateEnd (&zs);
+    }
 }
 
 static gboolean
@@ -43,6 +43,11 @@
 static gboolean  jpeg_load_resolution       (gint32    image_ID,
                                              struct jpeg_decompress_struct
                                                        *cinfo);
+static gboolean  jpeg_load_exif_resolution  (gint32       image_ID,
+                                             const gchar *filename);
+static gint      jpeg_load_scale_denom      (struct jpeg_decompress_struct
+                                                       *cinfo,
+                                             gint      size);
 
 static void      jpeg_load_sanitize_comment (gchar    *comment);
 
@@ -59,6 +64,7 @@ gint32
 load_image (const gchar  *filename,
             GimpRunMode   runmode,
             gboolean      preview,
+            gint          size,
             gboolean     *resolution_loaded,
             GError      **error)
 {
@@ -160,6 +166,13 @@ load_image (const gchar  *filename,
 
   cinfo.dct_method = JDCT_FLOAT;
 
+  /* When a reduced size was requested, let the library do the
+   * downscaling as part of the IDCT, which is a lot cheaper than
+   * decoding the full image.
+   */
+  cinfo.scale_num   = 1;
+  cinfo.scale_denom = jpeg_load_scale_denom (&cinfo, size);
+
   /* Step 5: Start decompressor */
 
   jpeg_start_decompress (&cinfo);
@@ -294,6 +307,28 @@ load_image (const gchar  *filename,
           if (resolution_loaded)
             *resolution_loaded = TRUE;
         }
+      else if (cinfo.scale_denom > 1)
+        {
+          /* the Exif resolution would be applied later, unscaled, by
+           * gimp_image_metadata_load_finish(), so apply it here
+           */
+          jpeg_load_exif_resolution (image_ID, filename);
+        }
+
+      /* keep the physical size of a downscaled image */
+      if (cinfo.scale_denom > 1)
+        {
+          gdouble xresolution;
+          gdouble yresolution;
+
+          gimp_image_get_resolution (image_ID, &xresolution, &yresolution);
+          gimp_image_set_resolution (image_ID,
+                                     xresolution / cinfo.scale_denom,
+                                     yresolution / cinfo.scale_denom);
+
+          if (resolution_loaded)
+            *resolution_loaded = TRUE;
+        }
 
       /* if we found any comments, then make a parasite for them */
       if (comment_buffer && comment_buffer->len)
@@ -488,6 +523,61 @@ jpeg_load_resolution (gint32                         image_ID,
   return FALSE;
 }
 
+static gboolean
+jpeg_load_exif_resolution (gint32       image_ID,
+                           const gchar *filename)
+{
+  GFile        *file     = g_file_new_for_path (filename);
+  GimpMetadata *metadata = gimp_metadata_load_from_file (file, NULL);
+  gboolean      success  = FALSE;
+
+  if (metadata)
+    {
+      gdouble  xresolution;
+      gdouble  yresolution;
+      GimpUnit unit;
+
+      if (gimp_metadata_get_resolution (metadata,
+                                        &xresolution, &yresolution, &unit))
+        {
+          gimp_image_set_resolution (image_ID, xresolution, yresolution);
+          gimp_image_set_unit (image_ID, unit);
+
+          success = TRUE;
+        }
+
+      g_object_unref (metadata);
+    }
+
+  g_object_unref (file);
+
+  return success;
+}
+
+/* Returns the largest IDCT scaling denominator supported by every
+ * libjpeg version (1, 2, 4 or 8) that still yields an image whose
+ * longer side is at least @size pixels.  A @size of 0 or less means
+ * full size.
+ */
+static gint
+jpeg_load_scale_denom (struct jpeg_decompress_struct *cinfo,
+                       gint                           size)
+{
+  gint longest = MAX (cinfo->image_width, cinfo->image_height);
+  gint denom;
+
+  if (size <= 0)
+    return 1;
+
+  for (denom = 8; denom > 1; denom /= 2)
+    {
+      if ((longest + denom - 1) / denom >= size)
+        return denom;
+    }
+
+  return 1;
+}
+
 /*
  * A number of JPEG files have comments written in a local character set
  * instead of UTF-8.  Some of these files may have been saved by older
@@ -514,6 +604,7 @@ jpeg_load_sanitize_comment (gchar *comment)
 
 gint32
 load_thumbnail_image (GFile         *file,
+                      gint           size,
                       gint          *width,
                       gint          *height,
                       GimpImageType *type,
@@ -523,26 +614,24 @@ load_thumbnail_image (GFile         *file,
   struct jpeg_decompress_struct cinfo;
   struct my_error_mgr           jerr;
   FILE                         *infile   = NULL;
+  gchar                        *filename;
 
   gimp_progress_init_printf (_("Opening thumbnail for '%s'"),
                              g_file_get_parse_name (file));
 
-  image_ID = gimp_image_metadata_load_thumbnail (file, error);
-  if (image_ID < 1)
-    return -1;
-
   cinfo.err = jpeg_std_error (&jerr.pub);
   jerr.pub.error_exit     = my_error_exit;
   jerr.pub.output_message = my_output_message;
 
-  if ((infile = g_fopen (g_file_get_path (file), "rb")) == NULL)
+  filename = g_file_get_path (file);
+
+  if ((infile = g_fopen (filename, "rb")) == NULL)
     {
       g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
                    _("Could not open '%s' for reading: %s"),
                    g_file_get_parse_name (file), g_strerror (errno));
 
-      if (image_ID != -1)
-        gimp_image_delete (image_ID);
+      g_free (filename);
 
       return -1;
     }
@@ -555,9 +644,9 @@ load_thumbnail_image (GFile         *file,
        * and return.
        */
       jpeg_destroy_decompress (&cinfo);
+      fclose (infile);
 
-      if (image_ID != -1)
-        gimp_image_delete (image_ID);
+      g_free (filename);
 
       return -1;
     }
@@ -569,11 +658,13 @@ load_thumbnail_image (GFile         *file,
 
   jpeg_stdio_src (&cinfo, infile);
 
-  /* Step 3: read file parameters with jpeg_read_header() */
+  /* Step 3: read file parameters with jpeg_read_header(), we only
+   * need the size and color space of the full image here
+   */
 
   jpeg_read_header (&cinfo, TRUE);
 
-  jpeg_start_decompress (&cinfo);
+  jpeg_calc_output_dimensions (&cinfo);
 
   *width  = cinfo.output_width;
   *height = cinfo.output_height;
@@ -602,9 +693,12 @@ load_thumbnail_image (GFile         *file,
                  cinfo.output_components, cinfo.out_color_space,
                  cinfo.jpeg_color_space);
 
-      gimp_image_delete (image_ID);
-      image_ID = -1;
-      break;
+      jpeg_destroy_decompress (&cinfo);
+      fclose (infile);
+
+      g_free (filename);
+
+      return -1;
     }
 
   /* Step 4: Release JPEG decompression object */
@@ -616,6 +710,26 @@ load_thumbnail_image (GFile         *file,
 
   fclose (infile);
 
+  /* Prefer the Exif thumbnail, unless it is smaller than what was asked
+   * for.  Otherwise, decode the image itself at a reduced size.
+   */
+  image_ID = gimp_image_metadata_load_thumbnail (file, NULL);
+
+  if (image_ID > 0 &&
+      MAX (gimp_image_width (image_ID), gimp_image_height (image_ID)) < size &&
+      MAX (*width, *height) > MAX (gimp_image_width (image_ID),
+                                   gimp_image_height (image_ID)))
+    {
+      gimp_image_delete (image_ID);
+      image_ID = -1;
+    }
+
+  if (image_ID < 1)
+    image_ID = load_image (filename, GIMP_RUN_NONINTERACTIVE, FALSE, size,
+                           NULL, error);
+
+  g_free (filename);
+
   return image_ID;
 }
 
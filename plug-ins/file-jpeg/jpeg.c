@@ -82,6 +82,14 @@ query (void)
     { GIMP_PDB_IMAGE,   "image",         "Output image" }
   };
 
+  static const GimpParamDef load_scaled_args[] =
+  {
+    { GIMP_PDB_INT32,    "run-mode",     "The run mode { RUN-INTERACTIVE (0), RUN-NONINTERACTIVE (1) }" },
+    { GIMP_PDB_STRING,   "filename",     "The name of the file to load" },
+    { GIMP_PDB_STRING,   "raw-filename", "The name of the file to load" },
+    { GIMP_PDB_INT32,    "size",         "Minimum size of the longer side of the loaded image, or 0 for full size" }
+  };
+
   static const GimpParamDef thumb_args[] =
   {
     { GIMP_PDB_STRING, "filename",     "The name of the file to load"  },
@@ -131,9 +139,30 @@ query (void)
                                     "",
                                     "6,string,JFIF,6,string,Exif");
 
+  gimp_install_procedure (LOAD_SCALED_PROC,
+                          "loads files in the JPEG file format at a reduced size",
+                          "Loads a JPEG image downscaled by 1/2, 1/4 or 1/8, "
+                          "whichever is the smallest that keeps the longer "
+                          "side of the image at least 'size' pixels long. "
+                          "The downscaling is done while decoding, which "
+                          "makes this a lot faster than loading the full "
+                          "image and scaling it, and is useful for loading "
+                          "proxies of large images.",
+                          "Spencer Kimball, Peter Mattis & others",
+                          "Spencer Kimball & Peter Mattis",
+                          "2026",
+                          NULL,
+                          NULL,
+                          GIMP_PLUGIN,
+                          G_N_ELEMENTS (load_scaled_args),
+                          G_N_ELEMENTS (load_return_vals),
+                          load_scaled_args, load_return_vals);
+
   gimp_install_procedure (LOAD_THUMB_PROC,
                           "Loads a thumbnail from a JPEG image",
-                          "Loads a thumbnail from a JPEG image (only if it exists)",
+                          "Loads the Exif thumbnail of a JPEG image, or, if "
+                          "there is none or it is smaller than 'thumb-size', "
+                          "decodes the image at a reduced size.",
                           "Mukund Sivaraman <muks@mukund.org>, Sven Neumann <sven@gimp.org>",
                           "Mukund Sivaraman <muks@mukund.org>, Sven Neumann <sven@gimp.org>",
                           "November 15, 2004",
@@ -194,9 +223,14 @@ run (const gchar      *name,
   orig_subsmp = JPEG_SUBSAMPLING_2x2_1x1_1x1;
   num_quant_tables = 0;
 
-  if (strcmp (name, LOAD_PROC) == 0)
+  if (strcmp (name, LOAD_PROC) == 0 ||
+      strcmp (name, LOAD_SCALED_PROC) == 0)
     {
       gboolean resolution_loaded = FALSE;
+      gint     size              = 0;
+
+      if (strcmp (name, LOAD_SCALED_PROC) == 0 && nparams > 3)
+        size = param[3].data.d_int32;
 
       switch (run_mode)
         {
@@ -210,7 +244,7 @@ run (const gchar      *name,
           break;
         }
 
-      image_ID = load_image (param[1].data.d_string, run_mode, FALSE,
+      image_ID = load_image (param[1].data.d_string, run_mode, FALSE, size,
                              &resolution_loaded, &error);
 
       if (image_ID != -1)
@@ -259,7 +293,8 @@ run (const gchar      *name,
           gint          height = 0;
           GimpImageType type   = -1;
 
-          image_ID = load_thumbnail_image (file, &width, &height, &type,
+          image_ID = load_thumbnail_image (file, param[1].data.d_int32,
+                                           &width, &height, &type,
                                            &error);
 
           g_object_unref (file);
@@ -18,9 +18,10 @@
 #ifndef __JPEG_H__
 #define __JPEG_H__
 
-#define LOAD_PROC       "file-jpeg-load"
-#define LOAD_THUMB_PROC "file-jpeg-load-thumb"
-#define SAVE_PROC       "file-jpeg-save"
+#define LOAD_PROC        "file-jpeg-load"
+#define LOAD_THUMB_PROC  "file-jpeg-load-thumb"
+#define LOAD_SCALED_PROC "file-jpeg-load-scaled"
+#define SAVE_PROC        "file-jpeg-save"
 #define PLUG_IN_BINARY  "file-jpeg"
 #define PLUG_IN_ROLE    "gimp-file-jpeg"
 
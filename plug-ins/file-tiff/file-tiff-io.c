@@ -47,6 +47,8 @@ typedef struct
 } TiffIO;
 
 
+static void      tiff_io_message       (const gchar *fmt,
+                                        va_list      ap) G_GNUC_PRINTF (1, 0);
 static void      tiff_io_warning       (const gchar *module,
                                         const gchar *fmt,
                                         va_list      ap) G_GNUC_PRINTF (2, 0);
@@ -64,70 +66,174 @@ static toff_t    tiff_io_seek          (thandle_t    handle,
                                         gint         whence);
 static gint      tiff_io_close         (thandle_t    handle);
 static toff_t    tiff_io_get_file_size (thandle_t    handle);
+static void      tiff_io_free          (TiffIO      *io);
 
 
-static TiffIO tiff_io = { 0, };
+/*  libtiff's handlers are called from whatever thread uses a handle.
+ *  messages from threads other than the one which opened the first
+ *  handle are queued, without duplicates, since all decoding threads
+ *  tend to report the same problem, and are shown by
+ *  tiff_io_flush_messages()
+ */
+static GThread   *tiff_io_thread = NULL;
+static GPtrArray *tiff_io_queue  = NULL;
+
+G_LOCK_DEFINE_STATIC (tiff_io_queue);
 
 
+/*  each TIFF handle gets its own TiffIO, so that several handles can be
+ *  open at the same time, for example one per decoding thread
+ */
 TIFF *
 tiff_open (GFile        *file,
            const gchar  *mode,
            GError      **error)
 {
+  TiffIO *tiff_io;
+  TIFF   *tif;
+
+  if (! tiff_io_thread)
+    tiff_io_thread = g_thread_self ();
+
   TIFFSetWarningHandler ((TIFFErrorHandler) tiff_io_warning);
   TIFFSetErrorHandler ((TIFFErrorHandler) tiff_io_error);
 
-  tiff_io.file = file;
+  tiff_io = g_slice_new0 (TiffIO);
+
+  tiff_io->file = g_object_ref (file);
 
   if (! strcmp (mode, "r"))
     {
-      tiff_io.input = G_INPUT_STREAM (g_file_read (file, NULL, error));
-      if (! tiff_io.input)
-        return NULL;
+      tiff_io->input = G_INPUT_STREAM (g_file_read (file, NULL, error));
 
-      tiff_io.stream = G_OBJECT (tiff_io.input);
+      tiff_io->stream = G_OBJECT (tiff_io->input);
     }
   else if(! strcmp (mode, "w"))
     {
-      tiff_io.output = G_OUTPUT_STREAM (g_file_replace (file,
-                                                        NULL, FALSE,
-                                                        G_FILE_CREATE_NONE,
-                                                        NULL, error));
-      if (! tiff_io.output)
-        return NULL;
-
-      tiff_io.stream = G_OBJECT (tiff_io.output);
+      tiff_io->output = G_OUTPUT_STREAM (g_file_replace (file,
+                                                         NULL, FALSE,
+                                                         G_FILE_CREATE_NONE,
+                                                         NULL, error));
+
+      tiff_io->stream = G_OBJECT (tiff_io->output);
     }
   else if(! strcmp (mode, "a"))
     {
       GIOStream *iostream = G_IO_STREAM (g_file_open_readwrite (file, NULL,
                                                                 error));
-      if (! iostream)
-        return NULL;
-
-      tiff_io.input  = g_io_stream_get_input_stream (iostream);
-      tiff_io.output = g_io_stream_get_output_stream (iostream);
-      tiff_io.stream = G_OBJECT (iostream);
+      if (iostream)
+        {
+          tiff_io->input  = g_io_stream_get_input_stream (iostream);
+          tiff_io->output = g_io_stream_get_output_stream (iostream);
+          tiff_io->stream = G_OBJECT (iostream);
+        }
     }
   else
     {
       g_assert_not_reached ();
     }
 
+  if (! tiff_io->stream)
+    {
+      tiff_io_free (tiff_io);
+
+      return NULL;
+    }
+
 #if 0
 #warning FIXME !can_seek code is broken
-  tiff_io.can_seek = g_seekable_can_seek (G_SEEKABLE (tiff_io.stream));
+  tiff_io->can_seek = g_seekable_can_seek (G_SEEKABLE (tiff_io->stream));
 #endif
-  tiff_io.can_seek = TRUE;
-
-  return TIFFClientOpen ("file-tiff", mode,
-                         (thandle_t) &tiff_io,
-                         tiff_io_read,
-                         tiff_io_write,
-                         tiff_io_seek,
-                         tiff_io_close,
-                         tiff_io_get_file_size,
-                         NULL, NULL);
+  tiff_io->can_seek = TRUE;
+
+  tif = TIFFClientOpen ("file-tiff", mode,
+                        (thandle_t) tiff_io,
+                        tiff_io_read,
+                        tiff_io_write,
+                        tiff_io_seek,
+                        tiff_io_close,
+                        tiff_io_get_file_size,
+                        NULL, NULL);
+
+  /*  libtiff doesn't call the close function when opening fails  */
+  if (! tif)
+    tiff_io_close ((thandle_t) tiff_io);
+
+  return tif;
+}
+
+/*  shows the messages queued by other threads, must be called from the
+ *  thread which opened the first handle, after the other threads are
+ *  done with their handles
+ */
+void
+tiff_io_flush_messages (void)
+{
+  GPtrArray *queue;
+  gint       i;
+
+  G_LOCK (tiff_io_queue);
+
+  queue         = tiff_io_queue;
+  tiff_io_queue = NULL;
+
+  G_UNLOCK (tiff_io_queue);
+
+  if (! queue)
+    return;
+
+  for (i = 0; i < queue->len; i++)
+    g_message ("%s", (const gchar *) g_ptr_array_index (queue, i));
+
+  g_ptr_array_free (queue, TRUE);
+}
+
+static void
+tiff_io_free (TiffIO *io)
+{
+  g_clear_object (&io->stream);
+  g_clear_object (&io->file);
+
+  g_free (io->buffer);
+
+  g_slice_free (TiffIO, io);
+}
+
+static void
+tiff_io_message (const gchar *fmt,
+                 va_list      ap)
+{
+  gchar *msg;
+  gint   i;
+
+  if (g_thread_self () == tiff_io_thread)
+    {
+      g_logv (G_LOG_DOMAIN, G_LOG_LEVEL_MESSAGE, fmt, ap);
+
+      return;
+    }
+
+  msg = g_strdup_vprintf (fmt, ap);
+
+  G_LOCK (tiff_io_queue);
+
+  if (! tiff_io_queue)
+    tiff_io_queue = g_ptr_array_new_with_free_func (g_free);
+
+  for (i = 0; i < tiff_io_queue->len; i++)
+    {
+      if (! strcmp (msg, g_ptr_array_index (tiff_io_queue, i)))
+        {
+          g_clear_pointer (&msg, g_free);
+
+          break;
+        }
+    }
+
+  if (msg)
+    g_ptr_array_add (tiff_io_queue, msg);
+
+  G_UNLOCK (tiff_io_queue);
 }
 
 static void
@@ -189,7 +295,7 @@ tiff_io_warning (const gchar *module,
       return;
     }
 
-  g_logv (G_LOG_DOMAIN, G_LOG_LEVEL_MESSAGE, fmt, ap);
+  tiff_io_message (fmt, ap);
 }
 
 static void
@@ -203,7 +309,7 @@ tiff_io_error (const gchar *module,
   if (! strcmp (fmt, "Compression algorithm does not support random access"))
     return;
 
-  g_logv (G_LOG_DOMAIN, G_LOG_LEVEL_MESSAGE, fmt, ap);
+  tiff_io_message (fmt, ap);
 }
 
 static tsize_t
@@ -442,17 +548,7 @@ tiff_io_close (thandle_t handle)
       g_clear_error (&error);
     }
 
-  g_object_unref (io->stream);
-  io->stream = NULL;
-  io->input  = NULL;
-  io->output = NULL;
-
-  g_free (io->buffer);
-  io->buffer = NULL;
-
-  io->allocated = 0;
-  io->used      = 0;
-  io->position  = 0;
+  tiff_io_free (io);
 
   return closed ? 0 : -1;
 }
@@ -23,9 +23,11 @@
 #define __FILE_TIFF_IO_H__
 
 
-TIFF * tiff_open (GFile        *file,
-                  const gchar  *mode,
-                  GError      **error);
+TIFF * tiff_open              (GFile        *file,
+                               const gchar  *mode,
+                               GError      **error);
+
+void   tiff_io_flush_messages (void);
 
 
 #endif /* __FILE_TIFF_IO_H__ */
@@ -45,6 +45,7 @@
 #include "config.h"
 
 #include <errno.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <tiffio.h>
@@ -52,6 +53,7 @@
 #include <libgimp/gimp.h>
 #include <libgimp/gimpui.h>
 
+#include "file-tiff-io.h"
 #include "file-tiff-load.h"
 
 #include "libgimp/stdplugins-intl.h"
@@ -76,6 +78,41 @@ typedef struct
   guchar     *pixel;
 } ChannelData;
 
+/*  a tile or strip, decoded by one of the threads of load_contiguous_parallel()  */
+typedef struct
+{
+  guint32   x;
+  guint32   y;
+  guint32   cols;
+  guint32   rows;
+  gboolean  success;
+  guchar   *data;
+  guchar   *bw_data;
+} DecodeChunk;
+
+typedef struct
+{
+  gboolean     tiled;
+  gboolean     is_bw;
+  guint32      image_width;
+  guint32      image_height;
+  guint32      chunk_width;
+  guint32      chunk_height;
+  guint32      chunks_across;
+  gint         n_chunks;
+  gint         next_chunk;
+
+  GAsyncQueue *free_chunks;
+  GAsyncQueue *decoded_chunks;
+} DecodeData;
+
+typedef struct
+{
+  DecodeData *data;
+  TIFF       *tif;
+  GThread    *thread;
+} DecodeWorker;
+
 
 /* Declare some local functions */
 
@@ -83,13 +120,34 @@ static GimpColorProfile * load_profile     (TIFF         *tif);
 
 static void               load_rgba        (TIFF         *tif,
                                             ChannelData  *channel);
-static void               load_contiguous  (TIFF         *tif,
+static void               load_contiguous  (GFile        *file,
+                                            TIFF         *tif,
                                             ChannelData  *channel,
                                             const Babl   *type,
                                             gushort       bps,
                                             gushort       spp,
                                             gboolean      is_bw,
                                             gint          extra);
+static gboolean           load_contiguous_parallel
+                                           (GFile        *file,
+                                            TIFF         *tif,
+                                            ChannelData  *channel,
+                                            const Babl   *src_format,
+                                            gint          bytes_per_pixel,
+                                            gboolean      is_bw,
+                                            gint          extra);
+static gpointer           load_contiguous_decode
+                                           (DecodeWorker *worker);
+static void               load_contiguous_write
+                                           (ChannelData  *channel,
+                                            gint          extra,
+                                            const Babl   *src_format,
+                                            const guchar *data,
+                                            gint          rowstride,
+                                            guint32       x,
+                                            guint32       y,
+                                            guint32       cols,
+                                            guint32       rows);
 static void               load_separate    (TIFF         *tif,
                                             ChannelData  *channel,
                                             const Babl   *type,
@@ -1014,7 +1072,7 @@ load_image (GFile              *file,
         }
       else if (planar == PLANARCONFIG_CONTIG)
         {
-          load_contiguous (tif, channel, type, bps, spp, is_bw, extra);
+          load_contiguous (file, tif, channel, type, bps, spp, is_bw, extra);
         }
       else
         {
@@ -1411,7 +1469,8 @@ load_paths (TIFF *tif,
 
 
 static void
-load_contiguous (TIFF        *tif,
+load_contiguous (GFile       *file,
+                 TIFF        *tif,
                  ChannelData *channel,
                  const Babl  *type,
                  gushort      bps,
@@ -1434,6 +1493,23 @@ load_contiguous (TIFF        *tif,
 
   g_printerr ("%s\n", __func__);
 
+  src_format = babl_format_n (type, spp);
+
+  /* consistency check */
+  bytes_per_pixel = 0;
+  for (i = 0; i <= extra; i++)
+    bytes_per_pixel += babl_format_get_bytes_per_pixel (channel[i].format);
+
+  g_printerr ("bytes_per_pixel: %d, format: %d\n",
+              bytes_per_pixel,
+              babl_format_get_bytes_per_pixel (src_format));
+
+  if (load_contiguous_parallel (file, tif, channel, src_format,
+                                bytes_per_pixel, is_bw, extra))
+    {
+      return;
+    }
+
   TIFFGetField (tif, TIFFTAG_IMAGEWIDTH,  &image_width);
   TIFFGetField (tif, TIFFTAG_IMAGELENGTH, &image_height);
 
@@ -1459,27 +1535,14 @@ load_contiguous (TIFF        *tif,
 
   one_row = (gdouble) tile_height / (gdouble) image_height;
 
-  src_format = babl_format_n (type, spp);
-
-  /* consistency check */
-  bytes_per_pixel = 0;
-  for (i = 0; i <= extra; i++)
-    bytes_per_pixel += babl_format_get_bytes_per_pixel (channel[i].format);
-
-  g_printerr ("bytes_per_pixel: %d, format: %d\n",
-              bytes_per_pixel,
-              babl_format_get_bytes_per_pixel (src_format));
-
   for (y = 0; y < image_height; y += tile_height)
     {
       guint32 x;
 
       for (x = 0; x < image_width; x += tile_width)
         {
-          GeglBuffer *src_buf;
-          guint32     rows;
-          guint32     cols;
-          gint        offset;
+          guint32 rows;
+          guint32 cols;
 
           gimp_progress_update (progress + one_row *
                                 ((gdouble) x / (gdouble) image_width));
@@ -1495,60 +1558,334 @@ load_contiguous (TIFF        *tif,
           if (is_bw)
             convert_bit2byte (buffer, bw_buffer, cols, rows);
 
-          src_buf = gegl_buffer_linear_new_from_data (is_bw ? bw_buffer : buffer,
-                                                      src_format,
-                                                      GEGL_RECTANGLE (0, 0, cols, rows),
-                                                      tile_width * bytes_per_pixel,
-                                                      NULL, NULL);
+          load_contiguous_write (channel, extra, src_format,
+                                 is_bw ? bw_buffer : buffer,
+                                 tile_width * bytes_per_pixel,
+                                 x, y, cols, rows);
+        }
 
-          offset = 0;
+      progress += one_row;
+    }
 
-          for (i = 0; i <= extra; i++)
-            {
-              GeglBufferIterator *iter;
-              gint                src_bpp;
-              gint                dest_bpp;
-
-              src_bpp  = babl_format_get_bytes_per_pixel (src_format);
-              dest_bpp = babl_format_get_bytes_per_pixel (channel[i].format);
-
-              iter = gegl_buffer_iterator_new (src_buf,
-                                               GEGL_RECTANGLE (0, 0, cols, rows),
-                                               0, NULL,
-                                               GEGL_ACCESS_READ,
-                                               GEGL_ABYSS_NONE, 2);
-              gegl_buffer_iterator_add (iter, channel[i].buffer,
-                                        GEGL_RECTANGLE (x, y, cols, rows),
-                                        0, channel[i].format,
-                                        GEGL_ACCESS_WRITE, GEGL_ABYSS_NONE);
-
-              while (gegl_buffer_iterator_next (iter))
-                {
-                  guchar *s      = iter->items[0].data;
-                  guchar *d      = iter->items[1].data;
-                  gint    length = iter->length;
+  g_free (buffer);
+  g_free (bw_buffer);
+}
 
-                  s += offset;
+/*  decodes the strips or tiles of a contiguous image concurrently, each
+ *  thread using its own libtiff handle.  the decoded chunks are written to
+ *  the drawables' buffers in the calling thread, since the plug-in's
+ *  buffers, like the progress, talk to the core over the wire.  returns
+ *  FALSE, without loading anything, if the image is not suitable for
+ *  parallel decoding.
+ */
+static gboolean
+load_contiguous_parallel (GFile       *file,
+                          TIFF        *tif,
+                          ChannelData *channel,
+                          const Babl  *src_format,
+                          gint         bytes_per_pixel,
+                          gboolean     is_bw,
+                          gint         extra)
+{
+  DecodeData    data = { 0, };
+  DecodeWorker *workers;
+  DecodeChunk  *chunks;
+  const gchar  *env;
+  gsize         chunk_size;
+  guint16       compression;
+  gint          max_threads;
+  gint          n_workers;
+  gint          n_chunks_alloc;
+  gint          i;
+
+  env = g_getenv ("GIMP_TIFF_LOAD_THREADS");
+
+  if (env)
+    max_threads = atoi (env);
+  else
+    max_threads = g_get_num_processors ();
 
-                  while (length--)
-                    {
-                      memcpy (d, s, dest_bpp);
-                      d += dest_bpp;
-                      s += src_bpp;
-                    }
-                }
+  if (max_threads < 2)
+    return FALSE;
+
+  /*  only codecs that decode each strip or tile independently, and
+   *  whose output matches what TIFFReadScanline() / TIFFReadTile() return
+   */
+  TIFFGetFieldDefaulted (tif, TIFFTAG_COMPRESSION, &compression);
+
+  switch (compression)
+    {
+    case COMPRESSION_NONE:
+    case COMPRESSION_LZW:
+    case COMPRESSION_PACKBITS:
+    case COMPRESSION_DEFLATE:
+    case COMPRESSION_ADOBE_DEFLATE:
+      break;
+
+    default:
+      return FALSE;
+    }
+
+  TIFFGetField (tif, TIFFTAG_IMAGEWIDTH,  &data.image_width);
+  TIFFGetField (tif, TIFFTAG_IMAGELENGTH, &data.image_height);
+
+  data.tiled = TIFFIsTiled (tif);
+  data.is_bw = is_bw;
+
+  if (data.tiled)
+    {
+      TIFFGetField (tif, TIFFTAG_TILEWIDTH,  &data.chunk_width);
+      TIFFGetField (tif, TIFFTAG_TILELENGTH, &data.chunk_height);
+
+      data.n_chunks = TIFFNumberOfTiles (tif);
+      chunk_size    = TIFFTileSize (tif);
+    }
+  else
+    {
+      data.chunk_width = data.image_width;
+
+      TIFFGetFieldDefaulted (tif, TIFFTAG_ROWSPERSTRIP, &data.chunk_height);
+      data.chunk_height = MIN (data.chunk_height, data.image_height);
+
+      data.n_chunks = TIFFNumberOfStrips (tif);
+      chunk_size    = TIFFStripSize (tif);
+    }
+
+  if (data.chunk_width == 0 || data.chunk_height == 0 || data.n_chunks < 2)
+    return FALSE;
+
+  data.chunks_across = (data.image_width + data.chunk_width - 1) /
+                       data.chunk_width;
+
+  max_threads = MIN (max_threads, data.n_chunks);
+
+  /*  open all handles up front, and fall back to serial loading if we
+   *  can't get at least two
+   */
+  workers = g_new0 (DecodeWorker, max_threads);
+
+  for (n_workers = 0; n_workers < max_threads; n_workers++)
+    {
+      TIFF *worker_tif = tiff_open (file, "r", NULL);
+
+      if (! worker_tif)
+        break;
+
+      if (! TIFFSetDirectory (worker_tif, TIFFCurrentDirectory (tif)))
+        {
+          TIFFClose (worker_tif);
+
+          break;
+        }
+
+      workers[n_workers].data = &data;
+      workers[n_workers].tif  = worker_tif;
+    }
 
-              offset += dest_bpp;
+  if (n_workers < 2)
+    {
+      for (i = 0; i < n_workers; i++)
+        TIFFClose (workers[i].tif);
+
+      g_free (workers);
+
+      return FALSE;
+    }
+
+  /*  bound the number of chunks in flight, in case writing them out is
+   *  slower than decoding them
+   */
+  n_chunks_alloc = 2 * n_workers;
+  chunks         = g_new0 (DecodeChunk, n_chunks_alloc);
+
+  data.free_chunks    = g_async_queue_new ();
+  data.decoded_chunks = g_async_queue_new ();
+
+  for (i = 0; i < n_chunks_alloc; i++)
+    {
+      chunks[i].data = g_malloc (chunk_size);
+
+      if (is_bw)
+        chunks[i].bw_data = g_malloc (data.chunk_width * data.chunk_height);
+
+      g_async_queue_push (data.free_chunks, &chunks[i]);
+    }
+
+  for (i = 0; i < n_workers; i++)
+    {
+      workers[i].thread = g_thread_new ("tiff-decode",
+                                        (GThreadFunc) load_contiguous_decode,
+                                        &workers[i]);
+    }
+
+  for (i = 0; i < data.n_chunks; i++)
+    {
+      DecodeChunk *chunk = g_async_queue_pop (data.decoded_chunks);
+
+      if (chunk->success)
+        {
+          if (is_bw)
+            {
+              load_contiguous_write (channel, extra, src_format,
+                                     chunk->bw_data,
+                                     data.chunk_width * bytes_per_pixel,
+                                     chunk->x, chunk->y,
+                                     chunk->cols, chunk->rows);
             }
+          else
+            {
+              load_contiguous_write (channel, extra, src_format,
+                                     chunk->data,
+                                     data.tiled ?
+                                     TIFFTileRowSize (tif) :
+                                     TIFFScanlineSize (tif),
+                                     chunk->x, chunk->y,
+                                     chunk->cols, chunk->rows);
+            }
+        }
+
+      g_async_queue_push (data.free_chunks, chunk);
+
+      gimp_progress_update ((gdouble) (i + 1) / (gdouble) data.n_chunks);
+    }
+
+  for (i = 0; i < n_workers; i++)
+    {
+      g_thread_join (workers[i].thread);
+
+      TIFFClose (workers[i].tif);
+    }
+
+  tiff_io_flush_messages ();
+
+  for (i = 0; i < n_chunks_alloc; i++)
+    {
+      g_free (chunks[i].data);
+      g_free (chunks[i].bw_data);
+    }
+
+  g_async_queue_unref (data.free_chunks);
+  g_async_queue_unref (data.decoded_chunks);
+
+  g_free (chunks);
+  g_free (workers);
+
+  return TRUE;
+}
+
+static gpointer
+load_contiguous_decode (DecodeWorker *worker)
+{
+  DecodeData *data = worker->data;
+  gint        index;
+
+  while ((index = g_atomic_int_add (&data->next_chunk, 1)) < data->n_chunks)
+    {
+      DecodeChunk *chunk = g_async_queue_pop (data->free_chunks);
+      tmsize_t     size;
+
+      chunk->x    = (index % data->chunks_across) * data->chunk_width;
+      chunk->y    = (index / data->chunks_across) * data->chunk_height;
+      chunk->cols = MIN (data->image_width  - chunk->x, data->chunk_width);
+      chunk->rows = MIN (data->image_height - chunk->y, data->chunk_height);
+
+      if (data->tiled)
+        size = TIFFReadEncodedTile (worker->tif, index, chunk->data, -1);
+      else
+        size = TIFFReadEncodedStrip (worker->tif, index, chunk->data, -1);
 
-          g_object_unref (src_buf);
+      chunk->success = (size != -1);
+
+      /*  tiles are always decoded in full, strips only up to the last row  */
+      if (chunk->success && data->is_bw)
+        {
+          convert_bit2byte (chunk->data, chunk->bw_data,
+                            data->chunk_width,
+                            data->tiled ? data->chunk_height : chunk->rows);
         }
 
-      progress += one_row;
+      g_async_queue_push (data->decoded_chunks, chunk);
     }
 
-  g_free (buffer);
-  g_free (bw_buffer);
+  return NULL;
+}
+
+/*  writes a decoded block of pixels to the buffers of the image's
+ *  drawables, splitting off any extra channels
+ */
+static void
+load_contiguous_write (ChannelData  *channel,
+                       gint          extra,
+                       const Babl   *src_format,
+                       const guchar *data,
+                       gint          rowstride,
+                       guint32       x,
+                       guint32       y,
+                       guint32       cols,
+                       guint32       rows)
+{
+  GeglBuffer *src_buf;
+  gint        offset;
+  gint        i;
+
+  if (extra == 0 &&
+      babl_format_get_bytes_per_pixel (src_format) ==
+      babl_format_get_bytes_per_pixel (channel[0].format))
+    {
+      gegl_buffer_set (channel[0].buffer,
+                       GEGL_RECTANGLE (x, y, cols, rows), 0,
+                       channel[0].format, data, rowstride);
+
+      return;
+    }
+
+  src_buf = gegl_buffer_linear_new_from_data (data,
+                                              src_format,
+                                              GEGL_RECTANGLE (0, 0, cols, rows),
+                                              rowstride,
+                                              NULL, NULL);
+
+  offset = 0;
+
+  for (i = 0; i <= extra; i++)
+    {
+      GeglBufferIterator *iter;
+      gint                src_bpp;
+      gint                dest_bpp;
+
+      src_bpp  = babl_format_get_bytes_per_pixel (src_format);
+      dest_bpp = babl_format_get_bytes_per_pixel (channel[i].format);
+
+      iter = gegl_buffer_iterator_new (src_buf,
+                                       GEGL_RECTANGLE (0, 0, cols, rows),
+                                       0, NULL,
+                                       GEGL_ACCESS_READ,
+                                       GEGL_ABYSS_NONE, 2);
+      gegl_buffer_iterator_add (iter, channel[i].buffer,
+                                GEGL_RECTANGLE (x, y, cols, rows),
+                                0, channel[i].format,
+                                GEGL_ACCESS_WRITE, GEGL_ABYSS_NONE);
+
+      while (gegl_buffer_iterator_next (iter))
+        {
+          guchar *s      = iter->items[0].data;
+          guchar *d      = iter->items[1].data;
+          gint    length = iter->length;
+
+          s += offset;
+
+          while (length--)
+            {
+              memcpy (d, s, dest_bpp);
+              d += dest_bpp;
+              s += src_bpp;
+            }
+        }
+
+      offset += dest_bpp;
+    }
+
+  g_object_unref (src_buf);
 }
 
 